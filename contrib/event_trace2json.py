@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# Convert an OpenOCD event trace, recorded with 'event_trace start', to the
+# Chrome trace event JSON format. Load the output in chrome://tracing or in
+# https://ui.perfetto.dev to see the adapter transactions on a time line.
+#
+# usage: event_trace2json.py trace.bin > trace.json
+
+import json
+import struct
+import sys
+
+MAGIC = b'OCDTRACE'
+HEADER = struct.Struct('8sIIQQq24x')
+
+# enum event_trace_type in src/helper/event_trace.h
+TYPES = {
+    1: ('jtag_execute_queue', 'jtag'),
+    2: ('dp_read', 'dap'),
+    3: ('dp_write', 'dap'),
+    4: ('ap_read', 'dap'),
+    5: ('ap_write', 'dap'),
+    6: ('dap_run', 'dap'),
+    7: ('batch_run', 'riscv'),
+    8: ('dmi_nop', 'riscv'),
+    9: ('dmi_read', 'riscv'),
+    10: ('dmi_write', 'riscv'),
+}
+
+
+def read_trace(data):
+    for order in '<>':
+        magic, version, record_size, capacity, count, start_time = \
+            struct.unpack_from(order + HEADER.format, data)
+        if magic == MAGIC and version == 1:
+            break
+    else:
+        sys.exit('not an OpenOCD event trace')
+
+    record = struct.Struct(order + 'QQQQIHh')
+    if record_size < record.size:
+        sys.exit('unsupported record size %d' % record_size)
+
+    kept = min(count, capacity)
+    first = count - kept
+    for n in range(first, count):
+        offset = HEADER.size + (n % capacity) * record_size
+        yield record.unpack_from(data, offset)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit('usage: %s trace_file' % sys.argv[0])
+
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+
+    events = []
+    for timestamp, unit, address, value, duration, type_, status in read_trace(data):
+        name, category = TYPES.get(type_, ('type %d' % type_, 'unknown'))
+        events.append({
+            'name': name,
+            'cat': category,
+            'ph': 'X',
+            'ts': timestamp,
+            'dur': duration,
+            'pid': 1,
+            'tid': category,
+            'args': {
+                'unit': hex(unit),
+                'address': hex(address),
+                'value': hex(value),
+                'status': status,
+            },
+        })
+
+    json.dump({'traceEvents': events, 'displayTimeUnit': 'ns'}, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
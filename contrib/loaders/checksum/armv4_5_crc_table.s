@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+	Table driven (slice-by-4) CRC32, same result as armv4_5_crc.s
+	The tables are built first in the buffer pointed by r2.
+
+	r0 - address in - crc out
+	r1 - char count
+	r2 - 4 KiB word aligned buffer for the tables
+*/
+
+	.text
+	.arm
+
+_start:
+main:
+	mov		r3, r0
+	add		r1, r0, r1
+	ldr		r7, CRC32XOR
+
+	/* t0[i]: CRC of byte i */
+	mov		r4, #0
+t0_byte:
+	mov		r0, r4, lsl #24
+	mov		r5, #8
+t0_bit:
+	movs	r0, r0, lsl #1
+	eorcs	r0, r0, r7
+	subs	r5, r5, #1
+	bne		t0_bit
+	str		r0, [r2, r4, lsl #2]
+	add		r4, r4, #1
+	cmp		r4, #256
+	bne		t0_byte
+
+	/* t1..t3: t[k][i] = (t[k - 1][i] << 8) ^ t0[t[k - 1][i] >> 24] */
+	mov		r5, r2
+	add		r4, r2, #1024
+	add		r6, r2, #4096
+tk_entry:
+	ldr		r0, [r5], #4
+	mov		r7, r0, lsr #24
+	ldr		r7, [r2, r7, lsl #2]
+	eor		r0, r7, r0, lsl #8
+	str		r0, [r4], #4
+	cmp		r4, r6
+	bne		tk_entry
+
+	add		r6, r2, #1024	/* t1 */
+	add		r7, r2, #2048	/* t2 */
+	add		r8, r2, #3072	/* t3 */
+	mvn		r0, #0			/* crc */
+
+	/* x = crc ^ next 4 bytes, crc = t3[x3] ^ t2[x2] ^ t1[x1] ^ t0[x0] */
+loop:
+	sub		r4, r1, r3
+	cmp		r4, #4
+	blo		tail
+	ldrb	r4, [r3], #1
+	ldrb	r5, [r3], #1
+	eor		r0, r0, r4, lsl #24
+	eor		r0, r0, r5, lsl #16
+	ldrb	r4, [r3], #1
+	ldrb	r5, [r3], #1
+	eor		r0, r0, r4, lsl #8
+	eor		r0, r0, r5
+	and		r4, r0, #0xff
+	ldr		r4, [r2, r4, lsl #2]
+	mov		r5, r0, lsr #24
+	ldr		r5, [r8, r5, lsl #2]
+	eor		r4, r4, r5
+	and		r5, r0, #0xff00
+	ldr		r5, [r6, r5, lsr #6]
+	eor		r4, r4, r5
+	and		r5, r0, #0xff0000
+	ldr		r5, [r7, r5, lsr #14]
+	eor		r0, r4, r5
+	b		loop
+
+	/* crc = (crc << 8) ^ t0[(crc >> 24) ^ byte] */
+tail:
+	cmp		r3, r1
+	beq		end
+	ldrb	r4, [r3], #1
+	eor		r4, r4, r0, lsr #24
+	ldr		r4, [r2, r4, lsl #2]
+	eor		r0, r4, r0, lsl #8
+	b		tail
+end:
+	bkpt	#0
+
+CRC32XOR:	.word	0x04c11db7
+
+	.end
@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+	Table driven (slice-by-4) CRC32, same result as armv7m_crc.s
+	The tables are built first in the buffer pointed by r2.
+
+	parameters:
+	r0 - address in - crc out
+	r1 - char count
+	r2 - 4 KiB word aligned buffer for the tables
+*/
+
+	.text
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+	.thumb_func
+
+	.align	2
+
+_start:
+main:
+	mov		r3, r0
+	adds	r1, r0, r1
+	mov		r8, r1
+	ldr		r6, CRC32XOR
+
+	/* t0[i]: CRC of byte i */
+	movs	r4, #0
+t0_byte:
+	lsls	r0, r4, #24
+	movs	r5, #8
+t0_bit:
+	lsls	r0, r0, #1
+	bcc		t0_next
+	eors	r0, r0, r6
+t0_next:
+	subs	r5, r5, #1
+	bne		t0_bit
+	lsls	r5, r4, #2
+	str		r0, [r2, r5]
+	adds	r4, r4, #1
+	lsrs	r5, r4, #8
+	beq		t0_byte
+
+	/* t1..t3: t[k][i] = (t[k - 1][i] << 8) ^ t0[t[k - 1][i] >> 24] */
+	movs	r7, #1
+	lsls	r7, r7, #10
+	adds	r4, r2, r7
+	lsls	r1, r7, #2
+	adds	r1, r2, r1
+	mov		r5, r2
+tk_entry:
+	ldm		r5!, {r0}
+	lsrs	r6, r0, #24
+	lsls	r6, r6, #2
+	ldr		r6, [r2, r6]
+	lsls	r0, r0, #8
+	eors	r0, r0, r6
+	stm		r4!, {r0}
+	cmp		r4, r1
+	bne		tk_entry
+
+	/* r2 - t0, r6 - t1, r7 - t2, r1 - t3, r3 - address, r8 - end address */
+	mov		r1, r5
+	adds	r6, r2, r7
+	adds	r7, r6, r7
+	movs	r0, #0
+	mvns	r0, r0
+
+loop:
+	cmp		r3, r8
+	beq		done
+	lsls	r4, r3, #30
+	bne		byte
+	mov		r5, r8
+	subs	r5, r5, r3
+	cmp		r5, #4
+	blo		byte
+
+	/* x = crc ^ next big endian word, crc = t3[x3] ^ t2[x2] ^ t1[x1] ^ t0[x0] */
+	ldm		r3!, {r4}
+	rev		r4, r4
+	eors	r4, r4, r0
+	lsrs	r5, r4, #24
+	lsls	r5, r5, #2
+	ldr		r0, [r1, r5]
+	lsls	r5, r4, #8
+	lsrs	r5, r5, #24
+	lsls	r5, r5, #2
+	ldr		r5, [r7, r5]
+	eors	r0, r0, r5
+	lsls	r5, r4, #16
+	lsrs	r5, r5, #24
+	lsls	r5, r5, #2
+	ldr		r5, [r6, r5]
+	eors	r0, r0, r5
+	lsls	r5, r4, #24
+	lsrs	r5, r5, #22
+	ldr		r5, [r2, r5]
+	eors	r0, r0, r5
+	b		loop
+
+	/* crc = (crc << 8) ^ t0[(crc >> 24) ^ byte] */
+byte:
+	ldrb	r4, [r3]
+	adds	r3, r3, #1
+	lsrs	r5, r0, #24
+	eors	r5, r5, r4
+	lsls	r5, r5, #2
+	ldr		r5, [r2, r5]
+	lsls	r0, r0, #8
+	eors	r0, r0, r5
+	b		loop
+
+done:
+	bkpt	#0
+
+	.align	2
+
+CRC32XOR:	.word	0x04c11db7
+
+	.end
@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+	Run length decompressor for the compressed memory writes.
+
+	A control byte below 0x80 is followed by as many literal bytes as its
+	value plus one, a control byte n from 0x80 by a byte repeated
+	n - 0x80 + 3 times.
+
+	parameters:
+	r0 - address of the compressed data
+	r1 - end address of the compressed data
+	r2 - destination address, returns the end of the data written
+*/
+
+	.text
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+	.thumb_func
+
+	.align	2
+
+start:
+	cmp	r0, r1
+	bhs	done
+
+	ldrb	r3, [r0]	/* control byte */
+	adds	r0, #1
+	cmp	r3, #0x80
+	bhs	repeat
+
+	adds	r3, #1
+literal_loop:
+	ldrb	r4, [r0]
+	adds	r0, #1
+	strb	r4, [r2]
+	adds	r2, #1
+	subs	r3, #1
+	bne	literal_loop
+	b	start
+
+repeat:
+	subs	r3, #(0x80 - 3)
+	ldrb	r4, [r0]
+	adds	r0, #1
+repeat_loop:
+	strb	r4, [r2]
+	adds	r2, #1
+	subs	r3, #1
+	bne	repeat_loop
+	b	start
+
+/* Avoid padding at .text segment end. Otherwise exit point check fails. */
+	.skip	( . - start + 2) & 2, 0
+
+done:
+	bkpt	#0
+
+	.end
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/* Accesses of the flash bus width, WIDTH in bits */
+
+#if WIDTH == 8
+# define LOAD	lbu
+# define STORE	sb
+#elif WIDTH == 16
+# define LOAD	lhu
+# define STORE	sh
+#elif WIDTH == 32
+# define LOAD	lw
+# define STORE	sw
+#else
+# error "WIDTH must be 8, 16 or 32"
+#endif
+
+#define STEP	(WIDTH / 8)
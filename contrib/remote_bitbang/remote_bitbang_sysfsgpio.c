@@ -25,6 +25,14 @@
   Or if you want to test UNIX sockets, run both on Raspberry Pi:
   socat UNIX-LISTEN:/tmp/remotebitbang-socket,fork EXEC:"sudo ./remote_bitbang_sysfsgpio tck 11 tms 25 tdo 9 tdi 10"
   openocd -c "interface remote_bitbang; remote_bitbang host /tmp/remotebitbang-socket" -f target/stm32f1x.cfg
+
+  Besides the ASCII protocol, this server implements the binary protocol
+  extension described in the OpenOCD manual: packed 'J' JTAG frames and,
+  when a swdio gpio is given (tck is then used as SWCLK), the 'W' and 'T'
+  SWD frames:
+  socat TCP6-LISTEN:7777,fork EXEC:"sudo ./remote_bitbang_sysfsgpio tck 11 swdio 25"
+  openocd -c "adapter driver remote_bitbang; transport select swd; remote_bitbang host raspberrypi" \
+	  -c "remote_bitbang port 7777" -f target/stm32f1x.cfg
 */
 
 #include <sys/types.h>
@@ -35,6 +43,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <stdint.h>
 
 #define LOG_ERROR(...)		do {					\
 		fprintf(stderr, __VA_ARGS__);				\
@@ -153,6 +162,12 @@ static int tdi_fd = -1;
 static int tdo_fd = -1;
 static int trst_fd = -1;
 static int srst_fd = -1;
+static int swdio_fd = -1;
+static int swdio_in_fd = -1;
+static int swdio_dir_fd = -1;
+
+/* Output levels cached by sysfsgpio_write(), invalid until its first call */
+static int write_cache_valid;
 
 /*
  * Bitbang interface read of TDO
@@ -191,14 +206,13 @@ static void sysfsgpio_write(int tck, int tms, int tdi)
 	static int last_tms;
 	static int last_tdi;
 
-	static int first_time;
 	size_t bytes_written;
 
-	if (!first_time) {
+	if (!write_cache_valid) {
 		last_tck = !tck;
 		last_tms = !tms;
 		last_tdi = !tdi;
-		first_time = 1;
+		write_cache_valid = 1;
 	}
 
 	if (tdi != last_tdi) {
@@ -258,6 +272,250 @@ static int tdi_gpio = -1;
 static int tdo_gpio = -1;
 static int trst_gpio = -1;
 static int srst_gpio = -1;
+static int swdio_gpio = -1;
+
+/* Capabilities reported in the reply to 'X' */
+#define CAP_JTAG	0x01
+#define CAP_SWD		0x02
+
+static int caps;
+
+static int read_bytes(unsigned char *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		int c = getchar();
+		if (c == EOF)
+			return ERROR_FAIL;
+		buf[i] = c;
+	}
+	return ERROR_OK;
+}
+
+/*
+ * 'J' len_lo len_hi flags tms[(len + 7) / 8] tdi[(len + 7) / 8]
+ *
+ * Clock len bits, for each one: TCK low with TMS and TDI set, sample TDO
+ * if bit 0 of flags is set, TCK high. The TDO samples are sent back packed
+ * in (len + 7) / 8 bytes, LSB first.
+ */
+static int process_jtag_frame(void)
+{
+	static unsigned char tms[8192], tdi[8192], tdo[8192];
+	unsigned char hdr[3];
+
+	if (read_bytes(hdr, sizeof(hdr)) != ERROR_OK)
+		return ERROR_FAIL;
+
+	unsigned int len = hdr[0] | hdr[1] << 8;
+	unsigned int bytes = (len + 7) / 8;
+	int capture = hdr[2] & 1;
+
+	if (read_bytes(tms, bytes) != ERROR_OK || read_bytes(tdi, bytes) != ERROR_OK)
+		return ERROR_FAIL;
+
+	memset(tdo, 0, bytes);
+	for (unsigned int i = 0; i < len; i++) {
+		int tms_bit = (tms[i / 8] >> (i % 8)) & 1;
+		int tdi_bit = (tdi[i / 8] >> (i % 8)) & 1;
+
+		sysfsgpio_write(0, tms_bit, tdi_bit);
+		if (capture && sysfsgpio_read() == '1')
+			tdo[i / 8] |= 1 << (i % 8);
+		sysfsgpio_write(1, tms_bit, tdi_bit);
+	}
+
+	if (capture && fwrite(tdo, 1, bytes, stdout) != bytes)
+		return ERROR_FAIL;
+
+	return ERROR_OK;
+}
+
+static void write_gpio(int fd, int value, const char *name)
+{
+	if (write(fd, value ? "1" : "0", 1) != 1)
+		LOG_WARNING("writing %s failed", name);
+}
+
+static void swd_drive(int on)
+{
+	static int driving = 1;
+
+	if (on == driving)
+		return;
+
+	const char *dir = on ? "out" : "in";
+	if (write(swdio_dir_fd, dir, strlen(dir)) < 0)
+		LOG_WARNING("setting swdio direction failed");
+	driving = on;
+}
+
+static void swd_bit_out(int bit)
+{
+	write_cache_valid = 0;
+	write_gpio(swdio_fd, bit, "swdio");
+	write_gpio(tck_fd, 0, "swclk");
+	write_gpio(tck_fd, 1, "swclk");
+}
+
+static int swd_bit_in(void)
+{
+	char buf[1];
+
+	write_cache_valid = 0;
+	write_gpio(tck_fd, 0, "swclk");
+	lseek(swdio_in_fd, 0, SEEK_SET);
+	if (read(swdio_in_fd, &buf, sizeof(buf)) != 1) {
+		LOG_WARNING("reading swdio failed");
+		buf[0] = '0';
+	}
+	write_gpio(tck_fd, 1, "swclk");
+
+	return buf[0] == '1';
+}
+
+static void swd_out(uint32_t value, unsigned int len)
+{
+	for (unsigned int i = 0; i < len; i++)
+		swd_bit_out((value >> i) & 1);
+}
+
+static uint32_t swd_in(unsigned int len)
+{
+	uint32_t value = 0;
+
+	for (unsigned int i = 0; i < len; i++)
+		value |= (uint32_t)swd_bit_in() << i;
+	return value;
+}
+
+static int parity_u32(uint32_t x)
+{
+	x ^= x >> 16;
+	x ^= x >> 8;
+	x ^= x >> 4;
+	x ^= x >> 2;
+	x ^= x >> 1;
+	return x & 1;
+}
+
+#define SWD_CMD_APNDP	0x02
+#define SWD_CMD_RNW	0x04
+#define SWD_ACK_OK	0x1
+#define SWD_ACK_WAIT	0x2
+/* write DP ABORT, with start and park bits */
+#define SWD_CMD_DP_ABORT_WRITE	0x81
+#define SWD_ABORT_CLEAR_ALL	0x1e
+#define SWD_WAIT_RETRIES	100
+
+/* One SWD transaction, returns the ack and the parity check for reads */
+static int swd_transfer(unsigned char cmd, uint32_t *data)
+{
+	int ack;
+
+	swd_out(cmd, 8);
+	swd_drive(0);
+	swd_in(1);
+	ack = swd_in(3);
+
+	if (cmd & SWD_CMD_RNW) {
+		*data = swd_in(32);
+		int parity = swd_in(1);
+		swd_in(1);
+		swd_drive(1);
+		if (parity != parity_u32(*data))
+			ack |= 0x8;
+	} else {
+		swd_in(1);
+		swd_drive(1);
+		swd_out(*data, 32);
+		swd_out(parity_u32(*data), 1);
+	}
+
+	return ack;
+}
+
+/*
+ * 'T' flags cmd [data_le32, for writes] delay_le16
+ *
+ * Run one SWD transaction. If bit 0 of flags is set, WAIT acks are retried
+ * after clearing the sticky errors. After an OK transaction, delay idle
+ * cycles are clocked. The reply is one byte, ack in bits 0 to 2 and read
+ * parity error in bit 3, followed for reads by the data, little endian.
+ */
+static int process_swd_transaction(void)
+{
+	unsigned char buf[6];
+
+	if (read_bytes(buf, 2) != ERROR_OK)
+		return ERROR_FAIL;
+
+	int check_ack = buf[0] & 1;
+	unsigned char cmd = buf[1];
+	int rnw = cmd & SWD_CMD_RNW;
+
+	if (read_bytes(buf, rnw ? 2 : 6) != ERROR_OK)
+		return ERROR_FAIL;
+
+	uint32_t data = 0;
+	unsigned int delay;
+	if (rnw) {
+		delay = buf[0] | buf[1] << 8;
+	} else {
+		data = buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+		delay = buf[4] | buf[5] << 8;
+	}
+
+	int ack;
+	for (int retry = 0; ; retry++) {
+		uint32_t value = data;
+		ack = swd_transfer(cmd, &value);
+		if (check_ack && (ack & 0x7) == SWD_ACK_WAIT && retry < SWD_WAIT_RETRIES) {
+			uint32_t abort_value = SWD_ABORT_CLEAR_ALL;
+			swd_transfer(SWD_CMD_DP_ABORT_WRITE, &abort_value);
+			continue;
+		}
+		data = value;
+		break;
+	}
+
+	if ((ack & 0x7) == SWD_ACK_OK || !check_ack)
+		for (unsigned int i = 0; i < delay; i++)
+			swd_bit_out(0);
+
+	buf[0] = ack;
+	buf[1] = data;
+	buf[2] = data >> 8;
+	buf[3] = data >> 16;
+	buf[4] = data >> 24;
+	if (fwrite(buf, 1, rnw ? 5 : 1, stdout) != (rnw ? 5u : 1u))
+		return ERROR_FAIL;
+
+	return ERROR_OK;
+}
+
+/*
+ * 'W' len_lo len_hi data[(len + 7) / 8]
+ *
+ * Clock len bits out on SWDIO, LSB first.
+ */
+static int process_swd_sequence(void)
+{
+	unsigned char hdr[2];
+	unsigned char data[8192];
+
+	if (read_bytes(hdr, sizeof(hdr)) != ERROR_OK)
+		return ERROR_FAIL;
+
+	unsigned int len = hdr[0] | hdr[1] << 8;
+	if (read_bytes(data, (len + 7) / 8) != ERROR_OK)
+		return ERROR_FAIL;
+
+	swd_drive(1);
+	for (unsigned int i = 0; i < len; i++)
+		swd_bit_out((data[i / 8] >> (i % 8)) & 1);
+
+	return ERROR_OK;
+}
 
 /* helper func to close and cleanup files only if they were valid/ used */
 static void cleanup_fd(int fd, int gpio)
@@ -278,6 +536,11 @@ static void cleanup_all_fds(void)
 	cleanup_fd(tdo_fd, tdo_gpio);
 	cleanup_fd(trst_fd, trst_gpio);
 	cleanup_fd(srst_fd, srst_gpio);
+	if (swdio_in_fd >= 0)
+		close(swdio_in_fd);
+	if (swdio_dir_fd >= 0)
+		close(swdio_dir_fd);
+	cleanup_fd(swdio_fd, swdio_gpio);
 }
 
 static void process_remote_protocol(void)
@@ -298,10 +561,23 @@ static void process_remote_protocol(void)
 			sysfsgpio_write(!!(d & 4),
 					!!(d & 2),
 					(d & 1));
-		} else if (c == 'R')
+		} else if (c == 'R') {
 			putchar(sysfsgpio_read());
-		else
+		} else if (c == 'X') { /* Protocol extension query */
+			putchar('X');
+			putchar(caps);
+		} else if (c == 'J' && (caps & CAP_JTAG)) {
+			if (process_jtag_frame() != ERROR_OK)
+				break;
+		} else if (c == 'W' && (caps & CAP_SWD)) {
+			if (process_swd_sequence() != ERROR_OK)
+				break;
+		} else if (c == 'T' && (caps & CAP_SWD)) {
+			if (process_swd_transaction() != ERROR_OK)
+				break;
+		} else {
 			LOG_ERROR("Unknown command '%c' received", c);
+		}
 	}
 }
 
@@ -322,13 +598,19 @@ int main(int argc, char *argv[])
 			trst_gpio = atoi(argv[++i]);
 		else if (!strcmp(argv[i], "srst"))
 			srst_gpio = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "swdio"))
+			swdio_gpio = atoi(argv[++i]);
 		else {
-			LOG_ERROR("Usage:\n%s ((tck|tms|tdo|tdi|trst|srst) num)*", argv[0]);
+			LOG_ERROR("Usage:\n%s ((tck|tms|tdo|tdi|trst|srst|swdio) num)*", argv[0]);
 			return -1;
 		}
 	}
 
-	if (!(is_gpio_valid(tck_gpio)
+	if (is_gpio_valid(tck_gpio) && is_gpio_valid(swdio_gpio)
+			&& !is_gpio_valid(tms_gpio) && !is_gpio_valid(tdi_gpio)
+			&& !is_gpio_valid(tdo_gpio)) {
+		/* SWD only */
+	} else if (!(is_gpio_valid(tck_gpio)
 			&& is_gpio_valid(tms_gpio)
 			&& is_gpio_valid(tdi_gpio)
 			&& is_gpio_valid(tdo_gpio))) {
@@ -353,17 +635,41 @@ int main(int argc, char *argv[])
 	if (tck_fd < 0)
 		goto out_error;
 
-	tms_fd = setup_sysfs_gpio(tms_gpio, 1, 1);
-	if (tms_fd < 0)
-		goto out_error;
+	if (is_gpio_valid(tms_gpio)) {
+		tms_fd = setup_sysfs_gpio(tms_gpio, 1, 1);
+		if (tms_fd < 0)
+			goto out_error;
 
-	tdi_fd = setup_sysfs_gpio(tdi_gpio, 1, 0);
-	if (tdi_fd < 0)
-		goto out_error;
+		tdi_fd = setup_sysfs_gpio(tdi_gpio, 1, 0);
+		if (tdi_fd < 0)
+			goto out_error;
 
-	tdo_fd = setup_sysfs_gpio(tdo_gpio, 0, 0);
-	if (tdo_fd < 0)
-		goto out_error;
+		tdo_fd = setup_sysfs_gpio(tdo_gpio, 0, 0);
+		if (tdo_fd < 0)
+			goto out_error;
+
+		caps |= CAP_JTAG;
+	}
+
+	if (is_gpio_valid(swdio_gpio)) {
+		char buf[40];
+
+		swdio_fd = setup_sysfs_gpio(swdio_gpio, 1, 1);
+		if (swdio_fd < 0)
+			goto out_error;
+
+		snprintf(buf, sizeof(buf), "/sys/class/gpio/gpio%d/value", swdio_gpio);
+		swdio_in_fd = open(buf, O_RDONLY | O_NONBLOCK | O_SYNC);
+		if (swdio_in_fd < 0)
+			goto out_error;
+
+		snprintf(buf, sizeof(buf), "/sys/class/gpio/gpio%d/direction", swdio_gpio);
+		swdio_dir_fd = open(buf, O_WRONLY);
+		if (swdio_dir_fd < 0)
+			goto out_error;
+
+		caps |= CAP_SWD;
+	}
 
 	/* assume active low */
 	if (trst_gpio > 0) {
@@ -383,6 +689,7 @@ int main(int argc, char *argv[])
 		 tck_gpio, tms_gpio, tdi_gpio, tdo_gpio);
 	LOG_WARNING("SysfsGPIO num: srst = %d", srst_gpio);
 	LOG_WARNING("SysfsGPIO num: trst = %d", trst_gpio);
+	LOG_WARNING("SysfsGPIO num: swdio = %d", swdio_gpio);
 
 	setvbuf(stdout, NULL, _IONBF, 0);
 	process_remote_protocol();
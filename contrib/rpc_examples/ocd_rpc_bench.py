@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+"""
+Measure how many commands per second OpenOCD runs through the Tcl RPC port.
+
+The command is run COUNT times with one round trip each, then COUNT times
+from a single Tcl loop, which leaves out the network and shows the cost of
+the command dispatch itself.
+
+usage: ocd_rpc_bench.py [-H host] [-p port] [-n count] [command]
+
+Example:
+./ocd_rpc_bench.py -n 20000 "mdw 0x20000000"
+"""
+
+import argparse
+import socket
+import time
+
+COMMAND_TOKEN = b'\x1a'
+
+
+class OpenOcd:
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port))
+        self.buffer = bytes()
+
+    def close(self):
+        self.sock.close()
+
+    def send(self, cmd):
+        self.sock.sendall(cmd.encode('utf-8') + COMMAND_TOKEN)
+        while COMMAND_TOKEN not in self.buffer:
+            chunk = self.sock.recv(65536)
+            if not chunk:
+                raise OSError('connection closed by OpenOCD')
+            self.buffer += chunk
+        reply, _, self.buffer = self.buffer.partition(COMMAND_TOKEN)
+        return reply.decode('utf-8', errors='replace')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='OpenOCD Tcl RPC command rate')
+    parser.add_argument('-H', '--host', default='127.0.0.1')
+    parser.add_argument('-p', '--port', type=int, default=6666)
+    parser.add_argument('-n', '--count', type=int, default=10000)
+    parser.add_argument('command', nargs='?', default='version')
+    args = parser.parse_args()
+
+    ocd = OpenOcd(args.host, args.port)
+    try:
+        print('reply: %s' % ocd.send(args.command).strip())
+
+        start = time.monotonic()
+        for _ in range(args.count):
+            ocd.send(args.command)
+        elapsed = time.monotonic() - start
+        print('round trips: %d commands in %.3f s, %.0f commands/s'
+              % (args.count, elapsed, args.count / elapsed))
+
+        script = 'for {set i 0} {$i < %d} {incr i} {%s}' % (args.count, args.command)
+        start = time.monotonic()
+        ocd.send(script)
+        elapsed = time.monotonic() - start
+        print('Tcl loop:    %d commands in %.3f s, %.0f commands/s'
+              % (args.count, elapsed, args.count / elapsed))
+    finally:
+        ocd.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -87,7 +87,7 @@ int arm_nandwrite(struct arm_nand_data *nand, uint8_t *data, int size)
 	struct reg_param reg_params[3];
 	uint32_t target_buf;
 	uint32_t exit_var = 0;
-	int retval;
+	int retval = ERROR_OK;
 
 	/* Inputs:
 	 *  r0	NAND data address (byte wide)
@@ -145,31 +145,41 @@ int arm_nandwrite(struct arm_nand_data *nand, uint8_t *data, int size)
 	}
 
 	nand->op = ARM_NAND_WRITE;
-
-	/* copy data to work area */
 	target_buf = nand->copy_area->address + target_code_size;
-	retval = target_write_buffer(target, target_buf, size, data);
-	if (retval != ERROR_OK)
-		return retval;
 
 	/* set up parameters */
 	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN);
 	init_reg_param(&reg_params[1], "r1", 32, PARAM_IN);
 	init_reg_param(&reg_params[2], "r2", 32, PARAM_IN);
 
-	buf_set_u32(reg_params[0].value, 0, 32, nand->data);
-	buf_set_u32(reg_params[1].value, 0, 32, target_buf);
-	buf_set_u32(reg_params[2].value, 0, 32, size);
-
 	/* armv4 must exit using a hardware breakpoint */
 	if (arm->arch == ARM_ARCH_V4)
 		exit_var = nand->copy_area->address + target_code_size - 4;
 
-	/* use alg to write data from work area to NAND chip */
-	retval = target_run_algorithm(target, 0, NULL, 3, reg_params,
-			nand->copy_area->address, exit_var, 1000, arm_algo);
-	if (retval != ERROR_OK)
-		LOG_ERROR("error executing hosted NAND write");
+	/* the copy area holds a chunk, e.g. the page and its OOB */
+	while (size > 0) {
+		int thisrun = MIN(size, (int)nand->chunk_size);
+
+		/* copy data to work area */
+		retval = target_write_buffer(target, target_buf, thisrun, data);
+		if (retval != ERROR_OK)
+			break;
+
+		buf_set_u32(reg_params[0].value, 0, 32, nand->data);
+		buf_set_u32(reg_params[1].value, 0, 32, target_buf);
+		buf_set_u32(reg_params[2].value, 0, 32, thisrun);
+
+		/* use alg to write data from work area to NAND chip */
+		retval = target_run_algorithm(target, 0, NULL, 3, reg_params,
+				nand->copy_area->address, exit_var, 1000, arm_algo);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("error executing hosted NAND write");
+			break;
+		}
+
+		data += thisrun;
+		size -= thisrun;
+	}
 
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
@@ -197,7 +207,7 @@ int arm_nandread(struct arm_nand_data *nand, uint8_t *data, uint32_t size)
 	struct reg_param reg_params[3];
 	uint32_t target_buf;
 	uint32_t exit_var = 0;
-	int retval;
+	int retval = ERROR_OK;
 
 	/* Inputs:
 	 *  r0	buffer address
@@ -263,26 +273,38 @@ int arm_nandread(struct arm_nand_data *nand, uint8_t *data, uint32_t size)
 	init_reg_param(&reg_params[1], "r1", 32, PARAM_IN);
 	init_reg_param(&reg_params[2], "r2", 32, PARAM_IN);
 
-	buf_set_u32(reg_params[0].value, 0, 32, target_buf);
-	buf_set_u32(reg_params[1].value, 0, 32, nand->data);
-	buf_set_u32(reg_params[2].value, 0, 32, size);
-
 	/* armv4 must exit using a hardware breakpoint */
 	if (arm->arch == ARM_ARCH_V4)
 		exit_var = nand->copy_area->address + target_code_size - 4;
 
-	/* use alg to write data from NAND chip to work area */
-	retval = target_run_algorithm(target, 0, NULL, 3, reg_params,
-			nand->copy_area->address, exit_var, 1000, arm_algo);
-	if (retval != ERROR_OK)
-		LOG_ERROR("error executing hosted NAND read");
+	/* the copy area holds a chunk, e.g. the page and its OOB */
+	while (size > 0) {
+		uint32_t thisrun = MIN(size, nand->chunk_size);
+
+		buf_set_u32(reg_params[0].value, 0, 32, target_buf);
+		buf_set_u32(reg_params[1].value, 0, 32, nand->data);
+		buf_set_u32(reg_params[2].value, 0, 32, thisrun);
+
+		/* use alg to write data from NAND chip to work area */
+		retval = target_run_algorithm(target, 0, NULL, 3, reg_params,
+				nand->copy_area->address, exit_var, 1000, arm_algo);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("error executing hosted NAND read");
+			break;
+		}
+
+		/* read from work area to the host's memory */
+		retval = target_read_buffer(target, target_buf, thisrun, data);
+		if (retval != ERROR_OK)
+			break;
+
+		data += thisrun;
+		size -= thisrun;
+	}
 
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
 	destroy_reg_param(&reg_params[2]);
 
-	/* read from work area to the host's memory */
-	retval = target_read_buffer(target, target_buf, size, data);
-
 	return retval;
 }
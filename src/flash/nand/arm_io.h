@@ -26,7 +26,7 @@ struct arm_nand_data {
 	/** The copy area holds code loop and data for I/O operations. */
 	struct working_area *copy_area;
 
-	/** The chunk size is the page size or ECC chunk. */
+	/** The chunk size is the page size and its OOB, or the ECC chunk. */
 	unsigned chunk_size;
 
 	/** Where data is read from or written to. */
@@ -255,7 +255,7 @@ static int at91sam9_read_block_data(struct nand_device *nand, uint8_t *data, int
 	if (!at91sam9_halted(nand->target, "read block"))
 		return ERROR_NAND_OPERATION_FAILED;
 
-	io->chunk_size = nand->page_size;
+	io->chunk_size = nand->page_size + nand_page_oob_size(nand);
 	status = arm_nandread(io, data, size);
 
 	return status;
@@ -279,7 +279,7 @@ static int at91sam9_write_block_data(struct nand_device *nand, uint8_t *data, in
 	if (!at91sam9_halted(nand->target, "write block"))
 		return ERROR_NAND_OPERATION_FAILED;
 
-	io->chunk_size = nand->page_size;
+	io->chunk_size = nand->page_size + nand_page_oob_size(nand);
 	status = arm_nandwrite(io, data, size);
 
 	return status;
@@ -785,6 +785,18 @@ int nand_read_page_raw(struct nand_device *nand, uint32_t page,
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* the OOB follows the page, read both in a single block transfer */
+	if (data && oob && data_size == (uint32_t)nand->page_size) {
+		uint8_t *buf = malloc(data_size + oob_size);
+		if (buf) {
+			retval = nand_read_data_page(nand, buf, data_size + oob_size);
+			memcpy(data, buf, data_size);
+			memcpy(oob, buf + data_size, oob_size);
+			free(buf);
+			return retval;
+		}
+	}
+
 	if (data)
 		nand_read_data_page(nand, data, data_size);
 
@@ -862,6 +874,22 @@ int nand_write_page_raw(struct nand_device *nand, uint32_t page,
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* the OOB follows the page, write both in a single block transfer */
+	if (data && oob && data_size == (uint32_t)nand->page_size) {
+		uint8_t *buf = malloc(data_size + oob_size);
+		if (buf) {
+			memcpy(buf, data, data_size);
+			memcpy(buf + data_size, oob, oob_size);
+			retval = nand_write_data_page(nand, buf, data_size + oob_size);
+			free(buf);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("Unable to write data to NAND device");
+				return retval;
+			}
+			return nand_write_finish(nand);
+		}
+	}
+
 	if (data) {
 		retval = nand_write_data_page(nand, data, data_size);
 		if (retval != ERROR_OK) {
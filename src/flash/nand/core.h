@@ -182,6 +182,12 @@ enum oob_formats {
 
 struct nand_device *get_nand_device_by_num(int num);
 
+/* the spare area of the small and large page devices, 16 or 64 bytes */
+static inline uint32_t nand_page_oob_size(struct nand_device *nand)
+{
+	return nand->page_size / 32;
+}
+
 int nand_page_command(struct nand_device *nand, uint32_t page,
 		      uint8_t cmd, bool oob_only);
 
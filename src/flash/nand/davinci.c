@@ -280,7 +280,7 @@ static int davinci_write_page(struct nand_device *nand, uint32_t page,
 	 * use 512 byte chunks.  Read side support will often want
 	 * to include oob_size ...
 	 */
-	info->io.chunk_size = nand->page_size;
+	info->io.chunk_size = nand->page_size + nand_page_oob_size(nand);
 
 	status = info->write_page(nand, page, data, data_size, oob, oob_size);
 	free(ooballoc);
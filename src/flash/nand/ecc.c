@@ -4,9 +4,9 @@
  * This file contains an ECC algorithm from Toshiba that allows for detection
  * and correction of 1-bit errors in a 256 byte block of data.
  *
- * [ Extracted from the initial code found in some early Linux versions.
- *   The current Linux code is bigger while being faster, but this is of
- *   no real benefit when the bottleneck largely remains the JTAG link.  ]
+ * [ Extracted from the initial code found in some early Linux versions,
+ *   and since reworked to compute the parities 64 bits at a time, as the
+ *   ECC of the whole image is computed when writing big NAND images.   ]
  *
  * Copyright (C) 2000-2004 Steven J. Hill (sjhill at realitydiluted.com)
  *                         Toshiba America Electronics Components, Inc.
@@ -44,28 +44,44 @@ static const uint8_t nand_ecc_precalc_table[] = {
 
 /*
  * nand_calculate_ecc - Calculate 3-byte ECC for 256-byte block
+ *
+ * The parities are linear, so they're computed on 64 bit words: the column
+ * parity is the one of the XOR of all the words, and the line parity bit n
+ * the parity of the bytes whose index has bit n set. Bits 0..2 of the index
+ * are the byte in the word, bits 3..7 the index of the word, whose parities
+ * are gathered in a bitmap.
  */
 int nand_calculate_ecc(struct nand_device *nand, const uint8_t *dat, uint8_t *ecc_code)
 {
-	uint8_t idx, reg1, reg2, reg3, tmp1, tmp2;
-	int i;
-
-	/* Initialize variables */
-	reg1 = reg2 = reg3 = 0;
-
-	/* Build up column parity */
-	for (i = 0; i < 256; i++) {
-		/* Get CP0 - CP5 from table */
-		idx = nand_ecc_precalc_table[*dat++];
-		reg1 ^= (idx & 0x3f);
-
-		/* All bit XOR = 1 ? */
-		if (idx & 0x40) {
-			reg3 ^= (uint8_t) i;
-			reg2 ^= ~((uint8_t) i);
-		}
+	uint8_t reg1, reg2, reg3, tmp1, tmp2;
+	uint64_t all = 0;
+	uint32_t odd = 0;
+
+	for (unsigned int i = 0; i < 32; i++) {
+		uint64_t w = le_to_h_u64(dat + 8 * i);
+
+		all ^= w;
+		odd |= (uint32_t)__builtin_parityll(w) << i;
 	}
 
+	reg3 = __builtin_parityll(all & 0xff00ff00ff00ff00ull) << 0;
+	reg3 |= __builtin_parityll(all & 0xffff0000ffff0000ull) << 1;
+	reg3 |= __builtin_parityll(all & 0xffffffff00000000ull) << 2;
+	reg3 |= __builtin_parity(odd & 0xaaaaaaaa) << 3;
+	reg3 |= __builtin_parity(odd & 0xcccccccc) << 4;
+	reg3 |= __builtin_parity(odd & 0xf0f0f0f0) << 5;
+	reg3 |= __builtin_parity(odd & 0xff00ff00) << 6;
+	reg3 |= __builtin_parity(odd & 0xffff0000) << 7;
+
+	/* the line parity of the inverted indices, when an odd number of bytes have odd parity */
+	reg2 = __builtin_parityll(all) ? ~reg3 : reg3;
+
+	/* Get CP0 - CP5 from table, of the XOR of all the bytes */
+	all ^= all >> 32;
+	all ^= all >> 16;
+	all ^= all >> 8;
+	reg1 = nand_ecc_precalc_table[all & 0xff] & 0x3f;
+
 	/* Create non-inverted ECC code from line parity */
 	tmp1  = (reg3 & 0x80) >> 0; /* B7 -> B7 */
 	tmp1 |= (reg2 & 0x80) >> 1; /* B7 -> B6 */
@@ -98,15 +114,6 @@ int nand_calculate_ecc(struct nand_device *nand, const uint8_t *dat, uint8_t *ec
 	return 0;
 }
 
-static inline int countbits(uint32_t b)
-{
-	int res = 0;
-
-	for (; b; b >>= 1)
-		res += b & 0x01;
-	return res;
-}
-
 /**
  * nand_correct_data - Detect and correct a 1 bit error for 256 byte block
  */
@@ -153,7 +160,7 @@ int nand_correct_data(struct nand_device *nand, u_char *dat,
 		return 1;
 	}
 
-	if (countbits(s0 | ((uint32_t)s1 << 8) | ((uint32_t)s2 << 16)) == 1)
+	if (__builtin_popcount(s0 | ((uint32_t)s1 << 8) | ((uint32_t)s2 << 16)) == 1)
 		return 1;
 
 	return -1;
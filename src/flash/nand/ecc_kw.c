@@ -36,6 +36,13 @@ static uint16_t gf_exp[1023 + 1023];
  */
 static uint16_t gf_log[1024];
 
+/*
+ * Maps the symbol r7 shifted out of the residue to the 8 multiples
+ * r7 * g_i of the coefficients of the generator polynomial, so that a
+ * step of the division is a single lookup, without branch.
+ */
+static uint16_t gf_gen[1024][8];
+
 static void gf_build_log_exp_table(void)
 {
 	int i;
@@ -62,6 +69,18 @@ static void gf_build_log_exp_table(void)
 	}
 }
 
+static void gf_build_gen_table(void)
+{
+	/* the generator polynomial, as the logs of its coefficients */
+	static const uint16_t gen_log[8] = {
+		0x21c, 0x181, 0x18e, 0x25f, 0x197, 0x193, 0x237, 0x024,
+	};
+
+	for (unsigned int r = 1; r < 1024; r++)
+		for (unsigned int i = 0; i < 8; i++)
+			gf_gen[r][i] = gf_exp[gf_log[r] + gen_log[i]];
+}
+
 
 /*****************************************************************************
  * Reed-Solomon code
@@ -98,6 +117,7 @@ int nand_calculate_ecc_kw(struct nand_device *nand, const uint8_t *data, uint8_t
 
 	if (!tables_initialized) {
 		gf_build_log_exp_table();
+		gf_build_gen_table();
 		tables_initialized = 1;
 	}
 
@@ -119,33 +139,17 @@ int nand_calculate_ecc_kw(struct nand_device *nand, const uint8_t *data, uint8_t
 	 * generator polynomial in every step.
 	 */
 	for (i = 503; i >= -8; i--) {
-		unsigned int d;
-
-		d = 0;
-		if (i >= 0)
-			d = data[i];
-
-		if (r7) {
-			uint16_t *t = gf_exp + gf_log[r7];
-
-			r7 = r6 ^ t[0x21c];
-			r6 = r5 ^ t[0x181];
-			r5 = r4 ^ t[0x18e];
-			r4 = r3 ^ t[0x25f];
-			r3 = r2 ^ t[0x197];
-			r2 = r1 ^ t[0x193];
-			r1 = r0 ^ t[0x237];
-			r0 = d  ^ t[0x024];
-		} else {
-			r7 = r6;
-			r6 = r5;
-			r5 = r4;
-			r4 = r3;
-			r3 = r2;
-			r2 = r1;
-			r1 = r0;
-			r0 = d;
-		}
+		const uint16_t *t = gf_gen[r7];
+		unsigned int d = i >= 0 ? data[i] : 0;
+
+		r7 = r6 ^ t[0];
+		r6 = r5 ^ t[1];
+		r5 = r4 ^ t[2];
+		r4 = r3 ^ t[3];
+		r3 = r2 ^ t[4];
+		r2 = r1 ^ t[5];
+		r1 = r0 ^ t[6];
+		r0 = d  ^ t[7];
 	}
 
 	ecc[0] = r0;
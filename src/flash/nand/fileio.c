@@ -13,6 +13,7 @@
 #endif
 
 #include "core.h"
+#include "imp.h"
 #include "fileio.h"
 
 static struct nand_ecclayout nand_oob_16 = {
@@ -136,6 +137,8 @@ COMMAND_HELPER(nand_fileio_parse_args, struct nand_fileio_state *state,
 				state->oob_format |= NAND_OOB_RAW;
 			else if (!strcmp(CMD_ARGV[i], "oob_only"))
 				state->oob_format |= NAND_OOB_RAW | NAND_OOB_ONLY;
+			else if (!strcmp(CMD_ARGV[i], "skip_bad"))
+				state->skip_bad = true;
 			else if (sw_ecc && !strcmp(CMD_ARGV[i], "oob_softecc"))
 				state->oob_format |= NAND_OOB_SW_ECC;
 			else if (sw_ecc && !strcmp(CMD_ARGV[i], "oob_softecc_kw"))
@@ -210,3 +213,35 @@ int nand_fileio_read(struct nand_device *nand, struct nand_fileio_state *s)
 	}
 	return total_read;
 }
+
+/**
+ * Moves @a address, at the start of a block, past the blocks marked bad
+ * when they are skipped. The marker of a block not checked yet is read.
+ */
+int nand_fileio_skip_bad(struct nand_device *nand, struct nand_fileio_state *s,
+	uint32_t *address)
+{
+	if (!s->skip_bad || *address % nand->erase_size)
+		return ERROR_OK;
+
+	for (;;) {
+		int block = *address / nand->erase_size;
+
+		if (block >= nand->num_blocks) {
+			LOG_ERROR("no good block left in the NAND flash");
+			return ERROR_NAND_OPERATION_FAILED;
+		}
+
+		if (nand->blocks[block].is_bad == -1) {
+			int retval = nand_build_bbt(nand, block, block);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		if (nand->blocks[block].is_bad != 1)
+			return ERROR_OK;
+
+		LOG_INFO("skipping bad block %d", block);
+		*address += nand->erase_size;
+	}
+}
@@ -96,7 +96,7 @@ static int nuc910_nand_read_block_data(struct nand_device *nand,
 	if (result != ERROR_OK)
 		return result;
 
-	nuc910_nand->io.chunk_size = nand->page_size;
+	nuc910_nand->io.chunk_size = nand->page_size + nand_page_oob_size(nand);
 
 	/* try the fast way first */
 	result = arm_nandread(&nuc910_nand->io, data, data_size);
@@ -120,7 +120,7 @@ static int nuc910_nand_write_block_data(struct nand_device *nand,
 	if (result != ERROR_OK)
 		return result;
 
-	nuc910_nand->io.chunk_size = nand->page_size;
+	nuc910_nand->io.chunk_size = nand->page_size + nand_page_oob_size(nand);
 
 	/* try the fast way first */
 	result = arm_nandwrite(&nuc910_nand->io, data, data_size);
@@ -85,7 +85,7 @@ static int orion_nand_fast_block_write(struct nand_device *nand, uint8_t *data,
 	struct orion_nand_controller *hw = nand->controller_priv;
 	int retval;
 
-	hw->io.chunk_size = nand->page_size;
+	hw->io.chunk_size = nand->page_size + nand_page_oob_size(nand);
 
 	retval = arm_nandwrite(&hw->io, data, size);
 	if (retval == ERROR_NAND_NO_BUFFER)
@@ -240,6 +240,12 @@ COMMAND_HANDLER(handle_nand_write_command)
 
 	uint32_t total_bytes = s.size;
 	while (s.size > 0) {
+		retval = nand_fileio_skip_bad(nand, &s, &s.address);
+		if (retval != ERROR_OK) {
+			nand_fileio_cleanup(&s);
+			return retval;
+		}
+
 		int bytes_read = nand_fileio_read(nand, &s);
 		if (bytes_read <= 0) {
 			command_print(CMD, "error while reading file");
@@ -288,6 +294,13 @@ COMMAND_HANDLER(handle_nand_verify_command)
 		return retval;
 
 	while (file.size > 0) {
+		retval = nand_fileio_skip_bad(nand, &file, &dev.address);
+		if (retval != ERROR_OK) {
+			nand_fileio_cleanup(&dev);
+			nand_fileio_cleanup(&file);
+			return retval;
+		}
+
 		retval = nand_read_page(nand, dev.address / dev.page_size,
 				dev.page, dev.page_size, dev.oob, dev.oob_size);
 		if (retval != ERROR_OK) {
@@ -340,6 +353,13 @@ COMMAND_HANDLER(handle_nand_dump_command)
 
 	while (s.size > 0) {
 		size_t size_written;
+
+		retval = nand_fileio_skip_bad(nand, &s, &s.address);
+		if (retval != ERROR_OK) {
+			nand_fileio_cleanup(&s);
+			return retval;
+		}
+
 		retval = nand_read_page(nand, s.address / nand->page_size,
 				s.page, s.page_size, s.oob, s.oob_size);
 		if (retval != ERROR_OK) {
@@ -435,7 +455,7 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.handler = handle_nand_dump_command,
 		.mode = COMMAND_EXEC,
 		.usage = "bank_id filename offset length "
-			"['oob_raw'|'oob_only']",
+			"['oob_raw'|'oob_only'] ['skip_bad']",
 		.help = "dump from NAND flash device",
 	},
 	{
@@ -443,7 +463,8 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.handler = handle_nand_verify_command,
 		.mode = COMMAND_EXEC,
 		.usage = "bank_id filename offset "
-			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw']",
+			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw'] "
+			"['skip_bad']",
 		.help = "verify NAND flash device",
 	},
 	{
@@ -451,7 +472,8 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.handler = handle_nand_write_command,
 		.mode = COMMAND_EXEC,
 		.usage = "bank_id filename offset "
-			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw']",
+			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw'] "
+			"['skip_bad']",
 		.help = "write to NAND flash device",
 	},
 	{
@@ -786,12 +786,7 @@ static int ath79_probe(struct flash_bank *bank)
 	if (retval != ERROR_OK)
 		return retval;
 
-	ath79_info->dev = NULL;
-	for (const struct flash_device *p = flash_devices; p->name; p++)
-		if (p->device_id == id) {
-			ath79_info->dev = p;
-			break;
-		}
+	ath79_info->dev = spi_flash_device_by_id(id);
 
 	if (!ath79_info->dev) {
 		LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
@@ -20,7 +20,9 @@
 #include <target/arm7_9_common.h>
 #include <target/armv7m.h>
 #include <target/mips32.h>
+#include <target/riscv/riscv.h>
 #include <helper/binarybuffer.h>
+#include <helper/time_support.h>
 #include <target/algorithm.h>
 
 /* defines internal maximum size for code fragment in cfi_intel_write_block() */
@@ -309,18 +311,24 @@ static void cfi_intel_clear_status_register(struct flash_bank *bank)
 	cfi_send_command(bank, 0x50, cfi_flash_address(bank, 0, 0x0));
 }
 
+/* Poll the status back to back for that long, the word and buffer programs
+ * are usually done by then, then once per ms in the erases */
+#define CFI_BUSY_SPIN_MS	2
+
+static void cfi_busy_wait(int64_t start)
+{
+	if (timeval_ms() - start >= CFI_BUSY_SPIN_MS)
+		alive_sleep(1);
+}
+
 static int cfi_intel_wait_status_busy(struct flash_bank *bank, int timeout, uint8_t *val)
 {
+	int64_t start = timeval_ms();
 	uint8_t status;
 
 	int retval = ERROR_OK;
 
 	for (;; ) {
-		if (timeout-- < 0) {
-			LOG_ERROR("timeout while waiting for WSM to become ready");
-			return ERROR_FAIL;
-		}
-
 		retval = cfi_get_u8(bank, 0, 0x0, &status);
 		if (retval != ERROR_OK)
 			return retval;
@@ -328,7 +336,12 @@ static int cfi_intel_wait_status_busy(struct flash_bank *bank, int timeout, uint
 		if (status & 0x80)
 			break;
 
-		alive_sleep(1);
+		if (timeval_ms() - start > timeout) {
+			LOG_ERROR("timeout while waiting for WSM to become ready");
+			return ERROR_FAIL;
+		}
+
+		cfi_busy_wait(start);
 	}
 
 	/* mask out bit 0 (reserved) */
@@ -362,6 +375,7 @@ static int cfi_intel_wait_status_busy(struct flash_bank *bank, int timeout, uint
 
 int cfi_spansion_wait_status_busy(struct flash_bank *bank, int timeout)
 {
+	int64_t start = timeval_ms();
 	uint8_t status, oldstatus;
 	struct cfi_flash_bank *cfi_info = bank->driver_priv;
 	int retval;
@@ -398,8 +412,8 @@ int cfi_spansion_wait_status_busy(struct flash_bank *bank, int timeout)
 		}
 
 		oldstatus = status;
-		alive_sleep(1);
-	} while (timeout-- > 0);
+		cfi_busy_wait(start);
+	} while (timeval_ms() - start <= timeout);
 
 	LOG_ERROR("timeout, status: 0x%x", status);
 
@@ -1113,6 +1127,153 @@ static uint32_t cfi_command_val(struct flash_bank *bank, uint8_t cmd)
 	}
 }
 
+/* Word programming on RISC-V targets, of both command sets */
+static int cfi_riscv_write_block(struct flash_bank *bank, const uint8_t *buffer,
+	uint32_t address, uint32_t count)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	struct target *target = bank->target;
+	struct working_area *write_algorithm;
+	struct working_area *source;
+	uint32_t buffer_size = 32768;
+	bool intel = cfi_info->pri_id != 2;
+	int retval;
+
+	/* see contrib/loaders/flash/cfi/riscv_cfi_*.S for src */
+	static const uint8_t riscv_cfi_intel_8[] = {
+#include "../../../contrib/loaders/flash/cfi/riscv_cfi_intel_8.inc"
+	};
+	static const uint8_t riscv_cfi_intel_16[] = {
+#include "../../../contrib/loaders/flash/cfi/riscv_cfi_intel_16.inc"
+	};
+	static const uint8_t riscv_cfi_intel_32[] = {
+#include "../../../contrib/loaders/flash/cfi/riscv_cfi_intel_32.inc"
+	};
+	static const uint8_t riscv_cfi_span_8[] = {
+#include "../../../contrib/loaders/flash/cfi/riscv_cfi_span_8.inc"
+	};
+	static const uint8_t riscv_cfi_span_16[] = {
+#include "../../../contrib/loaders/flash/cfi/riscv_cfi_span_16.inc"
+	};
+	static const uint8_t riscv_cfi_span_32[] = {
+#include "../../../contrib/loaders/flash/cfi/riscv_cfi_span_32.inc"
+	};
+	const uint8_t *code;
+	size_t code_size;
+
+	switch (bank->bus_width) {
+		case 1:
+			code = intel ? riscv_cfi_intel_8 : riscv_cfi_span_8;
+			code_size = intel ? sizeof(riscv_cfi_intel_8) : sizeof(riscv_cfi_span_8);
+			break;
+		case 2:
+			code = intel ? riscv_cfi_intel_16 : riscv_cfi_span_16;
+			code_size = intel ? sizeof(riscv_cfi_intel_16) : sizeof(riscv_cfi_span_16);
+			break;
+		case 4:
+			code = intel ? riscv_cfi_intel_32 : riscv_cfi_span_32;
+			code_size = intel ? sizeof(riscv_cfi_intel_32) : sizeof(riscv_cfi_span_32);
+			break;
+		default:
+			LOG_ERROR("Unsupported bank buswidth %u, can't do block memory writes",
+					bank->bus_width);
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	if (target_alloc_working_area(target, code_size, &write_algorithm) != ERROR_OK) {
+		LOG_WARNING("No working area available, can't do block memory writes");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	retval = target_write_buffer(target, write_algorithm->address, code_size, code);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, write_algorithm);
+		return retval;
+	}
+
+	while (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
+		buffer_size /= 2;
+		if (buffer_size <= 256) {
+			target_free_working_area(target, write_algorithm);
+			LOG_WARNING("not enough working area available, can't do block memory writes");
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+	}
+
+	/* a0..a5, t0..t2 and s0 are the arguments, the others only have to be
+	 * restored after the run */
+	static char * const reg_names[] = {
+		"a0", "a1", "a2", "a3", "a4", "a5", "t0", "t1", "t2", "s0",
+		"s1", "gp", "tp",
+	};
+	unsigned int xlen = riscv_xlen(target);
+	struct reg_param reg_params[ARRAY_SIZE(reg_names)];
+	uint64_t args[ARRAY_SIZE(reg_names)] = { 0 };
+
+	if (intel) {
+		args[3] = cfi_command_val(bank, 0x40);
+		args[4] = cfi_command_val(bank, 0x80);
+		args[5] = cfi_command_val(bank, 0x7e);
+		cfi_intel_clear_status_register(bank);
+	} else {
+		struct cfi_spansion_pri_ext *pri_ext = cfi_info->pri_ext;
+
+		args[3] = cfi_command_val(bank, 0xa0);
+		args[4] = cfi_command_val(bank, 0x80);
+		args[5] = (cfi_info->status_poll_mask & 0x20) ? cfi_command_val(bank, 0x20) : 0;
+		args[6] = cfi_flash_address(bank, 0, pri_ext->_unlock1);
+		args[7] = cfi_command_val(bank, 0xaa);
+		args[8] = cfi_flash_address(bank, 0, pri_ext->_unlock2);
+		args[9] = cfi_command_val(bank, 0x55);
+	}
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_names); i++)
+		init_reg_param(&reg_params[i], reg_names[i], xlen, i < 2 ? PARAM_IN_OUT : PARAM_OUT);
+
+	while (count > 0) {
+		uint32_t thisrun_count = MIN(count, buffer_size);
+
+		retval = target_write_buffer(target, source->address, thisrun_count, buffer);
+		if (retval != ERROR_OK)
+			break;
+
+		args[0] = source->address;
+		args[1] = address;
+		args[2] = thisrun_count / bank->bus_width;
+		for (unsigned int i = 0; i < ARRAY_SIZE(reg_names); i++)
+			buf_set_u64(reg_params[i].value, 0, xlen, args[i]);
+
+		retval = target_run_algorithm(target, 0, NULL, ARRAY_SIZE(reg_params), reg_params,
+				write_algorithm->address, 0, 10000, NULL);
+		if (retval != ERROR_OK)
+			break;
+
+		uint64_t status = buf_get_u64(reg_params[0].value, 0, xlen);
+		if (status) {
+			LOG_ERROR("flash write block failed at 0x%" PRIx64 ", status 0x%" PRIx64,
+				buf_get_u64(reg_params[1].value, 0, xlen), status);
+			if (intel)
+				cfi_intel_clear_status_register(bank);
+			retval = ERROR_FLASH_OPERATION_FAILED;
+			break;
+		}
+
+		buffer += thisrun_count;
+		address += thisrun_count;
+		count -= thisrun_count;
+
+		keep_alive();
+	}
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_params); i++)
+		destroy_reg_param(&reg_params[i]);
+
+	target_free_working_area(target, source);
+	target_free_working_area(target, write_algorithm);
+
+	return retval;
+}
+
 static int cfi_intel_write_block(struct flash_bank *bank, const uint8_t *buffer,
 	uint32_t address, uint32_t count)
 {
@@ -1192,6 +1353,9 @@ static int cfi_intel_write_block(struct flash_bank *bank, const uint8_t *buffer,
 	uint32_t target_code_size;
 	int retval = ERROR_OK;
 
+	if (!strcmp(target_type_name(target), "riscv"))
+		return cfi_riscv_write_block(bank, buffer, address, count);
+
 	/* check we have a supported arch */
 	if (is_arm(target_to_arm(target))) {
 		/* All other ARM CPUs have 32 bit instructions */
@@ -1781,6 +1945,9 @@ static int cfi_spansion_write_block(struct flash_bank *bank, const uint8_t *buff
 	if (strncmp(target_type_name(target), "mips_m4k", 8) == 0)
 		return cfi_spansion_write_block_mips(bank, buffer, address, count);
 
+	if (!strcmp(target_type_name(target), "riscv"))
+		return cfi_riscv_write_block(bank, buffer, address, count);
+
 	if (is_armv7m(target_to_armv7m(target))) {	/* armv7m target */
 		armv7m_algo.common_magic = ARMV7M_COMMON_MAGIC;
 		armv7m_algo.core_mode = ARM_MODE_THREAD;
@@ -1999,21 +2166,14 @@ static int cfi_intel_write_words(struct flash_bank *bank, const uint8_t *word,
 	uint32_t buffermask = buffersize-1;
 	uint32_t bufferwsize = buffersize / bank->bus_width;
 
-	/* Check for valid range */
-	if (address & buffermask) {
-		LOG_ERROR("Write address at base " TARGET_ADDR_FMT ", address 0x%"
-				PRIx32 " not aligned to 2^%d boundary",
+	/* Check for valid range, the words must be in one write buffer */
+	if (wordcount == 0 || (address & buffermask) / bank->bus_width + wordcount > bufferwsize) {
+		LOG_ERROR("Write of %" PRIu32 " words at base " TARGET_ADDR_FMT ", address 0x%"
+				PRIx32 " crosses a 2^%d boundary", wordcount,
 				bank->base, address, cfi_info->max_buf_write_size);
 		return ERROR_FLASH_OPERATION_FAILED;
 	}
 
-	/* Check for valid size */
-	if (wordcount > bufferwsize) {
-		LOG_ERROR("Number of data words %" PRIu32 " exceeds available buffersize %" PRIu32,
-			wordcount, buffersize);
-		return ERROR_FLASH_OPERATION_FAILED;
-	}
-
 	/* Write to flash buffer */
 	cfi_intel_clear_status_register(bank);
 
@@ -2039,11 +2199,11 @@ static int cfi_intel_write_words(struct flash_bank *bank, const uint8_t *word,
 	}
 
 	/* Write buffer wordcount-1 and data words */
-	retval = cfi_send_command(bank, bufferwsize-1, address);
+	retval = cfi_send_command(bank, wordcount - 1, address);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = cfi_target_write_memory(bank, address, bufferwsize, word);
+	retval = cfi_target_write_memory(bank, address, wordcount, word);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -2114,18 +2274,11 @@ static int cfi_spansion_write_words(struct flash_bank *bank, const uint8_t *word
 	uint32_t buffermask = buffersize-1;
 	uint32_t bufferwsize = buffersize / bank->bus_width;
 
-	/* Check for valid range */
-	if (address & buffermask) {
-		LOG_ERROR("Write address at base " TARGET_ADDR_FMT
-			", address 0x%" PRIx32 " not aligned to 2^%d boundary",
-			bank->base, address, cfi_info->max_buf_write_size);
-		return ERROR_FLASH_OPERATION_FAILED;
-	}
-
-	/* Check for valid size */
-	if (wordcount > bufferwsize) {
-		LOG_ERROR("Number of data words %" PRIu32 " exceeds available buffersize %"
-			PRIu32, wordcount, buffersize);
+	/* Check for valid range, the words must be in one write buffer */
+	if (wordcount == 0 || (address & buffermask) / bank->bus_width + wordcount > bufferwsize) {
+		LOG_ERROR("Write of %" PRIu32 " words at base " TARGET_ADDR_FMT ", address 0x%"
+				PRIx32 " crosses a 2^%d boundary", wordcount,
+				bank->base, address, cfi_info->max_buf_write_size);
 		return ERROR_FLASH_OPERATION_FAILED;
 	}
 
@@ -2140,11 +2293,11 @@ static int cfi_spansion_write_words(struct flash_bank *bank, const uint8_t *word
 		return retval;
 
 	/* Write buffer wordcount-1 and data words */
-	retval = cfi_send_command(bank, bufferwsize-1, address);
+	retval = cfi_send_command(bank, wordcount - 1, address);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = cfi_target_write_memory(bank, address, bufferwsize, word);
+	retval = cfi_target_write_memory(bank, address, wordcount, word);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -2160,7 +2313,7 @@ static int cfi_spansion_write_words(struct flash_bank *bank, const uint8_t *word
 
 		LOG_ERROR("couldn't write block at base " TARGET_ADDR_FMT
 			", address 0x%" PRIx32 ", size 0x%" PRIx32, bank->base, address,
-			bufferwsize);
+			wordcount);
 		return ERROR_FLASH_OPERATION_FAILED;
 	}
 
@@ -2376,21 +2529,22 @@ static int cfi_write(struct flash_bank *bank, const uint8_t *buffer, uint32_t of
 			uint32_t buffermask = buffersize-1;
 			uint32_t bufferwsize = buffersize / bank->bus_width;
 
-			/* fall back to memory writes */
+			/* fall back to memory writes, of up to a write buffer at once */
 			while (count >= (uint32_t)bank->bus_width) {
 				bool fallback;
-				if ((write_p & 0xff) == 0) {
+				if ((write_p & 0xffff) == 0) {
 					LOG_INFO("Programming at 0x%08" PRIx32 ", count 0x%08"
 						PRIx32 " bytes remaining", write_p, count);
 				}
 				fallback = true;
-				if ((bufferwsize > 0) && (count >= buffersize) &&
-						!(write_p & buffermask)) {
-					retval = cfi_write_words(bank, buffer, bufferwsize, write_p);
+				uint32_t wordcount = MIN(buffersize - (write_p & buffermask), count) /
+					bank->bus_width;
+				if (bufferwsize > 1 && wordcount > 1) {
+					retval = cfi_write_words(bank, buffer, wordcount, write_p);
 					if (retval == ERROR_OK) {
-						buffer += buffersize;
-						write_p += buffersize;
-						count -= buffersize;
+						buffer += wordcount * bank->bus_width;
+						write_p += wordcount * bank->bus_width;
+						count -= wordcount * bank->bus_width;
 						fallback = false;
 					} else if (retval != ERROR_FLASH_OPER_UNSUPPORTED)
 						return retval;
@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Checkpoint file of 'flash write_image', the sectors written and verified
+ * so far, to resume an interrupted programming where it stopped.
+ *
+ * The file is a text file:
+ *   image 0x<crc of the image>
+ *   uid <unique ID of the device>, if known
+ *   sector <bank name> 0x<offset> 0x<size> 0x<crc of the data>
+ * with a line appended, and flushed, for each sector once it is verified.
+ *
+ * Kept as the manifest of the last image programmed, it tells the sectors a
+ * slightly different image leaves unchanged.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <flash/nor/imp.h>
+#include <helper/crc32.h>
+#include <target/image.h>
+
+#define FLASH_CHECKPOINT_CHUNK	(64 * 1024)
+
+struct flash_checkpoint_sector {
+	char *bank;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t crc;
+};
+
+uint32_t flash_checkpoint_crc(const uint8_t *buffer, uint32_t count)
+{
+	return crc32_be(CRC32_POLY_BE, 0xffffffff, buffer, count);
+}
+
+/* the crc of the addresses and the data of all the sections */
+static int flash_checkpoint_image_crc(struct image *image, uint32_t *crc)
+{
+	uint8_t *buffer = malloc(FLASH_CHECKPOINT_CHUNK);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	*crc = 0xffffffff;
+
+	for (unsigned int i = 0; i < image->num_sections; i++) {
+		struct imagesection *section = &image->sections[i];
+		uint8_t header[12];
+
+		h_u64_to_le(header, section->base_address);
+		h_u32_to_le(header + 8, section->size);
+		*crc = crc32_be(CRC32_POLY_BE, *crc, header, sizeof(header));
+
+		for (uint32_t offset = 0; offset < section->size; ) {
+			size_t size_read = MIN(section->size - offset, FLASH_CHECKPOINT_CHUNK);
+			int retval = image_read_section(image, i, offset, size_read, buffer,
+					&size_read);
+			if (retval != ERROR_OK || size_read == 0) {
+				free(buffer);
+				return retval != ERROR_OK ? retval : ERROR_FAIL;
+			}
+
+			*crc = crc32_be(CRC32_POLY_BE, *crc, buffer, size_read);
+			offset += size_read;
+			keep_alive();
+		}
+	}
+
+	free(buffer);
+
+	return ERROR_OK;
+}
+
+static int flash_checkpoint_compare(const void *a, const void *b)
+{
+	const struct flash_checkpoint_sector *sa = a;
+	const struct flash_checkpoint_sector *sb = b;
+	int diff = strcmp(sa->bank, sb->bank);
+
+	if (diff)
+		return diff;
+	if (sa->offset != sb->offset)
+		return sa->offset < sb->offset ? -1 : 1;
+	return 0;
+}
+
+static void flash_checkpoint_clear(struct flash_checkpoint *checkpoint)
+{
+	for (unsigned int i = 0; i < checkpoint->num_sectors; i++)
+		free(checkpoint->sectors[i].bank);
+	free(checkpoint->sectors);
+	checkpoint->sectors = NULL;
+	checkpoint->num_sectors = 0;
+}
+
+/* the sectors recorded by the programming being resumed */
+static int flash_checkpoint_load(struct flash_checkpoint *checkpoint, const char *path,
+	enum flash_checkpoint_mode mode)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		LOG_INFO("no checkpoint in %s, programming all of the image", path);
+		return ERROR_OK;
+	}
+
+	unsigned int allocated = 0;
+	bool image_match = false;
+	/* a file without uid is of any device, but not if the device has one */
+	bool uid_match = !checkpoint->uid;
+	bool valid = true;
+	char line[256];
+
+	while (valid && fgets(line, sizeof(line), f)) {
+		struct flash_checkpoint_sector s;
+		char bank[128];
+		char uid[128];
+		uint32_t crc;
+
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '#' || line[0] == '\0')
+			continue;
+
+		if (sscanf(line, "image 0x%" SCNx32, &crc) == 1) {
+			image_match = crc == checkpoint->image_crc || mode == FLASH_CHECKPOINT_MANIFEST;
+			valid = image_match;
+			continue;
+		}
+
+		if (sscanf(line, "uid %127s", uid) == 1) {
+			uid_match = checkpoint->uid && !strcmp(uid, checkpoint->uid);
+			valid = uid_match;
+			continue;
+		}
+
+		if (!image_match || sscanf(line, "sector %127s 0x%" SCNx32 " 0x%" SCNx32
+				" 0x%" SCNx32, bank, &s.offset, &s.size, &s.crc) != 4) {
+			valid = false;
+			continue;
+		}
+
+		if (checkpoint->num_sectors == allocated) {
+			unsigned int n = allocated ? 2 * allocated : 64;
+			struct flash_checkpoint_sector *sectors =
+				realloc(checkpoint->sectors, n * sizeof(*sectors));
+			if (!sectors) {
+				LOG_ERROR("Out of memory");
+				fclose(f);
+				flash_checkpoint_clear(checkpoint);
+				return ERROR_FAIL;
+			}
+			checkpoint->sectors = sectors;
+			allocated = n;
+		}
+
+		s.bank = strdup(bank);
+		checkpoint->sectors[checkpoint->num_sectors++] = s;
+	}
+
+	fclose(f);
+
+	if (!uid_match) {
+		LOG_INFO("checkpoint %s is not of this device, programming all of the image", path);
+		flash_checkpoint_clear(checkpoint);
+		return ERROR_OK;
+	}
+
+	if (!valid || !image_match) {
+		LOG_INFO("checkpoint %s is not of this image, programming all of it", path);
+		flash_checkpoint_clear(checkpoint);
+		return ERROR_OK;
+	}
+
+	qsort(checkpoint->sectors, checkpoint->num_sectors, sizeof(*checkpoint->sectors),
+		flash_checkpoint_compare);
+
+	LOG_INFO("checkpoint %s: %u sectors written earlier", path, checkpoint->num_sectors);
+
+	return ERROR_OK;
+}
+
+int flash_checkpoint_open(struct flash_checkpoint *checkpoint, const char *path,
+	struct image *image, enum flash_checkpoint_mode mode, const char *uid)
+{
+	memset(checkpoint, 0, sizeof(*checkpoint));
+
+	int retval = flash_checkpoint_image_crc(image, &checkpoint->image_crc);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (uid) {
+		checkpoint->uid = strdup(uid);
+		if (!checkpoint->uid) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	if (mode != FLASH_CHECKPOINT_NEW) {
+		retval = flash_checkpoint_load(checkpoint, path, mode);
+		if (retval != ERROR_OK) {
+			free(checkpoint->uid);
+			return retval;
+		}
+	}
+
+	/* the sectors loaded, and confirmed again, are recorded anew */
+	checkpoint->file = fopen(path, "w");
+	if (!checkpoint->file) {
+		LOG_ERROR("couldn't create the checkpoint %s: %s", path, strerror(errno));
+		flash_checkpoint_clear(checkpoint);
+		free(checkpoint->uid);
+		return ERROR_FAIL;
+	}
+
+	fprintf(checkpoint->file, "# sectors written by 'flash write_image'\n");
+	fprintf(checkpoint->file, "image 0x%08" PRIx32 "\n", checkpoint->image_crc);
+	if (checkpoint->uid)
+		fprintf(checkpoint->file, "uid %s\n", checkpoint->uid);
+	fflush(checkpoint->file);
+
+	return ERROR_OK;
+}
+
+void flash_checkpoint_close(struct flash_checkpoint *checkpoint)
+{
+	if (checkpoint->file)
+		fclose(checkpoint->file);
+	checkpoint->file = NULL;
+
+	flash_checkpoint_clear(checkpoint);
+	free(checkpoint->uid);
+	checkpoint->uid = NULL;
+}
+
+bool flash_checkpoint_done(const struct flash_checkpoint *checkpoint,
+	const struct flash_bank *bank, uint32_t offset, uint32_t size, uint32_t crc)
+{
+	struct flash_checkpoint_sector key = {
+		.bank = bank->name,
+		.offset = offset,
+	};
+	const struct flash_checkpoint_sector *s;
+
+	if (!checkpoint->num_sectors)
+		return false;
+
+	s = bsearch(&key, checkpoint->sectors, checkpoint->num_sectors,
+		sizeof(*checkpoint->sectors), flash_checkpoint_compare);
+
+	return s && s->size == size && s->crc == crc;
+}
+
+int flash_checkpoint_record(struct flash_checkpoint *checkpoint,
+	const struct flash_bank *bank, uint32_t offset, uint32_t size, uint32_t crc)
+{
+	fprintf(checkpoint->file, "sector %s 0x%08" PRIx32 " 0x%08" PRIx32 " 0x%08" PRIx32 "\n",
+		bank->name, offset, size, crc);
+
+	if (fflush(checkpoint->file) != 0 || ferror(checkpoint->file)) {
+		LOG_ERROR("couldn't write the checkpoint: %s", strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
@@ -16,6 +16,8 @@
 #include <flash/nor/core.h>
 #include <flash/nor/imp.h>
 #include <target/image.h>
+#include <helper/metrics.h>
+#include <helper/time_support.h>
 
 /**
  * @file
@@ -26,14 +28,220 @@
 
 static struct flash_bank *flash_banks;
 
+static struct metric flash_erase_sectors = METRIC_COUNTER("flash_erase_sectors_total",
+		"Flash sectors erased");
+static struct metric flash_write_bytes = METRIC_COUNTER("flash_write_bytes_total",
+		"Bytes written to the flash");
+static struct metric flash_write_metric = METRIC_HISTOGRAM("flash_write_microseconds",
+		"Time taken by a flash driver write");
+static struct metric flash_errors = METRIC_COUNTER("flash_errors_total",
+		"Failed flash erases and writes");
+
+/* the flash operations of the session */
+static struct flash_stats flash_totals;
+
+static void flash_phase_add(enum flash_phase phase, int64_t begin, uint64_t bytes)
+{
+	flash_totals.phase[phase].us += timeval_us() - begin;
+	flash_totals.phase[phase].bytes += bytes;
+	flash_totals.phase[phase].calls++;
+}
+
+static void flash_stats_metric(const char *name, uint64_t *count, uint64_t *sum)
+{
+	struct metric *metric = metric_find(name);
+
+	*count = metric ? metric->count : 0;
+	if (sum)
+		*sum = metric ? metric->sum : 0;
+}
+
+void flash_stats_start(struct flash_stats *stats)
+{
+	*stats = flash_totals;
+	stats->start = timeval_us();
+
+	flash_stats_metric("async_algorithm_wait_milliseconds_total", &stats->program_wait_ms, NULL);
+	flash_stats_metric("dap_run_microseconds", &stats->dap_runs, &stats->dap_run_us);
+	flash_stats_metric("jtag_execute_queue_microseconds", &stats->jtag_flushes, &stats->jtag_flush_us);
+}
+
+void flash_stats_print(struct command_invocation *cmd, const struct flash_stats *stats)
+{
+	static const char * const names[FLASH_PHASES] = {
+		[FLASH_PHASE_ERASE] = "erase",
+		[FLASH_PHASE_READ_IMAGE] = "read image",
+		[FLASH_PHASE_WRITE] = "write",
+		[FLASH_PHASE_VERIFY] = "verify",
+	};
+	struct flash_stats now;
+
+	flash_stats_start(&now);
+
+	for (unsigned int i = 0; i < FLASH_PHASES; i++) {
+		unsigned int calls = now.phase[i].calls - stats->phase[i].calls;
+		uint64_t bytes = now.phase[i].bytes - stats->phase[i].bytes;
+		int64_t us = now.phase[i].us - stats->phase[i].us;
+
+		if (!calls)
+			continue;
+
+		command_print(cmd, "%-10s %10" PRIu64 " bytes in %8.3f s, %9.1f KiB/s, %u calls",
+			names[i], bytes, us / 1e6, us ? bytes * 1e6 / 1024 / us : 0, calls);
+	}
+
+	uint64_t program_wait_ms = now.program_wait_ms - stats->program_wait_ms;
+	if (program_wait_ms)
+		command_print(cmd, "%-10s %8.3f s waiting for the flash loader",
+			"", program_wait_ms / 1e3);
+
+	uint64_t dap_runs = now.dap_runs - stats->dap_runs;
+	if (dap_runs)
+		command_print(cmd, "%-10s %10" PRIu64 " DAP runs of %.1f us on average",
+			"adapter", dap_runs, (double)(now.dap_run_us - stats->dap_run_us) / dap_runs);
+
+	uint64_t jtag_flushes = now.jtag_flushes - stats->jtag_flushes;
+	if (jtag_flushes)
+		command_print(cmd, "%-10s %10" PRIu64 " JTAG queue flushes of %.1f us on average",
+			"adapter", jtag_flushes, (double)(now.jtag_flush_us - stats->jtag_flush_us) / jtag_flushes);
+
+	command_print(cmd, "%-10s %8.3f s", "total", (now.start - stats->start) / 1e6);
+}
+
+/*
+ * The core remembers the sectors it erased in the session and how far they
+ * were programmed since, so that a later 'write_image erase' over them can
+ * skip the erase, as in the flows programming a bootloader, an application
+ * and a configuration one after the other. Anything which may change the
+ * flash behind the back of the core, a reset or the target running, makes
+ * it forget all of it.
+ */
+static bool flash_erased_callback_registered;
+
+void flash_forget_erased(struct flash_bank *bank)
+{
+	free(bank->erased_from);
+	bank->erased_from = NULL;
+	bank->erased_num_sectors = 0;
+}
+
+static int flash_erased_target_event(struct target *target,
+		enum target_event event, void *priv)
+{
+	switch (event) {
+	case TARGET_EVENT_RESUMED:
+	case TARGET_EVENT_RESET_START:
+	case TARGET_EVENT_EXAMINE_START:
+		for (struct flash_bank *c = flash_banks; c; c = c->next)
+			if (c->target == target)
+				flash_forget_erased(c);
+		break;
+	default:
+		break;
+	}
+
+	return ERROR_OK;
+}
+
+/* A virtual bank shares the sectors of its master, and writes behind its back */
+static void flash_forget_erased_aliases(struct flash_bank *bank)
+{
+	for (struct flash_bank *c = flash_banks; c; c = c->next)
+		if (c != bank && c->sectors == bank->sectors)
+			flash_forget_erased(c);
+}
+
+/* @returns the erase state of the sectors of @a bank, NULL if unknown */
+static uint32_t *flash_erased_state(struct flash_bank *bank)
+{
+	/* probed again since */
+	if (bank->erased_from && bank->erased_num_sectors != bank->num_sectors)
+		flash_forget_erased(bank);
+
+	return bank->erased_from;
+}
+
+static void flash_erased_mark(struct flash_bank *bank, unsigned int first,
+		unsigned int last)
+{
+	flash_forget_erased_aliases(bank);
+
+	uint32_t *erased = flash_erased_state(bank);
+	if (!erased) {
+		erased = malloc(bank->num_sectors * sizeof(*erased));
+		if (!erased)
+			return;
+		for (unsigned int i = 0; i < bank->num_sectors; i++)
+			erased[i] = bank->sectors[i].size;
+		bank->erased_from = erased;
+		bank->erased_num_sectors = bank->num_sectors;
+	}
+
+	if (!flash_erased_callback_registered) {
+		target_register_event_callback(flash_erased_target_event, NULL);
+		flash_erased_callback_registered = true;
+	}
+
+	for (unsigned int i = first; i <= last && i < bank->num_sectors; i++)
+		erased[i] = 0;
+}
+
+static void flash_erased_written(struct flash_bank *bank, uint32_t offset,
+		uint32_t count)
+{
+	flash_forget_erased_aliases(bank);
+
+	uint32_t *erased = flash_erased_state(bank);
+	if (!erased)
+		return;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+
+		if (offset + count <= sector->offset || offset >= sector->offset + sector->size)
+			continue;
+
+		uint32_t end = MIN(offset + count, sector->offset + sector->size) - sector->offset;
+		erased[i] = MAX(erased[i], end);
+	}
+}
+
+/* @returns true if sector @a i of @a bank needs no erase to program @a count bytes at @a offset */
+static bool flash_erased_sector_covers(struct flash_bank *bank, unsigned int i,
+		uint32_t offset, uint32_t count)
+{
+	uint32_t *erased = flash_erased_state(bank);
+	struct flash_sector *sector = &bank->sectors[i];
+
+	if (!erased)
+		return false;
+
+	if (offset + count <= sector->offset || offset >= sector->offset + sector->size)
+		return true;
+
+	return MAX(offset, sector->offset) - sector->offset >= erased[i];
+}
+
 int flash_driver_erase(struct flash_bank *bank, unsigned int first,
 		unsigned int last)
 {
 	int retval;
+	int64_t begin = timeval_us();
 
 	retval = bank->driver->erase(bank, first, last);
-	if (retval != ERROR_OK)
+	if (retval != ERROR_OK) {
 		LOG_ERROR("failed erasing sectors %u to %u", first, last);
+		metric_add(&flash_errors, 1);
+		flash_phase_add(FLASH_PHASE_ERASE, begin, 0);
+	} else {
+		uint64_t bytes = 0;
+		for (unsigned int i = first; i <= last && i < bank->num_sectors; i++)
+			bytes += bank->sectors[i].size;
+
+		metric_add(&flash_erase_sectors, last - first + 1);
+		flash_phase_add(FLASH_PHASE_ERASE, begin, bytes);
+		flash_erased_mark(bank, first, last);
+	}
 
 	return retval;
 }
@@ -86,14 +294,24 @@ int flash_driver_write(struct flash_bank *bank,
 	const uint8_t *buffer, uint32_t offset, uint32_t count)
 {
 	int retval;
+	int64_t begin = timeval_us();
 
 	retval = bank->driver->write(bank, buffer, offset, count);
+	metric_histogram_add(&flash_write_metric, timeval_us() - begin);
+	flash_phase_add(FLASH_PHASE_WRITE, begin, retval == ERROR_OK ? count : 0);
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
 			"error writing to flash at address " TARGET_ADDR_FMT
 			" at offset 0x%8.8" PRIx32,
 			bank->base,
 			offset);
+		metric_add(&flash_errors, 1);
+		/* programmed up to where? */
+		flash_forget_erased_aliases(bank);
+		flash_forget_erased(bank);
+	} else {
+		metric_add(&flash_write_bytes, count);
+		flash_erased_written(bank, offset, count);
 	}
 
 	return retval;
@@ -128,9 +346,11 @@ int flash_driver_verify(struct flash_bank *bank,
 	const uint8_t *buffer, uint32_t offset, uint32_t count)
 {
 	int retval;
+	int64_t begin = timeval_us();
 
 	retval = bank->driver->verify ? bank->driver->verify(bank, buffer, offset, count) :
 		default_flash_verify(bank, buffer, offset, count);
+	flash_phase_add(FLASH_PHASE_VERIFY, begin, count);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("verify failed in bank at " TARGET_ADDR_FMT " starting at 0x%8.8" PRIx32,
 			bank->base, offset);
@@ -232,12 +452,18 @@ void flash_free_all_banks(void)
 			free(bank->sectors);
 			free(bank->prot_blocks);
 		}
+		free(bank->erased_from);
 
 		free(bank->name);
 		free(bank);
 		bank = next;
 	}
 	flash_banks = NULL;
+
+	if (flash_erased_callback_registered) {
+		target_unregister_event_callback(flash_erased_target_event, NULL);
+		flash_erased_callback_registered = false;
+	}
 }
 
 struct flash_bank *get_flash_bank_by_name_noprobe(const char *name)
@@ -333,8 +559,7 @@ int get_flash_bank_by_addr(struct target *target,
 static int default_flash_mem_blank_check(struct flash_bank *bank)
 {
 	struct target *target = bank->target;
-	const int buffer_size = 1024;
-	uint32_t n_bytes;
+	const uint32_t buffer_size = 16 * 1024;
 	int retval = ERROR_OK;
 
 	if (bank->target->state != TARGET_HALTED) {
@@ -342,36 +567,42 @@ static int default_flash_mem_blank_check(struct flash_bank *bank)
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	/* The target is read in large chunks to keep adapter round trips down,
+	 * and each chunk is compared against an erased pattern with memcmp(),
+	 * which the C library implements with wide vector compares. */
 	uint8_t *buffer = malloc(buffer_size);
+	uint8_t *erased = malloc(buffer_size);
+	if (!buffer || !erased) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto done;
+	}
+	memset(erased, bank->erased_value, buffer_size);
 
 	for (unsigned int i = 0; i < bank->num_sectors; i++) {
-		uint32_t j;
-		bank->sectors[i].is_erased = 1;
-
-		for (j = 0; j < bank->sectors[i].size; j += buffer_size) {
-			uint32_t chunk;
-			chunk = buffer_size;
-			if (chunk > (bank->sectors[i].size - j))
-				chunk = (bank->sectors[i].size - j);
-
-			retval = target_read_memory(target,
-					bank->base + bank->sectors[i].offset + j,
-					4,
-					chunk/4,
-					buffer);
-			if (retval != ERROR_OK)
-				goto done;
+		struct flash_sector *sector = &bank->sectors[i];
+		sector->is_erased = 1;
 
-			for (n_bytes = 0; n_bytes < chunk; n_bytes++) {
-				if (buffer[n_bytes] != bank->erased_value) {
-					bank->sectors[i].is_erased = 0;
-					break;
-				}
+		/* stop reading a sector at its first non erased chunk */
+		for (uint32_t j = 0; j < sector->size && sector->is_erased; j += buffer_size) {
+			uint32_t chunk = MIN(buffer_size, sector->size - j);
+
+			retval = target_read_buffer(target, bank->base + sector->offset + j,
+					chunk, buffer);
+			if (retval != ERROR_OK) {
+				sector->is_erased = -1;
+				goto done;
 			}
+
+			if (memcmp(buffer, erased, chunk) != 0)
+				sector->is_erased = 0;
 		}
+
+		keep_alive();
 	}
 
 done:
+	free(erased);
 	free(buffer);
 
 	return retval;
@@ -610,11 +841,253 @@ static int flash_iterate_address_range(struct target *target,
 	return retval;
 }
 
+/* banks with an erase in flight at the same time */
+#define FLASH_ERASE_PENDING_MAX		8
+
+/* erases started by flash_driver_erase_start(), bank is NULL if free */
+static struct flash_erase_pending {
+	struct flash_bank *bank;
+	/* sectors not erased yet, the one before is being erased */
+	unsigned int next;
+	unsigned int last;
+} erase_pending[FLASH_ERASE_PENDING_MAX];
+
+/* @returns true if @a bank can erase while @a other erases or programs */
+static bool flash_banks_parallel(struct flash_bank *bank, struct flash_bank *other)
+{
+	/* the flash of other targets, e.g. on the same chain */
+	if (bank->target != other->target)
+		return true;
+
+	return bank != other && bank->parallel_group
+		&& bank->parallel_group == other->parallel_group;
+}
+
+/* Wait for the sector being erased and start erasing the next one */
+static int flash_erase_pending_step(struct flash_erase_pending *pending)
+{
+	struct flash_bank *bank = pending->bank;
+	int64_t begin = timeval_us();
+
+	int retval = bank->driver->erase_wait(bank);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("failed erasing sector %u", pending->next - 1);
+		metric_add(&flash_errors, 1);
+		flash_phase_add(FLASH_PHASE_ERASE, begin, 0);
+		pending->bank = NULL;
+		return retval;
+	}
+	metric_add(&flash_erase_sectors, 1);
+	flash_phase_add(FLASH_PHASE_ERASE, begin, bank->sectors[pending->next - 1].size);
+	flash_erased_mark(bank, pending->next - 1, pending->next - 1);
+
+	if (pending->next > pending->last) {
+		pending->bank = NULL;
+		return ERROR_OK;
+	}
+
+	retval = bank->driver->erase_start(bank, pending->next);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("failed erasing sector %u", pending->next);
+		metric_add(&flash_errors, 1);
+		pending->bank = NULL;
+		return retval;
+	}
+	pending->next++;
+
+	return ERROR_OK;
+}
+
+/* Wait for the sectors being erased and drop the rest, after an error */
+static void flash_erase_pending_cancel(void)
+{
+	for (unsigned int i = 0; i < FLASH_ERASE_PENDING_MAX; i++) {
+		struct flash_bank *bank = erase_pending[i].bank;
+
+		if (!bank)
+			continue;
+
+		erase_pending[i].bank = NULL;
+		bank->driver->erase_wait(bank);
+	}
+}
+
+/*
+ * Erase the rest of the sectors of @a bank, or of all banks if NULL. The
+ * other banks erasing in parallel go on with their sectors meanwhile.
+ */
+static int flash_erase_address_range_finish(struct flash_bank *bank)
+{
+	for (;;) {
+		struct flash_erase_pending *pending = NULL;
+		unsigned int in_flight = 0;
+
+		for (unsigned int i = 0; i < FLASH_ERASE_PENDING_MAX; i++) {
+			if (!erase_pending[i].bank)
+				continue;
+			in_flight++;
+			if (!bank || erase_pending[i].bank == bank)
+				pending = &erase_pending[i];
+		}
+
+		if (!pending)
+			return ERROR_OK;
+
+		if (in_flight == 1) {
+			/* nothing else in flight, the driver erases the rest at once */
+			struct flash_bank *c = pending->bank;
+			unsigned int next = pending->next;
+			unsigned int last = pending->last;
+
+			pending->last = pending->next - 1;
+			int retval = flash_erase_pending_step(pending);
+			if (retval != ERROR_OK || next > last)
+				return retval;
+
+			return flash_driver_erase(c, next, last);
+		}
+
+		/* a sector of each bank in turn, the banks erase together */
+		for (unsigned int i = 0; i < FLASH_ERASE_PENDING_MAX; i++) {
+			if (!erase_pending[i].bank)
+				continue;
+
+			int retval = flash_erase_pending_step(&erase_pending[i]);
+			if (retval != ERROR_OK) {
+				flash_erase_pending_cancel();
+				return retval;
+			}
+		}
+	}
+}
+
+static int flash_driver_erase_start(struct flash_bank *bank, unsigned int first,
+		unsigned int last)
+{
+	struct flash_erase_pending *pending = NULL;
+	int retval;
+
+	/* only the banks able to erase in parallel stay in flight */
+	for (unsigned int i = 0; i < FLASH_ERASE_PENDING_MAX; i++) {
+		struct flash_bank *c = erase_pending[i].bank;
+
+		if (c && !flash_banks_parallel(bank, c)) {
+			retval = flash_erase_address_range_finish(c);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	if (!bank->driver->erase_start || !bank->driver->erase_wait)
+		return flash_driver_erase(bank, first, last);
+
+	for (unsigned int i = 0; i < FLASH_ERASE_PENDING_MAX && !pending; i++)
+		if (!erase_pending[i].bank)
+			pending = &erase_pending[i];
+
+	if (!pending) {
+		retval = flash_erase_address_range_finish(NULL);
+		if (retval != ERROR_OK)
+			return retval;
+		pending = &erase_pending[0];
+	}
+
+	retval = bank->driver->erase_start(bank, first);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("failed erasing sector %u", first);
+		metric_add(&flash_errors, 1);
+		return retval;
+	}
+
+	pending->bank = bank;
+	pending->next = first + 1;
+	pending->last = last;
+
+	return ERROR_OK;
+}
+
+/*
+ * Like flash_erase_address_range() with padding, but with a driver able to
+ * erase in the background it returns once the erase of the first sector
+ * of each bank started. flash_erase_address_range_finish() erases the rest.
+ */
+static int flash_erase_address_range_start(struct target *target,
+	target_addr_t addr, uint32_t length)
+{
+	int retval = flash_iterate_address_range(target, "erase",
+		addr, length, false, &flash_driver_erase_start);
+	if (retval != ERROR_OK) {
+		flash_erase_pending_cancel();
+		return retval;
+	}
+
+	return ERROR_OK;
+}
+
+/*
+ * Like flash_erase_address_range_start() within @a bank, but only for the
+ * sectors not left erased by an earlier erase of the session.
+ */
+static int flash_erase_address_range_needed(struct target *target,
+	struct flash_bank *bank, target_addr_t addr, uint32_t length)
+{
+	uint32_t offset = addr - bank->base;
+	/* the consecutive sectors to erase not started yet */
+	uint32_t erase_offset = 0;
+	uint32_t erase_end = 0;
+	unsigned int skipped = 0;
+	int retval;
+
+	if (!flash_erased_state(bank))
+		return flash_erase_address_range_start(target, addr, length);
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+
+		if (offset + length <= sector->offset || offset >= sector->offset + sector->size)
+			continue;
+
+		if (flash_erased_sector_covers(bank, i, offset, length)) {
+			skipped++;
+			continue;
+		}
+
+		uint32_t start = MAX(offset, sector->offset);
+		if (erase_end > erase_offset && start != erase_end) {
+			retval = flash_erase_address_range_start(target, bank->base + erase_offset,
+					erase_end - erase_offset);
+			if (retval != ERROR_OK)
+				return retval;
+			erase_end = erase_offset;
+		}
+		if (erase_end == erase_offset)
+			erase_offset = start;
+		erase_end = MIN(offset + length, sector->offset + sector->size);
+	}
+
+	if (skipped)
+		LOG_INFO("%u sectors at " TARGET_ADDR_FMT " still erased from earlier in the session, "
+			"not erased again", skipped, addr);
+
+	if (erase_end == erase_offset)
+		return ERROR_OK;
+
+	return flash_erase_address_range_start(target, bank->base + erase_offset,
+			erase_end - erase_offset);
+}
+
 int flash_erase_address_range(struct target *target,
 	bool pad, target_addr_t addr, uint32_t length)
 {
-	return flash_iterate_address_range(target, pad ? "erase" : NULL,
-		addr, length, false, &flash_driver_erase);
+	/* a range over banks able to erase in parallel erases them together */
+	int retval = flash_iterate_address_range(target, pad ? "erase" : NULL,
+		addr, length, false, &flash_driver_erase_start);
+	if (retval != ERROR_OK) {
+		flash_erase_pending_cancel();
+		return retval;
+	}
+
+	return flash_erase_address_range_finish(NULL);
 }
 
 static int flash_driver_unprotect(struct flash_bank *bank, unsigned int first,
@@ -727,8 +1200,423 @@ static bool flash_write_check_gap(struct flash_bank *bank,
 }
 
 
+/* @returns true if the flash at @a offset already holds the @a count bytes of @a buffer */
+static bool flash_driver_matches(struct flash_bank *bank,
+	const uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	int64_t begin = timeval_us();
+	bool match;
+
+	if (bank->driver->verify) {
+		match = bank->driver->verify(bank, buffer, offset, count) == ERROR_OK;
+	} else if (bank->driver->read == default_flash_read) {
+		/* the target computes the checksum of memory mapped flash */
+		match = default_flash_verify(bank, buffer, offset, count) == ERROR_OK;
+	} else {
+		uint8_t *data = malloc(count);
+		if (!data)
+			return false;
+
+		match = flash_driver_read(bank, data, offset, count) == ERROR_OK
+			&& !memcmp(data, buffer, count);
+		free(data);
+	}
+
+	flash_phase_add(FLASH_PHASE_VERIFY, begin, count);
+
+	return match;
+}
+
+/* Erase if asked and program @a count bytes at @a offset of the bank */
+static int flash_write_range(struct target *target, struct flash_bank *bank,
+	const uint8_t *buffer, uint32_t offset, uint32_t count, bool erase)
+{
+	if (erase) {
+		int retval = flash_erase_address_range(target, true, bank->base + offset, count);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return flash_driver_write(bank, buffer, offset, count);
+}
+
+/*
+ * Erase and program only the sectors of the run at @a address whose
+ * contents differ from @a buffer, the consecutive ones at once.
+ * @returns in @a programmed the number of bytes programmed.
+ */
+/* the differing sectors written at once while recording a checkpoint */
+#define FLASH_CHECKPOINT_INTERVAL	(256 * 1024)
+
+/*
+ * Write a range of a run and, with a @a checkpoint, verify it and record
+ * its sectors
+ */
+static int flash_write_range_recorded(struct target *target, struct flash_bank *bank,
+	const uint8_t *buffer, uint32_t offset, uint32_t count, bool erase,
+	struct flash_checkpoint *checkpoint)
+{
+	int retval = flash_write_range(target, bank, buffer, offset, count, erase);
+	if (retval != ERROR_OK || !checkpoint)
+		return retval;
+
+	retval = flash_driver_verify(bank, buffer, offset, count);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (!bank->num_sectors)
+		return flash_checkpoint_record(checkpoint, bank, offset, count,
+				flash_checkpoint_crc(buffer, count));
+
+	uint32_t end = offset + count;
+	for (unsigned int i = 0; i < bank->num_sectors && retval == ERROR_OK; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		uint32_t from = MAX(sector->offset, offset);
+		uint32_t to = MIN(sector->offset + sector->size, end);
+
+		if (from < to)
+			retval = flash_checkpoint_record(checkpoint, bank, from, to - from,
+					flash_checkpoint_crc(buffer + from - offset, to - from));
+	}
+
+	return retval;
+}
+
+/*
+ * @returns true if a part of a run needs no programming: with a checkpoint
+ * if recorded earlier and still in the flash, else if the flash holds it
+ */
+static bool flash_write_run_skip(struct flash_bank *bank, const uint8_t *buffer,
+	uint32_t offset, uint32_t count, struct flash_checkpoint *checkpoint)
+{
+	if (!checkpoint)
+		return flash_driver_matches(bank, buffer, offset, count);
+
+	uint32_t crc = flash_checkpoint_crc(buffer, count);
+	if (!flash_checkpoint_done(checkpoint, bank, offset, count, crc)
+			|| !flash_driver_matches(bank, buffer, offset, count))
+		return false;
+
+	/* still done if this programming fails too */
+	return flash_checkpoint_record(checkpoint, bank, offset, count, crc) == ERROR_OK;
+}
+
+static int flash_write_run_diff(struct target *target, struct flash_bank *bank,
+	const uint8_t *buffer, target_addr_t address, uint32_t size, bool erase,
+	struct flash_checkpoint *checkpoint, uint32_t *programmed)
+{
+	uint32_t run_offset = address - bank->base;
+	uint32_t run_end = run_offset + size;
+	/* differing sectors not programmed yet */
+	uint32_t diff_offset = run_offset;
+	uint32_t diff_end = run_offset;
+	unsigned int sectors = 0;
+	unsigned int skipped = 0;
+	int retval;
+
+	*programmed = 0;
+
+	/* after a small change most sectors match, but all do after a repeated write */
+	if (!checkpoint && flash_driver_matches(bank, buffer, run_offset, size)) {
+		LOG_INFO("flash at " TARGET_ADDR_FMT " already holds the %" PRIu32
+			" bytes of the image, skipped", address, size);
+		return ERROR_OK;
+	}
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		uint32_t offset = MAX(sector->offset, run_offset);
+		uint32_t end = MIN(sector->offset + sector->size, run_end);
+
+		if (offset >= end)
+			continue;
+
+		sectors++;
+		if (flash_write_run_skip(bank, buffer + offset - run_offset, offset,
+					end - offset, checkpoint)) {
+			skipped++;
+			continue;
+		}
+
+		/* a checkpoint is recorded now and then */
+		if (offset != diff_end || (checkpoint &&
+					diff_end - diff_offset >= FLASH_CHECKPOINT_INTERVAL)) {
+			if (diff_end > diff_offset) {
+				retval = flash_write_range_recorded(target, bank,
+						buffer + diff_offset - run_offset, diff_offset,
+						diff_end - diff_offset, erase, checkpoint);
+				if (retval != ERROR_OK)
+					return retval;
+				*programmed += diff_end - diff_offset;
+			}
+			diff_offset = offset;
+		}
+		diff_end = end;
+	}
+
+	/* no sector list, or the differing sectors at the end */
+	if (!sectors) {
+		diff_offset = run_offset;
+		diff_end = run_end;
+		if (checkpoint && flash_write_run_skip(bank, buffer, run_offset, size, checkpoint))
+			diff_end = diff_offset;
+	}
+	if (diff_end > diff_offset) {
+		retval = flash_write_range_recorded(target, bank, buffer + diff_offset - run_offset,
+				diff_offset, diff_end - diff_offset, erase, checkpoint);
+		if (retval != ERROR_OK)
+			return retval;
+		*programmed += diff_end - diff_offset;
+	}
+
+	if (checkpoint)
+		LOG_INFO("%u of %u sectors at " TARGET_ADDR_FMT " written earlier, skipped",
+			skipped, sectors, address);
+	else
+		LOG_INFO("%u of %u sectors at " TARGET_ADDR_FMT " already matched the image, skipped",
+			skipped, sectors, address);
+
+	return ERROR_OK;
+}
+
+/* write and verify a run of the image, @a buffer holds its @a size bytes */
+static int flash_write_run(struct target *target, struct flash_bank *bank,
+	const uint8_t *buffer, target_addr_t address, uint32_t size, bool erase,
+	bool write, bool verify, bool only_diff, struct flash_checkpoint *checkpoint,
+	uint32_t *run_written)
+{
+	int retval;
+
+	*run_written = size;
+
+	if (only_diff && write) {
+		retval = flash_write_run_diff(target, bank, buffer, address, size,
+				erase, checkpoint, run_written);
+	} else {
+		/* the rest of the sectors, the other banks erase meanwhile */
+		retval = flash_erase_address_range_finish(bank);
+
+		if (retval == ERROR_OK && write)
+			retval = flash_driver_write(bank, buffer, address - bank->base, size);
+	}
+
+	if (retval == ERROR_OK && verify)
+		retval = flash_driver_verify(bank, buffer, address - bank->base, size);
+
+	return retval;
+}
+
+/* the sector holding @a offset of a bank, false if there is none */
+static bool flash_sector_bounds(struct flash_bank *bank, uint32_t offset,
+	uint32_t *start, uint32_t *end)
+{
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+
+		if (offset >= sector->offset && offset - sector->offset < sector->size) {
+			*start = sector->offset;
+			*end = sector->offset + sector->size;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Split a run of @a size bytes at @a offset of a bank, padded with @a head
+ * bytes before and @a tail bytes after the image data, in its padded first
+ * sector up to @a head_end, the data in between and its padded last sector
+ * from @a tail_start on.
+ * @returns false if the padding does not fit in those sectors
+ */
+static bool flash_write_run_split(struct flash_bank *bank, uint32_t offset,
+	uint32_t size, uint32_t head, uint32_t tail, uint32_t *head_end,
+	uint32_t *tail_start)
+{
+	uint32_t end = offset + size;
+	uint32_t start, stop;
+
+	*head_end = offset;
+	*tail_start = end;
+
+	if (head) {
+		if (!flash_sector_bounds(bank, offset, &start, &stop))
+			return false;
+		*head_end = MIN(stop, end);
+	}
+	if (tail) {
+		if (!flash_sector_bounds(bank, end - 1, &start, &stop))
+			return false;
+		*tail_start = MAX(start, offset);
+	}
+
+	return *head_end - offset >= head && end - *tail_start >= tail
+		&& *head_end <= *tail_start;
+}
+
+/*
+ * Write a run split by flash_write_run_split() straight from the @a data of
+ * the image. The drivers want the padding in the same buffer, so only the
+ * padded first and last sector are copied and written on their own.
+ */
+static int flash_write_run_mapped(struct target *target, struct flash_bank *bank,
+	const uint8_t *data, target_addr_t address, uint32_t size, uint32_t head,
+	uint32_t tail, uint32_t head_end, uint32_t tail_start, bool erase,
+	bool write, bool verify, bool only_diff, struct flash_checkpoint *checkpoint,
+	uint32_t *run_written)
+{
+	uint32_t offset = address - bank->base;
+	uint32_t end = offset + size;
+
+	*run_written = 0;
+
+	/* the padded head, the data in place, the padded tail */
+	uint32_t pieces[][2] = {
+		{ offset, head_end },
+		{ head_end, tail_start },
+		{ tail_start, end },
+	};
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(pieces); i++) {
+		uint32_t from = pieces[i][0];
+		uint32_t count = pieces[i][1] - from;
+		uint32_t piece_written;
+		uint8_t *buffer = NULL;
+		int retval;
+
+		if (!count)
+			continue;
+
+		if (i != 1) {
+			buffer = malloc(count);
+			if (!buffer) {
+				LOG_ERROR("Out of memory for flash bank buffer");
+				return ERROR_FAIL;
+			}
+			/* the run bytes [head, size - tail) are the data */
+			for (uint32_t j = 0; j < count; j++) {
+				uint32_t idx = from - offset + j;
+				buffer[j] = (idx < head || idx >= size - tail) ?
+					bank->default_padded_value : data[idx - head];
+			}
+		}
+
+		retval = flash_write_run(target, bank,
+				buffer ? buffer : data + from - offset - head,
+				bank->base + from, count, erase, write, verify, only_diff,
+				checkpoint, &piece_written);
+		free(buffer);
+		if (retval != ERROR_OK)
+			return retval;
+
+		*run_written += piece_written;
+	}
+
+	return ERROR_OK;
+}
+
+/* the range of the image in a bank */
+struct flash_write_extent {
+	struct flash_bank *bank;
+	target_addr_t start;
+	target_addr_t end;
+	/* the image has sectors of the bank left untouched between its sections */
+	bool split;
+};
+
+/*
+ * With an image over several banks able to erase in parallel, start erasing
+ * all of them before writing the first run, the erase of each bank then goes
+ * on while the others are erased or written. With @a all, start erasing the
+ * image's range of every bank. @a ahead gets the banks whose range is getting
+ * erased, NULL terminated.
+ */
+static int flash_write_erase_ahead(struct target *target,
+	struct imagesection **sections, unsigned int num_sections, bool unlock,
+	bool all, struct flash_bank **ahead)
+{
+	struct flash_write_extent extents[FLASH_ERASE_PENDING_MAX];
+	unsigned int num_extents = 0;
+	unsigned int num_ahead = 0;
+
+	ahead[0] = NULL;
+
+	for (unsigned int i = 0; i < num_sections; i++) {
+		target_addr_t addr = sections[i]->base_address;
+		target_addr_t end = addr + sections[i]->size;
+
+		/* a section may span banks */
+		while (addr < end) {
+			struct flash_bank *c;
+			int retval = get_flash_bank_by_addr(target, addr, false, &c);
+			if (retval != ERROR_OK)
+				return retval;
+			if (!c)
+				break;
+
+			target_addr_t bank_end = MIN(end, c->base + c->size);
+			struct flash_write_extent *extent = NULL;
+
+			for (unsigned int j = 0; j < num_extents; j++)
+				if (extents[j].bank == c)
+					extent = &extents[j];
+
+			if (extent) {
+				if (addr > extent->end && flash_write_check_gap(c, extent->end - 1, addr))
+					extent->split = true;
+				extent->end = MAX(extent->end, bank_end);
+			} else if ((all || c->parallel_group) && num_extents < FLASH_ERASE_PENDING_MAX) {
+				extents[num_extents++] = (struct flash_write_extent) {
+					.bank = c,
+					.start = addr,
+					.end = bank_end,
+				};
+			}
+
+			addr = bank_end;
+		}
+	}
+
+	for (unsigned int i = 0; i < num_extents; i++) {
+		bool parallel = all;
+
+		if (extents[i].split)
+			continue;
+
+		for (unsigned int j = 0; j < num_extents; j++)
+			if (!extents[j].split && flash_banks_parallel(extents[i].bank, extents[j].bank))
+				parallel = true;
+
+		/* one bank alone erases while the image is read, as usual */
+		if (!parallel)
+			continue;
+
+		uint32_t length = extents[i].end - extents[i].start;
+		int retval = ERROR_OK;
+		if (unlock)
+			retval = flash_unlock_address_range(target, extents[i].start, length);
+		if (retval == ERROR_OK)
+			retval = flash_erase_address_range_needed(target, extents[i].bank,
+					extents[i].start, length);
+		if (retval != ERROR_OK) {
+			flash_erase_pending_cancel();
+			return retval;
+		}
+
+		ahead[num_ahead++] = extents[i].bank;
+		ahead[num_ahead] = NULL;
+	}
+
+	if (num_ahead)
+		LOG_INFO("erasing %u flash banks in parallel", num_ahead);
+
+	return ERROR_OK;
+}
+
 int flash_write_unlock_verify(struct target *target, struct image *image,
-	uint32_t *written, bool erase, bool unlock, bool write, bool verify)
+	uint32_t *written, bool erase, bool unlock, bool write, bool verify,
+	bool only_diff, struct flash_checkpoint *checkpoint)
 {
 	int retval = ERROR_OK;
 
@@ -743,6 +1631,10 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 	if (written)
 		*written = 0;
 
+	/* each sector is erased when written, those written earlier are kept */
+	if (checkpoint)
+		only_diff = true;
+
 	if (erase) {
 		/* assume all sectors need erasing - stops any problems
 		 * when flash_write is called multiple times */
@@ -764,6 +1656,15 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 	qsort(sections, image->num_sections, sizeof(struct imagesection *),
 		compare_section);
 
+	/* the banks erased in parallel from the start */
+	struct flash_bank *ahead[FLASH_ERASE_PENDING_MAX + 1] = { NULL };
+	if (erase && !(only_diff && write)) {
+		retval = flash_write_erase_ahead(target, sections, image->num_sections,
+				unlock, false, ahead);
+		if (retval != ERROR_OK)
+			goto done;
+	}
+
 	/* loop until we reach end of the image */
 	while (section < image->num_sections) {
 		uint32_t buffer_idx;
@@ -894,10 +1795,57 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 			run_size += delta;
 		}
 
+		bool erased_ahead = false;
+		for (unsigned int i = 0; ahead[i]; i++)
+			if (ahead[i] == c)
+				erased_ahead = true;
+
+		/* the image is read while the driver, if it can, erases the first sector */
+		retval = ERROR_OK;
+		if (unlock && !erased_ahead)
+			retval = flash_unlock_address_range(target, run_address, run_size);
+		/* with diff, the sectors to erase are only known from the image */
+		if (retval == ERROR_OK && erase && !(only_diff && write) && !erased_ahead)
+			retval = flash_erase_address_range_needed(target, c, run_address, run_size);
+		if (retval != ERROR_OK)
+			goto done;
+
+		/* the number of the sorted section in the image */
+		int section_num = sections[section] - image->sections;
+		uint32_t run_written;
+
+		/* a run of a single section is written from the image in place */
+		uint32_t data_size = run_size - padding_at_start - padding[section];
+		uint32_t head_end, tail_start;
+		const uint8_t *data;
+		if (section_last == section && padding_at_start + padding[section] < run_size
+				&& data_size <= sections[section]->size - section_offset
+				&& flash_write_run_split(c, run_address - c->base, run_size,
+					padding_at_start, padding[section], &head_end, &tail_start)
+				&& image_section_data(image, section_num, section_offset,
+					data_size, &data) == ERROR_OK) {
+			retval = flash_write_run_mapped(target, c, data, run_address, run_size,
+					padding_at_start, padding[section], head_end, tail_start,
+					erase, write, verify, only_diff, checkpoint, &run_written);
+			if (retval != ERROR_OK)
+				goto done;
+
+			section_offset += data_size;
+			if (section_offset >= sections[section]->size) {
+				section++;
+				section_offset = 0;
+			}
+
+			if (written)
+				*written += run_written;
+			continue;
+		}
+
 		/* allocate buffer */
 		buffer = malloc(run_size);
 		if (!buffer) {
 			LOG_ERROR("Out of memory for flash bank buffer");
+			flash_erase_pending_cancel();
 			retval = ERROR_FAIL;
 			goto done;
 		}
@@ -927,9 +1875,12 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 					"section_offset = %"PRIu32", buffer_idx = %"PRIu32", size_read = %zu",
 				section, t_section_num, section_offset,
 				buffer_idx, size_read);
+			int64_t begin = timeval_us();
 			retval = image_read_section(image, t_section_num, section_offset,
 					size_read, buffer + buffer_idx, &size_read);
+			flash_phase_add(FLASH_PHASE_READ_IMAGE, begin, size_read);
 			if (retval != ERROR_OK || size_read == 0) {
+				flash_erase_pending_cancel();
 				free(buffer);
 				goto done;
 			}
@@ -949,31 +1900,8 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 			}
 		}
 
-		retval = ERROR_OK;
-
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
-		}
-
-		if (retval == ERROR_OK) {
-			if (write) {
-				/* write flash sectors */
-				retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
-			}
-		}
-
-		if (retval == ERROR_OK) {
-			if (verify) {
-				/* verify flash sectors */
-				retval = flash_driver_verify(c, buffer, run_address - c->base, run_size);
-			}
-		}
+		retval = flash_write_run(target, c, buffer, run_address, run_size,
+				erase, write, verify, only_diff, checkpoint, &run_written);
 
 		free(buffer);
 
@@ -983,20 +1911,53 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 		}
 
 		if (written)
-			*written += run_size;	/* add run size to total written counter */
+			*written += run_written;	/* add run size to total written counter */
 	}
 
 done:
+	/* banks erased ahead which the write did not reach */
+	flash_erase_pending_cancel();
+
 	free(sections);
 	free(padding);
 
 	return retval;
 }
 
+int flash_erase_image_start(struct target *target, struct image *image, bool unlock)
+{
+	struct imagesection **sections = malloc(sizeof(struct imagesection *) *
+			image->num_sections);
+	if (!sections) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < image->num_sections; i++)
+		sections[i] = &image->sections[i];
+
+	qsort(sections, image->num_sections, sizeof(struct imagesection *),
+		compare_section);
+
+	struct flash_bank *ahead[FLASH_ERASE_PENDING_MAX + 1];
+	int retval = flash_write_erase_ahead(target, sections, image->num_sections,
+			unlock, true, ahead);
+
+	free(sections);
+
+	return retval;
+}
+
+int flash_erase_image_finish(void)
+{
+	return flash_erase_address_range_finish(NULL);
+}
+
 int flash_write(struct target *target, struct image *image,
 	uint32_t *written, bool erase)
 {
-	return flash_write_unlock_verify(target, image, written, erase, false, true, false);
+	return flash_write_unlock_verify(target, image, written, erase, false, true, false,
+			false, NULL);
 }
 
 struct flash_sector *alloc_block_array(uint32_t offset, uint32_t size,
@@ -105,6 +105,10 @@ struct flash_bank {
 	 * sectors in between.
      * Can be size in bytes or FLASH_WRITE_CONTINUOUS */
 	uint32_t minimal_write_gap;
+	/** Banks of a target with the same non-zero group have flash controllers
+	 * of their own, the core erases one while it erases or programs another.
+	 * Default 0, the driver sets it for banks supporting erase_start. */
+	unsigned int parallel_group;
 
 	/**
 	 * The number of sectors on this chip.  This value will
@@ -125,6 +129,15 @@ struct flash_bank {
 	/** Array of protection blocks, allocated and initialized by the flash driver */
 	struct flash_sector *prot_blocks;
 
+	/**
+	 * Per sector, the offset from which the core knows the sector is still
+	 * erased since it erased it in this session, the sector size if it knows
+	 * nothing.  NULL until an erase, managed by the core only.
+	 */
+	uint32_t *erased_from;
+	/** Number of sectors when erased_from was allocated */
+	unsigned int erased_num_sectors;
+
 	struct flash_bank *next; /**< The next flash bank on this chip */
 };
 
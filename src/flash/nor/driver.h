@@ -96,6 +96,30 @@ struct flash_driver {
 	int (*erase)(struct flash_bank *bank, unsigned int first,
 		unsigned int last);
 
+	/**
+	 * Start erasing a sector and return without waiting for the end of
+	 * the erase.  Optional, together with erase_wait.  It lets the core
+	 * read the image and prepare the data to program while the device
+	 * erases, which pays off on the sectors with long erase times.
+	 *
+	 * No other driver method but erase_wait is called for the bank before
+	 * the erase completes.  With flash_bank::parallel_group set, the
+	 * methods of the other banks of the group are.
+	 *
+	 * @param bank The bank of flash to be erased.
+	 * @param sector The number of the sector to erase.
+	 * @returns ERROR_OK if the erase started; otherwise, an error code.
+	 */
+	int (*erase_start)(struct flash_bank *bank, unsigned int sector);
+
+	/**
+	 * Wait for the end of the erase started by erase_start.
+	 *
+	 * @param bank The bank of flash being erased.
+	 * @returns ERROR_OK if the sector was erased; otherwise, an error code.
+	 */
+	int (*erase_wait)(struct flash_bank *bank);
+
 	/**
 	 * Bank/sector protection routine (target-specific).
 	 *
@@ -109,6 +109,9 @@
 #define FESPI_PROBE_TIMEOUT (100)
 #define FESPI_MAX_TIMEOUT  (3000)
 
+/* Largest FIFO of the streamed writes, in bytes */
+#define FESPI_ASYNC_FIFO_SIZE	(16 * 1024)
+
 
 struct fespi_flash_bank {
 	bool probed;
@@ -275,37 +278,41 @@ static int fespi_rx(struct flash_bank *bank, uint8_t *out)
 }
 
 /* TODO!!! Why don't we need to call this after writing? */
-static int fespi_wip(struct flash_bank *bank, int timeout)
+/* the status, read continuously as long as the chip select is held */
+static int fespi_read_held_status(struct flash_bank *bank, uint32_t *status)
 {
-	int64_t endtime;
+	uint8_t rx;
+
+	fespi_tx(bank, 0);
+	if (fespi_rx(bank, &rx) != ERROR_OK)
+		return ERROR_FAIL;
+
+	*status = rx;
+	return ERROR_OK;
+}
 
+/* timeout in ms */
+static int fespi_wip(struct flash_bank *bank, uint32_t typical, int timeout)
+{
 	fespi_set_dir(bank, FESPI_DIR_RX);
 
 	if (fespi_write_reg(bank, FESPI_REG_CSMODE, FESPI_CSMODE_HOLD) != ERROR_OK)
 		return ERROR_FAIL;
-	endtime = timeval_ms() + timeout;
 
 	fespi_tx(bank, SPIFLASH_READ_STATUS);
 	if (fespi_rx(bank, NULL) != ERROR_OK)
 		return ERROR_FAIL;
 
-	do {
-		alive_sleep(1);
+	int retval = spi_wait_ready(bank, fespi_read_held_status, SPIFLASH_BSY_BIT,
+		typical, timeout);
+	if (retval != ERROR_OK)
+		return retval;
 
-		fespi_tx(bank, 0);
-		uint8_t rx;
-		if (fespi_rx(bank, &rx) != ERROR_OK)
-			return ERROR_FAIL;
-		if ((rx & SPIFLASH_BSY_BIT) == 0) {
-			if (fespi_write_reg(bank, FESPI_REG_CSMODE, FESPI_CSMODE_AUTO) != ERROR_OK)
-				return ERROR_FAIL;
-			fespi_set_dir(bank, FESPI_DIR_TX);
-			return ERROR_OK;
-		}
-	} while (timeval_ms() < endtime);
+	if (fespi_write_reg(bank, FESPI_REG_CSMODE, FESPI_CSMODE_AUTO) != ERROR_OK)
+		return ERROR_FAIL;
+	fespi_set_dir(bank, FESPI_DIR_TX);
 
-	LOG_ERROR("timeout");
-	return ERROR_FAIL;
+	return ERROR_OK;
 }
 
 static int fespi_erase_sector(struct flash_bank *bank, int sector)
@@ -346,7 +353,7 @@ static int fespi_erase_sector(struct flash_bank *bank, int sector)
 	if (fespi_write_reg(bank, FESPI_REG_CSMODE, FESPI_CSMODE_AUTO) != ERROR_OK)
 		return ERROR_FAIL;
 
-	retval = fespi_wip(bank, FESPI_MAX_TIMEOUT);
+	retval = fespi_wip(bank, fespi_info->dev->erase_time_ms, FESPI_MAX_TIMEOUT);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -400,7 +407,7 @@ static int fespi_erase(struct flash_bank *bank, unsigned int first,
 		return ERROR_FAIL;
 
 	/* poll WIP */
-	retval = fespi_wip(bank, FESPI_PROBE_TIMEOUT);
+	retval = fespi_wip(bank, 0, FESPI_PROBE_TIMEOUT);
 	if (retval != ERROR_OK)
 		goto done;
 
@@ -478,6 +485,110 @@ static const uint8_t riscv64_bin[] = {
 #include "../../../contrib/loaders/flash/fespi/riscv64_fespi.inc"
 };
 
+static const uint8_t riscv32_async_bin[] = {
+#include "../../../contrib/loaders/flash/fespi/riscv32_fespi_async.inc"
+};
+
+static const uint8_t riscv64_async_bin[] = {
+#include "../../../contrib/loaders/flash/fespi/riscv64_fespi_async.inc"
+};
+
+/* Stream the data to the loader through a FIFO in the working area, while it
+ * runs. Needs the memory to be accessible while the hart runs; returns
+ * ERROR_TARGET_RESOURCE_NOT_AVAILABLE, before touching the flash, if the
+ * working area is too small. */
+static int fespi_write_async(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	struct target *target = bank->target;
+	struct fespi_flash_bank *fespi_info = bank->driver_priv;
+	unsigned int xlen = riscv_xlen(target);
+	struct working_area *algorithm_wa;
+	struct working_area *fifo_wa;
+	const uint8_t *bin;
+	size_t bin_size;
+	int retval;
+
+	if (xlen == 32) {
+		bin = riscv32_async_bin;
+		bin_size = sizeof(riscv32_async_bin);
+	} else {
+		bin = riscv64_async_bin;
+		bin_size = sizeof(riscv64_async_bin);
+	}
+
+	if (target_alloc_working_area(target, bin_size, &algorithm_wa) != ERROR_OK) {
+		LOG_DEBUG("no working area for the streamed write");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	retval = target_write_buffer(target, algorithm_wa->address, bin_size, bin);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, algorithm_wa);
+		return retval;
+	}
+
+	uint32_t fifo_size = FESPI_ASYNC_FIFO_SIZE;
+	while (target_alloc_working_area_try(target, fifo_size, &fifo_wa) != ERROR_OK) {
+		fifo_size /= 2;
+		if (fifo_size <= 256) {
+			target_free_working_area(target, algorithm_wa);
+			LOG_DEBUG("no working area for the FIFO of the streamed write");
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+	}
+
+	/* the loader and target_run_flash_async_algorithm() use 32-bit pointers */
+	if (fifo_wa->address + fifo_size > UINT32_MAX) {
+		target_free_working_area(target, fifo_wa);
+		target_free_working_area(target, algorithm_wa);
+		LOG_DEBUG("FIFO of the streamed write above 4 GiB");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	uint32_t page_size = fespi_info->dev->pagesize ?
+		fespi_info->dev->pagesize : SPIFLASH_DEF_PAGESIZE;
+
+	/* the arguments, then the registers the loader uses, to have them restored */
+	static char * const reg_names[] = {
+		"a0", "a1", "a2", "a3", "a4", "a5", "t0",
+		"t1", "t2", "s0", "s1", "ra", "sp", "gp", "tp",
+	};
+	const uint64_t args[] = {
+		fespi_info->ctrl_base,
+		page_size,
+		fifo_wa->address,
+		fifo_wa->address + fifo_size,
+		offset,
+		count,
+		fespi_info->dev->pprog_cmd | (bank->size > 0x1000000 ? 0x100 : 0),
+	};
+	struct reg_param reg_params[ARRAY_SIZE(reg_names)];
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_names); i++) {
+		init_reg_param(&reg_params[i], reg_names[i], xlen, i ? PARAM_OUT : PARAM_IN_OUT);
+		buf_set_u64(reg_params[i].value, 0, xlen, i < ARRAY_SIZE(args) ? args[i] : 0);
+	}
+
+	LOG_DEBUG("streamed write of 0x%" PRIx32 " bytes at 0x%" PRIx32 ", FIFO of %" PRIu32 " bytes",
+			count, offset, fifo_size);
+
+	retval = target_run_flash_async_algorithm(target, buffer, count, 1,
+			0, NULL, ARRAY_SIZE(reg_params), reg_params,
+			fifo_wa->address, fifo_size, algorithm_wa->address, 0, NULL);
+	if (retval == ERROR_FLASH_OPERATION_FAILED)
+		LOG_ERROR("fespi loader returned error %" PRIu64,
+				buf_get_u64(reg_params[0].value, 0, xlen));
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_params); i++)
+		destroy_reg_param(&reg_params[i]);
+
+	target_free_working_area(target, fifo_wa);
+	target_free_working_area(target, algorithm_wa);
+
+	return retval;
+}
+
 static int fespi_write(struct flash_bank *bank, const uint8_t *buffer,
 		uint32_t offset, uint32_t count)
 {
@@ -518,6 +629,12 @@ static int fespi_write(struct flash_bank *bank, const uint8_t *buffer,
 		return ERROR_FAIL;
 	}
 
+	if (riscv_access_memory_running(target)) {
+		retval = fespi_write_async(bank, buffer, offset, count);
+		if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			return retval;
+	}
+
 	unsigned int xlen = riscv_xlen(target);
 	struct working_area *algorithm_wa = NULL;
 	struct working_area *data_wa = NULL;
@@ -625,7 +742,7 @@ static int fespi_write(struct flash_bank *bank, const uint8_t *buffer,
 			return ERROR_FAIL;
 
 		/* poll WIP */
-		retval = fespi_wip(bank, FESPI_PROBE_TIMEOUT);
+		retval = fespi_wip(bank, 0, FESPI_PROBE_TIMEOUT);
 		if (retval != ERROR_OK)
 			goto err;
 
@@ -681,7 +798,7 @@ static int fespi_read_flash_id(struct flash_bank *bank, uint32_t *id)
 	fespi_txwm_wait(bank);
 
 	/* poll WIP */
-	retval = fespi_wip(bank, FESPI_PROBE_TIMEOUT);
+	retval = fespi_wip(bank, 0, FESPI_PROBE_TIMEOUT);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -772,12 +889,7 @@ static int fespi_probe(struct flash_bank *bank)
 	if (retval != ERROR_OK)
 		return retval;
 
-	fespi_info->dev = NULL;
-	for (const struct flash_device *p = flash_devices; p->name ; p++)
-		if (p->device_id == id) {
-			fespi_info->dev = p;
-			break;
-		}
+	fespi_info->dev = spi_flash_device_by_id(id);
 
 	if (!fespi_info->dev) {
 		LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
@@ -26,6 +26,9 @@ void flash_bank_add(struct flash_bank *bank);
  */
 struct flash_bank *flash_bank_list(void);
 
+/** Forget which sectors of @a bank the core erased in the session */
+void flash_forget_erased(struct flash_bank *bank);
+
 int flash_driver_erase(struct flash_bank *bank, unsigned int first,
 		unsigned int last);
 int flash_driver_protect(struct flash_bank *bank, int set, unsigned int first,
@@ -37,8 +40,91 @@ int flash_driver_read(struct flash_bank *bank,
 int flash_driver_verify(struct flash_bank *bank,
 		const uint8_t *buffer, uint32_t offset, uint32_t count);
 
-/* write (optional verify) an image to flash memory of the given target */
+struct flash_checkpoint_sector;
+
+/* Sectors written and verified, saved to a file to resume the programming */
+struct flash_checkpoint {
+	FILE *file;
+	uint32_t image_crc;
+	/* the unique ID of the device, in hex, NULL if unknown */
+	char *uid;
+	/* those of the programming being resumed, sorted */
+	struct flash_checkpoint_sector *sectors;
+	unsigned int num_sectors;
+};
+
+enum flash_checkpoint_mode {
+	/* record the sectors written */
+	FLASH_CHECKPOINT_NEW,
+	/* skip those recorded for the same image */
+	FLASH_CHECKPOINT_RESUME,
+	/* skip those recorded for any image, the last one programmed */
+	FLASH_CHECKPOINT_MANIFEST,
+};
+
+/*
+ * Start a checkpoint file for writing @a image, after loading the sectors
+ * recorded in it as @a mode says. A file of another device @a uid, if
+ * known, is ignored.
+ */
+int flash_checkpoint_open(struct flash_checkpoint *checkpoint, const char *path,
+		struct image *image, enum flash_checkpoint_mode mode, const char *uid);
+void flash_checkpoint_close(struct flash_checkpoint *checkpoint);
+/* @returns true if the programming being resumed wrote these data there */
+bool flash_checkpoint_done(const struct flash_checkpoint *checkpoint,
+		const struct flash_bank *bank, uint32_t offset, uint32_t size, uint32_t crc);
+int flash_checkpoint_record(struct flash_checkpoint *checkpoint,
+		const struct flash_bank *bank, uint32_t offset, uint32_t size, uint32_t crc);
+uint32_t flash_checkpoint_crc(const uint8_t *buffer, uint32_t count);
+
+/*
+ * write (optional verify) an image to flash memory of the given target,
+ * with @a only_diff only the sectors whose contents differ from the image.
+ * With a @a checkpoint the sectors are recorded as they are written and
+ * verified, and those recorded earlier are skipped if the flash still
+ * matches them.
+ */
 int flash_write_unlock_verify(struct target *target, struct image *image,
-		uint32_t *written, bool erase, bool unlock, bool write, bool verify);
+		uint32_t *written, bool erase, bool unlock, bool write, bool verify,
+		bool only_diff, struct flash_checkpoint *checkpoint);
+
+/*
+ * Start erasing the sectors of the flash of @a target the image is written
+ * to, without waiting. The erases of several targets run in parallel until
+ * flash_erase_image_finish(). The sectors without sections in between are
+ * left to flash_write_unlock_verify().
+ */
+int flash_erase_image_start(struct target *target, struct image *image, bool unlock);
+/* Wait for the end of the erases started by flash_erase_image_start() */
+int flash_erase_image_finish(void);
+
+enum flash_phase {
+	FLASH_PHASE_ERASE,
+	FLASH_PHASE_READ_IMAGE,
+	FLASH_PHASE_WRITE,
+	FLASH_PHASE_VERIFY,
+	FLASH_PHASES,
+};
+
+/* Time taken by the flash operations, for the reports of their throughput */
+struct flash_stats {
+	int64_t start;
+	struct {
+		int64_t us;
+		uint64_t bytes;
+		unsigned int calls;
+	} phase[FLASH_PHASES];
+	/* the metrics of the adapter and the flash loaders at the start */
+	uint64_t program_wait_ms;
+	uint64_t dap_runs;
+	uint64_t dap_run_us;
+	uint64_t jtag_flushes;
+	uint64_t jtag_flush_us;
+};
+
+/* Start measuring the flash operations */
+void flash_stats_start(struct flash_stats *stats);
+/* Print the time taken by each phase since flash_stats_start() */
+void flash_stats_print(struct command_invocation *cmd, const struct flash_stats *stats);
 
 #endif /* OPENOCD_FLASH_NOR_IMP_H */
@@ -11,10 +11,20 @@
 #include "imp.h"
 #include <jtag/jtag.h>
 #include <flash/nor/spi.h>
+#include <flash/nor/sfdp.h>
+#include <jtag/adapter.h>
 #include <helper/time_support.h>
 
 #define JTAGSPI_MAX_TIMEOUT 3000
 
+/* pages programmed with a single execution of the JTAG queue */
+#define JTAGSPI_PIPELINE_PAGES 32
+/* bytes read with a single execution of the JTAG queue */
+#define JTAGSPI_PIPELINE_READ_SIZE (256 * 1024)
+/* page program time assumed without SFDP, and the longest one waited for */
+#define JTAGSPI_DEF_PPROG_TIME_US 1000
+#define JTAGSPI_MAX_PPROG_TIME_US 10000
+
 
 struct jtagspi_flash_bank {
 	struct jtag_tap *tap;
@@ -24,6 +34,7 @@ struct jtagspi_flash_bank {
 	bool always_4byte;			/* use always 4-byte address except for basic read 0x03 */
 	uint32_t ir;
 	unsigned int addr_len;		/* address length in bytes */
+	uint32_t pprog_wait_us;		/* wait for a pipelined page program */
 };
 
 FLASH_BANK_COMMAND_HANDLER(jtagspi_flash_bank_command)
@@ -68,20 +79,27 @@ static void flip_u8(const uint8_t *in, uint8_t *out, unsigned int len)
 		out[i] = flip_u32(in[i], 8);
 }
 
-static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
-		uint8_t *write_buffer, unsigned int write_len, uint8_t *data_buffer, int data_len)
+/* the address and dummy bytes, or the bytes of 'jtagspi cmd', after a command */
+#define JTAGSPI_MAX_WRITE_LEN 32
+
+/*
+ * Queue a command, with @a data_len bytes to write from @a data_out or read
+ * to @a data_in. The bytes read are bit reversed until flip_u8() once the
+ * queue is executed, so @a data_in must last until then.
+ */
+static int jtagspi_queue_cmd(struct flash_bank *bank, uint8_t cmd,
+		const uint8_t *write_buffer, unsigned int write_len,
+		const uint8_t *data_out, uint8_t *data_in, unsigned int data_len)
 {
 	assert(write_buffer || write_len == 0);
-	assert(data_buffer || data_len == 0);
+	assert(write_len <= JTAGSPI_MAX_WRITE_LEN);
+	assert(!(data_out && data_in));
 
 	struct scan_field fields[6];
+	uint8_t write_bits[JTAGSPI_MAX_WRITE_LEN];
+	uint8_t *data_bits = NULL;
 
-	LOG_DEBUG("cmd=0x%02x write_len=%d data_len=%d", cmd, write_len, data_len);
-
-	/* negative data_len == read operation */
-	const bool is_read = (data_len < 0);
-	if (is_read)
-		data_len = -data_len;
+	LOG_DEBUG("cmd=0x%02x write_len=%u data_len=%u", cmd, write_len, data_len);
 
 	int n = 0;
 	const uint8_t marker = 1;
@@ -107,25 +125,31 @@ static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
 	n++;
 
 	if (write_len) {
-		flip_u8(write_buffer, write_buffer, write_len);
+		flip_u8(write_buffer, write_bits, write_len);
 		fields[n].num_bits = write_len * CHAR_BIT;
-		fields[n].out_value = write_buffer;
+		fields[n].out_value = write_bits;
 		fields[n].in_value = NULL;
 		n++;
 	}
 
 	if (data_len > 0) {
-		if (is_read) {
+		if (data_in) {
 			fields[n].num_bits = jtag_tap_count_enabled();
 			fields[n].out_value = NULL;
 			fields[n].in_value = NULL;
 			n++;
 
 			fields[n].out_value = NULL;
-			fields[n].in_value = data_buffer;
+			fields[n].in_value = data_in;
 		} else {
-			flip_u8(data_buffer, data_buffer, data_len);
-			fields[n].out_value = data_buffer;
+			/* the caller's data stays as it is, the queue keeps a copy */
+			data_bits = malloc(data_len);
+			if (!data_bits) {
+				LOG_ERROR("not enough memory");
+				return ERROR_FAIL;
+			}
+			flip_u8(data_out, data_bits, data_len);
+			fields[n].out_value = data_bits;
 			fields[n].in_value = NULL;
 		}
 		fields[n].num_bits = data_len * CHAR_BIT;
@@ -136,13 +160,76 @@ static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
 	/* passing from an IR scan to SHIFT-DR clears BYPASS registers */
 	struct jtagspi_flash_bank *info = bank->driver_priv;
 	jtag_add_dr_scan(info->tap, n, fields, TAP_IDLE);
-	int retval = jtag_execute_queue();
+	free(data_bits);
+
+	return ERROR_OK;
+}
+
+static uint8_t *fill_addr(uint32_t addr, unsigned int addr_len, uint8_t *buffer)
+{
+	for (buffer += addr_len; addr_len > 0; --addr_len) {
+		*--buffer = addr;
+		addr >>= 8;
+	}
+
+	return buffer;
+}
+
+static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
+		uint8_t *write_buffer, unsigned int write_len, uint8_t *data_buffer, int data_len)
+{
+	assert(data_buffer || data_len == 0);
+
+	/* negative data_len == read operation */
+	const bool is_read = (data_len < 0);
+	if (is_read)
+		data_len = -data_len;
+
+	int retval = jtagspi_queue_cmd(bank, cmd, write_buffer, write_len,
+			is_read ? NULL : data_buffer, is_read ? data_buffer : NULL, data_len);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = jtag_execute_queue();
 
 	if (is_read)
 		flip_u8(data_buffer, data_buffer, data_len);
 	return retval;
 }
 
+static int jtagspi_read_sfdp_block(struct flash_bank *bank, uint32_t addr,
+		uint32_t words, uint32_t *buffer)
+{
+	/* 3-byte address and 8 dummy clocks */
+	uint8_t addr_dummy[4] = { 0 };
+	fill_addr(addr, 3, addr_dummy);
+
+	int retval = jtagspi_cmd(bank, SPIFLASH_READ_SFDP, addr_dummy, sizeof(addr_dummy),
+			(uint8_t *)buffer, -(int)(words * sizeof(*buffer)));
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (uint32_t i = 0; i < words; i++)
+		buffer[i] = le_to_h_u32((uint8_t *)&buffer[i]);
+
+	return ERROR_OK;
+}
+
+/* the page program time the pipelined write starts with */
+static void jtagspi_pprog_estimate(struct flash_bank *bank)
+{
+	struct jtagspi_flash_bank *info = bank->driver_priv;
+	uint32_t time_us;
+
+	/* 'jtagspi set' before the first probe */
+	if (info->tap && spi_sfdp_pprog_time(bank, jtagspi_read_sfdp_block, &time_us) == ERROR_OK) {
+		info->dev.pprog_time_us = time_us;
+		info->pprog_wait_us = time_us;
+	} else {
+		info->pprog_wait_us = JTAGSPI_DEF_PPROG_TIME_US;
+	}
+}
+
 COMMAND_HANDLER(jtagspi_handle_set)
 {
 	struct flash_bank *bank = NULL;
@@ -284,6 +371,7 @@ COMMAND_HANDLER(jtagspi_handle_set)
 	else
 		LOG_INFO("flash \'%s\' id = unknown\nflash size = %" PRIu32 " bytes",
 			info->dev.name, info->dev.size_in_bytes);
+	jtagspi_pprog_estimate(bank);
 	info->probed = true;
 
 	return ERROR_OK;
@@ -392,13 +480,13 @@ static int jtagspi_probe(struct flash_bank *bank)
 	id = le_to_h_u24(in_buf);
 
 	memset(&info->dev, 0, sizeof(info->dev));
-	for (p = flash_devices; p->name ; p++)
-		if (p->device_id == id) {
-			memcpy(&info->dev, p, sizeof(info->dev));
-			break;
-		}
-
-	if (!(p->name)) {
+	p = spi_flash_device_by_id(id);
+	if (p) {
+		memcpy(&info->dev, p, sizeof(info->dev));
+	} else if (spi_sfdp_cached(bank, &info->dev, id, jtagspi_read_sfdp_block) == ERROR_OK) {
+		/* spi_sfdp() clears all info */
+		info->dev.device_id = id;
+	} else {
 		LOG_ERROR("Unknown flash device (ID 0x%06" PRIx32 ")", id & 0xFFFFFF);
 		return ERROR_FAIL;
 	}
@@ -441,6 +529,7 @@ static int jtagspi_probe(struct flash_bank *bank)
 	}
 
 	bank->sectors = sectors;
+	jtagspi_pprog_estimate(bank);
 	info->probed = true;
 	return ERROR_OK;
 }
@@ -465,28 +554,10 @@ static int jtagspi_read_status(struct flash_bank *bank, uint32_t *status)
 	return err;
 }
 
-static int jtagspi_wait(struct flash_bank *bank, int timeout_ms)
+static int jtagspi_wait(struct flash_bank *bank, uint32_t typical_ms, int timeout_ms)
 {
-	int64_t t0 = timeval_ms();
-	int64_t dt;
-
-	do {
-		dt = timeval_ms() - t0;
-
-		uint32_t status = (uint32_t)-1;
-		int retval = jtagspi_read_status(bank, &status);
-		if (retval != ERROR_OK)
-			return retval;
-
-		if ((status & SPIFLASH_BSY_BIT) == 0) {
-			LOG_DEBUG("waited %" PRId64 " ms", dt);
-			return ERROR_OK;
-		}
-		alive_sleep(1);
-	} while (dt <= timeout_ms);
-
-	LOG_ERROR("timeout, device still busy");
-	return ERROR_FAIL;
+	return spi_wait_ready(bank, jtagspi_read_status, SPIFLASH_BSY_BIT, typical_ms,
+		timeout_ms);
 }
 
 static int jtagspi_write_enable(struct flash_bank *bank)
@@ -522,21 +593,12 @@ static int jtagspi_bulk_erase(struct flash_bank *bank)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = jtagspi_wait(bank, bank->num_sectors * JTAGSPI_MAX_TIMEOUT);
+	retval = jtagspi_wait(bank, info->dev.chip_erase_time_ms,
+		bank->num_sectors * JTAGSPI_MAX_TIMEOUT);
 	LOG_INFO("took %" PRId64 " ms", timeval_ms() - t0);
 	return retval;
 }
 
-static uint8_t *fill_addr(uint32_t addr, unsigned int addr_len, uint8_t *buffer)
-{
-	for (buffer += addr_len; addr_len > 0; --addr_len) {
-		*--buffer = addr;
-		addr >>= 8;
-	}
-
-	return buffer;
-}
-
 static int jtagspi_sector_erase(struct flash_bank *bank, unsigned int sector)
 {
 	struct jtagspi_flash_bank *info = bank->driver_priv;
@@ -556,7 +618,7 @@ static int jtagspi_sector_erase(struct flash_bank *bank, unsigned int sector)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = jtagspi_wait(bank, JTAGSPI_MAX_TIMEOUT);
+	retval = jtagspi_wait(bank, info->dev.erase_time_ms, JTAGSPI_MAX_TIMEOUT);
 	LOG_INFO("sector %u took %" PRId64 " ms", sector, timeval_ms() - t0);
 	return retval;
 }
@@ -641,21 +703,34 @@ static int jtagspi_read(struct flash_bank *bank, uint8_t *buffer, uint32_t offse
 	unsigned int addr_len = ((info->dev.read_cmd != 0x03) && info->always_4byte) ? 4 : info->addr_len;
 
 	while (count > 0) {
-		/* length up to end of current page */
-		currsize = ((offset + pagesize) & ~(pagesize - 1)) - offset;
-		/* but no more than remaining size */
-		currsize = (count < currsize) ? count : currsize;
+		uint8_t *queued = buffer;
+		uint32_t queued_size = 0;
+
+		/* the reads of several pages in a single execution of the queue */
+		while (count > 0 && queued_size < JTAGSPI_PIPELINE_READ_SIZE) {
+			/* length up to end of current page */
+			currsize = ((offset + pagesize) & ~(pagesize - 1)) - offset;
+			/* but no more than remaining size */
+			currsize = (count < currsize) ? count : currsize;
+
+			retval = jtagspi_queue_cmd(bank, info->dev.read_cmd,
+				fill_addr(offset, addr_len, addr), addr_len, NULL, buffer, currsize);
+			if (retval != ERROR_OK)
+				return retval;
+			LOG_DEBUG("read page at 0x%08" PRIx32, offset);
+			offset += currsize;
+			buffer += currsize;
+			count -= currsize;
+			queued_size += currsize;
+		}
 
-		retval = jtagspi_cmd(bank, info->dev.read_cmd, fill_addr(offset, addr_len, addr),
-			addr_len, buffer, -currsize);
+		retval = jtag_execute_queue();
 		if (retval != ERROR_OK) {
 			LOG_ERROR("page read error");
 			return retval;
 		}
-		LOG_DEBUG("read page at 0x%08" PRIx32, offset);
-		offset += currsize;
-		buffer += currsize;
-		count -= currsize;
+		flip_u8(queued, queued, queued_size);
+		keep_alive();
 	}
 	return ERROR_OK;
 }
@@ -677,7 +752,95 @@ static int jtagspi_page_write(struct flash_bank *bank, const uint8_t *buffer, ui
 		addr_len, (uint8_t *) buffer, count);
 	if (retval != ERROR_OK)
 		return retval;
-	return jtagspi_wait(bank, JTAGSPI_MAX_TIMEOUT);
+	return jtagspi_wait(bank, 0, JTAGSPI_MAX_TIMEOUT);
+}
+
+/*
+ * Queue the write enable, a status read and the program of several pages,
+ * each followed by a wait of the estimated page program time, and execute
+ * them at once. A page whose write enable found the flash still busy, so
+ * the flash ignored its program, is written again alone, and makes the
+ * estimate longer.
+ */
+static int jtagspi_write_pipelined(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count, uint32_t pagesize)
+{
+	struct jtagspi_flash_bank *info = bank->driver_priv;
+	uint8_t addr[sizeof(uint32_t)];
+	int retval;
+
+	/* ATXP032/064/128 use always 4-byte addresses except for 0x03 read */
+	unsigned int addr_len = ((info->dev.read_cmd != 0x03) && info->always_4byte) ? 4 : info->addr_len;
+
+	while (count > 0) {
+		struct {
+			const uint8_t *buffer;
+			uint32_t offset;
+			uint32_t size;
+		} pages[JTAGSPI_PIPELINE_PAGES];
+		uint8_t status[JTAGSPI_PIPELINE_PAGES];
+		unsigned int num_pages = 0;
+		unsigned int retried = 0;
+
+		int cycles = DIV_ROUND_UP((uint64_t)info->pprog_wait_us * adapter_get_speed_khz(), 1000);
+
+		for (; count > 0 && num_pages < JTAGSPI_PIPELINE_PAGES; num_pages++) {
+			/* length up to end of current page, but no more than remaining size */
+			uint32_t currsize = ((offset + pagesize) & ~(pagesize - 1)) - offset;
+			currsize = MIN(count, currsize);
+
+			pages[num_pages].buffer = buffer;
+			pages[num_pages].offset = offset;
+			pages[num_pages].size = currsize;
+
+			retval = jtagspi_queue_cmd(bank, SPIFLASH_WRITE_ENABLE, NULL, 0, NULL, NULL, 0);
+			if (retval == ERROR_OK)
+				retval = jtagspi_queue_cmd(bank, SPIFLASH_READ_STATUS, NULL, 0,
+						NULL, &status[num_pages], 1);
+			if (retval == ERROR_OK)
+				retval = jtagspi_queue_cmd(bank, info->dev.pprog_cmd,
+						fill_addr(offset, addr_len, addr), addr_len, buffer, NULL, currsize);
+			if (retval != ERROR_OK)
+				return retval;
+			jtag_add_runtest(cycles, TAP_IDLE);
+
+			offset += currsize;
+			buffer += currsize;
+			count -= currsize;
+		}
+
+		retval = jtag_execute_queue();
+		if (retval == ERROR_OK)
+			retval = jtagspi_wait(bank, 0, JTAGSPI_MAX_TIMEOUT);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("page write error");
+			return retval;
+		}
+
+		for (unsigned int i = 0; i < num_pages; i++) {
+			flip_u8(&status[i], &status[i], 1);
+			if ((status[i] & (SPIFLASH_BSY_BIT | SPIFLASH_WE_BIT)) == SPIFLASH_WE_BIT)
+				continue;
+
+			LOG_DEBUG("page at 0x%08" PRIx32 " not programmed, status=0x%02" PRIx8,
+				pages[i].offset, status[i]);
+			retval = jtagspi_page_write(bank, pages[i].buffer, pages[i].offset, pages[i].size);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("page write error");
+				return retval;
+			}
+			retried++;
+		}
+
+		if (retried && info->pprog_wait_us < JTAGSPI_MAX_PPROG_TIME_US) {
+			info->pprog_wait_us = MIN(info->pprog_wait_us + info->pprog_wait_us / 4 + 1,
+					JTAGSPI_MAX_PPROG_TIME_US);
+			LOG_DEBUG("%u of %u pages written again, page program wait now %" PRIu32 " us",
+				retried, num_pages, info->pprog_wait_us);
+		}
+	}
+
+	return ERROR_OK;
 }
 
 static int jtagspi_write(struct flash_bank *bank, const uint8_t *buffer, uint32_t offset, uint32_t count)
@@ -694,6 +857,10 @@ static int jtagspi_write(struct flash_bank *bank, const uint8_t *buffer, uint32_
 	/* if no write pagesize, use reasonable default */
 	pagesize = info->dev.pagesize ? info->dev.pagesize : SPIFLASH_DEF_PAGESIZE;
 
+	/* the wait is a number of TCK cycles, unknown with RCLK */
+	if (count > pagesize && adapter_get_speed_khz())
+		return jtagspi_write_pipelined(bank, buffer, offset, count, pagesize);
+
 	while (count > 0) {
 		/* length up to end of current page */
 		currsize = ((offset + pagesize) & ~(pagesize - 1)) - offset;
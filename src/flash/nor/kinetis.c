@@ -1275,15 +1275,13 @@ static int kinetis_write_block(struct flash_bank *bank, const uint8_t *buffer,
 	int retval;
 	uint8_t fstat;
 
-	/* allocate working area with flash programming code */
-	if (target_alloc_working_area(target, sizeof(kinetis_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
+	/* allocate working area with flash programming code, kept loaded
+	 * between blocks */
+	retval = target_alloc_loader_working_area(target, kinetis_flash_write_code,
+			sizeof(kinetis_flash_write_code), sizeof(kinetis_flash_write_code),
+			&write_algorithm);
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
 		LOG_WARNING("no working area available, can't do block memory writes");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	}
-
-	retval = target_write_buffer(target, write_algorithm->address,
-		sizeof(kinetis_flash_write_code), kinetis_flash_write_code);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -309,27 +309,10 @@ static int read_status_reg(struct flash_bank *bank, uint32_t *status)
 }
 
 /* check for BSY bit in flash status register */
-/* timeout in ms */
-static int wait_till_ready(struct flash_bank *bank, int timeout)
+/* typical time and timeout in ms */
+static int wait_till_ready(struct flash_bank *bank, uint32_t typical, int timeout)
 {
-	uint32_t status;
-	int retval;
-	int64_t endtime;
-
-	endtime = timeval_ms() + timeout;
-	do {
-		/* read flash status register */
-		retval = read_status_reg(bank, &status);
-		if (retval != ERROR_OK)
-			return retval;
-
-		if ((status & SPIFLASH_BSY_BIT) == 0)
-			return ERROR_OK;
-		alive_sleep(1);
-	} while (timeval_ms() < endtime);
-
-	LOG_ERROR("timeout waiting for flash to finish write/erase operation");
-	return ERROR_FAIL;
+	return spi_wait_ready(bank, read_status_reg, SPIFLASH_BSY_BIT, typical, timeout);
 }
 
 /* Send "write enable" command to SPI flash chip. */
@@ -398,7 +381,8 @@ static int lpcspifi_bulk_erase(struct flash_bank *bank)
 
 	/* poll flash BSY for self-timed bulk erase */
 	if (retval == ERROR_OK)
-		retval = wait_till_ready(bank, bank->num_sectors*SSP_MAX_TIMEOUT);
+		retval = wait_till_ready(bank, lpcspifi_info->dev->chip_erase_time_ms,
+			bank->num_sectors * SSP_MAX_TIMEOUT);
 
 	return retval;
 }
@@ -777,7 +761,7 @@ static int lpcspifi_read_flash_id(struct flash_bank *bank, uint32_t *id)
 
 	/* poll WIP */
 	if (retval == ERROR_OK)
-		retval = wait_till_ready(bank, SSP_PROBE_TIMEOUT);
+		retval = wait_till_ready(bank, 0, SSP_PROBE_TIMEOUT);
 
 	/* Send SPI command "read ID" */
 	if (retval == ERROR_OK)
@@ -854,12 +838,7 @@ static int lpcspifi_probe(struct flash_bank *bank)
 	if (retval != ERROR_OK)
 		return retval;
 
-	lpcspifi_info->dev = NULL;
-	for (const struct flash_device *p = flash_devices; p->name ; p++)
-		if (p->device_id == id) {
-			lpcspifi_info->dev = p;
-			break;
-		}
+	lpcspifi_info->dev = spi_flash_device_by_id(id);
 
 	if (!lpcspifi_info->dev) {
 		LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
@@ -841,12 +841,7 @@ static int mrvlqspi_probe(struct flash_bank *bank)
 	if (retval != ERROR_OK)
 		return retval;
 
-	mrvlqspi_info->dev = NULL;
-	for (const struct flash_device *p = flash_devices; p->name ; p++)
-		if (p->device_id == id) {
-			mrvlqspi_info->dev = p;
-			break;
-		}
+	mrvlqspi_info->dev = spi_flash_device_by_id(id);
 
 	if (!mrvlqspi_info->dev) {
 		LOG_ERROR("Unknown flash device ID 0x%08" PRIx32, id);
@@ -944,9 +944,14 @@ static int nrf5_ll_flash_write(struct nrf5_info *chip, uint32_t address, const u
 	LOG_DEBUG("Writing buffer to flash address=0x%"PRIx32" bytes=0x%"PRIx32, address, bytes);
 	assert(bytes % 4 == 0);
 
-	/* allocate working area with flash programming code */
-	if (target_alloc_working_area(target, sizeof(nrf5_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
+	/* allocate working area with flash programming code, kept loaded
+	 * between blocks */
+	retval = target_alloc_loader_working_area(target, nrf5_flash_write_code,
+			sizeof(nrf5_flash_write_code), sizeof(nrf5_flash_write_code),
+			&write_algorithm);
+	if (retval != ERROR_OK && retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+		return retval;
+	if (retval != ERROR_OK) {
 		LOG_WARNING("no working area available, falling back to slow memory writes");
 
 		for (; bytes > 0; bytes -= 4) {
@@ -965,12 +970,6 @@ static int nrf5_ll_flash_write(struct nrf5_info *chip, uint32_t address, const u
 		return ERROR_OK;
 	}
 
-	retval = target_write_buffer(target, write_algorithm->address,
-				sizeof(nrf5_flash_write_code),
-				nrf5_flash_write_code);
-	if (retval != ERROR_OK)
-		return retval;
-
 	/* memory buffer */
 	while (target_alloc_working_area(target, buffer_size, &source) != ERROR_OK) {
 		buffer_size /= 2;
@@ -455,12 +455,7 @@ static int rp2040_flash_probe(struct flash_bank *bank)
 			return err;
 
 		/* search for a SPI flash Device ID match */
-		priv->dev = NULL;
-		for (const struct flash_device *p = flash_devices; p->name ; p++)
-			if (p->device_id == device_id) {
-				priv->dev = p;
-				break;
-			}
+		priv->dev = spi_flash_device_by_id(device_id);
 
 		if (!priv->dev) {
 			LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", device_id);
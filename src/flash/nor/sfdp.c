@@ -11,14 +11,25 @@
 #include "imp.h"
 #include "spi.h"
 #include "sfdp.h"
+#include <helper/crc32.h>
 
 #define SFDP_MAGIC			0x50444653
 #define SFDP_ACCESS_PROT	0xFF
 #define SFDP_BASIC_FLASH	0xFF00
 #define SFDP_4BYTE_ADDR		0xFF84
 
+#define SFDP_CACHE_SIZE		8
+
 static const char *sfdp_name = "sfdp";
 
+/* the devices parsed from SFDP, by JEDEC id and crc of the SFDP headers */
+static struct sfdp_cache_entry {
+	uint32_t id;
+	uint32_t crc;
+	struct flash_device dev;
+} sfdp_cache[SFDP_CACHE_SIZE];
+static unsigned int sfdp_cache_next;
+
 struct sfdp_hdr {
 	uint32_t			signature;
 	uint32_t			revision;
@@ -57,6 +68,31 @@ struct sfdp_4byte_addr_param {
 	uint32_t			erase_t1234;	/* 02: erase commands */
 };
 
+/* typical page program time of the 'chip_byte' word, JESD216 11th dword */
+static uint32_t sfdp_pprog_time_us(uint32_t chip_byte)
+{
+	uint32_t unit = (chip_byte & (1UL << 13)) ? 64 : 8;
+
+	return (((chip_byte >> 8) & 0x1F) + 1) * unit;
+}
+
+/* typical time of the erase type 1..4 of the 'erase_time' word, 10th dword */
+static uint32_t sfdp_erase_time_ms(uint32_t erase_time, int erase_type)
+{
+	static const uint32_t units[] = { 1, 16, 128, 1000 };
+	uint32_t field = erase_time >> (4 + 7 * (erase_type - 1));
+
+	return ((field & 0x1F) + 1) * units[(field >> 5) & 0x3];
+}
+
+/* typical chip erase time of the 'chip_byte' word, 11th dword */
+static uint32_t sfdp_chip_erase_time_ms(uint32_t chip_byte)
+{
+	static const uint32_t units[] = { 16, 256, 4000, 64000 };
+
+	return (((chip_byte >> 24) & 0x1F) + 1) * units[(chip_byte >> 29) & 0x3];
+}
+
 /* Try to get parameters from flash via SFDP */
 int spi_sfdp(struct flash_bank *bank, struct flash_device *dev,
 	read_sfdp_block_t read_sfdp_block)
@@ -172,9 +208,15 @@ int spi_sfdp(struct flash_bank *bank, struct flash_device *dev,
 			dev->erase_cmd = (erase >> 8) & 0xFF;
 			dev->sectorsize = 1UL << (erase & 0xFF);
 
+			/* erase times, optional too */
+			if ((offsetof(struct sfdp_basic_flash_param, erase_time) >> 2) < words)
+				dev->erase_time_ms = sfdp_erase_time_ms(table->erase_time, erase_type);
+
 			if ((offsetof(struct sfdp_basic_flash_param, chip_byte) >> 2) < words) {
 				/* get Program Page Size, if chip_byte present, that's optional */
 				dev->pagesize = 1UL << ((table->chip_byte >> 4) & 0x0F);
+				dev->pprog_time_us = sfdp_pprog_time_us(table->chip_byte);
+				dev->chip_erase_time_ms = sfdp_chip_erase_time_ms(table->chip_byte);
 			} else {
 				/* no explicit page size specified ... */
 				if (table->fast_addr & (1UL << 2)) {
@@ -251,3 +293,87 @@ err:
 
 	return retval;
 }
+
+int spi_sfdp_pprog_time(struct flash_bank *bank, read_sfdp_block_t read_sfdp_block,
+	uint32_t *time_us)
+{
+	struct sfdp_hdr header;
+	struct sfdp_phdr pheader;
+	uint32_t chip_byte;
+	unsigned int index = offsetof(struct sfdp_basic_flash_param, chip_byte) >> 2;
+
+	int retval = read_sfdp_block(bank, 0x0, sizeof(header) >> 2, (uint32_t *)&header);
+	if (retval != ERROR_OK)
+		return retval;
+	if (header.signature != SFDP_MAGIC)
+		return ERROR_FLASH_OPER_UNSUPPORTED;
+
+	/* the basic flash parameter table comes first */
+	retval = read_sfdp_block(bank, sizeof(header), sizeof(pheader) >> 2, (uint32_t *)&pheader);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint8_t words = (pheader.revision >> 24) & 0xFF;
+	uint16_t id = ((pheader.ptr >> 16) & 0xFF00) | (pheader.revision & 0xFF);
+	if (id != SFDP_BASIC_FLASH || words <= index)
+		return ERROR_FLASH_OPER_UNSUPPORTED;
+
+	retval = read_sfdp_block(bank, (pheader.ptr & 0xFFFFFF) + (index << 2), 1, &chip_byte);
+	if (retval != ERROR_OK)
+		return retval;
+
+	*time_us = sfdp_pprog_time_us(chip_byte);
+	LOG_DEBUG("SFDP page program time %" PRIu32 " us", *time_us);
+
+	return ERROR_OK;
+}
+
+int spi_sfdp_cached(struct flash_bank *bank, struct flash_device *dev, uint32_t id,
+	read_sfdp_block_t read_sfdp_block)
+{
+	struct sfdp_hdr header;
+	struct sfdp_phdr *pheaders;
+
+	int retval = read_sfdp_block(bank, 0x0, sizeof(header) >> 2, (uint32_t *)&header);
+	if (retval != ERROR_OK)
+		return retval;
+	if (header.signature != SFDP_MAGIC)
+		return spi_sfdp(bank, dev, read_sfdp_block);
+
+	unsigned int nph = ((header.revision >> 16) & 0xFF) + 1;
+	pheaders = calloc(nph, sizeof(*pheaders));
+	if (!pheaders) {
+		LOG_ERROR("not enough memory");
+		return ERROR_FAIL;
+	}
+	retval = read_sfdp_block(bank, sizeof(header), (sizeof(*pheaders) >> 2) * nph,
+		(uint32_t *)pheaders);
+	if (retval != ERROR_OK) {
+		free(pheaders);
+		return retval;
+	}
+
+	uint32_t crc = crc32_be(CRC32_POLY_BE, 0xffffffff, &header, sizeof(header));
+	crc = crc32_be(CRC32_POLY_BE, crc, pheaders, nph * sizeof(*pheaders));
+	free(pheaders);
+
+	for (unsigned int i = 0; i < SFDP_CACHE_SIZE; i++) {
+		if (sfdp_cache[i].dev.name && sfdp_cache[i].id == id && sfdp_cache[i].crc == crc) {
+			LOG_DEBUG("SFDP of id 0x%06" PRIx32 " parsed before", id);
+			memcpy(dev, &sfdp_cache[i].dev, sizeof(*dev));
+			return ERROR_OK;
+		}
+	}
+
+	retval = spi_sfdp(bank, dev, read_sfdp_block);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct sfdp_cache_entry *entry = &sfdp_cache[sfdp_cache_next];
+	sfdp_cache_next = (sfdp_cache_next + 1) % SFDP_CACHE_SIZE;
+	entry->id = id;
+	entry->crc = crc;
+	memcpy(&entry->dev, dev, sizeof(entry->dev));
+
+	return ERROR_OK;
+}
@@ -21,4 +21,15 @@ typedef int (*read_sfdp_block_t)(struct flash_bank *bank, uint32_t addr,
 extern int spi_sfdp(struct flash_bank *bank, struct flash_device *dev,
 	read_sfdp_block_t read_sfdp_block);
 
+/*
+ * Like spi_sfdp(), but only the SFDP headers are read again for a flash
+ * with the JEDEC @a id and the same headers as one parsed before
+ */
+int spi_sfdp_cached(struct flash_bank *bank, struct flash_device *dev, uint32_t id,
+	read_sfdp_block_t read_sfdp_block);
+
+/* Only read the typical page program time of the basic parameters, quietly */
+int spi_sfdp_pprog_time(struct flash_bank *bank, read_sfdp_block_t read_sfdp_block,
+	uint32_t *time_us);
+
 #endif /* OPENOCD_FLASH_NOR_SFDP_H */
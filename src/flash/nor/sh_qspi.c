@@ -788,12 +788,7 @@ static int sh_qspi_probe(struct flash_bank *bank)
 	if (ret != ERROR_OK)
 		return ret;
 
-	info->dev = NULL;
-	for (const struct flash_device *p = flash_devices; p->name; p++)
-		if (p->device_id == id) {
-			info->dev = p;
-			break;
-		}
+	info->dev = spi_flash_device_by_id(id);
 
 	if (!info->dev) {
 		LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
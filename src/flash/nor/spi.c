@@ -18,6 +18,7 @@
 #include "imp.h"
 #include "spi.h"
 #include <jtag/jtag.h>
+#include <helper/time_support.h>
 
  /* Shared table of known SPI flash devices for SPI-based flash drivers. Taken
   * from device datasheets and Linux SPI flash drivers. */
@@ -208,3 +209,86 @@ const struct flash_device flash_devices[] = {
 
 	FLASH_ID(NULL,                  0,    0,    0,    0,    0,    0,          0,     0,       0)
 };
+
+/* the entries of flash_devices[], without the last one, sorted by device id */
+static const struct flash_device *flash_devices_by_id[ARRAY_SIZE(flash_devices) - 1];
+static unsigned int num_flash_devices;
+
+static int flash_device_compare(const void *a, const void *b)
+{
+	const struct flash_device *da = *(const struct flash_device * const *)a;
+	const struct flash_device *db = *(const struct flash_device * const *)b;
+
+	if (da->device_id != db->device_id)
+		return da->device_id < db->device_id ? -1 : 1;
+	/* the first of the same id in the table wins, like a linear search */
+	return da < db ? -1 : (da > db);
+}
+
+const struct flash_device *spi_flash_device_by_id(uint32_t device_id)
+{
+	/* built on first use */
+	if (!num_flash_devices) {
+		for (unsigned int i = 0; i < ARRAY_SIZE(flash_devices_by_id); i++)
+			flash_devices_by_id[i] = &flash_devices[i];
+		qsort(flash_devices_by_id, ARRAY_SIZE(flash_devices_by_id),
+			sizeof(*flash_devices_by_id), flash_device_compare);
+		num_flash_devices = ARRAY_SIZE(flash_devices_by_id);
+	}
+
+	/* the first entry with the id */
+	unsigned int lo = 0, hi = num_flash_devices;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (flash_devices_by_id[mid]->device_id < device_id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < num_flash_devices && flash_devices_by_id[lo]->device_id == device_id)
+		return flash_devices_by_id[lo];
+
+	return NULL;
+}
+
+/* the longest sleep between two status reads */
+#define SPI_WAIT_MAX_DELAY_MS	100
+
+int spi_wait_ready(struct flash_bank *bank, spi_read_status_t read_status,
+	uint32_t busy_mask, uint32_t typical_ms, unsigned int timeout_ms)
+{
+	int64_t start = timeval_ms();
+	int64_t deadline = start + timeout_ms;
+	unsigned int delay_ms = 1;
+	unsigned int reads = 0;
+
+	/* most operations are close to the typical time */
+	if (typical_ms > 1)
+		alive_sleep(typical_ms * 3 / 4);
+
+	for (;;) {
+		uint32_t status;
+		int retval = read_status(bank, &status);
+		if (retval != ERROR_OK)
+			return retval;
+		reads++;
+
+		int64_t now = timeval_ms();
+		if (!(status & busy_mask)) {
+			LOG_DEBUG("ready after %" PRId64 " ms, %u status reads", now - start, reads);
+			return ERROR_OK;
+		}
+
+		if (now >= deadline) {
+			LOG_ERROR("timeout, flash still busy");
+			return ERROR_FLASH_OPERATION_FAILED;
+		}
+
+		/* the end is seen at most a quarter of the time waited late */
+		alive_sleep(MIN(delay_ms, deadline - now));
+		delay_ms = MIN(2 * delay_ms, MAX((now - start) / 4, 1));
+		delay_ms = MIN(delay_ms, SPI_WAIT_MAX_DELAY_MS);
+	}
+}
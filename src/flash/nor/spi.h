@@ -28,6 +28,11 @@ struct flash_device {
 	uint32_t pagesize;
 	uint32_t sectorsize;
 	uint32_t size_in_bytes;
+	/* typical page program time from SFDP, 0 if unknown */
+	uint32_t pprog_time_us;
+	/* typical sector and chip erase times from SFDP, 0 if unknown */
+	uint32_t erase_time_ms;
+	uint32_t chip_erase_time_ms;
 };
 
 #define FLASH_ID(n, re, qr, pp, es, ces, id, psize, ssize, size) \
@@ -60,6 +65,21 @@ struct flash_device {
 
 extern const struct flash_device flash_devices[];
 
+/* @returns the first entry of flash_devices[] with @a device_id, NULL if none */
+const struct flash_device *spi_flash_device_by_id(uint32_t device_id);
+
+/* reads the status register of the flash, bit 0 set while it's busy */
+typedef int (*spi_read_status_t)(struct flash_bank *bank, uint32_t *status);
+
+/*
+ * Waits for the flash to be ready, the @a busy_mask bits of the status clear.
+ * The status isn't read before most of the @a typical_ms of the operation,
+ * then the reads are spaced more and more, so that a long erase takes a few
+ * reads only. @returns ERROR_FLASH_OPERATION_FAILED after @a timeout_ms.
+ */
+int spi_wait_ready(struct flash_bank *bank, spi_read_status_t read_status,
+	uint32_t busy_mask, uint32_t typical_ms, unsigned int timeout_ms);
+
 #endif
 
 /* fields in SPI flash status register */
@@ -457,19 +457,14 @@ static int stm32x_write_block_async(struct flash_bank *bank, const uint8_t *buff
 #include "../../../contrib/loaders/flash/stm32/stm32f1x.inc"
 	};
 
-	/* flash write code */
-	if (target_alloc_working_area(target, sizeof(stm32x_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
+	/* flash write code, kept loaded between blocks */
+	retval = target_alloc_loader_working_area(target, stm32x_flash_write_code,
+			sizeof(stm32x_flash_write_code), sizeof(stm32x_flash_write_code),
+			&write_algorithm);
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
 		LOG_WARNING("no working area available, can't do block memory writes");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	}
-
-	retval = target_write_buffer(target, write_algorithm->address,
-			sizeof(stm32x_flash_write_code), stm32x_flash_write_code);
-	if (retval != ERROR_OK) {
-		target_free_working_area(target, write_algorithm);
+	if (retval != ERROR_OK)
 		return retval;
-	}
 
 	/* memory buffer */
 	buffer_size = target_get_working_area_avail(target);
@@ -548,26 +543,21 @@ static int stm32x_write_block_riscv(struct flash_bank *bank, const uint8_t *buff
 	struct working_area *write_algorithm;
 	struct working_area *source;
 	static const uint8_t gd32vf103_flash_write_code[] = {
-#include "../../../contrib/loaders/flash/gd32vf103/gd32vf103.inc"
+#include "../../../contrib/loaders/flash/gd32vf103/gd32vf103_async.inc"
 	};
 
-	/* flash write code */
-	if (target_alloc_working_area(target, sizeof(gd32vf103_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
+	/* flash write code, kept loaded between blocks */
+	int retval = target_alloc_loader_working_area(target, gd32vf103_flash_write_code,
+			sizeof(gd32vf103_flash_write_code), sizeof(gd32vf103_flash_write_code),
+			&write_algorithm);
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
 		LOG_WARNING("no working area available, can't do block memory writes");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	}
-
-	int retval = target_write_buffer(target, write_algorithm->address,
-			sizeof(gd32vf103_flash_write_code), gd32vf103_flash_write_code);
-	if (retval != ERROR_OK) {
-		target_free_working_area(target, write_algorithm);
+	if (retval != ERROR_OK)
 		return retval;
-	}
 
-	/* memory buffer */
+	/* memory buffer, the FIFO of the loader */
 	buffer_size = target_get_working_area_avail(target);
-	buffer_size = MIN(hwords_count * 2, MAX(buffer_size, 256));
+	buffer_size = MIN(hwords_count * 2 + 8, MAX(buffer_size, 256));
 
 	retval = target_alloc_working_area(target, buffer_size, &source);
 	/* Allocated size is always word aligned */
@@ -580,58 +570,44 @@ static int stm32x_write_block_riscv(struct flash_bank *bank, const uint8_t *buff
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	}
 
-	struct reg_param reg_params[4];
-
-	init_reg_param(&reg_params[0], "a0", 32, PARAM_OUT);	/* poiner to FLASH_SR */
-	init_reg_param(&reg_params[1], "a1", 32, PARAM_OUT);	/* count (halfword-16bit) */
-	init_reg_param(&reg_params[2], "a2", 32, PARAM_OUT);	/* buffer start */
-	init_reg_param(&reg_params[3], "a3", 32, PARAM_IN_OUT);	/* target address */
-
-	while (hwords_count > 0) {
-		uint32_t thisrun_hwords = source->size / 2;
-
-		/* Limit to the amount of data we actually want to write */
-		if (thisrun_hwords > hwords_count)
-			thisrun_hwords = hwords_count;
+	/* the arguments, then the registers the loader uses, to have them restored */
+	static char * const reg_names[] = {
+		"a0", "a1", "a2", "a3", "a4", "a5", "t0", "t1", "t2", "s0",
+	};
+	const uint32_t args[] = {
+		stm32x_get_flash_reg(bank, STM32_FLASH_SR),
+		hwords_count,
+		source->address,
+		source->address + source->size,
+		address,
+	};
+	struct reg_param reg_params[ARRAY_SIZE(reg_names)];
 
-		/* Write data to buffer */
-		retval = target_write_buffer(target, source->address,
-					thisrun_hwords * 2, buffer);
-		if (retval != ERROR_OK)
-			break;
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_names); i++) {
+		init_reg_param(&reg_params[i], reg_names[i], 32,
+				(i == 0 || i == 4) ? PARAM_IN_OUT : PARAM_OUT);
+		buf_set_u32(reg_params[i].value, 0, 32, i < ARRAY_SIZE(args) ? args[i] : 0);
+	}
 
-		buf_set_u32(reg_params[0].value, 0, 32, stm32x_get_flash_reg(bank, STM32_FLASH_SR));
-		buf_set_u32(reg_params[1].value, 0, 32, thisrun_hwords);
-		buf_set_u32(reg_params[2].value, 0, 32, source->address);
-		buf_set_u32(reg_params[3].value, 0, 32, address);
-
-		retval = target_run_algorithm(target,
-				0, NULL,
-				ARRAY_SIZE(reg_params), reg_params,
-				write_algorithm->address,
-				write_algorithm->address + sizeof(gd32vf103_flash_write_code) - 4,
-				10000, NULL);
-
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Failed to execute algorithm at 0x%" TARGET_PRIxADDR ": %d",
-					write_algorithm->address, retval);
-			break;
-		}
+	retval = target_run_flash_async_algorithm(target, buffer, hwords_count, 2,
+			0, NULL,
+			ARRAY_SIZE(reg_params), reg_params,
+			source->address, source->size,
+			write_algorithm->address, 0,
+			NULL);
 
-		/* Actually we just need to check for programming errors
-		 * stm32x_wait_status_busy also reports error and clears status bits
+	if (retval == ERROR_FLASH_OPERATION_FAILED) {
+		/* The loader returns the flash status in a0 on a programming
+		 * error, stm32x_wait_status_busy also reports the error and
+		 * clears the status bits.
 		 */
-		retval = stm32x_wait_status_busy(bank, 5);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("flash write failed at address 0x%"PRIx32,
-					buf_get_u32(reg_params[3].value, 0, 32));
-			break;
-		}
+		int retval2 = stm32x_wait_status_busy(bank, 5);
+		if (retval2 != ERROR_OK)
+			retval = retval2;
 
-		/* Update counters */
-		buffer += thisrun_hwords * 2;
-		address += thisrun_hwords * 2;
-		hwords_count -= thisrun_hwords;
+		LOG_ERROR("flash write failed at address 0x%" PRIx32 ", status 0x%" PRIx32,
+				buf_get_u32(reg_params[4].value, 0, 32),
+				buf_get_u32(reg_params[0].value, 0, 32));
 	}
 
 	for (unsigned int i = 0; i < ARRAY_SIZE(reg_params); i++)
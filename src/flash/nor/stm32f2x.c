@@ -589,10 +589,24 @@ static int stm32x_protect_check(struct flash_bank *bank)
 	return ERROR_OK;
 }
 
+/* Set the SER bit, select the sector and set the STRT bit */
+static int stm32x_erase_sector_start(struct flash_bank *bank, unsigned int sector)
+{
+	struct stm32x_flash_bank *stm32x_info = bank->driver_priv;
+	unsigned int snb;
+
+	if (stm32x_info->has_large_mem && sector >= (bank->num_sectors / 2))
+		snb = (sector - (bank->num_sectors / 2)) | 0x10;
+	else
+		snb = sector;
+
+	return target_write_u32(bank->target, stm32x_get_flash_reg(bank, STM32_FLASH_CR),
+			FLASH_SER | FLASH_SNB(snb) | FLASH_STRT);
+}
+
 static int stm32x_erase(struct flash_bank *bank, unsigned int first,
 		unsigned int last)
 {
-	struct stm32x_flash_bank *stm32x_info = bank->driver_priv;
 	struct target *target = bank->target;
 
 	if (stm32x_is_otp(bank)) {
@@ -624,14 +638,7 @@ static int stm32x_erase(struct flash_bank *bank, unsigned int first,
 	 */
 
 	for (unsigned int i = first; i <= last; i++) {
-		unsigned int snb;
-		if (stm32x_info->has_large_mem && i >= (bank->num_sectors / 2))
-			snb = (i - (bank->num_sectors / 2)) | 0x10;
-		else
-			snb = i;
-
-		retval = target_write_u32(target,
-				stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_SER | FLASH_SNB(snb) | FLASH_STRT);
+		retval = stm32x_erase_sector_start(bank, i);
 		if (retval != ERROR_OK)
 			return retval;
 
@@ -647,6 +654,37 @@ static int stm32x_erase(struct flash_bank *bank, unsigned int first,
 	return ERROR_OK;
 }
 
+/* Start the sector erase of stm32x_erase() and return, the target keeps running it */
+static int stm32x_erase_start(struct flash_bank *bank, unsigned int sector)
+{
+	if (stm32x_is_otp(bank)) {
+		LOG_ERROR("Cannot erase OTP memory");
+		return ERROR_FAIL;
+	}
+
+	assert(sector < bank->num_sectors);
+
+	if (bank->target->state != TARGET_HALTED) {
+		LOG_ERROR("Target not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	int retval = stm32x_unlock_reg(bank->target);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return stm32x_erase_sector_start(bank, sector);
+}
+
+static int stm32x_erase_wait(struct flash_bank *bank)
+{
+	int retval = stm32x_wait_status_busy(bank, FLASH_ERASE_TIMEOUT);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return target_write_u32(bank->target, stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_LOCK);
+}
+
 static int stm32x_protect(struct flash_bank *bank, int set, unsigned int first,
 		unsigned int last)
 {
@@ -1807,6 +1845,8 @@ const struct flash_driver stm32f2x_flash = {
 	.commands = stm32f2x_command_handlers,
 	.flash_bank_command = stm32x_flash_bank_command,
 	.erase = stm32x_erase,
+	.erase_start = stm32x_erase_start,
+	.erase_wait = stm32x_erase_wait,
 	.protect = stm32x_protect,
 	.write = stm32x_write,
 	.read = default_flash_read,
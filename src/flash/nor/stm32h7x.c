@@ -460,10 +460,26 @@ static int stm32x_protect_check(struct flash_bank *bank)
 	return ERROR_OK;
 }
 
+static int stm32x_erase_sector_start(struct flash_bank *bank, unsigned int sector)
+{
+	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
+
+	LOG_DEBUG("erase sector %u", sector);
+	int retval = stm32x_write_flash_reg(bank, FLASH_CR,
+			stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64, sector));
+	if (retval == ERROR_OK)
+		retval = stm32x_write_flash_reg(bank, FLASH_CR,
+				stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64 | FLASH_START,
+					sector));
+	if (retval != ERROR_OK)
+		LOG_ERROR("Error erase sector %u", sector);
+
+	return retval;
+}
+
 static int stm32x_erase(struct flash_bank *bank, unsigned int first,
 		unsigned int last)
 {
-	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
 	int retval, retval2;
 
 	assert(first < bank->num_sectors);
@@ -487,19 +503,10 @@ static int stm32x_erase(struct flash_bank *bank, unsigned int first,
 	4. Wait for flash operations completion
 	 */
 	for (unsigned int i = first; i <= last; i++) {
-		LOG_DEBUG("erase sector %u", i);
-		retval = stm32x_write_flash_reg(bank, FLASH_CR,
-				stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64, i));
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error erase sector %u", i);
-			goto flash_lock;
-		}
-		retval = stm32x_write_flash_reg(bank, FLASH_CR,
-				stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64 | FLASH_START, i));
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error erase sector %u", i);
+		retval = stm32x_erase_sector_start(bank, i);
+		if (retval != ERROR_OK)
 			goto flash_lock;
-		}
+
 		retval = stm32x_wait_flash_op_queue(bank, FLASH_ERASE_TIMEOUT);
 
 		if (retval != ERROR_OK) {
@@ -516,6 +523,39 @@ flash_lock:
 	return (retval == ERROR_OK) ? retval2 : retval;
 }
 
+/*
+ * Start the sector erase of stm32x_erase() and return. Each bank has its
+ * own controller, the other bank can erase or program meanwhile.
+ */
+static int stm32x_erase_start(struct flash_bank *bank, unsigned int sector)
+{
+	assert(sector < bank->num_sectors);
+
+	if (bank->target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	int retval = stm32x_unlock_reg(bank);
+	if (retval == ERROR_OK)
+		retval = stm32x_erase_sector_start(bank, sector);
+	if (retval != ERROR_OK)
+		stm32x_lock_reg(bank);
+
+	return retval;
+}
+
+static int stm32x_erase_wait(struct flash_bank *bank)
+{
+	int retval = stm32x_wait_flash_op_queue(bank, FLASH_ERASE_TIMEOUT);
+	if (retval != ERROR_OK)
+		LOG_ERROR("erase time-out or operation error");
+
+	int retval2 = stm32x_lock_reg(bank);
+	if (retval2 != ERROR_OK)
+		LOG_ERROR("error during the lock of flash");
+
+	return (retval == ERROR_OK) ? retval2 : retval;
+}
+
 static int stm32x_protect(struct flash_bank *bank, int set, unsigned int first,
 		unsigned int last)
 {
@@ -873,6 +913,8 @@ static int stm32x_probe(struct flash_bank *bank)
 	bank->size = flash_size_in_kb * 1024;
 	bank->write_start_alignment = stm32x_info->part_info->block_size;
 	bank->write_end_alignment = stm32x_info->part_info->block_size;
+	/* the banks of a dual bank device erase in parallel */
+	bank->parallel_group = has_dual_bank ? 1 : 0;
 
 	/* setup sectors */
 	bank->num_sectors = flash_size_in_kb / stm32x_info->part_info->page_size_kb;
@@ -1201,6 +1243,8 @@ const struct flash_driver stm32h7x_flash = {
 	.commands = stm32h7x_command_handlers,
 	.flash_bank_command = stm32x_flash_bank_command,
 	.erase = stm32x_erase,
+	.erase_start = stm32x_erase_start,
+	.erase_wait = stm32x_erase_wait,
 	.protect = stm32x_protect,
 	.write = stm32x_write,
 	.read = default_flash_read,
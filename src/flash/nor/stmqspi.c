@@ -171,6 +171,7 @@ struct stmqspi_flash_bank {
 	uint32_t saved_ir;	/* only for OCTOSPI */
 	unsigned int sfdp_dummy1;	/* number of dummy bytes for SFDP read for flash1 and octo */
 	unsigned int sfdp_dummy2;	/* number of dummy bytes for SFDP read for flash2 */
+	bool mm_read;	/* read, verify and blank check in memory mapped mode */
 };
 
 static inline int octospi_cmd(struct flash_bank *bank, uint32_t mode,
@@ -225,6 +226,7 @@ FLASH_BANK_COMMAND_HANDLER(stmqspi_flash_bank_command)
 	stmqspi_info->sfdp_dummy2 = 0;
 	stmqspi_info->probed = false;
 	stmqspi_info->io_base = io_base;
+	stmqspi_info->mm_read = true;
 
 	return ERROR_OK;
 }
@@ -319,6 +321,36 @@ static int set_mm_mode(struct flash_bank *bank)
 	return retval;
 }
 
+/* The last word of the flash is never read in memory mapped mode, due to a
+ * silicon bug of some devices */
+#define SPI_MM_GUARD	4
+
+/* Can the flash be read through the memory mapped window? Only if the
+ * controller was set up for memory mapped mode, with the read command, the
+ * dummy cycles and the lines of the flash, when the bank was probed. */
+static bool stmqspi_mm_usable(struct flash_bank *bank)
+{
+	struct stmqspi_flash_bank *stmqspi_info = bank->driver_priv;
+
+	if (!stmqspi_info->mm_read || bank->size <= SPI_MM_GUARD)
+		return false;
+
+	if (IS_OCTOSPI)
+		return (stmqspi_info->saved_cr & OCTOSPI_MM_MODE) == OCTOSPI_MM_MODE &&
+			(stmqspi_info->saved_ir & 0xFF) != 0;
+
+	return (stmqspi_info->saved_ccr & QSPI_MM_MODE) == QSPI_MM_MODE &&
+		(stmqspi_info->saved_ccr & 0xFF) != 0;
+}
+
+/* Number of bytes from offset, at most count, readable in memory mapped mode */
+static uint32_t stmqspi_mm_count(struct flash_bank *bank, uint32_t offset, uint32_t count)
+{
+	const uint32_t mm_end = bank->size - SPI_MM_GUARD;
+
+	return offset < mm_end ? MIN(count, mm_end - offset) : 0;
+}
+
 /* Read the status register of the external SPI flash chip(s). */
 static int read_status_reg(struct flash_bank *bank, uint16_t *status)
 {
@@ -391,28 +423,21 @@ err:
 	return retval;
 }
 
-/* check for WIP (write in progress) bit(s) in status register(s) */
-/* timeout in ms */
-static int wait_till_ready(struct flash_bank *bank, int timeout)
+static int read_status_regs(struct flash_bank *bank, uint32_t *status)
 {
-	uint16_t status;
-	int retval;
-	long long endtime;
-
-	endtime = timeval_ms() + timeout;
-	do {
-		/* Read flash status register(s) */
-		retval = read_status_reg(bank, &status);
-		if (retval != ERROR_OK)
-			return retval;
+	uint16_t regs;
+	int retval = read_status_reg(bank, &regs);
 
-		if ((status & ((SPIFLASH_BSY_BIT << 8) | SPIFLASH_BSY_BIT)) == 0)
-			return retval;
-		alive_sleep(25);
-	} while (timeval_ms() < endtime);
+	*status = regs;
+	return retval;
+}
 
-	LOG_ERROR("timeout");
-	return ERROR_FLASH_OPERATION_FAILED;
+/* check for WIP (write in progress) bit(s) in status register(s) */
+/* typical time and timeout in ms */
+static int wait_till_ready(struct flash_bank *bank, uint32_t typical, int timeout)
+{
+	return spi_wait_ready(bank, read_status_regs,
+		(SPIFLASH_BSY_BIT << 8) | SPIFLASH_BSY_BIT, typical, timeout);
 }
 
 /* Send "write enable" command to SPI flash chip(s). */
@@ -575,7 +600,8 @@ COMMAND_HANDLER(stmqspi_handle_mass_erase_command)
 	}
 
 	/* Poll WIP for end of self timed Sector Erase cycle */
-	retval = wait_till_ready(bank, SPI_MASS_ERASE_TIMEOUT);
+	retval = wait_till_ready(bank, stmqspi_info->dev.chip_erase_time_ms,
+		SPI_MASS_ERASE_TIMEOUT);
 
 	duration_measure(&bench);
 	if (retval == ERROR_OK)
@@ -921,6 +947,31 @@ err:
 	return retval;
 }
 
+COMMAND_HANDLER(stmqspi_handle_mm_read)
+{
+	struct flash_bank *bank;
+	struct stmqspi_flash_bank *stmqspi_info;
+	int retval;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	stmqspi_info = bank->driver_priv;
+
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[1], stmqspi_info->mm_read);
+
+	command_print(CMD, "memory mapped read %s%s", stmqspi_info->mm_read ? "on" : "off",
+		(stmqspi_info->mm_read && stmqspi_info->probed && !stmqspi_mm_usable(bank)) ?
+		", but the controller is not set up for memory mapped mode" : "");
+
+	return ERROR_OK;
+}
+
 static int qspi_erase_sector(struct flash_bank *bank, unsigned int sector)
 {
 	struct target *target = bank->target;
@@ -986,7 +1037,7 @@ static int qspi_erase_sector(struct flash_bank *bank, unsigned int sector)
 	LOG_DEBUG("erasing sector %4u", sector);
 
 	/* Poll WIP for end of self timed Sector Erase cycle */
-	retval = wait_till_ready(bank, SPI_MAX_TIMEOUT);
+	retval = wait_till_ready(bank, stmqspi_info->dev.erase_time_ms, SPI_MAX_TIMEOUT);
 
 err:
 	return retval;
@@ -1060,6 +1111,67 @@ static int stmqspi_protect(struct flash_bank *bank, int set,
 }
 
 /* Check whether flash is blank */
+static int qspi_read_write_block(struct flash_bank *bank, uint8_t *buffer,
+	uint32_t offset, uint32_t count, bool write);
+
+/* Blank check of the memory mapped flash with the generic algorithm of the
+ * target, the last word is read in indirect mode. Returns
+ * ERROR_TARGET_RESOURCE_NOT_AVAILABLE if the target has no such algorithm. */
+static int stmqspi_mm_blank_check(struct flash_bank *bank)
+{
+	struct target *target = bank->target;
+	struct target_memory_check_block *blocks;
+	uint8_t guard[SPI_MM_GUARD];
+	int retval;
+
+	retval = set_mm_mode(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	blocks = malloc(bank->num_sectors * sizeof(*blocks));
+	if (!blocks)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		blocks[i].address = bank->base + bank->sectors[i].offset;
+		blocks[i].size = stmqspi_mm_count(bank, bank->sectors[i].offset,
+			bank->sectors[i].size);
+		blocks[i].result = UINT32_MAX;
+	}
+
+	for (unsigned int i = 0; i < bank->num_sectors; ) {
+		retval = target_blank_check_memory(target, blocks + i,
+			bank->num_sectors - i, bank->erased_value);
+		if (retval < 1) {
+			free(blocks);
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+		i += retval;
+	}
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++)
+		bank->sectors[i].is_erased = blocks[i].result;
+	free(blocks);
+
+	/* the last word, in the last sector */
+	retval = stmqspi_abort(bank);
+	if (retval == ERROR_OK)
+		retval = poll_busy(bank, SPI_PROBE_TIMEOUT);
+	if (retval == ERROR_OK)
+		retval = qspi_read_write_block(bank, guard, bank->size - SPI_MM_GUARD,
+			SPI_MM_GUARD, false);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct flash_sector *last = &bank->sectors[bank->num_sectors - 1];
+	for (unsigned int i = 0; i < SPI_MM_GUARD; i++) {
+		if (guard[i] != bank->erased_value)
+			last->is_erased = 0;
+	}
+
+	return ERROR_OK;
+}
+
 static int stmqspi_blank_check(struct flash_bank *bank)
 {
 	struct target *target = bank->target;
@@ -1085,6 +1197,13 @@ static int stmqspi_blank_check(struct flash_bank *bank)
 		return ERROR_FLASH_BANK_NOT_PROBED;
 	}
 
+	if (stmqspi_mm_usable(bank) && bank->num_sectors) {
+		retval = stmqspi_mm_blank_check(bank);
+		if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			return retval;
+		LOG_DEBUG("no blank check algorithm for the memory mapped flash");
+	}
+
 	/* Abort any previous operation */
 	retval = stmqspi_abort(bank);
 	if (retval != ERROR_OK)
@@ -1591,6 +1710,21 @@ static int stmqspi_read(struct flash_bank *bank, uint8_t *buffer,
 		count = bank->size - offset;
 	}
 
+	/* Plain memory reads, only the last word is read in indirect mode */
+	if (stmqspi_mm_usable(bank)) {
+		uint32_t mm_count = stmqspi_mm_count(bank, offset, count);
+
+		retval = set_mm_mode(bank);
+		if (retval == ERROR_OK && mm_count)
+			retval = default_flash_read(bank, buffer, offset, mm_count);
+		if (retval != ERROR_OK || mm_count == count)
+			return retval;
+
+		buffer += mm_count;
+		offset += mm_count;
+		count -= mm_count;
+	}
+
 	/* Abort any previous operation */
 	retval = stmqspi_abort(bank);
 	if (retval != ERROR_OK)
@@ -1701,6 +1835,22 @@ static int stmqspi_verify(struct flash_bank *bank, const uint8_t *buffer,
 		return ERROR_FLASH_DST_BREAKS_ALIGNMENT;
 	}
 
+	/* Checksum of the memory mapped flash, only the last word is verified
+	 * in indirect mode */
+	if (stmqspi_mm_usable(bank)) {
+		uint32_t mm_count = stmqspi_mm_count(bank, offset, count);
+
+		retval = set_mm_mode(bank);
+		if (retval == ERROR_OK && mm_count)
+			retval = default_flash_verify(bank, buffer, offset, mm_count);
+		if (retval != ERROR_OK || mm_count == count)
+			return retval;
+
+		buffer += mm_count;
+		offset += mm_count;
+		count -= mm_count;
+	}
+
 	/* Abort any previous operation */
 	retval = stmqspi_abort(bank);
 	if (retval != ERROR_OK)
@@ -1959,7 +2109,7 @@ static int read_flash_id(struct flash_bank *bank, uint32_t *id1, uint32_t *id2)
 			goto err;
 
 		/* Poll WIP */
-		retval = wait_till_ready(bank, SPI_PROBE_TIMEOUT);
+		retval = wait_till_ready(bank, 0, SPI_PROBE_TIMEOUT);
 		if (retval != ERROR_OK)
 			goto err;
 
@@ -2198,27 +2348,25 @@ static int stmqspi_probe(struct flash_bank *bank)
 		goto err;
 
 	/* identify flash1 */
-	for (p = flash_devices; id1 && p->name ; p++) {
-		if (p->device_id == id1) {
-			memcpy(&stmqspi_info->dev, p, sizeof(stmqspi_info->dev));
-			if (p->size_in_bytes / 4096)
-				LOG_INFO("flash1 \'%s\' id = 0x%06" PRIx32 " size = %" PRIu32
-					" KiB", p->name, id1, p->size_in_bytes / 1024);
-			else
-				LOG_INFO("flash1 \'%s\' id = 0x%06" PRIx32 " size = %" PRIu32
-					" B", p->name, id1, p->size_in_bytes);
-			break;
-		}
+	p = id1 ? spi_flash_device_by_id(id1) : NULL;
+	if (p) {
+		memcpy(&stmqspi_info->dev, p, sizeof(stmqspi_info->dev));
+		if (p->size_in_bytes / 4096)
+			LOG_INFO("flash1 \'%s\' id = 0x%06" PRIx32 " size = %" PRIu32
+				" KiB", p->name, id1, p->size_in_bytes / 1024);
+		else
+			LOG_INFO("flash1 \'%s\' id = 0x%06" PRIx32 " size = %" PRIu32
+				" B", p->name, id1, p->size_in_bytes);
 	}
 
-	if (id1 && !p->name) {
+	if (id1 && !p) {
 		/* chip not been identified by id, then try SFDP */
 		struct flash_device temp;
 		uint32_t saved_cr = stmqspi_info->saved_cr;
 
 		/* select flash1 */
 		stmqspi_info->saved_cr = stmqspi_info->saved_cr & ~BIT(SPI_FSEL_FLASH);
-		retval = spi_sfdp(bank, &temp, &read_sfdp_block);
+		retval = spi_sfdp_cached(bank, &temp, id1, &read_sfdp_block);
 
 		/* restore saved_cr */
 		stmqspi_info->saved_cr = saved_cr;
@@ -2239,44 +2387,42 @@ static int stmqspi_probe(struct flash_bank *bank)
 	}
 
 	/* identify flash2 */
-	for (p = flash_devices; id2 && p->name ; p++) {
-		if (p->device_id == id2) {
-			if (p->size_in_bytes / 4096)
-				LOG_INFO("flash2 \'%s\' id = 0x%06" PRIx32 " size = %" PRIu32
-					" KiB", p->name, id2, p->size_in_bytes / 1024);
-			else
-				LOG_INFO("flash2 \'%s\' id = 0x%06" PRIx32 " size = %" PRIu32
-					" B", p->name, id2, p->size_in_bytes);
-
-			if (!id1)
-				memcpy(&stmqspi_info->dev, p, sizeof(stmqspi_info->dev));
-			else {
-				if ((stmqspi_info->dev.read_cmd != p->read_cmd) ||
-					(stmqspi_info->dev.qread_cmd != p->qread_cmd) ||
-					(stmqspi_info->dev.pprog_cmd != p->pprog_cmd) ||
-					(stmqspi_info->dev.erase_cmd != p->erase_cmd) ||
-					(stmqspi_info->dev.chip_erase_cmd != p->chip_erase_cmd) ||
-					(stmqspi_info->dev.sectorsize != p->sectorsize) ||
-					(stmqspi_info->dev.size_in_bytes != p->size_in_bytes)) {
-					LOG_ERROR("Incompatible flash1/flash2 devices");
-					goto err;
-				}
-				/* page size is optional in SFDP, so accept smallest value */
-				if (p->pagesize < stmqspi_info->dev.pagesize)
-					stmqspi_info->dev.pagesize = p->pagesize;
+	p = id2 ? spi_flash_device_by_id(id2) : NULL;
+	if (p) {
+		if (p->size_in_bytes / 4096)
+			LOG_INFO("flash2 \'%s\' id = 0x%06" PRIx32 " size = %" PRIu32
+				" KiB", p->name, id2, p->size_in_bytes / 1024);
+		else
+			LOG_INFO("flash2 \'%s\' id = 0x%06" PRIx32 " size = %" PRIu32
+				" B", p->name, id2, p->size_in_bytes);
+
+		if (!id1) {
+			memcpy(&stmqspi_info->dev, p, sizeof(stmqspi_info->dev));
+		} else {
+			if ((stmqspi_info->dev.read_cmd != p->read_cmd) ||
+				(stmqspi_info->dev.qread_cmd != p->qread_cmd) ||
+				(stmqspi_info->dev.pprog_cmd != p->pprog_cmd) ||
+				(stmqspi_info->dev.erase_cmd != p->erase_cmd) ||
+				(stmqspi_info->dev.chip_erase_cmd != p->chip_erase_cmd) ||
+				(stmqspi_info->dev.sectorsize != p->sectorsize) ||
+				(stmqspi_info->dev.size_in_bytes != p->size_in_bytes)) {
+				LOG_ERROR("Incompatible flash1/flash2 devices");
+				goto err;
 			}
-			break;
+			/* page size is optional in SFDP, so accept smallest value */
+			if (p->pagesize < stmqspi_info->dev.pagesize)
+				stmqspi_info->dev.pagesize = p->pagesize;
 		}
 	}
 
-	if (id2 && !p->name) {
+	if (id2 && !p) {
 		/* chip not been identified by id, then try SFDP */
 		struct flash_device temp;
 		uint32_t saved_cr = stmqspi_info->saved_cr;
 
 		/* select flash2 */
 		stmqspi_info->saved_cr = stmqspi_info->saved_cr | BIT(SPI_FSEL_FLASH);
-		retval = spi_sfdp(bank, &temp, &read_sfdp_block);
+		retval = spi_sfdp_cached(bank, &temp, id2, &read_sfdp_block);
 
 		/* restore saved_cr */
 		stmqspi_info->saved_cr = saved_cr;
@@ -2433,6 +2579,14 @@ static const struct command_registration stmqspi_exec_command_handlers[] = {
 		.usage = "bank_id num_resp cmd_byte ...",
 		.help = "Send low-level command cmd_byte and following bytes or read num_resp.",
 	},
+	{
+		.name = "mm_read",
+		.handler = stmqspi_handle_mm_read,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id ['on'|'off']",
+		.help = "Read, verify and blank check in memory mapped mode, if the "
+			"controller is set up for it (default on).",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
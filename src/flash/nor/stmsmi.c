@@ -559,12 +559,7 @@ static int stmsmi_probe(struct flash_bank *bank)
 	if (retval != ERROR_OK)
 		return retval;
 
-	stmsmi_info->dev = NULL;
-	for (const struct flash_device *p = flash_devices; p->name ; p++)
-		if (p->device_id == id) {
-			stmsmi_info->dev = p;
-			break;
-		}
+	stmsmi_info->dev = spi_flash_device_by_id(id);
 
 	if (!stmsmi_info->dev) {
 		LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
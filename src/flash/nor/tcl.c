@@ -11,6 +11,8 @@
 #include "config.h"
 #endif
 #include "imp.h"
+#include <helper/binarybuffer.h>
+#include <helper/crc32.h>
 #include <helper/time_support.h>
 #include <target/image.h>
 
@@ -162,6 +164,7 @@ COMMAND_HANDLER(handle_flash_probe_command)
 		return retval;
 
 	if (p) {
+		flash_forget_erased(p);
 		retval = p->driver->probe(p);
 		if (retval == ERROR_OK)
 			command_print(CMD,
@@ -389,6 +392,9 @@ COMMAND_HANDLER(handle_flash_protect_command)
 	return retval;
 }
 
+/* the unique ID of a device recorded in a manifest */
+#define FLASH_UID_MAX_SIZE	32
+
 COMMAND_HANDLER(handle_flash_write_image_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -401,6 +407,12 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	/* flash auto-erase is disabled by default*/
 	int auto_erase = 0;
 	bool auto_unlock = false;
+	bool diff = false;
+	bool stats = false;
+	const char *checkpoint_path = NULL;
+	enum flash_checkpoint_mode mode = FLASH_CHECKPOINT_NEW;
+	target_addr_t uid_address = 0;
+	uint32_t uid_length = 0;
 
 	while (CMD_ARGC) {
 		if (strcmp(CMD_ARGV[0], "erase") == 0) {
@@ -413,6 +425,36 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 			CMD_ARGV++;
 			CMD_ARGC--;
 			command_print(CMD, "auto unlock enabled");
+		} else if (strcmp(CMD_ARGV[0], "diff") == 0) {
+			diff = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD, "only writing the sectors which differ");
+		} else if (strcmp(CMD_ARGV[0], "stats") == 0) {
+			stats = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
+		} else if (strcmp(CMD_ARGV[0], "checkpoint") == 0
+				|| strcmp(CMD_ARGV[0], "resume") == 0
+				|| strcmp(CMD_ARGV[0], "manifest") == 0) {
+			if (CMD_ARGC < 2)
+				return ERROR_COMMAND_SYNTAX_ERROR;
+			if (strcmp(CMD_ARGV[0], "resume") == 0)
+				mode = FLASH_CHECKPOINT_RESUME;
+			else if (strcmp(CMD_ARGV[0], "manifest") == 0)
+				mode = FLASH_CHECKPOINT_MANIFEST;
+			checkpoint_path = CMD_ARGV[1];
+			CMD_ARGV += 2;
+			CMD_ARGC -= 2;
+		} else if (strcmp(CMD_ARGV[0], "uid") == 0) {
+			if (CMD_ARGC < 3)
+				return ERROR_COMMAND_SYNTAX_ERROR;
+			COMMAND_PARSE_ADDRESS(CMD_ARGV[1], uid_address);
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], uid_length);
+			if (uid_length == 0 || uid_length > FLASH_UID_MAX_SIZE)
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			CMD_ARGV += 3;
+			CMD_ARGC -= 3;
 		} else
 			break;
 	}
@@ -428,6 +470,9 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	struct duration bench;
 	duration_start(&bench);
 
+	struct flash_stats flash_stats;
+	flash_stats_start(&flash_stats);
+
 	if (CMD_ARGC >= 2) {
 		image.base_address_set = true;
 		COMMAND_PARSE_NUMBER(llong, CMD_ARGV[1], image.base_address);
@@ -442,8 +487,33 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* the device whose flash the checkpoint describes */
+	char uid[2 * FLASH_UID_MAX_SIZE + 1];
+	if (checkpoint_path && uid_length) {
+		uint8_t uid_data[FLASH_UID_MAX_SIZE];
+		retval = target_read_buffer(target, uid_address, uid_length, uid_data);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("couldn't read the unique ID at " TARGET_ADDR_FMT, uid_address);
+			image_close(&image);
+			return retval;
+		}
+		hexify(uid, uid_data, uid_length, sizeof(uid));
+	}
+
+	struct flash_checkpoint checkpoint;
+	if (checkpoint_path) {
+		retval = flash_checkpoint_open(&checkpoint, checkpoint_path, &image, mode,
+				uid_length ? uid : NULL);
+		if (retval != ERROR_OK) {
+			image_close(&image);
+			return retval;
+		}
+	}
+
 	retval = flash_write_unlock_verify(target, &image, &written, auto_erase,
-		auto_unlock, true, false);
+		auto_unlock, true, false, diff, checkpoint_path ? &checkpoint : NULL);
+	if (checkpoint_path)
+		flash_checkpoint_close(&checkpoint);
 	if (retval != ERROR_OK) {
 		image_close(&image);
 		return retval;
@@ -455,11 +525,193 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 			duration_elapsed(&bench), duration_kbps(&bench, written));
 	}
 
+	if (stats)
+		flash_stats_print(CMD, &flash_stats);
+
 	image_close(&image);
 
 	return retval;
 }
 
+/* targets programmed at once by 'flash gang_write_image' */
+#define FLASH_GANG_MAX_TARGETS	32
+
+COMMAND_HANDLER(handle_flash_gang_write_image_command)
+{
+	struct target *targets[FLASH_GANG_MAX_TARGETS];
+	unsigned int num_targets = 0;
+	struct image image;
+	bool auto_erase = false;
+	bool auto_unlock = false;
+	bool verify = false;
+	int retval;
+
+	while (CMD_ARGC) {
+		if (strcmp(CMD_ARGV[0], "erase") == 0)
+			auto_erase = true;
+		else if (strcmp(CMD_ARGV[0], "unlock") == 0)
+			auto_unlock = true;
+		else if (strcmp(CMD_ARGV[0], "verify") == 0)
+			verify = true;
+		else
+			break;
+		CMD_ARGV++;
+		CMD_ARGC--;
+	}
+
+	if (CMD_ARGC < 2 || CMD_ARGC > 4)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	/* a list of target names */
+	char *names = strdup(CMD_ARGV[0]);
+	if (!names) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	for (char *name = strtok(names, " \t\n"); name; name = strtok(NULL, " \t\n")) {
+		struct target *target = get_target(name);
+
+		if (!target) {
+			command_print(CMD, "target '%s' not defined", name);
+			free(names);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		if (num_targets == FLASH_GANG_MAX_TARGETS) {
+			command_print(CMD, "at most %d targets", FLASH_GANG_MAX_TARGETS);
+			free(names);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		targets[num_targets++] = target;
+	}
+	free(names);
+
+	if (!num_targets)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC >= 3) {
+		image.base_address_set = true;
+		COMMAND_PARSE_NUMBER(llong, CMD_ARGV[2], image.base_address);
+	} else {
+		image.base_address_set = false;
+		image.base_address = 0x0;
+	}
+
+	image.start_address_set = false;
+
+	retval = image_open(&image, CMD_ARGV[1], (CMD_ARGC == 4) ? CMD_ARGV[3] : NULL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct duration bench;
+	duration_start(&bench);
+
+	/* the targets erase at the same time, the writes skip the erased sectors */
+	if (auto_erase) {
+		for (unsigned int i = 0; i < num_targets; i++) {
+			if (flash_erase_image_start(targets[i], &image, auto_unlock) != ERROR_OK)
+				LOG_WARNING("%s: erasing the flash early failed", target_name(targets[i]));
+		}
+		if (flash_erase_image_finish() != ERROR_OK)
+			LOG_WARNING("erasing the flash early failed");
+
+		if (duration_measure(&bench) == ERROR_OK)
+			command_print(CMD, "erased the flash of %u targets in %fs",
+				num_targets, duration_elapsed(&bench));
+	}
+
+	unsigned int failed = 0;
+	for (unsigned int i = 0; i < num_targets; i++) {
+		struct duration target_bench;
+		uint32_t written;
+
+		duration_start(&target_bench);
+		retval = flash_write_unlock_verify(targets[i], &image, &written, auto_erase,
+			auto_unlock, true, verify, false, NULL);
+
+		if (retval != ERROR_OK) {
+			command_print(CMD, "%s: failed", target_name(targets[i]));
+			failed++;
+		} else if (duration_measure(&target_bench) == ERROR_OK) {
+			command_print(CMD, "%s: wrote %" PRIu32 " bytes in %fs (%0.3f KiB/s)%s",
+				target_name(targets[i]), written, duration_elapsed(&target_bench),
+				duration_kbps(&target_bench, written), verify ? ", verified" : "");
+		}
+	}
+
+	image_close(&image);
+
+	if (duration_measure(&bench) == ERROR_OK)
+		command_print(CMD, "programmed %u of %u targets in %fs",
+			num_targets - failed, num_targets, duration_elapsed(&bench));
+
+	return failed ? ERROR_FAIL : ERROR_OK;
+}
+
+/* the data written by default by 'flash benchmark' */
+#define FLASH_BENCHMARK_SIZE	(64 * 1024)
+
+COMMAND_HANDLER(handle_flash_benchmark_command)
+{
+	struct flash_bank *bank;
+	uint32_t size = FLASH_BENCHMARK_SIZE;
+	int retval;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+
+	if (size == 0 || bank->num_sectors == 0)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	/* whole sectors from the start of the bank */
+	uint32_t end = 0;
+	for (unsigned int i = 0; i < bank->num_sectors && end < size; i++)
+		end = bank->sectors[i].offset + bank->sectors[i].size;
+	size = MIN(end, bank->size);
+
+	uint8_t *buffer = malloc(size);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	/* xorshift, a pattern neither compressible nor blank */
+	uint32_t random = 0x2545f491;
+	for (uint32_t i = 0; i < size; i++) {
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		buffer[i] = random;
+	}
+
+	struct flash_stats flash_stats;
+	flash_stats_start(&flash_stats);
+
+	command_print(CMD, "erasing, writing and verifying %" PRIu32 " bytes at " TARGET_ADDR_FMT,
+		size, bank->base);
+
+	retval = flash_erase_address_range(bank->target, false, bank->base, size);
+	if (retval == ERROR_OK)
+		retval = flash_driver_write(bank, buffer, 0, size);
+	if (retval == ERROR_OK)
+		retval = flash_driver_verify(bank, buffer, 0, size);
+
+	free(buffer);
+
+	if (retval != ERROR_OK)
+		return retval;
+
+	flash_stats_print(CMD, &flash_stats);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_flash_verify_image_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -495,7 +747,7 @@ COMMAND_HANDLER(handle_flash_verify_image_command)
 		return retval;
 
 	retval = flash_write_unlock_verify(target, &image, &verified, false,
-		false, false, true);
+		false, false, true, false, NULL);
 	if (retval != ERROR_OK) {
 		image_close(&image);
 		return retval;
@@ -843,13 +1095,14 @@ COMMAND_HANDLER(handle_flash_write_bank_command)
 	return retval;
 }
 
+#define FLASH_READ_BANK_CHUNK	(256 * 1024)
+
 COMMAND_HANDLER(handle_flash_read_bank_command)
 {
 	uint32_t offset;
 	uint8_t *buffer;
 	struct fileio *fileio;
 	uint32_t length;
-	size_t written;
 
 	if (CMD_ARGC < 2 || CMD_ARGC > 4)
 		return ERROR_COMMAND_SYNTAX_ERROR;
@@ -885,19 +1138,14 @@ COMMAND_HANDLER(handle_flash_read_bank_command)
 		return ERROR_COMMAND_ARGUMENT_INVALID;
 	}
 
-	buffer = malloc(length);
+	/* the bank is read and written in chunks, not all in memory */
+	uint32_t buf_size = MIN(length, FLASH_READ_BANK_CHUNK);
+	buffer = malloc(MAX(buf_size, 1));
 	if (!buffer) {
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
 
-	retval = flash_driver_read(p, buffer, offset, length);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Read error");
-		free(buffer);
-		return retval;
-	}
-
 	retval = fileio_open(&fileio, CMD_ARGV[1], FILEIO_WRITE, FILEIO_BINARY);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Could not open file");
@@ -905,19 +1153,43 @@ COMMAND_HANDLER(handle_flash_read_bank_command)
 		return retval;
 	}
 
-	retval = fileio_write(fileio, length, buffer, &written);
+	/* the checksum of verify_image, computed on the way */
+	uint32_t crc = 0xffffffff;
+	size_t written = 0;
+
+	for (uint32_t done = 0; done < length; ) {
+		uint32_t count = MIN(length - done, buf_size);
+		size_t size_written;
+
+		retval = flash_driver_read(p, buffer, offset + done, count);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Read error");
+			break;
+		}
+
+		retval = fileio_write(fileio, count, buffer, &size_written);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Could not write file");
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		crc = crc32_be(CRC32_POLY_BE, crc, buffer, count);
+		written += size_written;
+		done += count;
+		keep_alive();
+	}
+
 	fileio_close(fileio);
 	free(buffer);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not write file");
-		return ERROR_FAIL;
-	}
+	if (retval != ERROR_OK)
+		return retval;
 
 	if (duration_measure(&bench) == ERROR_OK)
 		command_print(CMD, "wrote %zd bytes to file %s from flash bank %u"
-			" at offset 0x%8.8" PRIx32 " in %fs (%0.3f KiB/s)",
+			" at offset 0x%8.8" PRIx32 " in %fs (%0.3f KiB/s), checksum 0x%08" PRIx32,
 			written, CMD_ARGV[1], p->bank_number, offset,
-			duration_elapsed(&bench), duration_kbps(&bench, written));
+			duration_elapsed(&bench), duration_kbps(&bench, written), crc);
 
 	return retval;
 }
@@ -1182,10 +1454,33 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.name = "write_image",
 		.handler = handle_flash_write_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "[erase] [unlock] filename [offset [file_type]]",
+		.usage = "[erase] [unlock] [diff] [stats] "
+			"[(checkpoint|resume|manifest) checkpoint_file] "
+			"[uid uid_address uid_length] filename [offset [file_type]]",
 		.help = "Write an image to flash.  Optionally first unprotect "
-			"and/or erase the region to be used. Allow optional "
-			"offset from beginning of bank (defaults to zero)",
+			"and/or erase the region to be used, or only write the "
+			"sectors whose contents differ, or record the sectors "
+			"written in a checkpoint file and resume from it, or "
+			"skip those it records for the image programmed last. "
+			"Allow optional offset from beginning of bank (defaults "
+			"to zero)",
+	},
+	{
+		.name = "gang_write_image",
+		.handler = handle_flash_gang_write_image_command,
+		.mode = COMMAND_EXEC,
+		.usage = "[erase] [unlock] [verify] target_list filename [offset [file_type]]",
+		.help = "Write an image to the flash of several targets, erasing "
+			"all of them at the same time",
+	},
+	{
+		.name = "benchmark",
+		.handler = handle_flash_benchmark_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id [size]",
+		.help = "Erase, write a pseudorandom pattern to and verify the "
+			"sectors at the start of the bank, and report the "
+			"throughput of each phase",
 	},
 	{
 		.name = "verify_image",
@@ -5,7 +5,7 @@
 #
 # program utility proc
 # usage: program filename
-# optional args: verify, reset, exit and address
+# optional args: preverify, verify, diff, reset, exit and address
 #
 
 lappend _telnet_autocomplete_skip program_error
@@ -27,6 +27,8 @@ proc program {filename args} {
 			set preverify 1
 		} elseif {[string equal $arg "verify"]} {
 			set verify 1
+		} elseif {[string equal $arg "diff"]} {
+			set diff 1
 		} elseif {[string equal $arg "reset"]} {
 			set reset 1
 		} elseif {[string equal $arg "exit"]} {
@@ -68,7 +70,12 @@ proc program {filename args} {
 	if {$needsflash == 1} {
 		echo "** Programming Started **"
 
-		if {[catch {eval flash write_image erase $flash_args}] == 0} {
+		if {[info exists diff]} {
+			set write_args "erase diff $flash_args"
+		} else {
+			set write_args "erase $flash_args"
+		}
+		if {[catch {eval flash write_image $write_args}] == 0} {
 			echo "** Programming Finished **"
 			if {[info exists verify]} {
 				# verify phase
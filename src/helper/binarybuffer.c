@@ -74,7 +74,7 @@ bool buf_cmp(const void *_buf1, const void *_buf2, unsigned size)
 
 	unsigned last = size / 8;
 	if (memcmp(_buf1, _buf2, last) != 0)
-		return false;
+		return true;
 
 	unsigned trailing = size % 8;
 	if (!trailing)
@@ -92,7 +92,15 @@ bool buf_cmp_mask(const void *_buf1, const void *_buf2,
 
 	const uint8_t *buf1 = _buf1, *buf2 = _buf2, *mask = _mask;
 	unsigned last = size / 8;
-	for (unsigned i = 0; i < last; i++) {
+	unsigned i = 0;
+
+	/* compare a 64-bit word at a time, then the remaining bytes */
+	for (; i + 8 <= last; i += 8) {
+		uint64_t diff = le_to_h_u64(buf1 + i) ^ le_to_h_u64(buf2 + i);
+		if (diff & le_to_h_u64(mask + i))
+			return true;
+	}
+	for (; i < last; i++) {
 		if (buf_cmp_masked(buf1[i], buf2[i], mask[i]))
 			return true;
 	}
@@ -118,46 +126,79 @@ void *buf_set_ones(void *_buf, unsigned size)
 	return buf;
 }
 
+/* @returns the @a n (1..8) bits of @a src starting at bit @a pos */
+static inline uint8_t buf_get_bits8(const uint8_t *src, unsigned pos, unsigned n)
+{
+	unsigned q = pos % 8;
+	unsigned bits = src[pos / 8] >> q;
+
+	/* only touch the next byte if it holds some of the requested bits */
+	if (q + n > 8)
+		bits |= src[pos / 8 + 1] << (8 - q);
+
+	return bits & (0xff >> (8 - n));
+}
+
+/* @returns the 64 bits of @a src starting at bit @a pos */
+static inline uint64_t buf_get_bits64(const uint8_t *src, unsigned pos)
+{
+	unsigned q = pos % 8;
+	uint64_t bits = le_to_h_u64(src + pos / 8);
+
+	if (q)
+		bits = (bits >> q) | ((uint64_t)src[pos / 8 + 8] << (64 - q));
+
+	return bits;
+}
+
 void *buf_set_buf(const void *_src, unsigned src_start,
 	void *_dst, unsigned dst_start, unsigned len)
 {
 	const uint8_t *src = _src;
 	uint8_t *dst = _dst;
-	unsigned i, sb, db, sq, dq, lb, lq;
+	unsigned sq, dq, n;
+
+	if (!len)
+		return _dst;
 
-	sb = src_start / 8;
-	db = dst_start / 8;
+	src += src_start / 8;
+	dst += dst_start / 8;
 	sq = src_start % 8;
 	dq = dst_start % 8;
-	lb = len / 8;
-	lq = len % 8;
-
-	src += sb;
-	dst += db;
 
 	/* check if both buffers are on byte boundary and
 	 * len is a multiple of 8bit so we can simple copy
 	 * the buffer */
-	if ((sq == 0) && (dq == 0) &&  (lq == 0)) {
-		for (i = 0; i < lb; i++)
-			*dst++ = *src++;
+	if ((sq == 0) && (dq == 0) && (len % 8 == 0)) {
+		memmove(dst, src, len / 8);
 		return _dst;
 	}
 
-	/* fallback to slow bit copy */
-	for (i = 0; i < len; i++) {
-		if (((*src >> (sq&7)) & 1) == 1)
-			*dst |= 1 << (dq&7);
-		else
-			*dst &= ~(1 << (dq&7));
-		if (sq++ == 7) {
-			sq = 0;
-			src++;
-		}
-		if (dq++ == 7) {
-			dq = 0;
-			dst++;
-		}
+	/* bring the destination to a byte boundary */
+	if (dq) {
+		n = MIN(8 - dq, len);
+		uint8_t mask = (0xff >> (8 - n)) << dq;
+		*dst = (*dst & ~mask) | (buf_get_bits8(src, sq, n) << dq);
+		len -= n;
+		sq += n;
+		src += sq / 8;
+		sq %= 8;
+		dst++;
+	}
+
+	/*
+	 * The source is read strictly ahead of what is written,
+	 * which keeps in-place shifts towards bit 0 (buffer_shr) safe.
+	 */
+	for (; len >= 64; len -= 64, src += 8, dst += 8)
+		h_u64_to_le(dst, buf_get_bits64(src, sq));
+
+	for (; len >= 8; len -= 8, src++, dst++)
+		*dst = buf_get_bits8(src, sq, 8);
+
+	if (len) {
+		uint8_t mask = 0xff >> (8 - len);
+		*dst = (*dst & ~mask) | buf_get_bits8(src, sq, len);
 	}
 
 	return _dst;
@@ -176,6 +217,12 @@ uint32_t flip_u32(uint32_t value, unsigned int num)
 	return c;
 }
 
+void buf_flip_bytes(uint8_t *buf, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		buf[i] = bit_reverse_table256[buf[i]];
+}
+
 static int ceil_f_to_u32(float x)
 {
 	if (x < 0)	/* return zero for negative numbers */
@@ -409,21 +456,24 @@ size_t hexify(char *hex, const uint8_t *bin, size_t count, size_t length)
 
 void buffer_shr(void *_buf, unsigned buf_len, unsigned count)
 {
-	unsigned i;
 	unsigned char *buf = _buf;
-	unsigned bytes_to_remove;
-	unsigned shift;
+	unsigned bits = buf_len * 8;
 
-	bytes_to_remove = count / 8;
-	shift = count - (bytes_to_remove * 8);
+	if (count >= bits) {
+		memset(buf, 0, buf_len);
+		return;
+	}
 
-	for (i = 0; i < (buf_len - 1); i++)
-		buf[i] = (buf[i] >> shift) | ((buf[i+1] << (8 - shift)) & 0xff);
+	if (!count)
+		return;
 
-	buf[(buf_len - 1)] = buf[(buf_len - 1)] >> shift;
+	/* move the bits towards bit 0, then clear what was shifted out */
+	buf_set_buf(buf, count, buf, 0, bits - count);
 
-	if (bytes_to_remove) {
-		memmove(buf, &buf[bytes_to_remove], buf_len - bytes_to_remove);
-		memset(&buf[buf_len - bytes_to_remove], 0, bytes_to_remove);
+	unsigned first = bits - count;
+	if (first % 8) {
+		buf[first / 8] &= 0xff >> (8 - first % 8);
+		first += 8 - first % 8;
 	}
+	memset(&buf[first / 8], 0, buf_len - first / 8);
 }
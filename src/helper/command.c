@@ -19,6 +19,7 @@
 #endif
 
 /* @todo the inclusion of target.h here is a layering violation */
+#include <jtag/adapter.h>
 #include <jtag/jtag.h>
 #include <target/target.h>
 #include "command.h"
@@ -58,8 +59,8 @@ void *jimcmd_privdata(Jim_Cmd *cmd)
 	return cmd->isproc ? NULL : cmd->u.native.privData;
 }
 
-static void tcl_output(void *privData, const char *file, unsigned line,
-	const char *function, const char *string)
+static void tcl_output(void *privData, enum log_levels level, const char *file,
+	unsigned int line, const char *function, const char *string)
 {
 	struct log_capture_state *state = privData;
 	Jim_AppendString(state->interp, state->output, string, strlen(string));
@@ -138,7 +139,7 @@ extern struct command_context *global_cmd_ctx;
  * Do nothing in case we are not at debug level 3 */
 static void script_debug(Jim_Interp *interp, unsigned int argc, Jim_Obj * const *argv)
 {
-	if (debug_level < LOG_LVL_DEBUG)
+	if (!LOG_LEVEL_IS(LOG_LVL_DEBUG))
 		return;
 
 	char *dbg = alloc_printf("command -");
@@ -259,6 +260,7 @@ static void command_free(struct Jim_Interp *interp, void *priv)
 {
 	struct command *c = priv;
 
+	free(c->subcmd_name);
 	free(c->name);
 	free(c);
 }
@@ -530,7 +532,9 @@ static int run_command(struct command_context *context,
 	cmd.output = Jim_NewEmptyStringObj(context->interp);
 	Jim_IncrRefCount(cmd.output);
 
+	adapter_stats_begin_op();
 	int retval = c->handler(&cmd);
+	adapter_stats_end_op();
 	if (retval == ERROR_COMMAND_SYNTAX_ERROR) {
 		/* Print help for command */
 		command_run_linef(context, "usage %s", words[0]);
@@ -911,14 +915,63 @@ static int exec_command(Jim_Interp *interp, struct command_context *cmd_ctx,
 	return command_retval_set(interp, retval);
 }
 
+/*
+ * Look up whether any Jim command, OpenOCD command or Tcl proc, is named
+ * "<name> <word>". Most commands have no subcommands, and scripts calling
+ * e.g. mdw in a loop would otherwise pay a lookup of "mdw <address>" each
+ * time. The answer is kept until the set of Jim commands changes: Jim bumps
+ * procEpoch when a command is deleted or replaced, creating a command adds
+ * an entry to the command table.
+ */
+static bool command_has_subcommands(Jim_Interp *interp, struct command *c, Jim_Obj *name)
+{
+	int len;
+	const char *s = Jim_GetString(name, &len);
+
+	if (c->subcmd_name && c->subcmd_epoch == interp->procEpoch
+			&& c->subcmd_commands == interp->commands.used
+			&& !strcmp(c->subcmd_name, s))
+		return c->has_subcmds;
+
+	/* glob pattern "<name> *" */
+	Jim_Obj *pattern = Jim_NewEmptyStringObj(interp);
+	for (int i = 0; i < len; i++) {
+		if (strchr("*?[]\\", s[i]))
+			Jim_AppendString(interp, pattern, "\\", 1);
+		Jim_AppendString(interp, pattern, &s[i], 1);
+	}
+	Jim_AppendString(interp, pattern, " *", 2);
+
+	Jim_Obj *objv[] = {
+		Jim_NewStringObj(interp, "info", -1),
+		Jim_NewStringObj(interp, "commands", -1),
+		pattern,
+	};
+	if (Jim_EvalObjVector(interp, ARRAY_SIZE(objv), objv) != JIM_OK)
+		return true;
+
+	char *subcmd_name = strdup(s);
+	if (!subcmd_name)
+		return true;
+
+	free(c->subcmd_name);
+	c->subcmd_name = subcmd_name;
+	c->subcmd_epoch = interp->procEpoch;
+	c->subcmd_commands = interp->commands.used;
+	c->has_subcmds = Jim_ListLength(interp, Jim_GetResult(interp)) > 0;
+
+	return c->has_subcmds;
+}
+
 static int jim_command_dispatch(Jim_Interp *interp, int argc, Jim_Obj * const *argv)
 {
+	struct command *c = jim_to_command(interp);
+
 	/* check subcommands */
-	if (argc > 1) {
-		char *s = alloc_printf("%s %s", Jim_GetString(argv[0], NULL), Jim_GetString(argv[1], NULL));
-		Jim_Obj *js = Jim_NewStringObj(interp, s, -1);
+	if (argc > 1 && command_has_subcommands(interp, c, argv[0])) {
+		Jim_Obj *js = Jim_DuplicateObj(interp, argv[0]);
+		Jim_AppendStrings(interp, js, " ", Jim_String(argv[1]), NULL);
 		Jim_IncrRefCount(js);
-		free(s);
 		Jim_Cmd *cmd = Jim_GetCommand(interp, js, JIM_NONE);
 		if (cmd) {
 			int retval = Jim_EvalObjPrefix(interp, js, argc - 2, argv + 2);
@@ -930,7 +983,6 @@ static int jim_command_dispatch(Jim_Interp *interp, int argc, Jim_Obj * const *a
 
 	script_debug(interp, argc, argv);
 
-	struct command *c = jim_to_command(interp);
 	if (!c->jim_handler && !c->handler) {
 		Jim_EvalObjPrefix(interp, Jim_NewStringObj(interp, "usage", -1), 1, argv);
 		return JIM_ERR;
@@ -197,6 +197,11 @@ struct command {
 	struct target *jim_override_target;
 		/* Used only for target of target-prefixed cmd */
 	enum command_mode mode;
+	/* Whether Jim commands "<subcmd_name> <word>" exist, see command_has_subcommands() */
+	char *subcmd_name;
+	unsigned long subcmd_epoch;
+	unsigned int subcmd_commands;
+	bool has_subcmds;
 };
 
 /*
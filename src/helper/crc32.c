@@ -13,9 +13,22 @@
 #endif
 
 #include "crc32.h"
+#include "types.h"
 #include <stdint.h>
 #include <stddef.h>
 
+/* Tables for the slice-by-8 algorithm: t[0] is the usual byte table, t[k]
+ * advances the CRC of a byte followed by k zero bytes. The tables of the
+ * last polynomial used are kept. */
+struct crc32_tables {
+	bool valid;
+	uint32_t poly;
+	uint32_t t[8][256];
+};
+
+static struct crc32_tables crc32_le_tables;
+static struct crc32_tables crc32_be_tables;
+
 static uint32_t crc_le_step(uint32_t poly, uint32_t crc, uint32_t data_in,
 		unsigned int data_bits)
 {
@@ -30,21 +43,110 @@ static uint32_t crc_le_step(uint32_t poly, uint32_t crc, uint32_t data_in,
 	return crc;
 }
 
+static const struct crc32_tables *crc32_le_get_tables(uint32_t poly)
+{
+	struct crc32_tables *tables = &crc32_le_tables;
+
+	if (tables->valid && tables->poly == poly)
+		return tables;
+
+	for (unsigned int i = 0; i < 256; i++)
+		tables->t[0][i] = crc_le_step(poly, 0, i, 8);
+	for (unsigned int k = 1; k < 8; k++)
+		for (unsigned int i = 0; i < 256; i++) {
+			uint32_t c = tables->t[k - 1][i];
+			tables->t[k][i] = (c >> 8) ^ tables->t[0][c & 0xff];
+		}
+
+	tables->poly = poly;
+	tables->valid = true;
+
+	return tables;
+}
+
+static const struct crc32_tables *crc32_be_get_tables(uint32_t poly)
+{
+	struct crc32_tables *tables = &crc32_be_tables;
+
+	if (tables->valid && tables->poly == poly)
+		return tables;
+
+	for (unsigned int i = 0; i < 256; i++) {
+		uint32_t c = i << 24;
+		for (unsigned int j = 0; j < 8; j++)
+			c = (c & 0x80000000) ? (c << 1) ^ poly : (c << 1);
+		tables->t[0][i] = c;
+	}
+	for (unsigned int k = 1; k < 8; k++)
+		for (unsigned int i = 0; i < 256; i++) {
+			uint32_t c = tables->t[k - 1][i];
+			tables->t[k][i] = (c << 8) ^ tables->t[0][c >> 24];
+		}
+
+	tables->poly = poly;
+	tables->valid = true;
+
+	return tables;
+}
+
+/* Advance a LSB first CRC over 8 bytes, given as two little endian words */
+static inline uint32_t crc32_le_slice8(const struct crc32_tables *tables,
+		uint32_t crc, uint32_t lo, uint32_t hi)
+{
+	lo ^= crc;
+	return tables->t[7][lo & 0xff] ^ tables->t[6][(lo >> 8) & 0xff] ^
+		tables->t[5][(lo >> 16) & 0xff] ^ tables->t[4][lo >> 24] ^
+		tables->t[3][hi & 0xff] ^ tables->t[2][(hi >> 8) & 0xff] ^
+		tables->t[1][(hi >> 16) & 0xff] ^ tables->t[0][hi >> 24];
+}
+
 uint32_t crc32_le(uint32_t poly, uint32_t seed, const void *_data,
 		size_t data_len)
 {
+	const struct crc32_tables *tables = crc32_le_get_tables(poly);
+
 	if (((uintptr_t)_data & 0x3) || (data_len & 0x3)) {
 		/* data is unaligned, processing data one byte at a time */
 		const uint8_t *data = _data;
+		for (; data_len >= 8; data_len -= 8, data += 8)
+			seed = crc32_le_slice8(tables, seed, le_to_h_u32(data),
+					le_to_h_u32(data + 4));
 		for (size_t i = 0; i < data_len; i++)
-			seed = crc_le_step(poly, seed, data[i], 8);
+			seed = (seed >> 8) ^ tables->t[0][(seed ^ data[i]) & 0xff];
 	} else {
 		/* data is aligned, processing 32 bit at a time */
 		data_len >>= 2;
 		const uint32_t *data = _data;
-		for (size_t i = 0; i < data_len; i++)
-			seed = crc_le_step(poly, seed, data[i], 32);
+		size_t i = 0;
+		for (; i + 1 < data_len; i += 2)
+			seed = crc32_le_slice8(tables, seed, data[i], data[i + 1]);
+		if (i < data_len) {
+			seed ^= data[i];
+			for (unsigned int j = 0; j < 4; j++)
+				seed = (seed >> 8) ^ tables->t[0][seed & 0xff];
+		}
 	}
 
 	return seed;
 }
+
+uint32_t crc32_be(uint32_t poly, uint32_t seed, const void *_data,
+		size_t data_len)
+{
+	const struct crc32_tables *tables = crc32_be_get_tables(poly);
+	const uint8_t *data = _data;
+
+	for (; data_len >= 8; data_len -= 8, data += 8) {
+		uint32_t hi = seed ^ be_to_h_u32(data);
+		uint32_t lo = be_to_h_u32(data + 4);
+		seed = tables->t[7][hi >> 24] ^ tables->t[6][(hi >> 16) & 0xff] ^
+			tables->t[5][(hi >> 8) & 0xff] ^ tables->t[4][hi & 0xff] ^
+			tables->t[3][lo >> 24] ^ tables->t[2][(lo >> 16) & 0xff] ^
+			tables->t[1][(lo >> 8) & 0xff] ^ tables->t[0][lo & 0xff];
+	}
+
+	for (size_t i = 0; i < data_len; i++)
+		seed = (seed << 8) ^ tables->t[0][(seed >> 24) ^ data[i]];
+
+	return seed;
+}
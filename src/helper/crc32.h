@@ -20,6 +20,11 @@
  */
 #define CRC32_POLY_LE	0xedb88320
 
+/**
+ * The same polynomial, for MSB first CRC32 as used by GDB and MPEG-2
+ */
+#define CRC32_POLY_BE	0x04c11db7
+
 /**
  * Calculate the CRC32 value of the given data
  * @param	poly		The polynomial of the CRC
@@ -34,4 +39,17 @@
 uint32_t crc32_le(uint32_t poly, uint32_t seed, const void *data,
 		size_t data_len);
 
+/**
+ * Calculate the MSB first CRC32 value of the given data
+ * @param	poly		The polynomial of the CRC, not bit reversed
+ * @param	seed		The seed to use (mostly either `0` or `0xffffffff`)
+ * @param	data		The data to calculate the CRC32 of
+ * @param	data_len	The length of the data in @p data in bytes
+ * @return	The CRC value of the first @p data_len bytes at @p data
+ * @note	Like crc32_le(), the CRC of a chunk can be used as @p seed to
+ *			continue the computation with the next chunk.
+ */
+uint32_t crc32_be(uint32_t poly, uint32_t seed, const void *data,
+		size_t data_len);
+
 #endif /* OPENOCD_HELPER_CRC32_H */
@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Binary trace of the transactions with the debug adapter.
+ *
+ * Each DAP, DMI and JTAG queue transaction adds one fixed-size record to a
+ * ring in a memory-mapped file, which costs far less than formatting a
+ * debug message. Without mmap() the ring is kept in memory and written to
+ * the file when tracing stops.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include "event_trace.h"
+#include "log.h"
+#include "replacements.h"
+
+#define EVENT_TRACE_DEFAULT_RECORDS	(1024 * 1024)
+#define EVENT_TRACE_MAX_RECORDS		(16 * 1024 * 1024)
+
+bool event_trace_enabled;
+
+static struct {
+	FILE *file;
+	char *file_name;
+	/* header, followed by the ring of records */
+	struct event_trace_header *header;
+	struct event_trace_record *records;
+	size_t size;
+	bool mapped;
+	int64_t start;
+} trace;
+
+void event_trace_add(enum event_trace_type type, int64_t begin, uint64_t unit,
+		uint64_t address, uint64_t value, int status)
+{
+	int64_t now = timeval_us();
+
+	/* tracing started while the transaction was running */
+	if (begin < trace.start)
+		begin = trace.start;
+
+	struct event_trace_record *record =
+		&trace.records[trace.header->count % trace.header->capacity];
+	record->timestamp = begin - trace.start;
+	record->unit = unit;
+	record->address = address;
+	record->value = value;
+	record->duration = MIN(now - begin, (int64_t)UINT32_MAX);
+	record->type = type;
+	record->status = MAX(MIN(status, INT16_MAX), INT16_MIN);
+	trace.header->count++;
+}
+
+static int event_trace_start(const char *file_name, uint64_t capacity)
+{
+	size_t size = sizeof(struct event_trace_header)
+		+ capacity * sizeof(struct event_trace_record);
+
+	FILE *file = fopen(file_name, "w+b");
+	if (!file) {
+		LOG_ERROR("can't open trace file '%s'", file_name);
+		return ERROR_FAIL;
+	}
+
+	void *buffer = NULL;
+	bool mapped = false;
+#ifdef HAVE_SYS_MMAN_H
+	if (!ftruncate(fileno(file), size)) {
+		buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(file), 0);
+		if (buffer == MAP_FAILED)
+			buffer = NULL;
+		else
+			mapped = true;
+	}
+#endif
+	if (!buffer)
+		buffer = calloc(1, size);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		fclose(file);
+		return ERROR_FAIL;
+	}
+
+	trace.file_name = strdup(file_name);
+	trace.file = file;
+	trace.header = buffer;
+	trace.records = (struct event_trace_record *)(trace.header + 1);
+	trace.size = size;
+	trace.mapped = mapped;
+	trace.start = timeval_us();
+
+	memcpy(trace.header->magic, EVENT_TRACE_MAGIC, sizeof(trace.header->magic));
+	trace.header->version = EVENT_TRACE_VERSION;
+	trace.header->record_size = sizeof(struct event_trace_record);
+	trace.header->capacity = capacity;
+	trace.header->count = 0;
+	trace.header->start_time = trace.start;
+
+	event_trace_enabled = true;
+
+	return ERROR_OK;
+}
+
+void event_trace_stop(void)
+{
+	if (!trace.header)
+		return;
+
+	event_trace_enabled = false;
+
+	uint64_t records = MIN(trace.header->count, trace.header->capacity);
+	size_t size = sizeof(struct event_trace_header)
+		+ records * sizeof(struct event_trace_record);
+
+	if (trace.mapped) {
+#ifdef HAVE_SYS_MMAN_H
+		munmap(trace.header, trace.size);
+		/* drop the unused part of the ring */
+		if (ftruncate(fileno(trace.file), size))
+			LOG_WARNING("can't truncate trace file '%s'", trace.file_name);
+#endif
+	} else {
+		if (fwrite(trace.header, 1, size, trace.file) != size)
+			LOG_ERROR("can't write trace file '%s'", trace.file_name);
+		free(trace.header);
+	}
+
+	if (fclose(trace.file))
+		LOG_ERROR("can't write trace file '%s'", trace.file_name);
+
+	free(trace.file_name);
+	trace.file_name = NULL;
+	trace.file = NULL;
+	trace.header = NULL;
+	trace.records = NULL;
+}
+
+COMMAND_HANDLER(handle_event_trace_start_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint64_t capacity = EVENT_TRACE_DEFAULT_RECORDS;
+	if (CMD_ARGC == 2) {
+		COMMAND_PARSE_NUMBER(u64, CMD_ARGV[1], capacity);
+		if (!capacity || capacity > EVENT_TRACE_MAX_RECORDS) {
+			command_print(CMD, "number of records must be from 1 to %d",
+					EVENT_TRACE_MAX_RECORDS);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	event_trace_stop();
+
+	return event_trace_start(CMD_ARGV[0], capacity);
+}
+
+COMMAND_HANDLER(handle_event_trace_stop_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	event_trace_stop();
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_event_trace_status_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!trace.header) {
+		command_print(CMD, "event trace off");
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "event trace to '%s', %" PRIu64 " records written, %" PRIu64
+			" kept", trace.file_name, trace.header->count,
+			MIN(trace.header->count, trace.header->capacity));
+
+	return ERROR_OK;
+}
+
+static const struct command_registration event_trace_subcommand_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_event_trace_start_command,
+		.mode = COMMAND_ANY,
+		.help = "start recording the adapter transactions to a file, "
+			"keeping the last records written",
+		.usage = "file_name [records]",
+	},
+	{
+		.name = "stop",
+		.handler = handle_event_trace_stop_command,
+		.mode = COMMAND_ANY,
+		.help = "stop recording and close the trace file",
+		.usage = "",
+	},
+	{
+		.name = "status",
+		.handler = handle_event_trace_status_command,
+		.mode = COMMAND_ANY,
+		.help = "display the state of the event trace",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration event_trace_command_handlers[] = {
+	{
+		.name = "event_trace",
+		.mode = COMMAND_ANY,
+		.help = "binary trace of the adapter transactions",
+		.usage = "",
+		.chain = event_trace_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int event_trace_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, event_trace_command_handlers);
+}
@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_HELPER_EVENT_TRACE_H
+#define OPENOCD_HELPER_EVENT_TRACE_H
+
+#include <helper/command.h>
+#include <helper/time_support.h>
+#include <helper/types.h>
+
+/*
+ * Binary trace of the transactions with the debug adapter. The trace file
+ * starts with a struct event_trace_header and holds a ring of fixed-size
+ * struct event_trace_record, both in host byte order. The records are
+ * decoded by contrib/event_trace2json.py.
+ */
+
+#define EVENT_TRACE_MAGIC		"OCDTRACE"
+#define EVENT_TRACE_VERSION		1
+
+/* Don't change the numbers, they are stored in the trace files */
+enum event_trace_type {
+	EVENT_TRACE_JTAG_EXECUTE_QUEUE = 1,
+	EVENT_TRACE_DAP_DP_READ = 2,
+	EVENT_TRACE_DAP_DP_WRITE = 3,
+	EVENT_TRACE_DAP_AP_READ = 4,
+	EVENT_TRACE_DAP_AP_WRITE = 5,
+	EVENT_TRACE_DAP_RUN = 6,
+	EVENT_TRACE_RISCV_BATCH_RUN = 7,
+	EVENT_TRACE_RISCV_DMI_NOP = 8,
+	EVENT_TRACE_RISCV_DMI_READ = 9,
+	EVENT_TRACE_RISCV_DMI_WRITE = 10,
+};
+
+struct event_trace_header {
+	char magic[8];
+	uint32_t version;
+	/** sizeof(struct event_trace_record) */
+	uint32_t record_size;
+	/** number of records the file holds */
+	uint64_t capacity;
+	/** records written so far; record n is at index n % capacity */
+	uint64_t count;
+	/** start of the trace, in microseconds since the epoch */
+	int64_t start_time;
+	uint8_t reserved[24];
+};
+
+struct event_trace_record {
+	/** start of the transaction, in microseconds since the trace start */
+	uint64_t timestamp;
+	/** AP number or ADIv6 AP address, target core, ... */
+	uint64_t unit;
+	/** DP, AP or DMI register address */
+	uint64_t address;
+	/**
+	 * data written or captured by a DMI scan, number of scans of a batch,
+	 * count of JTAG queue flushes;
+	 * DAP reads are only queued, so their value is 0
+	 */
+	uint64_t value;
+	/** in microseconds */
+	uint32_t duration;
+	uint16_t type;
+	/** error code of the transaction, ERROR_OK on success */
+	int16_t status;
+};
+
+extern bool event_trace_enabled;
+
+void event_trace_add(enum event_trace_type type, int64_t begin, uint64_t unit,
+		uint64_t address, uint64_t value, int status);
+
+/** @returns the start time of a traced transaction, 0 if tracing is off */
+static inline int64_t event_trace_begin(void)
+{
+	return event_trace_enabled ? timeval_us() : 0;
+}
+
+/** Record a transaction started at @a begin, if tracing is on */
+static inline void event_trace_end(enum event_trace_type type, int64_t begin,
+		uint64_t unit, uint64_t address, uint64_t value, int status)
+{
+	if (event_trace_enabled)
+		event_trace_add(type, begin, unit, address, value, status);
+}
+
+void event_trace_stop(void);
+
+int event_trace_register_commands(struct command_context *cmd_ctx);
+
+#endif /* OPENOCD_HELPER_EVENT_TRACE_H */
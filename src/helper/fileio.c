@@ -16,20 +16,152 @@
 #endif
 
 #include "log.h"
+#include "command.h"
 #include "configuration.h"
 #include "fileio.h"
 #include "replacements.h"
 
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/* the stdio buffer of the files, 0 for the default of the host */
+static size_t fileio_buffer_size = FILEIO_BUFFER_SIZE;
+
 struct fileio {
 	char *url;
 	size_t size;
 	enum fileio_type type;
 	enum fileio_access access;
 	FILE *file;
+	/* the stdio buffer, NULL for the default one */
+	char *buffer;
+	/* the file mapped by fileio_map(), NULL if not yet */
+	void *map;
+#ifdef HAVE_ZLIB
+	/* the decompressed stream of a gzip file, NULL for other files */
+	gzFile gz;
+	/* the decompressed size is known, it takes a pass through the stream */
+	bool size_known;
+#endif
 };
 
+#define GZIP_MAGIC	"\x1f\x8b"
+#define ZSTD_MAGIC	"\x28\xb5\x2f\xfd"
+
+/*
+ * A compressed file opened for reading is decompressed on the fly, without
+ * a temporary file. Seeking backwards restarts the decompression, which the
+ * readers of the images, going through the file in order, hardly do.
+ */
+static int fileio_open_compressed(struct fileio *fileio)
+{
+	char magic[4];
+	size_t n = fread(magic, 1, sizeof(magic), fileio->file);
+
+	if (fseek(fileio->file, 0, SEEK_SET) != 0)
+		return ERROR_FILEIO_OPERATION_FAILED;
+
+	if (n == sizeof(magic) && !memcmp(magic, ZSTD_MAGIC, 4)) {
+		LOG_ERROR("%s is zstd compressed, which isn't supported, use gzip", fileio->url);
+		return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+	}
+
+	if (n < 2 || memcmp(magic, GZIP_MAGIC, 2))
+		return ERROR_OK;
+
+#ifdef HAVE_ZLIB
+	/* the stream read ahead, the position of the descriptor is elsewhere */
+	int fd = dup(fileno(fileio->file));
+	if (fd < 0 || lseek(fd, 0, SEEK_SET) != 0) {
+		if (fd >= 0)
+			close(fd);
+		LOG_ERROR("couldn't open %s: %s", fileio->url, strerror(errno));
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+
+	fileio->gz = gzdopen(fd, "rb");
+	if (!fileio->gz) {
+		close(fd);
+		LOG_ERROR("couldn't decompress %s", fileio->url);
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+	if (fileio_buffer_size)
+		gzbuffer(fileio->gz, fileio_buffer_size);
+
+	/* found by fileio_size(), when asked */
+	fileio->size_known = false;
+
+	LOG_DEBUG("decompressing %s", fileio->url);
+
+	return ERROR_OK;
+#else
+	LOG_ERROR("%s is gzip compressed, but OpenOCD is built without zlib", fileio->url);
+	return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+}
+
+#ifdef HAVE_ZLIB
+static int fileio_gz_error(struct fileio *fileio)
+{
+	int errnum;
+	const char *msg = gzerror(fileio->gz, &errnum);
+
+	if (errnum == Z_ERRNO)
+		msg = strerror(errno);
+	LOG_ERROR("couldn't decompress %s: %s", fileio->url, msg);
+
+	return ERROR_FILEIO_OPERATION_FAILED;
+}
+
+/* the decompressed size, the whole stream is decompressed once */
+static int fileio_gz_size(struct fileio *fileio)
+{
+	char *buffer = malloc(FILEIO_BUFFER_SIZE);
+	z_off_t position = gztell(fileio->gz);
+	size_t size = 0;
+	int n;
+
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	if (gzrewind(fileio->gz) != 0) {
+		free(buffer);
+		return fileio_gz_error(fileio);
+	}
+
+	while ((n = gzread(fileio->gz, buffer, FILEIO_BUFFER_SIZE)) > 0) {
+		size += n;
+		keep_alive();
+	}
+	free(buffer);
+
+	if (n < 0 || gzseek(fileio->gz, position, SEEK_SET) < 0)
+		return fileio_gz_error(fileio);
+
+	fileio->size = size;
+	fileio->size_known = true;
+
+	return ERROR_OK;
+}
+#endif
+
 static inline int fileio_close_local(struct fileio *fileio)
 {
+#ifdef HAVE_ZLIB
+	if (fileio->gz)
+		gzclose(fileio->gz);
+	fileio->gz = NULL;
+#endif
+
 	int retval = fclose(fileio->file);
 	if (retval != 0) {
 		if (retval == EBADF)
@@ -81,6 +213,21 @@ static inline int fileio_open_local(struct fileio *fileio)
 		return ERROR_FILEIO_OPERATION_FAILED;
 	}
 
+	/* images, SVF files and the like are read or written at once, in order */
+	if (fileio_buffer_size) {
+		fileio->buffer = malloc(fileio_buffer_size);
+		if (fileio->buffer && setvbuf(fileio->file, fileio->buffer, _IOFBF,
+				fileio_buffer_size) != 0) {
+			free(fileio->buffer);
+			fileio->buffer = NULL;
+		}
+	}
+
+#ifdef HAVE_POSIX_FADVISE
+	if (fileio->access == FILEIO_READ)
+		posix_fadvise(fileno(fileio->file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
 	file_size = 0;
 
 	if ((fileio->access != FILEIO_WRITE) || (fileio->access == FILEIO_READWRITE)) {
@@ -97,12 +244,22 @@ static inline int fileio_open_local(struct fileio *fileio)
 
 		if ((file_size < 0) || (result < 0) || (result2 < 0)) {
 			fileio_close_local(fileio);
+			free(fileio->buffer);
 			return ERROR_FILEIO_OPERATION_FAILED;
 		}
 	}
 
 	fileio->size = file_size;
 
+	if (fileio->access == FILEIO_READ) {
+		int retval = fileio_open_compressed(fileio);
+		if (retval != ERROR_OK) {
+			fileio_close_local(fileio);
+			free(fileio->buffer);
+			return retval;
+		}
+	}
+
 	return ERROR_OK;
 }
 
@@ -117,6 +274,11 @@ int fileio_open(struct fileio **fileio, const char *url,
 	tmp->type = type;
 	tmp->access = access_type;
 	tmp->url = strdup(url);
+	tmp->buffer = NULL;
+	tmp->map = NULL;
+#ifdef HAVE_ZLIB
+	tmp->gz = NULL;
+#endif
 
 	retval = fileio_open_local(tmp);
 
@@ -135,8 +297,14 @@ int fileio_close(struct fileio *fileio)
 {
 	int retval;
 
+#ifdef HAVE_SYS_MMAN_H
+	if (fileio->map)
+		munmap(fileio->map, fileio->size);
+#endif
+
 	retval = fileio_close_local(fileio);
 
+	free(fileio->buffer);
 	free(fileio->url);
 	free(fileio);
 
@@ -145,6 +313,11 @@ int fileio_close(struct fileio *fileio)
 
 int fileio_feof(struct fileio *fileio)
 {
+#ifdef HAVE_ZLIB
+	if (fileio->gz)
+		return gzeof(fileio->gz);
+#endif
+
 	return feof(fileio->file);
 }
 
@@ -152,6 +325,14 @@ int fileio_seek(struct fileio *fileio, size_t position)
 {
 	int retval;
 
+#ifdef HAVE_ZLIB
+	if (fileio->gz) {
+		if (gzseek(fileio->gz, position, SEEK_SET) < 0)
+			return fileio_gz_error(fileio);
+		return ERROR_OK;
+	}
+#endif
+
 	retval = fseek(fileio->file, position, SEEK_SET);
 
 	if (retval != 0) {
@@ -167,6 +348,24 @@ static int fileio_local_read(struct fileio *fileio, size_t size, void *buffer,
 {
 	ssize_t retval;
 
+#ifdef HAVE_ZLIB
+	if (fileio->gz) {
+		*size_read = 0;
+		while (size) {
+			/* gzread() takes an unsigned int */
+			int n = gzread(fileio->gz, buffer, MIN(size, 1u << 30));
+			if (n < 0)
+				return fileio_gz_error(fileio);
+			if (n == 0)
+				break;
+			buffer = (uint8_t *)buffer + n;
+			size -= n;
+			*size_read += n;
+		}
+		return ERROR_OK;
+	}
+#endif
+
 	retval = fread(buffer, 1, size, fileio->file);
 	*size_read = (retval >= 0) ? retval : 0;
 
@@ -197,6 +396,14 @@ int fileio_read_u32(struct fileio *fileio, uint32_t *data)
 
 static int fileio_local_fgets(struct fileio *fileio, size_t size, void *buffer)
 {
+#ifdef HAVE_ZLIB
+	if (fileio->gz) {
+		if (!gzgets(fileio->gz, buffer, size))
+			return ERROR_FILEIO_OPERATION_FAILED;
+		return ERROR_OK;
+	}
+#endif
+
 	if (!fgets(buffer, size, fileio->file))
 		return ERROR_FILEIO_OPERATION_FAILED;
 
@@ -248,17 +455,85 @@ int fileio_write_u32(struct fileio *fileio, uint32_t data)
 }
 
 /**
- * FIX!!!!
- *
- * For now this can not fail, but that's because a seek was executed
- * on startup.
- *
- * Avoiding the seek on startup opens up for using streams.
- *
+ * The size of a plain file is found by a seek on startup. That of a
+ * compressed one takes a pass through the stream, only done if asked, and
+ * can fail.
  */
 int fileio_size(struct fileio *fileio, size_t *size)
 {
+#ifdef HAVE_ZLIB
+	if (fileio->gz && !fileio->size_known) {
+		int retval = fileio_gz_size(fileio);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+#endif
+
 	*size = fileio->size;
 
 	return ERROR_OK;
 }
+
+int fileio_map(struct fileio *fileio, const uint8_t **data)
+{
+#ifdef HAVE_SYS_MMAN_H
+	if (!fileio->map) {
+		if (fileio->access != FILEIO_READ || fileio->size == 0)
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#ifdef HAVE_ZLIB
+		if (fileio->gz)
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+
+		void *map = mmap(NULL, fileio->size, PROT_READ, MAP_PRIVATE,
+				fileno(fileio->file), 0);
+		if (map == MAP_FAILED) {
+			LOG_DEBUG("couldn't map %s: %s", fileio->url, strerror(errno));
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+		}
+		fileio->map = map;
+#ifdef MADV_SEQUENTIAL
+		madvise(map, fileio->size, MADV_SEQUENTIAL);
+#endif
+	}
+
+	*data = fileio->map;
+
+	return ERROR_OK;
+#else
+	return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+}
+
+COMMAND_HANDLER(handle_fileio_buffer_size_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		uint32_t size;
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], size);
+		fileio_buffer_size = size;
+	}
+
+	command_print(CMD, "%zu", fileio_buffer_size);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration fileio_command_handlers[] = {
+	{
+		.name = "fileio_buffer_size",
+		.handler = handle_fileio_buffer_size_command,
+		.mode = COMMAND_ANY,
+		.help = "set the size of the buffer of the files opened from "
+			"then on, 0 for the default of the host",
+		.usage = "[size]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int fileio_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, fileio_command_handlers);
+}
@@ -18,6 +18,9 @@
 
 #define FILEIO_MAX_ERROR_STRING		(128)
 
+/* the default size of the buffer of the files, see 'fileio_buffer_size' */
+#define FILEIO_BUFFER_SIZE			(256 * 1024)
+
 enum fileio_type {
 	FILEIO_TEXT,
 	FILEIO_BINARY,
@@ -32,6 +35,7 @@ enum fileio_access {
 	FILEIO_APPENDREAD,	/* open for writing, position at end, allow reading */
 };
 
+struct command_context;
 struct fileio;
 
 int fileio_open(struct fileio **fileio, const char *url,
@@ -51,6 +55,15 @@ int fileio_read_u32(struct fileio *fileio, uint32_t *data);
 int fileio_write_u32(struct fileio *fileio, uint32_t data);
 int fileio_size(struct fileio *fileio, size_t *size);
 
+/*
+ * Map a file opened for reading in memory, the whole fileio_size() bytes.
+ * The mapping lasts until fileio_close(). Fails with
+ * ERROR_FILEIO_OPERATION_NOT_SUPPORTED where the host or the file can't.
+ */
+int fileio_map(struct fileio *fileio, const uint8_t **data);
+
+int fileio_register_commands(struct command_context *cmd_ctx);
+
 #define ERROR_FILEIO_LOCATION_UNKNOWN			(-1200)
 #define ERROR_FILEIO_NOT_FOUND					(-1201)
 #define ERROR_FILEIO_OPERATION_FAILED			(-1202)
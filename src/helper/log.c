@@ -16,6 +16,7 @@
 #endif
 
 #include "log.h"
+#include "bits.h"
 #include "command.h"
 #include "replacements.h"
 #include "time_support.h"
@@ -32,10 +33,37 @@
 #endif
 
 int debug_level = LOG_LVL_INFO;
+int log_category_level[LOG_CAT_NUM];
+
+static const char * const log_category_names[LOG_CAT_NUM] = {
+	[LOG_CAT_DEFAULT] = "default",
+	[LOG_CAT_JTAG] = "jtag",
+	[LOG_CAT_DAP] = "dap",
+	[LOG_CAT_RISCV] = "riscv",
+	[LOG_CAT_FLASH] = "flash",
+	[LOG_CAT_GDB] = "gdb",
+	[LOG_CAT_RTOS] = "rtos",
+};
+
+/* Categories with their own level, bit n for category n */
+static uint32_t log_category_mask;
+static int log_category_own_level[LOG_CAT_NUM];
+/* Most verbose level of debug_level and all categories */
+static int log_max_level = LOG_LVL_INFO;
 
 static FILE *log_output;
 static struct log_callback *log_callbacks;
 
+/*
+ * Debug output to a log file goes through a large stdio buffer, which is
+ * written out in batches: when it is full, with the next message of level
+ * info or more severe, when OpenOCD gets idle, in keep_alive() and at exit.
+ * Writing every debug line on its own slowed down flash programming several
+ * times. Debug messages are then also formatted straight into the buffer.
+ */
+#define LOG_BUFFER_SIZE		(64 * 1024)
+static bool log_batched;
+
 static int64_t last_time;
 
 static int64_t start;
@@ -51,15 +79,76 @@ static const char * const log_strings[6] = {
 
 static int count;
 
+static void log_update_levels(void)
+{
+	log_max_level = debug_level;
+	for (unsigned int i = 0; i < LOG_CAT_NUM; i++) {
+		if (log_category_mask & BIT(i))
+			log_category_level[i] = log_category_own_level[i];
+		else
+			log_category_level[i] = debug_level;
+		log_max_level = MAX(log_max_level, log_category_level[i]);
+	}
+}
+
+static bool log_level_enabled(enum log_levels level)
+{
+	/* LOG_DEBUG() and friends already tested the level of their category */
+	if (level >= LOG_LVL_DEBUG)
+		return level <= log_max_level;
+
+	return level <= debug_level;
+}
+
+static void log_print_header(enum log_levels level, const char *file, int line,
+		const char *function)
+{
+	const char *f = strrchr(file, '/');
+	if (f)
+		file = f + 1;
+
+	/* print with count and time information */
+	int64_t t = timeval_ms() - start;
+#ifdef _DEBUG_FREE_SPACE_
+	struct mallinfo info;
+	info = mallinfo();
+#endif
+	fprintf(log_output, "%s%d %" PRId64 " %s:%d %s()"
+#ifdef _DEBUG_FREE_SPACE_
+		" %d"
+#endif
+		": ", log_strings[level + 1], count, t, file, line, function
+#ifdef _DEBUG_FREE_SPACE_
+		, info.fordblks
+#endif
+		);
+}
+
+/* Debug messages are not forwarded, they are formatted right into the log */
+static bool log_direct(enum log_levels level)
+{
+	return log_batched && level >= LOG_LVL_DEBUG;
+}
+
+static void log_vprintf_direct(enum log_levels level, const char *file, int line,
+		const char *function, const char *format, va_list args, bool lf)
+{
+	log_print_header(level, file, line, function);
+	vfprintf(log_output, format, args);
+	if (lf)
+		fputc('\n', log_output);
+}
+
 /* forward the log to the listeners */
-static void log_forward(const char *file, unsigned line, const char *function, const char *string)
+static void log_forward(enum log_levels level, const char *file, unsigned int line,
+		const char *function, const char *string)
 {
 	struct log_callback *cb, *next;
 	cb = log_callbacks;
 	/* DANGER!!!! the log callback can remove itself!!!! */
 	while (cb) {
 		next = cb->next;
-		cb->fn(cb->priv, file, line, function, string);
+		cb->fn(cb->priv, level, file, line, function, string);
 		cb = next;
 	}
 }
@@ -96,26 +185,9 @@ static void log_puts(enum log_levels level,
 		return;
 	}
 
-	f = strrchr(file, '/');
-	if (f)
-		file = f + 1;
-
-	if (debug_level >= LOG_LVL_DEBUG) {
-		/* print with count and time information */
-		int64_t t = timeval_ms() - start;
-#ifdef _DEBUG_FREE_SPACE_
-		struct mallinfo info;
-		info = mallinfo();
-#endif
-		fprintf(log_output, "%s%d %" PRId64 " %s:%d %s()"
-#ifdef _DEBUG_FREE_SPACE_
-			" %d"
-#endif
-			": %s", log_strings[level + 1], count, t, file, line, function,
-#ifdef _DEBUG_FREE_SPACE_
-			info.fordblks,
-#endif
-			string);
+	if (log_max_level >= LOG_LVL_DEBUG) {
+		log_print_header(level, file, line, function);
+		fputs(string, log_output);
 	} else {
 		/* if we are using gdb through pipes then we do not want any output
 		 * to the pipe otherwise we get repeated strings */
@@ -123,11 +195,17 @@ static void log_puts(enum log_levels level,
 			(level > LOG_LVL_USER) ? log_strings[level + 1] : "", string);
 	}
 
-	fflush(log_output);
+	if (!log_batched || level <= LOG_LVL_INFO)
+		fflush(log_output);
 
 	/* Never forward LOG_LVL_DEBUG, too verbose and they can be found in the log if need be */
-	if (level <= LOG_LVL_INFO)
-		log_forward(file, line, function, string);
+	if (level <= LOG_LVL_INFO) {
+		f = strrchr(file, '/');
+		if (f)
+			file = f + 1;
+
+		log_forward(level, file, line, function, string);
+	}
 }
 
 void log_printf(enum log_levels level,
@@ -141,11 +219,17 @@ void log_printf(enum log_levels level,
 	va_list ap;
 
 	count++;
-	if (level > debug_level)
+	if (!log_level_enabled(level))
 		return;
 
 	va_start(ap, format);
 
+	if (log_direct(level)) {
+		log_vprintf_direct(level, file, line, function, format, ap, false);
+		va_end(ap);
+		return;
+	}
+
 	string = alloc_vprintf(format, ap);
 	if (string) {
 		log_puts(level, file, line, function, string);
@@ -155,16 +239,21 @@ void log_printf(enum log_levels level,
 	va_end(ap);
 }
 
-void log_vprintf_lf(enum log_levels level, const char *file, unsigned line,
+void log_vprintf_lf(enum log_levels level, const char *file, unsigned int line,
 		const char *function, const char *format, va_list args)
 {
 	char *tmp;
 
 	count++;
 
-	if (level > debug_level)
+	if (!log_level_enabled(level))
 		return;
 
+	if (log_direct(level)) {
+		log_vprintf_direct(level, file, line, function, format, args, true);
+		return;
+	}
+
 	tmp = alloc_vprintf(format, args);
 
 	if (!tmp)
@@ -193,16 +282,28 @@ void log_printf_lf(enum log_levels level,
 	va_end(ap);
 }
 
+static int log_parse_level(struct command_invocation *cmd, const char *str, int *level)
+{
+	COMMAND_PARSE_NUMBER(int, str, *level);
+	if (*level > LOG_LVL_DEBUG_IO || *level < LOG_LVL_SILENT) {
+		LOG_ERROR("level must be between %d and %d", LOG_LVL_SILENT, LOG_LVL_DEBUG_IO);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+	if (*level > LOG_LVL_BUILD)
+		LOG_WARNING("debug messages are not built in, see configure --disable-debug-log");
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_debug_level_command)
 {
 	if (CMD_ARGC == 1) {
 		int new_level;
-		COMMAND_PARSE_NUMBER(int, CMD_ARGV[0], new_level);
-		if ((new_level > LOG_LVL_DEBUG_IO) || (new_level < LOG_LVL_SILENT)) {
-			LOG_ERROR("level must be between %d and %d", LOG_LVL_SILENT, LOG_LVL_DEBUG_IO);
-			return ERROR_COMMAND_SYNTAX_ERROR;
-		}
+		int retval = log_parse_level(CMD, CMD_ARGV[0], &new_level);
+		if (retval != ERROR_OK)
+			return retval;
 		debug_level = new_level;
+		log_update_levels();
 	} else if (CMD_ARGC > 1)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
@@ -211,6 +312,53 @@ COMMAND_HANDLER(handle_debug_level_command)
 	return ERROR_OK;
 }
 
+static void log_print_category(struct command_invocation *cmd, unsigned int category)
+{
+	command_print(cmd, "%s: %i%s", log_category_names[category],
+			log_category_level[category],
+			(log_category_mask & BIT(category)) ? "" : " (debug_level)");
+}
+
+COMMAND_HANDLER(handle_log_category_command)
+{
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 0) {
+		for (unsigned int i = 0; i < LOG_CAT_NUM; i++)
+			log_print_category(CMD, i);
+		return ERROR_OK;
+	}
+
+	unsigned int category;
+	for (category = 0; category < LOG_CAT_NUM; category++) {
+		if (!strcmp(CMD_ARGV[0], log_category_names[category]))
+			break;
+	}
+	if (category == LOG_CAT_NUM) {
+		command_print(CMD, "unknown log category '%s'", CMD_ARGV[0]);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (CMD_ARGC == 2) {
+		if (!strcmp(CMD_ARGV[1], "default")) {
+			log_category_mask &= ~BIT(category);
+		} else {
+			int level;
+			int retval = log_parse_level(CMD, CMD_ARGV[1], &level);
+			if (retval != ERROR_OK)
+				return retval;
+			log_category_own_level[category] = level;
+			log_category_mask |= BIT(category);
+		}
+		log_update_levels();
+	}
+
+	log_print_category(CMD, category);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_log_output_command)
 {
 	if (CMD_ARGC == 0 || (CMD_ARGC == 1 && strcmp(CMD_ARGV[0], "default") == 0)) {
@@ -219,6 +367,7 @@ COMMAND_HANDLER(handle_log_output_command)
 			fclose(log_output);
 		}
 		log_output = stderr;
+		log_batched = false;
 		LOG_DEBUG("set log_output to default");
 		return ERROR_OK;
 	}
@@ -233,6 +382,7 @@ COMMAND_HANDLER(handle_log_output_command)
 			fclose(log_output);
 		}
 		log_output = file;
+		log_batched = !setvbuf(file, NULL, _IOFBF, LOG_BUFFER_SIZE);
 		LOG_DEBUG("set log_output to \"%s\"", CMD_ARGV[0]);
 		return ERROR_OK;
 	}
@@ -258,6 +408,15 @@ static const struct command_registration log_command_handlers[] = {
 			"4 adds extra verbose debugging.",
 		.usage = "number",
 	},
+	{
+		.name = "log_category",
+		.handler = handle_log_category_command,
+		.mode = COMMAND_ANY,
+		.help = "Sets the level of debugging output of a subsystem, "
+			"or makes it follow debug_level again. "
+			"Without arguments, lists the level of all subsystems.",
+		.usage = "[category [number|'default']]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -279,6 +438,7 @@ void log_init(void)
 				debug_level <= LOG_LVL_DEBUG_IO)
 				debug_level = value;
 	}
+	log_update_levels();
 
 	if (!log_output)
 		log_output = stderr;
@@ -293,6 +453,13 @@ void log_exit(void)
 		fclose(log_output);
 	}
 	log_output = NULL;
+	log_batched = false;
+}
+
+void log_flush(void)
+{
+	if (log_batched)
+		fflush(log_output);
 }
 
 /* add/remove log callback handler */
@@ -430,6 +597,8 @@ void keep_alive(void)
 	if (delta_time > KEEP_ALIVE_KICK_TIME_MS) {
 		last_time = current_time;
 
+		log_flush();
+
 		/* this will keep the GDB connection alive */
 		server_keep_clients_alive();
 
@@ -48,12 +48,12 @@ enum log_levels {
 	LOG_LVL_DEBUG_IO = 4,
 };
 
-void log_printf(enum log_levels level, const char *file, unsigned line,
+void log_printf(enum log_levels level, const char *file, unsigned int line,
 		const char *function, const char *format, ...)
 __attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 5, 6)));
-void log_vprintf_lf(enum log_levels level, const char *file, unsigned line,
+void log_vprintf_lf(enum log_levels level, const char *file, unsigned int line,
 		const char *function, const char *format, va_list args);
-void log_printf_lf(enum log_levels level, const char *file, unsigned line,
+void log_printf_lf(enum log_levels level, const char *file, unsigned int line,
 		const char *function, const char *format, ...)
 __attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 5, 6)));
 
@@ -63,6 +63,12 @@ __attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 5, 6)));
 void log_init(void);
 void log_exit(void);
 
+/**
+ * Write out the debug messages buffered for a log file. Messages of level
+ * info and more severe are always written right away.
+ */
+void log_flush(void);
+
 int log_register_commands(struct command_context *cmd_ctx);
 
 void keep_alive(void);
@@ -73,8 +79,8 @@ void busy_sleep(uint64_t ms);
 
 void log_socket_error(const char *socket_desc);
 
-typedef void (*log_callback_fn)(void *priv, const char *file, unsigned line,
-		const char *function, const char *string);
+typedef void (*log_callback_fn)(void *priv, enum log_levels level, const char *file,
+		unsigned int line, const char *function, const char *string);
 
 struct log_callback {
 	log_callback_fn fn;
@@ -93,14 +99,47 @@ char *find_nonprint_char(char *buf, unsigned buf_len);
 
 extern int debug_level;
 
+/*
+ * Log categories, each with its own level for debug messages. The category
+ * of a source file is set with LOG_CATEGORY, per library in Makefile.am or
+ * by a define ahead of the first #include of the file. Messages of level
+ * info and more severe are always filtered by debug_level alone.
+ */
+enum log_category {
+	LOG_CAT_DEFAULT,
+	LOG_CAT_JTAG,
+	LOG_CAT_DAP,
+	LOG_CAT_RISCV,
+	LOG_CAT_FLASH,
+	LOG_CAT_GDB,
+	LOG_CAT_RTOS,
+	LOG_CAT_NUM
+};
+
+#ifndef LOG_CATEGORY
+#define LOG_CATEGORY LOG_CAT_DEFAULT
+#endif
+
+/* Most verbose level built in; configure --disable-debug-log drops debug messages */
+#ifdef _NO_DEBUG_LOG_
+#define LOG_LVL_BUILD LOG_LVL_INFO
+#else
+#define LOG_LVL_BUILD LOG_LVL_DEBUG_IO
+#endif
+
+/* Level of each category: its own one if selected by log_category, else debug_level */
+extern int log_category_level[LOG_CAT_NUM];
+
 /* Avoid fn call and building parameter list if we're not outputting the information.
- * Matters on feeble CPUs for DEBUG/INFO statements that are involved frequently */
+ * Matters on feeble CPUs for DEBUG/INFO statements that are involved frequently.
+ * With the level constant, the test folds to false for the levels not built in. */
 
-#define LOG_LEVEL_IS(FOO)  ((debug_level) >= (FOO))
+#define LOG_LEVEL_IS(FOO) \
+	((FOO) <= LOG_LVL_BUILD && log_category_level[LOG_CATEGORY] >= (FOO))
 
 #define LOG_DEBUG_IO(expr ...) \
 	do { \
-		if (debug_level >= LOG_LVL_DEBUG_IO) \
+		if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) \
 			log_printf_lf(LOG_LVL_DEBUG, \
 				__FILE__, __LINE__, __func__, \
 				expr); \
@@ -108,7 +147,7 @@ extern int debug_level;
 
 #define LOG_DEBUG(expr ...) \
 	do { \
-		if (debug_level >= LOG_LVL_DEBUG) \
+		if (LOG_LEVEL_IS(LOG_LVL_DEBUG)) \
 			log_printf_lf(LOG_LVL_DEBUG, \
 				__FILE__, __LINE__, __func__, \
 				expr); \
@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Registry of the counters, gauges and histograms of the subsystems.
+ *
+ * The metrics are kept in a list, those with the same name and different
+ * labels next to each other as the Prometheus text format wants them.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "metrics.h"
+#include "log.h"
+#include "replacements.h"
+
+static struct metric *metrics;
+
+void metric_register(struct metric *metric)
+{
+	struct metric **p = &metrics;
+	struct metric **after = NULL;
+
+	if (metric->registered)
+		return;
+
+	for (; *p; p = &(*p)->next)
+		if (!strcmp((*p)->name, metric->name))
+			after = &(*p)->next;
+
+	if (!after)
+		after = p;
+
+	metric->next = *after;
+	*after = metric;
+	metric->registered = true;
+}
+
+void metric_unregister(struct metric *metric)
+{
+	for (struct metric **p = &metrics; *p; p = &(*p)->next) {
+		if (*p == metric) {
+			*p = metric->next;
+			break;
+		}
+	}
+
+	metric->registered = false;
+	metric->next = NULL;
+	free(metric->labels);
+	metric->labels = NULL;
+}
+
+void metric_set_labels(struct metric *metric, const char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	free(metric->labels);
+	metric->labels = alloc_vprintf(format, ap);
+	va_end(ap);
+}
+
+void metric_histogram_add(struct metric *metric, uint64_t value)
+{
+	unsigned int bucket = 0;
+
+	if (!metric->registered)
+		metric_register(metric);
+
+	/* the smallest n with value <= 2^n */
+	if (value > 1)
+		bucket = 64 - __builtin_clzll(value - 1);
+
+	metric->buckets[MIN(bucket, METRIC_HISTOGRAM_BUCKETS - 1)]++;
+	metric->count++;
+	metric->sum += value;
+}
+
+struct metric *metric_find(const char *name)
+{
+	for (struct metric *m = metrics; m; m = m->next)
+		if (!strcmp(m->name, name))
+			return m;
+
+	return NULL;
+}
+
+static uint64_t metric_bucket_limit(unsigned int bucket)
+{
+	return (uint64_t)1 << bucket;
+}
+
+struct metrics_text {
+	char *buf;
+	size_t len;
+	size_t size;
+	bool error;
+};
+
+static void metrics_printf(struct metrics_text *text, const char *format, ...)
+	__attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 2, 3)));
+
+static void metrics_printf(struct metrics_text *text, const char *format, ...)
+{
+	va_list ap;
+
+	if (text->error)
+		return;
+
+	for (;;) {
+		size_t room = text->size - text->len;
+
+		va_start(ap, format);
+		int n = vsnprintf(text->buf ? text->buf + text->len : NULL, room, format, ap);
+		va_end(ap);
+
+		if (n < 0) {
+			text->error = true;
+			return;
+		}
+		if ((size_t)n < room) {
+			text->len += n;
+			return;
+		}
+
+		size_t size = MAX(2 * text->size, text->len + n + 1024);
+		char *buf = realloc(text->buf, size);
+		if (!buf) {
+			text->error = true;
+			return;
+		}
+		text->buf = buf;
+		text->size = size;
+	}
+}
+
+char *metrics_prometheus_text(void)
+{
+	struct metrics_text text = { 0 };
+	const char *name = NULL;
+
+	for (struct metric *m = metrics; m; m = m->next) {
+		static const char * const types[] = {
+			[METRIC_COUNTER] = "counter",
+			[METRIC_GAUGE] = "gauge",
+			[METRIC_HISTOGRAM] = "histogram",
+		};
+
+		/* the same metric with other labels */
+		if (!name || strcmp(name, m->name)) {
+			name = m->name;
+			metrics_printf(&text, "# HELP openocd_%s %s\n", m->name, m->help);
+			metrics_printf(&text, "# TYPE openocd_%s %s\n", m->name, types[m->type]);
+		}
+
+		const char *labels = m->labels ? m->labels : "";
+		const char *open = m->labels ? "{" : "";
+		const char *close = m->labels ? "}" : "";
+
+		switch (m->type) {
+		case METRIC_COUNTER:
+			metrics_printf(&text, "openocd_%s%s%s%s %" PRIu64 "\n",
+					m->name, open, labels, close, m->count);
+			break;
+		case METRIC_GAUGE:
+			metrics_printf(&text, "openocd_%s%s%s%s %" PRId64 "\n",
+					m->name, open, labels, close, m->gauge);
+			break;
+		case METRIC_HISTOGRAM: {
+			const char *sep = m->labels ? "," : "";
+			uint64_t total = 0;
+			for (unsigned int i = 0; i < METRIC_HISTOGRAM_BUCKETS - 1; i++) {
+				total += m->buckets[i];
+				metrics_printf(&text, "openocd_%s_bucket{%s%sle=\"%" PRIu64 "\"} %" PRIu64 "\n",
+						m->name, labels, sep, metric_bucket_limit(i), total);
+			}
+			metrics_printf(&text, "openocd_%s_bucket{%s%sle=\"+Inf\"} %" PRIu64 "\n",
+					m->name, labels, sep, m->count);
+			metrics_printf(&text, "openocd_%s_sum%s%s%s %" PRIu64 "\n",
+					m->name, open, labels, close, m->sum);
+			metrics_printf(&text, "openocd_%s_count%s%s%s %" PRIu64 "\n",
+					m->name, open, labels, close, m->count);
+			break;
+		}
+		}
+	}
+
+	if (text.error) {
+		LOG_ERROR("Out of memory");
+		free(text.buf);
+		return NULL;
+	}
+
+	/* no metric yet */
+	if (!text.buf)
+		return strdup("");
+
+	return text.buf;
+}
+
+COMMAND_HANDLER(handle_metrics_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	for (struct metric *m = metrics; m; m = m->next) {
+		if (CMD_ARGC == 1 && !strstr(m->name, CMD_ARGV[0]))
+			continue;
+
+		/* a dict, the labels are part of the key */
+		if (m->labels)
+			command_print_sameline(CMD, "{%s{%s}} ", m->name, m->labels);
+		else
+			command_print_sameline(CMD, "%s ", m->name);
+
+		switch (m->type) {
+		case METRIC_COUNTER:
+			command_print(CMD, "%" PRIu64, m->count);
+			break;
+		case METRIC_GAUGE:
+			command_print(CMD, "%" PRId64, m->gauge);
+			break;
+		case METRIC_HISTOGRAM: {
+			uint64_t total = 0;
+			command_print_sameline(CMD, "{count %" PRIu64 " sum %" PRIu64 " buckets {",
+					m->count, m->sum);
+			for (unsigned int i = 0; i < METRIC_HISTOGRAM_BUCKETS - 1; i++) {
+				total += m->buckets[i];
+				command_print_sameline(CMD, "%" PRIu64 " %" PRIu64 " ",
+						metric_bucket_limit(i), total);
+			}
+			command_print(CMD, "+Inf %" PRIu64 "}}", m->count);
+			break;
+		}
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static const struct command_registration metrics_command_handlers[] = {
+	{
+		.name = "metrics",
+		.handler = handle_metrics_command,
+		.mode = COMMAND_ANY,
+		.help = "display the counters, gauges and histograms of the "
+			"subsystems as a dict, optionally only those whose name "
+			"contains the string",
+		.usage = "[string]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int metrics_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, metrics_command_handlers);
+}
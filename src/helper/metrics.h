@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_HELPER_METRICS_H
+#define OPENOCD_HELPER_METRICS_H
+
+#include <helper/command.h>
+#include <helper/types.h>
+
+/*
+ * Counters, gauges and histograms of the subsystems, read with the
+ * 'metrics' command or in the Prometheus text format from the port set with
+ * 'metrics_port'.
+ *
+ * A metric is usually a static struct metric of the subsystem, set up with
+ * METRIC_COUNTER() and friends. It joins the registry the first time it is
+ * updated, so updating it costs only a few instructions. Metrics with labels,
+ * e.g. one per target, must be removed with metric_unregister() before their
+ * memory goes away.
+ */
+
+enum metric_type {
+	METRIC_COUNTER,
+	METRIC_GAUGE,
+	METRIC_HISTOGRAM,
+};
+
+/* bucket n counts the values up to 2^n, the last one the larger values */
+#define METRIC_HISTOGRAM_BUCKETS	25
+
+struct metric {
+	/* without the "openocd_" prefix of the Prometheus output */
+	const char *name;
+	const char *help;
+	enum metric_type type;
+	/* Prometheus labels, e.g. target="stm32.cpu", owned by the metric */
+	char *labels;
+	/* counter value, number of values of a histogram */
+	uint64_t count;
+	/* sum of the values of a histogram */
+	uint64_t sum;
+	int64_t gauge;
+	uint64_t buckets[METRIC_HISTOGRAM_BUCKETS];
+	bool registered;
+	struct metric *next;
+};
+
+#define METRIC_COUNTER(n, h)	{ .name = n, .help = h, .type = METRIC_COUNTER }
+#define METRIC_GAUGE(n, h)	{ .name = n, .help = h, .type = METRIC_GAUGE }
+#define METRIC_HISTOGRAM(n, h)	{ .name = n, .help = h, .type = METRIC_HISTOGRAM }
+
+void metric_register(struct metric *metric);
+
+/* Remove a metric from the registry and free its labels */
+void metric_unregister(struct metric *metric);
+
+/* Set the labels of a metric, with the syntax of the Prometheus labels */
+void metric_set_labels(struct metric *metric, const char *format, ...)
+	__attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 2, 3)));
+
+void metric_histogram_add(struct metric *metric, uint64_t value);
+
+/* @returns the first registered metric called @a name, NULL if none */
+struct metric *metric_find(const char *name);
+
+static inline void metric_add(struct metric *metric, uint64_t value)
+{
+	if (!metric->registered)
+		metric_register(metric);
+	metric->count += value;
+}
+
+static inline void metric_set(struct metric *metric, int64_t value)
+{
+	if (!metric->registered)
+		metric_register(metric);
+	metric->gauge = value;
+}
+
+static inline void metric_gauge_add(struct metric *metric, int64_t value)
+{
+	if (!metric->registered)
+		metric_register(metric);
+	metric->gauge += value;
+}
+
+/* @returns the metrics in the Prometheus text format, free() it */
+char *metrics_prometheus_text(void);
+
+int metrics_register_commands(struct command_context *cmd_ctx);
+
+#endif /* OPENOCD_HELPER_METRICS_H */
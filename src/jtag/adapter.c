@@ -16,7 +16,11 @@
 #include "minidriver.h"
 #include "interface.h"
 #include "interfaces.h"
+#include "adapter_record.h"
+#include "swd.h"
 #include <transport/transport.h>
+#include <target/target.h>
+#include <helper/time_support.h>
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -52,6 +56,10 @@ static struct {
 	bool gpios_initialized; /* Initialization of GPIOs to their unset values performed at run time */
 } adapter_config;
 
+static struct adapter_flush_stats adapter_flush_stats[ADAPTER_STATS_NUM];
+static unsigned int adapter_stats_op_nesting;
+static unsigned int adapter_stats_op_flushes[ADAPTER_STATS_NUM];
+
 static const struct gpio_map {
 	const char *name;
 	enum adapter_gpio_direction direction;
@@ -154,6 +162,10 @@ int adapter_init(struct command_context *cmd_ctx)
 		return retval;
 	adapter_config.adapter_initialized = true;
 
+	retval = adapter_record_start();
+	if (retval != ERROR_OK)
+		return retval;
+
 	if (!adapter_driver->speed) {
 		LOG_INFO("Note: The adapter \"%s\" doesn't support configurable speed", adapter_driver->name);
 		return ERROR_OK;
@@ -194,6 +206,11 @@ int adapter_quit(void)
 			LOG_ERROR("failed: %d", result);
 	}
 
+	adapter_record_stop();
+
+	jtag_command_queue_release_pages();
+	jtag_set_chain_cache(NULL);
+
 	free(adapter_config.serial);
 	free(adapter_config.usb_location);
 
@@ -378,6 +395,110 @@ done:
 	return equal;
 }
 
+static unsigned int adapter_stats_bucket(uint64_t value)
+{
+	unsigned int bucket = 0;
+
+	while (value && bucket < ADAPTER_STATS_BUCKETS - 1) {
+		value >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+void adapter_stats_flush(enum adapter_stats_queue queue, int64_t start_us,
+		unsigned int commands, uint64_t bits, int retval)
+{
+	struct adapter_flush_stats *stats = &adapter_flush_stats[queue];
+	int64_t elapsed = timeval_us() - start_us;
+
+	if (elapsed < 0)
+		elapsed = 0;
+
+	stats->flushes++;
+	if (retval != ERROR_OK)
+		stats->failures++;
+	stats->commands += commands;
+	stats->bits += bits;
+	stats->total_us += elapsed;
+	if ((uint64_t)elapsed > stats->max_us)
+		stats->max_us = elapsed;
+	stats->latency_us[adapter_stats_bucket(elapsed)]++;
+	stats->depth[adapter_stats_bucket(commands)]++;
+	stats->bits_shifted[adapter_stats_bucket(bits)]++;
+
+	if (adapter_stats_op_nesting)
+		adapter_stats_op_flushes[queue]++;
+}
+
+void adapter_stats_begin_op(void)
+{
+	adapter_stats_op_nesting++;
+}
+
+void adapter_stats_end_op(void)
+{
+	assert(adapter_stats_op_nesting > 0);
+	if (--adapter_stats_op_nesting)
+		return;
+
+	/* operations without any flush are not interesting here */
+	for (unsigned int i = 0; i < ADAPTER_STATS_NUM; i++) {
+		unsigned int flushes = adapter_stats_op_flushes[i];
+		if (!flushes)
+			continue;
+		adapter_flush_stats[i].ops++;
+		adapter_flush_stats[i].flushes_per_op[adapter_stats_bucket(flushes)]++;
+		adapter_stats_op_flushes[i] = 0;
+	}
+}
+
+void adapter_stats_reset(enum adapter_stats_queue queue)
+{
+	memset(&adapter_flush_stats[queue], 0, sizeof(adapter_flush_stats[queue]));
+	adapter_stats_op_flushes[queue] = 0;
+}
+
+static void adapter_stats_print_histogram(struct command_invocation *cmd, const char *name,
+		const uint64_t *histogram)
+{
+	command_print(CMD, "%s:", name);
+	for (unsigned int i = 0; i < ADAPTER_STATS_BUCKETS; i++) {
+		if (!histogram[i])
+			continue;
+		if (i < 2)
+			command_print(CMD, "  %10u            %10" PRIu64, i, histogram[i]);
+		else if (i == ADAPTER_STATS_BUCKETS - 1)
+			command_print(CMD, "  %10" PRIu64 " and above  %10" PRIu64,
+				(uint64_t)1 << (i - 1), histogram[i]);
+		else
+			command_print(CMD, "  %10" PRIu64 " - %-8" PRIu64 "%10" PRIu64,
+				(uint64_t)1 << (i - 1), ((uint64_t)1 << i) - 1, histogram[i]);
+	}
+}
+
+void adapter_stats_print(struct command_invocation *cmd, enum adapter_stats_queue queue)
+{
+	const struct adapter_flush_stats *stats = &adapter_flush_stats[queue];
+
+	command_print(CMD, "flushes: %" PRIu64 " (%" PRIu64 " failed), operations: %" PRIu64,
+		stats->flushes, stats->failures, stats->ops);
+	if (!stats->flushes)
+		return;
+
+	command_print(CMD, "time: %" PRIu64 " us total, %" PRIu64 " us average, %" PRIu64 " us max",
+		stats->total_us, stats->total_us / stats->flushes, stats->max_us);
+	command_print(CMD, "average per flush: %" PRIu64 " commands, %" PRIu64 " bits",
+		stats->commands / stats->flushes, stats->bits / stats->flushes);
+
+	adapter_stats_print_histogram(cmd, "latency (us)", stats->latency_us);
+	adapter_stats_print_histogram(cmd, "queue depth (commands)", stats->depth);
+	adapter_stats_print_histogram(cmd, "bits shifted", stats->bits_shifted);
+	if (stats->ops)
+		adapter_stats_print_histogram(cmd, "flushes per operation", stats->flushes_per_op);
+}
+
 COMMAND_HANDLER(handle_adapter_name)
 {
 	/* return the name of the interface */
@@ -392,6 +513,235 @@ COMMAND_HANDLER(handle_adapter_name)
 	return ERROR_OK;
 }
 
+#define ADAPTER_BENCHMARK_DEFAULT_COUNT	100
+#define ADAPTER_BENCHMARK_DEFAULT_SIZE	4096
+/* the raw scans into BYPASS shift this many bytes, this many times */
+#define ADAPTER_BENCHMARK_SCAN_BYTES	(64 * 1024)
+#define ADAPTER_BENCHMARK_SCAN_REPEAT	8
+
+static const uint8_t adapter_benchmark_out[4];
+static uint8_t adapter_benchmark_in[4];
+static uint32_t adapter_benchmark_value;
+
+/* queue the smallest transaction of the transport that needs a reply */
+static void adapter_benchmark_queue(void)
+{
+	if (transport_is_swd())
+		adapter_driver->swd_ops->read_reg(swd_cmd(true, false, DP_DPIDR),
+			&adapter_benchmark_value, 0);
+	else
+		jtag_add_plain_dr_scan(32, adapter_benchmark_out, adapter_benchmark_in, TAP_IDLE);
+}
+
+static int adapter_benchmark_run(void)
+{
+	if (transport_is_swd())
+		return adapter_driver->swd_ops->run();
+	return jtag_execute_queue();
+}
+
+static int adapter_benchmark_compare(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a;
+	int64_t y = *(const int64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void adapter_benchmark_print_latency(struct command_invocation *cmd,
+		int64_t *samples, unsigned int count)
+{
+	qsort(samples, count, sizeof(*samples), adapter_benchmark_compare);
+	command_print(CMD, "round-trip (us): min %" PRId64 ", p50 %" PRId64 ", p90 %" PRId64
+		", p99 %" PRId64 ", max %" PRId64, samples[0], samples[count / 2],
+		samples[count * 90 / 100], samples[count * 99 / 100], samples[count - 1]);
+}
+
+/* put all the TAPs in BYPASS, the chain is then one bit per TAP long */
+static int adapter_benchmark_bypass(void)
+{
+	struct jtag_tap *tap = jtag_tap_next_enabled(NULL);
+	if (!tap) {
+		LOG_ERROR("no enabled TAP");
+		return ERROR_FAIL;
+	}
+
+	uint8_t *ones = malloc(DIV_ROUND_UP(tap->ir_length, 8));
+	if (!ones) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	buf_set_ones(ones, tap->ir_length);
+
+	struct scan_field field = {
+		.num_bits = tap->ir_length,
+		.out_value = ones,
+	};
+	jtag_add_ir_scan(tap, &field, TAP_IDLE);
+	int retval = jtag_execute_queue();
+	free(ones);
+
+	return retval;
+}
+
+static int adapter_benchmark_transactions(struct command_invocation *cmd, unsigned int count)
+{
+	int64_t *samples = malloc(count * sizeof(*samples));
+	if (!samples) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; i++) {
+		int64_t start = timeval_us();
+		adapter_benchmark_queue();
+		retval = adapter_benchmark_run();
+		samples[i] = timeval_us() - start;
+	}
+	if (retval == ERROR_OK)
+		adapter_benchmark_print_latency(cmd, samples, count);
+	free(samples);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct duration bench;
+	duration_start(&bench);
+	for (unsigned int i = 0; i < count; i++)
+		adapter_benchmark_queue();
+	retval = adapter_benchmark_run();
+	duration_measure(&bench);
+	if (retval != ERROR_OK)
+		return retval;
+
+	float elapsed = duration_elapsed(&bench);
+	command_print(CMD, "queued: %u transactions in %.3f ms, %.0f transactions/s",
+		count, elapsed * 1000, elapsed > 0 ? count / elapsed : 0);
+
+	return ERROR_OK;
+}
+
+static int adapter_benchmark_scan(struct command_invocation *cmd)
+{
+	uint8_t *buf = calloc(ADAPTER_BENCHMARK_SCAN_BYTES, 1);
+	if (!buf) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	struct duration bench;
+	duration_start(&bench);
+	for (unsigned int i = 0; i < ADAPTER_BENCHMARK_SCAN_REPEAT && retval == ERROR_OK; i++) {
+		jtag_add_plain_dr_scan(ADAPTER_BENCHMARK_SCAN_BYTES * 8, buf, buf, TAP_IDLE);
+		retval = jtag_execute_queue();
+	}
+	duration_measure(&bench);
+	free(buf);
+	if (retval != ERROR_OK)
+		return retval;
+
+	command_print(CMD, "scan into BYPASS: %u x %u bits, %.1f kbit/s",
+		ADAPTER_BENCHMARK_SCAN_REPEAT, ADAPTER_BENCHMARK_SCAN_BYTES * 8,
+		duration_kbps(&bench, ADAPTER_BENCHMARK_SCAN_BYTES * ADAPTER_BENCHMARK_SCAN_REPEAT) * 8);
+
+	return ERROR_OK;
+}
+
+/* read blocks of the target memory and write them back as they were */
+static int adapter_benchmark_memory(struct command_invocation *cmd, struct target *target,
+		target_addr_t address, uint32_t size, unsigned int count)
+{
+	static const uint32_t block_sizes[] = { 64, 256, 1024, 4096, 16384, 65536 };
+	unsigned int repeat = MAX(count / 10, 1U);
+
+	uint8_t *buf = malloc(size);
+	if (!buf) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	for (unsigned int i = 0; i < ARRAY_SIZE(block_sizes) && block_sizes[i] <= size; i++) {
+		uint32_t block = block_sizes[i];
+		struct duration read_bench, write_bench;
+
+		duration_start(&read_bench);
+		for (unsigned int j = 0; j < repeat && retval == ERROR_OK; j++)
+			retval = target_read_buffer(target, address, block, buf);
+		duration_measure(&read_bench);
+		if (retval != ERROR_OK)
+			break;
+
+		duration_start(&write_bench);
+		for (unsigned int j = 0; j < repeat && retval == ERROR_OK; j++)
+			retval = target_write_buffer(target, address, block, buf);
+		duration_measure(&write_bench);
+		if (retval != ERROR_OK)
+			break;
+
+		command_print(CMD, "memory %6" PRIu32 " bytes: read %.1f KiB/s, write %.1f KiB/s",
+			block, duration_kbps(&read_bench, block * repeat),
+			duration_kbps(&write_bench, block * repeat));
+	}
+	free(buf);
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_adapter_benchmark_command)
+{
+	unsigned int count = ADAPTER_BENCHMARK_DEFAULT_COUNT;
+	uint32_t size = ADAPTER_BENCHMARK_DEFAULT_SIZE;
+	target_addr_t address = 0;
+	int retval;
+
+	if (CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC >= 1) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], count);
+		if (!count) {
+			command_print(CMD, "count must be at least 1");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+	if (CMD_ARGC >= 2)
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
+	if (CMD_ARGC >= 3)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], size);
+
+	if (!is_adapter_initialized()) {
+		command_print(CMD, "the adapter is not initialized");
+		return ERROR_FAIL;
+	}
+
+	command_print(CMD, "adapter %s, transport %s, %u kHz", adapter_driver->name,
+		get_current_transport()->name, adapter_get_speed_khz());
+
+	if (transport_is_jtag()) {
+		retval = adapter_benchmark_bypass();
+		if (retval == ERROR_OK)
+			retval = adapter_benchmark_transactions(CMD, count);
+		if (retval == ERROR_OK)
+			retval = adapter_benchmark_scan(CMD);
+	} else if (transport_is_swd()) {
+		retval = adapter_benchmark_transactions(CMD, count);
+	} else {
+		command_print(CMD, "no raw transactions through transport %s",
+			get_current_transport()->name);
+		retval = ERROR_OK;
+	}
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC < 2)
+		return ERROR_OK;
+
+	struct target *target = get_current_target(CMD_CTX);
+	return adapter_benchmark_memory(CMD, target, address, size, count);
+}
+
 COMMAND_HANDLER(adapter_transports_command)
 {
 	char **transports;
@@ -1129,6 +1479,15 @@ static const struct command_registration adapter_command_handlers[] = {
 			"selected adapter (driver)",
 		.usage = "",
 	},
+	{
+		.name = "benchmark",
+		.handler = handle_adapter_benchmark_command,
+		.mode = COMMAND_EXEC,
+		.help = "Measure the round-trip latency and the bandwidth of the "
+			"adapter, and optionally of the memory accesses of the "
+			"current target at the given address",
+		.usage = "[count [address [size]]]",
+	},
 	{
 		.name = "srst",
 		.mode = COMMAND_ANY,
@@ -1211,7 +1570,11 @@ static const struct command_registration interface_command_handlers[] = {
  */
 int adapter_register_commands(struct command_context *ctx)
 {
-	return register_commands(ctx, NULL, interface_command_handlers);
+	int retval = register_commands(ctx, NULL, interface_command_handlers);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return register_commands(ctx, "adapter", adapter_record_command_handlers);
 }
 
 const char *adapter_gpio_get_name(enum adapter_gpio_config_index idx)
@@ -64,7 +64,63 @@ struct adapter_gpio_config {
 	enum adapter_gpio_pull pull;
 };
 
+/** Queues instrumented by the flush statistics */
+enum adapter_stats_queue {
+	ADAPTER_STATS_JTAG,
+	ADAPTER_STATS_SWD,
+	ADAPTER_STATS_NUM, /* must be the last item */
+};
+
+/** Number of buckets of each flush histogram */
+#define ADAPTER_STATS_BUCKETS 24
+
+/**
+ * Statistics of the queue flushes of one transport. Bucket 0 of each
+ * histogram counts the value 0, bucket n counts values in [2^(n-1), 2^n)
+ * and the last bucket collects everything larger.
+ */
+struct adapter_flush_stats {
+	uint64_t flushes;
+	uint64_t failures;
+	uint64_t commands;
+	uint64_t bits;
+	uint64_t total_us;
+	uint64_t max_us;
+	/** Number of top level operations that flushed this queue */
+	uint64_t ops;
+	uint64_t latency_us[ADAPTER_STATS_BUCKETS];
+	uint64_t depth[ADAPTER_STATS_BUCKETS];
+	uint64_t bits_shifted[ADAPTER_STATS_BUCKETS];
+	uint64_t flushes_per_op[ADAPTER_STATS_BUCKETS];
+};
+
 struct command_context;
+struct command_invocation;
+
+/**
+ * Account one queue flush.
+ * @param queue The queue that was flushed.
+ * @param start_us timeval_us() taken just before the flush.
+ * @param commands Number of queued commands or transactions.
+ * @param bits Number of bits shifted by the flush.
+ * @param retval Result of the flush.
+ */
+void adapter_stats_flush(enum adapter_stats_queue queue, int64_t start_us,
+		unsigned int commands, uint64_t bits, int retval);
+
+/**
+ * Bracket a top level operation, such as a command or a GDB packet, to
+ * count the flushes it requires. Calls can nest, only the outermost pair
+ * delimits an operation.
+ */
+void adapter_stats_begin_op(void);
+void adapter_stats_end_op(void);
+
+/** Clear the statistics of @a queue */
+void adapter_stats_reset(enum adapter_stats_queue queue);
+
+/** Print the statistics of @a queue as command output */
+void adapter_stats_print(struct command_invocation *cmd, enum adapter_stats_queue queue);
 
 /** Register the adapter's commands */
 int adapter_register_commands(struct command_context *ctx);
@@ -0,0 +1,280 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Recording of the transactions of the debug adapter, see adapter_record.h.
+ *
+ * The JTAG queue is recorded after the driver executed it. The SWD driver is
+ * wrapped instead, so that the results of the queued reads can be collected
+ * when the driver runs the queue.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "adapter_record.h"
+#include "interface.h"
+#include "commands.h"
+#include "swd.h"
+#include <helper/log.h>
+#include <helper/time_support.h>
+
+extern struct adapter_driver *adapter_driver;
+
+struct adapter_record_swd_transaction {
+	uint8_t cmd;
+	uint32_t value;
+	uint32_t *read_value;
+};
+
+static char *adapter_record_filename;
+static FILE *adapter_record_file;
+
+/* the payload of the record being built */
+static uint8_t *adapter_record_buf;
+static size_t adapter_record_size;
+static size_t adapter_record_alloc;
+
+static const struct swd_driver *adapter_record_swd;
+static struct adapter_record_swd_transaction *adapter_record_swd_queue;
+static unsigned int adapter_record_swd_queue_len;
+static unsigned int adapter_record_swd_queue_alloc;
+
+static int adapter_record_reserve(size_t size)
+{
+	if (adapter_record_size + size <= adapter_record_alloc)
+		return ERROR_OK;
+
+	size_t alloc = MAX(adapter_record_alloc * 2, adapter_record_size + size);
+	uint8_t *buf = realloc(adapter_record_buf, alloc);
+	if (!buf) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	adapter_record_buf = buf;
+	adapter_record_alloc = alloc;
+
+	return ERROR_OK;
+}
+
+/* write the header and the payload built in adapter_record_buf */
+static void adapter_record_write(enum adapter_record_type type, int retval, int64_t elapsed_us)
+{
+	uint8_t header[ADAPTER_RECORD_HEADER_SIZE];
+
+	if (elapsed_us < 0)
+		elapsed_us = 0;
+
+	header[0] = type;
+	h_u32_to_le(header + 1, adapter_record_size);
+	h_u32_to_le(header + 5, retval);
+	h_u32_to_le(header + 9, MIN(elapsed_us, (int64_t)UINT32_MAX));
+
+	if (fwrite(header, 1, sizeof(header), adapter_record_file) != sizeof(header) ||
+			fwrite(adapter_record_buf, 1, adapter_record_size, adapter_record_file)
+				!= adapter_record_size) {
+		LOG_ERROR("couldn't write to %s: %s, recording stopped",
+			adapter_record_filename, strerror(errno));
+		adapter_record_stop();
+	}
+
+	adapter_record_size = 0;
+}
+
+void adapter_record_jtag(const struct jtag_command *queue, int retval, int64_t elapsed_us)
+{
+	if (!adapter_record_file)
+		return;
+
+	for (const struct jtag_command *cmd = queue; cmd; cmd = cmd->next) {
+		if (cmd->type != JTAG_SCAN)
+			continue;
+		for (int i = 0; i < cmd->cmd.scan->num_fields; i++) {
+			const struct scan_field *field = &cmd->cmd.scan->fields[i];
+			if (!field->in_value)
+				continue;
+
+			size_t size = DIV_ROUND_UP(field->num_bits, 8);
+			if (adapter_record_reserve(size) != ERROR_OK) {
+				adapter_record_stop();
+				return;
+			}
+			buf_cpy(field->in_value, adapter_record_buf + adapter_record_size,
+				field->num_bits);
+			adapter_record_size += size;
+		}
+	}
+
+	adapter_record_write(ADAPTER_RECORD_JTAG, retval, elapsed_us);
+}
+
+static void adapter_record_swd_queue_add(uint8_t cmd, uint32_t value, uint32_t *read_value)
+{
+	if (adapter_record_swd_queue_len == adapter_record_swd_queue_alloc) {
+		unsigned int alloc = MAX(2 * adapter_record_swd_queue_alloc, 64U);
+		struct adapter_record_swd_transaction *queue = realloc(adapter_record_swd_queue,
+			alloc * sizeof(*queue));
+		if (!queue) {
+			LOG_ERROR("Out of memory, recording stopped");
+			adapter_record_stop();
+			return;
+		}
+		adapter_record_swd_queue = queue;
+		adapter_record_swd_queue_alloc = alloc;
+	}
+
+	struct adapter_record_swd_transaction *t =
+		&adapter_record_swd_queue[adapter_record_swd_queue_len++];
+	t->cmd = cmd;
+	t->value = value;
+	t->read_value = read_value;
+}
+
+static int adapter_record_swd_init(void)
+{
+	return adapter_record_swd->init();
+}
+
+static int adapter_record_swd_switch_seq(enum swd_special_seq seq)
+{
+	int64_t start = timeval_us();
+	int retval = adapter_record_swd->switch_seq(seq);
+
+	if (adapter_record_file && adapter_record_reserve(1) == ERROR_OK) {
+		adapter_record_buf[adapter_record_size++] = seq;
+		adapter_record_write(ADAPTER_RECORD_SWD_SEQ, retval, timeval_us() - start);
+	}
+
+	return retval;
+}
+
+static void adapter_record_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_hint)
+{
+	if (adapter_record_file)
+		adapter_record_swd_queue_add(cmd, 0, value);
+	adapter_record_swd->read_reg(cmd, value, ap_delay_hint);
+}
+
+static void adapter_record_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_hint)
+{
+	if (adapter_record_file)
+		adapter_record_swd_queue_add(cmd, value, NULL);
+	adapter_record_swd->write_reg(cmd, value, ap_delay_hint);
+}
+
+static int adapter_record_swd_run(void)
+{
+	int64_t start = timeval_us();
+	int retval = adapter_record_swd->run();
+	int64_t elapsed_us = timeval_us() - start;
+
+	if (adapter_record_file && adapter_record_reserve(adapter_record_swd_queue_len *
+			ADAPTER_RECORD_SWD_TRANSACTION_SIZE) == ERROR_OK) {
+		for (unsigned int i = 0; i < adapter_record_swd_queue_len; i++) {
+			const struct adapter_record_swd_transaction *t = &adapter_record_swd_queue[i];
+			uint8_t *p = adapter_record_buf + adapter_record_size;
+
+			p[0] = t->cmd;
+			h_u32_to_le(p + 1, t->read_value ? *t->read_value : t->value);
+			adapter_record_size += ADAPTER_RECORD_SWD_TRANSACTION_SIZE;
+		}
+		adapter_record_write(ADAPTER_RECORD_SWD, retval, elapsed_us);
+	}
+	adapter_record_swd_queue_len = 0;
+
+	return retval;
+}
+
+static int *adapter_record_swd_trace(bool swo)
+{
+	return adapter_record_swd->trace(swo);
+}
+
+static struct swd_driver adapter_record_swd_driver = {
+	.init = adapter_record_swd_init,
+	.switch_seq = adapter_record_swd_switch_seq,
+	.read_reg = adapter_record_swd_read_reg,
+	.write_reg = adapter_record_swd_write_reg,
+	.run = adapter_record_swd_run,
+};
+
+int adapter_record_start(void)
+{
+	if (!adapter_record_filename || adapter_record_file)
+		return ERROR_OK;
+
+	adapter_record_file = fopen(adapter_record_filename, "wb");
+	if (!adapter_record_file) {
+		LOG_ERROR("couldn't open %s: %s", adapter_record_filename, strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	if (fwrite(ADAPTER_RECORD_MAGIC, 1, ADAPTER_RECORD_MAGIC_SIZE, adapter_record_file)
+			!= ADAPTER_RECORD_MAGIC_SIZE) {
+		LOG_ERROR("couldn't write to %s: %s", adapter_record_filename, strerror(errno));
+		fclose(adapter_record_file);
+		adapter_record_file = NULL;
+		return ERROR_FAIL;
+	}
+
+	/* wrap the SWD driver, the DAP picks up the driver after the adapter init */
+	if (adapter_driver->swd_ops && adapter_driver->swd_ops != &adapter_record_swd_driver) {
+		adapter_record_swd = adapter_driver->swd_ops;
+		adapter_record_swd_driver.trace = adapter_record_swd->trace ?
+			adapter_record_swd_trace : NULL;
+		adapter_driver->swd_ops = &adapter_record_swd_driver;
+	}
+
+	LOG_INFO("recording the adapter transactions to %s", adapter_record_filename);
+
+	return ERROR_OK;
+}
+
+void adapter_record_stop(void)
+{
+	if (adapter_record_file) {
+		fclose(adapter_record_file);
+		adapter_record_file = NULL;
+	}
+
+	/* the wrapper stays in place and only forwards from now on */
+	free(adapter_record_buf);
+	adapter_record_buf = NULL;
+	adapter_record_size = 0;
+	adapter_record_alloc = 0;
+
+	free(adapter_record_swd_queue);
+	adapter_record_swd_queue = NULL;
+	adapter_record_swd_queue_len = 0;
+	adapter_record_swd_queue_alloc = 0;
+
+	free(adapter_record_filename);
+	adapter_record_filename = NULL;
+}
+
+COMMAND_HANDLER(handle_adapter_record_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	free(adapter_record_filename);
+	adapter_record_filename = strdup(CMD_ARGV[0]);
+	if (!adapter_record_filename) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+const struct command_registration adapter_record_command_handlers[] = {
+	{
+		.name = "record",
+		.handler = handle_adapter_record_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Record the transactions of the adapter to a file, "
+			"for the replay adapter driver",
+		.usage = "filename",
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_JTAG_ADAPTER_RECORD_H
+#define OPENOCD_JTAG_ADAPTER_RECORD_H
+
+#include <helper/command.h>
+#include <helper/types.h>
+
+/*
+ * Log of the transactions of the debug adapter, written by 'adapter record'
+ * and played back by the 'replay' adapter driver.
+ *
+ * The log starts with ADAPTER_RECORD_MAGIC, followed by one record per flush
+ * of the JTAG or SWD queue. Each record has a header of
+ * ADAPTER_RECORD_HEADER_SIZE bytes: the type, the size of the payload, the
+ * result of the flush and its duration in microseconds; all the numbers are
+ * little endian. The payload is:
+ * - ADAPTER_RECORD_JTAG: the captured bits of each scan field with an input,
+ *   in the order of the queue, each field rounded up to whole bytes;
+ * - ADAPTER_RECORD_SWD: for each queued transaction its command byte and the
+ *   value written or read, as a 32 bit word;
+ * - ADAPTER_RECORD_SWD_SEQ: the special sequence sent.
+ */
+
+#define ADAPTER_RECORD_MAGIC		"OOCDREC1"
+#define ADAPTER_RECORD_MAGIC_SIZE	8
+
+#define ADAPTER_RECORD_HEADER_SIZE	13
+#define ADAPTER_RECORD_SWD_TRANSACTION_SIZE	5
+
+enum adapter_record_type {
+	ADAPTER_RECORD_JTAG = 'J',
+	ADAPTER_RECORD_SWD = 'S',
+	ADAPTER_RECORD_SWD_SEQ = 'Q',
+};
+
+struct jtag_command;
+
+/* start recording to the file set with 'adapter record', if any */
+int adapter_record_start(void);
+void adapter_record_stop(void);
+
+/* record the results of the JTAG queue that was just executed */
+void adapter_record_jtag(const struct jtag_command *queue, int retval, int64_t elapsed_us);
+
+extern const struct command_registration adapter_record_command_handlers[];
+
+#endif /* OPENOCD_JTAG_ADAPTER_RECORD_H */
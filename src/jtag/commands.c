@@ -27,11 +27,29 @@ struct cmd_queue_page {
 	struct cmd_queue_page *next;
 	void *address;
 	size_t used;
+	size_t size;
 };
 
 #define CMD_QUEUE_PAGE_SIZE (1024 * 1024)
+
+/*
+ * Pages are recycled across queue resets; the spare ones are kept on a
+ * free list whose length is bounded by the largest number of pages used
+ * by a single queue over the last two trim windows.
+ */
+#define CMD_QUEUE_TRIM_INTERVAL 256
+
 static struct cmd_queue_page *cmd_queue_pages;
 static struct cmd_queue_page *cmd_queue_pages_tail;
+static unsigned int cmd_queue_pages_used;
+/* allocations larger than a page get their own buffer, never recycled */
+static struct cmd_queue_page *cmd_queue_big_pages;
+static struct cmd_queue_page *cmd_queue_free_pages;
+static unsigned int cmd_queue_free_count;
+static unsigned int cmd_queue_window_peak;
+static unsigned int cmd_queue_prev_window_peak;
+
+static struct cmd_queue_stats cmd_queue_stats;
 
 struct jtag_command *jtag_command_queue;
 static struct jtag_command **next_command_pointer = &jtag_command_queue;
@@ -63,6 +81,16 @@ void jtag_queue_command(struct jtag_command *cmd)
 	next_command_pointer = &cmd->next;
 }
 
+void jtag_command_queue_unlink(struct jtag_command **link)
+{
+	struct jtag_command *cmd = *link;
+
+	assert(cmd);
+	*link = cmd->next;
+	if (next_command_pointer == &cmd->next)
+		next_command_pointer = link;
+}
+
 void *cmd_queue_alloc(size_t size)
 {
 	struct cmd_queue_page **p_page = &cmd_queue_pages;
@@ -101,6 +129,24 @@ void *cmd_queue_alloc(size_t size)
 	size = (size + ALIGN_SIZE - 1) & (~(ALIGN_SIZE - 1));
 	/* Done... */
 
+	if (size > CMD_QUEUE_PAGE_SIZE) {
+		struct cmd_queue_page *big = malloc(sizeof(*big));
+		if (!big)
+			return NULL;
+		big->address = malloc(size);
+		if (!big->address) {
+			free(big);
+			return NULL;
+		}
+		big->used = size;
+		big->size = size;
+		big->next = cmd_queue_big_pages;
+		cmd_queue_big_pages = big;
+		cmd_queue_stats.page_allocs++;
+		cmd_queue_stats.bytes_used += size;
+		return big->address;
+	}
+
 	if (*p_page) {
 		p_page = &cmd_queue_pages_tail;
 		if (CMD_QUEUE_PAGE_SIZE - (*p_page)->used < size)
@@ -108,35 +154,90 @@ void *cmd_queue_alloc(size_t size)
 	}
 
 	if (!*p_page) {
-		*p_page = malloc(sizeof(struct cmd_queue_page));
+		if (cmd_queue_free_pages) {
+			*p_page = cmd_queue_free_pages;
+			cmd_queue_free_pages = cmd_queue_free_pages->next;
+			cmd_queue_free_count--;
+		} else {
+			*p_page = malloc(sizeof(struct cmd_queue_page));
+			if (!*p_page)
+				return NULL;
+			(*p_page)->address = malloc(CMD_QUEUE_PAGE_SIZE);
+			if (!(*p_page)->address) {
+				free(*p_page);
+				*p_page = NULL;
+				return NULL;
+			}
+			(*p_page)->size = CMD_QUEUE_PAGE_SIZE;
+			cmd_queue_stats.page_allocs++;
+			cmd_queue_stats.pages_live++;
+		}
 		(*p_page)->used = 0;
-		size_t alloc_size = (size < CMD_QUEUE_PAGE_SIZE) ?
-					CMD_QUEUE_PAGE_SIZE : size;
-		(*p_page)->address = malloc(alloc_size);
 		(*p_page)->next = NULL;
 		cmd_queue_pages_tail = *p_page;
+		cmd_queue_pages_used++;
 	}
 
 	offset = (*p_page)->used;
 	(*p_page)->used += size;
+	cmd_queue_stats.bytes_used += size;
 
 	t = (*p_page)->address;
 	return t + offset;
 }
 
+static void cmd_queue_page_free(struct cmd_queue_page *page)
+{
+	free(page->address);
+	free(page);
+}
+
+/* Release spare pages until at most @a keep of them are left. */
+static void cmd_queue_trim(unsigned int keep)
+{
+	while (cmd_queue_free_count > keep) {
+		struct cmd_queue_page *page = cmd_queue_free_pages;
+		cmd_queue_free_pages = page->next;
+		cmd_queue_free_count--;
+		cmd_queue_page_free(page);
+		cmd_queue_stats.page_frees++;
+		cmd_queue_stats.pages_live--;
+	}
+}
+
 static void cmd_queue_free(void)
 {
-	struct cmd_queue_page *page = cmd_queue_pages;
+	while (cmd_queue_big_pages) {
+		struct cmd_queue_page *big = cmd_queue_big_pages;
+		cmd_queue_big_pages = big->next;
+		cmd_queue_page_free(big);
+		cmd_queue_stats.page_frees++;
+	}
+
+	if (cmd_queue_stats.bytes_used > cmd_queue_stats.peak_bytes)
+		cmd_queue_stats.peak_bytes = cmd_queue_stats.bytes_used;
+	cmd_queue_stats.bytes_used = 0;
+	cmd_queue_stats.resets++;
+
+	if (cmd_queue_pages_used > cmd_queue_window_peak)
+		cmd_queue_window_peak = cmd_queue_pages_used;
+	if (cmd_queue_stats.resets % CMD_QUEUE_TRIM_INTERVAL == 0) {
+		cmd_queue_prev_window_peak = cmd_queue_window_peak;
+		cmd_queue_window_peak = 0;
+	}
 
-	while (page) {
-		struct cmd_queue_page *last = page;
-		free(page->address);
-		page = page->next;
-		free(last);
+	/* splice the whole list of used pages in front of the free list */
+	if (cmd_queue_pages) {
+		cmd_queue_pages_tail->next = cmd_queue_free_pages;
+		cmd_queue_free_pages = cmd_queue_pages;
+		cmd_queue_free_count += cmd_queue_pages_used;
 	}
 
 	cmd_queue_pages = NULL;
 	cmd_queue_pages_tail = NULL;
+	cmd_queue_pages_used = 0;
+
+	cmd_queue_trim(MAX(cmd_queue_window_peak, cmd_queue_prev_window_peak));
 }
 
 void jtag_command_queue_reset(void)
@@ -147,6 +248,21 @@ void jtag_command_queue_reset(void)
 	next_command_pointer = &jtag_command_queue;
 }
 
+void jtag_command_queue_release_pages(void)
+{
+	jtag_command_queue_reset();
+	cmd_queue_trim(0);
+	cmd_queue_window_peak = 0;
+	cmd_queue_prev_window_peak = 0;
+}
+
+void jtag_command_queue_get_stats(struct cmd_queue_stats *stats)
+{
+	*stats = cmd_queue_stats;
+	stats->pages_free = cmd_queue_free_count;
+	stats->pages_retained = MAX(cmd_queue_window_peak, cmd_queue_prev_window_peak);
+}
+
 /**
  * Copy a struct scan_field for insertion into the queue.
  *
@@ -152,10 +152,38 @@ struct jtag_command {
 /** The current queue of jtag_command_s structures. */
 extern struct jtag_command *jtag_command_queue;
 
+/** Usage counters of the memory backing the JTAG command queue. */
+struct cmd_queue_stats {
+	/** pages currently allocated, either in use or on the free list */
+	unsigned int pages_live;
+	/** pages on the free list, ready for recycling */
+	unsigned int pages_free;
+	/** number of free pages the trim policy currently retains */
+	unsigned int pages_retained;
+	/** bytes handed out since the last queue reset */
+	size_t bytes_used;
+	/** largest number of bytes handed out between two resets */
+	size_t peak_bytes;
+	/** number of queue resets */
+	uint64_t resets;
+	/** number of calls to malloc() for queue pages */
+	uint64_t page_allocs;
+	/** number of queue pages returned to the system */
+	uint64_t page_frees;
+};
+
 void *cmd_queue_alloc(size_t size);
 
 void jtag_queue_command(struct jtag_command *cmd);
 void jtag_command_queue_reset(void);
+/**
+ * Remove the command pointed to by @a link from the queue. Its memory
+ * stays valid until the queue is reset.
+ */
+void jtag_command_queue_unlink(struct jtag_command **link);
+/** Reset the queue and return all the recycled pages to the system. */
+void jtag_command_queue_release_pages(void);
+void jtag_command_queue_get_stats(struct cmd_queue_stats *stats);
 
 void jtag_scan_field_clone(struct scan_field *dst, const struct scan_field *src);
 enum scan_type jtag_scan_type(const struct scan_command *cmd);
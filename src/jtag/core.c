@@ -20,12 +20,16 @@
 #endif
 
 #include "adapter.h"
+#include "adapter_record.h"
 #include "jtag.h"
 #include "swd.h"
 #include "interface.h"
 #include <transport/transport.h>
 #include <helper/jep106.h>
 #include "helper/system.h"
+#include "helper/time_support.h"
+#include "helper/event_trace.h"
+#include "helper/metrics.h"
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -41,6 +45,11 @@
 /** The number of JTAG queue flushes (for profiling and debugging purposes). */
 static int jtag_flush_queue_count;
 
+static struct metric jtag_execute_queue_metric = METRIC_HISTOGRAM("jtag_execute_queue_microseconds",
+		"Time taken to execute the JTAG queue");
+static struct metric jtag_execute_queue_errors = METRIC_COUNTER("jtag_execute_queue_errors_total",
+		"Failed executions of the JTAG queue");
+
 /* Sleep this # of ms after flushing the queue */
 static int jtag_flush_queue_sleep;
 
@@ -90,6 +99,25 @@ tap_state_t cmd_queue_cur_state = TAP_RESET;
 static bool jtag_verify_capture_ir = true;
 static int jtag_verify = 1;
 
+/* skip IR scans of the instruction each TAP already holds */
+static bool jtag_ir_cache;
+static uint64_t jtag_ir_cache_hits;
+static uint64_t jtag_ir_cache_misses;
+
+/* file holding the scan chain found by the last full examination */
+static char *jtag_chain_cache_file;
+/* set when the examination had to create TAPs that were not declared */
+static bool jtag_chain_autoprobed;
+
+/* let jtag_execute_queue_posted() run queues asynchronously */
+static bool jtag_pipeline;
+static bool jtag_posted;
+static uint64_t jtag_posted_count;
+
+/* peephole optimization of the command queue before it reaches the driver */
+static bool jtag_optimize;
+static struct jtag_optimize_stats jtag_optimize_stats;
+
 /* how long the OpenOCD should wait before attempting JTAG communication after reset lines
  *deasserted (in ms) */
 static int adapter_nsrst_delay;	/* default to no nSRST delay */
@@ -370,11 +398,51 @@ static void jtag_add_ir_scan_noverify_callback(struct jtag_tap *active,
 	jtag_add_ir_scan_noverify(active, in_fields, state);
 }
 
+void jtag_ir_cache_invalidate(void)
+{
+	for (struct jtag_tap *tap = __jtag_all_taps; tap; tap = tap->next_tap)
+		tap->ir_cache_valid = false;
+}
+
+/*
+ * The IR scan can be skipped if the active TAP already holds the
+ * instruction, all the other enabled TAPs hold BYPASS, the caller does
+ * not want the captured value and no state move is needed afterwards.
+ */
+static bool jtag_ir_cache_hit(struct jtag_tap *active,
+		const struct scan_field *field, tap_state_t state)
+{
+	if (field->in_value || !field->out_value || state != cmd_queue_cur_state
+			|| field->num_bits != active->ir_length)
+		return false;
+
+	for (struct jtag_tap *tap = jtag_tap_next_enabled(NULL); tap; tap = jtag_tap_next_enabled(tap)) {
+		if (!tap->ir_cache_valid)
+			return false;
+		if (tap == active) {
+			if (tap->bypass || buf_cmp(tap->cur_instr, field->out_value, tap->ir_length))
+				return false;
+		} else if (!tap->bypass) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 /* If fields->in_value is filled out, then the captured IR value will be checked */
 void jtag_add_ir_scan(struct jtag_tap *active, struct scan_field *in_fields, tap_state_t state)
 {
 	assert(state != TAP_RESET);
 
+	if (jtag_ir_cache) {
+		if (jtag_ir_cache_hit(active, in_fields, state)) {
+			jtag_ir_cache_hits++;
+			return;
+		}
+		jtag_ir_cache_misses++;
+	}
+
 	if (jtag_verify && jtag_verify_capture_ir) {
 		/* 8 x 32 bit id's is enough for all invocations */
 
@@ -397,6 +465,9 @@ void jtag_add_plain_ir_scan(int num_bits, const uint8_t *out_bits, uint8_t *in_b
 
 	jtag_prelude(state);
 
+	/* the bits shifted into each TAP are not tracked */
+	jtag_ir_cache_invalidate();
+
 	int retval = interface_jtag_add_plain_ir_scan(
 			num_bits, out_bits, in_bits, state);
 	jtag_set_error(retval);
@@ -404,16 +475,86 @@ void jtag_add_plain_ir_scan(int num_bits, const uint8_t *out_bits, uint8_t *in_b
 
 static int jtag_check_value_inner(uint8_t *captured, uint8_t *in_check_value,
 				  uint8_t *in_check_mask, int num_bits);
+static bool jtag_check_value_failed(const uint8_t *captured, const uint8_t *in_check_value,
+	const uint8_t *in_check_mask, int num_bits);
+static void jtag_check_value_report(const uint8_t *captured, const uint8_t *in_check_value,
+	const uint8_t *in_check_mask, int num_bits);
+
+/* A captured field to be verified once the queue has been executed. */
+struct jtag_check_entry {
+	uint8_t *captured;
+	uint8_t *check_value;
+	uint8_t *check_mask;
+	int num_bits;
+	struct jtag_check_entry *next;
+};
 
-static int jtag_check_value_mask_callback(jtag_callback_data_t data0,
+/*
+ * All the checks of a queue are collected in one table, verified by a
+ * single callback after the queue has been flushed. Like everything else
+ * in the queue, the table lives in memory from cmd_queue_alloc().
+ */
+struct jtag_check_table {
+	struct jtag_check_entry *head;
+	struct jtag_check_entry **tail;
+	unsigned int count;
+};
+
+/* table of the queue being built, NULL until its first check */
+static struct jtag_check_table *jtag_check_table;
+
+static int jtag_check_table_callback(jtag_callback_data_t data0,
 	jtag_callback_data_t data1,
 	jtag_callback_data_t data2,
 	jtag_callback_data_t data3)
 {
-	return jtag_check_value_inner((uint8_t *)data0,
-		(uint8_t *)data1,
-		(uint8_t *)data2,
-		(int)data3);
+	struct jtag_check_table *table = (struct jtag_check_table *)data0;
+	struct jtag_check_entry *first_failed = NULL;
+	unsigned int failed = 0;
+
+	for (struct jtag_check_entry *e = table->head; e; e = e->next) {
+		if (jtag_check_value_failed(e->captured, e->check_value, e->check_mask, e->num_bits)) {
+			if (!first_failed)
+				first_failed = e;
+			failed++;
+		}
+	}
+
+	if (!failed)
+		return ERROR_OK;
+
+	/* only the failures get formatted */
+	jtag_check_value_report(first_failed->captured, first_failed->check_value,
+		first_failed->check_mask, first_failed->num_bits);
+	if (failed > 1)
+		LOG_WARNING("%u of %u checked fields in the JTAG queue did not match",
+			failed, table->count);
+
+	return ERROR_JTAG_QUEUE_FAILED;
+}
+
+static void jtag_check_table_add(struct scan_field *field)
+{
+	if (!jtag_check_table) {
+		jtag_check_table = cmd_queue_alloc(sizeof(*jtag_check_table));
+		jtag_check_table->head = NULL;
+		jtag_check_table->tail = &jtag_check_table->head;
+		jtag_check_table->count = 0;
+
+		jtag_add_callback4(jtag_check_table_callback,
+			(jtag_callback_data_t)jtag_check_table, 0, 0, 0);
+	}
+
+	struct jtag_check_entry *e = cmd_queue_alloc(sizeof(*e));
+	e->captured = field->in_value;
+	e->check_value = field->check_value;
+	e->check_mask = field->check_mask;
+	e->num_bits = field->num_bits;
+	e->next = NULL;
+
+	*jtag_check_table->tail = e;
+	jtag_check_table->tail = &e->next;
+	jtag_check_table->count++;
 }
 
 static void jtag_add_scan_check(struct jtag_tap *active, void (*jtag_add_scan)(
@@ -426,13 +567,8 @@ static void jtag_add_scan_check(struct jtag_tap *active, void (*jtag_add_scan)(
 	jtag_add_scan(active, in_num_fields, in_fields, state);
 
 	for (int i = 0; i < in_num_fields; i++) {
-		if ((in_fields[i].check_value) && (in_fields[i].in_value)) {
-			jtag_add_callback4(jtag_check_value_mask_callback,
-				(jtag_callback_data_t)in_fields[i].in_value,
-				(jtag_callback_data_t)in_fields[i].check_value,
-				(jtag_callback_data_t)in_fields[i].check_mask,
-				(jtag_callback_data_t)in_fields[i].num_bits);
-		}
+		if ((in_fields[i].check_value) && (in_fields[i].in_value))
+			jtag_check_table_add(&in_fields[i]);
 	}
 }
 
@@ -508,6 +644,7 @@ int jtag_add_tms_seq(unsigned nbits, const uint8_t *seq, enum tap_state state)
 
 	jtag_checks();
 	cmd_queue_cur_state = state;
+	jtag_ir_cache_invalidate();
 
 	retval = interface_add_tms_seq(nbits, seq, state);
 	jtag_set_error(retval);
@@ -712,6 +849,8 @@ static void legacy_jtag_add_reset(int req_tlr_or_trst, int req_srst)
 		jtag_srst = new_srst;
 		if (jtag_srst) {
 			LOG_DEBUG("SRST line asserted");
+			/* the TAPs may be reset along with the system */
+			jtag_ir_cache_invalidate();
 			if (adapter_nsrst_assert_width)
 				jtag_add_sleep(adapter_nsrst_assert_width * 1000);
 		} else {
@@ -874,44 +1013,50 @@ void jtag_add_sleep(uint32_t us)
 	jtag_set_error(interface_jtag_add_sleep(us));
 }
 
-static int jtag_check_value_inner(uint8_t *captured, uint8_t *in_check_value,
-	uint8_t *in_check_mask, int num_bits)
+static bool jtag_check_value_failed(const uint8_t *captured, const uint8_t *in_check_value,
+	const uint8_t *in_check_mask, int num_bits)
 {
-	int retval = ERROR_OK;
-	int compare_failed;
-
 	if (in_check_mask)
-		compare_failed = buf_cmp_mask(captured, in_check_value, in_check_mask, num_bits);
-	else
-		compare_failed = buf_cmp(captured, in_check_value, num_bits);
+		return buf_cmp_mask(captured, in_check_value, in_check_mask, num_bits);
 
-	if (compare_failed) {
-		char *captured_str, *in_check_value_str;
-		int bits = (num_bits > DEBUG_JTAG_IOZ) ? DEBUG_JTAG_IOZ : num_bits;
+	return buf_cmp(captured, in_check_value, num_bits);
+}
 
-		/* NOTE:  we've lost diagnostic context here -- 'which tap' */
+static void jtag_check_value_report(const uint8_t *captured, const uint8_t *in_check_value,
+	const uint8_t *in_check_mask, int num_bits)
+{
+	char *captured_str, *in_check_value_str;
+	int bits = (num_bits > DEBUG_JTAG_IOZ) ? DEBUG_JTAG_IOZ : num_bits;
 
-		captured_str = buf_to_hex_str(captured, bits);
-		in_check_value_str = buf_to_hex_str(in_check_value, bits);
+	/* NOTE:  we've lost diagnostic context here -- 'which tap' */
 
-		LOG_WARNING("Bad value '%s' captured during DR or IR scan:",
-			captured_str);
-		LOG_WARNING(" check_value: 0x%s", in_check_value_str);
+	captured_str = buf_to_hex_str(captured, bits);
+	in_check_value_str = buf_to_hex_str(in_check_value, bits);
 
-		free(captured_str);
-		free(in_check_value_str);
+	LOG_WARNING("Bad value '%s' captured during DR or IR scan:",
+		captured_str);
+	LOG_WARNING(" check_value: 0x%s", in_check_value_str);
 
-		if (in_check_mask) {
-			char *in_check_mask_str;
+	free(captured_str);
+	free(in_check_value_str);
 
-			in_check_mask_str = buf_to_hex_str(in_check_mask, bits);
-			LOG_WARNING(" check_mask: 0x%s", in_check_mask_str);
-			free(in_check_mask_str);
-		}
+	if (in_check_mask) {
+		char *in_check_mask_str;
 
-		retval = ERROR_JTAG_QUEUE_FAILED;
+		in_check_mask_str = buf_to_hex_str(in_check_mask, bits);
+		LOG_WARNING(" check_mask: 0x%s", in_check_mask_str);
+		free(in_check_mask_str);
 	}
-	return retval;
+}
+
+static int jtag_check_value_inner(uint8_t *captured, uint8_t *in_check_value,
+	uint8_t *in_check_mask, int num_bits)
+{
+	if (!jtag_check_value_failed(captured, in_check_value, in_check_mask, num_bits))
+		return ERROR_OK;
+
+	jtag_check_value_report(captured, in_check_value, in_check_mask, num_bits);
+	return ERROR_JTAG_QUEUE_FAILED;
 }
 
 void jtag_check_value_mask(struct scan_field *field, uint8_t *value, uint8_t *mask)
@@ -929,6 +1074,198 @@ void jtag_check_value_mask(struct scan_field *field, uint8_t *value, uint8_t *ma
 	jtag_set_error(retval);
 }
 
+/* @returns the TAP state reached after @a cmd, TAP_INVALID if not known */
+static tap_state_t jtag_optimize_end_state(const struct jtag_command *cmd,
+		tap_state_t state)
+{
+	switch (cmd->type) {
+	case JTAG_SCAN:
+		return cmd->cmd.scan->end_state;
+	case JTAG_TLR_RESET:
+		return TAP_RESET;
+	case JTAG_RUNTEST:
+		return cmd->cmd.runtest->end_state;
+	case JTAG_PATHMOVE:
+		if (cmd->cmd.pathmove->num_states > 0)
+			return cmd->cmd.pathmove->path[cmd->cmd.pathmove->num_states - 1];
+		return state;
+	case JTAG_SLEEP:
+	case JTAG_STABLECLOCKS:
+		return state;
+	default:
+		return TAP_INVALID;
+	}
+}
+
+/*
+ * An IR scan is redundant if it follows an IR scan that shifted the very
+ * same bits, wants nothing back and ends in the same state.
+ */
+static bool jtag_optimize_same_ir_scan(const struct jtag_command *prev,
+		const struct jtag_command *cmd)
+{
+	if (prev->type != JTAG_SCAN || cmd->type != JTAG_SCAN)
+		return false;
+
+	const struct scan_command *a = prev->cmd.scan;
+	const struct scan_command *b = cmd->cmd.scan;
+
+	if (!a->ir_scan || !b->ir_scan || a->end_state != b->end_state
+			|| a->num_fields != b->num_fields)
+		return false;
+
+	for (int i = 0; i < a->num_fields; i++) {
+		const struct scan_field *fa = &a->fields[i];
+		const struct scan_field *fb = &b->fields[i];
+
+		if (fa->num_bits != fb->num_bits || fb->in_value
+				|| !fa->out_value || !fb->out_value
+				|| buf_cmp(fa->out_value, fb->out_value, fa->num_bits))
+			return false;
+	}
+
+	return true;
+}
+
+/* @returns true if @a cmd has no effect when executed in @a state */
+static bool jtag_optimize_is_noop(const struct jtag_command *cmd,
+		tap_state_t state, unsigned int *bits)
+{
+	switch (cmd->type) {
+	case JTAG_PATHMOVE:
+		return cmd->cmd.pathmove->num_states == 0;
+	case JTAG_TMS:
+		return cmd->cmd.tms->num_bits == 0;
+	case JTAG_STABLECLOCKS:
+		return cmd->cmd.stableclocks->num_cycles <= 0;
+	case JTAG_RUNTEST:
+		return cmd->cmd.runtest->num_cycles == 0 && state == TAP_IDLE
+			&& cmd->cmd.runtest->end_state == TAP_IDLE;
+	case JTAG_TLR_RESET:
+		if (state != TAP_RESET)
+			return false;
+		*bits = 5;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Try to fold @a cmd into @a prev. @returns true if @a cmd became redundant. */
+static bool jtag_optimize_merge(struct jtag_command *prev,
+		const struct jtag_command *cmd, unsigned int *bits)
+{
+	if (jtag_optimize_same_ir_scan(prev, cmd)) {
+		*bits = jtag_scan_size(cmd->cmd.scan);
+		return true;
+	}
+
+	if (prev->type == JTAG_RUNTEST && prev->cmd.runtest->end_state == TAP_IDLE) {
+		struct runtest_command *runtest = prev->cmd.runtest;
+
+		if (cmd->type == JTAG_RUNTEST
+				&& cmd->cmd.runtest->num_cycles <= INT_MAX - runtest->num_cycles) {
+			runtest->num_cycles += cmd->cmd.runtest->num_cycles;
+			runtest->end_state = cmd->cmd.runtest->end_state;
+			return true;
+		}
+
+		/* stable clocks in Run-Test/Idle are just more idle cycles */
+		if (cmd->type == JTAG_STABLECLOCKS
+				&& cmd->cmd.stableclocks->num_cycles <= INT_MAX - runtest->num_cycles) {
+			runtest->num_cycles += cmd->cmd.stableclocks->num_cycles;
+			return true;
+		}
+	}
+
+	if (prev->type == JTAG_STABLECLOCKS && cmd->type == JTAG_STABLECLOCKS
+			&& cmd->cmd.stableclocks->num_cycles
+				<= INT_MAX - prev->cmd.stableclocks->num_cycles) {
+		prev->cmd.stableclocks->num_cycles += cmd->cmd.stableclocks->num_cycles;
+		return true;
+	}
+
+	if (prev->type == JTAG_PATHMOVE && cmd->type == JTAG_PATHMOVE) {
+		struct pathmove_command *a = prev->cmd.pathmove;
+		const struct pathmove_command *b = cmd->cmd.pathmove;
+		tap_state_t *path = cmd_queue_alloc((a->num_states + b->num_states) * sizeof(*path));
+		if (!path)
+			return false;
+
+		memcpy(path, a->path, a->num_states * sizeof(*path));
+		memcpy(path + a->num_states, b->path, b->num_states * sizeof(*path));
+		a->path = path;
+		a->num_states += b->num_states;
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Driver-agnostic peephole pass over the command queue: drop commands that
+ * have no effect and fold adjacent commands that can be expressed as one.
+ */
+static void jtag_optimize_queue(void)
+{
+	struct jtag_command **link = &jtag_command_queue;
+	struct jtag_command *prev = NULL;
+	tap_state_t state = TAP_INVALID;
+
+	jtag_optimize_stats.queues++;
+
+	while (*link) {
+		struct jtag_command *cmd = *link;
+		unsigned int bits = 0;
+
+		jtag_optimize_stats.commands++;
+
+		if (jtag_optimize_is_noop(cmd, state, &bits)
+				|| (prev && jtag_optimize_merge(prev, cmd, &bits))) {
+			jtag_command_queue_unlink(link);
+			jtag_optimize_stats.commands_removed++;
+			jtag_optimize_stats.bits_saved += bits;
+			continue;
+		}
+
+		state = jtag_optimize_end_state(cmd, state);
+		prev = cmd;
+		link = &cmd->next;
+	}
+}
+
+/** Count the commands and TCK cycles of the queue for the flush statistics. */
+static unsigned int jtag_queue_size(uint64_t *bits)
+{
+	unsigned int commands = 0;
+
+	*bits = 0;
+	for (struct jtag_command *cmd = jtag_command_queue; cmd; cmd = cmd->next) {
+		commands++;
+		switch (cmd->type) {
+		case JTAG_SCAN:
+			*bits += jtag_scan_size(cmd->cmd.scan);
+			break;
+		case JTAG_RUNTEST:
+			*bits += cmd->cmd.runtest->num_cycles;
+			break;
+		case JTAG_STABLECLOCKS:
+			*bits += cmd->cmd.stableclocks->num_cycles;
+			break;
+		case JTAG_PATHMOVE:
+			*bits += cmd->cmd.pathmove->num_states;
+			break;
+		case JTAG_TMS:
+			*bits += cmd->cmd.tms->num_bits;
+			break;
+		default:
+			break;
+		}
+	}
+
+	return commands;
+}
+
 int default_interface_jtag_execute_queue(void)
 {
 	if (!is_adapter_initialized()) {
@@ -951,10 +1288,20 @@ int default_interface_jtag_execute_queue(void)
 			return ERROR_OK;
 	}
 
+	if (jtag_optimize)
+		jtag_optimize_queue();
+
+	uint64_t bits;
+	unsigned int commands = jtag_queue_size(&bits);
+	int64_t start = timeval_us();
+
 	int result = adapter_driver->jtag_ops->execute_queue();
 
+	adapter_stats_flush(ADAPTER_STATS_JTAG, start, commands, bits, result);
+	adapter_record_jtag(jtag_command_queue, result, timeval_us() - start);
+
 	struct jtag_command *cmd = jtag_command_queue;
-	while (debug_level >= LOG_LVL_DEBUG_IO && cmd) {
+	while (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO) && cmd) {
 		switch (cmd->type) {
 			case JTAG_SCAN:
 				LOG_DEBUG_IO("JTAG %s SCAN to %s",
@@ -1018,7 +1365,21 @@ int default_interface_jtag_execute_queue(void)
 void jtag_execute_queue_noclear(void)
 {
 	jtag_flush_queue_count++;
-	jtag_set_error(interface_jtag_execute_queue());
+
+	int64_t begin = timeval_us();
+	int retval = interface_jtag_execute_queue();
+	event_trace_end(EVENT_TRACE_JTAG_EXECUTE_QUEUE, begin, 0, 0,
+			jtag_flush_queue_count, retval);
+	metric_histogram_add(&jtag_execute_queue_metric, timeval_us() - begin);
+	if (retval != ERROR_OK)
+		metric_add(&jtag_execute_queue_errors, 1);
+	/* the table went away with the queue */
+	jtag_check_table = NULL;
+	if (retval != ERROR_OK) {
+		/* don't trust any instruction that was queued */
+		jtag_ir_cache_invalidate();
+	}
+	jtag_set_error(retval);
 
 	if (jtag_flush_queue_sleep > 0) {
 		/* For debug purposes it can be useful to test performance
@@ -1029,6 +1390,48 @@ void jtag_execute_queue_noclear(void)
 	}
 }
 
+/* @returns True if nothing in the queue has to be read back by the caller */
+static bool jtag_queue_results_unneeded(void)
+{
+	if (interface_jtag_has_callbacks())
+		return false;
+
+	for (struct jtag_command *cmd = jtag_command_queue; cmd; cmd = cmd->next) {
+		if (cmd->type != JTAG_SCAN)
+			continue;
+		if (jtag_scan_type(cmd->cmd.scan) & SCAN_IN)
+			return false;
+	}
+
+	return true;
+}
+
+int jtag_execute_queue_posted(void)
+{
+	if (!jtag_pipeline || !jtag_command_queue
+			|| !transport_is_jtag()
+			|| !(adapter_driver->jtag_ops->supported & DEBUG_CAP_QUEUE_ASYNC)
+			|| !jtag_queue_results_unneeded())
+		return jtag_error;
+
+	jtag_posted = true;
+	jtag_posted_count++;
+	jtag_execute_queue_noclear();
+	jtag_posted = false;
+
+	return jtag_error;
+}
+
+bool jtag_queue_is_posted(void)
+{
+	return jtag_posted;
+}
+
+uint64_t jtag_get_posted_queue_count(void)
+{
+	return jtag_posted_count;
+}
+
 int jtag_get_flush_queue_count(void)
 {
 	return jtag_flush_queue_count;
@@ -1050,6 +1453,10 @@ static int jtag_reset_callback(enum jtag_event event, void *priv)
 		/* current instruction is either BYPASS or IDCODE */
 		buf_set_ones(tap->cur_instr, tap->ir_length);
 		tap->bypass = 1;
+		tap->ir_cache_valid = false;
+	} else if (event == JTAG_TAP_EVENT_ENABLE || event == JTAG_TAP_EVENT_DISABLE) {
+		/* the scan chain has changed */
+		tap->ir_cache_valid = false;
 	}
 
 	return ERROR_OK;
@@ -1266,6 +1673,7 @@ static int jtag_examine_chain(void)
 				goto out;
 			}
 
+			jtag_chain_autoprobed = true;
 			tap->chip = alloc_printf("auto%u", autocount++);
 			tap->tapname = strdup("tap");
 			tap->dotted_name = alloc_printf("%s.%s", tap->chip, tap->tapname);
@@ -1500,6 +1908,180 @@ void jtag_tap_free(struct jtag_tap *tap)
 	free(tap);
 }
 
+/* Number of leading scan chain bits compared against the cache */
+#define JTAG_CHAIN_CACHE_PROBE_BITS 32
+
+static char *jtag_chain_cache_key(void)
+{
+	const char *serial = adapter_get_required_serial();
+
+	return alloc_printf("%s %s", adapter_driver->name, serial ? serial : "-");
+}
+
+/**
+ * Read the scan chain cache. It is only valid if it was written for the
+ * same adapter and lists exactly the enabled TAPs, with the same names and
+ * IR lengths. @returns an array of IDCODEs, 0 for a TAP without IDCODE.
+ */
+static uint32_t *jtag_chain_cache_load(void)
+{
+	unsigned int count = jtag_tap_count_enabled();
+	if (!count)
+		return NULL;
+
+	FILE *f = fopen(jtag_chain_cache_file, "r");
+	if (!f) {
+		LOG_DEBUG("no scan chain cache in %s", jtag_chain_cache_file);
+		return NULL;
+	}
+
+	char *key = jtag_chain_cache_key();
+	uint32_t *idcodes = calloc(count, sizeof(*idcodes));
+	struct jtag_tap *tap = NULL;
+	unsigned int n = 0;
+	bool adapter_match = false;
+	bool valid = key && idcodes;
+	char line[256];
+
+	while (valid && fgets(line, sizeof(line), f)) {
+		char name[128];
+		unsigned int ir_length;
+		uint32_t idcode;
+
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '#' || line[0] == '\0')
+			continue;
+
+		if (!strncmp(line, "adapter ", 8)) {
+			adapter_match = !strcmp(line + 8, key);
+		} else if (sscanf(line, "tap %127s %u 0x%" SCNx32, name, &ir_length, &idcode) == 3) {
+			tap = jtag_tap_next_enabled(tap);
+			valid = tap && !strcmp(tap->dotted_name, name)
+				&& (unsigned int)tap->ir_length == ir_length;
+			if (valid)
+				idcodes[n++] = idcode;
+		} else {
+			valid = false;
+		}
+	}
+
+	fclose(f);
+	free(key);
+
+	if (!valid || !adapter_match || n != count) {
+		LOG_INFO("scan chain cache %s does not match the configuration",
+			jtag_chain_cache_file);
+		free(idcodes);
+		return NULL;
+	}
+
+	return idcodes;
+}
+
+/**
+ * Take the scan chain from the cache instead of examining it. The first
+ * bits of the DR chain are compared with what the cached TAPs would shift
+ * out, and all TAPs are put in BYPASS as jtag_validate_ircapture() does.
+ * On any mismatch the chain is reset for a full examination.
+ */
+static int jtag_chain_cache_probe(void)
+{
+	uint32_t *idcodes = jtag_chain_cache_load();
+	if (!idcodes)
+		return ERROR_FAIL;
+
+	uint8_t expected[DIV_ROUND_UP(JTAG_CHAIN_CACHE_PROBE_BITS, 8)];
+	uint8_t out[sizeof(expected)];
+	uint8_t in[sizeof(expected)];
+	unsigned int pos = 0;
+	unsigned int i = 0;
+	int total_ir_length = 0;
+	struct jtag_tap *tap;
+
+	buf_set_ones(expected, JTAG_CHAIN_CACHE_PROBE_BITS);
+	buf_set_ones(out, JTAG_CHAIN_CACHE_PROBE_BITS);
+	for (tap = jtag_tap_next_enabled(NULL); tap; tap = jtag_tap_next_enabled(tap), i++) {
+		if (pos < JTAG_CHAIN_CACHE_PROBE_BITS) {
+			if (idcodes[i]) {
+				buf_set_u32(expected, pos, MIN(32, JTAG_CHAIN_CACHE_PROBE_BITS - pos),
+					idcodes[i]);
+				pos += 32;
+			} else {
+				buf_set_u32(expected, pos, 1, 0);
+				pos++;
+			}
+		}
+		total_ir_length += tap->ir_length;
+	}
+
+	uint8_t *ir_ones = malloc(DIV_ROUND_UP(total_ir_length, 8));
+	if (!ir_ones) {
+		free(idcodes);
+		return ERROR_FAIL;
+	}
+	buf_set_ones(ir_ones, total_ir_length);
+
+	jtag_add_plain_dr_scan(JTAG_CHAIN_CACHE_PROBE_BITS, out, in, TAP_IDLE);
+	jtag_add_plain_ir_scan(total_ir_length, ir_ones, NULL, TAP_IDLE);
+	int retval = jtag_execute_queue();
+	free(ir_ones);
+
+	if (retval == ERROR_OK && buf_cmp(in, expected, JTAG_CHAIN_CACHE_PROBE_BITS)) {
+		LOG_INFO("JTAG scan chain differs from the cache, examining it");
+		retval = ERROR_FAIL;
+	}
+
+	if (retval != ERROR_OK) {
+		free(idcodes);
+		jtag_add_tlr();
+		jtag_execute_queue();
+		return ERROR_FAIL;
+	}
+
+	i = 0;
+	for (tap = jtag_tap_next_enabled(NULL); tap; tap = jtag_tap_next_enabled(tap), i++) {
+		tap->hasidcode = idcodes[i] != 0;
+		tap->idcode = idcodes[i];
+		if (tap->hasidcode)
+			jtag_examine_chain_display(LOG_LVL_INFO, "tap/device cached",
+				tap->dotted_name, tap->idcode);
+		else
+			LOG_INFO("TAP %s does not have valid IDCODE (cached)", tap->dotted_name);
+	}
+
+	free(idcodes);
+	return ERROR_OK;
+}
+
+/** Record the examined scan chain, unless it contains autoprobed TAPs. */
+static void jtag_chain_cache_save(void)
+{
+	if (jtag_chain_autoprobed) {
+		LOG_DEBUG("not caching a scan chain with undeclared TAPs");
+		return;
+	}
+
+	char *key = jtag_chain_cache_key();
+	FILE *f = fopen(jtag_chain_cache_file, "w");
+	if (!key || !f) {
+		LOG_WARNING("unable to write the scan chain cache %s", jtag_chain_cache_file);
+		free(key);
+		if (f)
+			fclose(f);
+		return;
+	}
+
+	fprintf(f, "# OpenOCD scan chain cache, written by 'jtag chain_cache'\n");
+	fprintf(f, "adapter %s\n", key);
+	for (struct jtag_tap *tap = jtag_tap_next_enabled(NULL); tap; tap = jtag_tap_next_enabled(tap))
+		fprintf(f, "tap %s %d 0x%08" PRIx32 "\n", tap->dotted_name, tap->ir_length,
+			tap->hasidcode ? tap->idcode : 0);
+
+	if (fclose(f))
+		LOG_WARNING("unable to write the scan chain cache %s", jtag_chain_cache_file);
+	free(key);
+}
+
 int jtag_init_inner(struct command_context *cmd_ctx)
 {
 	struct jtag_tap *tap;
@@ -1532,6 +2114,12 @@ int jtag_init_inner(struct command_context *cmd_ctx)
 	if (retval != ERROR_OK)
 		return retval;
 
+	if (jtag_chain_cache_file && jtag_chain_cache_probe() == ERROR_OK) {
+		LOG_INFO("JTAG scan chain matches the cache, skipping its examination");
+		jtag_notify_event(JTAG_TAP_EVENT_SETUP);
+		return ERROR_OK;
+	}
+
 	/* Examine DR values first.  This discovers problems which will
 	 * prevent communication ... hardware issues like TDO stuck, or
 	 * configuring the wrong number of (enabled) TAPs.
@@ -1571,10 +2159,13 @@ int jtag_init_inner(struct command_context *cmd_ctx)
 		issue_setup = false;
 	}
 
-	if (issue_setup)
+	if (issue_setup) {
+		if (jtag_chain_cache_file)
+			jtag_chain_cache_save();
 		jtag_notify_event(JTAG_TAP_EVENT_SETUP);
-	else
+	} else {
 		LOG_WARNING("Bypassing JTAG setup events due to errors");
+	}
 
 
 	return ERROR_OK;
@@ -1707,6 +2298,60 @@ bool jtag_will_verify_capture_ir(void)
 	return jtag_verify_capture_ir;
 }
 
+void jtag_set_pipeline(bool enable)
+{
+	jtag_pipeline = enable;
+}
+
+bool jtag_will_pipeline(void)
+{
+	return jtag_pipeline;
+}
+
+void jtag_set_chain_cache(const char *filename)
+{
+	free(jtag_chain_cache_file);
+	jtag_chain_cache_file = filename ? strdup(filename) : NULL;
+}
+
+const char *jtag_get_chain_cache(void)
+{
+	return jtag_chain_cache_file;
+}
+
+void jtag_set_ir_cache(bool enable)
+{
+	jtag_ir_cache = enable;
+	if (!enable)
+		jtag_ir_cache_invalidate();
+}
+
+bool jtag_will_ir_cache(void)
+{
+	return jtag_ir_cache;
+}
+
+void jtag_get_ir_cache_stats(uint64_t *hits, uint64_t *misses)
+{
+	*hits = jtag_ir_cache_hits;
+	*misses = jtag_ir_cache_misses;
+}
+
+void jtag_set_optimize(bool enable)
+{
+	jtag_optimize = enable;
+}
+
+bool jtag_will_optimize(void)
+{
+	return jtag_optimize;
+}
+
+void jtag_get_optimize_stats(struct jtag_optimize_stats *stats)
+{
+	*stats = jtag_optimize_stats;
+}
+
 int jtag_power_dropout(int *dropout)
 {
 	if (!is_adapter_initialized()) {
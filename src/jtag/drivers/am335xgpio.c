@@ -224,6 +224,63 @@ static int am335xgpio_write(int tck, int tms, int tdi)
 	return ERROR_OK;
 }
 
+/* The fast scan loop drives TCK, TMS and TDI with single register writes */
+static bool am335xgpio_jtag_fast_mode_possible(void)
+{
+	const struct adapter_gpio_config *tck = &adapter_gpio_config[ADAPTER_GPIO_IDX_TCK];
+	const struct adapter_gpio_config *tms = &adapter_gpio_config[ADAPTER_GPIO_IDX_TMS];
+	const struct adapter_gpio_config *tdi = &adapter_gpio_config[ADAPTER_GPIO_IDX_TDI];
+
+	return tck->drive == ADAPTER_GPIO_DRIVE_MODE_PUSH_PULL
+		&& tms->drive == ADAPTER_GPIO_DRIVE_MODE_PUSH_PULL
+		&& tdi->drive == ADAPTER_GPIO_DRIVE_MODE_PUSH_PULL
+		&& tms->chip_num == tck->chip_num
+		&& tdi->chip_num == tck->chip_num;
+}
+
+static int am335xgpio_scan_word(uint32_t tms, uint32_t tdi, uint32_t *tdo, unsigned int num_bits)
+{
+	const struct adapter_gpio_config *tck_config = &adapter_gpio_config[ADAPTER_GPIO_IDX_TCK];
+	const struct adapter_gpio_config *tms_config = &adapter_gpio_config[ADAPTER_GPIO_IDX_TMS];
+	const struct adapter_gpio_config *tdi_config = &adapter_gpio_config[ADAPTER_GPIO_IDX_TDI];
+	const struct adapter_gpio_config *tdo_config = &adapter_gpio_config[ADAPTER_GPIO_IDX_TDO];
+	const int chip = tck_config->chip_num;
+	const uint32_t tck_mask = BIT(tck_config->gpio_num);
+	/* TCK low, and TCK high, output levels */
+	const uint32_t tck_low_set = tck_config->active_low ? tck_mask : 0;
+	const uint32_t tck_low_clear = tck_mask ^ tck_low_set;
+	uint32_t in = 0;
+
+	if (tms_config->active_low)
+		tms = ~tms;
+	if (tdi_config->active_low)
+		tdi = ~tdi;
+
+	for (unsigned int i = 0; i < num_bits; i++) {
+		uint32_t high = ((tms >> i) & 1) << tms_config->gpio_num |
+				((tdi >> i) & 1) << tdi_config->gpio_num;
+		uint32_t low = (BIT(tms_config->gpio_num) | BIT(tdi_config->gpio_num)) & ~high;
+
+		AM335XGPIO_WRITE_REG(chip, AM335XGPIO_GPIO_SETDATAOUT_OFFSET, high | tck_low_set);
+		AM335XGPIO_WRITE_REG(chip, AM335XGPIO_GPIO_CLEARDATAOUT_OFFSET, low | tck_low_clear);
+		for (unsigned int j = 0; j < jtag_delay; ++j)
+			asm volatile ("");
+
+		if (tdo)
+			in |= (uint32_t)get_gpio_value(tdo_config) << i;
+
+		AM335XGPIO_WRITE_REG(chip, tck_low_set ? AM335XGPIO_GPIO_CLEARDATAOUT_OFFSET :
+				AM335XGPIO_GPIO_SETDATAOUT_OFFSET, tck_mask);
+		for (unsigned int j = 0; j < jtag_delay; ++j)
+			asm volatile ("");
+	}
+
+	if (tdo)
+		*tdo = in;
+
+	return ERROR_OK;
+}
+
 static int am335xgpio_swd_write(int swclk, int swdio)
 {
 	set_gpio_value(&adapter_gpio_config[ADAPTER_GPIO_IDX_SWDIO], swdio);
@@ -433,6 +490,13 @@ static int am335xgpio_init(void)
 		initialize_gpio(ADAPTER_GPIO_IDX_TMS);
 		initialize_gpio(ADAPTER_GPIO_IDX_TCK);
 		initialize_gpio(ADAPTER_GPIO_IDX_TRST);
+
+		if (am335xgpio_jtag_fast_mode_possible()) {
+			LOG_DEBUG("am335xgpio using fast mode for JTAG scans");
+			am335xgpio_bitbang.scan_word = am335xgpio_scan_word;
+		} else {
+			am335xgpio_bitbang.scan_word = NULL;
+		}
 	}
 
 	if (transport_is_swd()) {
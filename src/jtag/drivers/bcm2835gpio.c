@@ -189,6 +189,41 @@ static int bcm2835gpio_write(int tck, int tms, int tdi)
 	return ERROR_OK;
 }
 
+/* Same levels and timing as bcm2835gpio_write(), without a call per edge */
+static int bcm2835gpio_scan_word(uint32_t tms, uint32_t tdi, uint32_t *tdo, unsigned int num_bits)
+{
+	const uint32_t tck_mask = 1 << adapter_gpio_config[ADAPTER_GPIO_IDX_TCK].gpio_num;
+	const unsigned int tms_shift = adapter_gpio_config[ADAPTER_GPIO_IDX_TMS].gpio_num;
+	const unsigned int tdi_shift = adapter_gpio_config[ADAPTER_GPIO_IDX_TDI].gpio_num;
+	const unsigned int tdo_shift = adapter_gpio_config[ADAPTER_GPIO_IDX_TDO].gpio_num;
+	uint32_t in = 0;
+
+	for (unsigned int i = 0; i < num_bits; i++) {
+		uint32_t tms_bit = (tms >> i) & 1;
+		uint32_t tdi_bit = (tdi >> i) & 1;
+
+		GPIO_SET = tms_bit << tms_shift | tdi_bit << tdi_shift;
+		GPIO_CLR = tck_mask | !tms_bit << tms_shift | !tdi_bit << tdi_shift;
+		bcm2835_gpio_synchronize();
+		bcm2835_delay();
+
+		if (tdo)
+			in |= ((GPIO_LEV >> tdo_shift) & 1) << i;
+
+		GPIO_SET = tck_mask;
+		bcm2835_gpio_synchronize();
+		bcm2835_delay();
+	}
+
+	if (tdo) {
+		if (adapter_gpio_config[ADAPTER_GPIO_IDX_TDO].active_low)
+			in = ~in;
+		*tdo = in;
+	}
+
+	return ERROR_OK;
+}
+
 /* Requires push-pull drive mode for swclk and swdio */
 static int bcm2835gpio_swd_write_fast(int swclk, int swdio)
 {
@@ -386,6 +421,7 @@ static int bcm2835gpio_blink(int on)
 static struct bitbang_interface bcm2835gpio_bitbang = {
 	.read = bcm2835gpio_read,
 	.write = bcm2835gpio_write,
+	.scan_word = bcm2835gpio_scan_word,
 	.swdio_read = bcm2835_swdio_read,
 	.swdio_drive = bcm2835_swdio_drive,
 	.swd_write = bcm2835gpio_swd_write_generic,
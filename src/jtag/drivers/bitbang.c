@@ -16,6 +16,8 @@
 #endif
 
 #include "bitbang.h"
+#include <helper/binarybuffer.h>
+#include <helper/bits.h>
 #include <jtag/interface.h>
 #include <jtag/commands.h>
 
@@ -92,7 +94,17 @@ static int bitbang_execute_tms(struct jtag_command *cmd)
 	LOG_DEBUG_IO("TMS: %d bits", num_bits);
 
 	int tms = 0;
-	for (unsigned i = 0; i < num_bits; i++) {
+	unsigned int i = 0;
+	if (bitbang_interface->scan_word) {
+		for (; i < num_bits; i += 32) {
+			unsigned int n = MIN(num_bits - i, 32);
+			uint32_t tms_word = buf_get_u32(bits, i, n);
+			if (bitbang_interface->scan_word(tms_word, 0, NULL, n) != ERROR_OK)
+				return ERROR_FAIL;
+			tms = (tms_word >> (n - 1)) & 1;
+		}
+	}
+	for (; i < num_bits; i++) {
 		tms = ((bits[i/8] >> (i % 8)) & 1);
 		if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
 			return ERROR_FAIL;
@@ -155,7 +167,13 @@ static int bitbang_runtest(int num_cycles)
 	}
 
 	/* execute num_cycles */
-	for (i = 0; i < num_cycles; i++) {
+	i = 0;
+	if (bitbang_interface->scan_word) {
+		for (; i < num_cycles; i += 32)
+			if (bitbang_interface->scan_word(0, 0, NULL, MIN(num_cycles - i, 32)) != ERROR_OK)
+				return ERROR_FAIL;
+	}
+	for (; i < num_cycles; i++) {
 		if (bitbang_interface->write(0, 0, 0) != ERROR_OK)
 			return ERROR_FAIL;
 		if (bitbang_interface->write(1, 0, 0) != ERROR_OK)
@@ -189,6 +207,25 @@ static int bitbang_stableclocks(int num_cycles)
 	return ERROR_OK;
 }
 
+/* Shift a whole scan with the scan_word() hook, TMS is raised on the last bit */
+static int bitbang_scan_words(enum scan_type type, uint8_t *buffer, unsigned int scan_size)
+{
+	for (unsigned int bit_cnt = 0; bit_cnt < scan_size; bit_cnt += 32) {
+		unsigned int n = MIN(scan_size - bit_cnt, 32);
+		uint32_t tms = (bit_cnt + n == scan_size) ? BIT(n - 1) : 0;
+		uint32_t tdi = (type != SCAN_IN) ? buf_get_u32(buffer, bit_cnt, n) : 0;
+		uint32_t tdo;
+
+		if (bitbang_interface->scan_word(tms, tdi, type != SCAN_OUT ? &tdo : NULL, n) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (type != SCAN_OUT)
+			buf_set_u32(buffer, bit_cnt, n, tdo);
+	}
+
+	return ERROR_OK;
+}
+
 static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		unsigned scan_size)
 {
@@ -208,8 +245,17 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		bitbang_end_state(saved_end_state);
 	}
 
+	if (bitbang_interface->scan_word) {
+		if (bitbang_scan_words(type, buffer, scan_size) != ERROR_OK)
+			return ERROR_FAIL;
+		/* skip the bit by bit loop */
+		bit_cnt = scan_size;
+	} else {
+		bit_cnt = 0;
+	}
+
 	size_t buffered = 0;
-	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
+	for (; bit_cnt < scan_size; bit_cnt++) {
 		int tms = (bit_cnt == scan_size-1) ? 1 : 0;
 		int tdi;
 		int bytec = bit_cnt/8;
@@ -43,6 +43,13 @@ struct bitbang_interface {
 	/** Set TCK, TMS, and TDI to the given values. */
 	int (*write)(int tck, int tms, int tdi);
 
+	/** Clock num_bits (1 to 32) TCK cycles, LSB first, the same way as
+	 * write(0, tms, tdi) followed by write(1, tms, tdi) for each bit. When
+	 * tdo is not NULL, TDO is sampled between the two writes and returned
+	 * in it. Optional, it lets drivers with memory-mapped GPIOs run a
+	 * tight loop instead of calling write() and read() per bit. */
+	int (*scan_word)(uint32_t tms, uint32_t tdi, uint32_t *tdo, unsigned int num_bits);
+
 	/** Blink led (optional). */
 	int (*blink)(int on);
 
@@ -165,6 +165,9 @@ static bool swd_mode;
  * Prevent using it until we have at least r/w operations. */
 #define CMD_DAP_TFER_BLOCK_MIN_OPS 4
 
+/* Atomic Commands */
+#define CMD_DAP_EXECUTE_COMMANDS  0x7F
+
 /* DAP Status Code */
 #define DAP_OK                    0
 #define DAP_ERROR                 0xFF
@@ -230,17 +233,34 @@ static unsigned int pending_queue_len;
 static unsigned int tfer_max_command_size;
 static unsigned int tfer_max_response_size;
 
-/* pointers to buffers that will receive jtag scan results on the next flush */
-#define MAX_PENDING_SCAN_RESULTS 256
+/* Split mixed SWD transfer sequences into DAP_Transfer and DAP_TransferBlock
+ * commands packed into one DAP_ExecuteCommands packet, if the probe supports it */
+static bool tfer_plan_enabled = true;
+
+/* Read SWO trace from the streaming endpoint instead of DAP_SWO_Data
+ * if both the probe and the backend support it */
+static bool swo_streaming_enabled = true;
+static bool tfer_plan;
+
+/* A run of queued transfers encoded as one DAP_Transfer or DAP_TransferBlock */
+struct tfer_segment {
+	unsigned int first;
+	unsigned int count;
+	bool block;
+};
+
+/* pointers to buffers that will receive jtag scan results on the next flush,
+ * sized by the number of TDO capturing sequences that fit into one packet */
+static unsigned int max_pending_scan_results;
 static int pending_scan_result_count;
-static struct pending_scan_result pending_scan_results[MAX_PENDING_SCAN_RESULTS];
+static struct pending_scan_result *pending_scan_results;
 
 /* queued JTAG sequences that will be executed on the next flush */
 #define QUEUED_SEQ_BUF_LEN (cmsis_dap_handle->packet_usable_size - 3)
 static int queued_seq_count;
 static int queued_seq_buf_end;
 static int queued_seq_tdo_ptr;
-static uint8_t queued_seq_buf[1024]; /* TODO: make dynamic / move into cmsis object */
+static uint8_t *queued_seq_buf;
 
 static int queued_retval;
 
@@ -750,47 +770,131 @@ static int cmsis_dap_cmd_dap_swo_data(
 }
 
 
-static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
+static unsigned int cmsis_dap_tfer_cmd_size(unsigned int write_count,
+							unsigned int read_count, bool block_tfer)
 {
-	uint8_t *command = dap->command;
-	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_put_idx];
+	unsigned int size;
+	if (block_tfer) {
+		size = 5;						/* DAP_TransferBlock header */
+		size += write_count * 4;		/* data */
+	} else {
+		size = 3;						/* DAP_Transfer header */
+		size += write_count * (1 + 4);	/* DAP register + data */
+		size += read_count;				/* DAP register */
+	}
+	return size;
+}
 
-	assert(dap->write_count + dap->read_count == block->transfer_count);
+static unsigned int cmsis_dap_tfer_resp_size(unsigned int write_count,
+							unsigned int read_count, bool block_tfer)
+{
+	unsigned int size;
+	if (block_tfer)
+		size = 4;						/* DAP_TransferBlock response header */
+	else
+		size = 3;						/* DAP_Transfer response header */
 
-	/* Reset packet size check counters for the next packet */
-	dap->write_count = 0;
-	dap->read_count = 0;
+	size += read_count * 4;				/* data */
+	return size;
+}
 
-	LOG_DEBUG_IO("Executing %d queued transactions from FIFO index %u%s",
-				 block->transfer_count, dap->pending_fifo_put_idx,
-				 cmsis_dap_handle->swd_cmds_differ ? "" : ", same swd ops");
+/* SWD command of the count queued transfers, the one past the end is next_cmd */
+static uint8_t cmsis_dap_tfer_cmd_at(const struct pending_request_block *block,
+		unsigned int i, uint8_t next_cmd)
+{
+	return i < block->transfer_count ? block->transfers[i].cmd : next_cmd;
+}
 
-	if (queued_retval != ERROR_OK) {
-		LOG_DEBUG("Skipping due to previous errors: %d", queued_retval);
-		goto skip;
+static unsigned int cmsis_dap_tfer_run_len(const struct pending_request_block *block,
+		unsigned int count, unsigned int first, uint8_t next_cmd)
+{
+	uint8_t cmd = cmsis_dap_tfer_cmd_at(block, first, next_cmd);
+	unsigned int i = first + 1;
+
+	while (i < count && i - first < 65535 && cmsis_dap_tfer_cmd_at(block, i, next_cmd) == cmd)
+		i++;
+
+	return i - first;
+}
+
+/* Runs of at least CMD_DAP_TFER_BLOCK_MIN_OPS transfers of the same register
+ * become a DAP_TransferBlock, anything between them a DAP_Transfer */
+static void cmsis_dap_tfer_next_segment(const struct pending_request_block *block,
+		unsigned int count, unsigned int first, uint8_t next_cmd,
+		struct tfer_segment *seg)
+{
+	unsigned int run = cmsis_dap_tfer_run_len(block, count, first, next_cmd);
+
+	seg->first = first;
+	if (run >= CMD_DAP_TFER_BLOCK_MIN_OPS) {
+		seg->block = true;
+		seg->count = run;
+		return;
 	}
 
-	if (block->transfer_count == 0)
-		goto skip;
+	unsigned int i = first;
+	while (i < count && i - first < 255) {
+		run = cmsis_dap_tfer_run_len(block, count, i, next_cmd);
+		if (run >= CMD_DAP_TFER_BLOCK_MIN_OPS)
+			break;
+		i += MIN(run, 255 - (i - first));
+	}
+	seg->block = false;
+	seg->count = i - first;
+}
+
+/* Compute command and response sizes of the planned packet for count queued
+ * transfers, returns the number of segments */
+static unsigned int cmsis_dap_tfer_plan_size(const struct pending_request_block *block,
+		unsigned int count, uint8_t next_cmd,
+		unsigned int *cmd_size, unsigned int *resp_size)
+{
+	struct tfer_segment seg;
+	unsigned int segments = 0;
+
+	*cmd_size = 0;
+	*resp_size = 0;
+	for (unsigned int first = 0; first < count; first += seg.count) {
+		cmsis_dap_tfer_next_segment(block, count, first, next_cmd, &seg);
+
+		unsigned int read_count = 0;
+		for (unsigned int i = first; i < first + seg.count; i++)
+			if (cmsis_dap_tfer_cmd_at(block, i, next_cmd) & SWD_CMD_RNW)
+				read_count++;
+
+		*cmd_size += cmsis_dap_tfer_cmd_size(seg.count - read_count, read_count, seg.block);
+		*resp_size += cmsis_dap_tfer_resp_size(seg.count - read_count, read_count, seg.block);
+		segments++;
+	}
 
-	bool block_cmd = !cmsis_dap_handle->swd_cmds_differ
-					 && block->transfer_count >= CMD_DAP_TFER_BLOCK_MIN_OPS;
-	block->command = block_cmd ? CMD_DAP_TFER_BLOCK : CMD_DAP_TFER;
+	if (segments > 1) {
+		/* DAP_ExecuteCommands header */
+		*cmd_size += 2;
+		*resp_size += 2;
+	}
+
+	return segments;
+}
 
-	command[0] = block->command;
+/* Encode a segment of the queued transfers as DAP_Transfer or DAP_TransferBlock,
+ * returns the command length */
+static unsigned int cmsis_dap_swd_encode_tfer(const struct pending_request_block *block,
+		const struct tfer_segment *seg, uint8_t *command)
+{
+	command[0] = seg->block ? CMD_DAP_TFER_BLOCK : CMD_DAP_TFER;
 	command[1] = 0x00;	/* DAP Index */
 
 	unsigned int idx;
-	if (block_cmd) {
-		h_u16_to_le(&command[2], block->transfer_count);
+	if (seg->block) {
+		h_u16_to_le(&command[2], seg->count);
 		idx = 4;	/* The first transfer will store the common DAP register */
 	} else {
-		command[2] = block->transfer_count;
+		command[2] = seg->count;
 		idx = 3;
 	}
 
-	for (unsigned int i = 0; i < block->transfer_count; i++) {
-		struct pending_transfer_result *transfer = &(block->transfers[i]);
+	for (unsigned int i = 0; i < seg->count; i++) {
+		struct pending_transfer_result *transfer = &block->transfers[seg->first + i];
 		uint8_t cmd = transfer->cmd;
 		uint32_t data = transfer->data;
 
@@ -818,7 +922,7 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 			data &= ~CORUNDETECT;
 		}
 
-		if (!block_cmd || i == 0)
+		if (!seg->block || i == 0)
 			command[idx++] = (cmd >> 1) & 0x0f;
 
 		if (!(cmd & SWD_CMD_RNW)) {
@@ -827,6 +931,62 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 		}
 	}
 
+	return idx;
+}
+
+static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
+{
+	uint8_t *command = dap->command;
+	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_put_idx];
+
+	assert(dap->write_count + dap->read_count == block->transfer_count);
+
+	/* Reset packet size check counters for the next packet */
+	dap->write_count = 0;
+	dap->read_count = 0;
+
+	LOG_DEBUG_IO("Executing %d queued transactions from FIFO index %u%s",
+				 block->transfer_count, dap->pending_fifo_put_idx,
+				 cmsis_dap_handle->swd_cmds_differ ? "" : ", same swd ops");
+
+	if (queued_retval != ERROR_OK) {
+		LOG_DEBUG("Skipping due to previous errors: %d", queued_retval);
+		goto skip;
+	}
+
+	if (block->transfer_count == 0)
+		goto skip;
+
+	struct tfer_segment seg;
+	unsigned int idx;
+	if (tfer_plan) {
+		unsigned int cmd_size, resp_size;
+		unsigned int segments = cmsis_dap_tfer_plan_size(block, block->transfer_count,
+				0, &cmd_size, &resp_size);
+		if (segments > 1) {
+			command[0] = CMD_DAP_EXECUTE_COMMANDS;
+			command[1] = segments;
+			idx = 2;
+			for (unsigned int first = 0; first < block->transfer_count; first += seg.count) {
+				cmsis_dap_tfer_next_segment(block, block->transfer_count, first, 0, &seg);
+				idx += cmsis_dap_swd_encode_tfer(block, &seg, &command[idx]);
+			}
+			assert(idx == cmd_size);
+			block->command = CMD_DAP_EXECUTE_COMMANDS;
+		} else {
+			cmsis_dap_tfer_next_segment(block, block->transfer_count, 0, 0, &seg);
+			idx = cmsis_dap_swd_encode_tfer(block, &seg, command);
+			block->command = command[0];
+		}
+	} else {
+		seg.first = 0;
+		seg.count = block->transfer_count;
+		seg.block = !cmsis_dap_handle->swd_cmds_differ
+					&& block->transfer_count >= CMD_DAP_TFER_BLOCK_MIN_OPS;
+		idx = cmsis_dap_swd_encode_tfer(block, &seg, command);
+		block->command = command[0];
+	}
+
 	int retval = dap->backend->write(dap, idx, LIBUSB_TIMEOUT_MS);
 	if (retval < 0) {
 		queued_retval = retval;
@@ -846,64 +1006,46 @@ skip:
 	block->transfer_count = 0;
 }
 
-static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
+/* Check the response to one DAP_Transfer or DAP_TransferBlock and store
+ * the data read, *pidx is advanced past the response */
+static int cmsis_dap_swd_read_tfer_resp(const struct pending_request_block *block,
+		const struct tfer_segment *seg, const uint8_t *resp, unsigned int *pidx)
 {
-	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_get_idx];
-
-	if (dap->pending_fifo_block_count == 0)
-		LOG_ERROR("no pending write");
-
-	/* get reply */
-	int retval = dap->backend->read(dap, timeout_ms);
-	if (retval == ERROR_TIMEOUT_REACHED && timeout_ms < LIBUSB_TIMEOUT_MS)
-		return;
-
-	if (retval <= 0) {
-		LOG_DEBUG("error reading data");
-		queued_retval = ERROR_FAIL;
-		goto skip;
-	}
+	uint8_t command = seg->block ? CMD_DAP_TFER_BLOCK : CMD_DAP_TFER;
+	unsigned int idx = *pidx;
 
-	uint8_t *resp = dap->response;
-	if (resp[0] != block->command) {
+	if (resp[idx] != command) {
 		LOG_ERROR("CMSIS-DAP command mismatch. Expected 0x%x received 0x%" PRIx8,
-			block->command, resp[0]);
-		queued_retval = ERROR_FAIL;
-		goto skip;
+			command, resp[idx]);
+		return ERROR_FAIL;
 	}
 
 	unsigned int transfer_count;
-	unsigned int idx;
-	if (block->command == CMD_DAP_TFER_BLOCK) {
-		transfer_count = le_to_h_u16(&resp[1]);
-		idx = 3;
+	if (seg->block) {
+		transfer_count = le_to_h_u16(&resp[idx + 1]);
+		idx += 3;
 	} else {
-		transfer_count = resp[1];
-		idx = 2;
+		transfer_count = resp[idx + 1];
+		idx += 2;
 	}
 	if (resp[idx] & 0x08) {
-		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", transfer_count);
-		queued_retval = ERROR_FAIL;
-		goto skip;
+		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", seg->first + transfer_count);
+		return ERROR_FAIL;
 	}
 	uint8_t ack = resp[idx++] & 0x07;
 	if (ack != SWD_ACK_OK) {
-		LOG_DEBUG("SWD ack not OK @ %d %s", transfer_count,
+		LOG_DEBUG("SWD ack not OK @ %d %s", seg->first + transfer_count,
 			  ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK");
-		queued_retval = ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
 		/* TODO: use results of transfers completed before the error occurred? */
-		goto skip;
+		return ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
 	}
 
-	if (block->transfer_count != transfer_count)
+	if (seg->count != transfer_count)
 		LOG_ERROR("CMSIS-DAP transfer count mismatch: expected %d, got %d",
-			  block->transfer_count, transfer_count);
-
-	LOG_DEBUG_IO("Received results of %d queued transactions FIFO index %u timeout %i",
-		 transfer_count, dap->pending_fifo_get_idx, timeout_ms);
+			  seg->count, transfer_count);
 
 	for (unsigned int i = 0; i < transfer_count; i++) {
-		struct pending_transfer_result *transfer = &(block->transfers[i]);
+		struct pending_transfer_result *transfer = &block->transfers[seg->first + i];
 		if (transfer->cmd & SWD_CMD_RNW) {
 			static uint32_t last_read;
 			uint32_t data = le_to_h_u32(&resp[idx]);
@@ -924,6 +1066,60 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
 		}
 	}
 
+	*pidx = idx;
+	return ERROR_OK;
+}
+
+static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
+{
+	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_get_idx];
+
+	if (dap->pending_fifo_block_count == 0)
+		LOG_ERROR("no pending write");
+
+	/* get reply */
+	int retval = dap->backend->read(dap, timeout_ms);
+	if (retval == ERROR_TIMEOUT_REACHED && timeout_ms < LIBUSB_TIMEOUT_MS)
+		return;
+
+	if (retval <= 0) {
+		LOG_DEBUG("error reading data");
+		queued_retval = ERROR_FAIL;
+		goto skip;
+	}
+
+	uint8_t *resp = dap->response;
+	if (resp[0] != block->command) {
+		LOG_ERROR("CMSIS-DAP command mismatch. Expected 0x%x received 0x%" PRIx8,
+			block->command, resp[0]);
+		queued_retval = ERROR_FAIL;
+		goto skip;
+	}
+
+	LOG_DEBUG_IO("Received results of %d queued transactions FIFO index %u timeout %i",
+		 block->transfer_count, dap->pending_fifo_get_idx, timeout_ms);
+
+	struct tfer_segment seg;
+	unsigned int idx = 0;
+	if (block->command == CMD_DAP_EXECUTE_COMMANDS) {
+		idx = 2;
+		for (unsigned int first = 0; first < block->transfer_count; first += seg.count) {
+			cmsis_dap_tfer_next_segment(block, block->transfer_count, first, 0, &seg);
+			retval = cmsis_dap_swd_read_tfer_resp(block, &seg, resp, &idx);
+			if (retval != ERROR_OK) {
+				queued_retval = retval;
+				goto skip;
+			}
+		}
+	} else {
+		seg.first = 0;
+		seg.count = block->transfer_count;
+		seg.block = block->command == CMD_DAP_TFER_BLOCK;
+		retval = cmsis_dap_swd_read_tfer_resp(block, &seg, resp, &idx);
+		if (retval != ERROR_OK)
+			queued_retval = retval;
+	}
+
 skip:
 	block->transfer_count = 0;
 	dap->pending_fifo_get_idx = (dap->pending_fifo_get_idx + 1) % dap->packet_count;
@@ -949,34 +1145,6 @@ static int cmsis_dap_swd_run_queue(void)
 	return retval;
 }
 
-static unsigned int cmsis_dap_tfer_cmd_size(unsigned int write_count,
-							unsigned int read_count, bool block_tfer)
-{
-	unsigned int size;
-	if (block_tfer) {
-		size = 5;						/* DAP_TransferBlock header */
-		size += write_count * 4;		/* data */
-	} else {
-		size = 3;						/* DAP_Transfer header */
-		size += write_count * (1 + 4);	/* DAP register + data */
-		size += read_count;				/* DAP register */
-	}
-	return size;
-}
-
-static unsigned int cmsis_dap_tfer_resp_size(unsigned int write_count,
-							unsigned int read_count, bool block_tfer)
-{
-	unsigned int size;
-	if (block_tfer)
-		size = 4;						/* DAP_TransferBlock response header */
-	else
-		size = 3;						/* DAP_Transfer response header */
-
-	size += read_count * 4;				/* data */
-	return size;
-}
-
 static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 {
 	/* Compute sizes of the DAP Transfer command and the expected response
@@ -985,23 +1153,32 @@ static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 
 	unsigned int write_count = cmsis_dap_handle->write_count;
 	unsigned int read_count = cmsis_dap_handle->read_count;
-	bool block_cmd;
-	if (write_count + read_count < CMD_DAP_TFER_BLOCK_MIN_OPS)
-		block_cmd = false;
-	else
-		block_cmd = !cmsis_dap_handle->swd_cmds_differ
-					&& cmd == cmsis_dap_handle->common_swd_cmd;
+	struct pending_request_block *block = &cmsis_dap_handle->pending_fifo[cmsis_dap_handle->pending_fifo_put_idx];
+	unsigned int cmd_size, resp_size;
+	unsigned int max_transfer_count;
 
 	if (cmd & SWD_CMD_RNW)
 		read_count++;
 	else
 		write_count++;
 
-	unsigned int cmd_size = cmsis_dap_tfer_cmd_size(write_count, read_count,
-													block_cmd);
-	unsigned int resp_size = cmsis_dap_tfer_resp_size(write_count, read_count,
-													block_cmd);
-	unsigned int max_transfer_count = block_cmd ? 65535 : 255;
+	if (tfer_plan) {
+		unsigned int segments = cmsis_dap_tfer_plan_size(block, block->transfer_count + 1,
+				cmd, &cmd_size, &resp_size);
+		/* DAP_ExecuteCommands holds up to 255 commands */
+		max_transfer_count = segments > 255 ? 0 : pending_queue_len;
+	} else {
+		bool block_cmd;
+		if (write_count + read_count <= CMD_DAP_TFER_BLOCK_MIN_OPS)
+			block_cmd = false;
+		else
+			block_cmd = !cmsis_dap_handle->swd_cmds_differ
+						&& cmd == cmsis_dap_handle->common_swd_cmd;
+
+		cmd_size = cmsis_dap_tfer_cmd_size(write_count, read_count, block_cmd);
+		resp_size = cmsis_dap_tfer_resp_size(write_count, read_count, block_cmd);
+		max_transfer_count = block_cmd ? 65535 : 255;
+	}
 
 	/* Does the DAP Transfer command and the expected response fit into one packet?
 	 * Run the queue also before a targetsel - it cannot be queued */
@@ -1029,7 +1206,7 @@ static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 		return;
 	}
 
-	struct pending_request_block *block = &cmsis_dap_handle->pending_fifo[cmsis_dap_handle->pending_fifo_put_idx];
+	block = &cmsis_dap_handle->pending_fifo[cmsis_dap_handle->pending_fifo_put_idx];
 	struct pending_transfer_result *transfer = &(block->transfers[block->transfer_count]);
 	transfer->data = data;
 	transfer->cmd = cmd;
@@ -1227,6 +1404,31 @@ static int cmsis_dap_swd_switch_seq(enum swd_special_seq seq)
 	return cmsis_dap_cmd_dap_swj_clock(adapter_get_speed_khz());
 }
 
+/* DAP_ExecuteCommands is not reported by DAP_Info, ask the probe to wrap
+ * a harmless DAP_Info into it and see if it understood */
+static bool cmsis_dap_probe_execute_commands(void)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	uint8_t *command = dap->command;
+
+	command[0] = CMD_DAP_EXECUTE_COMMANDS;
+	command[1] = 1;
+	command[2] = CMD_DAP_INFO;
+	command[3] = INFO_ID_CAPS;
+
+	int retval = dap->backend->write(dap, 4, LIBUSB_TIMEOUT_MS);
+	if (retval < 0)
+		return false;
+
+	retval = dap->backend->read(dap, LIBUSB_TIMEOUT_MS);
+	if (retval < 0)
+		return false;
+
+	uint8_t *resp = dap->response;
+	return resp[0] == CMD_DAP_EXECUTE_COMMANDS && resp[1] == 1
+		&& resp[2] == CMD_DAP_INFO;
+}
+
 static int cmsis_dap_swd_open(void)
 {
 	if (!(cmsis_dap_handle->caps & INFO_CAPS_SWD)) {
@@ -1305,13 +1507,31 @@ static int cmsis_dap_init(void)
 		}
 	}
 
+	tfer_plan = swd_mode && tfer_plan_enabled && cmsis_dap_probe_execute_commands();
+	if (tfer_plan)
+		LOG_DEBUG("CMSIS-DAP: using DAP_ExecuteCommands for mixed transfers");
+
 	/* Maximal number of transfers which fit to one packet:
 	 * Limited by response size: 3 bytes of response header + 4 per read
-	 * Plus writes to full command size: 3 bytes cmd header + 1 per read + 5 per write */
+	 * Plus writes to full command size: 3 bytes cmd header + 1 per read + 5 per write,
+	 * or 4 per write if writes can be packed into DAP_TransferBlock */
 	tfer_max_command_size = cmsis_dap_handle->packet_usable_size;
 	tfer_max_response_size = cmsis_dap_handle->packet_usable_size;
 	unsigned int max_reads = tfer_max_response_size / 4;
-	pending_queue_len = max_reads + (tfer_max_command_size - max_reads) / 5;
+	if (tfer_plan)
+		pending_queue_len = max_reads + tfer_max_command_size / 4;
+	else
+		pending_queue_len = max_reads + (tfer_max_command_size - max_reads) / 5;
+
+	/* Every sequence capturing TDO takes at least 2 bytes */
+	max_pending_scan_results = MIN(255, QUEUED_SEQ_BUF_LEN / 2);
+	queued_seq_buf = malloc(QUEUED_SEQ_BUF_LEN);
+	pending_scan_results = malloc(max_pending_scan_results * sizeof(*pending_scan_results));
+	if (!queued_seq_buf || !pending_scan_results) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP JTAG queue");
+		retval = ERROR_FAIL;
+		goto init_err;
+	}
 	cmsis_dap_handle->write_count = 0;
 	cmsis_dap_handle->read_count = 0;
 
@@ -1404,6 +1624,12 @@ static int cmsis_dap_quit(void)
 
 	cmsis_dap_close(cmsis_dap_handle);
 
+	free(queued_seq_buf);
+	queued_seq_buf = NULL;
+	free(pending_scan_results);
+	pending_scan_results = NULL;
+	tfer_plan = false;
+
 	return ERROR_OK;
 }
 
@@ -1615,7 +1841,8 @@ static void cmsis_dap_add_jtag_sequence(unsigned int s_len, const uint8_t *seque
 	}
 
 	unsigned int cmd_len = 1 + DIV_ROUND_UP(s_len, 8);
-	if (queued_seq_count >= 255 || queued_seq_buf_end + cmd_len > QUEUED_SEQ_BUF_LEN)
+	if (queued_seq_count >= 255 || queued_seq_buf_end + cmd_len > QUEUED_SEQ_BUF_LEN
+			|| (tdo_buffer && (unsigned int)pending_scan_result_count >= max_pending_scan_results))
 		/* empty out the buffer */
 		cmsis_dap_flush();
 
@@ -1943,6 +2170,14 @@ static bool calculate_swo_prescaler(unsigned int traceclkin_freq,
 	return true;
 }
 
+static void cmsis_dap_swo_stream_stop(void)
+{
+	if (cmsis_dap_handle->trace_streaming) {
+		cmsis_dap_handle->backend->trace_stop(cmsis_dap_handle);
+		cmsis_dap_handle->trace_streaming = false;
+	}
+}
+
 /**
  * @see adapter_driver::config_trace
  */
@@ -1964,6 +2199,7 @@ static int cmsis_dap_config_trace(
 				return retval;
 			}
 		}
+		cmsis_dap_swo_stream_stop();
 		cmsis_dap_handle->trace_enabled = false;
 		LOG_INFO("SWO-trace disabled.");
 		return ERROR_OK;
@@ -1996,13 +2232,19 @@ static int cmsis_dap_config_trace(
 	if (retval != ERROR_OK)
 		return retval;
 
+	cmsis_dap_swo_stream_stop();
 	cmsis_dap_handle->trace_enabled = false;
 
 	retval = cmsis_dap_get_swo_buf_sz(&cmsis_dap_handle->swo_buf_sz);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = cmsis_dap_cmd_dap_swo_transport(DAP_SWO_TRANSPORT_DATA);
+	bool streaming = swo_streaming_enabled
+		&& (cmsis_dap_handle->caps & INFO_CAPS_SWO_STREAMING_TRACE)
+		&& cmsis_dap_handle->backend->trace_start;
+
+	retval = cmsis_dap_cmd_dap_swo_transport(streaming ? DAP_SWO_TRANSPORT_WINUSB
+		: DAP_SWO_TRANSPORT_DATA);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -2024,9 +2266,20 @@ static int cmsis_dap_config_trace(
 	LOG_INFO("SWO frequency: %u Hz.", *swo_freq);
 	LOG_INFO("SWO prescaler: %u.", *swo_prescaler);
 
+	if (streaming) {
+		/* Start reading before the capture to not miss any data */
+		retval = cmsis_dap_handle->backend->trace_start(cmsis_dap_handle);
+		if (retval != ERROR_OK)
+			return retval;
+		cmsis_dap_handle->trace_streaming = true;
+		LOG_INFO("SWO-trace streaming via the trace endpoint.");
+	}
+
 	retval = cmsis_dap_cmd_dap_swo_control(DAP_SWO_CONTROL_START);
-	if (retval != ERROR_OK)
+	if (retval != ERROR_OK) {
+		cmsis_dap_swo_stream_stop();
 		return retval;
+	}
 
 	cmsis_dap_handle->trace_enabled = true;
 
@@ -2046,6 +2299,10 @@ static int cmsis_dap_poll_trace(uint8_t *buf, size_t *size)
 		return ERROR_OK;
 	}
 
+	/* No need to poll the probe, the backend already collected the trace */
+	if (cmsis_dap_handle->trace_streaming)
+		return cmsis_dap_handle->backend->trace_read(cmsis_dap_handle, buf, size);
+
 	int retval = cmsis_dap_cmd_dap_swo_status(&trace_status, &trace_count);
 	if (retval != ERROR_OK)
 		return retval;
@@ -2105,6 +2362,35 @@ COMMAND_HANDLER(cmsis_dap_handle_cmd_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(cmsis_dap_handle_tfer_plan_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], tfer_plan_enabled);
+
+	command_print(CMD, "mixed transfer packing %s%s",
+		tfer_plan_enabled ? "enabled" : "disabled",
+		tfer_plan ? ", in use" : "");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_swo_streaming_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], swo_streaming_enabled);
+
+	command_print(CMD, "SWO trace streaming %s",
+		swo_streaming_enabled ? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(cmsis_dap_handle_vid_pid_command)
 {
 	if (CMD_ARGC > MAX_USB_IDS * 2) {
@@ -2172,6 +2458,21 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.usage = "",
 		.help = "issue cmsis-dap command",
 	},
+	{
+		.name = "tfer_plan",
+		.handler = &cmsis_dap_handle_tfer_plan_command,
+		.mode = COMMAND_CONFIG,
+		.usage = "['enable'|'disable']",
+		.help = "pack mixed SWD transfers into DAP_TransferBlock and "
+			"DAP_Transfer commands of one DAP_ExecuteCommands packet",
+	},
+	{
+		.name = "swo_streaming",
+		.handler = &cmsis_dap_handle_swo_streaming_command,
+		.mode = COMMAND_ANY,
+		.usage = "['enable'|'disable']",
+		.help = "read SWO trace from the streaming trace endpoint",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
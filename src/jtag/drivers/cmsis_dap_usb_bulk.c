@@ -28,18 +28,66 @@
 #include <libusb.h>
 #include <helper/log.h>
 #include <helper/replacements.h>
+#include <helper/time_support.h>
 
 #include "cmsis_dap.h"
+#include "libusb_helper.h"
+
+/* Compatibility define for older libusb-1.0 */
+#ifndef LIBUSB_CALL
+#define LIBUSB_CALL
+#endif
+
+/* One more than the driver may leave pending, for a command/response
+ * exchange issued while the FIFO is full */
+#define MAX_USB_SLOTS (MAX_PENDING_REQUESTS + 1)
+
+/* A command submitted to the probe and the transfer receiving its response */
+struct cmsis_dap_usb_slot {
+	struct libusb_transfer *out;
+	struct libusb_transfer *in;
+	uint8_t *out_buf;
+	uint8_t *in_buf;
+	int out_completed;
+	int in_completed;
+};
+
+/* Transfers kept in flight on the streaming SWO trace endpoint */
+#define SWO_TRANSFERS		4
+#define SWO_TRANSFER_SIZE	(16 * 1024)
+/* Host side buffer holding trace data until the next poll */
+#define SWO_BUFFER_SIZE		(1024 * 1024)
+
+struct cmsis_dap_usb_swo {
+	struct libusb_transfer *transfers[SWO_TRANSFERS];
+	uint8_t *buf;
+	/* free running ring buffer indexes */
+	size_t put_idx, get_idx;
+	size_t dropped;
+	unsigned int active;
+	bool stopping;
+	bool error;
+};
 
 struct cmsis_dap_backend_data {
 	struct libusb_context *usb_ctx;
 	struct libusb_device_handle *dev_handle;
 	unsigned int ep_out;
 	unsigned int ep_in;
+	unsigned int ep_swo;
 	int interface;
+
+	/* Streaming SWO trace, if the interface has the optional endpoint */
+	struct cmsis_dap_usb_swo swo;
+
+	/* Ring of commands in flight when using asynchronous transfers */
+	struct cmsis_dap_usb_slot slots[MAX_USB_SLOTS];
+	unsigned int slot_put_idx, slot_get_idx;
+	unsigned int slot_count;
 };
 
 static int cmsis_dap_usb_interface = -1;
+static bool cmsis_dap_usb_async = true;
 
 static void cmsis_dap_usb_close(struct cmsis_dap *dap);
 static int cmsis_dap_usb_alloc(struct cmsis_dap *dap, unsigned int pkt_sz);
@@ -313,6 +361,11 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t p
 			int packet_size = intf_desc_found->endpoint[0].wMaxPacketSize;
 			int ep_out = intf_desc_found->endpoint[0].bEndpointAddress;
 			int ep_in = intf_desc_found->endpoint[1].bEndpointAddress;
+			int ep_swo = 0;
+			if (intf_desc_found->bNumEndpoints >= 3 &&
+					(intf_desc_found->endpoint[2].bmAttributes & 3) == LIBUSB_TRANSFER_TYPE_BULK &&
+					(intf_desc_found->endpoint[2].bEndpointAddress & 0x80) == LIBUSB_ENDPOINT_IN)
+				ep_swo = intf_desc_found->endpoint[2].bEndpointAddress;
 
 			libusb_free_config_descriptor(config_desc);
 			libusb_free_device_list(device_list, true);
@@ -343,7 +396,7 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t p
 			if (err)
 				LOG_WARNING("could not claim interface: %s", libusb_strerror(err));
 
-			dap->bdata = malloc(sizeof(struct cmsis_dap_backend_data));
+			dap->bdata = calloc(1, sizeof(struct cmsis_dap_backend_data));
 			if (!dap->bdata) {
 				LOG_ERROR("unable to allocate memory");
 				libusb_release_interface(dev_handle, interface_num);
@@ -356,8 +409,19 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t p
 			dap->bdata->dev_handle = dev_handle;
 			dap->bdata->ep_out = ep_out;
 			dap->bdata->ep_in = ep_in;
+			dap->bdata->ep_swo = ep_swo;
 			dap->bdata->interface = interface_num;
 
+			for (unsigned int s = 0; s < MAX_USB_SLOTS && cmsis_dap_usb_async; s++) {
+				dap->bdata->slots[s].out = libusb_alloc_transfer(0);
+				dap->bdata->slots[s].in = libusb_alloc_transfer(0);
+				if (!dap->bdata->slots[s].out || !dap->bdata->slots[s].in) {
+					LOG_ERROR("unable to allocate USB transfers");
+					cmsis_dap_usb_close(dap);
+					return ERROR_FAIL;
+				}
+			}
+
 			err = cmsis_dap_usb_alloc(dap, packet_size);
 			if (err != ERROR_OK)
 				cmsis_dap_usb_close(dap);
@@ -374,8 +438,83 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t p
 	return ERROR_FAIL;
 }
 
+static LIBUSB_CALL void cmsis_dap_usb_transfer_cb(struct libusb_transfer *transfer)
+{
+	int *completed = transfer->user_data;
+
+	*completed = 1;
+}
+
+/* Handle USB events until *completed is set or timeout_ms elapsed,
+ * a zero timeout only processes the events already pending */
+static int cmsis_dap_usb_wait(struct cmsis_dap_backend_data *bdata, int *completed,
+		int timeout_ms)
+{
+	int64_t deadline = timeval_ms() + timeout_ms;
+
+	while (!*completed) {
+		int64_t remaining = deadline - timeval_ms();
+		if (remaining < 0)
+			remaining = 0;
+
+		struct timeval tv = {
+			.tv_sec = remaining / 1000,
+			.tv_usec = (remaining % 1000) * 1000,
+		};
+		int err = libusb_handle_events_timeout_completed(bdata->usb_ctx, &tv, completed);
+		if (err && err != LIBUSB_ERROR_INTERRUPTED) {
+			LOG_ERROR("error handling USB events: %s", libusb_strerror(err));
+			return ERROR_FAIL;
+		}
+
+		if (remaining == 0)
+			break;
+	}
+
+	return *completed ? ERROR_OK : ERROR_TIMEOUT_REACHED;
+}
+
+/* Cancel the oldest command in flight and forget about it */
+static void cmsis_dap_usb_drop_slot(struct cmsis_dap_backend_data *bdata)
+{
+	struct cmsis_dap_usb_slot *slot = &bdata->slots[bdata->slot_get_idx];
+
+	if (!slot->out_completed)
+		libusb_cancel_transfer(slot->out);
+	if (!slot->in_completed)
+		libusb_cancel_transfer(slot->in);
+	cmsis_dap_usb_wait(bdata, &slot->out_completed, LIBUSB_TIMEOUT_MS);
+	cmsis_dap_usb_wait(bdata, &slot->in_completed, LIBUSB_TIMEOUT_MS);
+
+	bdata->slot_get_idx = (bdata->slot_get_idx + 1) % MAX_USB_SLOTS;
+	bdata->slot_count--;
+}
+
+static void cmsis_dap_usb_free_slots(struct cmsis_dap_backend_data *bdata)
+{
+	while (bdata->slot_count)
+		cmsis_dap_usb_drop_slot(bdata);
+
+	for (unsigned int i = 0; i < MAX_USB_SLOTS; i++) {
+		struct cmsis_dap_usb_slot *slot = &bdata->slots[i];
+		free(slot->out_buf);
+		free(slot->in_buf);
+		slot->out_buf = NULL;
+		slot->in_buf = NULL;
+	}
+}
+
+static void cmsis_dap_usb_trace_stop(struct cmsis_dap *dap);
+
 static void cmsis_dap_usb_close(struct cmsis_dap *dap)
 {
+	cmsis_dap_usb_trace_stop(dap);
+	cmsis_dap_usb_free_slots(dap->bdata);
+	for (unsigned int i = 0; i < MAX_USB_SLOTS; i++) {
+		libusb_free_transfer(dap->bdata->slots[i].out);
+		libusb_free_transfer(dap->bdata->slots[i].in);
+	}
+
 	libusb_release_interface(dap->bdata->dev_handle, dap->bdata->interface);
 	libusb_close(dap->bdata->dev_handle);
 	libusb_exit(dap->bdata->usb_ctx);
@@ -385,7 +524,7 @@ static void cmsis_dap_usb_close(struct cmsis_dap *dap)
 	dap->packet_buffer = NULL;
 }
 
-static int cmsis_dap_usb_read(struct cmsis_dap *dap, int timeout_ms)
+static int cmsis_dap_usb_read_sync(struct cmsis_dap *dap, int timeout_ms)
 {
 	int transferred = 0;
 	int err;
@@ -406,7 +545,46 @@ static int cmsis_dap_usb_read(struct cmsis_dap *dap, int timeout_ms)
 	return transferred;
 }
 
-static int cmsis_dap_usb_write(struct cmsis_dap *dap, int txlen, int timeout_ms)
+static int cmsis_dap_usb_read(struct cmsis_dap *dap, int timeout_ms)
+{
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+
+	/* Nothing in flight, e.g. when draining stale responses */
+	if (!bdata->slot_count)
+		return cmsis_dap_usb_read_sync(dap, timeout_ms);
+
+	/* Responses come back in the order the commands were submitted */
+	struct cmsis_dap_usb_slot *slot = &bdata->slots[bdata->slot_get_idx];
+
+	int retval = cmsis_dap_usb_wait(bdata, &slot->in_completed, timeout_ms);
+	if (retval == ERROR_TIMEOUT_REACHED && timeout_ms == 0)
+		return retval;
+	if (retval == ERROR_OK)
+		retval = cmsis_dap_usb_wait(bdata, &slot->out_completed, LIBUSB_TIMEOUT_MS);
+	if (retval != ERROR_OK) {
+		cmsis_dap_usb_drop_slot(bdata);
+		return retval;
+	}
+
+	if (slot->out->status != LIBUSB_TRANSFER_COMPLETED) {
+		LOG_ERROR("error writing data: transfer status %d", slot->out->status);
+		retval = ERROR_FAIL;
+	} else if (slot->in->status != LIBUSB_TRANSFER_COMPLETED) {
+		LOG_ERROR("error reading data: transfer status %d", slot->in->status);
+		retval = ERROR_FAIL;
+	} else {
+		retval = slot->in->actual_length;
+		memcpy(dap->packet_buffer, slot->in_buf, retval);
+		memset(&dap->packet_buffer[retval], 0, dap->packet_buffer_size - retval);
+	}
+
+	bdata->slot_get_idx = (bdata->slot_get_idx + 1) % MAX_USB_SLOTS;
+	bdata->slot_count--;
+
+	return retval;
+}
+
+static int cmsis_dap_usb_write_sync(struct cmsis_dap *dap, int txlen, int timeout_ms)
 {
 	int transferred = 0;
 	int err;
@@ -426,6 +604,198 @@ static int cmsis_dap_usb_write(struct cmsis_dap *dap, int txlen, int timeout_ms)
 	return transferred;
 }
 
+/*
+ * Submit the command and, at the same time, the transfer receiving its
+ * response, so the probe never waits for the host to ask for a response
+ * while it holds further commands. The command is copied, the caller may
+ * reuse the packet buffer as soon as this returns.
+ */
+static int cmsis_dap_usb_write(struct cmsis_dap *dap, int txlen, int timeout_ms)
+{
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+
+	if (!cmsis_dap_usb_async)
+		return cmsis_dap_usb_write_sync(dap, txlen, timeout_ms);
+
+	if (bdata->slot_count == MAX_USB_SLOTS) {
+		LOG_ERROR("too many CMSIS-DAP commands in flight");
+		return ERROR_FAIL;
+	}
+
+	struct cmsis_dap_usb_slot *slot = &bdata->slots[bdata->slot_put_idx];
+	memcpy(slot->out_buf, dap->packet_buffer, txlen);
+	slot->out_completed = 0;
+	slot->in_completed = 0;
+
+	libusb_fill_bulk_transfer(slot->out, bdata->dev_handle, bdata->ep_out,
+		slot->out_buf, txlen, cmsis_dap_usb_transfer_cb, &slot->out_completed,
+		timeout_ms);
+	/* the response is waited for by cmsis_dap_usb_read() with its own timeout */
+	libusb_fill_bulk_transfer(slot->in, bdata->dev_handle, bdata->ep_in,
+		slot->in_buf, dap->packet_size, cmsis_dap_usb_transfer_cb, &slot->in_completed,
+		0);
+
+	int err = libusb_submit_transfer(slot->out);
+	if (err) {
+		LOG_ERROR("error writing data: %s", libusb_strerror(err));
+		return ERROR_FAIL;
+	}
+
+	err = libusb_submit_transfer(slot->in);
+	if (err) {
+		LOG_ERROR("error reading data: %s", libusb_strerror(err));
+		libusb_cancel_transfer(slot->out);
+		cmsis_dap_usb_wait(bdata, &slot->out_completed, LIBUSB_TIMEOUT_MS);
+		return ERROR_FAIL;
+	}
+
+	bdata->slot_put_idx = (bdata->slot_put_idx + 1) % MAX_USB_SLOTS;
+	bdata->slot_count++;
+
+	return txlen;
+}
+
+static LIBUSB_CALL void cmsis_dap_usb_swo_cb(struct libusb_transfer *transfer)
+{
+	struct cmsis_dap_usb_swo *swo = transfer->user_data;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+		size_t len = transfer->actual_length;
+		size_t room = SWO_BUFFER_SIZE - (swo->put_idx - swo->get_idx);
+		if (len > room) {
+			swo->dropped += len - room;
+			len = room;
+		}
+
+		/* copy in up to two pieces around the end of the ring */
+		for (size_t done = 0; done < len; ) {
+			size_t offset = swo->put_idx % SWO_BUFFER_SIZE;
+			size_t chunk = MIN(len - done, SWO_BUFFER_SIZE - offset);
+			memcpy(&swo->buf[offset], &transfer->buffer[done], chunk);
+			swo->put_idx += chunk;
+			done += chunk;
+		}
+	} else if (transfer->status != LIBUSB_TRANSFER_CANCELLED) {
+		swo->error = true;
+	}
+
+	if (swo->stopping || swo->error || libusb_submit_transfer(transfer) != LIBUSB_SUCCESS) {
+		if (!swo->stopping)
+			swo->error = true;
+		swo->active--;
+	}
+}
+
+/* Keep reading the streaming SWO endpoint into the host buffer, the data is
+ * collected while handling USB events, also when waiting for responses */
+static int cmsis_dap_usb_trace_start(struct cmsis_dap *dap)
+{
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+	struct cmsis_dap_usb_swo *swo = &bdata->swo;
+
+	if (!bdata->ep_swo) {
+		LOG_DEBUG("no streaming SWO trace endpoint");
+		return ERROR_NOT_IMPLEMENTED;
+	}
+
+	cmsis_dap_usb_trace_stop(dap);
+
+	swo->buf = malloc(SWO_BUFFER_SIZE);
+	if (!swo->buf) {
+		LOG_ERROR("unable to allocate SWO trace buffer");
+		return ERROR_FAIL;
+	}
+	swo->put_idx = 0;
+	swo->get_idx = 0;
+	swo->dropped = 0;
+	swo->stopping = false;
+	swo->error = false;
+
+	for (unsigned int i = 0; i < SWO_TRANSFERS; i++) {
+		struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+		uint8_t *buf = malloc(SWO_TRANSFER_SIZE);
+		if (!transfer || !buf) {
+			LOG_ERROR("unable to allocate SWO trace transfers");
+			libusb_free_transfer(transfer);
+			free(buf);
+			cmsis_dap_usb_trace_stop(dap);
+			return ERROR_FAIL;
+		}
+
+		libusb_fill_bulk_transfer(transfer, bdata->dev_handle, bdata->ep_swo,
+			buf, SWO_TRANSFER_SIZE, cmsis_dap_usb_swo_cb, swo, 0);
+		transfer->flags |= LIBUSB_TRANSFER_FREE_BUFFER;
+		swo->transfers[i] = transfer;
+
+		int err = libusb_submit_transfer(transfer);
+		if (err) {
+			LOG_ERROR("error reading SWO trace: %s", libusb_strerror(err));
+			cmsis_dap_usb_trace_stop(dap);
+			return ERROR_FAIL;
+		}
+		swo->active++;
+	}
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_usb_trace_stop(struct cmsis_dap *dap)
+{
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+	struct cmsis_dap_usb_swo *swo = &bdata->swo;
+
+	swo->stopping = true;
+	for (unsigned int i = 0; i < SWO_TRANSFERS && swo->active; i++)
+		if (swo->transfers[i])
+			libusb_cancel_transfer(swo->transfers[i]);
+
+	int64_t deadline = timeval_ms() + LIBUSB_TIMEOUT_MS;
+	while (swo->active && timeval_ms() < deadline) {
+		struct timeval tv = { .tv_sec = 0, .tv_usec = 10000 };
+		libusb_handle_events_timeout_completed(bdata->usb_ctx, &tv, NULL);
+	}
+	if (swo->active)
+		LOG_ERROR("SWO trace transfers did not terminate");
+
+	for (unsigned int i = 0; i < SWO_TRANSFERS; i++) {
+		libusb_free_transfer(swo->transfers[i]);
+		swo->transfers[i] = NULL;
+	}
+	free(swo->buf);
+	swo->buf = NULL;
+}
+
+static int cmsis_dap_usb_trace_read(struct cmsis_dap *dap, uint8_t *buf, size_t *size)
+{
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+	struct cmsis_dap_usb_swo *swo = &bdata->swo;
+
+	struct timeval tv = { .tv_sec = 0, .tv_usec = 0 };
+	libusb_handle_events_timeout_completed(bdata->usb_ctx, &tv, NULL);
+
+	if (swo->dropped) {
+		LOG_WARNING("SWO trace buffer overrun, %zu bytes dropped", swo->dropped);
+		swo->dropped = 0;
+	}
+
+	size_t len = MIN(*size, swo->put_idx - swo->get_idx);
+	for (size_t done = 0; done < len; ) {
+		size_t offset = swo->get_idx % SWO_BUFFER_SIZE;
+		size_t chunk = MIN(len - done, SWO_BUFFER_SIZE - offset);
+		memcpy(&buf[done], &swo->buf[offset], chunk);
+		swo->get_idx += chunk;
+		done += chunk;
+	}
+	*size = len;
+
+	if (swo->error && !len) {
+		LOG_ERROR("SWO trace streaming failed");
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
 static int cmsis_dap_usb_alloc(struct cmsis_dap *dap, unsigned int pkt_sz)
 {
 	uint8_t *buf = malloc(pkt_sz);
@@ -443,6 +813,21 @@ static int cmsis_dap_usb_alloc(struct cmsis_dap *dap, unsigned int pkt_sz)
 	dap->command = dap->packet_buffer;
 	dap->response = dap->packet_buffer;
 
+	if (!cmsis_dap_usb_async)
+		return ERROR_OK;
+
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+	cmsis_dap_usb_free_slots(bdata);
+	for (unsigned int i = 0; i < MAX_USB_SLOTS; i++) {
+		bdata->slots[i].out_buf = malloc(pkt_sz);
+		bdata->slots[i].in_buf = malloc(pkt_sz);
+		if (!bdata->slots[i].out_buf || !bdata->slots[i].in_buf) {
+			LOG_ERROR("unable to allocate CMSIS-DAP packet buffer");
+			cmsis_dap_usb_free_slots(bdata);
+			return ERROR_FAIL;
+		}
+	}
+
 	return ERROR_OK;
 }
 
@@ -456,6 +841,20 @@ COMMAND_HANDLER(cmsis_dap_handle_usb_interface_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(cmsis_dap_handle_usb_async_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], cmsis_dap_usb_async);
+
+	command_print(CMD, "asynchronous USB bulk transfers %s",
+		cmsis_dap_usb_async ? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
 const struct command_registration cmsis_dap_usb_subcommand_handlers[] = {
 	{
 		.name = "interface",
@@ -464,6 +863,14 @@ const struct command_registration cmsis_dap_usb_subcommand_handlers[] = {
 		.help = "set the USB interface number to use (for USB bulk backend only)",
 		.usage = "<interface_number>",
 	},
+	{
+		.name = "async",
+		.handler = &cmsis_dap_handle_usb_async_command,
+		.mode = COMMAND_CONFIG,
+		.help = "submit USB bulk transfers asynchronously, keeping all "
+			"pending commands and their responses in flight",
+		.usage = "['enable'|'disable']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -474,4 +881,7 @@ const struct cmsis_dap_backend cmsis_dap_usb_backend = {
 	.read = cmsis_dap_usb_read,
 	.write = cmsis_dap_usb_write,
 	.packet_buffer_alloc = cmsis_dap_usb_alloc,
+	.trace_start = cmsis_dap_usb_trace_start,
+	.trace_stop = cmsis_dap_usb_trace_stop,
+	.trace_read = cmsis_dap_usb_trace_read,
 };
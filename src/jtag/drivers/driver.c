@@ -91,6 +91,7 @@ int interface_jtag_add_ir_scan(struct jtag_tap *active,
 
 		/* update device information */
 		buf_cpy(field->out_value, tap->cur_instr, tap->ir_length);
+		tap->ir_cache_valid = true;
 
 		field++;
 	}
@@ -348,6 +349,11 @@ void interface_jtag_add_callback4(jtag_callback_t callback,
 	}
 }
 
+bool interface_jtag_has_callbacks(void)
+{
+	return jtag_callback_queue_head;
+}
+
 int interface_jtag_execute_queue(void)
 {
 	static int reentry;
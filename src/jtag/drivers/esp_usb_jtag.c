@@ -166,6 +166,8 @@ struct jtag_proto_caps_speed_apb {
 /* The internal repeats register is 10 bits, which means we can have 5 repeat commands in a
  *row at max. This translates to ('b1111111111+1=)1024 reps max. */
 #define CMD_REP_MAX_REPS 1024
+/* A command with its repeat commands takes at most this many nibbles. */
+#define CMD_RLE_MAX_NIBBLES 6
 
 /* Currently we only support one USB device. */
 #define USB_CONFIGURATION 0
@@ -173,15 +175,14 @@ struct jtag_proto_caps_speed_apb {
 /* Buffer size; is equal to the endpoint size. In bytes
  * TODO for future adapters: read from device configuration? */
 #define OUT_EP_SZ 64
-/* Out data can be buffered for longer without issues (as long as the in buffer does not overflow),
- * so we'll use an out buffer that is much larger than the out ep size. */
-#define OUT_BUF_SZ (OUT_EP_SZ * 32)
-/* The in buffer cannot be larger than the device can offer, though. */
-#define IN_BUF_SZ 64
+/* Out data can be buffered for longer without issues, as the IN data it generates is read by a
+ * transfer queued alongside, so we'll use an out buffer that is much larger than the out ep size. */
+#define OUT_BUF_SZ (OUT_EP_SZ * 256)
+/* Each send of the out buffer gets back all of the TDO bits it captured, which have to fit here. */
+#define IN_BUF_SZ (OUT_EP_SZ * 256)
 
-/* Because a series of out commands can lead to a multitude of IN_BUF_SZ-sized in packets
- *to be read, we have multiple buffers to store those before the bitq interface reads them out. */
-#define IN_BUF_CT 8
+/* The out buffer is split in up to this many transfers, queued at once on the OUT endpoint. */
+#define OUT_XFER_CT 4
 
 #define ESP_USB_INTERFACE       1
 
@@ -193,10 +194,10 @@ struct esp_usb_jtag {
 	uint16_t div_max;
 	uint8_t out_buf[OUT_BUF_SZ];
 	unsigned int out_buf_pos_nibbles;			/* write position in out_buf */
+	unsigned int out_buf_in_bits;	/* amount of TDO bits captured by the commands in out_buf */
 
-	uint8_t in_buf[IN_BUF_CT][IN_BUF_SZ];
-	unsigned int in_buf_size_bits[IN_BUF_CT];	/* size in bits of the data stored in an in_buf */
-	unsigned int cur_in_buf_rd, cur_in_buf_wr;	/* read/write index */
+	uint8_t in_buf[IN_BUF_SZ];
+	unsigned int in_buf_size_bits;	/* size in bits of the data stored in in_buf */
 	unsigned int in_buf_pos_bits;	/* which bit in the in buf needs to be returned to bitq next */
 
 	unsigned int read_ep;
@@ -205,14 +206,17 @@ struct esp_usb_jtag {
 	unsigned int prev_cmd;		/* previous command, stored here for RLEing. */
 	int prev_cmd_repct;			/* Amount of repetitions of that command we have seen until now */
 
-	/* This is the total number of in bits we need to read, including in unsent commands */
-	unsigned int pending_in_bits;
-
-	unsigned int hw_in_fifo_len;
-
 	struct bitq_interface bitq_interface;
 };
 
+/* State of the transfers of one send of the out buffer */
+struct esp_usb_jtag_xfer {
+	unsigned int in_flight;
+	bool failed;
+	unsigned int in_expected;	/* amount of bytes the IN transfer has to receive */
+	unsigned int in_recvd;
+};
+
 /* For now, we only use one static private struct. Technically, we can re-work this, but I don't think
  * OpenOCD supports multiple JTAG adapters anyway. */
 static struct esp_usb_jtag esp_usb_jtag_priv;
@@ -226,112 +230,167 @@ static int esp_usb_target_chip_id;
 static int esp_usb_jtag_init(void);
 static int esp_usb_jtag_quit(void);
 
-/* Try to receive from USB endpoint into the current priv->in_buf */
-static int esp_usb_jtag_recv_buf(void)
+static LIBUSB_CALL void esp_usb_jtag_out_cb(struct libusb_transfer *transfer)
 {
-	if (priv->in_buf_size_bits[priv->cur_in_buf_wr] != 0)
-		LOG_ERROR("esp_usb_jtag: IN buffer overflow! (%d, size %d)",
-			priv->cur_in_buf_wr,
-			priv->in_buf_size_bits[priv->cur_in_buf_wr]);
-
-	unsigned int recvd = 0, ct = (priv->pending_in_bits + 7) / 8;
-	if (ct > IN_BUF_SZ)
-		ct = IN_BUF_SZ;
-	if (ct == 0) {
-		/* Note that the adapters IN EP specifically does *not* usually generate 0-byte in
-		 * packets if there has been no data since the last flush.
-		 * As such, we don't need (and shouldn't) try to read it. */
-		return ERROR_OK;
+	struct esp_usb_jtag_xfer *xfer = transfer->user_data;
+
+	xfer->in_flight--;
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED)
+		return;
+
+	LOG_DEBUG_IO("esp_usb_jtag: sent %d bytes.", transfer->actual_length);
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED || transfer->actual_length != transfer->length) {
+		LOG_ERROR("esp_usb_jtag: usb sent only %d out of %d bytes (status %d).",
+			transfer->actual_length, transfer->length, transfer->status);
+		xfer->failed = true;
 	}
+}
 
-	priv->in_buf_size_bits[priv->cur_in_buf_wr] = 0;
-	while (recvd < ct) {
-		unsigned int tr;
-		int ret = jtag_libusb_bulk_read(priv->usb_device,
-			priv->read_ep,
-			(char *)priv->in_buf[priv->cur_in_buf_wr] + recvd,
-			ct,
-			LIBUSB_TIMEOUT_MS,	/*ms*/
-			(int *)&tr);
-		if (ret != ERROR_OK || tr == 0) {
-			/* Sometimes the hardware returns 0 bytes instead of NAKking the transaction. Ignore this. */
-			return ERROR_FAIL;
-		}
+static LIBUSB_CALL void esp_usb_jtag_in_cb(struct libusb_transfer *transfer)
+{
+	struct esp_usb_jtag_xfer *xfer = transfer->user_data;
 
-		if (tr != ct) {
-			/* Huh, short read? */
-			LOG_DEBUG("esp_usb_jtag: usb received only %d out of %d bytes.", tr, ct);
-		}
-		/* Adjust the amount of bits we still expect to read from the USB device after this. */
-		unsigned int bits_in_buf = priv->pending_in_bits;	/* initially assume we read
-									* everything that was pending */
-		if (bits_in_buf > tr * 8)
-			bits_in_buf = tr * 8;	/* ...but correct that if that was not the case. */
-		priv->pending_in_bits -= bits_in_buf;
-		priv->in_buf_size_bits[priv->cur_in_buf_wr] += bits_in_buf;
-		recvd += tr;
+	xfer->in_flight--;
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED)
+		return;
+
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+		LOG_ERROR("esp_usb_jtag: usb receive failed, got %d out of %d bytes (status %d).",
+			xfer->in_recvd + transfer->actual_length, xfer->in_expected, transfer->status);
+		xfer->failed = true;
+		return;
 	}
-	/* next in buffer for the next time. */
-	priv->cur_in_buf_wr++;
-	if (priv->cur_in_buf_wr == IN_BUF_CT)
-		priv->cur_in_buf_wr = 0;
-	LOG_DEBUG_IO("esp_usb_jtag: In ep: received %d bytes; %d bytes (%d bits) left.", recvd,
-		(priv->pending_in_bits + 7) / 8, priv->pending_in_bits);
-	return ERROR_OK;
+
+	xfer->in_recvd += transfer->actual_length;
+	if (xfer->in_recvd >= xfer->in_expected || xfer->failed)
+		return;
+
+	/* Huh, short read? Sometimes the hardware returns 0 bytes instead of NAKking the
+	 * transaction. Ignore this and wait for the rest. */
+	LOG_DEBUG("esp_usb_jtag: usb received only %d out of %d bytes.", xfer->in_recvd, xfer->in_expected);
+	transfer->buffer += transfer->actual_length;
+	transfer->length -= transfer->actual_length;
+	if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS) {
+		xfer->failed = true;
+		return;
+	}
+	xfer->in_flight++;
 }
 
-/* Sends priv->out_buf to the USB device. */
-static int esp_usb_jtag_send_buf(void)
+/* Sends priv->out_buf, which has to end with a CMD_FLUSH, to the USB device and receives all of
+ * the TDO bits it captures into priv->in_buf. The IN transfer is queued before the OUT ones, so the
+ * host keeps emptying the IN endpoint and the device never stops accepting the OUT data. */
+static int esp_usb_jtag_xfer(void)
 {
 	unsigned int ct = priv->out_buf_pos_nibbles / 2;
-	unsigned int written = 0;
-
-	while (written < ct) {
-		int tr = 0, ret = jtag_libusb_bulk_write(priv->usb_device,
-			priv->write_ep,
-			(char *)priv->out_buf + written,
-			ct - written,
-			LIBUSB_TIMEOUT_MS,	/*ms*/
-			&tr);
-		LOG_DEBUG_IO("esp_usb_jtag: sent %d bytes.", tr);
-		if (written + tr != ct) {
-			LOG_DEBUG("esp_usb_jtag: usb sent only %d out of %d bytes.",
-				written + tr,
-				ct);
+	unsigned int in_ct = DIV_ROUND_UP(priv->out_buf_in_bits, 8);
+	struct libusb_transfer *transfers[OUT_XFER_CT + 1];
+	unsigned int num_transfers = 0;
+	unsigned int in_bits = priv->out_buf_in_bits;
+	struct esp_usb_jtag_xfer xfer = { .in_expected = in_ct };
+	int ret = LIBUSB_SUCCESS;
+
+	if (priv->in_buf_pos_bits != priv->in_buf_size_bits)
+		LOG_ERROR("esp_usb_jtag: IN buffer overflow! (%d of %d bits unread)",
+			priv->in_buf_size_bits - priv->in_buf_pos_bits,
+			priv->in_buf_size_bits);
+	priv->in_buf_size_bits = 0;
+	priv->in_buf_pos_bits = 0;
+
+	if (in_ct) {
+		struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+		if (!transfer) {
+			ret = LIBUSB_ERROR_NO_MEM;
+			goto cancel;
 		}
-		if (ret != ERROR_OK)
-			return ret;
-		written += tr;
+		transfers[num_transfers++] = transfer;
+		libusb_fill_bulk_transfer(transfer, priv->usb_device, priv->read_ep,
+			priv->in_buf, in_ct, esp_usb_jtag_in_cb, &xfer, LIBUSB_TIMEOUT_MS);
+		ret = libusb_submit_transfer(transfer);
+		if (ret != LIBUSB_SUCCESS)
+			goto cancel;
+		xfer.in_flight++;
+	}
+
+	/* Split the out buffer in packet aligned segments that are all queued at once */
+	unsigned int segments = MIN(OUT_XFER_CT, DIV_ROUND_UP(ct, OUT_EP_SZ));
+	unsigned int segment_size = DIV_ROUND_UP(DIV_ROUND_UP(ct, segments), OUT_EP_SZ) * OUT_EP_SZ;
+	for (unsigned int offset = 0; offset < ct; offset += segment_size) {
+		struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+		if (!transfer) {
+			ret = LIBUSB_ERROR_NO_MEM;
+			goto cancel;
+		}
+		transfers[num_transfers++] = transfer;
+		libusb_fill_bulk_transfer(transfer, priv->usb_device, priv->write_ep,
+			priv->out_buf + offset, MIN(segment_size, ct - offset),
+			esp_usb_jtag_out_cb, &xfer, LIBUSB_TIMEOUT_MS);
+		ret = libusb_submit_transfer(transfer);
+		if (ret != LIBUSB_SUCCESS)
+			goto cancel;
+		xfer.in_flight++;
+	}
+
+	while (xfer.in_flight && !xfer.failed) {
+		ret = jtag_libusb_handle_events_completed(NULL);
+		if (ret != LIBUSB_SUCCESS && ret != LIBUSB_ERROR_INTERRUPTED)
+			goto cancel;
+	}
+	if (!xfer.failed)
+		goto done;
+	ret = LIBUSB_ERROR_IO;
+
+cancel:
+	for (unsigned int i = 0; i < num_transfers; i++)
+		libusb_cancel_transfer(transfers[i]);
+	while (xfer.in_flight) {
+		if (jtag_libusb_handle_events_completed(NULL) != LIBUSB_SUCCESS)
+			break;
 	}
-	priv->out_buf_pos_nibbles = 0;
 
-	/* If there's more than a bufferful of data queuing up in the jtag adapters IN endpoint, empty
-	 * all but one buffer. */
-	while (priv->pending_in_bits > (IN_BUF_SZ + priv->hw_in_fifo_len - 1) * 8)
-		esp_usb_jtag_recv_buf();
+done:
+	for (unsigned int i = 0; i < num_transfers; i++)
+		libusb_free_transfer(transfers[i]);
 
+	priv->out_buf_pos_nibbles = 0;
+	priv->out_buf_in_bits = 0;
+	if (ret != LIBUSB_SUCCESS) {
+		LOG_ERROR("esp_usb_jtag: usb transfer failed with %s", libusb_error_name(ret));
+		return ERROR_FAIL;
+	}
+
+	/* Only the captured bits are valid, the device pads the last byte with zeroes. */
+	priv->in_buf_size_bits = in_bits;
+	LOG_DEBUG_IO("esp_usb_jtag: sent %d bytes, received %d bytes (%d bits).", ct, in_ct,
+		priv->in_buf_size_bits);
 	return ERROR_OK;
 }
 
-/* Simply adds a command to the buffer. Is called by the RLE encoding mechanism.
- *Also sends the intermediate buffer if there's enough to go into one USB packet. */
-static int esp_usb_jtag_command_add_raw(unsigned int cmd)
+/* Simply adds a command to the buffer. Is called by the RLE encoding mechanism, which makes sure
+ * there is room for it. */
+static void esp_usb_jtag_command_add_raw(unsigned int cmd)
 {
-	int ret = ERROR_OK;
-
 	if ((priv->out_buf_pos_nibbles & 1) == 0)
 		priv->out_buf[priv->out_buf_pos_nibbles / 2] = (cmd << 4);
 	else
 		priv->out_buf[priv->out_buf_pos_nibbles / 2] |= cmd;
 	priv->out_buf_pos_nibbles++;
+}
+
+/* Terminates the buffered commands with a flush of the IN endpoint, so all of the TDO bits they
+ * capture come back, and sends them off. */
+static int esp_usb_jtag_send_buf(void)
+{
+	if (priv->out_buf_pos_nibbles == 0)
+		return ERROR_OK;
 
-	if (priv->out_buf_pos_nibbles == OUT_BUF_SZ * 2)
-		ret = esp_usb_jtag_send_buf();
-	if (ret == ERROR_OK && priv->out_buf_pos_nibbles % (OUT_EP_SZ * 2) == 0) {
-		if (priv->pending_in_bits > (IN_BUF_SZ + priv->hw_in_fifo_len - 1) * 8)
-			ret = esp_usb_jtag_send_buf();
+	esp_usb_jtag_command_add_raw(CMD_FLUSH);
+	/* Make sure we have an even amount of commands, as we can't write a nibble by itself. */
+	if (priv->out_buf_pos_nibbles & 1) {
+		/*If not, pad with an extra FLUSH */
+		esp_usb_jtag_command_add_raw(CMD_FLUSH);
 	}
-	return ret;
+	return esp_usb_jtag_xfer();
 }
 
 /* Writes a command stream equivalent to writing `cmd` `ct` times. */
@@ -340,15 +399,21 @@ static int esp_usb_jtag_write_rlestream(unsigned int cmd, int ct)
 	/* Special case: stacking flush commands does not make sense (and may not make the hardware very happy) */
 	if (cmd == CMD_FLUSH)
 		ct = 1;
+	unsigned int in_bits = (cmd & BIT(3)) == 0 && (cmd & BIT(2)) ? ct : 0;
+	/* Send the buffer first if the stream, or its TDO bits, would not fit. Two nibbles are kept
+	 * for the flush which terminates the buffer. */
+	if (priv->out_buf_pos_nibbles + CMD_RLE_MAX_NIBBLES + 2 > OUT_BUF_SZ * 2 ||
+		priv->out_buf_in_bits + in_bits > IN_BUF_SZ * 8) {
+		int ret = esp_usb_jtag_send_buf();
+		if (ret != ERROR_OK)
+			return ret;
+	}
+	priv->out_buf_in_bits += in_bits;
 	/* Output previous command and repeat commands */
-	int ret = esp_usb_jtag_command_add_raw(cmd);
-	if (ret != ERROR_OK)
-		return ret;
+	esp_usb_jtag_command_add_raw(cmd);
 	ct--;	/* as the previous line already executes the command one time */
 	while (ct > 0) {
-		ret = esp_usb_jtag_command_add_raw(CMD_REP(ct & 3));
-		if (ret != ERROR_OK)
-			return ret;
+		esp_usb_jtag_command_add_raw(CMD_REP(ct & 3));
 		ct >>= 2;
 	}
 	return ERROR_OK;
@@ -377,12 +442,7 @@ static int esp_usb_jtag_command_add(unsigned int cmd)
 /* Called by bitq interface to output a bit on tdi and perhaps read a bit from tdo */
 static int esp_usb_jtag_out(int tms, int tdi, int tdo_req)
 {
-	int ret = esp_usb_jtag_command_add(CMD_CLK(tdo_req, tdi, tms));
-	if (ret != ERROR_OK)
-		return ret;
-	if (tdo_req)
-		priv->pending_in_bits++;
-	return ERROR_OK;
+	return esp_usb_jtag_command_add(CMD_CLK(tdo_req, tdi, tms));
 }
 
 /* Called by bitq interface to flush all output commands and get returned data ready to read */
@@ -396,28 +456,9 @@ static int esp_usb_jtag_flush(void)
 			return ret;
 	}
 	priv->prev_cmd_repct = 0;
-	/* Flush in buffer */
-	ret = esp_usb_jtag_command_add_raw(CMD_FLUSH);
-	if (ret != ERROR_OK)
-		return ret;
-	/* Make sure we have an even amount of commands, as we can't write a nibble by itself. */
-	if (priv->out_buf_pos_nibbles & 1) {
-		/*If not, pad with an extra FLUSH */
-		ret = esp_usb_jtag_command_add_raw(CMD_FLUSH);
-		if (ret != ERROR_OK)
-			return ret;
-	}
 	LOG_DEBUG_IO("esp_usb_jtag: Flush!");
-	/* Send off the buffer. */
-	ret = esp_usb_jtag_send_buf();
-	if (ret != ERROR_OK)
-		return ret;
-
-	/* Immediately fetch the response bits. */
-	while (priv->pending_in_bits > 0)
-		esp_usb_jtag_recv_buf();
-
-	return ERROR_OK;
+	/* Send off the buffer, this also fetches the response bits. */
+	return esp_usb_jtag_send_buf();
 }
 
 /* Called by bitq interface to sleep for a determined amount of time */
@@ -441,7 +482,7 @@ static int esp_usb_jtag_reset(int trst, int srst)
 /* Called by bitq to see if the IN data already is returned to the host. */
 static int esp_usb_jtag_in_rdy(void)
 {
-	/* We read all bits in the flush() routine, so if we're here, we have bits or are at EOF. */
+	/* We read all bits when sending the buffer, so if we're here, we have bits or are at EOF. */
 	return 1;
 }
 
@@ -452,23 +493,13 @@ static int esp_usb_jtag_in(void)
 		LOG_ERROR("esp_usb_jtag: Eeek! bitq asked us for in data while not ready!");
 		return -1;
 	}
-	if (priv->cur_in_buf_rd == priv->cur_in_buf_wr &&
-		priv->in_buf_size_bits[priv->cur_in_buf_rd] == 0)
+	if (priv->in_buf_pos_bits == priv->in_buf_size_bits)
 		return -1;
 
 	/* Extract the bit */
-	int r = (priv->in_buf[priv->cur_in_buf_rd][priv->in_buf_pos_bits / 8] &
-		BIT(priv->in_buf_pos_bits & 7)) ? 1 : 0;
+	int r = (priv->in_buf[priv->in_buf_pos_bits / 8] & BIT(priv->in_buf_pos_bits & 7)) ? 1 : 0;
 	/* Move to next bit. */
 	priv->in_buf_pos_bits++;
-	if (priv->in_buf_pos_bits == priv->in_buf_size_bits[priv->cur_in_buf_rd]) {
-		/* No more bits in this buffer; mark as re-usable and move to next buffer. */
-		priv->in_buf_pos_bits = 0;
-		priv->in_buf_size_bits[priv->cur_in_buf_rd] = 0;/*indicate it is free again */
-		priv->cur_in_buf_rd++;
-		if (priv->cur_in_buf_rd == IN_BUF_CT)
-			priv->cur_in_buf_rd = 0;
-	}
 	return r;
 }
 
@@ -568,9 +599,6 @@ static int esp_usb_jtag_init(void)
 	LOG_INFO("esp_usb_jtag: Device found. Base speed %dKHz, div range %d to %d",
 		priv->base_speed_khz, priv->div_min, priv->div_max);
 
-	/* TODO: grab from (future) descriptor if we ever have a device with larger IN buffers */
-	priv->hw_in_fifo_len = 4;
-
 	/* inform bridge board about the connected target chip for the specific operations
 	 * it is also safe to send this info to chips that have builtin usb jtag */
 	jtag_libusb_control_transfer(priv->usb_device,
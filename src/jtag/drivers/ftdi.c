@@ -81,6 +81,7 @@
 static char *ftdi_device_desc;
 static uint8_t ftdi_channel;
 static uint8_t ftdi_jtag_mode = JTAG_MODE;
+static unsigned int ftdi_transfer_depth = MPSSE_DEFAULT_TRANSFERS;
 
 static bool swd_mode;
 
@@ -108,10 +109,12 @@ static struct signal *signals;
 static struct swd_cmd_queue_entry {
 	uint8_t cmd;
 	uint32_t *dst;
+	uint32_t ap_delay_clk;
 	uint8_t trn_ack_data_parity_trn[DIV_ROUND_UP(4 + 3 + 32 + 1 + 4, 8)];
 } *swd_cmd_queue;
 static size_t swd_cmd_queue_length;
 static size_t swd_cmd_queue_alloced;
+static unsigned int swd_wait_retries;
 static int queued_retval;
 static int freq;
 
@@ -121,6 +124,7 @@ static uint16_t jtag_output_init;
 static uint16_t jtag_direction_init;
 
 static int ftdi_swd_switch_seq(enum swd_special_seq seq);
+static void ftdi_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data, uint32_t ap_delay_clk);
 
 static struct signal *find_signal_by_name(const char *name)
 {
@@ -663,6 +667,8 @@ static int ftdi_initialize(void)
 	if (!mpsse_ctx)
 		return ERROR_JTAG_INIT_FAILED;
 
+	mpsse_set_transfer_depth(mpsse_ctx, ftdi_transfer_depth);
+
 	output = jtag_output_init;
 	direction = jtag_direction_init;
 
@@ -917,6 +923,65 @@ COMMAND_HANDLER(ftdi_handle_tdo_sample_edge_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(ftdi_handle_transfer_depth_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], ftdi_transfer_depth);
+		if (ftdi_transfer_depth < 1 || ftdi_transfer_depth > MPSSE_MAX_TRANSFERS) {
+			command_print(CMD, "transfer depth must be between 1 and %d",
+				MPSSE_MAX_TRANSFERS);
+			ftdi_transfer_depth = MPSSE_DEFAULT_TRANSFERS;
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		if (mpsse_ctx)
+			mpsse_set_transfer_depth(mpsse_ctx, ftdi_transfer_depth);
+	}
+
+	command_print(CMD, "ftdi keeps up to %u USB transfers in flight", ftdi_transfer_depth);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(ftdi_handle_swd_wait_retries_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], swd_wait_retries);
+
+	command_print(CMD, "ftdi replays the SWD queue up to %u times on WAIT", swd_wait_retries);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(ftdi_handle_stats_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!mpsse_ctx) {
+		command_print(CMD, "ftdi device is not open");
+		return ERROR_FAIL;
+	}
+
+	struct mpsse_stats stats;
+	mpsse_get_stats(mpsse_ctx, &stats);
+
+	command_print(CMD, "flushes:         %" PRIu64, stats.flushes);
+	command_print(CMD, "write transfers: %" PRIu64 " (%" PRIu64 " bytes)",
+		stats.write_transfers, stats.bytes_written);
+	command_print(CMD, "read transfers:  %" PRIu64 " (%" PRIu64 " bytes)",
+		stats.read_transfers, stats.bytes_read);
+	command_print(CMD, "peak in flight:  %u (depth %u per direction)",
+		stats.peak_in_flight, ftdi_transfer_depth);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration ftdi_subcommand_handlers[] = {
 	{
 		.name = "device_desc",
@@ -978,6 +1043,29 @@ static const struct command_registration ftdi_subcommand_handlers[] = {
 			"allow signalling speed increase)",
 		.usage = "(rising|falling)",
 	},
+	{
+		.name = "transfer_depth",
+		.handler = &ftdi_handle_transfer_depth_command,
+		.mode = COMMAND_ANY,
+		.help = "set how many USB transfers per direction are kept in flight "
+			"while flushing the MPSSE queue",
+		.usage = "[(1-" stringify(MPSSE_MAX_TRANSFERS) ")]",
+	},
+	{
+		.name = "swd_wait_retries",
+		.handler = &ftdi_handle_swd_wait_retries_command,
+		.mode = COMMAND_ANY,
+		.help = "set how many times the tail of the SWD queue is replayed "
+			"after a WAIT response (0 disables the replay)",
+		.usage = "[count]",
+	},
+	{
+		.name = "stats",
+		.handler = &ftdi_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show USB transfer statistics of the MPSSE queue",
+		.usage = "",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -1028,7 +1116,9 @@ static int ftdi_swd_init(void)
 	if (create_signals() != ERROR_OK)
 		return ERROR_FAIL;
 
-	swd_cmd_queue_alloced = 10;
+	/* Roughly what fits in the MPSSE buffers, so that most queues are
+	 * sent in one go instead of being run early to grow the queue */
+	swd_cmd_queue_alloced = 512;
 	swd_cmd_queue = malloc(swd_cmd_queue_alloced * sizeof(*swd_cmd_queue));
 
 	return swd_cmd_queue ? ERROR_OK : ERROR_FAIL;
@@ -1052,6 +1142,47 @@ static void ftdi_swd_swdio_en(bool enable)
 	}
 }
 
+/**
+ * Queue again the transactions from @a first to the end of the SWD queue,
+ * after clearing the sticky overrun flag raised by the WAIT response of
+ * transaction @a first. With overrun detection enabled, the transactions
+ * following a WAIT have no effect and the data phase of each one is still
+ * clocked, so the command stream is in sync and the tail can be sent again.
+ * Must be called with the MPSSE queue flushed.
+ */
+static int ftdi_swd_requeue_tail(size_t first)
+{
+	size_t count = swd_cmd_queue_length - first;
+	struct swd_cmd_queue_entry *tail = malloc(count * sizeof(*tail));
+	if (!tail)
+		return ERROR_FAIL;
+	memcpy(tail, swd_cmd_queue + first, count * sizeof(*tail));
+
+	/* The queue was just run, there are no pending pointers into it */
+	if (count + 1 > swd_cmd_queue_alloced) {
+		struct swd_cmd_queue_entry *q = realloc(swd_cmd_queue,
+				swd_cmd_queue_alloced * 2 * sizeof(*swd_cmd_queue));
+		if (!q) {
+			free(tail);
+			return ERROR_FAIL;
+		}
+		swd_cmd_queue = q;
+		swd_cmd_queue_alloced *= 2;
+	}
+
+	swd_cmd_queue_length = 0;
+	ftdi_swd_queue_cmd(swd_cmd(false, false, DP_ABORT), NULL, ORUNERRCLR, 0);
+	for (size_t i = 0; i < count; i++) {
+		uint32_t data = 0;
+		if (!(tail[i].cmd & SWD_CMD_RNW))
+			data = buf_get_u32(tail[i].trn_ack_data_parity_trn, 1 + 3 + 1, 32);
+		ftdi_swd_queue_cmd(tail[i].cmd, tail[i].dst, data, tail[i].ap_delay_clk);
+	}
+
+	free(tail);
+	return queued_retval;
+}
+
 /**
  * Flush the MPSSE queue and process the SWD transaction queue
  * @return
@@ -1061,12 +1192,14 @@ static int ftdi_swd_run_queue(void)
 	LOG_DEBUG_IO("Executing %zu queued transactions", swd_cmd_queue_length);
 	int retval;
 	struct signal *led = find_signal_by_name("LED");
+	unsigned int retries = 0;
 
 	if (queued_retval != ERROR_OK) {
 		LOG_DEBUG_IO("Skipping due to previous errors: %d", queued_retval);
 		goto skip;
 	}
 
+again:
 	/* A transaction must be followed by another transaction or at least 8 idle cycles to
 	 * ensure that data is clocked through the AP. */
 	mpsse_clock_data_out(mpsse_ctx, NULL, 0, 8, SWD_MODE);
@@ -1097,6 +1230,13 @@ static int ftdi_swd_run_queue(void)
 						1 + 3 + (swd_cmd_queue[i].cmd & SWD_CMD_RNW ? 0 : 1), 32));
 
 		if (ack != SWD_ACK_OK && check_ack) {
+			if (ack == SWD_ACK_WAIT && retries < swd_wait_retries) {
+				retries++;
+				LOG_DEBUG("WAIT on transaction %zu of %zu, replaying the rest",
+					i, swd_cmd_queue_length);
+				if (ftdi_swd_requeue_tail(i) == ERROR_OK)
+					goto again;
+			}
 			queued_retval = swd_ack_to_error_code(ack);
 			goto skip;
 
@@ -1147,6 +1287,7 @@ static void ftdi_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data, uint32
 
 	size_t i = swd_cmd_queue_length++;
 	swd_cmd_queue[i].cmd = cmd | SWD_CMD_START | SWD_CMD_PARK;
+	swd_cmd_queue[i].ap_delay_clk = ap_delay_clk;
 
 	mpsse_clock_data_out(mpsse_ctx, &swd_cmd_queue[i].cmd, 0, 8, SWD_MODE);
 
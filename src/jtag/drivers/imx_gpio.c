@@ -135,6 +135,40 @@ static int imx_gpio_write(int tck, int tms, int tdi)
 	return ERROR_OK;
 }
 
+/*
+ * With TCK, TMS and TDI in the same GPIO bank each edge costs a single
+ * read-modify-write of the data register.
+ */
+static int imx_gpio_scan_word(uint32_t tms, uint32_t tdi, uint32_t *tdo, unsigned int num_bits)
+{
+	volatile uint32_t *dr = &pio_base[tck_gpio / 32].dr;
+	const uint32_t tck_mask = 1u << (tck_gpio & 0x1F);
+	const unsigned int tms_shift = tms_gpio & 0x1F;
+	const unsigned int tdi_shift = tdi_gpio & 0x1F;
+	const uint32_t mask = tck_mask | 1u << tms_shift | 1u << tdi_shift;
+	uint32_t in = 0;
+
+	for (unsigned int i = 0; i < num_bits; i++) {
+		uint32_t value = ((tms >> i) & 1) << tms_shift | ((tdi >> i) & 1) << tdi_shift;
+
+		*dr = (*dr & ~mask) | value;
+		for (unsigned int j = 0; j < jtag_delay; j++)
+			asm volatile ("");
+
+		if (tdo)
+			in |= (uint32_t)gpio_level(tdo_gpio) << i;
+
+		*dr |= tck_mask;
+		for (unsigned int j = 0; j < jtag_delay; j++)
+			asm volatile ("");
+	}
+
+	if (tdo)
+		*tdo = in;
+
+	return ERROR_OK;
+}
+
 static int imx_gpio_swd_write(int swclk, int swdio)
 {
 	swdio ? gpio_set(swdio_gpio) : gpio_clear(swdio_gpio);
@@ -515,6 +549,13 @@ static int imx_gpio_init(void)
 		gpio_mode_output_set(tck_gpio);
 		gpio_mode_output_set(tms_gpio);
 
+		if (tms_gpio / 32 == tck_gpio / 32 && tdi_gpio / 32 == tck_gpio / 32) {
+			LOG_DEBUG("imx_gpio using fast mode for JTAG scans");
+			imx_gpio_bitbang.scan_word = imx_gpio_scan_word;
+		} else {
+			imx_gpio_bitbang.scan_word = NULL;
+		}
+
 		if (trst_gpio != -1) {
 			trst_gpio_mode = gpio_mode_get(trst_gpio);
 			gpio_set(trst_gpio);
@@ -51,6 +51,20 @@ static bool trace_enabled;
 #define JLINK_MAX_SPEED			12000
 #define JLINK_TAP_BUFFER_SIZE	2048
 
+#define MAX_PENDING_SCAN_RESULTS 256
+
+/*
+ * Largest single SWD transfer, the length is passed to the device in bits as
+ * a 16-bit value.
+ */
+#define JLINK_SWD_MAX_IO_SIZE	(0xffff / 8)
+
+/*
+ * Upper limit of the SWD queue in bytes per direction. A queue run is split
+ * into transfers which fit into the device internal memory.
+ */
+#define JLINK_SWD_QUEUE_SIZE	(64 * 1024)
+
 static unsigned int swd_buffer_size = JLINK_TAP_BUFFER_SIZE;
 
 /* Maximum SWO frequency deviation. */
@@ -91,6 +105,8 @@ static int jlink_swd_switch_seq(enum swd_special_seq seq);
 
 /* J-Link tap buffer functions */
 static void jlink_tap_init(void);
+static bool jlink_tap_resize(unsigned int size, int results);
+static void jlink_tap_free(void);
 static int jlink_flush(void);
 /**
  * Queue data to go out and in, flushing the queue as many times as
@@ -472,7 +488,7 @@ static bool adjust_swd_buffer_size(void)
 		return false;
 	}
 
-	tmp = MIN(JLINK_TAP_BUFFER_SIZE, (tmp - 16) / 2);
+	tmp = MIN(JLINK_SWD_MAX_IO_SIZE, (tmp - 16) / 2);
 
 	if (tmp != swd_buffer_size) {
 		swd_buffer_size = tmp;
@@ -811,6 +827,13 @@ static int jlink_init(void)
 		return ret;
 	}
 
+	if (!jlink_tap_resize(JLINK_TAP_BUFFER_SIZE, MAX_PENDING_SCAN_RESULTS)) {
+		LOG_ERROR("Failed to allocate the transaction queue");
+		jaylink_close(devh);
+		jaylink_exit(jayctx);
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
 	jlink_reset(0, 0);
 	jtag_sleep(3000);
 	jlink_tap_init();
@@ -855,6 +878,8 @@ static int jlink_quit(void)
 	jaylink_close(devh);
 	jaylink_exit(jayctx);
 
+	jlink_tap_free();
+
 	return ERROR_OK;
 }
 
@@ -1962,10 +1987,14 @@ static void jlink_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_c
 /* J-Link tap functions */
 
 static unsigned tap_length;
-/* In SWD mode use tms buffer for direction control */
-static uint8_t tms_buffer[JLINK_TAP_BUFFER_SIZE];
-static uint8_t tdi_buffer[JLINK_TAP_BUFFER_SIZE];
-static uint8_t tdo_buffer[JLINK_TAP_BUFFER_SIZE];
+/*
+ * In SWD mode use tms buffer for direction control. The buffers hold
+ * JLINK_TAP_BUFFER_SIZE bytes in JTAG mode and grow with the SWD queue.
+ */
+static unsigned int tap_buffer_size;
+static uint8_t *tms_buffer;
+static uint8_t *tdi_buffer;
+static uint8_t *tdo_buffer;
 
 struct pending_scan_result {
 	/** First bit position in tdo_buffer to read. */
@@ -1980,17 +2009,70 @@ struct pending_scan_result {
 	uint8_t swd_cmd;
 };
 
-#define MAX_PENDING_SCAN_RESULTS 256
-
 static int pending_scan_results_length;
-static struct pending_scan_result pending_scan_results_buffer[MAX_PENDING_SCAN_RESULTS];
+static int pending_scan_results_size;
+static struct pending_scan_result *pending_scan_results_buffer;
 
 static void jlink_tap_init(void)
 {
+	/* Only the used part may be non-zero */
+	if (tap_length) {
+		memset(tms_buffer, 0, DIV_ROUND_UP(tap_length, 8));
+		memset(tdi_buffer, 0, DIV_ROUND_UP(tap_length, 8));
+	}
+
+	tap_length = 0;
+	pending_scan_results_length = 0;
+}
+
+/* Grow the queue to hold size bytes and the given number of results */
+static bool jlink_tap_resize(unsigned int size, int results)
+{
+	if (size > tap_buffer_size) {
+		uint8_t *tms = realloc(tms_buffer, size);
+		if (tms)
+			tms_buffer = tms;
+		uint8_t *tdi = realloc(tdi_buffer, size);
+		if (tdi)
+			tdi_buffer = tdi;
+		uint8_t *tdo = realloc(tdo_buffer, size);
+		if (tdo)
+			tdo_buffer = tdo;
+		if (!tms || !tdi || !tdo)
+			return false;
+
+		memset(&tms_buffer[tap_buffer_size], 0, size - tap_buffer_size);
+		memset(&tdi_buffer[tap_buffer_size], 0, size - tap_buffer_size);
+		tap_buffer_size = size;
+	}
+
+	if (results > pending_scan_results_size) {
+		struct pending_scan_result *p = realloc(pending_scan_results_buffer,
+			results * sizeof(*p));
+		if (!p)
+			return false;
+
+		pending_scan_results_buffer = p;
+		pending_scan_results_size = results;
+	}
+
+	return true;
+}
+
+static void jlink_tap_free(void)
+{
+	free(tms_buffer);
+	free(tdi_buffer);
+	free(tdo_buffer);
+	free(pending_scan_results_buffer);
+	tms_buffer = NULL;
+	tdi_buffer = NULL;
+	tdo_buffer = NULL;
+	pending_scan_results_buffer = NULL;
+	tap_buffer_size = 0;
+	pending_scan_results_size = 0;
 	tap_length = 0;
 	pending_scan_results_length = 0;
-	memset(tms_buffer, 0, sizeof(tms_buffer));
-	memset(tdi_buffer, 0, sizeof(tdi_buffer));
 }
 
 static void jlink_clock_data(const uint8_t *out, unsigned out_offset,
@@ -2104,6 +2186,27 @@ static void jlink_queue_data_in(uint32_t len)
 	tap_length += len;
 }
 
+/*
+ * Make room for bits more bits and results more transactions in the SWD queue,
+ * growing it or, if it reached its upper limit, running it. Returns false if
+ * nothing more can be queued because of a previous error.
+ */
+static bool jlink_swd_reserve(unsigned int bits, int results)
+{
+	/* Leave room for the idle cycles appended by jlink_swd_run_queue() */
+	unsigned int size = DIV_ROUND_UP(tap_length + bits + 8, 8);
+
+	if (size > JLINK_SWD_QUEUE_SIZE ||
+			(size > tap_buffer_size &&
+			 !jlink_tap_resize(MAX(size, MIN(2 * tap_buffer_size, JLINK_SWD_QUEUE_SIZE)),
+					pending_scan_results_size)) ||
+			(pending_scan_results_length + results > pending_scan_results_size &&
+			 !jlink_tap_resize(tap_buffer_size, 2 * pending_scan_results_size)))
+		queued_retval = jlink_swd_run_queue();
+
+	return queued_retval == ERROR_OK;
+}
+
 static int jlink_swd_switch_seq(enum swd_special_seq seq)
 {
 	const uint8_t *s;
@@ -2150,14 +2253,45 @@ static int jlink_swd_switch_seq(enum swd_special_seq seq)
 			return ERROR_FAIL;
 	}
 
+	if (!jlink_swd_reserve(s_len, 0))
+		return queued_retval;
+
 	jlink_queue_data_out(s, s_len);
 
 	return ERROR_OK;
 }
 
+/* Scratch buffers for transfers which do not start on a byte boundary */
+static uint8_t swd_io_tms[JLINK_SWD_MAX_IO_SIZE];
+static uint8_t swd_io_tdi[JLINK_SWD_MAX_IO_SIZE];
+static uint8_t swd_io_tdo[JLINK_SWD_MAX_IO_SIZE];
+
+/* Run length bits of the queue starting at bit position start */
+static int jlink_swd_io(unsigned int start, unsigned int length)
+{
+	int ret;
+
+	if (!(start % 8)) {
+		ret = jaylink_swd_io(devh, &tms_buffer[start / 8], &tdi_buffer[start / 8],
+			&tdo_buffer[start / 8], length);
+	} else {
+		buf_set_buf(tms_buffer, start, swd_io_tms, 0, length);
+		buf_set_buf(tdi_buffer, start, swd_io_tdi, 0, length);
+		ret = jaylink_swd_io(devh, swd_io_tms, swd_io_tdi, swd_io_tdo, length);
+		if (ret == JAYLINK_OK)
+			buf_set_buf(swd_io_tdo, 0, tdo_buffer, start, length);
+	}
+
+	if (ret != JAYLINK_OK) {
+		LOG_ERROR("jaylink_swd_io() failed: %s", jaylink_strerror(ret));
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
 static int jlink_swd_run_queue(void)
 {
-	int i;
 	int ret;
 
 	LOG_DEBUG("Executing %d queued transactions", pending_scan_results_length);
@@ -2173,35 +2307,64 @@ static int jlink_swd_run_queue(void)
 	 */
 	jlink_queue_data_out(NULL, 8);
 
-	ret = jaylink_swd_io(devh, tms_buffer, tdi_buffer, tdo_buffer, tap_length);
-
-	if (ret != JAYLINK_OK) {
-		LOG_ERROR("jaylink_swd_io() failed: %s", jaylink_strerror(ret));
-		goto skip;
-	}
+	/*
+	 * The device can only hold swd_buffer_size bytes per transfer. Split the
+	 * queue where a transaction starts, so the acks of the transactions already
+	 * sent are checked before the following ones are.
+	 */
+	unsigned int max_length = MIN(swd_buffer_size, JLINK_SWD_MAX_IO_SIZE) * 8;
+	unsigned int start = 0;
+	int i = 0;
+
+	while (start < tap_length) {
+		unsigned int end = tap_length;
+
+		if (end - start > max_length) {
+			end = start + max_length;
+			for (int j = i; j < pending_scan_results_length; j++) {
+				/* The 8 bit request is queued in front of the first bit read */
+				unsigned int cmd_start = pending_scan_results_buffer[j].first - 8;
+				if (cmd_start > start + max_length)
+					break;
+				if (cmd_start > start)
+					end = cmd_start;
+			}
+		}
 
-	for (i = 0; i < pending_scan_results_length; i++) {
-		/* Devices do not reply to DP_TARGETSEL write cmd, ignore received ack */
-		bool check_ack = swd_cmd_returns_ack(pending_scan_results_buffer[i].swd_cmd);
-		int ack = buf_get_u32(tdo_buffer, pending_scan_results_buffer[i].first, 3);
-		if (check_ack && ack != SWD_ACK_OK) {
-			LOG_DEBUG("SWD ack not OK: %d %s", ack,
-				  ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK");
-			queued_retval = swd_ack_to_error_code(ack);
+		queued_retval = jlink_swd_io(start, end - start);
+		if (queued_retval != ERROR_OK)
 			goto skip;
-		} else if (pending_scan_results_buffer[i].length) {
-			uint32_t data = buf_get_u32(tdo_buffer, 3 + pending_scan_results_buffer[i].first, 32);
-			int parity = buf_get_u32(tdo_buffer, 3 + 32 + pending_scan_results_buffer[i].first, 1);
 
-			if (parity != parity_u32(data)) {
-				LOG_ERROR("SWD: Read data parity mismatch");
-				queued_retval = ERROR_FAIL;
+		/* Check the transactions received completely */
+		for (; i < pending_scan_results_length; i++) {
+			struct pending_scan_result *p = &pending_scan_results_buffer[i];
+			if (p->first + 3 + (p->length ? 32 + 1 : 0) > end)
+				break;
+
+			/* Devices do not reply to DP_TARGETSEL write cmd, ignore received ack */
+			bool check_ack = swd_cmd_returns_ack(p->swd_cmd);
+			int ack = buf_get_u32(tdo_buffer, p->first, 3);
+			if (check_ack && ack != SWD_ACK_OK) {
+				LOG_DEBUG("SWD ack not OK: %d %s", ack,
+					  ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK");
+				queued_retval = swd_ack_to_error_code(ack);
 				goto skip;
+			} else if (p->length) {
+				uint32_t data = buf_get_u32(tdo_buffer, 3 + p->first, 32);
+				int parity = buf_get_u32(tdo_buffer, 3 + 32 + p->first, 1);
+
+				if (parity != parity_u32(data)) {
+					LOG_ERROR("SWD: Read data parity mismatch");
+					queued_retval = ERROR_FAIL;
+					goto skip;
+				}
+
+				if (p->buffer)
+					*(uint32_t *)p->buffer = data;
 			}
-
-			if (pending_scan_results_buffer[i].buffer)
-				*(uint32_t *)pending_scan_results_buffer[i].buffer = data;
 		}
+
+		start = end;
 	}
 
 skip:
@@ -2215,13 +2378,8 @@ skip:
 static void jlink_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data, uint32_t ap_delay_clk)
 {
 	uint8_t data_parity_trn[DIV_ROUND_UP(32 + 1, 8)];
-	if (tap_length + 46 + 8 + ap_delay_clk >= swd_buffer_size * 8 ||
-	    pending_scan_results_length == MAX_PENDING_SCAN_RESULTS) {
-		/* Not enough room in the queue. Run the queue. */
-		queued_retval = jlink_swd_run_queue();
-	}
 
-	if (queued_retval != ERROR_OK)
+	if (!jlink_swd_reserve(46 + ap_delay_clk, 1))
 		return;
 
 	pending_scan_results_buffer[pending_scan_results_length].swd_cmd = cmd;
@@ -38,6 +38,10 @@
 #define CMD_SCAN_CHAIN_FLIP_TMS	3
 #define CMD_STOP_SIMU		4
 
+/* Upper limit of scan replies not yet read back from the server */
+#define MAX_PENDING_XFERS	64
+#define DEFAULT_PIPELINE_DEPTH	32
+
 /* jtag_vpi server port and address to connect to */
 static int server_port = DEFAULT_SERVER_PORT;
 static char *server_address;
@@ -45,6 +49,9 @@ static char *server_address;
 /* Send CMD_STOP_SIMU to server when OpenOCD exits? */
 static bool stop_sim_on_exit;
 
+/* Number of scan replies that may be pending before reading them back */
+static unsigned int pipeline_depth = DEFAULT_PIPELINE_DEPTH;
+
 static int sockfd;
 static struct sockaddr_in serv_addr;
 
@@ -66,6 +73,34 @@ struct vpi_cmd {
 	};
 };
 
+/*
+ * The commands are collected in send_buf and written to the socket in one go.
+ * The server replies to the scan commands only, in order, so the replies are
+ * read back later into the buffers of the pending transfers; the scan
+ * results are then handed to the JTAG layer.
+ */
+static uint8_t *send_buf;
+static size_t send_buf_used;
+static size_t send_buf_size;
+
+struct pending_xfer {
+	uint8_t *bits;
+	int nb_bits;
+};
+
+static struct pending_xfer pending_xfers[MAX_PENDING_XFERS];
+static unsigned int pending_xfers_len;
+
+struct pending_scan {
+	struct scan_command *cmd;
+	uint8_t *buf;
+};
+
+/* a scan is only registered after its last transfer, which may have
+ * triggered a flush, hence one more entry than transfers */
+static struct pending_scan pending_scans[MAX_PENDING_XFERS + 1];
+static unsigned int pending_scans_len;
+
 static char *jtag_vpi_cmd_to_str(int cmd_num)
 {
 	switch (cmd_num) {
@@ -84,10 +119,9 @@ static char *jtag_vpi_cmd_to_str(int cmd_num)
 	}
 }
 
+/* Queue a command, it is sent by jtag_vpi_flush() */
 static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
 {
-	int retval;
-
 	/* Optional low-level JTAG debug */
 	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
 		if (vpi->nb_bits > 0) {
@@ -125,8 +159,29 @@ static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
 	h_u32_to_le(vpi->length_buf, vpi->length);
 	h_u32_to_le(vpi->nb_bits_buf, vpi->nb_bits);
 
+	if (send_buf_used + sizeof(struct vpi_cmd) > send_buf_size) {
+		size_t size = MAX(2 * send_buf_size, 16 * sizeof(struct vpi_cmd));
+		uint8_t *buf = realloc(send_buf, size);
+		if (!buf) {
+			LOG_ERROR("jtag_vpi: out of memory");
+			return ERROR_FAIL;
+		}
+		send_buf = buf;
+		send_buf_size = size;
+	}
+
+	memcpy(send_buf + send_buf_used, vpi, sizeof(struct vpi_cmd));
+	send_buf_used += sizeof(struct vpi_cmd);
+
+	return ERROR_OK;
+}
+
+static int jtag_vpi_write(const uint8_t *buf, size_t size)
+{
+	int retval;
+
 retry_write:
-	retval = write_socket(sockfd, vpi, sizeof(struct vpi_cmd));
+	retval = write_socket(sockfd, buf, size);
 
 	if (retval < 0) {
 		/* Account for the case when socket write is interrupted. */
@@ -144,15 +199,19 @@ retry_write:
 		/* TODO: Clean way how adapter drivers can report fatal errors
 		   to upper layers of OpenOCD and let it perform an orderly shutdown? */
 		exit(-1);
-	} else if (retval < (int)sizeof(struct vpi_cmd)) {
+	} else if (retval == 0) {
 		/* This means we could not send all data, which is most likely fatal
 		   for the jtag_vpi connection (the underlying TCP connection likely not
 		   usable anymore) */
 		LOG_ERROR("jtag_vpi: Could not send all data through jtag_vpi connection.");
 		exit(-1);
+	} else if ((size_t)retval < size) {
+		buf += retval;
+		size -= retval;
+		goto retry_write;
 	}
 
-	/* Otherwise the packet has been sent successfully. */
+	/* Otherwise the packets have been sent successfully. */
 	return ERROR_OK;
 }
 
@@ -195,6 +254,55 @@ static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
 	return ERROR_OK;
 }
 
+/**
+ * jtag_vpi_flush - send the queued commands and read back the replies
+ *
+ * The pending scans are completed with the data received.
+ */
+static int jtag_vpi_flush(void)
+{
+	int retval = ERROR_OK;
+
+	if (send_buf_used) {
+		retval = jtag_vpi_write(send_buf, send_buf_used);
+		send_buf_used = 0;
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	for (unsigned int i = 0; i < pending_xfers_len; i++) {
+		struct vpi_cmd vpi;
+		int nb_bits = pending_xfers[i].nb_bits;
+
+		retval = jtag_vpi_receive_cmd(&vpi);
+		if (retval != ERROR_OK)
+			return retval;
+
+		/* Optional low-level JTAG debug */
+		if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
+			char *char_buf = buf_to_hex_str(vpi.buffer_in,
+					(nb_bits > DEBUG_JTAG_IOZ) ? DEBUG_JTAG_IOZ : nb_bits);
+			LOG_DEBUG_IO("recvd JTAG VPI data: nb_bits=%d, buf_in=0x%s%s",
+				nb_bits, char_buf, (nb_bits > DEBUG_JTAG_IOZ) ? "(...)" : "");
+			free(char_buf);
+		}
+
+		if (pending_xfers[i].bits)
+			memcpy(pending_xfers[i].bits, vpi.buffer_in, DIV_ROUND_UP(nb_bits, 8));
+	}
+	pending_xfers_len = 0;
+
+	for (unsigned int i = 0; i < pending_scans_len; i++) {
+		int ret = jtag_read_buffer(pending_scans[i].buf, pending_scans[i].cmd);
+		if (ret != ERROR_OK && retval == ERROR_OK)
+			retval = ret;
+		free(pending_scans[i].buf);
+	}
+	pending_scans_len = 0;
+
+	return retval;
+}
+
 /**
  * jtag_vpi_reset - ask to reset the JTAG device
  * @param trst 1 if TRST is to be asserted
@@ -310,21 +418,13 @@ static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = jtag_vpi_receive_cmd(&vpi);
-	if (retval != ERROR_OK)
-		return retval;
+	/* the reply is read back by jtag_vpi_flush() */
+	pending_xfers[pending_xfers_len].bits = bits;
+	pending_xfers[pending_xfers_len].nb_bits = nb_bits;
+	pending_xfers_len++;
 
-	/* Optional low-level JTAG debug */
-	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
-		char *char_buf = buf_to_hex_str(vpi.buffer_in,
-				(nb_bits > DEBUG_JTAG_IOZ) ? DEBUG_JTAG_IOZ : nb_bits);
-		LOG_DEBUG_IO("recvd JTAG VPI data: nb_bits=%d, buf_in=0x%s%s",
-			nb_bits, char_buf, (nb_bits > DEBUG_JTAG_IOZ) ? "(...)" : "");
-		free(char_buf);
-	}
-
-	if (bits)
-		memcpy(bits, vpi.buffer_in, nb_bytes);
+	if (pending_xfers_len >= pipeline_depth)
+		return jtag_vpi_flush();
 
 	return ERROR_OK;
 }
@@ -425,11 +525,10 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 			tap_set_state(TAP_DRPAUSE);
 	}
 
-	retval = jtag_read_buffer(buf, cmd);
-	if (retval != ERROR_OK)
-		return retval;
-
-	free(buf);
+	/* the scan data is available once the replies have been read back */
+	pending_scans[pending_scans_len].cmd = cmd;
+	pending_scans[pending_scans_len].buf = buf;
+	pending_scans_len++;
 
 	if (cmd->end_state != TAP_DRSHIFT) {
 		retval = jtag_vpi_state_move(cmd->end_state);
@@ -508,6 +607,7 @@ static int jtag_vpi_execute_queue(void)
 			retval = jtag_vpi_tms(cmd->cmd.tms);
 			break;
 		case JTAG_SLEEP:
+			retval = jtag_vpi_flush();
 			jtag_sleep(cmd->cmd.sleep->us);
 			break;
 		case JTAG_SCAN:
@@ -521,6 +621,10 @@ static int jtag_vpi_execute_queue(void)
 		}
 	}
 
+	int flush_retval = jtag_vpi_flush();
+	if (retval == ERROR_OK)
+		retval = flush_retval;
+
 	return retval;
 }
 
@@ -574,7 +678,11 @@ static int jtag_vpi_stop_simulation(void)
 	cmd.length = 0;
 	cmd.nb_bits = 0;
 	cmd.cmd = CMD_STOP_SIMU;
-	return jtag_vpi_send_cmd(&cmd);
+	int retval = jtag_vpi_send_cmd(&cmd);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return jtag_vpi_flush();
 }
 
 static int jtag_vpi_quit(void)
@@ -588,6 +696,9 @@ static int jtag_vpi_quit(void)
 		log_socket_error("jtag_vpi");
 	}
 	free(server_address);
+	free(send_buf);
+	send_buf = NULL;
+	send_buf_size = 0;
 	return ERROR_OK;
 }
 
@@ -630,6 +741,25 @@ COMMAND_HANDLER(jtag_vpi_stop_sim_on_exit_handler)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(jtag_vpi_pipeline_depth_handler)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int depth;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], depth);
+		if (depth < 1 || depth > MAX_PENDING_XFERS) {
+			LOG_ERROR("jtag_vpi: pipeline depth must be between 1 and %d", MAX_PENDING_XFERS);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		pipeline_depth = depth;
+	}
+
+	command_print(CMD, "%u", pipeline_depth);
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 	{
 		.name = "set_port",
@@ -653,6 +783,14 @@ static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 			"before OpenOCD exits (default: off)",
 		.usage = "<on|off>",
 	},
+	{
+		.name = "pipeline_depth",
+		.handler = &jtag_vpi_pipeline_depth_handler,
+		.mode = COMMAND_ANY,
+		.help = "set or show the number of scan replies that may be pending "
+			"before reading them back (default: 32)",
+		.usage = "[1-64]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
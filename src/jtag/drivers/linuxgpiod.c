@@ -22,6 +22,25 @@
 static struct gpiod_chip *gpiod_chip[ADAPTER_GPIO_IDX_NUM] = {};
 static struct gpiod_line *gpiod_line[ADAPTER_GPIO_IDX_NUM] = {};
 
+/*
+ * When TDI, TMS and TCK share the same gpiochip and the same configuration
+ * they are requested together and updated with a single ioctl per edge.
+ * Order of the lines in the bulk is the order of the values passed to
+ * gpiod_line_set_value_bulk().
+ */
+static const enum adapter_gpio_config_index jtag_bulk_idx[] = {
+	ADAPTER_GPIO_IDX_TDI,
+	ADAPTER_GPIO_IDX_TMS,
+	ADAPTER_GPIO_IDX_TCK,
+};
+static struct gpiod_line_bulk jtag_bulk;
+static bool jtag_bulk_requested;
+
+#ifdef HAVE_LIBGPIOD_SET_DIRECTION
+/* cleared if the kernel lacks GPIO_GET_LINE_SET_CONFIG ioctl */
+static bool swdio_set_direction = true;
+#endif
+
 static int last_swclk;
 static int last_swdio;
 static bool last_stored;
@@ -80,6 +99,31 @@ static int linuxgpiod_write(int tck, int tms, int tdi)
 		first_time = 1;
 	}
 
+	if (jtag_bulk_requested) {
+		if (tdi == last_tdi && tms == last_tms && tck == last_tck)
+			return ERROR_OK;
+
+		int values[] = { tdi, tms, last_tck };
+
+		/* on a rising edge, let tdi and tms settle before moving clk */
+		if (tck && !last_tck && (tdi != last_tdi || tms != last_tms)) {
+			retval = gpiod_line_set_value_bulk(&jtag_bulk, values);
+			if (retval < 0)
+				LOG_WARNING("writing tdi/tms failed");
+		}
+
+		values[2] = tck;
+		retval = gpiod_line_set_value_bulk(&jtag_bulk, values);
+		if (retval < 0)
+			LOG_WARNING("writing tdi/tms/tck failed");
+
+		last_tdi = tdi;
+		last_tms = tms;
+		last_tck = tck;
+
+		return ERROR_OK;
+	}
+
 	if (tdi != last_tdi) {
 		retval = gpiod_line_set_value(gpiod_line[ADAPTER_GPIO_IDX_TDI], tdi);
 		if (retval < 0)
@@ -119,14 +163,62 @@ static int linuxgpiod_swdio_read(void)
 	return retval;
 }
 
+#ifdef HAVE_LIBGPIOD_SET_DIRECTION
+/*
+ * Change the direction of swdio in place, without releasing the line.
+ * Return false if the kernel does not support it.
+ */
+static bool linuxgpiod_swdio_set_direction(bool is_output)
+{
+	struct gpiod_line *swdio = gpiod_line[ADAPTER_GPIO_IDX_SWDIO];
+	struct gpiod_line *swdio_dir = gpiod_line[ADAPTER_GPIO_IDX_SWDIO_DIR];
+	int retval;
+
+	if (is_output) {
+		if (swdio_dir) {
+			retval = gpiod_line_set_value(swdio_dir, 1);
+			if (retval < 0)
+				LOG_WARNING("Fail set swdio_dir");
+		}
+		retval = gpiod_line_set_direction_output(swdio, 1);
+	} else {
+		retval = gpiod_line_set_direction_input(swdio);
+		if (retval == 0 && swdio_dir) {
+			retval = gpiod_line_set_value(swdio_dir, 0);
+			if (retval < 0)
+				LOG_WARNING("Fail set swdio_dir");
+			retval = 0;
+		}
+	}
+
+	if (retval < 0) {
+		LOG_DEBUG("linuxgpiod: in place direction change of swdio not supported");
+		return false;
+	}
+
+	return true;
+}
+#endif
+
 static void linuxgpiod_swdio_drive(bool is_output)
 {
 	int retval;
 
+#ifdef HAVE_LIBGPIOD_SET_DIRECTION
+	if (swdio_set_direction) {
+		if (linuxgpiod_swdio_set_direction(is_output)) {
+			last_stored = false;
+			swdio_input = !is_output;
+			return;
+		}
+		swdio_set_direction = false;
+	}
+#endif
+
 	/*
-	 * FIXME: change direction requires release and re-require the line
+	 * Without GPIO_GET_LINE_SET_CONFIG ioctl (Linux v5.5) or libgpiod v1.5,
+	 * changing direction requires releasing and re-requesting the line.
 	 * https://stackoverflow.com/questions/58735140/
-	 * this would change in future libgpiod
 	 */
 	gpiod_line_release(gpiod_line[ADAPTER_GPIO_IDX_SWDIO]);
 
@@ -254,46 +346,33 @@ static bool linuxgpiod_swd_mode_possible(void)
 	return true;
 }
 
-static inline void helper_release(enum adapter_gpio_config_index idx)
-{
-	if (gpiod_line[idx]) {
-		gpiod_line_release(gpiod_line[idx]);
-		gpiod_line[idx] = NULL;
-	}
-	if (gpiod_chip[idx]) {
-		gpiod_chip_close(gpiod_chip[idx]);
-		gpiod_chip[idx] = NULL;
-	}
-}
-
 static int linuxgpiod_quit(void)
 {
 	LOG_DEBUG("linuxgpiod_quit");
-	for (int i = 0; i < ADAPTER_GPIO_IDX_NUM; ++i)
-		helper_release(i);
+
+	/* lines of the jtag bulk belong to a single chip, release all lines first */
+	for (int i = 0; i < ADAPTER_GPIO_IDX_NUM; ++i) {
+		if (gpiod_line[i]) {
+			gpiod_line_release(gpiod_line[i]);
+			gpiod_line[i] = NULL;
+		}
+	}
+	for (int i = 0; i < ADAPTER_GPIO_IDX_NUM; ++i) {
+		if (gpiod_chip[i]) {
+			gpiod_chip_close(gpiod_chip[i]);
+			gpiod_chip[i] = NULL;
+		}
+	}
+	jtag_bulk_requested = false;
 
 	return ERROR_OK;
 }
 
-static int helper_get_line(enum adapter_gpio_config_index idx)
+/* Translate the "adapter gpio" configuration in a libgpiod request */
+static void helper_line_config(enum adapter_gpio_config_index idx,
+	struct gpiod_line_request_config *config, int *value)
 {
-	if (!is_gpio_config_valid(idx))
-		return ERROR_OK;
-
-	int dir = GPIOD_LINE_REQUEST_DIRECTION_INPUT, flags = 0, val = 0, retval;
-
-	gpiod_chip[idx] = gpiod_chip_open_by_number(adapter_gpio_config[idx].chip_num);
-	if (!gpiod_chip[idx]) {
-		LOG_ERROR("Cannot open LinuxGPIOD chip %d for %s", adapter_gpio_config[idx].chip_num,
-			adapter_gpio_get_name(idx));
-		return ERROR_JTAG_INIT_FAILED;
-	}
-
-	gpiod_line[idx] = gpiod_chip_get_line(gpiod_chip[idx], adapter_gpio_config[idx].gpio_num);
-	if (!gpiod_line[idx]) {
-		LOG_ERROR("Error get line %s", adapter_gpio_get_name(idx));
-		return ERROR_JTAG_INIT_FAILED;
-	}
+	int dir = GPIOD_LINE_REQUEST_DIRECTION_INPUT, flags = 0, val = 0;
 
 	switch (adapter_gpio_config[idx].init_state) {
 	case ADAPTER_GPIO_INIT_STATE_INPUT:
@@ -347,11 +426,36 @@ static int helper_get_line(enum adapter_gpio_config_index idx)
 	if (adapter_gpio_config[idx].active_low)
 		flags |= GPIOD_LINE_REQUEST_FLAG_ACTIVE_LOW;
 
-	struct gpiod_line_request_config config = {
+	*config = (struct gpiod_line_request_config) {
 		.consumer = "OpenOCD",
 		.request_type = dir,
 		.flags = flags,
 	};
+	*value = val;
+}
+
+static int helper_get_line(enum adapter_gpio_config_index idx)
+{
+	if (!is_gpio_config_valid(idx))
+		return ERROR_OK;
+
+	struct gpiod_line_request_config config;
+	int val, retval;
+
+	gpiod_chip[idx] = gpiod_chip_open_by_number(adapter_gpio_config[idx].chip_num);
+	if (!gpiod_chip[idx]) {
+		LOG_ERROR("Cannot open LinuxGPIOD chip %d for %s", adapter_gpio_config[idx].chip_num,
+			adapter_gpio_get_name(idx));
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	gpiod_line[idx] = gpiod_chip_get_line(gpiod_chip[idx], adapter_gpio_config[idx].gpio_num);
+	if (!gpiod_line[idx]) {
+		LOG_ERROR("Error get line %s", adapter_gpio_get_name(idx));
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	helper_line_config(idx, &config, &val);
 
 	retval = gpiod_line_request(gpiod_line[idx], &config, val);
 	if (retval < 0) {
@@ -362,6 +466,80 @@ static int helper_get_line(enum adapter_gpio_config_index idx)
 	return ERROR_OK;
 }
 
+/*
+ * A single request for TDI, TMS and TCK is possible only if they are outputs
+ * on the same gpiochip with same flags; libgpiod v1 applies one set of flags
+ * to all the lines in a request.
+ */
+static bool linuxgpiod_jtag_bulk_possible(void)
+{
+	const struct adapter_gpio_config *tck = &adapter_gpio_config[ADAPTER_GPIO_IDX_TCK];
+
+	for (size_t i = 0; i < ARRAY_SIZE(jtag_bulk_idx); i++) {
+		const struct adapter_gpio_config *cfg = &adapter_gpio_config[jtag_bulk_idx[i]];
+
+		if (cfg->init_state == ADAPTER_GPIO_INIT_STATE_INPUT)
+			return false;
+		if (cfg->chip_num != tck->chip_num || cfg->drive != tck->drive ||
+			cfg->pull != tck->pull || cfg->active_low != tck->active_low)
+			return false;
+	}
+	return true;
+}
+
+static int helper_get_jtag_bulk(void)
+{
+	enum adapter_gpio_config_index chip_idx = jtag_bulk_idx[0];
+	struct gpiod_line_request_config config;
+	int vals[ARRAY_SIZE(jtag_bulk_idx)];
+	int retval;
+
+	gpiod_chip[chip_idx] = gpiod_chip_open_by_number(adapter_gpio_config[chip_idx].chip_num);
+	if (!gpiod_chip[chip_idx]) {
+		LOG_ERROR("Cannot open LinuxGPIOD chip %d for %s", adapter_gpio_config[chip_idx].chip_num,
+			adapter_gpio_get_name(chip_idx));
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	gpiod_line_bulk_init(&jtag_bulk);
+	for (size_t i = 0; i < ARRAY_SIZE(jtag_bulk_idx); i++) {
+		enum adapter_gpio_config_index idx = jtag_bulk_idx[i];
+
+		gpiod_line[idx] = gpiod_chip_get_line(gpiod_chip[chip_idx], adapter_gpio_config[idx].gpio_num);
+		if (!gpiod_line[idx]) {
+			LOG_ERROR("Error get line %s", adapter_gpio_get_name(idx));
+			return ERROR_JTAG_INIT_FAILED;
+		}
+		/* flags are identical, only the initial value differs */
+		helper_line_config(idx, &config, &vals[i]);
+		gpiod_line_bulk_add(&jtag_bulk, gpiod_line[idx]);
+	}
+
+	retval = gpiod_line_request_bulk(&jtag_bulk, &config, vals);
+	if (retval < 0) {
+		LOG_ERROR("Error requesting gpio lines tdi, tms and tck");
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	jtag_bulk_requested = true;
+	LOG_DEBUG("linuxgpiod: tdi, tms and tck driven with a single request");
+
+	return ERROR_OK;
+}
+
+static int helper_get_jtag_lines(void)
+{
+	if (linuxgpiod_jtag_bulk_possible())
+		return helper_get_jtag_bulk();
+
+	if (helper_get_line(ADAPTER_GPIO_IDX_TDI) != ERROR_OK ||
+		helper_get_line(ADAPTER_GPIO_IDX_TCK) != ERROR_OK ||
+		helper_get_line(ADAPTER_GPIO_IDX_TMS) != ERROR_OK)
+		return ERROR_JTAG_INIT_FAILED;
+
+	return ERROR_OK;
+}
+
 static int linuxgpiod_init(void)
 {
 	LOG_INFO("Linux GPIOD JTAG/SWD bitbang driver");
@@ -381,9 +559,7 @@ static int linuxgpiod_init(void)
 		}
 
 		if (helper_get_line(ADAPTER_GPIO_IDX_TDO) != ERROR_OK ||
-			helper_get_line(ADAPTER_GPIO_IDX_TDI) != ERROR_OK ||
-			helper_get_line(ADAPTER_GPIO_IDX_TCK) != ERROR_OK ||
-			helper_get_line(ADAPTER_GPIO_IDX_TMS) != ERROR_OK ||
+			helper_get_jtag_lines() != ERROR_OK ||
 			helper_get_line(ADAPTER_GPIO_IDX_TRST) != ERROR_OK)
 				goto out_error;
 	}
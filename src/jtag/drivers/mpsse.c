@@ -73,6 +73,8 @@ struct mpsse_ctx {
 	unsigned read_chunk_size;
 	struct bit_copy_queue read_queue;
 	int retval;
+	unsigned int transfer_depth;
+	struct mpsse_stats stats;
 };
 
 /* Returns true if the string descriptor indexed by str_index in device matches string */
@@ -335,6 +337,7 @@ struct mpsse_ctx *mpsse_open(const uint16_t vids[], const uint16_t pids[], const
 	ctx->index = channel + 1;
 	ctx->usb_read_timeout = 5000;
 	ctx->usb_write_timeout = 5000;
+	ctx->transfer_depth = MPSSE_DEFAULT_TRANSFERS;
 
 	err = libusb_init(&ctx->usb_ctx);
 	if (err != LIBUSB_SUCCESS) {
@@ -400,6 +403,20 @@ bool mpsse_is_high_speed(struct mpsse_ctx *ctx)
 	return ctx->type != TYPE_FT2232C;
 }
 
+void mpsse_set_transfer_depth(struct mpsse_ctx *ctx, unsigned int depth)
+{
+	if (depth < 1)
+		depth = 1;
+	if (depth > MPSSE_MAX_TRANSFERS)
+		depth = MPSSE_MAX_TRANSFERS;
+	ctx->transfer_depth = depth;
+}
+
+void mpsse_get_stats(struct mpsse_ctx *ctx, struct mpsse_stats *stats)
+{
+	*stats = ctx->stats;
+}
+
 void mpsse_purge(struct mpsse_ctx *ctx)
 {
 	int err;
@@ -758,49 +775,71 @@ int mpsse_set_frequency(struct mpsse_ctx *ctx, int frequency)
 	return frequency;
 }
 
-/* Context needed by the callbacks */
+/* Context needed by the callbacks, one for each direction */
 struct transfer_result {
 	struct mpsse_ctx *ctx;
 	bool done;
-	unsigned transferred;
+	bool failed;
+	unsigned int transferred;
+	unsigned int in_flight;
 };
 
+static void transfer_submitted(struct transfer_result *res, struct mpsse_ctx *ctx,
+		struct transfer_result *other)
+{
+	res->in_flight++;
+	if (res->in_flight + other->in_flight > ctx->stats.peak_in_flight)
+		ctx->stats.peak_in_flight = res->in_flight + other->in_flight;
+}
+
 static LIBUSB_CALL void read_cb(struct libusb_transfer *transfer)
 {
 	struct transfer_result *res = transfer->user_data;
 	struct mpsse_ctx *ctx = res->ctx;
 
-	unsigned packet_size = ctx->max_packet_size;
+	unsigned int packet_size = ctx->max_packet_size;
+
+	res->in_flight--;
+
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED)
+		return;
 
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
 	/* Strip the two status bytes sent at the beginning of each USB packet
-	 * while copying the chunk buffer to the read buffer */
-	unsigned num_packets = DIV_ROUND_UP(transfer->actual_length, packet_size);
-	unsigned chunk_remains = transfer->actual_length;
-	for (unsigned i = 0; i < num_packets && chunk_remains > 2; i++) {
-		unsigned this_size = packet_size - 2;
+	 * while copying the chunk buffer to the read buffer. The in-flight read
+	 * transfers complete in the order they were submitted, so the payload
+	 * can simply be appended. */
+	unsigned int num_packets = DIV_ROUND_UP(transfer->actual_length, packet_size);
+	unsigned int chunk_remains = transfer->actual_length;
+	for (unsigned int i = 0; i < num_packets && chunk_remains > 2 && !res->done; i++) {
+		unsigned int this_size = packet_size - 2;
 		if (this_size > chunk_remains - 2)
 			this_size = chunk_remains - 2;
 		if (this_size > ctx->read_count - res->transferred)
 			this_size = ctx->read_count - res->transferred;
 		memcpy(ctx->read_buffer + res->transferred,
-			ctx->read_chunk + packet_size * i + 2,
+			transfer->buffer + packet_size * i + 2,
 			this_size);
 		res->transferred += this_size;
 		chunk_remains -= this_size + 2;
-		if (res->transferred == ctx->read_count) {
+		if (res->transferred == ctx->read_count)
 			res->done = true;
-			break;
-		}
 	}
 
 	LOG_DEBUG_IO("raw chunk %d, transferred %d of %d", transfer->actual_length, res->transferred,
 		ctx->read_count);
 
-	if (!res->done)
-		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
-			res->done = true;
+	if (res->done || res->failed)
+		return;
+
+	/* Requeue at the tail of the ring */
+	if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS) {
+		res->failed = true;
+		return;
+	}
+	res->in_flight++;
+	ctx->stats.read_transfers++;
 }
 
 static LIBUSB_CALL void write_cb(struct libusb_transfer *transfer)
@@ -808,20 +847,44 @@ static LIBUSB_CALL void write_cb(struct libusb_transfer *transfer)
 	struct transfer_result *res = transfer->user_data;
 	struct mpsse_ctx *ctx = res->ctx;
 
+	res->in_flight--;
+
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED)
+		return;
+
 	res->transferred += transfer->actual_length;
 
 	LOG_DEBUG_IO("transferred %d of %d", res->transferred, ctx->write_count);
 
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
-	if (res->transferred == ctx->write_count)
+	if (res->transferred == ctx->write_count) {
 		res->done = true;
-	else {
-		transfer->length = ctx->write_count - res->transferred;
-		transfer->buffer = ctx->write_buffer + res->transferred;
-		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
-			res->done = true;
+		return;
+	}
+
+	/* Only the last segment can be completed by resubmitting the remainder,
+	 * any other short write would reorder the MPSSE command stream */
+	uint8_t *end = transfer->buffer + transfer->length;
+	if (end != ctx->write_buffer + ctx->write_count || res->in_flight) {
+		res->failed = true;
+		return;
+	}
+
+	transfer->buffer += transfer->actual_length;
+	transfer->length = end - transfer->buffer;
+	if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS) {
+		res->failed = true;
+		return;
 	}
+	res->in_flight++;
+	ctx->stats.write_transfers++;
+}
+
+static void cancel_transfers(struct libusb_transfer **transfers, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+		libusb_cancel_transfer(transfers[i]);
 }
 
 int mpsse_flush(struct mpsse_ctx *ctx)
@@ -842,8 +905,14 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 	if (ctx->write_count == 0)
 		return retval;
 
-	struct libusb_transfer *read_transfer = 0;
+	unsigned int packet_size = ctx->max_packet_size;
+	struct libusb_transfer *write_transfers[MPSSE_MAX_TRANSFERS];
+	struct libusb_transfer *read_transfers[MPSSE_MAX_TRANSFERS];
+	unsigned int num_writes = 0;
+	unsigned int num_reads = 0;
 	struct transfer_result read_result = { .ctx = ctx, .done = true };
+	struct transfer_result write_result = { .ctx = ctx, .done = false };
+
 	if (ctx->read_count) {
 		buffer_write_byte(ctx, 0x87); /* SEND_IMMEDIATE */
 		read_result.done = false;
@@ -851,30 +920,77 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 		   immediately after processing the MPSSE commands in the write transaction */
 	}
 
-	struct transfer_result write_result = { .ctx = ctx, .done = false };
-	struct libusb_transfer *write_transfer = libusb_alloc_transfer(0);
-	libusb_fill_bulk_transfer(write_transfer, ctx->usb_dev, ctx->out_ep, ctx->write_buffer,
-		ctx->write_count, write_cb, &write_result, ctx->usb_write_timeout);
-	retval = libusb_submit_transfer(write_transfer);
-	if (retval != LIBUSB_SUCCESS)
-		goto error_check;
+	ctx->stats.flushes++;
+	ctx->stats.bytes_written += ctx->write_count;
+	ctx->stats.bytes_read += ctx->read_count;
+
+	/* Split the write buffer in packet aligned segments that are all queued
+	 * at once, so the host controller never waits for us to refill the pipe */
+	unsigned int segments = MIN(ctx->transfer_depth, DIV_ROUND_UP(ctx->write_count, packet_size));
+	unsigned int segment_size = DIV_ROUND_UP(DIV_ROUND_UP(ctx->write_count, segments),
+			packet_size) * packet_size;
+	for (unsigned int offset = 0; offset < ctx->write_count; offset += segment_size) {
+		struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+		if (!transfer) {
+			retval = LIBUSB_ERROR_NO_MEM;
+			goto cancel;
+		}
+		write_transfers[num_writes++] = transfer;
+		libusb_fill_bulk_transfer(transfer, ctx->usb_dev, ctx->out_ep,
+			ctx->write_buffer + offset, MIN(segment_size, ctx->write_count - offset),
+			write_cb, &write_result, ctx->usb_write_timeout);
+		retval = libusb_submit_transfer(transfer);
+		if (retval != LIBUSB_SUCCESS)
+			goto cancel;
+		transfer_submitted(&write_result, ctx, &read_result);
+		ctx->stats.write_transfers++;
+	}
 
 	if (ctx->read_count) {
-		read_transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(read_transfer, ctx->usb_dev, ctx->in_ep, ctx->read_chunk,
-			ctx->read_chunk_size, read_cb, &read_result,
-			ctx->usb_read_timeout);
-		retval = libusb_submit_transfer(read_transfer);
-		if (retval != LIBUSB_SUCCESS)
-			goto error_check;
+		/* Size the ring of read transfers to the expected reply, including
+		 * the two status bytes the chip prepends to every packet */
+		unsigned int expected = ctx->read_count +
+			2 * DIV_ROUND_UP(ctx->read_count, packet_size - 2);
+		unsigned int chunk_size = ctx->read_chunk_size / ctx->transfer_depth / packet_size * packet_size;
+		unsigned int chunks = MIN(ctx->transfer_depth, DIV_ROUND_UP(expected, chunk_size));
+		if (chunks == 1)
+			chunk_size = ctx->read_chunk_size;
+		for (unsigned int i = 0; i < chunks; i++) {
+			struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+			if (!transfer) {
+				retval = LIBUSB_ERROR_NO_MEM;
+				goto cancel;
+			}
+			read_transfers[num_reads++] = transfer;
+			libusb_fill_bulk_transfer(transfer, ctx->usb_dev, ctx->in_ep,
+				ctx->read_chunk + i * chunk_size, chunk_size, read_cb, &read_result,
+				ctx->usb_read_timeout);
+			retval = libusb_submit_transfer(transfer);
+			if (retval != LIBUSB_SUCCESS)
+				goto cancel;
+			transfer_submitted(&read_result, ctx, &write_result);
+			ctx->stats.read_transfers++;
+		}
 	}
 
 	/* Polling loop, more or less taken from libftdi */
 	int64_t start = timeval_ms();
 	int64_t warn_after = 2000;
-	while (!write_result.done || !read_result.done) {
+	bool reads_cancelled = false;
+	while (write_result.in_flight || read_result.in_flight) {
 		struct timeval timeout_usb;
 
+		if (write_result.failed || read_result.failed) {
+			retval = LIBUSB_ERROR_IO;
+			goto cancel;
+		}
+
+		/* All data is in, retire the spare reads still waiting in the ring */
+		if (read_result.done && read_result.in_flight && !reads_cancelled) {
+			cancel_transfers(read_transfers, num_reads);
+			reads_cancelled = true;
+		}
+
 		timeout_usb.tv_sec = 1;
 		timeout_usb.tv_usec = 0;
 
@@ -883,17 +999,8 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 		if (retval == LIBUSB_ERROR_NO_DEVICE || retval == LIBUSB_ERROR_INTERRUPTED)
 			break;
 
-		if (retval != LIBUSB_SUCCESS) {
-			libusb_cancel_transfer(write_transfer);
-			if (read_transfer)
-				libusb_cancel_transfer(read_transfer);
-			while (!write_result.done || !read_result.done) {
-				retval = libusb_handle_events_timeout_completed(ctx->usb_ctx,
-								&timeout_usb, NULL);
-				if (retval != LIBUSB_SUCCESS)
-					break;
-			}
-		}
+		if (retval != LIBUSB_SUCCESS)
+			goto cancel;
 
 		int64_t now = timeval_ms();
 		if (now - start > warn_after) {
@@ -903,6 +1010,20 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 		}
 	}
 
+	if (retval == LIBUSB_SUCCESS && (write_result.failed || read_result.failed))
+		retval = LIBUSB_ERROR_IO;
+	goto error_check;
+
+cancel:
+	cancel_transfers(write_transfers, num_writes);
+	cancel_transfers(read_transfers, num_reads);
+	while (write_result.in_flight || read_result.in_flight) {
+		struct timeval timeout_usb = { .tv_sec = 1, .tv_usec = 0 };
+		if (libusb_handle_events_timeout_completed(ctx->usb_ctx, &timeout_usb,
+					NULL) != LIBUSB_SUCCESS)
+			break;
+	}
+
 error_check:
 	if (retval != LIBUSB_SUCCESS) {
 		LOG_ERROR("libusb_handle_events() failed with %s", libusb_error_name(retval));
@@ -931,9 +1052,10 @@ error_check:
 	if (retval != ERROR_OK)
 		mpsse_purge(ctx);
 
-	libusb_free_transfer(write_transfer);
-	if (read_transfer)
-		libusb_free_transfer(read_transfer);
+	for (unsigned int i = 0; i < num_writes; i++)
+		libusb_free_transfer(write_transfers[i]);
+	for (unsigned int i = 0; i < num_reads; i++)
+		libusb_free_transfer(read_transfers[i]);
 
 	return retval;
 }
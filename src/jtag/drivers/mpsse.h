@@ -28,11 +28,26 @@ enum ftdi_chip_type {
 
 struct mpsse_ctx;
 
+/* Number of USB transfers per direction mpsse_flush() keeps in flight */
+#define MPSSE_DEFAULT_TRANSFERS 4
+#define MPSSE_MAX_TRANSFERS 8
+
+struct mpsse_stats {
+	uint64_t flushes;
+	uint64_t write_transfers;
+	uint64_t read_transfers;
+	uint64_t bytes_written;
+	uint64_t bytes_read;
+	unsigned int peak_in_flight;
+};
+
 /* Device handling */
 struct mpsse_ctx *mpsse_open(const uint16_t *vid, const uint16_t *pid, const char *description,
 	const char *serial, const char *location, int channel);
 void mpsse_close(struct mpsse_ctx *ctx);
 bool mpsse_is_high_speed(struct mpsse_ctx *ctx);
+void mpsse_set_transfer_depth(struct mpsse_ctx *ctx, unsigned int depth);
+void mpsse_get_stats(struct mpsse_ctx *ctx, struct mpsse_stats *stats);
 
 /* Command queuing. These correspond to the MPSSE commands with the same names, but no need to care
  * about bit/byte transfer or data length limitation. Read data is guaranteed to be available only
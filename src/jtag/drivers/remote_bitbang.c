@@ -16,21 +16,40 @@
 #endif
 #include "helper/system.h"
 #include "helper/replacements.h"
+#include "helper/bits.h"
+#include "helper/time_support.h"
 #include <jtag/interface.h>
+#include <jtag/swd.h>
+#include <transport/transport.h>
 #include "bitbang.h"
 
 /* arbitrary limit on host name length: */
 #define REMOTE_BITBANG_HOST_MAX 255
 
+/* Capabilities reported by the server in its reply to the 'X' query */
+#define REMOTE_BITBANG_CAP_JTAG		BIT(0)
+#define REMOTE_BITBANG_CAP_SWD		BIT(1)
+
+/* How long to wait for the reply to the 'X' query */
+#define REMOTE_BITBANG_EXT_TIMEOUT_MS	200
+
+/* Max number of TCK cycles in a packed JTAG frame */
+#define REMOTE_BITBANG_FRAME_BITS	8192
+/* Max number of TDO capturing frames waiting for their reply */
+#define REMOTE_BITBANG_MAX_PENDING_FRAMES	8
+/* Max number of queued SWD transactions */
+#define REMOTE_BITBANG_SWD_QUEUE_SIZE	128
+
 static char *remote_bitbang_host;
 static char *remote_bitbang_port;
+static bool remote_bitbang_use_ext = true;
 
 static int remote_bitbang_fd;
-static uint8_t remote_bitbang_send_buf[512];
+static uint8_t remote_bitbang_send_buf[4096];
 static unsigned int remote_bitbang_send_buf_used;
 
 /* Circular buffer. When start == end, the buffer is empty. */
-static char remote_bitbang_recv_buf[256];
+static uint8_t remote_bitbang_recv_buf[4096];
 static unsigned int remote_bitbang_recv_buf_start;
 static unsigned int remote_bitbang_recv_buf_end;
 
@@ -148,6 +167,205 @@ static int remote_bitbang_queue(int c, flush_bool_t flush)
 	return ERROR_OK;
 }
 
+static int remote_bitbang_queue_buf(const uint8_t *buf, unsigned int size)
+{
+	while (size) {
+		unsigned int n = MIN(size, ARRAY_SIZE(remote_bitbang_send_buf) -
+				remote_bitbang_send_buf_used);
+		memcpy(remote_bitbang_send_buf + remote_bitbang_send_buf_used, buf, n);
+		remote_bitbang_send_buf_used += n;
+		buf += n;
+		size -= n;
+		if (remote_bitbang_send_buf_used >= ARRAY_SIZE(remote_bitbang_send_buf))
+			if (remote_bitbang_flush() != ERROR_OK)
+				return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+/* Return the next received byte, or a negative value on error */
+static int remote_bitbang_read_byte(void)
+{
+	if (remote_bitbang_recv_buf_empty()) {
+		if (remote_bitbang_fill_buf(BLOCK) != ERROR_OK)
+			return -1;
+	}
+	assert(!remote_bitbang_recv_buf_empty());
+	int c = remote_bitbang_recv_buf[remote_bitbang_recv_buf_start];
+	remote_bitbang_recv_buf_start =
+		(remote_bitbang_recv_buf_start + 1) % sizeof(remote_bitbang_recv_buf);
+	return c;
+}
+
+/*
+ * Packed JTAG mode.
+ *
+ * The write() calls from the bitbang layer are collected in 'J' frames,
+ * each pair of TCK low/TCK high writes becoming one bit of the frame. The
+ * TDO samples of a frame come back packed in its reply. Anything that
+ * does not fit a frame falls back to the ASCII commands.
+ */
+static bool remote_bitbang_packed;
+
+static struct {
+	uint8_t tms[REMOTE_BITBANG_FRAME_BITS / 8];
+	uint8_t tdi[REMOTE_BITBANG_FRAME_BITS / 8];
+	unsigned int bits;
+	bool capture;
+} remote_bitbang_frame;
+
+struct remote_bitbang_pins {
+	int tck;
+	int tms;
+	int tdi;
+};
+
+/* levels requested by the bitbang layer, and levels the server is left
+ * with once it has processed all the commands sent so far */
+static struct remote_bitbang_pins remote_bitbang_pins_wanted = { -1, -1, -1 };
+static struct remote_bitbang_pins remote_bitbang_pins_sent = { -1, -1, -1 };
+static bool remote_bitbang_sample_pending;
+
+/* sizes of the frames whose TDO reply is still to be read */
+static unsigned int remote_bitbang_pending_frames[REMOTE_BITBANG_MAX_PENDING_FRAMES];
+static unsigned int remote_bitbang_pending_first;
+static unsigned int remote_bitbang_pending_count;
+
+/* reply being read */
+static unsigned int remote_bitbang_tdo_bits_left;
+static unsigned int remote_bitbang_tdo_bit;
+static uint8_t remote_bitbang_tdo_byte;
+
+static int remote_bitbang_frame_flush(void)
+{
+	unsigned int bits = remote_bitbang_frame.bits;
+
+	if (!bits)
+		return ERROR_OK;
+
+	if (remote_bitbang_frame.capture) {
+		if (remote_bitbang_pending_count == REMOTE_BITBANG_MAX_PENDING_FRAMES) {
+			LOG_ERROR("BUG: too many remote_bitbang frames waiting for TDO");
+			return ERROR_FAIL;
+		}
+		remote_bitbang_pending_frames[(remote_bitbang_pending_first + remote_bitbang_pending_count) %
+				REMOTE_BITBANG_MAX_PENDING_FRAMES] = bits;
+		remote_bitbang_pending_count++;
+	}
+
+	uint8_t header[4] = { 'J', bits & 0xff, bits >> 8, remote_bitbang_frame.capture ? 1 : 0 };
+	remote_bitbang_frame.bits = 0;
+
+	if (remote_bitbang_queue_buf(header, sizeof(header)) != ERROR_OK)
+		return ERROR_FAIL;
+	if (remote_bitbang_queue_buf(remote_bitbang_frame.tms, DIV_ROUND_UP(bits, 8)) != ERROR_OK)
+		return ERROR_FAIL;
+	return remote_bitbang_queue_buf(remote_bitbang_frame.tdi, DIV_ROUND_UP(bits, 8));
+}
+
+static bool remote_bitbang_pins_equal(const struct remote_bitbang_pins *a,
+		const struct remote_bitbang_pins *b)
+{
+	return a->tck == b->tck && a->tms == b->tms && a->tdi == b->tdi;
+}
+
+/* Send the pending frame and bring the server pins to the requested levels */
+static int remote_bitbang_sync_pins(void)
+{
+	if (remote_bitbang_frame_flush() != ERROR_OK)
+		return ERROR_FAIL;
+
+	const struct remote_bitbang_pins *w = &remote_bitbang_pins_wanted;
+	if (remote_bitbang_pins_equal(w, &remote_bitbang_pins_sent))
+		return ERROR_OK;
+
+	remote_bitbang_pins_sent = *w;
+	char c = '0' + ((w->tck ? 0x4 : 0x0) | (w->tms ? 0x2 : 0x0) | (w->tdi ? 0x1 : 0x0));
+	return remote_bitbang_queue(c, NO_FLUSH);
+}
+
+static int remote_bitbang_write_packed(int tck, int tms, int tdi)
+{
+	struct remote_bitbang_pins pins = { !!tck, !!tms, !!tdi };
+
+	if (!pins.tck) {
+		remote_bitbang_pins_wanted = pins;
+		return ERROR_OK;
+	}
+
+	if (remote_bitbang_pins_wanted.tck) {
+		/* no rising edge, nothing to pack */
+		if (remote_bitbang_pins_equal(&pins, &remote_bitbang_pins_wanted))
+			return ERROR_OK;
+		remote_bitbang_pins_wanted = pins;
+		return remote_bitbang_sync_pins();
+	}
+
+	if (remote_bitbang_frame.bits == REMOTE_BITBANG_FRAME_BITS ||
+			(remote_bitbang_frame.bits &&
+			 remote_bitbang_frame.capture != remote_bitbang_sample_pending)) {
+		if (remote_bitbang_frame_flush() != ERROR_OK)
+			return ERROR_FAIL;
+	}
+
+	unsigned int i = remote_bitbang_frame.bits++;
+	if (i % 8 == 0) {
+		remote_bitbang_frame.tms[i / 8] = 0;
+		remote_bitbang_frame.tdi[i / 8] = 0;
+	}
+	remote_bitbang_frame.tms[i / 8] |= pins.tms << (i % 8);
+	remote_bitbang_frame.tdi[i / 8] |= pins.tdi << (i % 8);
+	remote_bitbang_frame.capture = remote_bitbang_sample_pending;
+	remote_bitbang_sample_pending = false;
+
+	remote_bitbang_pins_wanted = pins;
+	remote_bitbang_pins_sent = pins;
+
+	return ERROR_OK;
+}
+
+static int remote_bitbang_sample_packed(void)
+{
+	if (remote_bitbang_pins_wanted.tck != 0) {
+		LOG_ERROR("BUG: remote_bitbang TDO sampled with TCK high");
+		return ERROR_FAIL;
+	}
+	remote_bitbang_sample_pending = true;
+
+	/* keep the server from blocking on its replies */
+	return remote_bitbang_fill_buf(NO_BLOCK);
+}
+
+static bb_value_t remote_bitbang_read_sample_packed(void)
+{
+	if (!remote_bitbang_tdo_bits_left) {
+		if (!remote_bitbang_pending_count && remote_bitbang_frame_flush() != ERROR_OK)
+			return BB_ERROR;
+		if (!remote_bitbang_pending_count) {
+			LOG_ERROR("BUG: no remote_bitbang TDO sample pending");
+			return BB_ERROR;
+		}
+		remote_bitbang_tdo_bits_left = remote_bitbang_pending_frames[remote_bitbang_pending_first];
+		remote_bitbang_pending_first = (remote_bitbang_pending_first + 1) %
+				REMOTE_BITBANG_MAX_PENDING_FRAMES;
+		remote_bitbang_pending_count--;
+		remote_bitbang_tdo_bit = 0;
+	}
+
+	if (remote_bitbang_tdo_bit % 8 == 0) {
+		int c = remote_bitbang_read_byte();
+		if (c < 0)
+			return BB_ERROR;
+		remote_bitbang_tdo_byte = c;
+	}
+
+	bool tdo = remote_bitbang_tdo_byte & BIT(remote_bitbang_tdo_bit % 8);
+	remote_bitbang_tdo_bit++;
+	remote_bitbang_tdo_bits_left--;
+
+	return tdo ? BB_HIGH : BB_LOW;
+}
+
 static int remote_bitbang_quit(void)
 {
 	if (remote_bitbang_queue('Q', FLUSH_SEND_BUF) == ERROR_FAIL)
@@ -181,6 +399,9 @@ static bb_value_t char_to_int(int c)
 
 static int remote_bitbang_sample(void)
 {
+	if (remote_bitbang_packed)
+		return remote_bitbang_sample_packed();
+
 	if (remote_bitbang_fill_buf(NO_BLOCK) != ERROR_OK)
 		return ERROR_FAIL;
 	assert(!remote_bitbang_recv_buf_full());
@@ -189,25 +410,29 @@ static int remote_bitbang_sample(void)
 
 static bb_value_t remote_bitbang_read_sample(void)
 {
-	if (remote_bitbang_recv_buf_empty()) {
-		if (remote_bitbang_fill_buf(BLOCK) != ERROR_OK)
-			return BB_ERROR;
-	}
-	assert(!remote_bitbang_recv_buf_empty());
-	int c = remote_bitbang_recv_buf[remote_bitbang_recv_buf_start];
-	remote_bitbang_recv_buf_start =
-		(remote_bitbang_recv_buf_start + 1) % sizeof(remote_bitbang_recv_buf);
+	if (remote_bitbang_packed)
+		return remote_bitbang_read_sample_packed();
+
+	int c = remote_bitbang_read_byte();
+	if (c < 0)
+		return BB_ERROR;
 	return char_to_int(c);
 }
 
 static int remote_bitbang_write(int tck, int tms, int tdi)
 {
+	if (remote_bitbang_packed)
+		return remote_bitbang_write_packed(tck, tms, tdi);
+
 	char c = '0' + ((tck ? 0x4 : 0x0) | (tms ? 0x2 : 0x0) | (tdi ? 0x1 : 0x0));
 	return remote_bitbang_queue(c, NO_FLUSH);
 }
 
 static int remote_bitbang_reset(int trst, int srst)
 {
+	if (remote_bitbang_packed && remote_bitbang_sync_pins() != ERROR_OK)
+		return ERROR_FAIL;
+
 	char c = 'r' + ((trst ? 0x2 : 0x0) | (srst ? 0x1 : 0x0));
 	/* Always flush the send buffer on reset, because the reset call need not be
 	 * followed by jtag_execute_queue(). */
@@ -216,6 +441,9 @@ static int remote_bitbang_reset(int trst, int srst)
 
 static int remote_bitbang_blink(int on)
 {
+	if (remote_bitbang_packed && remote_bitbang_sync_pins() != ERROR_OK)
+		return ERROR_FAIL;
+
 	char c = on ? 'B' : 'b';
 	return remote_bitbang_queue(c, FLUSH_SEND_BUF);
 }
@@ -228,6 +456,276 @@ static struct bitbang_interface remote_bitbang_bitbang = {
 	.blink = &remote_bitbang_blink,
 };
 
+/*
+ * SWD transactions, only available with the protocol extension.
+ *
+ * Each 'T' frame carries one complete transaction, executed by the server
+ * including the WAIT retries. The replies are read back in run().
+ */
+struct remote_bitbang_swd_transfer {
+	uint8_t cmd;
+	bool check_ack;
+	uint32_t *dst;
+};
+
+static struct remote_bitbang_swd_transfer remote_bitbang_swd_queue[REMOTE_BITBANG_SWD_QUEUE_SIZE];
+static unsigned int remote_bitbang_swd_queue_len;
+static int remote_bitbang_swd_queued_retval;
+
+static int remote_bitbang_swd_run_queue(void);
+
+static int remote_bitbang_swd_init(void)
+{
+	return ERROR_OK;
+}
+
+static int remote_bitbang_swd_queue_seq(const uint8_t *seq, unsigned int len)
+{
+	uint8_t header[3] = { 'W', len & 0xff, len >> 8 };
+
+	if (remote_bitbang_queue_buf(header, sizeof(header)) != ERROR_OK)
+		return ERROR_FAIL;
+	return remote_bitbang_queue_buf(seq, DIV_ROUND_UP(len, 8));
+}
+
+static int remote_bitbang_swd_switch_seq(enum swd_special_seq seq)
+{
+	int retval;
+
+	switch (seq) {
+	case LINE_RESET:
+		LOG_DEBUG_IO("SWD line reset");
+		retval = remote_bitbang_swd_queue_seq(swd_seq_line_reset, swd_seq_line_reset_len);
+		break;
+	case JTAG_TO_SWD:
+		LOG_DEBUG("JTAG-to-SWD");
+		retval = remote_bitbang_swd_queue_seq(swd_seq_jtag_to_swd, swd_seq_jtag_to_swd_len);
+		break;
+	case JTAG_TO_DORMANT:
+		LOG_DEBUG("JTAG-to-DORMANT");
+		retval = remote_bitbang_swd_queue_seq(swd_seq_jtag_to_dormant, swd_seq_jtag_to_dormant_len);
+		break;
+	case SWD_TO_JTAG:
+		LOG_DEBUG("SWD-to-JTAG");
+		retval = remote_bitbang_swd_queue_seq(swd_seq_swd_to_jtag, swd_seq_swd_to_jtag_len);
+		break;
+	case SWD_TO_DORMANT:
+		LOG_DEBUG("SWD-to-DORMANT");
+		retval = remote_bitbang_swd_queue_seq(swd_seq_swd_to_dormant, swd_seq_swd_to_dormant_len);
+		break;
+	case DORMANT_TO_SWD:
+		LOG_DEBUG("DORMANT-to-SWD");
+		retval = remote_bitbang_swd_queue_seq(swd_seq_dormant_to_swd, swd_seq_dormant_to_swd_len);
+		break;
+	case DORMANT_TO_JTAG:
+		LOG_DEBUG("DORMANT-to-JTAG");
+		retval = remote_bitbang_swd_queue_seq(swd_seq_dormant_to_jtag, swd_seq_dormant_to_jtag_len);
+		break;
+	default:
+		LOG_ERROR("Sequence %d not supported", seq);
+		return ERROR_FAIL;
+	}
+
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the sequence may not be followed by any transaction */
+	return remote_bitbang_flush();
+}
+
+static void remote_bitbang_swd_queue_transfer(uint8_t cmd, uint32_t *dst, uint32_t data,
+		uint32_t ap_delay_clk)
+{
+	if (remote_bitbang_swd_queued_retval != ERROR_OK) {
+		LOG_DEBUG("Skip SWD transaction because queued_retval=%d",
+				remote_bitbang_swd_queued_retval);
+		return;
+	}
+
+	if (remote_bitbang_swd_queue_len == REMOTE_BITBANG_SWD_QUEUE_SIZE) {
+		remote_bitbang_swd_queued_retval = remote_bitbang_swd_run_queue();
+		if (remote_bitbang_swd_queued_retval != ERROR_OK)
+			return;
+	}
+
+	cmd |= SWD_CMD_START | SWD_CMD_PARK;
+	bool check_ack = swd_cmd_returns_ack(cmd);
+	uint16_t delay = (cmd & SWD_CMD_APNDP) ? MIN(ap_delay_clk, 0xffff) : 0;
+
+	uint8_t frame[9];
+	unsigned int size = 0;
+	frame[size++] = 'T';
+	frame[size++] = check_ack ? 1 : 0;
+	frame[size++] = cmd;
+	if (!(cmd & SWD_CMD_RNW)) {
+		h_u32_to_le(&frame[size], data);
+		size += 4;
+	}
+	h_u16_to_le(&frame[size], delay);
+	size += 2;
+
+	if (remote_bitbang_queue_buf(frame, size) != ERROR_OK) {
+		remote_bitbang_swd_queued_retval = ERROR_FAIL;
+		return;
+	}
+
+	struct remote_bitbang_swd_transfer *t =
+		&remote_bitbang_swd_queue[remote_bitbang_swd_queue_len++];
+	t->cmd = cmd;
+	t->check_ack = check_ack;
+	t->dst = dst;
+}
+
+static void remote_bitbang_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_clk)
+{
+	assert(cmd & SWD_CMD_RNW);
+	remote_bitbang_swd_queue_transfer(cmd, value, 0, ap_delay_clk);
+}
+
+static void remote_bitbang_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_clk)
+{
+	assert(!(cmd & SWD_CMD_RNW));
+	remote_bitbang_swd_queue_transfer(cmd, NULL, value, ap_delay_clk);
+}
+
+static int remote_bitbang_swd_run_queue(void)
+{
+	/* A transaction must be followed by another transaction or at least 8 idle cycles to
+	 * ensure that data is clocked through the AP. */
+	const uint8_t idle = 0;
+	int retval = remote_bitbang_swd_queue_seq(&idle, 8);
+	if (retval == ERROR_OK)
+		retval = remote_bitbang_flush();
+
+	/* all the replies have to be read, even after a failing transaction */
+	bool io_error = retval != ERROR_OK;
+	for (unsigned int i = 0; i < remote_bitbang_swd_queue_len && !io_error; i++) {
+		struct remote_bitbang_swd_transfer *t = &remote_bitbang_swd_queue[i];
+		bool rnw = t->cmd & SWD_CMD_RNW;
+		uint8_t reply[5];
+
+		for (unsigned int j = 0; j < (rnw ? 5 : 1); j++) {
+			int c = remote_bitbang_read_byte();
+			if (c < 0) {
+				io_error = true;
+				retval = ERROR_FAIL;
+				break;
+			}
+			reply[j] = c;
+		}
+		if (io_error || retval != ERROR_OK)
+			continue;
+
+		int ack = reply[0] & 0x7;
+		uint32_t data = rnw ? le_to_h_u32(&reply[1]) : 0;
+
+		LOG_DEBUG_IO("%s%s %s %s reg %X = %08" PRIx32,
+			  t->check_ack ? "" : "ack ignored ",
+			  ack == SWD_ACK_OK ? "OK" : ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK",
+			  t->cmd & SWD_CMD_APNDP ? "AP" : "DP",
+			  rnw ? "read" : "write",
+			  (t->cmd & SWD_CMD_A32) >> 1,
+			  data);
+
+		if (t->check_ack && ack != SWD_ACK_OK) {
+			retval = swd_ack_to_error_code(ack);
+			continue;
+		}
+
+		if (rnw) {
+			if (reply[0] & 0x8) {
+				LOG_ERROR("Wrong parity detected");
+				retval = ERROR_FAIL;
+				continue;
+			}
+			if (t->dst)
+				*t->dst = data;
+		}
+	}
+
+	remote_bitbang_swd_queue_len = 0;
+
+	if (remote_bitbang_swd_queued_retval != ERROR_OK)
+		retval = remote_bitbang_swd_queued_retval;
+	remote_bitbang_swd_queued_retval = ERROR_OK;
+
+	LOG_DEBUG_IO("SWD queue return value: %02x", retval);
+	return retval;
+}
+
+static const struct swd_driver remote_bitbang_swd = {
+	.init = remote_bitbang_swd_init,
+	.switch_seq = remote_bitbang_swd_switch_seq,
+	.read_reg = remote_bitbang_swd_read_reg,
+	.write_reg = remote_bitbang_swd_write_reg,
+	.run = remote_bitbang_swd_run_queue,
+};
+
+/*
+ * Ask the server for the protocol extension. Servers that only know the
+ * ASCII protocol ignore the query, so no reply within the timeout means
+ * no extension.
+ */
+static int remote_bitbang_negotiate(uint8_t *caps)
+{
+	*caps = 0;
+
+	if (!remote_bitbang_use_ext)
+		return ERROR_OK;
+
+	if (remote_bitbang_queue('X', FLUSH_SEND_BUF) != ERROR_OK)
+		return ERROR_FAIL;
+
+	uint8_t reply[2];
+	unsigned int received = 0;
+	int64_t deadline = timeval_ms() + REMOTE_BITBANG_EXT_TIMEOUT_MS;
+	while (received < sizeof(reply)) {
+		int64_t left = deadline - timeval_ms();
+		if (left <= 0) {
+			LOG_INFO("remote_bitbang: no protocol extension, using the ASCII protocol");
+			return ERROR_OK;
+		}
+
+		fd_set rfds;
+		FD_ZERO(&rfds);
+		FD_SET(remote_bitbang_fd, &rfds);
+		struct timeval tv = { .tv_sec = left / 1000, .tv_usec = (left % 1000) * 1000 };
+		int ret = socket_select(remote_bitbang_fd + 1, &rfds, NULL, NULL, &tv);
+		if (ret < 0) {
+			log_socket_error("select");
+			return ERROR_FAIL;
+		}
+		if (ret == 0)
+			continue;
+
+		ssize_t count = read_socket(remote_bitbang_fd, reply + received,
+				sizeof(reply) - received);
+		if (count == 0) {
+			LOG_ERROR("remote_bitbang: connection closed by the server");
+			return ERROR_FAIL;
+		} else if (count < 0) {
+#ifdef _WIN32
+			if (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+			if (errno == EAGAIN)
+#endif
+				continue;
+			log_socket_error("remote_bitbang_negotiate");
+			return ERROR_FAIL;
+		}
+		received += count;
+	}
+
+	if (reply[0] != 'X') {
+		LOG_ERROR("remote_bitbang: invalid reply 0x%02" PRIx8 " to the extension query", reply[0]);
+		return ERROR_FAIL;
+	}
+
+	*caps = reply[1];
+	LOG_INFO("remote_bitbang: protocol extension supported, capabilities 0x%02" PRIx8, *caps);
+	return ERROR_OK;
+}
+
 static int remote_bitbang_init_tcp(void)
 {
 	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
@@ -311,6 +809,8 @@ static int remote_bitbang_init(void)
 
 	remote_bitbang_recv_buf_start = 0;
 	remote_bitbang_recv_buf_end = 0;
+	remote_bitbang_packed = false;
+	remote_bitbang_bitbang.buf_size = sizeof(remote_bitbang_recv_buf) - 1;
 
 	LOG_INFO("Initializing remote_bitbang driver");
 	if (!remote_bitbang_port)
@@ -323,6 +823,21 @@ static int remote_bitbang_init(void)
 
 	socket_nonblock(remote_bitbang_fd);
 
+	uint8_t caps;
+	if (remote_bitbang_negotiate(&caps) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (transport_is_swd() && !(caps & REMOTE_BITBANG_CAP_SWD)) {
+		LOG_ERROR("remote_bitbang: the server does not support SWD");
+		return ERROR_FAIL;
+	}
+
+	if (caps & REMOTE_BITBANG_CAP_JTAG) {
+		remote_bitbang_packed = true;
+		/* room for the packed TDO replies of the buffered samples */
+		remote_bitbang_bitbang.buf_size = 2 * REMOTE_BITBANG_FRAME_BITS;
+	}
+
 	LOG_INFO("remote_bitbang driver initialized");
 	return ERROR_OK;
 }
@@ -339,6 +854,15 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_port_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_use_extension_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], remote_bitbang_use_ext);
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_host_command)
 {
 	if (CMD_ARGC == 1) {
@@ -366,6 +890,13 @@ static const struct command_registration remote_bitbang_subcommand_handlers[] =
 			"  if port is 0 or unset, this is the name of the unix socket to use.",
 		.usage = "host_name",
 	},
+	{
+		.name = "use_extension",
+		.handler = remote_bitbang_handle_remote_bitbang_use_extension_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Ask the remote for the packed binary protocol extension.",
+		.usage = "(on|off)",
+	},
 	COMMAND_REGISTRATION_DONE,
 };
 
@@ -391,6 +922,12 @@ static int remote_bitbang_execute_queue(void)
 	if (ret != ERROR_OK)
 		return ret;
 
+	if (remote_bitbang_packed) {
+		ret = remote_bitbang_sync_pins();
+		if (ret != ERROR_OK)
+			return ret;
+	}
+
 	/* flush not-yet-sent characters, if any */
 	return remote_bitbang_flush();
 }
@@ -399,9 +936,11 @@ static struct jtag_interface remote_bitbang_interface = {
 	.execute_queue = &remote_bitbang_execute_queue,
 };
 
+static const char * const remote_bitbang_transports[] = { "jtag", "swd", NULL };
+
 struct adapter_driver remote_bitbang_adapter_driver = {
 	.name = "remote_bitbang",
-	.transports = jtag_only,
+	.transports = remote_bitbang_transports,
 	.commands = remote_bitbang_command_handlers,
 
 	.init = &remote_bitbang_init,
@@ -409,4 +948,5 @@ struct adapter_driver remote_bitbang_adapter_driver = {
 	.reset = &remote_bitbang_reset,
 
 	.jtag_ops = &remote_bitbang_interface,
+	.swd_ops = &remote_bitbang_swd,
 };
@@ -0,0 +1,371 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Adapter driver playing back a log written by 'adapter record'.
+ *
+ * Each flush of the JTAG or SWD queue takes the next record of the log and
+ * returns the results that the real adapter returned, so that the host side
+ * of OpenOCD runs the same code paths without hardware. The queue must match
+ * the recorded one: a replay that diverges from the log fails.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <jtag/adapter_record.h>
+#include <jtag/interface.h>
+#include <jtag/commands.h>
+#include <jtag/swd.h>
+#include <helper/time_support.h>
+
+struct replay_swd_transaction {
+	uint8_t cmd;
+	uint32_t value;
+	uint32_t *read_value;
+};
+
+static char *replay_filename;
+static FILE *replay_file;
+static bool replay_timing;
+static unsigned long replay_records;
+
+/* the payload of the current record */
+static uint8_t *replay_buf;
+static size_t replay_alloc;
+
+static struct replay_swd_transaction *replay_swd_queue;
+static unsigned int replay_swd_queue_len;
+static unsigned int replay_swd_queue_alloc;
+static bool replay_swd_queue_failed;
+
+/* read the next record of the log, its payload goes to replay_buf */
+static int replay_next(enum adapter_record_type type, uint32_t *size, int *retval)
+{
+	uint8_t header[ADAPTER_RECORD_HEADER_SIZE];
+
+	if (!replay_file) {
+		LOG_ERROR("no replay log open");
+		return ERROR_FAIL;
+	}
+
+	if (fread(header, 1, sizeof(header), replay_file) != sizeof(header)) {
+		LOG_ERROR("replay log %s ended after %lu records", replay_filename, replay_records);
+		return ERROR_FAIL;
+	}
+
+	*size = le_to_h_u32(header + 1);
+	*retval = (int)le_to_h_u32(header + 5);
+	uint32_t elapsed_us = le_to_h_u32(header + 9);
+
+	if (*size > replay_alloc) {
+		uint8_t *buf = realloc(replay_buf, *size);
+		if (!buf) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		replay_buf = buf;
+		replay_alloc = *size;
+	}
+
+	if (fread(replay_buf, 1, *size, replay_file) != *size) {
+		LOG_ERROR("replay log %s truncated in record %lu", replay_filename, replay_records);
+		return ERROR_FAIL;
+	}
+
+	if (header[0] != type) {
+		LOG_ERROR("replay diverged at record %lu: '%c' in the log, '%c' queued",
+			replay_records, header[0], type);
+		return ERROR_FAIL;
+	}
+
+	replay_records++;
+
+	if (replay_timing && elapsed_us)
+		usleep(elapsed_us);
+
+	return ERROR_OK;
+}
+
+static int replay_execute_queue(void)
+{
+	uint32_t size;
+	int retval;
+	int result = replay_next(ADAPTER_RECORD_JTAG, &size, &retval);
+	if (result != ERROR_OK)
+		return result;
+
+	uint32_t offset = 0;
+	for (struct jtag_command *cmd = jtag_command_queue; cmd; cmd = cmd->next) {
+		if (cmd->type != JTAG_SCAN)
+			continue;
+		for (int i = 0; i < cmd->cmd.scan->num_fields; i++) {
+			struct scan_field *field = &cmd->cmd.scan->fields[i];
+			if (!field->in_value)
+				continue;
+
+			uint32_t field_size = DIV_ROUND_UP(field->num_bits, 8);
+			if (offset + field_size > size) {
+				LOG_ERROR("replay diverged at record %lu: more scans queued than logged",
+					replay_records - 1);
+				return ERROR_FAIL;
+			}
+			buf_set_buf(replay_buf + offset, 0, field->in_value, 0, field->num_bits);
+			offset += field_size;
+		}
+	}
+
+	if (offset != size) {
+		LOG_ERROR("replay diverged at record %lu: fewer scans queued than logged",
+			replay_records - 1);
+		return ERROR_FAIL;
+	}
+
+	return retval;
+}
+
+static void replay_swd_queue_add(uint8_t cmd, uint32_t value, uint32_t *read_value)
+{
+	if (replay_swd_queue_failed)
+		return;
+
+	if (replay_swd_queue_len == replay_swd_queue_alloc) {
+		unsigned int alloc = MAX(2 * replay_swd_queue_alloc, 64U);
+		struct replay_swd_transaction *queue = realloc(replay_swd_queue,
+			alloc * sizeof(*queue));
+		if (!queue) {
+			LOG_ERROR("Out of memory");
+			replay_swd_queue_failed = true;
+			return;
+		}
+		replay_swd_queue = queue;
+		replay_swd_queue_alloc = alloc;
+	}
+
+	struct replay_swd_transaction *t = &replay_swd_queue[replay_swd_queue_len++];
+	t->cmd = cmd;
+	t->value = value;
+	t->read_value = read_value;
+}
+
+static int replay_swd_init(void)
+{
+	return ERROR_OK;
+}
+
+static int replay_swd_switch_seq(enum swd_special_seq seq)
+{
+	uint32_t size;
+	int retval;
+	int result = replay_next(ADAPTER_RECORD_SWD_SEQ, &size, &retval);
+	if (result != ERROR_OK)
+		return result;
+
+	if (size != 1 || replay_buf[0] != seq) {
+		LOG_ERROR("replay diverged at record %lu: other SWD sequence", replay_records - 1);
+		return ERROR_FAIL;
+	}
+
+	return retval;
+}
+
+static void replay_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_hint)
+{
+	replay_swd_queue_add(cmd, 0, value);
+}
+
+static void replay_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_hint)
+{
+	replay_swd_queue_add(cmd, value, NULL);
+}
+
+static int replay_swd_run_queue(void)
+{
+	uint32_t size;
+	int retval;
+
+	if (replay_swd_queue_failed)
+		return ERROR_FAIL;
+
+	int result = replay_next(ADAPTER_RECORD_SWD, &size, &retval);
+	if (result != ERROR_OK)
+		return result;
+
+	if (size != replay_swd_queue_len * ADAPTER_RECORD_SWD_TRANSACTION_SIZE) {
+		LOG_ERROR("replay diverged at record %lu: %u SWD transactions queued, %" PRIu32
+			" logged", replay_records - 1, replay_swd_queue_len,
+			size / ADAPTER_RECORD_SWD_TRANSACTION_SIZE);
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < replay_swd_queue_len; i++) {
+		const struct replay_swd_transaction *t = &replay_swd_queue[i];
+		const uint8_t *p = replay_buf + i * ADAPTER_RECORD_SWD_TRANSACTION_SIZE;
+		uint32_t value = le_to_h_u32(p + 1);
+
+		if (p[0] != t->cmd) {
+			LOG_ERROR("replay diverged at record %lu: SWD command 0x%02" PRIx8
+				" queued, 0x%02" PRIx8 " logged", replay_records - 1, t->cmd, p[0]);
+			return ERROR_FAIL;
+		}
+
+		if (t->read_value)
+			*t->read_value = value;
+		else if (t->value != value)
+			LOG_DEBUG("replay: SWD write 0x%08" PRIx32 " logged as 0x%08" PRIx32,
+				t->value, value);
+	}
+
+	return retval;
+}
+
+static int replay_swd_run(void)
+{
+	int retval = replay_swd_run_queue();
+
+	replay_swd_queue_len = 0;
+	replay_swd_queue_failed = false;
+
+	return retval;
+}
+
+static int replay_reset(int srst, int trst)
+{
+	return ERROR_OK;
+}
+
+static int replay_init(void)
+{
+	char magic[ADAPTER_RECORD_MAGIC_SIZE];
+
+	if (!replay_filename) {
+		LOG_ERROR("no replay log, see 'replay file'");
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	replay_file = fopen(replay_filename, "rb");
+	if (!replay_file) {
+		LOG_ERROR("couldn't open %s: %s", replay_filename, strerror(errno));
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	if (fread(magic, 1, sizeof(magic), replay_file) != sizeof(magic) ||
+			memcmp(magic, ADAPTER_RECORD_MAGIC, sizeof(magic))) {
+		LOG_ERROR("%s is not a log of 'adapter record'", replay_filename);
+		fclose(replay_file);
+		replay_file = NULL;
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	replay_records = 0;
+	LOG_INFO("replaying the adapter transactions of %s", replay_filename);
+
+	return ERROR_OK;
+}
+
+static int replay_quit(void)
+{
+	if (replay_file) {
+		LOG_INFO("replayed %lu records", replay_records);
+		fclose(replay_file);
+		replay_file = NULL;
+	}
+
+	free(replay_buf);
+	replay_buf = NULL;
+	replay_alloc = 0;
+
+	free(replay_swd_queue);
+	replay_swd_queue = NULL;
+	replay_swd_queue_len = 0;
+	replay_swd_queue_alloc = 0;
+
+	free(replay_filename);
+	replay_filename = NULL;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(replay_handle_file_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	free(replay_filename);
+	replay_filename = strdup(CMD_ARGV[0]);
+	if (!replay_filename) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(replay_handle_timing_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], replay_timing);
+
+	command_print(CMD, "replay timing is %s", replay_timing ? "on" : "off");
+
+	return ERROR_OK;
+}
+
+static const struct command_registration replay_subcommand_handlers[] = {
+	{
+		.name = "file",
+		.handler = replay_handle_file_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the log written by 'adapter record' to play back",
+		.usage = "filename",
+	},
+	{
+		.name = "timing",
+		.handler = replay_handle_timing_command,
+		.mode = COMMAND_ANY,
+		.help = "wait as long as the recorded adapter for each flush",
+		.usage = "['on'|'off']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration replay_command_handlers[] = {
+	{
+		.name = "replay",
+		.mode = COMMAND_ANY,
+		.help = "replay adapter driver command group",
+		.chain = replay_subcommand_handlers,
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const char * const replay_transports[] = { "jtag", "swd", NULL };
+
+static struct jtag_interface replay_interface = {
+	.execute_queue = replay_execute_queue,
+};
+
+static const struct swd_driver replay_swd = {
+	.init = replay_swd_init,
+	.switch_seq = replay_swd_switch_seq,
+	.read_reg = replay_swd_read_reg,
+	.write_reg = replay_swd_write_reg,
+	.run = replay_swd_run,
+};
+
+struct adapter_driver replay_adapter_driver = {
+	.name = "replay",
+	.transports = replay_transports,
+	.commands = replay_command_handlers,
+
+	.init = replay_init,
+	.quit = replay_quit,
+	.reset = replay_reset,
+
+	.jtag_ops = &replay_interface,
+	.swd_ops = &replay_swd,
+};
@@ -169,6 +169,23 @@ struct stlink_tcp_priv_s {
 	struct stlink_tcp_version version;
 };
 
+/* Upper limit of memory read/write commands kept in flight */
+#define STLINK_MEM_PIPELINE_MAX		8
+
+/** A memory read/write command issued as part of a pipeline */
+struct stlink_mem_chunk {
+	/** the command */
+	uint8_t cmd[STLINK_CMD_SIZE_V2];
+	/** data to write or destination of the data read */
+	uint8_t *buf;
+	/** length of the data phase */
+	uint16_t len;
+	/** direction of the data phase */
+	bool write;
+	/** response to the read/write status command following the command */
+	uint8_t status[12];
+};
+
 struct stlink_backend_s {
 	/** */
 	int (*open)(void *handle, struct hl_interface_param_s *param);
@@ -178,6 +195,9 @@ struct stlink_backend_s {
 	int (*xfer_noerrcheck)(void *handle, const uint8_t *buf, int size);
 	/** */
 	int (*read_trace)(void *handle, const uint8_t *buf, int size);
+	/** optional, run the memory commands and their status commands
+	 * without waiting for each one to complete */
+	int (*xfer_mem_chunks)(void *handle, struct stlink_mem_chunk *chunks, unsigned int n_chunks);
 };
 
 /* TODO: make queue size dynamic */
@@ -911,14 +931,13 @@ static int stlink_usb_usb_xfer_noerrcheck(void *handle, const uint8_t *buf, int
 }
 
 
-static int stlink_tcp_send_cmd(void *handle, int send_size, int recv_size, bool check_tcp_status)
+static int stlink_tcp_send_recv(void *handle, const uint8_t *send_buf, int send_size,
+		uint8_t *recv_buf, int recv_size)
 {
 	struct stlink_usb_handle_s *h = handle;
 
-	assert(handle);
-
 	/* send the TCP command */
-	int sent_size = send(h->tcp_backend_priv.fd, (void *)h->tcp_backend_priv.send_buf, send_size, 0);
+	int sent_size = send(h->tcp_backend_priv.fd, (void *)send_buf, send_size, 0);
 	if (sent_size != send_size) {
 		LOG_ERROR("failed to send USB CMD");
 		if (sent_size == -1)
@@ -931,7 +950,6 @@ static int stlink_tcp_send_cmd(void *handle, int send_size, int recv_size, bool
 	/* read the TCP response */
 	int retval = ERROR_OK;
 	int remaining_bytes = recv_size;
-	uint8_t *recv_buf = h->tcp_backend_priv.recv_buf;
 	const int64_t timeout = timeval_ms() + 1000; /* 1 second */
 
 	while (remaining_bytes > 0) {
@@ -959,22 +977,42 @@ static int stlink_tcp_send_cmd(void *handle, int send_size, int recv_size, bool
 		return retval;
 	}
 
-	if (check_tcp_status) {
-		uint32_t tcp_ss = le_to_h_u32(h->tcp_backend_priv.recv_buf);
-		if (tcp_ss != STLINK_TCP_SS_OK) {
-			if (tcp_ss == STLINK_TCP_SS_TCP_BUSY) {
-				LOG_DEBUG("TCP busy");
-				return ERROR_WAIT;
-			}
+	return ERROR_OK;
+}
 
-			LOG_ERROR("TCP error status 0x%X", tcp_ss);
-			return ERROR_FAIL;
+static int stlink_tcp_check_status(const uint8_t *recv_buf)
+{
+	uint32_t tcp_ss = le_to_h_u32(recv_buf);
+	if (tcp_ss != STLINK_TCP_SS_OK) {
+		if (tcp_ss == STLINK_TCP_SS_TCP_BUSY) {
+			LOG_DEBUG("TCP busy");
+			return ERROR_WAIT;
 		}
+
+		LOG_ERROR("TCP error status 0x%X", tcp_ss);
+		return ERROR_FAIL;
 	}
 
 	return ERROR_OK;
 }
 
+static int stlink_tcp_send_cmd(void *handle, int send_size, int recv_size, bool check_tcp_status)
+{
+	struct stlink_usb_handle_s *h = handle;
+
+	assert(handle);
+
+	int retval = stlink_tcp_send_recv(handle, h->tcp_backend_priv.send_buf, send_size,
+			h->tcp_backend_priv.recv_buf, recv_size);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (check_tcp_status)
+		return stlink_tcp_check_status(h->tcp_backend_priv.recv_buf);
+
+	return ERROR_OK;
+}
+
 /** */
 static int stlink_tcp_xfer_noerrcheck(void *handle, const uint8_t *buf, int size)
 {
@@ -2794,6 +2832,210 @@ static int stlink_usb_write_mem32_noaddrinc(void *handle, uint8_t ap_num, uint32
 	return stlink_usb_get_rw_status(handle);
 }
 
+/* Build the read/write status command, returns the size of its response */
+static unsigned int stlink_usb_rw_status_cmd(struct stlink_usb_handle_s *h, uint8_t *cmd)
+{
+	memset(cmd, 0, STLINK_CMD_SIZE_V2);
+	cmd[0] = STLINK_DEBUG_COMMAND;
+	if (h->version.flags & STLINK_F_HAS_GETLASTRWSTATUS2) {
+		cmd[1] = STLINK_DEBUG_APIV2_GETLASTRWSTATUS2;
+		return 12;
+	}
+
+	cmd[1] = STLINK_DEBUG_APIV2_GETLASTRWSTATUS;
+	return 2;
+}
+
+#ifdef USE_LIBUSB_ASYNCIO
+static int stlink_usb_usb_xfer_mem_chunks(void *handle, struct stlink_mem_chunk *chunks,
+		unsigned int n_chunks)
+{
+	struct stlink_usb_handle_s *h = handle;
+	struct jtag_xfer transfers[4 * STLINK_MEM_PIPELINE_MAX];
+	uint8_t status_cmd[STLINK_CMD_SIZE_V2];
+	unsigned int status_size = stlink_usb_rw_status_cmd(h, status_cmd);
+	size_t n_transfers = 0;
+
+	assert(n_chunks <= STLINK_MEM_PIPELINE_MAX);
+
+	memset(transfers, 0, sizeof(transfers));
+
+	/* The device handles the commands in order, the transfers of each
+	 * endpoint complete in the order they have been submitted */
+	for (unsigned int i = 0; i < n_chunks; i++) {
+		transfers[n_transfers].ep = h->tx_ep;
+		transfers[n_transfers].buf = chunks[i].cmd;
+		transfers[n_transfers].size = STLINK_CMD_SIZE_V2;
+		n_transfers++;
+
+		transfers[n_transfers].ep = chunks[i].write ? h->tx_ep : h->rx_ep;
+		transfers[n_transfers].buf = chunks[i].buf;
+		transfers[n_transfers].size = chunks[i].len;
+		n_transfers++;
+
+		transfers[n_transfers].ep = h->tx_ep;
+		transfers[n_transfers].buf = status_cmd;
+		transfers[n_transfers].size = STLINK_CMD_SIZE_V2;
+		n_transfers++;
+
+		transfers[n_transfers].ep = h->rx_ep;
+		transfers[n_transfers].buf = chunks[i].status;
+		transfers[n_transfers].size = status_size;
+		n_transfers++;
+	}
+
+	return jtag_libusb_bulk_transfer_n(h->usb_backend_priv.fd, transfers, n_transfers,
+			STLINK_WRITE_TIMEOUT);
+}
+#endif
+
+static uint8_t *stlink_tcp_fill_usb_cmd(struct stlink_usb_handle_s *h, uint8_t *buf,
+		const uint8_t *cmd, uint8_t direction, uint32_t size)
+{
+	buf[0] = STLINK_TCP_CMD_SEND_USB_CMD;
+	memset(&buf[1], 0, 3);
+	h_u32_to_le(&buf[4], h->tcp_backend_priv.connect_id);
+	memcpy(&buf[8], cmd, STLINK_CMD_SIZE_V2);
+	buf[24] = direction;
+	memset(&buf[25], 0, 3);
+	h_u32_to_le(&buf[28], size);
+
+	return &buf[STLINK_TCP_USB_CMD_SIZE];
+}
+
+/* Send all the memory commands and their status commands in one TCP round trip */
+static int stlink_tcp_xfer_mem_chunks(void *handle, struct stlink_mem_chunk *chunks,
+		unsigned int n_chunks)
+{
+	struct stlink_usb_handle_s *h = handle;
+	uint8_t status_cmd[STLINK_CMD_SIZE_V2];
+	unsigned int status_size = stlink_usb_rw_status_cmd(h, status_cmd);
+	int send_size = 0;
+	int recv_size = 0;
+
+	if (!n_chunks)
+		return ERROR_OK;
+
+	for (unsigned int i = 0; i < n_chunks; i++) {
+		send_size += 2 * STLINK_TCP_USB_CMD_SIZE + (chunks[i].write ? chunks[i].len : 0);
+		recv_size += 2 * STLINK_TCP_SS_SIZE + (chunks[i].write ? 0 : chunks[i].len) + status_size;
+	}
+
+	uint8_t *send_buf = malloc(send_size);
+	uint8_t *recv_buf = malloc(recv_size);
+	if (!send_buf || !recv_buf) {
+		LOG_ERROR("Out of memory");
+		free(send_buf);
+		free(recv_buf);
+		return ERROR_FAIL;
+	}
+
+	uint8_t *p = send_buf;
+	for (unsigned int i = 0; i < n_chunks; i++) {
+		if (chunks[i].write) {
+			p = stlink_tcp_fill_usb_cmd(h, p, chunks[i].cmd, h->tx_ep, chunks[i].len);
+			memcpy(p, chunks[i].buf, chunks[i].len);
+			p += chunks[i].len;
+		} else {
+			p = stlink_tcp_fill_usb_cmd(h, p, chunks[i].cmd, h->rx_ep, chunks[i].len);
+		}
+		p = stlink_tcp_fill_usb_cmd(h, p, status_cmd, h->rx_ep, status_size);
+	}
+
+	int retval = stlink_tcp_send_recv(h, send_buf, send_size, recv_buf, recv_size);
+
+	p = recv_buf;
+	for (unsigned int i = 0; i < n_chunks && retval == ERROR_OK; i++) {
+		retval = stlink_tcp_check_status(p);
+		if (retval != ERROR_OK)
+			break;
+		p += STLINK_TCP_SS_SIZE;
+		if (!chunks[i].write) {
+			memcpy(chunks[i].buf, p, chunks[i].len);
+			p += chunks[i].len;
+		}
+
+		retval = stlink_tcp_check_status(p);
+		if (retval != ERROR_OK)
+			break;
+		p += STLINK_TCP_SS_SIZE;
+		memcpy(chunks[i].status, p, status_size);
+		p += status_size;
+	}
+
+	free(send_buf);
+	free(recv_buf);
+
+	return retval;
+}
+
+/* Number of memory commands kept in flight, 1 disables the pipeline */
+static unsigned int stlink_mem_pipeline_depth = 4;
+
+static bool stlink_usb_can_pipeline(struct stlink_usb_handle_s *h)
+{
+	if (stlink_mem_pipeline_depth < 2 || !h->backend->xfer_mem_chunks)
+		return false;
+
+	if (h->version.jtag_api == STLINK_JTAG_API_V1)
+		return false;
+
+	/* only the high-speed V3 probes gain from it over USB */
+	return h->version.stlink >= 3 || h->backend->xfer_mem_chunks == stlink_tcp_xfer_mem_chunks;
+}
+
+static uint32_t stlink_max_block_size(uint32_t tar_autoincr_block, uint32_t address);
+
+/*
+ * Read or write count bytes of 32-bit words starting at addr with up to
+ * stlink_mem_pipeline_depth commands in flight. The number of bytes
+ * transferred before the first failing command is returned in *done.
+ */
+static int stlink_usb_rw_mem32_pipelined(void *handle, uint8_t ap_num, uint32_t csw,
+		bool write, uint32_t addr, uint32_t count, uint8_t *buffer, uint32_t *done)
+{
+	struct stlink_usb_handle_s *h = handle;
+	struct stlink_mem_chunk chunks[STLINK_MEM_PIPELINE_MAX];
+	unsigned int n_chunks = 0;
+	uint32_t offset = 0;
+
+	*done = 0;
+
+	while (n_chunks < MIN(stlink_mem_pipeline_depth, STLINK_MEM_PIPELINE_MAX) && offset < count) {
+		uint32_t len = stlink_max_block_size(h->max_mem_packet, addr + offset);
+		len = MIN(len, MIN(count - offset, STLINK_MAX_RW16_32));
+
+		struct stlink_mem_chunk *chunk = &chunks[n_chunks++];
+		memset(chunk->cmd, 0, sizeof(chunk->cmd));
+		chunk->cmd[0] = STLINK_DEBUG_COMMAND;
+		chunk->cmd[1] = write ? STLINK_DEBUG_WRITEMEM_32BIT : STLINK_DEBUG_READMEM_32BIT;
+		h_u32_to_le(&chunk->cmd[2], addr + offset);
+		h_u16_to_le(&chunk->cmd[6], len);
+		chunk->cmd[8] = ap_num;
+		h_u24_to_le(&chunk->cmd[9], csw >> 8);
+		chunk->buf = &buffer[offset];
+		chunk->len = len;
+		chunk->write = write;
+
+		offset += len;
+	}
+
+	int retval = h->backend->xfer_mem_chunks(h, chunks, n_chunks);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < n_chunks; i++) {
+		memcpy(h->databuf, chunks[i].status, sizeof(chunks[i].status));
+		retval = stlink_usb_error_check(h);
+		if (retval != ERROR_OK)
+			return retval;
+
+		*done += chunks[i].len;
+	}
+
+	return ERROR_OK;
+}
+
 static uint32_t stlink_max_block_size(uint32_t tar_autoincr_block, uint32_t address)
 {
 	uint32_t max_tar_block = (tar_autoincr_block - ((tar_autoincr_block - 1) & address));
@@ -2821,6 +3063,24 @@ static int stlink_usb_read_ap_mem(void *handle, uint8_t ap_num, uint32_t csw,
 		bytes_remaining = (size != 1) ?
 				stlink_max_block_size(h->max_mem_packet, addr) : stlink_usb_block(h);
 
+		/* keep several aligned 32 bit chunks in flight */
+		if (size == 4 && !(addr & 3) && count / 4 * 4 > bytes_remaining &&
+				stlink_usb_can_pipeline(h)) {
+			uint32_t done;
+			retval = stlink_usb_rw_mem32_pipelined(handle, ap_num, csw, false,
+					addr, count / 4 * 4, buffer, &done);
+			buffer += done;
+			addr += done;
+			count -= done;
+			if (retval == ERROR_WAIT && retries < MAX_WAIT_RETRIES) {
+				usleep((1 << retries++) * 1000);
+				continue;
+			}
+			if (retval != ERROR_OK)
+				return retval;
+			continue;
+		}
+
 		if (count < bytes_remaining)
 			bytes_remaining = count;
 
@@ -2907,6 +3167,24 @@ static int stlink_usb_write_ap_mem(void *handle, uint8_t ap_num, uint32_t csw,
 		bytes_remaining = (size != 1) ?
 				stlink_max_block_size(h->max_mem_packet, addr) : stlink_usb_block(h);
 
+		/* keep several aligned 32 bit chunks in flight */
+		if (size == 4 && !(addr & 3) && count / 4 * 4 > bytes_remaining &&
+				stlink_usb_can_pipeline(h)) {
+			uint32_t done;
+			retval = stlink_usb_rw_mem32_pipelined(handle, ap_num, csw, true,
+					addr, count / 4 * 4, (uint8_t *)buffer, &done);
+			buffer += done;
+			addr += done;
+			count -= done;
+			if (retval == ERROR_WAIT && retries < MAX_WAIT_RETRIES) {
+				usleep((1 << retries++) * 1000);
+				continue;
+			}
+			if (retval != ERROR_OK)
+				return retval;
+			continue;
+		}
+
 		if (count < bytes_remaining)
 			bytes_remaining = count;
 
@@ -3677,6 +3955,9 @@ static struct stlink_backend_s stlink_usb_backend = {
 	.close = stlink_usb_usb_close,
 	.xfer_noerrcheck = stlink_usb_usb_xfer_noerrcheck,
 	.read_trace = stlink_usb_usb_read_trace,
+#ifdef USE_LIBUSB_ASYNCIO
+	.xfer_mem_chunks = stlink_usb_usb_xfer_mem_chunks,
+#endif
 };
 
 static struct stlink_backend_s stlink_tcp_backend = {
@@ -3684,6 +3965,7 @@ static struct stlink_backend_s stlink_tcp_backend = {
 	.close = stlink_tcp_close,
 	.xfer_noerrcheck = stlink_tcp_xfer_noerrcheck,
 	.read_trace = stlink_tcp_read_trace,
+	.xfer_mem_chunks = stlink_tcp_xfer_mem_chunks,
 };
 
 static int stlink_open(struct hl_interface_param_s *param, enum stlink_mode mode, void **fd)
@@ -4996,6 +5278,27 @@ COMMAND_HANDLER(stlink_dap_backend_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(stlink_dap_pipeline_depth_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int depth;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], depth);
+		if (depth < 1 || depth > STLINK_MEM_PIPELINE_MAX) {
+			command_print(CMD, "pipeline depth must be between 1 and %d",
+					STLINK_MEM_PIPELINE_MAX);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		stlink_mem_pipeline_depth = depth;
+	}
+
+	command_print(CMD, "%u", stlink_mem_pipeline_depth);
+
+	return ERROR_OK;
+}
+
 #define BYTES_PER_LINE 16
 COMMAND_HANDLER(stlink_dap_cmd_command)
 {
@@ -5049,6 +5352,13 @@ static const struct command_registration stlink_dap_subcommand_handlers[] = {
 		.help = "select which ST-Link backend to use",
 		.usage = "usb | tcp [port]",
 	},
+	{
+		.name = "pipeline_depth",
+		.handler = stlink_dap_pipeline_depth_command,
+		.mode = COMMAND_ANY,
+		.help = "set or show the number of memory read/write commands kept in flight",
+		.usage = "[1-8]",
+	},
 	{
 		.name = "cmd",
 		.handler = stlink_dap_cmd_command,
@@ -9,10 +9,13 @@
 #include "config.h"
 #endif
 
+#include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <linux/pci.h>
 
 #include <jtag/interface.h>
@@ -20,6 +23,7 @@
 #include <jtag/commands.h>
 #include <helper/replacements.h>
 #include <helper/bits.h>
+#include <helper/time_support.h>
 
 /* Available only from kernel v4.10 */
 #ifndef PCI_CFG_SPACE_EXP_SIZE
@@ -38,6 +42,20 @@
 #define XLNX_XVC_VSEC_ID	0x8
 #define XLNX_XVC_MAX_BITS	0x20
 
+/*
+ * Register layout of the debug bridge in PCIe-to-BSCAN/XVC mode when mapped
+ * in a BAR instead of the configuration space
+ */
+#define XLNX_XVC_BAR_LEN_REG	0x00
+#define XLNX_XVC_BAR_TMS_REG	0x04
+#define XLNX_XVC_BAR_TDI_REG	0x08
+#define XLNX_XVC_BAR_TDO_REG	0x0C
+#define XLNX_XVC_BAR_CTRL_REG	0x10
+#define XLNX_XVC_BAR_SIZE	0x14
+
+#define XLNX_XVC_BAR_CTRL_START	BIT(0)
+#define XLNX_XVC_BAR_TIMEOUT_MS	100
+
 #define MASK_ACK(x) (((x) >> 9) & 0x7)
 #define MASK_PAR(x) ((int)((x) & 0x1))
 
@@ -45,9 +63,22 @@ struct xlnx_pcie_xvc {
 	int fd;
 	unsigned offset;
 	char *device;
+	/* BAR holding the registers, -1 to use the configuration space */
+	int bar;
+	off_t bar_offset;
+	void *bar_map;
+	size_t bar_map_size;
+	volatile uint32_t *bar_regs;
+	/* last value written in the length register, SIZE_MAX if unknown */
+	size_t len;
 };
 
-static struct xlnx_pcie_xvc xlnx_pcie_xvc_state;
+static struct xlnx_pcie_xvc xlnx_pcie_xvc_state = {
+	.fd = -1,
+	.bar = -1,
+	.bar_map = MAP_FAILED,
+	.len = SIZE_MAX,
+};
 static struct xlnx_pcie_xvc *xlnx_pcie_xvc = &xlnx_pcie_xvc_state;
 
 static int xlnx_pcie_xvc_read_reg(const int offset, uint32_t *val)
@@ -91,14 +122,68 @@ static int xlnx_pcie_xvc_write_reg(const int offset, const uint32_t val)
 	return ERROR_OK;
 }
 
-static int xlnx_pcie_xvc_transact(size_t num_bits, uint32_t tms, uint32_t tdi,
-				  uint32_t *tdo)
+/*
+ * Registers in the BAR are little endian. Each access is a single 32 bits
+ * load or store, without any system call.
+ */
+static inline uint32_t xlnx_pcie_xvc_bar_read(const int offset)
+{
+	uint32_t raw = xlnx_pcie_xvc->bar_regs[offset / 4];
+
+	return le_to_h_u32((const uint8_t *)&raw);
+}
+
+static inline void xlnx_pcie_xvc_bar_write(const int offset, const uint32_t val)
+{
+	uint32_t raw;
+
+	h_u32_to_le((uint8_t *)&raw, val);
+	xlnx_pcie_xvc->bar_regs[offset / 4] = raw;
+}
+
+static int xlnx_pcie_xvc_bar_shift(size_t num_bits, uint32_t tms, uint32_t tdi,
+				   uint32_t *tdo)
+{
+	if (num_bits != xlnx_pcie_xvc->len) {
+		xlnx_pcie_xvc_bar_write(XLNX_XVC_BAR_LEN_REG, num_bits);
+		xlnx_pcie_xvc->len = num_bits;
+	}
+	xlnx_pcie_xvc_bar_write(XLNX_XVC_BAR_TMS_REG, tms);
+	xlnx_pcie_xvc_bar_write(XLNX_XVC_BAR_TDI_REG, tdi);
+	xlnx_pcie_xvc_bar_write(XLNX_XVC_BAR_CTRL_REG, XLNX_XVC_BAR_CTRL_START);
+
+	/* the shift takes a few TCK cycles, don't read the clock for it */
+	int64_t then = 0;
+	while (xlnx_pcie_xvc_bar_read(XLNX_XVC_BAR_CTRL_REG) & XLNX_XVC_BAR_CTRL_START) {
+		if (!then) {
+			then = timeval_ms();
+		} else if (timeval_ms() - then > XLNX_XVC_BAR_TIMEOUT_MS) {
+			LOG_ERROR("Timeout waiting for XVC shift to complete");
+			xlnx_pcie_xvc->len = SIZE_MAX;
+			return ERROR_JTAG_DEVICE_ERROR;
+		}
+	}
+
+	if (tdo)
+		*tdo = xlnx_pcie_xvc_bar_read(XLNX_XVC_BAR_TDO_REG);
+
+	return ERROR_OK;
+}
+
+static int xlnx_pcie_xvc_cfg_shift(size_t num_bits, uint32_t tms, uint32_t tdi,
+				   uint32_t *tdo)
 {
 	int err;
 
-	err = xlnx_pcie_xvc_write_reg(XLNX_XVC_LEN_REG, num_bits);
-	if (err != ERROR_OK)
-		return err;
+	/* most scans are made of full words, skip rewriting the length */
+	if (num_bits != xlnx_pcie_xvc->len) {
+		err = xlnx_pcie_xvc_write_reg(XLNX_XVC_LEN_REG, num_bits);
+		if (err != ERROR_OK) {
+			xlnx_pcie_xvc->len = SIZE_MAX;
+			return err;
+		}
+		xlnx_pcie_xvc->len = num_bits;
+	}
 
 	err = xlnx_pcie_xvc_write_reg(XLNX_XVC_TMS_REG, tms);
 	if (err != ERROR_OK)
@@ -108,7 +193,18 @@ static int xlnx_pcie_xvc_transact(size_t num_bits, uint32_t tms, uint32_t tdi,
 	if (err != ERROR_OK)
 		return err;
 
-	err = xlnx_pcie_xvc_read_reg(XLNX_XVC_TDX_REG, tdo);
+	return xlnx_pcie_xvc_read_reg(XLNX_XVC_TDX_REG, tdo);
+}
+
+static int xlnx_pcie_xvc_transact(size_t num_bits, uint32_t tms, uint32_t tdi,
+				  uint32_t *tdo)
+{
+	int err;
+
+	if (xlnx_pcie_xvc->bar_regs)
+		err = xlnx_pcie_xvc_bar_shift(num_bits, tms, tdi, tdo);
+	else
+		err = xlnx_pcie_xvc_cfg_shift(num_bits, tms, tdi, tdo);
 	if (err != ERROR_OK)
 		return err;
 
@@ -380,12 +476,51 @@ static int xlnx_pcie_xvc_execute_queue(void)
 }
 
 
+static int xlnx_pcie_xvc_bar_init(void)
+{
+	char filename[PATH_MAX];
+	long page_size = sysconf(_SC_PAGE_SIZE);
+	off_t map_base = xlnx_pcie_xvc->bar_offset & ~((off_t)page_size - 1);
+
+	snprintf(filename, PATH_MAX, "/sys/bus/pci/devices/%s/resource%d",
+		 xlnx_pcie_xvc->device, xlnx_pcie_xvc->bar);
+	xlnx_pcie_xvc->fd = open(filename, O_RDWR | O_SYNC);
+	if (xlnx_pcie_xvc->fd < 0) {
+		LOG_ERROR("Failed to open device: %s", filename);
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	xlnx_pcie_xvc->bar_map_size = xlnx_pcie_xvc->bar_offset - map_base + XLNX_XVC_BAR_SIZE;
+	xlnx_pcie_xvc->bar_map = mmap(NULL, xlnx_pcie_xvc->bar_map_size, PROT_READ | PROT_WRITE,
+				      MAP_SHARED, xlnx_pcie_xvc->fd, map_base);
+	if (xlnx_pcie_xvc->bar_map == MAP_FAILED) {
+		LOG_ERROR("Failed to map %s: %s", filename, strerror(errno));
+		close(xlnx_pcie_xvc->fd);
+		xlnx_pcie_xvc->fd = -1;
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	xlnx_pcie_xvc->bar_regs = (volatile uint32_t *)((uint8_t *)xlnx_pcie_xvc->bar_map +
+							(xlnx_pcie_xvc->bar_offset - map_base));
+	xlnx_pcie_xvc->len = SIZE_MAX;
+
+	LOG_INFO("Using Xilinx XVC/PCIe registers in BAR%d at offset: 0x%llx",
+		 xlnx_pcie_xvc->bar, (unsigned long long)xlnx_pcie_xvc->bar_offset);
+
+	return ERROR_OK;
+}
+
 static int xlnx_pcie_xvc_init(void)
 {
 	char filename[PATH_MAX];
 	uint32_t cap, vh;
 	int err;
 
+	if (xlnx_pcie_xvc->bar >= 0)
+		return xlnx_pcie_xvc_bar_init();
+
+	xlnx_pcie_xvc->len = SIZE_MAX;
+
 	snprintf(filename, PATH_MAX, "/sys/bus/pci/devices/%s/config",
 		 xlnx_pcie_xvc->device);
 	xlnx_pcie_xvc->fd = open(filename, O_RDWR | O_SYNC);
@@ -439,6 +574,13 @@ static int xlnx_pcie_xvc_quit(void)
 {
 	int err;
 
+	if (xlnx_pcie_xvc->bar_map != MAP_FAILED) {
+		if (munmap(xlnx_pcie_xvc->bar_map, xlnx_pcie_xvc->bar_map_size) < 0)
+			LOG_ERROR("munmap: %s", strerror(errno));
+		xlnx_pcie_xvc->bar_map = MAP_FAILED;
+		xlnx_pcie_xvc->bar_regs = NULL;
+	}
+
 	err = close(xlnx_pcie_xvc->fd);
 	if (err)
 		return err;
@@ -461,6 +603,46 @@ COMMAND_HANDLER(xlnx_pcie_xvc_handle_config_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(xlnx_pcie_xvc_handle_bar_command)
+{
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC >= 1) {
+		if (!strcmp(CMD_ARGV[0], "none")) {
+			if (CMD_ARGC != 1)
+				return ERROR_COMMAND_SYNTAX_ERROR;
+			xlnx_pcie_xvc->bar = -1;
+			xlnx_pcie_xvc->bar_offset = 0;
+		} else {
+			unsigned int bar;
+			uint32_t offset = 0;
+
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], bar);
+			if (bar > 5) {
+				command_print(CMD, "BAR number must be in range 0-5");
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+			if (CMD_ARGC == 2)
+				COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], offset);
+			if (offset & 0x3) {
+				command_print(CMD, "offset must be 32 bits aligned");
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+			xlnx_pcie_xvc->bar = bar;
+			xlnx_pcie_xvc->bar_offset = offset;
+		}
+	}
+
+	if (xlnx_pcie_xvc->bar < 0)
+		command_print(CMD, "none");
+	else
+		command_print(CMD, "%d 0x%llx", xlnx_pcie_xvc->bar,
+			      (unsigned long long)xlnx_pcie_xvc->bar_offset);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration xlnx_pcie_xvc_subcommand_handlers[] = {
 	{
 		.name = "config",
@@ -469,6 +651,14 @@ static const struct command_registration xlnx_pcie_xvc_subcommand_handlers[] = {
 		.help = "Configure XVC/PCIe JTAG adapter",
 		.usage = "device",
 	},
+	{
+		.name = "bar",
+		.handler = xlnx_pcie_xvc_handle_bar_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Access the XVC registers memory mapped in a BAR instead of "
+			"the configuration space",
+		.usage = "['none'|bar_num [offset]]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -187,6 +187,13 @@ struct jtag_interface {
 	 */
 	unsigned supported;
 #define DEBUG_CAP_TMS_SEQ	(1 << 0)
+/*
+ * execute_queue() may return before a posted queue (see
+ * jtag_queue_is_posted()) has completed; the driver must complete any
+ * outstanding transfer, and report its errors, at the start of the next
+ * execute_queue() call.
+ */
+#define DEBUG_CAP_QUEUE_ASYNC	(1 << 1)
 
 	/**
 	 * Execute queued commands.
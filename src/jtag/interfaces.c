@@ -49,6 +49,9 @@ extern struct adapter_driver esp_usb_adapter_driver;
 #if BUILD_JTAG_VPI == 1
 extern struct adapter_driver jtag_vpi_adapter_driver;
 #endif
+#if BUILD_REPLAY == 1
+extern struct adapter_driver replay_adapter_driver;
+#endif
 #if BUILD_VDEBUG == 1
 extern struct adapter_driver vdebug_adapter_driver;
 #endif
@@ -166,6 +169,9 @@ struct adapter_driver *adapter_drivers[] = {
 #if BUILD_JTAG_VPI == 1
 		&jtag_vpi_adapter_driver,
 #endif
+#if BUILD_REPLAY == 1
+		&replay_adapter_driver,
+#endif
 #if BUILD_VDEBUG == 1
 		&vdebug_adapter_driver,
 #endif
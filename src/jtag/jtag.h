@@ -131,6 +131,8 @@ struct jtag_tap {
 	uint8_t *cur_instr;
 	/** Bypass register selected */
 	int bypass;
+	/** cur_instr is known to match the content of the TAP's IR */
+	bool ir_cache_valid;
 
 	struct jtag_tap_event_action *event_action;
 
@@ -252,6 +254,41 @@ void jtag_set_verify_capture_ir(bool enable);
 /** @returns True if IR scan verification will be performed. */
 bool jtag_will_verify_capture_ir(void);
 
+/**
+ * Set the file caching the scan chain found by jtag_init_inner(), or
+ * disable the cache with NULL. A matching cache lets the initialization
+ * skip the examination of the chain and the IR capture validation.
+ */
+void jtag_set_chain_cache(const char *filename);
+/** @returns the scan chain cache file, NULL if disabled. */
+const char *jtag_get_chain_cache(void);
+
+/** Enable or disable skipping IR scans of an instruction already loaded. */
+void jtag_set_ir_cache(bool enable);
+/** @returns True if redundant IR scans are skipped. */
+bool jtag_will_ir_cache(void);
+/** Forget the instruction held by every TAP, forcing the next IR scan. */
+void jtag_ir_cache_invalidate(void);
+void jtag_get_ir_cache_stats(uint64_t *hits, uint64_t *misses);
+
+/** Counters of the command queue peephole optimizer. */
+struct jtag_optimize_stats {
+	/** number of queues that went through the optimizer */
+	uint64_t queues;
+	/** number of commands inspected */
+	uint64_t commands;
+	/** number of commands dropped or folded into their predecessor */
+	uint64_t commands_removed;
+	/** number of TCK cycles no longer shifted */
+	uint64_t bits_saved;
+};
+
+/** Enable or disable the command queue peephole optimizer. */
+void jtag_set_optimize(bool enable);
+/** @returns True if queued commands are optimized before execution. */
+bool jtag_will_optimize(void);
+void jtag_get_optimize_stats(struct jtag_optimize_stats *stats);
+
 /** Set ms to sleep after jtag_execute_queue() flushes queue. Debug purposes. */
 void jtag_set_flush_queue_sleep(int ms);
 
@@ -518,6 +555,32 @@ int jtag_execute_queue(void);
 /** same as jtag_execute_queue() but does not clear the error flag */
 void jtag_execute_queue_noclear(void);
 
+/**
+ * Hint that the queue can be started now, because the caller does not
+ * need anything back from it yet.
+ *
+ * In pipelined mode, and if the adapter driver supports it, the queue is
+ * handed to the driver which may return before the transfer completes,
+ * so that the caller can build the next queue while this one is still in
+ * flight. Otherwise, or if the queue captures data or has callbacks, the
+ * commands simply stay queued.
+ *
+ * The next jtag_execute_queue() is the fence: it waits for all the posted
+ * queues and reports their errors.
+ *
+ * @returns an error already recorded for the pending queues, or ERROR_OK.
+ */
+int jtag_execute_queue_posted(void);
+
+/** Enable or disable posting of queues to drivers that support it. */
+void jtag_set_pipeline(bool enable);
+/** @returns True if jtag_execute_queue_posted() may run queues asynchronously. */
+bool jtag_will_pipeline(void);
+/** @returns True while the queue being executed has been posted. */
+bool jtag_queue_is_posted(void);
+/** @returns the number of queues handed to the driver as posted */
+uint64_t jtag_get_posted_queue_count(void);
+
 /** @returns the number of times the scan queue has been flushed */
 int jtag_get_flush_queue_count(void);
 
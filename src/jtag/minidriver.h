@@ -69,6 +69,8 @@ int interface_jtag_add_reset(int trst, int srst);
 int interface_jtag_add_sleep(uint32_t us);
 int interface_jtag_add_clocks(int num_cycles);
 int interface_jtag_execute_queue(void);
+/** @returns True if callbacks have been queued with jtag_add_callback() */
+bool interface_jtag_has_callbacks(void);
 
 /**
  * Calls the interface callback to execute the queue.  This routine
@@ -260,6 +260,47 @@ COMMAND_HANDLER(handle_jtag_flush_count)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_jtag_queue_stats)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "trim"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		jtag_command_queue_release_pages();
+	}
+
+	struct cmd_queue_stats stats;
+	jtag_command_queue_get_stats(&stats);
+
+	command_print(CMD, "pages live:     %u (%u free, %u retained)",
+		stats.pages_live, stats.pages_free, stats.pages_retained);
+	command_print(CMD, "peak bytes:     %zu", stats.peak_bytes);
+	command_print(CMD, "queue resets:   %" PRIu64, stats.resets);
+	command_print(CMD, "page allocs:    %" PRIu64, stats.page_allocs);
+	command_print(CMD, "page frees:     %" PRIu64, stats.page_frees);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_stats)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		adapter_stats_reset(ADAPTER_STATS_JTAG);
+		return ERROR_OK;
+	}
+
+	adapter_stats_print(CMD, ADAPTER_STATS_JTAG);
+
+	return ERROR_OK;
+}
+
 /* REVISIT Just what about these should "move" ... ?
  * These registrations, into the main JTAG table?
  *
@@ -287,6 +328,22 @@ static const struct command_registration jtag_command_handlers_to_move[] = {
 			"has been flushed.",
 		.usage = "",
 	},
+	{
+		.name = "queue_stats",
+		.mode = COMMAND_EXEC,
+		.handler = handle_jtag_queue_stats,
+		.help = "Report usage of the JTAG command queue memory. "
+			"With 'trim', release all recycled pages first.",
+		.usage = "['trim']",
+	},
+	{
+		.name = "stats",
+		.mode = COMMAND_ANY,
+		.handler = handle_jtag_stats,
+		.help = "Report histograms of JTAG queue flush latency, depth, "
+			"bits shifted and flushes per operation, or clear them.",
+		.usage = "['reset']",
+	},
 	{
 		.name = "pathmove",
 		.mode = COMMAND_EXEC,
@@ -817,6 +874,83 @@ COMMAND_HANDLER(handle_jtag_init_command)
 	return jtag_init(CMD_CTX);
 }
 
+COMMAND_HANDLER(handle_jtag_pipeline_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+		jtag_set_pipeline(enable);
+	}
+
+	command_print(CMD, "jtag queue pipelining is %s, %" PRIu64 " queues posted",
+		jtag_will_pipeline() ? "enabled" : "disabled",
+		jtag_get_posted_queue_count());
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_chain_cache_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		jtag_set_chain_cache(strcmp(CMD_ARGV[0], "none") ? CMD_ARGV[0] : NULL);
+
+	const char *filename = jtag_get_chain_cache();
+	command_print(CMD, "%s", filename ? filename : "none");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_ir_cache_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+		jtag_set_ir_cache(enable);
+	}
+
+	uint64_t hits, misses;
+	jtag_get_ir_cache_stats(&hits, &misses);
+
+	command_print(CMD, "jtag IR cache is %s",
+		jtag_will_ir_cache() ? "enabled" : "disabled");
+	command_print(CMD, "%" PRIu64 " IR scans skipped, %" PRIu64 " shifted",
+		hits, misses);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_optimize_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+		jtag_set_optimize(enable);
+	}
+
+	struct jtag_optimize_stats stats;
+	jtag_get_optimize_stats(&stats);
+
+	command_print(CMD, "jtag queue optimization is %s",
+		jtag_will_optimize() ? "enabled" : "disabled");
+	command_print(CMD, "%" PRIu64 " queues, %" PRIu64 " of %" PRIu64
+		" commands removed, %" PRIu64 " bits saved",
+		stats.queues, stats.commands_removed, stats.commands, stats.bits_saved);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_subcommand_handlers[] = {
 	{
 		.name = "init",
@@ -903,6 +1037,38 @@ static const struct command_registration jtag_subcommand_handlers[] = {
 		.help = "Returns list of all JTAG tap names.",
 		.usage = "",
 	},
+	{
+		.name = "chain_cache",
+		.mode = COMMAND_CONFIG,
+		.handler = handle_jtag_chain_cache_command,
+		.help = "Set the file caching the scan chain, which lets "
+			"a warm start skip the chain examination.",
+		.usage = "[filename|'none']",
+	},
+	{
+		.name = "ir_cache",
+		.mode = COMMAND_ANY,
+		.handler = handle_jtag_ir_cache_command,
+		.help = "Display or change skipping of IR scans that load "
+			"the instruction already held by the TAPs.",
+		.usage = "['enable'|'disable']",
+	},
+	{
+		.name = "pipeline",
+		.mode = COMMAND_ANY,
+		.handler = handle_jtag_pipeline_command,
+		.help = "Display or change whether write-only queues may be "
+			"executed asynchronously by the adapter driver.",
+		.usage = "['enable'|'disable']",
+	},
+	{
+		.name = "optimize",
+		.mode = COMMAND_ANY,
+		.handler = handle_jtag_optimize_command,
+		.help = "Display or change the peephole optimization of "
+			"the JTAG queue and report what it saved.",
+		.usage = "['enable'|'disable']",
+	},
 	{
 		.chain = jtag_command_handlers_to_move,
 	},
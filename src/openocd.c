@@ -21,12 +21,18 @@
 #include <transport/transport.h>
 #include <helper/util.h>
 #include <helper/configuration.h>
+#include <helper/event_trace.h>
+#include <helper/fileio.h>
+#include <helper/metrics.h>
+#include <helper/time_support.h>
 #include <flash/nor/core.h>
 #include <flash/nand/core.h>
 #include <pld/pld.h>
 #include <target/arm_cti.h>
+#include <target/arm_tmc.h>
 #include <target/arm_adi_v5.h>
 #include <target/arm_tpiu_swo.h>
+#include <target/mem_ap_sampler.h>
 #include <rtt/rtt.h>
 
 #include <server/server.h>
@@ -50,6 +56,48 @@ static const char openocd_startup_tcl[] = {
 0 /* Terminate with zero */
 };
 
+#define STARTUP_PROFILE_MAX_PHASES 64
+
+/* the time spent in each phase of the startup, in the order they ran */
+static struct startup_phase {
+	const char *name;
+	int64_t us;
+} startup_phases[STARTUP_PROFILE_MAX_PHASES];
+static unsigned int startup_num_phases;
+static int64_t startup_profile_last;
+
+/* close the current phase of the startup, the next one starts now */
+static void startup_profile_mark(const char *name)
+{
+	int64_t now = timeval_us();
+
+	if (startup_num_phases < STARTUP_PROFILE_MAX_PHASES) {
+		startup_phases[startup_num_phases].name = name;
+		startup_phases[startup_num_phases].us = now - startup_profile_last;
+		startup_num_phases++;
+	}
+	LOG_DEBUG("startup: %s took %" PRId64 " us", name, now - startup_profile_last);
+
+	startup_profile_last = now;
+}
+
+COMMAND_HANDLER(handle_startup_profile_command)
+{
+	int64_t total = 0;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	for (unsigned int i = 0; i < startup_num_phases; i++) {
+		command_print(CMD, "%-24s %10.3f ms", startup_phases[i].name,
+			startup_phases[i].us / 1000.0);
+		total += startup_phases[i].us;
+	}
+	command_print(CMD, "%-24s %10.3f ms", "total", total / 1000.0);
+
+	return ERROR_OK;
+}
+
 /* Give scripts and TELNET a way to find out what version this is */
 COMMAND_HANDLER(handler_version_command)
 {
@@ -120,15 +168,19 @@ COMMAND_HANDLER(handle_init_command)
 
 	bool save_poll_mask = jtag_poll_mask();
 
+	startup_profile_mark("before init");
+
 	retval = command_run_line(CMD_CTX, "target init");
 	if (retval != ERROR_OK)
 		return ERROR_FAIL;
+	startup_profile_mark("target init");
 
 	retval = adapter_init(CMD_CTX);
 	if (retval != ERROR_OK) {
 		/* we must be able to set up the debug adapter */
 		return retval;
 	}
+	startup_profile_mark("adapter init");
 
 	LOG_DEBUG("Debug Adapter init complete");
 
@@ -142,14 +194,17 @@ COMMAND_HANDLER(handle_init_command)
 	retval = command_run_line(CMD_CTX, "transport init");
 	if (retval != ERROR_OK)
 		return ERROR_FAIL;
+	startup_profile_mark("transport init");
 
 	retval = command_run_line(CMD_CTX, "dap init");
 	if (retval != ERROR_OK)
 		return ERROR_FAIL;
+	startup_profile_mark("dap init");
 
 	LOG_DEBUG("Examining targets...");
 	if (target_examine() != ERROR_OK)
 		LOG_DEBUG("target examination failed");
+	startup_profile_mark("target examine");
 
 	command_context_mode(CMD_CTX, COMMAND_CONFIG);
 
@@ -162,10 +217,12 @@ COMMAND_HANDLER(handle_init_command)
 	if (command_run_line(CMD_CTX, "pld init") != ERROR_OK)
 		return ERROR_FAIL;
 	command_context_mode(CMD_CTX, COMMAND_EXEC);
+	startup_profile_mark("flash, nand and pld init");
 
 	/* in COMMAND_EXEC, after target_examine(), only tpiu or only swo */
 	if (command_run_line(CMD_CTX, "tpiu init") != ERROR_OK)
 		return ERROR_FAIL;
+	startup_profile_mark("tpiu init");
 
 	jtag_poll_unmask(save_poll_mask);
 
@@ -176,6 +233,7 @@ COMMAND_HANDLER(handle_init_command)
 
 	if (command_run_line(CMD_CTX, "_run_post_init_commands") != ERROR_OK)
 		return ERROR_FAIL;
+	startup_profile_mark("post init commands");
 
 	return ERROR_OK;
 }
@@ -222,6 +280,13 @@ static const struct command_registration openocd_command_handlers[] = {
 		.help = "dir to search for config files and scripts",
 		.usage = "<directory>"
 	},
+	{
+		.name = "startup_profile",
+		.handler = &handle_startup_profile_command,
+		.mode = COMMAND_ANY,
+		.help = "show the time spent in each phase of the startup",
+		.usage = ""
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -234,36 +299,49 @@ struct command_context *global_cmd_ctx;
 
 static struct command_context *setup_command_handler(Jim_Interp *interp)
 {
+	startup_profile_last = timeval_us();
+
 	log_init();
 	LOG_DEBUG("log_init: complete");
+	startup_profile_mark("log init");
 
 	struct command_context *cmd_ctx = command_init(openocd_startup_tcl, interp);
+	startup_profile_mark("startup.tcl");
 
 	/* register subsystem commands */
 	typedef int (*command_registrant_t)(struct command_context *cmd_ctx_value);
-	static const command_registrant_t command_registrants[] = {
-		&openocd_register_commands,
-		&server_register_commands,
-		&gdb_register_commands,
-		&log_register_commands,
-		&rtt_server_register_commands,
-		&transport_register_commands,
-		&adapter_register_commands,
-		&target_register_commands,
-		&flash_register_commands,
-		&nand_register_commands,
-		&pld_register_commands,
-		&cti_register_commands,
-		&dap_register_commands,
-		&arm_tpiu_swo_register_commands,
-		NULL
+	static const struct {
+		const char *name;
+		command_registrant_t registrant;
+	} command_registrants[] = {
+		{ "openocd commands", &openocd_register_commands },
+		{ "server commands", &server_register_commands },
+		{ "gdb commands", &gdb_register_commands },
+		{ "log commands", &log_register_commands },
+		{ "event_trace commands", &event_trace_register_commands },
+		{ "metrics commands", &metrics_register_commands },
+		{ "fileio commands", &fileio_register_commands },
+		{ "rtt server commands", &rtt_server_register_commands },
+		{ "transport commands", &transport_register_commands },
+		{ "adapter commands", &adapter_register_commands },
+		{ "target commands", &target_register_commands },
+		{ "flash commands", &flash_register_commands },
+		{ "nand commands", &nand_register_commands },
+		{ "pld commands", &pld_register_commands },
+		{ "cti commands", &cti_register_commands },
+		{ "tmc commands", &tmc_register_commands },
+		{ "dap commands", &dap_register_commands },
+		{ "tpiu commands", &arm_tpiu_swo_register_commands },
+		{ "mem_ap_sampler commands", &mem_ap_sampler_register_commands },
+		{ NULL, NULL }
 	};
-	for (unsigned i = 0; command_registrants[i]; i++) {
-		int retval = (*command_registrants[i])(cmd_ctx);
+	for (unsigned int i = 0; command_registrants[i].registrant; i++) {
+		int retval = (*command_registrants[i].registrant)(cmd_ctx);
 		if (retval != ERROR_OK) {
 			command_done(cmd_ctx);
 			return NULL;
 		}
+		startup_profile_mark(command_registrants[i].name);
 	}
 	LOG_DEBUG("command registration: complete");
 
@@ -285,9 +363,11 @@ static int openocd_thread(int argc, char *argv[], struct command_context *cmd_ct
 
 	if (parse_cmdline_args(cmd_ctx, argc, argv) != ERROR_OK)
 		return ERROR_FAIL;
+	startup_profile_mark("command line");
 
 	if (server_preinit() != ERROR_OK)
 		return ERROR_FAIL;
+	startup_profile_mark("server preinit");
 
 	ret = parse_config_file(cmd_ctx);
 	if (ret == ERROR_COMMAND_CLOSE_CONNECTION) {
@@ -298,9 +378,12 @@ static int openocd_thread(int argc, char *argv[], struct command_context *cmd_ct
 		return ERROR_FAIL;
 	}
 
+	startup_profile_mark("config files");
+
 	ret = server_init(cmd_ctx);
 	if (ret != ERROR_OK)
 		return ERROR_FAIL;
+	startup_profile_mark("server init");
 
 	if (init_at_startup) {
 		ret = command_run_line(cmd_ctx, "init");
@@ -338,6 +421,7 @@ int openocd_main(int argc, char *argv[])
 
 	if (rtt_init() != ERROR_OK)
 		return EXIT_FAILURE;
+	startup_profile_mark("util and rtt init");
 
 	LOG_OUTPUT("For bug reports, read\n\t"
 		"http://openocd.org/doc/doxygen/bugs.html"
@@ -354,16 +438,19 @@ int openocd_main(int argc, char *argv[])
 	flash_free_all_banks();
 	gdb_service_free();
 	arm_tpiu_swo_cleanup_all();
+	mem_ap_sampler_cleanup_all();
 	server_free();
 
 	unregister_all_commands(cmd_ctx, NULL);
 	help_del_all_commands(cmd_ctx);
 
-	/* free all DAP and CTI objects */
+	/* free all DAP, CTI and TMC objects */
 	arm_cti_cleanup_all();
+	arm_tmc_cleanup_all();
 	dap_cleanup_all();
 
 	adapter_quit();
+	event_trace_stop();
 
 	server_host_os_close();
 
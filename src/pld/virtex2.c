@@ -13,6 +13,9 @@
 #include "xilinx_bit.h"
 #include "pld.h"
 
+/* the bitstream is read and shifted in chunks of this size */
+#define VIRTEX2_CHUNK_SIZE (64 * 1024)
+
 static int virtex2_set_instr(struct jtag_tap *tap, uint32_t new_instr)
 {
 	if (!tap)
@@ -119,15 +122,19 @@ static int virtex2_load(struct pld_device *pld_device, const char *filename)
 	struct virtex2_pld_device *virtex2_info = pld_device->driver_priv;
 	struct xilinx_bit_file bit_file;
 	int retval;
-	unsigned int i;
-	struct scan_field field;
-
-	field.in_value = NULL;
+	uint8_t *chunk;
 
-	retval = xilinx_read_bit_file(&bit_file, filename);
+	retval = xilinx_open_bit_file(&bit_file, filename);
 	if (retval != ERROR_OK)
 		return retval;
 
+	chunk = malloc(MIN(bit_file.length, VIRTEX2_CHUNK_SIZE));
+	if (!chunk && bit_file.length) {
+		LOG_ERROR("Out of memory");
+		xilinx_free_bit_file(&bit_file);
+		return ERROR_FAIL;
+	}
+
 	virtex2_set_instr(virtex2_info->tap, 0xb);	/* JPROG_B */
 	jtag_execute_queue();
 	jtag_add_sleep(1000);
@@ -135,14 +142,49 @@ static int virtex2_load(struct pld_device *pld_device, const char *filename)
 	virtex2_set_instr(virtex2_info->tap, 0x5);	/* CFG_IN */
 	jtag_execute_queue();
 
-	for (i = 0; i < bit_file.length; i++)
-		bit_file.data[i] = flip_u32(bit_file.data[i], 8);
+	/* The bitstream is shifted through the whole chain as plain DR scans,
+	 * each one resuming the shift from DRPAUSE without a capture or an
+	 * update.  The other TAPs are in BYPASS and only delay the stream by one
+	 * bit each, so append as many padding bits for the tail of the bitstream
+	 * to get through them; the configuration logic ignores the leading and
+	 * trailing zeros around the bitstream. */
+	for (uint32_t offset = 0; offset < bit_file.length; ) {
+		uint32_t size = MIN(bit_file.length - offset, VIRTEX2_CHUNK_SIZE);
+
+		retval = xilinx_read_bit_data(&bit_file, chunk, size);
+		if (retval != ERROR_OK)
+			break;
+		buf_flip_bytes(chunk, size);
+
+		jtag_add_plain_dr_scan(size * 8, chunk, NULL, TAP_DRPAUSE);
+		retval = jtag_execute_queue();
+		if (retval != ERROR_OK)
+			break;
+		offset += size;
+	}
 
-	field.num_bits = bit_file.length * 8;
-	field.out_value = bit_file.data;
+	free(chunk);
 
-	jtag_add_dr_scan(virtex2_info->tap, 1, &field, TAP_DRPAUSE);
-	jtag_execute_queue();
+	if (retval != ERROR_OK) {
+		LOG_ERROR("couldn't load the bitstream of %s", filename);
+		jtag_add_tlr();
+		jtag_execute_queue();
+		xilinx_free_bit_file(&bit_file);
+		return retval;
+	}
+
+	unsigned int pad_bits = jtag_tap_count_enabled() - 1;
+	if (pad_bits) {
+		uint8_t *pad = calloc(DIV_ROUND_UP(pad_bits, 8), 1);
+		if (!pad) {
+			LOG_ERROR("Out of memory");
+			xilinx_free_bit_file(&bit_file);
+			return ERROR_FAIL;
+		}
+		jtag_add_plain_dr_scan(pad_bits, pad, NULL, TAP_DRPAUSE);
+		jtag_execute_queue();
+		free(pad);
+	}
 
 	jtag_add_tlr();
 
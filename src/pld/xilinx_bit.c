@@ -15,11 +15,10 @@
 
 #include <helper/system.h>
 
-static int read_section(FILE *input_file, int length_size, char section,
-	uint32_t *buffer_length, uint8_t **buffer)
+static int read_section_length(FILE *input_file, int length_size, char section,
+	uint32_t *length)
 {
 	uint8_t length_buffer[4];
-	int length;
 	char section_char;
 	int read_count;
 
@@ -40,14 +39,25 @@ static int read_section(FILE *input_file, int length_size, char section,
 		return ERROR_PLD_FILE_LOAD_FAILED;
 
 	if (length_size == 4)
-		length = be_to_h_u32(length_buffer);
+		*length = be_to_h_u32(length_buffer);
 	else	/* (length_size == 2) */
-		length = be_to_h_u16(length_buffer);
+		*length = be_to_h_u16(length_buffer);
 
-	if (buffer_length)
-		*buffer_length = length;
+	return ERROR_OK;
+}
+
+static int read_section(FILE *input_file, char section, uint8_t **buffer)
+{
+	uint32_t length;
+	size_t read_count;
+
+	int retval = read_section_length(input_file, 2, section, &length);
+	if (retval != ERROR_OK)
+		return retval;
 
 	*buffer = malloc(length);
+	if (!*buffer)
+		return ERROR_PLD_FILE_LOAD_FAILED;
 
 	read_count = fread(*buffer, 1, length, input_file);
 	if (read_count != length)
@@ -56,7 +66,7 @@ static int read_section(FILE *input_file, int length_size, char section,
 	return ERROR_OK;
 }
 
-int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename)
+int xilinx_open_bit_file(struct xilinx_bit_file *bit_file, const char *filename)
 {
 	FILE *input_file;
 	int read_count;
@@ -75,48 +85,66 @@ int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename)
 	bit_file->date = NULL;
 	bit_file->time = NULL;
 	bit_file->data = NULL;
+	bit_file->input_file = input_file;
 
 	read_count = fread(bit_file->unknown_header, 1, 13, input_file);
 	if (read_count != 13) {
 		LOG_ERROR("couldn't read unknown_header from file '%s'", filename);
-		fclose(input_file);
+		xilinx_free_bit_file(bit_file);
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	if (read_section(input_file, 2, 'a', NULL, &bit_file->source_file) != ERROR_OK) {
+	if (read_section(input_file, 'a', &bit_file->source_file) != ERROR_OK ||
+			read_section(input_file, 'b', &bit_file->part_name) != ERROR_OK ||
+			read_section(input_file, 'c', &bit_file->date) != ERROR_OK ||
+			read_section(input_file, 'd', &bit_file->time) != ERROR_OK ||
+			read_section_length(input_file, 4, 'e', &bit_file->length) != ERROR_OK) {
+		LOG_ERROR("couldn't read the header of file '%s'", filename);
 		xilinx_free_bit_file(bit_file);
-		fclose(input_file);
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	if (read_section(input_file, 2, 'b', NULL, &bit_file->part_name) != ERROR_OK) {
-		xilinx_free_bit_file(bit_file);
-		fclose(input_file);
+	LOG_DEBUG("bit_file: %s %s %s,%s %" PRIu32 "", bit_file->source_file, bit_file->part_name,
+		bit_file->date, bit_file->time, bit_file->length);
+
+	return ERROR_OK;
+}
+
+int xilinx_read_bit_data(struct xilinx_bit_file *bit_file, uint8_t *buffer, uint32_t size)
+{
+	if (!bit_file->input_file)
 		return ERROR_PLD_FILE_LOAD_FAILED;
-	}
 
-	if (read_section(input_file, 2, 'c', NULL, &bit_file->date) != ERROR_OK) {
-		xilinx_free_bit_file(bit_file);
-		fclose(input_file);
+	if (fread(buffer, 1, size, bit_file->input_file) != size) {
+		LOG_ERROR("couldn't read the bitstream: %s",
+			ferror(bit_file->input_file) ? strerror(errno) : "file truncated");
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	if (read_section(input_file, 2, 'd', NULL, &bit_file->time) != ERROR_OK) {
+	return ERROR_OK;
+}
+
+int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename)
+{
+	int retval = xilinx_open_bit_file(bit_file, filename);
+	if (retval != ERROR_OK)
+		return retval;
+
+	bit_file->data = malloc(bit_file->length);
+	if (!bit_file->data) {
+		LOG_ERROR("couldn't allocate %" PRIu32 " bytes for the bitstream", bit_file->length);
 		xilinx_free_bit_file(bit_file);
-		fclose(input_file);
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	if (read_section(input_file, 4, 'e', &bit_file->length, &bit_file->data) != ERROR_OK) {
+	retval = xilinx_read_bit_data(bit_file, bit_file->data, bit_file->length);
+	if (retval != ERROR_OK) {
 		xilinx_free_bit_file(bit_file);
-		fclose(input_file);
-		return ERROR_PLD_FILE_LOAD_FAILED;
+		return retval;
 	}
 
-	LOG_DEBUG("bit_file: %s %s %s,%s %" PRIu32 "", bit_file->source_file, bit_file->part_name,
-		bit_file->date, bit_file->time, bit_file->length);
-
-	fclose(input_file);
+	fclose(bit_file->input_file);
+	bit_file->input_file = NULL;
 
 	return ERROR_OK;
 }
@@ -128,4 +156,14 @@ void xilinx_free_bit_file(struct xilinx_bit_file *bit_file)
 	free(bit_file->date);
 	free(bit_file->time);
 	free(bit_file->data);
+	bit_file->source_file = NULL;
+	bit_file->part_name = NULL;
+	bit_file->date = NULL;
+	bit_file->time = NULL;
+	bit_file->data = NULL;
+
+	if (bit_file->input_file) {
+		fclose(bit_file->input_file);
+		bit_file->input_file = NULL;
+	}
 }
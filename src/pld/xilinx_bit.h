@@ -9,6 +9,7 @@
 #define OPENOCD_PLD_XILINX_BIT_H
 
 #include "helper/types.h"
+#include <stdio.h>
 
 struct xilinx_bit_file {
 	uint8_t unknown_header[13];
@@ -18,10 +19,18 @@ struct xilinx_bit_file {
 	uint8_t *time;
 	uint32_t length;
 	uint8_t *data;
+	/* the file while its bitstream is streamed, positioned at the data */
+	FILE *input_file;
 };
 
+/* read the whole bit file, bitstream included, into @a bit_file->data */
 int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename);
 
+/* read the header only and leave the @a bit_file->length bytes of the
+ * bitstream to be read in chunks with xilinx_read_bit_data() */
+int xilinx_open_bit_file(struct xilinx_bit_file *bit_file, const char *filename);
+int xilinx_read_bit_data(struct xilinx_bit_file *bit_file, uint8_t *buffer, uint32_t size);
+
 void xilinx_free_bit_file(struct xilinx_bit_file *bit_file);
 
 #endif /* OPENOCD_PLD_XILINX_BIT_H */
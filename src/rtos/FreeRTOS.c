@@ -21,6 +21,7 @@
 #include "target/cortex_m.h"
 
 #define FREERTOS_MAX_PRIORITIES	63
+#define FREERTOS_LIST_ELEM_SIZE	32
 
 /* FIXME: none of the _width parameters are actually observed properly!
  * you WILL need to edit more if you actually attempt to target a 8/16/64
@@ -79,6 +80,8 @@ static int freertos_update_threads(struct rtos *rtos);
 static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 		struct rtos_reg **reg_list, int *num_regs);
 static int freertos_get_symbol_list_to_lookup(struct symbol_table_elem *symbol_list[]);
+static int freertos_get_current_thread_address(struct rtos *rtos, target_addr_t *address);
+static int freertos_read_thread_name(struct rtos *rtos, struct thread_detail *detail);
 
 const struct rtos_type freertos_rtos = {
 	.name = "FreeRTOS",
@@ -88,6 +91,8 @@ const struct rtos_type freertos_rtos = {
 	.update_threads = freertos_update_threads,
 	.get_thread_reg_list = freertos_get_thread_reg_list,
 	.get_symbol_list_to_lookup = freertos_get_symbol_list_to_lookup,
+	.get_current_thread_address = freertos_get_current_thread_address,
+	.read_thread_name = freertos_read_thread_name,
 };
 
 enum freertos_symbol_values {
@@ -103,6 +108,7 @@ enum freertos_symbol_values {
 	FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS = 9,
 	FREERTOS_VAL_UX_TOP_USED_PRIORITY = 10,
 	FREERTOS_VAL_X_SCHEDULER_RUNNING = 11,
+	FREERTOS_VAL_UX_TASK_NUMBER = 12,
 };
 
 struct symbols {
@@ -123,6 +129,7 @@ static const struct symbols freertos_symbol_list[] = {
 	{ "uxCurrentNumberOfTasks", false },
 	{ "uxTopUsedPriority", true }, /* Unavailable since v7.5.3 */
 	{ "xSchedulerRunning", false },
+	{ "uxTaskNumber", true }, /* Only to skip rereading the task names */
 	{ NULL, false }
 };
 
@@ -165,8 +172,19 @@ static int freertos_update_threads(struct rtos *rtos)
 		return retval;
 	}
 
-	/* wipe out previous thread details if any */
-	rtos_free_threadlist(rtos);
+	/* uxTaskNumber counts the task creations, while it does not change
+	 * the task at a given TCB address keeps its name */
+	bool task_number_valid = false;
+	uint32_t task_number = 0;
+	if (rtos->symbols[FREERTOS_VAL_UX_TASK_NUMBER].address != 0) {
+		retval = target_read_u32(rtos->target,
+				rtos->symbols[FREERTOS_VAL_UX_TASK_NUMBER].address,
+				&task_number);
+		task_number_valid = retval == ERROR_OK;
+	}
+
+	/* wipe out previous thread details if any, keeping the names */
+	rtos_keep_threadlist(rtos, task_number_valid, task_number);
 
 	/* read the current thread */
 	uint32_t pointer_casts_are_bad;
@@ -211,6 +229,7 @@ static int freertos_update_threads(struct rtos *rtos)
 		rtos->current_thread = 1;
 		rtos->thread_details->threadid = rtos->current_thread;
 		rtos->thread_details->exists = true;
+		rtos->thread_details->name_pending = false;
 		rtos->thread_details->extra_info_str = NULL;
 		rtos->thread_details->thread_name_str = malloc(sizeof(tmp_str));
 		strcpy(rtos->thread_details->thread_name_str, tmp_str);
@@ -274,6 +293,11 @@ static int freertos_update_threads(struct rtos *rtos)
 	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_SUSPENDED_TASK_LIST].address;
 	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_TASKS_WAITING_TERMINATION].address;
 
+	/* a list item is read at once, up to its owner or next item pointer */
+	unsigned int list_elem_size = MAX(param->list_elem_next_offset,
+			param->list_elem_content_offset) + param->pointer_width;
+	assert(list_elem_size <= FREERTOS_LIST_ELEM_SIZE);
+
 	for (unsigned int i = 0; i < num_lists; i++) {
 		if (list_of_lists[i] == 0)
 			continue;
@@ -311,46 +335,29 @@ static int freertos_update_threads(struct rtos *rtos)
 		while ((list_thread_count > 0) && (list_elem_ptr != 0) &&
 				(list_elem_ptr != prev_list_elem_ptr) &&
 				(tasks_found < thread_list_size)) {
-			/* Get the location of the thread structure. */
-			retval = target_read_u32(rtos->target,
-					list_elem_ptr + param->list_elem_content_offset,
-					&pointer_casts_are_bad);
+			/* Read the list item, for the thread structure and the next item */
+			uint8_t list_elem[FREERTOS_LIST_ELEM_SIZE];
+			retval = target_read_buffer(rtos->target, list_elem_ptr,
+					list_elem_size, list_elem);
 			if (retval != ERROR_OK) {
 				LOG_ERROR("Error reading thread list item object in FreeRTOS thread list");
 				free(list_of_lists);
 				return retval;
 			}
+			pointer_casts_are_bad = target_buffer_get_u32(rtos->target,
+					list_elem + param->list_elem_content_offset);
 			rtos->thread_details[tasks_found].threadid = pointer_casts_are_bad;
 			LOG_DEBUG("FreeRTOS: Read Thread ID at 0x%" PRIx32 ", value 0x%" PRIx64,
 										list_elem_ptr + param->list_elem_content_offset,
 										rtos->thread_details[tasks_found].threadid);
 
-			/* get thread name */
-
-			#define FREERTOS_THREAD_NAME_STR_SIZE (200)
-			char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
-
-			/* Read the thread name */
-			retval = target_read_buffer(rtos->target,
-					rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-					FREERTOS_THREAD_NAME_STR_SIZE,
-					(uint8_t *)&tmp_str);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
-			tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
-			LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
-										rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-										tmp_str);
-
-			if (tmp_str[0] == '\x00')
-				strcpy(tmp_str, "No Name");
-
+			/* get thread name, unless the previous update read it */
 			rtos->thread_details[tasks_found].thread_name_str =
-				malloc(strlen(tmp_str)+1);
-			strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
+				rtos_reuse_thread_name(rtos, rtos->thread_details[tasks_found].threadid);
+			/* else it is read when GDB asks for it, see freertos_read_thread_name() */
+			rtos->thread_details[tasks_found].name_pending =
+				!rtos->thread_details[tasks_found].thread_name_str;
+
 			rtos->thread_details[tasks_found].exists = true;
 
 			if (rtos->thread_details[tasks_found].threadid == rtos->current_thread) {
@@ -367,15 +374,8 @@ static int freertos_update_threads(struct rtos *rtos)
 			rtos->thread_count = tasks_found;
 
 			prev_list_elem_ptr = list_elem_ptr;
-			list_elem_ptr = 0;
-			retval = target_read_u32(rtos->target,
-					prev_list_elem_ptr + param->list_elem_next_offset,
-					&list_elem_ptr);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading next thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
+			list_elem_ptr = target_buffer_get_u32(rtos->target,
+					list_elem + param->list_elem_next_offset);
 			LOG_DEBUG("FreeRTOS: Read next thread location at 0x%" PRIx32 ", value 0x%" PRIx32,
 										prev_list_elem_ptr + param->list_elem_next_offset,
 										list_elem_ptr);
@@ -442,23 +442,75 @@ static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 	}
 
 	if (cm4_fpu_enabled == 1) {
-		/* Read the LR to decide between stacking with or without FPU */
-		uint32_t lr_svc = 0;
-		retval = target_read_u32(rtos->target,
-				stack_ptr + 0x20,
-				&lr_svc);
+		const struct rtos_register_stacking *stacking = param->stacking_info_cm4f;
+		const struct rtos_register_stacking *fpu_stacking = param->stacking_info_cm4f_fpu;
+		uint8_t *stack_data = malloc(fpu_stacking->stack_registers_size);
+		if (!stack_data) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+
+		/* Read the frame without FPU registers, its LR at 0x20 tells
+		 * whether the FPU registers follow */
+		retval = target_read_buffer(rtos->target, stack_ptr,
+				stacking->stack_registers_size, stack_data);
+		if (retval == ERROR_OK) {
+			uint32_t lr_svc = target_buffer_get_u32(rtos->target, stack_data + 0x20);
+			if ((lr_svc & 0x10) == 0) {
+				retval = target_read_buffer(rtos->target,
+						stack_ptr + stacking->stack_registers_size,
+						fpu_stacking->stack_registers_size - stacking->stack_registers_size,
+						stack_data + stacking->stack_registers_size);
+				stacking = fpu_stacking;
+			}
+		}
 		if (retval != ERROR_OK) {
+			free(stack_data);
 			LOG_OUTPUT("Error reading stack frame from FreeRTOS thread");
 			return retval;
 		}
-		if ((lr_svc & 0x10) == 0)
-			return rtos_generic_stack_read(rtos->target, param->stacking_info_cm4f_fpu, stack_ptr, reg_list, num_regs);
-		else
-			return rtos_generic_stack_read(rtos->target, param->stacking_info_cm4f, stack_ptr, reg_list, num_regs);
+
+		retval = rtos_generic_stack_decode(rtos->target, stacking, stack_ptr,
+				stack_data, reg_list, num_regs);
+		free(stack_data);
+		return retval;
 	} else
 		return rtos_generic_stack_read(rtos->target, param->stacking_info_cm3, stack_ptr, reg_list, num_regs);
 }
 
+static int freertos_read_thread_name(struct rtos *rtos, struct thread_detail *detail)
+{
+	const struct freertos_params *param = rtos->rtos_specific_params;
+	#define FREERTOS_THREAD_NAME_STR_SIZE (200)
+	char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
+
+	/* Read the thread name */
+	int retval = target_read_buffer(rtos->target,
+			detail->threadid + param->thread_name_offset,
+			FREERTOS_THREAD_NAME_STR_SIZE,
+			(uint8_t *)&tmp_str);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading thread name in FreeRTOS thread list");
+		return retval;
+	}
+	tmp_str[FREERTOS_THREAD_NAME_STR_SIZE - 1] = '\x00';
+	LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
+			detail->threadid + param->thread_name_offset, tmp_str);
+
+	if (tmp_str[0] == '\x00')
+		strcpy(tmp_str, "No Name");
+
+	detail->thread_name_str = strdup(tmp_str);
+	return detail->thread_name_str ? ERROR_OK : ERROR_FAIL;
+}
+
+/* the thread ids are the TCB addresses held by pxCurrentTCB */
+static int freertos_get_current_thread_address(struct rtos *rtos, target_addr_t *address)
+{
+	*address = rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address;
+	return *address ? ERROR_OK : ERROR_FAIL;
+}
+
 static int freertos_get_symbol_list_to_lookup(struct symbol_table_elem *symbol_list[])
 {
 	unsigned int i;
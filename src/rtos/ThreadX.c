@@ -29,6 +29,7 @@ static int threadx_create(struct target *target);
 static int threadx_update_threads(struct rtos *rtos);
 static int threadx_get_thread_reg_list(struct rtos *rtos, int64_t thread_id, struct rtos_reg **reg_list, int *num_regs);
 static int threadx_get_symbol_list_to_lookup(struct symbol_table_elem *symbol_list[]);
+static int threadx_get_current_thread_address(struct rtos *rtos, target_addr_t *address);
 
 
 
@@ -199,6 +200,7 @@ const struct rtos_type threadx_rtos = {
 	.update_threads = threadx_update_threads,
 	.get_thread_reg_list = threadx_get_thread_reg_list,
 	.get_symbol_list_to_lookup = threadx_get_symbol_list_to_lookup,
+	.get_current_thread_address = threadx_get_current_thread_address,
 };
 
 static const struct rtos_register_stacking *get_stacking_info(const struct rtos *rtos, int64_t stack_ptr)
@@ -347,6 +349,12 @@ static int threadx_update_threads(struct rtos *rtos)
 		return retval;
 	}
 
+	/* the name pointer, state and next pointer are read at once */
+	uint32_t tcb_size = MAX(param->thread_name_offset + param->pointer_width,
+			MAX(param->thread_state_offset + 4,
+				param->thread_next_offset + param->pointer_width));
+	uint8_t tcb[RTOS_TCB_MAX_SIZE];
+
 	/* loop over all threads */
 	int64_t prev_thread_ptr = 0;
 	while ((thread_ptr != prev_thread_ptr) && (tasks_found < thread_list_size)) {
@@ -359,16 +367,16 @@ static int threadx_update_threads(struct rtos *rtos)
 		/* Save the thread pointer */
 		rtos->thread_details[tasks_found].threadid = thread_ptr;
 
-		/* read the name pointer */
-		retval = target_read_buffer(rtos->target,
-				thread_ptr + param->thread_name_offset,
-				param->pointer_width,
-				(uint8_t *)&name_ptr);
+		retval = rtos_read_tcb(rtos, thread_ptr, tcb_size, tcb);
 		if (retval != ERROR_OK) {
-			LOG_ERROR("Could not read ThreadX thread name pointer from target");
+			LOG_ERROR("Could not read ThreadX thread control block from target");
 			return retval;
 		}
 
+		/* the name pointer */
+		name_ptr = rtos_tcb_get_field(rtos, tcb, param->thread_name_offset,
+				param->pointer_width);
+
 		/* Read the thread name */
 		tmp_str[0] = '\x00';
 
@@ -393,16 +401,9 @@ static int threadx_update_threads(struct rtos *rtos)
 			malloc(strlen(tmp_str)+1);
 		strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
 
-		/* Read the thread status */
-		int64_t thread_status = 0;
-		retval = target_read_buffer(rtos->target,
-				thread_ptr + param->thread_state_offset,
-				4,
-				(uint8_t *)&thread_status);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading thread state from ThreadX target");
-			return retval;
-		}
+		/* the thread status */
+		int64_t thread_status = rtos_tcb_get_field(rtos, tcb,
+				param->thread_state_offset, 4);
 
 		for (i = 0; (i < THREADX_NUM_STATES) &&
 				(threadx_thread_states[i].value != thread_status); i++) {
@@ -425,15 +426,8 @@ static int threadx_update_threads(struct rtos *rtos)
 		prev_thread_ptr = thread_ptr;
 
 		/* Get the location of the next thread structure. */
-		thread_ptr = 0;
-		retval = target_read_buffer(rtos->target,
-				prev_thread_ptr + param->thread_next_offset,
-				param->pointer_width,
-				(uint8_t *) &thread_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading next thread pointer in ThreadX thread list");
-			return retval;
-		}
+		thread_ptr = rtos_tcb_get_field(rtos, tcb, param->thread_next_offset,
+				param->pointer_width);
 	}
 
 	rtos->thread_count = tasks_found;
@@ -487,6 +481,13 @@ static int threadx_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 	return rtos_generic_stack_read(rtos->target, stacking_info, stack_ptr, reg_list, num_regs);
 }
 
+/* the thread ids are the TCB addresses held by _tx_thread_current_ptr */
+static int threadx_get_current_thread_address(struct rtos *rtos, target_addr_t *address)
+{
+	*address = rtos->symbols[THREADX_VAL_TX_THREAD_CURRENT_PTR].address;
+	return *address ? ERROR_OK : ERROR_FAIL;
+}
+
 static int threadx_get_symbol_list_to_lookup(struct symbol_table_elem *symbol_list[])
 {
 	unsigned int i;
@@ -250,10 +250,20 @@ static int hwthread_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 
 	int j = 0;
 	for (int i = 0; i < reg_list_size; i++) {
-		if (!reg_list[i] || reg_list[i]->exist == false || reg_list[i]->hidden)
+		if (!reg_list[i] || !reg_list[i]->exist || reg_list[i]->hidden) {
+			reg_list[i] = NULL;
 			continue;
+		}
 		j++;
 	}
+
+	/* read the registers of the core in one batch where it can, the loop
+	 * below then only reads those the batch left out */
+	retval = target_read_registers(curr, reg_list, reg_list_size);
+	if (retval != ERROR_OK) {
+		free(reg_list);
+		return retval;
+	}
 	*rtos_reg_list_size = j;
 	*rtos_reg_list = calloc(*rtos_reg_list_size, sizeof(struct rtos_reg));
 	if (!*rtos_reg_list) {
@@ -10,6 +10,7 @@
 #include "config.h"
 #endif
 
+#include <helper/align.h>
 #include <helper/time_support.h>
 #include <jtag/jtag.h>
 #include "target/target.h"
@@ -41,6 +42,8 @@ struct linux_os {
 	/*  virt2phys parameter */
 	uint32_t phys_mask;
 	uint32_t phys_base;
+	/*  phys_base computed from the init_task translation */
+	bool phys_valid;
 };
 
 struct current_thread {
@@ -64,6 +67,7 @@ struct threads {
 	int status;		/* dead = 1 alive = 2 current = 3 alive and current */
 	/*  value that should not change during the live of a thread ? */
 	uint32_t thread_info_addr;	/*  contain latest thread_info_addr computed */
+	uint32_t next_base_addr;	/*  next task in the list, filled by fill_task */
 	/*  retrieve from thread_info */
 	struct cpu_context *context;
 	struct threads *next;
@@ -105,12 +109,14 @@ static int linux_compute_virt2phys(struct target *target, target_addr_t address)
 		LOG_ERROR("Cannot compute linux virt2phys translation");
 		/*  fixes default address  */
 		linux_os->phys_base = 0;
+		linux_os->phys_valid = false;
 		return ERROR_FAIL;
 	}
 
 	linux_os->init_task_addr = address;
 	address = address & linux_os->phys_mask;
 	linux_os->phys_base = pa - address;
+	linux_os->phys_valid = true;
 	return ERROR_OK;
 }
 
@@ -128,10 +134,12 @@ static int linux_read_memory(struct target *target,
 		return ERROR_FAIL;
 	}
 #ifdef PHYS
-	target_read_phys_memory(target, pa, size, count, buffer);
+	/*  the kernel memory is linearly mapped, the translation of init_task
+	 *  holds for all of it and saves a table walk per access */
+	if (linux_os->phys_valid)
+		return target_read_phys_memory(target, pa, size, count, buffer);
 #endif
-	target_read_memory(target, address, size, count, buffer);
-	return ERROR_OK;
+	return target_read_memory(target, address, size, count, buffer);
 }
 
 static int fill_buffer(struct target *target, uint32_t addr, uint8_t *buffer)
@@ -280,58 +288,69 @@ int fill_task_pid(struct target *target, struct threads *t)
 }
 #endif
 
-static int fill_task(struct target *target, struct threads *t)
+/*  the part of a task_struct read by fill_task: all the fields it uses */
+static uint32_t task_slice_size(void)
 {
-	int retval;
-	uint32_t pid_addr = t->base_addr + PID;
-	uint32_t mem_addr = t->base_addr + MEM;
-	uint32_t on_cpu = t->base_addr + ONCPU;
-	uint8_t *buffer = calloc(1, 4);
-	retval = fill_buffer(target, t->base_addr, buffer);
-
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->state = val;
-	} else
-		LOG_ERROR("fill_task: unable to read memory");
-
-	retval = fill_buffer(target, pid_addr, buffer);
+	static const uint32_t ends[] = {
+		4, PID + 4, MEM + 4, ONCPU + 4, NEXT + 4, COMM + 16
+	};
+	uint32_t size = 0;
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(ends); i++)
+		size = MAX(size, ends[i]);
+	return ALIGN_UP(size, 4);
+}
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->pid = val;
-	} else
-		LOG_ERROR("fill task: unable to read memory");
+static void decode_name(struct target *target, struct threads *t,
+	const uint8_t *comm)
+{
+	for (int i = 0; i < 16; i += 4) {
+		uint32_t raw_name = target_buffer_get_u32(target, comm + i);
+		t->name[i + 3] = raw_name >> 24;
+		t->name[i + 2] = raw_name >> 16;
+		t->name[i + 1] = raw_name >> 8;
+		t->name[i] = raw_name;
+	}
+	t->name[16] = 0;
+}
 
-	retval = fill_buffer(target, on_cpu, buffer);
+/*  read the fields and the name of a task from one read of its task_struct */
+static int fill_task(struct target *target, struct threads *t)
+{
+	uint32_t size = task_slice_size();
+	uint8_t *task = malloc(size);
+	if (!task)
+		return ERROR_FAIL;
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->oncpu = val;
-	} else
+	t->next_base_addr = 0;
+	int retval = linux_read_memory(target, t->base_addr, 4, size / 4, task);
+	if (retval != ERROR_OK) {
 		LOG_ERROR("fill task: unable to read memory");
+		free(task);
+		return retval;
+	}
 
-	retval = fill_buffer(target, mem_addr, buffer);
+	t->state = get_buffer(target, task);
+	t->pid = get_buffer(target, task + PID);
+	t->oncpu = get_buffer(target, task + ONCPU);
+	t->next_base_addr = get_buffer(target, task + NEXT) - NEXT;
+	decode_name(target, t, task + COMM);
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
+	uint32_t val = get_buffer(target, task + MEM);
+	free(task);
 
-		if (val != 0) {
-			uint32_t asid_addr = val + MM_CTX;
-			retval = fill_buffer(target, asid_addr, buffer);
+	if (val != 0) {
+		uint8_t buffer[4];
+		uint32_t asid_addr = val + MM_CTX;
+		retval = fill_buffer(target, asid_addr, buffer);
 
-			if (retval == ERROR_OK) {
-				val = get_buffer(target, buffer);
-				t->asid = val;
-			} else
-				LOG_ERROR
-					("fill task: unable to read memory -- ASID");
-		} else
-			t->asid = 0;
-	} else
-		LOG_ERROR("fill task: unable to read memory");
-
-	free(buffer);
+		if (retval == ERROR_OK)
+			t->asid = get_buffer(target, buffer);
+		else
+			LOG_ERROR("fill task: unable to read memory -- ASID");
+	} else {
+		t->asid = 0;
+	}
 
 	return retval;
 }
@@ -339,45 +358,19 @@ static int fill_task(struct target *target, struct threads *t)
 static int get_name(struct target *target, struct threads *t)
 {
 	int retval;
-	uint32_t full_name[4];
+	uint8_t full_name[16];
 	uint32_t comm = t->base_addr + COMM;
-	int i;
 
-	for (i = 0; i < 17; i++)
-		t->name[i] = 0;
+	memset(t->name, 0, sizeof(t->name));
 
-	retval = linux_read_memory(target, comm, 4, 4, (uint8_t *) full_name);
+	retval = linux_read_memory(target, comm, 4, 4, full_name);
 
 	if (retval != ERROR_OK) {
 		LOG_ERROR("get_name: unable to read memory\n");
 		return ERROR_FAIL;
 	}
 
-	uint32_t raw_name = target_buffer_get_u32(target,
-			(const uint8_t *)
-			&full_name[0]);
-	t->name[3] = raw_name >> 24;
-	t->name[2] = raw_name >> 16;
-	t->name[1] = raw_name >> 8;
-	t->name[0] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[1]);
-	t->name[7] = raw_name >> 24;
-	t->name[6] = raw_name >> 16;
-	t->name[5] = raw_name >> 8;
-	t->name[4] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[2]);
-	t->name[11] = raw_name >> 24;
-	t->name[10] = raw_name >> 16;
-	t->name[9] = raw_name >> 8;
-	t->name[8] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[3]);
-	t->name[15] = raw_name >> 24;
-	t->name[14] = raw_name >> 16;
-	t->name[13] = raw_name >> 8;
-	t->name[12] = raw_name;
+	decode_name(target, t, full_name);
 	return ERROR_OK;
 
 }
@@ -445,7 +438,6 @@ static int get_current(struct target *target, int create)
 					t = calloc(1, sizeof(struct threads));
 					t->base_addr = ct->TS;
 					fill_task(target, t);
-					get_name(target, t);
 					t->oncpu = cpu;
 					insert_into_threadlist(target, t);
 					t->status = 3;
@@ -693,8 +685,7 @@ static int linux_get_tasks(struct target *target, int context)
 	while (((t->base_addr != linux_os->init_task_addr) &&
 		(t->base_addr != 0)) || (loop == 0)) {
 		loop++;
-		fill_task(target, t);
-		retval = get_name(target, t);
+		retval = fill_task(target, t);
 
 		if (loop > MAX_THREADS) {
 			free(t);
@@ -730,10 +721,10 @@ static int linux_get_tasks(struct target *target, int context)
 				t->context =
 					cpu_context_read(target, t->base_addr,
 						&t->thread_info_addr);
-			base_addr = next_task(target, t);
+			base_addr = t->next_base_addr;
 		} else {
 			/*LOG_INFO("thread %s is a current thread already created",t->name); */
-			base_addr = next_task(target, t);
+			base_addr = t->next_base_addr;
 			free(t);
 		}
 
@@ -859,7 +850,6 @@ error_handling:
 				if (fill_task(target, t) != ERROR_OK)
 					goto error_handling;
 
-				get_name(target, t);
 				insert_into_threadlist(target, t);
 				t->thread_info_addr = 0xdeadbeef;
 			}
@@ -994,7 +984,6 @@ static int linux_task_update(struct target *target, int context)
 		if (found == 0) {
 			uint32_t base_addr;
 			fill_task(target, t);
-			get_name(target, t);
 			retval = insert_into_threadlist(target, t);
 			t->thread_info_addr = 0xdeadbeef;
 
@@ -1003,7 +992,7 @@ static int linux_task_update(struct target *target, int context)
 					cpu_context_read(target, t->base_addr,
 						&t->thread_info_addr);
 
-			base_addr = next_task(target, t);
+			base_addr = t->next_base_addr;
 			t = calloc(1, sizeof(struct threads));
 			t->base_addr = base_addr;
 			linux_os->thread_count++;
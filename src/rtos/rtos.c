@@ -11,8 +11,10 @@
 
 #include "rtos.h"
 #include "target/target.h"
+#include "target/target_memcache.h"
 #include "helper/log.h"
 #include "helper/binarybuffer.h"
+#include "helper/time_support.h"
 #include "server/gdb_server.h"
 
 /* RTOSs */
@@ -51,6 +53,7 @@ static const struct rtos_type *rtos_types[] = {
 };
 
 static int rtos_try_next(struct target *target);
+static int rtos_sample_callback(void *priv);
 
 int rtos_thread_packet(struct connection *connection, const char *packet, int packet_size);
 
@@ -90,11 +93,81 @@ static int os_alloc(struct target *target, const struct rtos_type *ostype)
 	return JIM_OK;
 }
 
+struct rtos_thread_regs {
+	int64_t thread_id;
+	struct rtos_reg *reg_list;
+	int num_regs;
+};
+
+static void rtos_free_thread_details(struct thread_detail *details, int count)
+{
+	for (int j = 0; j < count; j++) {
+		free(details[j].thread_name_str);
+		free(details[j].extra_info_str);
+	}
+	free(details);
+}
+
+static void rtos_free_thread_regs(struct rtos *rtos)
+{
+	for (unsigned int i = 0; i < rtos->thread_regs_count; i++)
+		free(rtos->thread_regs[i].reg_list);
+	free(rtos->thread_regs);
+	rtos->thread_regs = NULL;
+	rtos->thread_regs_count = 0;
+}
+
+/* Unstack the registers of a thread only once while the target memory does
+ * not change, e.g. for the many 'p' packets of a backtrace. The returned
+ * list belongs to the cache. */
+static int rtos_get_thread_regs(struct rtos *rtos, int64_t thread_id,
+		struct rtos_reg **reg_list, int *num_regs)
+{
+	if (rtos->thread_regs_generation != target_memcache_generation()) {
+		rtos_free_thread_regs(rtos);
+		rtos->thread_regs_generation = target_memcache_generation();
+	}
+
+	for (unsigned int i = 0; i < rtos->thread_regs_count; i++) {
+		if (rtos->thread_regs[i].thread_id == thread_id) {
+			*reg_list = rtos->thread_regs[i].reg_list;
+			*num_regs = rtos->thread_regs[i].num_regs;
+			return ERROR_OK;
+		}
+	}
+
+	int retval = rtos->type->get_thread_reg_list(rtos, thread_id, reg_list, num_regs);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct rtos_thread_regs *thread_regs = realloc(rtos->thread_regs,
+			(rtos->thread_regs_count + 1) * sizeof(*thread_regs));
+	if (!thread_regs) {
+		LOG_ERROR("Out of memory");
+		free(*reg_list);
+		return ERROR_FAIL;
+	}
+	thread_regs[rtos->thread_regs_count].thread_id = thread_id;
+	thread_regs[rtos->thread_regs_count].reg_list = *reg_list;
+	thread_regs[rtos->thread_regs_count].num_regs = *num_regs;
+	rtos->thread_regs = thread_regs;
+	rtos->thread_regs_count++;
+
+	return ERROR_OK;
+}
+
 static void os_free(struct target *target)
 {
 	if (!target->rtos)
 		return;
 
+	if (target->rtos->sample_period_ms)
+		target_unregister_timer_callback(rtos_sample_callback, target);
+	rtos_free_thread_details(target->rtos->sample_details,
+			target->rtos->sample_count);
+	rtos_free_thread_regs(target->rtos);
+	rtos_free_thread_details(target->rtos->prev_thread_details,
+			target->rtos->prev_thread_count);
 	free(target->rtos->symbols);
 	free(target->rtos);
 	target->rtos = NULL;
@@ -200,6 +273,13 @@ static struct symbol_table_elem *next_symbol(struct rtos *os, char *cur_symbol,
 	return s;
 }
 
+/* keep the symbols of a detected RTOS, if the first one can confirm them */
+static void rtos_cache_symbols(struct rtos *os)
+{
+	os->symbols_cached = os->symbols && os->symbols[0].symbol_name &&
+		os->symbols[0].address;
+}
+
 /* rtos_qsymbol() processes and replies to all qSymbol packets from GDB.
  *
  * GDB sends a qSymbol:: packet (empty address, empty name) to notify
@@ -223,6 +303,11 @@ static struct symbol_table_elem *next_symbol(struct rtos *os, char *cur_symbol,
  * symbol here from the -flto case.  (Each subsequent static symbol with
  * the same name is exported as .lto_priv.1, .lto_priv.2, etc.)
  *
+ * Once an RTOS has been detected, its symbols are kept for the next
+ * lookups, e.g. from a new GDB connection: only the first symbol is asked
+ * again, and when GDB returns the same address the RTOS is detected at
+ * once. Any other answer starts a full lookup.
+ *
  * rtos_qsymbol() returns 1 if an RTOS has been detected, or 0 otherwise.
  */
 int rtos_qsymbol(struct connection *connection, char const *packet, int packet_size)
@@ -263,7 +348,34 @@ int rtos_qsymbol(struct connection *connection, char const *packet, int packet_s
 		next_suffix = lto_suffix;
 	}
 
-	if ((strcmp(packet, "qSymbol::") != 0) &&               /* GDB is not offering symbol lookup for the first time */
+	bool restart = false;
+	if (os->symbols_confirming) {
+		/* Answer about the first of the symbols kept from the last detection */
+		os->symbols_confirming = false;
+		if (cur_suffix == no_suffix && !strcmp(cur_sym, os->symbols[0].symbol_name) &&
+				sscanf(packet, "qSymbol:%" SCNx64 ":", &addr) == 1 &&
+				(symbol_address_t)addr == os->symbols[0].address) {
+			LOG_DEBUG("RTOS: Symbols of %s confirmed by '%s'", os->type->name, cur_sym);
+			rtos_detected = 1;
+			goto done;
+		}
+
+		/* Another image, look all the symbols up again */
+		os->symbols_cached = false;
+		for (struct symbol_table_elem *s = os->symbols; s->symbol_name; s++)
+			s->address = 0;
+		cur_sym[0] = '\0';
+		cur_suffix = no_suffix;
+		addr = 0;
+		restart = true;
+	} else if (!strcmp(packet, "qSymbol::") && os->symbols_cached) {
+		os->symbols_confirming = true;
+		next_sym = &os->symbols[0];
+		next_suffix = no_suffix;
+	}
+
+	if (!restart && !os->symbols_confirming &&
+	    (strcmp(packet, "qSymbol::") != 0) &&               /* GDB is not offering symbol lookup for the first time */
 	    (!sscanf(packet, "qSymbol:%" SCNx64 ":", &addr))) { /* GDB did not find an address for a symbol */
 
 		/* GDB could not find an address for the previous symbol */
@@ -306,12 +418,14 @@ int rtos_qsymbol(struct connection *connection, char const *packet, int packet_s
 
 		if (!target->rtos_auto_detect) {
 			rtos_detected = 1;
+			rtos_cache_symbols(os);
 			goto done;
 		}
 
 		if (os->type->detect_rtos(target)) {
 			LOG_INFO("Auto-detected RTOS: %s", os->type->name);
 			rtos_detected = 1;
+			rtos_cache_symbols(os);
 			goto done;
 		} else {
 			LOG_WARNING("No RTOS could be auto-detected!");
@@ -372,6 +486,7 @@ int rtos_thread_packet(struct connection *connection, char const *packet, int pa
 
 			struct thread_detail *detail = &target->rtos->thread_details[found];
 
+			rtos_get_thread_name(target->rtos, detail);
 			int str_size = 0;
 			if (detail->thread_name_str)
 				str_size += strlen(detail->thread_name_str);
@@ -545,25 +660,29 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 				return retval;
 			}
 		} else {
-			retval = target->rtos->type->get_thread_reg_list(target->rtos,
-					current_threadid,
-					&reg_list,
-					&num_regs);
+			retval = rtos_get_thread_regs(target->rtos, current_threadid,
+					&reg_list, &num_regs);
 			if (retval != ERROR_OK) {
 				LOG_ERROR("RTOS: failed to get register list");
 				return retval;
 			}
 		}
 
+		retval = ERROR_FAIL;
 		for (int i = 0; i < num_regs; ++i) {
 			if (reg_list[i].number == (uint32_t)reg_num) {
 				rtos_put_gdb_reg_list(connection, reg_list + i, 1);
-				free(reg_list);
-				return ERROR_OK;
+				retval = ERROR_OK;
+				break;
 			}
 		}
 
-		free(reg_list);
+		/* otherwise the cache owns the register list */
+		if (target->rtos->type->get_thread_reg)
+			free(reg_list);
+
+		if (retval == ERROR_OK)
+			return ERROR_OK;
 	}
 	return ERROR_FAIL;
 }
@@ -585,17 +704,24 @@ int rtos_get_gdb_reg_list(struct connection *connection)
 										current_threadid,
 										target->rtos->current_thread);
 
-		int retval = target->rtos->type->get_thread_reg_list(target->rtos,
-				current_threadid,
-				&reg_list,
-				&num_regs);
+		/* RTOS drivers that provide single registers, like hwthread, read
+		 * them from the cores; the others unstack them from memory */
+		bool cached = !target->rtos->type->get_thread_reg;
+		int retval;
+		if (cached)
+			retval = rtos_get_thread_regs(target->rtos, current_threadid,
+					&reg_list, &num_regs);
+		else
+			retval = target->rtos->type->get_thread_reg_list(target->rtos,
+					current_threadid, &reg_list, &num_regs);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("RTOS: failed to get register list");
 			return retval;
 		}
 
 		rtos_put_gdb_reg_list(connection, reg_list, num_regs);
-		free(reg_list);
+		if (!cached)
+			free(reg_list);
 
 		return ERROR_OK;
 	}
@@ -611,6 +737,7 @@ int rtos_set_reg(struct connection *connection, int reg_num,
 			(target->rtos->type->set_reg) &&
 			(current_threadid != -1) &&
 			(current_threadid != 0)) {
+		rtos_free_thread_regs(target->rtos);
 		return target->rtos->type->set_reg(target->rtos, reg_num, reg_value);
 	}
 	return ERROR_FAIL;
@@ -652,6 +779,24 @@ int rtos_generic_stack_read(struct target *target,
 		LOG_OUTPUT("\r\n");
 #endif
 
+	retval = rtos_generic_stack_decode(target, stacking, stack_ptr, stack_data,
+			reg_list, num_regs);
+	free(stack_data);
+	return retval;
+}
+
+/** Decode the registers of a thread from its stack frame at @a stack_ptr,
+ * already read into @a stack_data, as rtos_generic_stack_read() does.
+ * Each register is a single memcpy() into its own rtos_reg, so there is
+ * nothing to gain from merging the copies; the decoded lists are kept per
+ * thread by rtos_get_thread_regs() until the target memory changes. */
+int rtos_generic_stack_decode(struct target *target,
+	const struct rtos_register_stacking *stacking,
+	int64_t stack_ptr,
+	const uint8_t *stack_data,
+	struct rtos_reg **reg_list,
+	int *num_regs)
+{
 	target_addr_t new_stack_ptr;
 	if (stacking->calculate_process_stack) {
 		new_stack_ptr = stacking->calculate_process_stack(target,
@@ -675,7 +820,6 @@ int rtos_generic_stack_read(struct target *target,
 			buf_cpy(stack_data + offset, (*reg_list)[i].value, (*reg_list)[i].size);
 	}
 
-	free(stack_data);
 /*	LOG_OUTPUT("Output register string: %s\r\n", *hex_reg_list); */
 	return ERROR_OK;
 }
@@ -698,6 +842,7 @@ static int rtos_try_next(struct target *target)
 
 	free(os->symbols);
 	os->symbols = NULL;
+	os->symbols_cached = false;
 
 	return 1;
 }
@@ -712,19 +857,124 @@ int rtos_update_threads(struct target *target)
 void rtos_free_threadlist(struct rtos *rtos)
 {
 	if (rtos->thread_details) {
-		int j;
+		rtos_free_thread_details(rtos->thread_details, rtos->thread_count);
+		rtos->thread_details = NULL;
+		rtos->thread_count = 0;
+		rtos->current_threadid = -1;
+		rtos->current_thread = 0;
+	}
+}
 
-		for (j = 0; j < rtos->thread_count; j++) {
-			struct thread_detail *current_thread = &rtos->thread_details[j];
-			free(current_thread->thread_name_str);
-			free(current_thread->extra_info_str);
-		}
-		free(rtos->thread_details);
+/**
+ * Replace rtos_free_threadlist() at the start of an update to read only
+ * the threads created since the previous one. @a generation is a counter
+ * of the RTOS bumped by every thread creation, e.g. the FreeRTOS
+ * uxTaskNumber. While it does not change, a thread found again at the same
+ * id is the same thread, and rtos_reuse_thread_name() returns its name
+ * without reading the target.
+ */
+void rtos_keep_threadlist(struct rtos *rtos, bool generation_valid,
+		uint64_t generation)
+{
+	rtos_free_thread_details(rtos->prev_thread_details, rtos->prev_thread_count);
+	rtos->prev_thread_details = NULL;
+	rtos->prev_thread_count = 0;
+
+	if (generation_valid && rtos->thread_list_generation_valid &&
+			generation == rtos->thread_list_generation) {
+		rtos->prev_thread_details = rtos->thread_details;
+		rtos->prev_thread_count = rtos->thread_count;
 		rtos->thread_details = NULL;
 		rtos->thread_count = 0;
 		rtos->current_threadid = -1;
 		rtos->current_thread = 0;
+	} else {
+		rtos_free_threadlist(rtos);
+	}
+
+	rtos->thread_list_generation_valid = generation_valid;
+	rtos->thread_list_generation = generation;
+}
+
+/** The name of @a threadid read by the previous update, if still valid.
+ * The caller owns the returned string. */
+char *rtos_reuse_thread_name(struct rtos *rtos, threadid_t threadid)
+{
+	for (int i = 0; i < rtos->prev_thread_count; i++) {
+		struct thread_detail *detail = &rtos->prev_thread_details[i];
+
+		if (detail->threadid == threadid && detail->thread_name_str) {
+			char *name = detail->thread_name_str;
+			detail->thread_name_str = NULL;
+			return name;
+		}
 	}
+
+	return NULL;
+}
+
+/**
+ * Read the first @a size bytes of the thread control block at @a address
+ * into @a tcb, a buffer of RTOS_TCB_MAX_SIZE bytes, to decode all the
+ * fields an update needs with rtos_tcb_get_field() instead of reading each
+ * one from the target.
+ */
+int rtos_read_tcb(struct rtos *rtos, target_addr_t address, uint32_t size,
+		uint8_t *tcb)
+{
+	if (size > RTOS_TCB_MAX_SIZE) {
+		LOG_ERROR("%s: thread control block of %" PRIu32 " bytes is too large",
+				rtos->type->name, size);
+		return ERROR_FAIL;
+	}
+
+	return target_read_buffer(rtos->target, address, size, tcb);
+}
+
+/** Decode the field of @a width bytes at @a offset of a TCB image. */
+uint64_t rtos_tcb_get_field(struct rtos *rtos, const uint8_t *tcb,
+		uint32_t offset, unsigned int width)
+{
+	assert(offset + width <= RTOS_TCB_MAX_SIZE);
+
+	switch (width) {
+	case 1:
+		return tcb[offset];
+	case 2:
+		return target_buffer_get_u16(rtos->target, tcb + offset);
+	case 4:
+		return target_buffer_get_u32(rtos->target, tcb + offset);
+	case 8:
+		return target_buffer_get_u64(rtos->target, tcb + offset);
+	default:
+		assert(0);
+		return 0;
+	}
+}
+
+/**
+ * The name of a thread, read from the target the first time it is asked
+ * for since the update which found the thread. NULL if the thread has no
+ * name or it can't be read.
+ */
+const char *rtos_get_thread_name(struct rtos *rtos, struct thread_detail *detail)
+{
+	if (rtos->type->read_thread_name && detail->name_pending) {
+		detail->name_pending = false;
+		if (rtos->type->read_thread_name(rtos, detail) != ERROR_OK)
+			detail->thread_name_str = NULL;
+	}
+	return detail->thread_name_str;
+}
+
+/** The address of the current thread pointer of a detected RTOS. */
+int rtos_get_current_thread_address(struct target *target, target_addr_t *address)
+{
+	struct rtos *rtos = target->rtos;
+
+	if (!rtos || !rtos->symbols_cached || !rtos->type->get_current_thread_address)
+		return ERROR_NOT_IMPLEMENTED;
+	return rtos->type->get_current_thread_address(rtos, address);
 }
 
 int rtos_read_buffer(struct target *target, target_addr_t address,
@@ -742,3 +992,182 @@ int rtos_write_buffer(struct target *target, target_addr_t address,
 		return target->rtos->type->write_buffer(target->rtos, address, size, buffer);
 	return ERROR_NOT_IMPLEMENTED;
 }
+
+/* updates of the thread list taken to get two alike, see rtos_sample() */
+#define RTOS_SAMPLE_TRIES 4
+
+static struct thread_detail *rtos_copy_thread_details(struct rtos *rtos)
+{
+	struct thread_detail *details = calloc(rtos->thread_count, sizeof(*details));
+	if (!details)
+		return NULL;
+
+	for (int i = 0; i < rtos->thread_count; i++) {
+		struct thread_detail *detail = &rtos->thread_details[i];
+
+		rtos_get_thread_name(rtos, detail);
+		details[i].threadid = detail->threadid;
+		details[i].exists = detail->exists;
+		if (detail->thread_name_str)
+			details[i].thread_name_str = strdup(detail->thread_name_str);
+		if (detail->extra_info_str)
+			details[i].extra_info_str = strdup(detail->extra_info_str);
+	}
+	return details;
+}
+
+static bool rtos_same_threads(const struct thread_detail *a, int a_count,
+		const struct thread_detail *b, int b_count)
+{
+	if (a_count != b_count)
+		return false;
+
+	for (int i = 0; i < a_count; i++)
+		if (a[i].threadid != b[i].threadid)
+			return false;
+	return true;
+}
+
+/* Update the thread list of a running target. The RTOS can change the list
+ * while it is read, so the list is only kept when two updates in a row
+ * find the same threads. */
+static int rtos_sample(struct target *target)
+{
+	struct rtos *rtos = target->rtos;
+	struct thread_detail *prev = NULL;
+	int prev_count = 0;
+
+	rtos->samples++;
+	for (int i = 0; i < RTOS_SAMPLE_TRIES; i++) {
+		if (rtos->type->update_threads(rtos) != ERROR_OK)
+			continue;
+
+		struct thread_detail *details = rtos_copy_thread_details(rtos);
+		if (!details && rtos->thread_count)
+			break;
+
+		if (prev && rtos_same_threads(prev, prev_count, details, rtos->thread_count)) {
+			rtos_free_thread_details(prev, prev_count);
+			rtos_free_thread_details(rtos->sample_details, rtos->sample_count);
+			rtos->sample_details = details;
+			rtos->sample_count = rtos->thread_count;
+			rtos->sample_time_ms = timeval_ms();
+			return ERROR_OK;
+		}
+
+		rtos_free_thread_details(prev, prev_count);
+		prev = details;
+		prev_count = rtos->thread_count;
+	}
+
+	rtos_free_thread_details(prev, prev_count);
+	rtos->samples_torn++;
+	LOG_DEBUG("RTOS: no consistent thread list sampled");
+	return ERROR_FAIL;
+}
+
+static int rtos_sample_callback(void *priv)
+{
+	struct target *target = priv;
+
+	/* only once the RTOS has been found through its symbols; while
+	 * halted, GDB gets the thread list from rtos_update_threads() */
+	if (!target->rtos || !target->rtos->symbols_cached ||
+			target->state != TARGET_RUNNING)
+		return ERROR_OK;
+
+	rtos_sample(target);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtos_sample_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct rtos *rtos = target->rtos;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!rtos) {
+		command_print(CMD, "no RTOS configured for target %s", target_name(target));
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC == 1) {
+		unsigned int period_ms = 0;
+		if (strcmp(CMD_ARGV[0], "off"))
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], period_ms);
+
+		if (rtos->sample_period_ms)
+			target_unregister_timer_callback(rtos_sample_callback, target);
+		rtos->sample_period_ms = period_ms;
+		if (period_ms) {
+			int retval = target_register_timer_callback(rtos_sample_callback,
+					period_ms, TARGET_TIMER_TYPE_PERIODIC, target);
+			if (retval != ERROR_OK) {
+				rtos->sample_period_ms = 0;
+				return retval;
+			}
+		}
+	}
+
+	if (rtos->sample_period_ms)
+		command_print(CMD, "rtos sample every %u ms, %" PRIu64 " samples, %" PRIu64 " torn",
+				rtos->sample_period_ms, rtos->samples, rtos->samples_torn);
+	else
+		command_print(CMD, "rtos sample off");
+	if (rtos->sample_details)
+		command_print(CMD, "last snapshot of %d threads, %" PRId64 " ms old",
+				rtos->sample_count, timeval_ms() - rtos->sample_time_ms);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtos_snapshot_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct rtos *rtos = target->rtos;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!rtos || !rtos->sample_details)
+		return ERROR_OK;
+
+	for (int i = 0; i < rtos->sample_count; i++) {
+		const struct thread_detail *detail = &rtos->sample_details[i];
+
+		command_print(CMD, "0x%" PRIx64 " {%s} {%s}", detail->threadid,
+				detail->thread_name_str ? detail->thread_name_str : "",
+				detail->extra_info_str ? detail->extra_info_str : "");
+	}
+	return ERROR_OK;
+}
+
+static const struct command_registration rtos_subcommand_handlers[] = {
+	{
+		.name = "sample",
+		.handler = handle_rtos_sample_command,
+		.mode = COMMAND_EXEC,
+		.help = "sample the thread list periodically while the target runs",
+		.usage = "[period_ms|off]",
+	},
+	{
+		.name = "snapshot",
+		.handler = handle_rtos_snapshot_command,
+		.mode = COMMAND_EXEC,
+		.help = "return the last thread list sampled while the target ran",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration rtos_target_command_handlers[] = {
+	{
+		.name = "rtos",
+		.mode = COMMAND_ANY,
+		.help = "RTOS awareness commands",
+		.usage = "",
+		.chain = rtos_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
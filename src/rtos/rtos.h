@@ -31,12 +31,19 @@ struct thread_detail {
 	bool exists;
 	char *thread_name_str;
 	char *extra_info_str;
+	/* the name is to be read by read_thread_name() of the RTOS, see
+	 * rtos_get_thread_name() */
+	bool name_pending;
 };
 
 struct rtos {
 	const struct rtos_type *type;
 
 	struct symbol_table_elem *symbols;
+	/* symbols resolved by the last detection, reused when GDB confirms the
+	 * address of the first one, see rtos_qsymbol() */
+	bool symbols_cached;
+	bool symbols_confirming;
 	struct target *target;
 	/*  add a context variable instead of global variable */
 	/* The thread currently selected by gdb. */
@@ -48,6 +55,24 @@ struct rtos {
 	int (*gdb_thread_packet)(struct connection *connection, char const *packet, int packet_size);
 	int (*gdb_target_for_threadid)(struct connection *connection, int64_t thread_id, struct target **p_target);
 	void *rtos_specific_params;
+	/* register lists of the threads unstacked since the target memory last
+	 * changed, see target_memcache_generation() */
+	struct rtos_thread_regs *thread_regs;
+	unsigned int thread_regs_count;
+	unsigned int thread_regs_generation;
+	/* thread list of the previous update, kept while the RTOS reported
+	 * no thread creation, see rtos_keep_threadlist() */
+	struct thread_detail *prev_thread_details;
+	int prev_thread_count;
+	bool thread_list_generation_valid;
+	uint64_t thread_list_generation;
+	/* thread list sampled while the target runs, see "rtos sample" */
+	unsigned int sample_period_ms;
+	struct thread_detail *sample_details;
+	int sample_count;
+	int64_t sample_time_ms;
+	uint64_t samples;
+	uint64_t samples_torn;
 };
 
 struct rtos_reg {
@@ -78,6 +103,12 @@ struct rtos_type {
 			uint8_t *buffer);
 	int (*write_buffer)(struct rtos *rtos, target_addr_t address, uint32_t size,
 			const uint8_t *buffer);
+	/* Address of the pointer to the running thread, whose value is the
+	 * thread id, for a profiler sampling it along with the PC. */
+	int (*get_current_thread_address)(struct rtos *rtos, target_addr_t *address);
+	/* Read the name of a thread which update_threads() left name_pending
+	 * to save the target reads of names GDB never asks for. */
+	int (*read_thread_name)(struct rtos *rtos, struct thread_detail *detail);
 };
 
 struct stack_register_offset {
@@ -113,6 +144,9 @@ struct rtos_register_stacking {
 
 #define GDB_THREAD_PACKET_NOT_CONSUMED (-40)
 
+/* largest thread control block image read by rtos_read_tcb() */
+#define RTOS_TCB_MAX_SIZE 512
+
 int rtos_create(struct jim_getopt_info *goi, struct target *target);
 void rtos_destroy(struct target *target);
 int rtos_set_reg(struct connection *connection, int reg_num,
@@ -122,11 +156,27 @@ int rtos_generic_stack_read(struct target *target,
 		int64_t stack_ptr,
 		struct rtos_reg **reg_list,
 		int *num_regs);
+int rtos_generic_stack_decode(struct target *target,
+		const struct rtos_register_stacking *stacking,
+		int64_t stack_ptr,
+		const uint8_t *stack_data,
+		struct rtos_reg **reg_list,
+		int *num_regs);
 int gdb_thread_packet(struct connection *connection, char const *packet, int packet_size);
 int rtos_get_gdb_reg(struct connection *connection, int reg_num);
 int rtos_get_gdb_reg_list(struct connection *connection);
 int rtos_update_threads(struct target *target);
 void rtos_free_threadlist(struct rtos *rtos);
+void rtos_keep_threadlist(struct rtos *rtos, bool generation_valid,
+		uint64_t generation);
+char *rtos_reuse_thread_name(struct rtos *rtos, threadid_t threadid);
+extern const struct command_registration rtos_target_command_handlers[];
+int rtos_get_current_thread_address(struct target *target, target_addr_t *address);
+const char *rtos_get_thread_name(struct rtos *rtos, struct thread_detail *detail);
+int rtos_read_tcb(struct rtos *rtos, target_addr_t address, uint32_t size,
+		uint8_t *tcb);
+uint64_t rtos_tcb_get_field(struct rtos *rtos, const uint8_t *tcb,
+		uint32_t offset, unsigned int width);
 int rtos_smp_init(struct target *target);
 /*  function for handling symbol access */
 int rtos_qsymbol(struct connection *connection, char const *packet, int packet_size);
@@ -375,6 +375,12 @@ static int ucos_iii_update_threads(struct rtos *rtos)
 		return retval;
 	}
 
+	/* the fields of a thread are decoded from one read of its TCB */
+	uint32_t tcb_size = MAX(MAX(params->thread_name_offset, params->thread_prev_offset) +
+				params->pointer_width,
+			MAX(params->thread_state_offset, params->thread_priority_offset) + 1);
+	uint8_t tcb[RTOS_TCB_MAX_SIZE];
+
 	for (int i = 0; i < rtos->thread_count; i++) {
 		struct thread_detail *thread_detail = &rtos->thread_details[i];
 		char thread_str_buffer[UCOS_III_MAX_STRLEN + 1];
@@ -391,19 +397,16 @@ static int ucos_iii_update_threads(struct rtos *rtos)
 
 		thread_detail->exists = true;
 
-		/* read thread name */
-		symbol_address_t thread_name_address = 0;
-
-		retval = target_read_memory(rtos->target,
-				thread_address + params->thread_name_offset,
-				params->pointer_width,
-				1,
-				(void *)&thread_name_address);
+		retval = rtos_read_tcb(rtos, thread_address, tcb_size, tcb);
 		if (retval != ERROR_OK) {
-			LOG_ERROR("uCOS-III: failed to name address");
+			LOG_ERROR("uCOS-III: failed to read thread control block");
 			return retval;
 		}
 
+		/* read thread name */
+		symbol_address_t thread_name_address = rtos_tcb_get_field(rtos, tcb,
+				params->thread_name_offset, params->pointer_width);
+
 		retval = target_read_buffer(rtos->target,
 				thread_name_address,
 				sizeof(thread_str_buffer),
@@ -417,24 +420,8 @@ static int ucos_iii_update_threads(struct rtos *rtos)
 		thread_detail->thread_name_str = strdup(thread_str_buffer);
 
 		/* read thread extra info */
-		uint8_t thread_state;
-		uint8_t thread_priority;
-
-		retval = target_read_u8(rtos->target,
-				thread_address + params->thread_state_offset,
-				&thread_state);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("uCOS-III: failed to read thread state");
-			return retval;
-		}
-
-		retval = target_read_u8(rtos->target,
-				thread_address + params->thread_priority_offset,
-				&thread_priority);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("uCOS-III: failed to read thread priority");
-			return retval;
-		}
+		uint8_t thread_state = tcb[params->thread_state_offset];
+		uint8_t thread_priority = tcb[params->thread_priority_offset];
 
 		const char *thread_state_str;
 
@@ -447,16 +434,9 @@ static int ucos_iii_update_threads(struct rtos *rtos)
 				thread_state_str, thread_priority);
 		thread_detail->extra_info_str = strdup(thread_str_buffer);
 
-		/* read previous thread address */
-		retval = target_read_memory(rtos->target,
-				thread_address + params->thread_prev_offset,
-				params->pointer_width,
-				1,
-				(void *)&thread_address);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("uCOS-III: failed to read previous thread address");
-			return retval;
-		}
+		/* previous thread address */
+		thread_address = rtos_tcb_get_field(rtos, tcb,
+				params->thread_prev_offset, params->pointer_width);
 	}
 
 	return ERROR_OK;
@@ -40,9 +40,17 @@ static struct {
 	bool found_cb;
 
 	struct rtt_sink_list **sink_list;
+	/** Statistics of the up-channels, same length as the sink list. */
+	struct rtt_channel_stats *stats;
 	size_t sink_list_length;
 
+	/** Current polling interval in milliseconds. */
 	unsigned int polling_interval;
+	/** Whether the polling interval follows the fill level of the buffers. */
+	bool adaptive;
+	/** Bounds of the adaptive polling interval in milliseconds. */
+	unsigned int min_interval;
+	unsigned int max_interval;
 } rtt;
 
 int rtt_init(void)
@@ -51,8 +59,14 @@ int rtt_init(void)
 	rtt.sink_list = calloc(rtt.sink_list_length,
 		sizeof(struct rtt_sink_list *));
 
-	if (!rtt.sink_list)
+	rtt.stats = calloc(rtt.sink_list_length,
+		sizeof(struct rtt_channel_stats));
+
+	if (!rtt.sink_list || !rtt.stats) {
+		free(rtt.sink_list);
+		free(rtt.stats);
 		return ERROR_FAIL;
+	}
 
 	rtt.sink_list[0] = NULL;
 	rtt.started = false;
@@ -65,15 +79,55 @@ int rtt_init(void)
 int rtt_exit(void)
 {
 	free(rtt.sink_list);
+	free(rtt.stats);
 
 	return ERROR_OK;
 }
 
+static int read_channel_callback(void *user_data);
+
+static void change_polling_interval(unsigned int interval)
+{
+	if (rtt.polling_interval == interval)
+		return;
+
+	rtt.polling_interval = interval;
+
+	if (!rtt.started)
+		return;
+
+	target_unregister_timer_callback(&read_channel_callback, NULL);
+	target_register_timer_callback(&read_channel_callback, interval, 1, NULL);
+}
+
+/*
+ * Halve the interval while a buffer is at least half full, so that a burst
+ * is drained before it overflows, and back off slowly while all of them are
+ * empty.
+ */
+static void adapt_polling_interval(void)
+{
+	unsigned int fill = 0;
+	unsigned int interval = rtt.polling_interval;
+
+	for (size_t i = 0; i < rtt.sink_list_length; i++) {
+		if (rtt.sink_list[i])
+			fill = MAX(fill, rtt.stats[i].last_fill_percent);
+	}
+
+	if (fill >= 50)
+		interval = MAX(interval / 2, rtt.min_interval);
+	else if (!fill)
+		interval = MIN(interval + interval / 2 + 1, rtt.max_interval);
+
+	change_polling_interval(interval);
+}
+
 static int read_channel_callback(void *user_data)
 {
 	int ret;
 
-	ret = rtt.source.read(rtt.target, &rtt.ctrl, rtt.sink_list,
+	ret = rtt.source.read(rtt.target, &rtt.ctrl, rtt.sink_list, rtt.stats,
 		rtt.sink_list_length, NULL);
 
 	if (ret != ERROR_OK) {
@@ -82,6 +136,9 @@ static int read_channel_callback(void *user_data)
 		return ret;
 	}
 
+	if (rtt.adaptive)
+		adapt_polling_interval();
+
 	return ERROR_OK;
 }
 
@@ -155,6 +212,9 @@ int rtt_start(void)
 	if (ret != ERROR_OK)
 		return ret;
 
+	memset(rtt.stats, 0, sizeof(struct rtt_channel_stats) *
+		rtt.sink_list_length);
+
 	target_register_timer_callback(&read_channel_callback,
 		rtt.polling_interval, 1, NULL);
 	rtt.started = true;
@@ -185,10 +245,20 @@ int rtt_stop(void)
 static int adjust_sink_list(size_t length)
 {
 	struct rtt_sink_list **tmp;
+	struct rtt_channel_stats *stats;
 
 	if (length <= rtt.sink_list_length)
 		return ERROR_OK;
 
+	stats = realloc(rtt.stats, sizeof(struct rtt_channel_stats) * length);
+
+	if (!stats)
+		return ERROR_FAIL;
+
+	memset(stats + rtt.sink_list_length, 0,
+		sizeof(struct rtt_channel_stats) * (length - rtt.sink_list_length));
+	rtt.stats = stats;
+
 	tmp = realloc(rtt.sink_list, sizeof(struct rtt_sink_list *) * length);
 
 	if (!tmp)
@@ -274,21 +344,52 @@ int rtt_set_polling_interval(unsigned int interval)
 	if (!interval)
 		return ERROR_FAIL;
 
-	if (rtt.polling_interval != interval) {
-		target_unregister_timer_callback(&read_channel_callback, NULL);
-		target_register_timer_callback(&read_channel_callback, interval, 1,
-			NULL);
-	}
+	rtt.adaptive = false;
+	change_polling_interval(interval);
 
-	rtt.polling_interval = interval;
+	return ERROR_OK;
+}
+
+int rtt_set_adaptive_polling(unsigned int min_interval,
+		unsigned int max_interval)
+{
+	if (!min_interval || min_interval > max_interval)
+		return ERROR_FAIL;
+
+	rtt.adaptive = true;
+	rtt.min_interval = min_interval;
+	rtt.max_interval = max_interval;
+
+	change_polling_interval(MIN(MAX(rtt.polling_interval, min_interval),
+		max_interval));
 
 	return ERROR_OK;
 }
 
+bool rtt_get_adaptive_polling(unsigned int *min_interval,
+		unsigned int *max_interval)
+{
+	if (min_interval)
+		*min_interval = rtt.min_interval;
+
+	if (max_interval)
+		*max_interval = rtt.max_interval;
+
+	return rtt.adaptive;
+}
+
+const struct rtt_channel_stats *rtt_get_channel_stats(unsigned int channel_index)
+{
+	if (channel_index >= rtt.sink_list_length || !rtt.sink_list[channel_index])
+		return NULL;
+
+	return &rtt.stats[channel_index];
+}
+
 int rtt_write_channel(unsigned int channel_index, const uint8_t *buffer,
 		size_t *length)
 {
-	if (channel_index >= rtt.ctrl.num_up_channels) {
+	if (channel_index >= rtt.ctrl.num_down_channels) {
 		LOG_WARNING("rtt: Down-channel %u is not available", channel_index);
 		return ERROR_OK;
 	}
@@ -77,6 +77,20 @@ struct rtt_channel_info {
 	uint32_t flags;
 };
 
+/** Statistics of an up-channel, gathered while polling. */
+struct rtt_channel_stats {
+	/** Number of bytes read from the channel. */
+	uint64_t bytes;
+	/** Number of polls that found data in the buffer. */
+	uint64_t polls_with_data;
+	/** Number of polls that found the buffer full, data may have been lost. */
+	uint64_t polls_full;
+	/** Largest number of pending bytes seen in the buffer. */
+	uint32_t max_fill;
+	/** Fill level of the buffer at the last poll, in percent. */
+	unsigned int last_fill_percent;
+};
+
 typedef int (*rtt_sink_read)(unsigned int channel, const uint8_t *buffer,
 		size_t length, void *user_data);
 
@@ -110,7 +124,8 @@ typedef int (*rtt_source_start)(struct target *target,
 typedef int (*rtt_source_stop)(struct target *target, void *user_data);
 typedef int (*rtt_source_read)(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data);
+		struct rtt_channel_stats *stats, size_t num_channels,
+		void *user_data);
 typedef int (*rtt_source_write)(struct target *target,
 		struct rtt_control *ctrl, unsigned int channel,
 		const uint8_t *buffer, size_t *length, void *user_data);
@@ -194,6 +209,40 @@ int rtt_get_polling_interval(unsigned int *interval);
  */
 int rtt_set_polling_interval(unsigned int interval);
 
+/**
+ * Enable the adaptive polling.
+ *
+ * The polling interval is shortened while the up-channel buffers fill up and
+ * extended while they are empty, within the given bounds.
+ *
+ * @param[in] min_interval Shortest polling interval in milliseconds.
+ * @param[in] max_interval Longest polling interval in milliseconds.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_set_adaptive_polling(unsigned int min_interval,
+		unsigned int max_interval);
+
+/**
+ * Get the adaptive polling configuration.
+ *
+ * @param[out] min_interval Shortest polling interval in milliseconds.
+ * @param[out] max_interval Longest polling interval in milliseconds.
+ *
+ * @returns Whether the adaptive polling is enabled.
+ */
+bool rtt_get_adaptive_polling(unsigned int *min_interval,
+		unsigned int *max_interval);
+
+/**
+ * Get the statistics of an up-channel.
+ *
+ * @param[in] channel_index Channel index.
+ *
+ * @returns The statistics, or NULL if the channel was never polled.
+ */
+const struct rtt_channel_stats *rtt_get_channel_stats(unsigned int channel_index);
+
 /**
  * Get whether RTT is started.
  *
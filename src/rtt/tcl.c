@@ -78,7 +78,31 @@ COMMAND_HANDLER(handle_rtt_polling_interval_command)
 			return ret;
 		}
 
-		command_print(CMD, "%u ms", interval);
+		unsigned int min_interval, max_interval;
+
+		if (rtt_get_adaptive_polling(&min_interval, &max_interval))
+			command_print(CMD, "%u ms (adaptive %u..%u ms)", interval,
+				min_interval, max_interval);
+		else
+			command_print(CMD, "%u ms", interval);
+	} else if (CMD_ARGC == 3 && !strcmp(CMD_ARGV[0], "adaptive")) {
+		int ret;
+		unsigned int min_interval, max_interval;
+
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], min_interval);
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[2], max_interval);
+
+		if (!min_interval || min_interval > max_interval) {
+			command_print(CMD, "Invalid polling interval bounds");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+
+		ret = rtt_set_adaptive_polling(min_interval, max_interval);
+
+		if (ret != ERROR_OK) {
+			command_print(CMD, "Failed to set polling interval");
+			return ret;
+		}
 	} else if (CMD_ARGC == 1) {
 		int ret;
 		unsigned int interval;
@@ -130,6 +154,16 @@ COMMAND_HANDLER(handle_rtt_channels_command)
 
 		command_print(CMD, "%u: %s %u %u", i, info.name, info.size,
 			info.flags);
+
+		const struct rtt_channel_stats *stats = rtt_get_channel_stats(i);
+
+		if (!stats)
+			continue;
+
+		command_print(CMD, "   read %" PRIu64 " bytes, %" PRIu64
+			" polls with data, %" PRIu64 " full, fill max %" PRIu32
+			" last %u%%", stats->bytes, stats->polls_with_data,
+			stats->polls_full, stats->max_fill, stats->last_fill_percent);
 	}
 
 	command_print(CMD, "Down-channels:");
@@ -238,8 +272,8 @@ static const struct command_registration rtt_subcommand_handlers[] = {
 		.name = "polling_interval",
 		.handler = handle_rtt_polling_interval_command,
 		.mode = COMMAND_EXEC,
-		.help = "show or set polling interval in ms",
-		.usage = "[interval]"
+		.help = "show or set polling interval in ms, fixed or adaptive",
+		.usage = "[interval | 'adaptive' min max]"
 	},
 	{
 		.name = "channels",
@@ -23,6 +23,8 @@
  *   elec4fun@gmail.com                                                    *
  ***************************************************************************/
 
+#define LOG_CATEGORY LOG_CAT_GDB
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -37,9 +39,11 @@
 #include <flash/nor/core.h>
 #include "gdb_server.h"
 #include <target/image.h>
+#include <jtag/adapter.h>
 #include <jtag/jtag.h>
 #include "rtos/rtos.h"
 #include "target/smp.h"
+#include "target/target_memcache.h"
 
 /**
  * @file
@@ -95,6 +99,26 @@ struct gdb_connection {
 	char *thread_list;
 	/* flag to mask the output from gdb_log_callback() */
 	enum gdb_output_flag output_flag;
+	/* outgoing packets are framed here, the buffer only ever grows */
+	char *tx_buffer;
+	size_t tx_buffer_size;
+	/* non-stop mode, the cores of a SMP group halt and resume individually */
+	bool non_stop;
+	/* non-stop mode: halted cores whose stop GDB has not fetched yet. The
+	 * first one has been sent as %Stop notification, GDB gets the others
+	 * with vStopped packets. */
+	struct target **stop_queue;
+	unsigned int stop_queue_len;
+	/* streamed vFlashWrite: contiguous data of one bank not programmed yet */
+	struct flash_bank *vflash_bank;
+	target_addr_t vflash_address;
+	uint8_t *vflash_data;
+	uint32_t vflash_len;
+	uint32_t vflash_size;
+	bool vflash_started;
+	/* streamed vFlashWrite: the data is programmed after GDB got the "OK",
+	 * a failure is reported with the next vFlashWrite or vFlashDone */
+	int vflash_error;
 };
 
 #if 0
@@ -110,21 +134,34 @@ static int gdb_error(struct connection *connection, int retval);
 static char *gdb_port;
 static char *gdb_port_next;
 
-static void gdb_log_callback(void *priv, const char *file, unsigned line,
-		const char *function, const char *string);
+static void gdb_log_callback(void *priv, enum log_levels level, const char *file,
+		unsigned int line, const char *function, const char *string);
 
 static void gdb_sig_halted(struct connection *connection);
+static void gdb_str_to_target(struct target *target,
+		char *tstr, struct reg *reg);
 
 /* number of gdb connections, mainly to suppress gdb related debugging spam
  * in helper/log.c when no gdb connections are actually active */
 int gdb_actual_connections;
 
+static struct metric gdb_packets_metric = METRIC_COUNTER("gdb_packets_total",
+		"Packets received from GDB");
+static struct metric gdb_rx_bytes_metric = METRIC_COUNTER("gdb_rx_bytes_total",
+		"Bytes received from GDB");
+
 /* set if we are sending a memory map to gdb
  * via qXfer:memory-map:read packet */
 /* enabled by default*/
 static int gdb_use_memory_map = 1;
 /* enabled by default*/
 static int gdb_flash_program = 1;
+/* program complete sectors while GDB still sends vFlashWrite packets,
+ * disabled by default */
+static int gdb_flash_stream;
+
+/* streamed vFlashWrite data is programmed in runs of at least this size */
+#define GDB_VFLASH_STREAM_CHUNK		(64 * 1024)
 
 /* if set, data aborts cause an error to be reported in memory read packets
  * see the code in gdb_read_memory_packet() for further explanations.
@@ -214,6 +251,12 @@ static int gdb_get_char_inner(struct connection *connection, int *next_char)
 		if (connection->service->type != CONNECTION_TCP)
 			gdb_con->buf_cnt = read(connection->fd, gdb_con->buffer, GDB_BUFFER_SIZE);
 		else {
+			/* GDB only answers once it got our packet */
+			retval = connection_flush(connection);
+			if (retval != ERROR_OK) {
+				gdb_con->closed = true;
+				return ERROR_SERVER_REMOTE_CLOSED;
+			}
 			retval = check_pending(connection, 1, NULL);
 			if (retval != ERROR_OK)
 				return retval;
@@ -222,8 +265,10 @@ static int gdb_get_char_inner(struct connection *connection, int *next_char)
 					GDB_BUFFER_SIZE);
 		}
 
-		if (gdb_con->buf_cnt > 0)
+		if (gdb_con->buf_cnt > 0) {
+			metric_add(&gdb_rx_bytes_metric, gdb_con->buf_cnt);
 			break;
+		}
 		if (gdb_con->buf_cnt == 0) {
 			LOG_DEBUG("GDB connection closed by the remote client");
 			gdb_con->closed = true;
@@ -407,17 +452,53 @@ static void gdb_log_outgoing_packet(struct connection *connection, char *packet_
 			checksum);
 }
 
+/* Frame the packet in the connection's TX buffer: @a start ("$" or "%" for
+ * notifications), payload, "#" and the checksum, computed while copying. */
+static int gdb_frame_packet(struct gdb_connection *gdb_con, char start,
+		const char *buffer, int len, unsigned char *checksum)
+{
+	static const char hex_digits[] = "0123456789abcdef";
+	size_t framed_len = (size_t)len + 4;
+
+	if (framed_len > gdb_con->tx_buffer_size) {
+		size_t size = MAX(framed_len, 2 * gdb_con->tx_buffer_size);
+		size = MAX(size, 1024);
+		char *tx_buffer = realloc(gdb_con->tx_buffer, size);
+		if (!tx_buffer) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		gdb_con->tx_buffer = tx_buffer;
+		gdb_con->tx_buffer_size = size;
+	}
+
+	char *tx = gdb_con->tx_buffer;
+	unsigned char my_checksum = 0;
+
+	*tx++ = start;
+	for (int i = 0; i < len; i++) {
+		my_checksum += buffer[i];
+		*tx++ = buffer[i];
+	}
+	*tx++ = '#';
+	*tx++ = hex_digits[my_checksum >> 4];
+	*tx = hex_digits[my_checksum & 0xf];
+
+	*checksum = my_checksum;
+	return ERROR_OK;
+}
+
 static int gdb_put_packet_inner(struct connection *connection,
 		char *buffer, int len)
 {
-	int i;
 	unsigned char my_checksum = 0;
 	int reply;
 	int retval;
 	struct gdb_connection *gdb_con = connection->priv;
 
-	for (i = 0; i < len; i++)
-		my_checksum += buffer[i];
+	retval = gdb_frame_packet(gdb_con, '$', buffer, len, &my_checksum);
+	if (retval != ERROR_OK)
+		return retval;
 
 #ifdef _DEBUG_GDB_IO_
 	/*
@@ -449,29 +530,10 @@ static int gdb_put_packet_inner(struct connection *connection,
 	while (1) {
 		gdb_log_outgoing_packet(connection, buffer, len, my_checksum);
 
-		char local_buffer[1024];
-		local_buffer[0] = '$';
-		if ((size_t)len + 4 <= sizeof(local_buffer)) {
-			/* performance gain on smaller packets by only a single call to gdb_write() */
-			memcpy(local_buffer + 1, buffer, len++);
-			len += snprintf(local_buffer + len, sizeof(local_buffer) - len, "#%02x", my_checksum);
-			retval = gdb_write(connection, local_buffer, len);
-			if (retval != ERROR_OK)
-				return retval;
-		} else {
-			/* larger packets are transmitted directly from caller supplied buffer
-			 * by several calls to gdb_write() to avoid dynamic allocation */
-			snprintf(local_buffer + 1, sizeof(local_buffer) - 1, "#%02x", my_checksum);
-			retval = gdb_write(connection, local_buffer, 1);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = gdb_write(connection, buffer, len);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = gdb_write(connection, local_buffer + 1, 3);
-			if (retval != ERROR_OK)
-				return retval;
-		}
+		/* a single write of the framed packet, also when resending it */
+		retval = gdb_write(connection, gdb_con->tx_buffer, len + 4);
+		if (retval != ERROR_OK)
+			return retval;
 
 		if (gdb_con->noack_mode)
 			break;
@@ -541,6 +603,24 @@ int gdb_put_packet(struct connection *connection, char *buffer, int len)
 	return retval;
 }
 
+/* Asynchronous notifications are framed with "%" and never acknowledged */
+static int gdb_put_notification(struct connection *connection, char *buffer, int len)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	unsigned char checksum;
+
+	int retval = gdb_frame_packet(gdb_con, '%', buffer, len, &checksum);
+	if (retval != ERROR_OK)
+		return retval;
+
+	gdb_log_outgoing_packet(connection, buffer, len, checksum);
+	retval = gdb_write(connection, gdb_con->tx_buffer, len + 4);
+
+	kept_alive();
+
+	return retval;
+}
+
 static inline int fetch_packet(struct connection *connection,
 		int *checksum_ok, int noack, int *len, char *buffer)
 {
@@ -565,38 +645,50 @@ static inline int fetch_packet(struct connection *connection,
 		 * gdb_get_char() update various bits and bobs correctly.
 		 */
 		if ((buf_cnt > 2) && ((buf_cnt + count) < *len)) {
-			/* The compiler will struggle a bit with constant propagation and
-			 * aliasing, so we help it by showing that these values do not
-			 * change inside the loop
+			/* Look for the '#' once and copy the spans between the escape
+			 * characters as a whole. The compiler will struggle a bit with
+			 * constant propagation and aliasing, so we help it by showing
+			 * that these values do not change inside the loop
 			 */
-			int i;
-			char *buf = buf_p;
+			const char *buf = buf_p;
 			int run = buf_cnt - 2;
-			i = 0;
-			int done = 0;
-			while (i < run) {
-				character = *buf++;
-				i++;
-				if (character == '#') {
-					/* Danger! character can be '#' when esc is
-					 * used so we need an explicit boolean for done here. */
-					done = 1;
-					break;
+			const char *hash = memchr(buf, '#', run);
+			int end = hash ? hash - buf : run;
+			int i = 0;
+			bool done = false;
+			while (i < end) {
+				const char *esc = memchr(buf + i, '}', end - i);
+				int n = (esc ? esc - buf : end) - i;
+
+				memcpy(buffer + count, buf + i, n);
+				if (!noack) {
+					for (int j = 0; j < n; j++)
+						my_checksum += buf[i + j];
 				}
+				count += n;
+				i += n;
 
-				if (character == '}') {
-					/* data transmitted in binary mode (X packet)
-					 * uses 0x7d as escape character */
-					my_checksum += character & 0xff;
-					character = *buf++;
-					i++;
-					my_checksum += character & 0xff;
-					buffer[count++] = (character ^ 0x20) & 0xff;
-				} else {
-					my_checksum += character & 0xff;
-					buffer[count++] = character & 0xff;
+				if (!esc)
+					break;
+
+				/* data transmitted in binary mode (X packet)
+				 * uses 0x7d as escape character */
+				character = buf[i + 1];
+				my_checksum += '}' + character;
+				buffer[count++] = character ^ 0x20;
+				i += 2;
+
+				/* Danger! the escaped character can be the '#' */
+				if (i > end) {
+					hash = i < run ? memchr(buf + i, '#', run - i) : NULL;
+					end = hash ? hash - buf : run;
 				}
 			}
+			if (hash && i == end) {
+				/* skip the '#' */
+				i++;
+				done = true;
+			}
 			buf_p += i;
 			buf_cnt -= i;
 			if (done)
@@ -775,66 +867,152 @@ static int gdb_output(struct command_context *context, const char *line)
 	return ERROR_OK;
 }
 
-static void gdb_signal_reply(struct target *target, struct connection *connection)
+/* The "watch:", "rwatch:" or "awatch:" part of the stop reply, if any */
+static void gdb_watch_stop_reason(struct target *ct, char *stop_reason, size_t size)
 {
-	struct gdb_connection *gdb_connection = connection->priv;
-	char sig_reply[65];
+	stop_reason[0] = '\0';
+	if (ct->debug_reason != DBG_REASON_WATCHPOINT)
+		return;
+
+	enum watchpoint_rw hit_wp_type;
+	target_addr_t hit_wp_address;
+
+	if (watchpoint_hit(ct, &hit_wp_type, &hit_wp_address) != ERROR_OK)
+		return;
+
+	switch (hit_wp_type) {
+		case WPT_WRITE:
+			snprintf(stop_reason, size, "watch:%08" TARGET_PRIxADDR ";", hit_wp_address);
+			break;
+		case WPT_READ:
+			snprintf(stop_reason, size, "rwatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
+			break;
+		case WPT_ACCESS:
+			snprintf(stop_reason, size, "awatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * Stop state of the last halt, shared by all the connections to the target.
+ * Every GDB connection handles the halt event on its own; the first one
+ * takes the stop reason, the threads and the expedited registers from the
+ * target, the others only format their reply from it. Any event, resume,
+ * step or memory write afterwards bumps the memory cache generation, which
+ * makes the state stale.
+ */
+struct gdb_halt_state {
+	struct target *target;
+	unsigned int generation;
+	bool exited;
+	int signal;
 	char stop_reason[32];
-	char current_thread[25];
-	int sig_reply_len;
-	int signal_var;
+	bool has_thread;
+	threadid_t thread;
+	/* "n:value;" of the program counter */
+	char expedited[32];
+};
+
+static struct gdb_halt_state gdb_halt_state;
+
+static void gdb_halt_state_invalidate(void)
+{
+	gdb_halt_state.target = NULL;
+}
+
+/* Send the program counter with the stop reply, saving GDB a round trip */
+static void gdb_expedite_pc(struct target *ct, char *expedited, size_t size)
+{
+	struct reg **reg_list;
+	int reg_list_size;
+
+	expedited[0] = '\0';
+
+	if (target_get_gdb_reg_list_noread(ct, &reg_list, &reg_list_size,
+			REG_CLASS_ALL) != ERROR_OK)
+		return;
+
+	for (int i = 0; i < reg_list_size; i++) {
+		struct reg *reg = reg_list[i];
+		if (!reg || !reg->exist || reg->hidden || strcmp(reg->name, "pc"))
+			continue;
+
+		/* GDB knows the register by its position and its number */
+		if (reg->number != (uint32_t)i || reg->size > 64)
+			break;
+
+		if (!reg->valid && reg->type->get(reg) != ERROR_OK)
+			break;
+
+		char value[17];
+		gdb_str_to_target(ct, value, reg);
+		snprintf(expedited, size, "%x:%s;", i, value);
+		break;
+	}
+
+	free(reg_list);
+}
+
+static const struct gdb_halt_state *gdb_get_halt_state(struct target *target,
+		struct connection *connection)
+{
+	struct gdb_halt_state *state = &gdb_halt_state;
+
+	if (state->target == target && state->generation == target_memcache_generation())
+		return state;
 
 	rtos_update_threads(target);
 
-	if (target->debug_reason == DBG_REASON_EXIT) {
-		sig_reply_len = snprintf(sig_reply, sizeof(sig_reply), "W00");
-	} else {
+	memset(state, 0, sizeof(*state));
+	state->exited = target->debug_reason == DBG_REASON_EXIT;
+	if (!state->exited) {
 		struct target *ct;
 		if (target->rtos) {
 			target->rtos->current_threadid = target->rtos->current_thread;
 			target->rtos->gdb_target_for_threadid(connection, target->rtos->current_threadid, &ct);
+			state->has_thread = true;
+			state->thread = target->rtos->current_thread;
 		} else {
 			ct = target;
+			gdb_expedite_pc(ct, state->expedited, sizeof(state->expedited));
 		}
 
-		if (gdb_connection->ctrl_c) {
-			signal_var = 0x2;
-		} else
-			signal_var = gdb_last_signal(ct);
+		state->signal = gdb_last_signal(ct);
+		gdb_watch_stop_reason(ct, state->stop_reason, sizeof(state->stop_reason));
+	}
 
-		stop_reason[0] = '\0';
-		if (ct->debug_reason == DBG_REASON_WATCHPOINT) {
-			enum watchpoint_rw hit_wp_type;
-			target_addr_t hit_wp_address;
+	state->generation = target_memcache_generation();
+	state->target = target;
 
-			if (watchpoint_hit(ct, &hit_wp_type, &hit_wp_address) == ERROR_OK) {
+	return state;
+}
 
-				switch (hit_wp_type) {
-					case WPT_WRITE:
-						snprintf(stop_reason, sizeof(stop_reason),
-								"watch:%08" TARGET_PRIxADDR ";", hit_wp_address);
-						break;
-					case WPT_READ:
-						snprintf(stop_reason, sizeof(stop_reason),
-								"rwatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
-						break;
-					case WPT_ACCESS:
-						snprintf(stop_reason, sizeof(stop_reason),
-								"awatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
-						break;
-					default:
-						break;
-				}
-			}
-		}
+static void gdb_signal_reply(struct target *target, struct connection *connection)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	const struct gdb_halt_state *state = gdb_get_halt_state(target, connection);
+	char sig_reply[96];
+	char current_thread[25];
+	int sig_reply_len;
+	int signal_var;
+
+	if (state->exited) {
+		sig_reply_len = snprintf(sig_reply, sizeof(sig_reply), "W00");
+	} else {
+		if (gdb_connection->ctrl_c)
+			signal_var = 0x2;
+		else
+			signal_var = state->signal;
 
 		current_thread[0] = '\0';
-		if (target->rtos)
+		if (state->has_thread)
 			snprintf(current_thread, sizeof(current_thread), "thread:%" PRIx64 ";",
-					target->rtos->current_thread);
+					state->thread);
 
-		sig_reply_len = snprintf(sig_reply, sizeof(sig_reply), "T%2.2x%s%s",
-				signal_var, stop_reason, current_thread);
+		sig_reply_len = snprintf(sig_reply, sizeof(sig_reply), "T%2.2x%s%s%s",
+				signal_var, state->expedited, state->stop_reason, current_thread);
 
 		gdb_connection->ctrl_c = false;
 	}
@@ -931,6 +1109,116 @@ static void gdb_fileio_reply(struct target *target, struct connection *connectio
 	}
 }
 
+/*
+ * Non-stop mode. Each core of the SMP group is a thread, numbered like the
+ * hwthread RTOS does, and halts and resumes on its own. Stops are reported
+ * with asynchronous %Stop notifications: the first stop is notified, GDB
+ * then fetches the pending ones with vStopped until it gets an "OK".
+ */
+static threadid_t gdb_core_thread_id(struct target *core)
+{
+	return core->coreid + 1;
+}
+
+static int gdb_core_stop_reply(struct target *core, char *reply, size_t size)
+{
+	char stop_reason[32];
+	int signal_var = 0;
+
+	/* halts requested with vCont;t are reported as signal 0 */
+	if (core->debug_reason != DBG_REASON_DBGRQ)
+		signal_var = gdb_last_signal(core);
+
+	gdb_watch_stop_reason(core, stop_reason, sizeof(stop_reason));
+
+	return snprintf(reply, size, "T%2.2x%sthread:%" PRIx64 ";",
+			signal_var, stop_reason, gdb_core_thread_id(core));
+}
+
+static int gdb_put_core_stop_reply(struct connection *connection, struct target *core)
+{
+	char reply[80];
+	int len = gdb_core_stop_reply(core, reply, sizeof(reply));
+
+	return gdb_put_packet(connection, reply, len);
+}
+
+static bool gdb_stop_queue_add(struct gdb_connection *gdb_con, struct target *core)
+{
+	for (unsigned int i = 0; i < gdb_con->stop_queue_len; i++) {
+		if (gdb_con->stop_queue[i] == core)
+			return false;
+	}
+
+	struct target **stop_queue = realloc(gdb_con->stop_queue,
+			(gdb_con->stop_queue_len + 1) * sizeof(*stop_queue));
+	if (!stop_queue) {
+		LOG_ERROR("Out of memory");
+		return false;
+	}
+	stop_queue[gdb_con->stop_queue_len++] = core;
+	gdb_con->stop_queue = stop_queue;
+
+	return true;
+}
+
+static void gdb_queue_stop(struct connection *connection, struct target *core)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (!gdb_stop_queue_add(gdb_con, core))
+		return;
+
+	/* GDB fetches the later stops itself while the first one is pending */
+	if (gdb_con->stop_queue_len == 1) {
+		char notification[96] = "Stop:";
+		int len = strlen(notification);
+		len += gdb_core_stop_reply(core, notification + len, sizeof(notification) - len);
+		gdb_put_notification(connection, notification, len);
+	}
+}
+
+/* vStopped: GDB has seen the first queued stop, reply with the next one */
+static int gdb_vstopped_packet(struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (gdb_con->stop_queue_len > 0) {
+		gdb_con->stop_queue_len--;
+		memmove(gdb_con->stop_queue, gdb_con->stop_queue + 1,
+				gdb_con->stop_queue_len * sizeof(*gdb_con->stop_queue));
+	}
+
+	if (!gdb_con->stop_queue_len)
+		return gdb_put_packet(connection, "OK", 2);
+
+	return gdb_put_core_stop_reply(connection, gdb_con->stop_queue[0]);
+}
+
+/* '?' in non-stop mode: report all halted cores, like a series of stops */
+static int gdb_non_stop_status_packet(struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+	struct target_list *head;
+
+	gdb_con->stop_queue_len = 0;
+
+	if (target->smp) {
+		foreach_smp_target(head, target->smp_targets) {
+			if (head->target->state == TARGET_HALTED)
+				gdb_stop_queue_add(gdb_con, head->target);
+		}
+	} else if (target->state == TARGET_HALTED) {
+		gdb_stop_queue_add(gdb_con, target);
+	}
+
+	if (!gdb_con->stop_queue_len)
+		return gdb_put_packet(connection, "OK", 2);
+
+	return gdb_put_core_stop_reply(connection, gdb_con->stop_queue[0]);
+}
+
 static void gdb_frontend_halted(struct target *target, struct connection *connection)
 {
 	struct gdb_connection *gdb_connection = connection->priv;
@@ -960,8 +1248,16 @@ static int gdb_target_callback_event_handler(struct target *target,
 		enum target_event event, void *priv)
 {
 	struct connection *connection = priv;
+	struct gdb_connection *gdb_connection = connection->priv;
 	struct gdb_service *gdb_service = connection->service->priv;
 
+	/* in non-stop mode every core of the group reports its own stops */
+	if (gdb_connection->non_stop && target->gdb_service == gdb_service) {
+		if (event == TARGET_EVENT_GDB_HALT && target->state == TARGET_HALTED)
+			gdb_queue_stop(connection, target);
+		return ERROR_OK;
+	}
+
 	if (gdb_service->target != target)
 		return ERROR_OK;
 
@@ -1007,6 +1303,18 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->target_desc.tdesc_length = 0;
 	gdb_connection->thread_list = NULL;
 	gdb_connection->output_flag = GDB_OUTPUT_NO;
+	gdb_connection->tx_buffer = NULL;
+	gdb_connection->tx_buffer_size = 0;
+	gdb_connection->non_stop = false;
+	gdb_connection->stop_queue = NULL;
+	gdb_connection->stop_queue_len = 0;
+	gdb_connection->vflash_bank = NULL;
+	gdb_connection->vflash_address = 0;
+	gdb_connection->vflash_data = NULL;
+	gdb_connection->vflash_len = 0;
+	gdb_connection->vflash_size = 0;
+	gdb_connection->vflash_started = false;
+	gdb_connection->vflash_error = ERROR_OK;
 
 	/* send ACK to GDB for debug request */
 	gdb_write(connection, "+", 1);
@@ -1124,6 +1432,12 @@ static int gdb_connection_closed(struct connection *connection)
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, target);
 
+	if (gdb_connection->non_stop)
+		smp_set_non_stop(target, false);
+
+	free(gdb_connection->vflash_data);
+	free(gdb_connection->stop_queue);
+	free(gdb_connection->tx_buffer);
 	free(connection->priv);
 	connection->priv = NULL;
 
@@ -1259,6 +1573,10 @@ static int gdb_get_registers_packet(struct connection *connection,
 
 	reg_packet_p = reg_packet;
 
+	/* fetch all registers not cached in one go, errors are reported below
+	 * for each register which is still invalid */
+	target_read_registers(target, reg_list, reg_list_size);
+
 	for (i = 0; i < reg_list_size; i++) {
 		if (!reg_list[i] || reg_list[i]->exist == false || reg_list[i]->hidden)
 			continue;
@@ -1306,6 +1624,8 @@ static int gdb_set_registers_packet(struct connection *connection,
 	LOG_DEBUG("-");
 #endif
 
+	gdb_halt_state_invalidate();
+
 	/* skip command character */
 	packet++;
 	packet_size--;
@@ -1422,6 +1742,8 @@ static int gdb_set_register_packet(struct connection *connection,
 		LOG_ERROR("GDB 'set register packet', but no '=' following the register number");
 		return ERROR_SERVER_REMOTE_CLOSED;
 	}
+
+	gdb_halt_state_invalidate();
 	size_t chars = strlen(separator + 1);
 	uint8_t *bin_buf = malloc(chars / 2);
 	gdb_target_to_reg(target, separator + 1, chars, bin_buf);
@@ -1488,6 +1810,28 @@ static int gdb_error(struct connection *connection, int retval)
 /* We don't have to worry about the default 2 second timeout for GDB packets,
  * because GDB breaks up large memory reads into smaller reads.
  */
+/* Escape the @a len bytes of @a data as the payload of a binary reply,
+ * prefixed by 'b'. @a reply needs 2 * @a len + 1 bytes; @a data may be
+ * its last @a len bytes, the escaped data never overtakes the data left
+ * to escape. */
+static size_t gdb_escape_binary(char *reply, const uint8_t *data, uint32_t len)
+{
+	size_t pos = 0;
+
+	reply[pos++] = 'b';
+	for (uint32_t i = 0; i < len; i++) {
+		uint8_t c = data[i];
+		if (c == '#' || c == '$' || c == '}' || c == '*') {
+			reply[pos++] = '}';
+			c ^= 0x20;
+		}
+		reply[pos++] = c;
+	}
+
+	return pos;
+}
+
+/* 'm' reads memory as hex, 'x' as escaped binary if GDB saw binary-upload+ */
 static int gdb_read_memory_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -1495,9 +1839,10 @@ static int gdb_read_memory_packet(struct connection *connection,
 	char *separator;
 	uint64_t addr = 0;
 	uint32_t len = 0;
+	bool binary = packet[0] == 'x';
 
 	uint8_t *buffer;
-	char *hex_buffer;
+	char *reply_buffer = NULL;
 
 	int retval = ERROR_OK;
 
@@ -1514,12 +1859,26 @@ static int gdb_read_memory_packet(struct connection *connection,
 	len = strtoul(separator + 1, NULL, 16);
 
 	if (!len) {
+		if (binary) {
+			gdb_put_packet(connection, "b", 1);
+			return ERROR_OK;
+		}
 		LOG_WARNING("invalid read memory packet received (len == 0)");
 		gdb_put_packet(connection, "", 0);
 		return ERROR_OK;
 	}
 
-	buffer = malloc(len);
+	if (binary) {
+		/* read to the end of the reply, then escape it in place */
+		reply_buffer = malloc((size_t)len * 2 + 1);
+		buffer = reply_buffer ? (uint8_t *)reply_buffer + len + 1 : NULL;
+	} else {
+		buffer = malloc(len);
+	}
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return gdb_error(connection, ERROR_FAIL);
+	}
 
 	LOG_DEBUG("addr: 0x%16.16" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
@@ -1547,18 +1906,23 @@ static int gdb_read_memory_packet(struct connection *connection,
 		retval = ERROR_OK;
 	}
 
-	if (retval == ERROR_OK) {
-		hex_buffer = malloc(len * 2 + 1);
+	if (retval == ERROR_OK && binary) {
+		size_t pkt_len = gdb_escape_binary(reply_buffer, buffer, len);
 
-		size_t pkt_len = hexify(hex_buffer, buffer, len, len * 2 + 1);
+		gdb_put_packet(connection, reply_buffer, pkt_len);
+	} else if (retval == ERROR_OK) {
+		reply_buffer = malloc(len * 2 + 1);
 
-		gdb_put_packet(connection, hex_buffer, pkt_len);
+		size_t pkt_len = hexify(reply_buffer, buffer, len, len * 2 + 1);
 
-		free(hex_buffer);
-	} else
+		gdb_put_packet(connection, reply_buffer, pkt_len);
+	} else {
 		retval = gdb_error(connection, retval);
+	}
 
-	free(buffer);
+	if (!binary)
+		free(buffer);
+	free(reply_buffer);
 
 	return retval;
 }
@@ -1882,6 +2246,72 @@ static int decode_xfer_read(char const *buf, char **annex, int *ofs, unsigned in
 	return ERROR_OK;
 }
 
+/* Generated XML documents are kept per target and reused, e.g. when GDB
+ * reconnects, for as long as a fingerprint of all their inputs matches. */
+struct gdb_xml_cache {
+	struct target *target;
+	uint32_t tdesc_fingerprint;
+	char *tdesc;
+	uint32_t memory_map_fingerprint;
+	char *memory_map;
+	struct gdb_xml_cache *next;
+};
+
+static struct gdb_xml_cache *gdb_xml_caches;
+
+static struct gdb_xml_cache *gdb_get_xml_cache(struct target *target)
+{
+	struct gdb_xml_cache *cache;
+
+	for (cache = gdb_xml_caches; cache; cache = cache->next) {
+		if (cache->target == target)
+			return cache;
+	}
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+	cache->target = target;
+	cache->next = gdb_xml_caches;
+	gdb_xml_caches = cache;
+
+	return cache;
+}
+
+static void gdb_free_xml_caches(void)
+{
+	while (gdb_xml_caches) {
+		struct gdb_xml_cache *next = gdb_xml_caches->next;
+		free(gdb_xml_caches->tdesc);
+		free(gdb_xml_caches->memory_map);
+		free(gdb_xml_caches);
+		gdb_xml_caches = next;
+	}
+}
+
+#define GDB_FINGERPRINT_INIT	2166136261u
+
+/* FNV-1a */
+static uint32_t gdb_fingerprint(uint32_t hash, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static uint32_t gdb_fingerprint_str(uint32_t hash, const char *str)
+{
+	if (!str)
+		return gdb_fingerprint(hash, &str, sizeof(str));
+
+	return gdb_fingerprint(hash, str, strlen(str) + 1);
+}
+
 static int compare_bank(const void *a, const void *b)
 {
 	struct flash_bank *b1, *b2;
@@ -1925,8 +2355,6 @@ static int gdb_memory_map(struct connection *connection,
 	offset = strtoul(packet, &separator, 16);
 	length = strtoul(separator + 1, &separator, 16);
 
-	xml_printf(&retval, &xml, &pos, &size, "<memory-map>\n");
-
 	/* Sort banks in ascending order.  We need to report non-flash
 	 * memory as ram (or rather read/write) by default for GDB, since
 	 * it has no concept of non-cacheable read/write memory (i/o etc).
@@ -1949,6 +2377,33 @@ static int gdb_memory_map(struct connection *connection,
 	qsort(banks, target_flash_banks, sizeof(struct flash_bank *),
 		compare_bank);
 
+	/* the probed banks are all the memory map is generated from */
+	uint32_t fingerprint = GDB_FINGERPRINT_INIT;
+	target_addr_t address_max = target_address_max(target);
+	fingerprint = gdb_fingerprint(fingerprint, &address_max, sizeof(address_max));
+	for (unsigned int i = 0; i < target_flash_banks; i++) {
+		p = banks[i];
+		fingerprint = gdb_fingerprint(fingerprint, &p->base, sizeof(p->base));
+		fingerprint = gdb_fingerprint(fingerprint, &p->size, sizeof(p->size));
+		fingerprint = gdb_fingerprint(fingerprint, &p->num_sectors, sizeof(p->num_sectors));
+		for (unsigned int j = 0; j < p->num_sectors; j++) {
+			fingerprint = gdb_fingerprint(fingerprint, &p->sectors[j].offset,
+					sizeof(p->sectors[j].offset));
+			fingerprint = gdb_fingerprint(fingerprint, &p->sectors[j].size,
+					sizeof(p->sectors[j].size));
+		}
+	}
+
+	struct gdb_xml_cache *cache = gdb_get_xml_cache(target);
+	if (cache && cache->memory_map && cache->memory_map_fingerprint == fingerprint) {
+		free(banks);
+		xml = cache->memory_map;
+		pos = strlen(xml);
+		goto send;
+	}
+
+	xml_printf(&retval, &xml, &pos, &size, "<memory-map>\n");
+
 	for (unsigned int i = 0; i < target_flash_banks; i++) {
 		unsigned sector_size = 0;
 		unsigned group_len = 0;
@@ -2030,6 +2485,13 @@ static int gdb_memory_map(struct connection *connection,
 		return retval;
 	}
 
+	if (cache) {
+		free(cache->memory_map);
+		cache->memory_map = xml;
+		cache->memory_map_fingerprint = fingerprint;
+	}
+
+send:
 	if (offset + length > pos)
 		length = pos - offset;
 
@@ -2039,7 +2501,8 @@ static int gdb_memory_map(struct connection *connection,
 	gdb_put_packet(connection, t, length + 1);
 
 	free(t);
-	free(xml);
+	if (!cache)
+		free(xml);
 	return ERROR_OK;
 }
 
@@ -2543,6 +3006,68 @@ error:
 	return retval;
 }
 
+static int gdb_target_description_fingerprint(struct target *target, uint32_t *fingerprint)
+{
+	struct reg **reg_list = NULL;
+	int reg_list_size;
+
+	int retval = smp_reg_list_noread(target, &reg_list, &reg_list_size, REG_CLASS_ALL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t hash = GDB_FINGERPRINT_INIT;
+	hash = gdb_fingerprint_str(hash, target_get_gdb_arch(target));
+	hash = gdb_fingerprint(hash, &reg_list_size, sizeof(reg_list_size));
+	for (int i = 0; i < reg_list_size; i++) {
+		const struct reg *reg = reg_list[i];
+		hash = gdb_fingerprint(hash, &reg, sizeof(reg));
+		hash = gdb_fingerprint_str(hash, reg->name);
+		hash = gdb_fingerprint(hash, &reg->size, sizeof(reg->size));
+		hash = gdb_fingerprint(hash, &reg->number, sizeof(reg->number));
+		bool flags[3] = { reg->exist, reg->hidden, reg->caller_save };
+		hash = gdb_fingerprint(hash, flags, sizeof(flags));
+		hash = gdb_fingerprint_str(hash, reg->feature ? reg->feature->name : NULL);
+		hash = gdb_fingerprint(hash, &reg->reg_data_type, sizeof(reg->reg_data_type));
+		if (reg->reg_data_type)
+			hash = gdb_fingerprint_str(hash, reg->reg_data_type->id);
+		hash = gdb_fingerprint_str(hash, reg->group);
+	}
+	free(reg_list);
+
+	*fingerprint = hash;
+	return ERROR_OK;
+}
+
+/* Like gdb_generate_target_description(), but served from the target's
+ * cache if its registers did not change since the last time. */
+static int gdb_get_target_description(struct target *target, char **tdesc_out)
+{
+	struct gdb_xml_cache *cache = gdb_get_xml_cache(target);
+	uint32_t fingerprint;
+
+	if (!cache || gdb_target_description_fingerprint(target, &fingerprint) != ERROR_OK)
+		return gdb_generate_target_description(target, tdesc_out);
+
+	if (!cache->tdesc || cache->tdesc_fingerprint != fingerprint) {
+		free(cache->tdesc);
+		cache->tdesc = NULL;
+		int retval = gdb_generate_target_description(target, &cache->tdesc);
+		if (retval != ERROR_OK)
+			return retval;
+		cache->tdesc_fingerprint = fingerprint;
+	} else {
+		LOG_TARGET_DEBUG(target, "reusing the cached target description");
+	}
+
+	*tdesc_out = strdup(cache->tdesc);
+	if (!*tdesc_out) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
 static int gdb_get_target_description_chunk(struct target *target, struct target_desc_format *target_desc,
 		char **chunk, int32_t offset, uint32_t length)
 {
@@ -2555,7 +3080,7 @@ static int gdb_get_target_description_chunk(struct target *target, struct target
 	uint32_t tdesc_length = target_desc->tdesc_length;
 
 	if (!tdesc) {
-		int retval = gdb_generate_target_description(target, &tdesc);
+		int retval = gdb_get_target_description(target, &tdesc);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Unable to Generate Target Description");
 			return ERROR_FAIL;
@@ -2661,6 +3186,7 @@ static int gdb_generate_thread_list(struct target *target, char **thread_list_ou
 			if (!thread_detail->exists)
 				continue;
 
+			rtos_get_thread_name(rtos, thread_detail);
 			if (thread_detail->thread_name_str)
 				xml_printf(&retval, &thread_list, &pos, &size,
 					   "<thread id=\"%" PRIx64 "\" name=\"%s\">",
@@ -2883,7 +3409,7 @@ static int gdb_query_packet(struct connection *connection,
 			&buffer,
 			&pos,
 			&size,
-			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+",
+			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+;binary-upload+;QNonStop+",
 			GDB_BUFFER_SIZE,
 			((gdb_use_memory_map == 1) && (flash_get_bank_count() > 0)) ? '+' : '-',
 			(gdb_target_desc_supported == 1) ? '+' : '-');
@@ -2966,6 +3492,21 @@ static int gdb_query_packet(struct connection *connection,
 		gdb_connection->noack_mode = 1;
 		gdb_put_packet(connection, "OK", 2);
 		return ERROR_OK;
+	} else if (strncmp(packet, "QNonStop:", 9) == 0) {
+		bool non_stop = packet[9] == '1';
+
+		/* the threads, i.e. the cores, have to be known to GDB */
+		if (non_stop && (!target->rtos || strcmp(target->rtos->type->name, "hwthread"))) {
+			LOG_ERROR("GDB non-stop mode requires the hwthread RTOS");
+			gdb_send_error(connection, 01);
+			return ERROR_OK;
+		}
+
+		gdb_connection->non_stop = non_stop;
+		gdb_connection->stop_queue_len = 0;
+		smp_set_non_stop(target, non_stop);
+		gdb_put_packet(connection, "OK", 2);
+		return ERROR_OK;
 	} else if (target->type->gdb_query_custom) {
 		char *buffer = NULL;
 		int ret = target->type->gdb_query_custom(target, packet, &buffer);
@@ -2977,6 +3518,170 @@ static int gdb_query_packet(struct connection *connection,
 	return ERROR_OK;
 }
 
+/* The first action of a vCont packet which applies to @a core, if any */
+static char gdb_vcont_core_action(const char *parse, struct target *core,
+		struct target *target)
+{
+	while (parse[0] == ';' && parse[1] != '\0') {
+		char action = parse[1];
+		char *endp;
+
+		parse += 2;
+		/* skip the signal of 'C' and 'S' */
+		if (action == 'C' || action == 'S') {
+			strtoul(parse, &endp, 16);
+			parse = endp;
+		}
+
+		/* no thread-id, -1 and 0 (any thread) */
+		bool match = true;
+		if (parse[0] == ':') {
+			int64_t thread_id = strtoll(parse + 1, &endp, 16);
+			parse = endp;
+			if (thread_id == 0)
+				match = core == target;
+			else if (thread_id != -1)
+				match = thread_id == gdb_core_thread_id(core);
+		}
+
+		if (match)
+			return action;
+	}
+
+	return 0;
+}
+
+static void gdb_vcont_core(struct connection *connection, struct target *core, char action)
+{
+	int retval;
+
+	switch (action) {
+		case 'c':
+		case 'C':
+			if (core->state != TARGET_HALTED)
+				break;
+			LOG_TARGET_DEBUG(core, "non-stop continue");
+			target_call_event_callbacks(core, TARGET_EVENT_GDB_START);
+			retval = target_resume(core, 1, 0, 0, 0);
+			if (retval != ERROR_OK)
+				LOG_TARGET_ERROR(core, "resume failed");
+			break;
+		case 's':
+		case 'S':
+			if (core->state != TARGET_HALTED)
+				break;
+			LOG_TARGET_DEBUG(core, "non-stop single-step");
+			target_call_event_callbacks(core, TARGET_EVENT_GDB_START);
+			retval = target_step(core, 1, 0, 0);
+			if (retval == ERROR_OK)
+				retval = target_poll(core);
+			/* some drivers do not signal the halt after a step */
+			if (retval == ERROR_OK && core->state == TARGET_HALTED)
+				gdb_queue_stop(connection, core);
+			else if (retval != ERROR_OK)
+				LOG_TARGET_ERROR(core, "step failed");
+			break;
+		case 't':
+			if (core->state == TARGET_HALTED) {
+				/* stopping a stopped thread reports it again */
+				gdb_queue_stop(connection, core);
+				break;
+			}
+			LOG_TARGET_DEBUG(core, "non-stop halt");
+			retval = target_halt(core);
+			if (retval == ERROR_OK)
+				retval = target_poll(core);
+			if (retval != ERROR_OK)
+				LOG_TARGET_ERROR(core, "halt failed");
+			break;
+		default:
+			break;
+	}
+}
+
+/* vCont in non-stop mode only affects the cores named by the actions and
+ * is replied to at once, the stops are notified later */
+static bool gdb_handle_vcont_non_stop(struct connection *connection, const char *parse)
+{
+	struct target *target = get_target_from_connection(connection);
+	struct target_list *head;
+
+	if (parse[0] != ';')
+		return false;
+
+	if (target->smp) {
+		foreach_smp_target(head, target->smp_targets)
+			gdb_vcont_core(connection, head->target,
+					gdb_vcont_core_action(parse, head->target, target));
+	} else {
+		gdb_vcont_core(connection, target, gdb_vcont_core_action(parse, target, target));
+	}
+
+	gdb_put_packet(connection, "OK", 2);
+	return true;
+}
+
+/*
+ * vCont;r: single-step until the PC leaves [start, end) without a round trip
+ * to GDB per instruction. Stepping also ends when anything else than the step
+ * stops the core, e.g. a breakpoint, or when GDB sends something (Ctrl-C).
+ */
+static int gdb_range_step(struct connection *connection, struct target *ct,
+		target_addr_t start, target_addr_t end)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct reg *pc = register_get_by_name(ct->reg_cache, "pc", true);
+	int retval;
+
+	/* GDB asks again for the rest of the range after a plain step */
+	if (!pc)
+		return target_step(ct, 1, 0, 0);
+
+	for (;;) {
+		retval = target_step(ct, 1, 0, 0);
+		if (retval != ERROR_OK)
+			return retval;
+
+		retval = target_poll(ct);
+		if (retval != ERROR_OK)
+			return retval;
+
+		if (ct->state != TARGET_HALTED || ct->debug_reason != DBG_REASON_SINGLESTEP)
+			return ERROR_OK;
+
+		/* the drivers usually read the PC on debug entry already */
+		if (!pc->valid) {
+			retval = pc->type->get(pc);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		target_addr_t addr = buf_get_u64(pc->value, 0, MIN(pc->size, 64));
+		if (addr < start || addr >= end)
+			return ERROR_OK;
+
+		int gotdata;
+		retval = check_pending(connection, 0, &gotdata);
+		if (retval != ERROR_OK)
+			return retval;
+		if (gotdata) {
+			int c;
+			retval = gdb_get_char(connection, &c);
+			if (retval != ERROR_OK)
+				return retval;
+			if (c == 0x3) {
+				gdb_con->ctrl_c = true;
+				gdb_log_incoming_packet(connection, "<Ctrl-C>");
+			} else {
+				gdb_putback_char(connection, c);
+			}
+			return ERROR_OK;
+		}
+
+		keep_alive();
+	}
+}
+
 static bool gdb_handle_vcont_packet(struct connection *connection, const char *packet, int packet_size)
 {
 	struct gdb_connection *gdb_connection = connection->priv;
@@ -2988,12 +3693,18 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 	if (parse[0] == '?') {
 		if (target->type->step) {
 			/* gdb doesn't accept c without C and s without S */
-			gdb_put_packet(connection, "vCont;c;C;s;S", 13);
+			if (gdb_connection->non_stop)
+				gdb_put_packet(connection, "vCont;c;C;s;S;t", 15);
+			else
+				gdb_put_packet(connection, "vCont;c;C;s;S;r", 15);
 			return true;
 		}
 		return false;
 	}
 
+	if (gdb_connection->non_stop)
+		return gdb_handle_vcont_non_stop(connection, parse);
+
 	if (parse[0] == ';') {
 		++parse;
 		--packet_size;
@@ -3026,16 +3737,30 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 		return true;
 	}
 
-	/* single-step or step-over-breakpoint */
-	if (parse[0] == 's') {
+	/* single-step, step-over-breakpoint or range step */
+	if (parse[0] == 's' || parse[0] == 'r') {
 		gdb_running_type = 's';
 		bool fake_step = false;
+		bool range_step = parse[0] == 'r';
+		target_addr_t range_start = 0;
+		target_addr_t range_end = 0;
 
 		struct target *ct = target;
 		int current_pc = 1;
 		int64_t thread_id;
 		parse++;
 		packet_size--;
+		if (range_step) {
+			char *endp;
+			range_start = strtoull(parse, &endp, 16);
+			if (*endp != ',') {
+				LOG_ERROR("incomplete vCont;r packet received");
+				return false;
+			}
+			range_end = strtoull(endp + 1, &endp, 16);
+			packet_size -= endp - parse;
+			parse = endp;
+		}
 		if (parse[0] == ':') {
 			char *endp;
 			parse++;
@@ -3134,7 +3859,10 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 			return true;
 		}
 
-		retval = target_step(ct, current_pc, 0, 0);
+		if (range_step)
+			retval = gdb_range_step(connection, ct, range_start, range_end);
+		else
+			retval = target_step(ct, current_pc, 0, 0);
 		if (retval == ERROR_TARGET_NOT_HALTED)
 			LOG_INFO("target %s was not halted when step was requested", target_name(ct));
 
@@ -3247,6 +3975,124 @@ static bool gdb_handle_vrun_packet(struct connection *connection, const char *pa
 	return true;
 }
 
+/* End of the last flash sector of @a bank within [start, end], or @a start */
+static target_addr_t gdb_vflash_sector_boundary(struct flash_bank *bank,
+		target_addr_t start, target_addr_t end)
+{
+	target_addr_t boundary = start;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		target_addr_t sector_end = bank->base + bank->sectors[i].offset +
+			bank->sectors[i].size;
+		if (sector_end > end)
+			break;
+		if (sector_end > start)
+			boundary = sector_end;
+	}
+
+	return boundary;
+}
+
+/* Program the first @a len bytes of the streamed vFlashWrite data */
+static int gdb_vflash_stream_program(struct connection *connection, uint32_t len)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+	struct image image;
+	uint32_t written = 0;
+
+	if (!len)
+		return ERROR_OK;
+
+	if (!gdb_con->vflash_started) {
+		target_call_event_callbacks(target, TARGET_EVENT_GDB_FLASH_WRITE_START);
+		gdb_con->vflash_started = true;
+	}
+
+	int retval = image_open(&image, "", "build");
+	if (retval == ERROR_OK) {
+		retval = image_add_section(&image, gdb_con->vflash_address, len, 0x0,
+				gdb_con->vflash_data);
+		if (retval == ERROR_OK)
+			retval = flash_write(target, &image, &written, false);
+		image_close(&image);
+	}
+
+	LOG_DEBUG("wrote %" PRIu32 " bytes at " TARGET_ADDR_FMT " from vFlash stream",
+			written, gdb_con->vflash_address);
+
+	gdb_con->vflash_address += len;
+	gdb_con->vflash_len -= len;
+	memmove(gdb_con->vflash_data, gdb_con->vflash_data + len, gdb_con->vflash_len);
+
+	if (retval != ERROR_OK && gdb_con->vflash_error == ERROR_OK)
+		gdb_con->vflash_error = retval;
+
+	return retval;
+}
+
+/* vFlashWrite in streamed mode: when enough contiguous data is collected,
+ * the complete sectors are programmed after replying, i.e. while GDB is
+ * already sending the next packet */
+static int gdb_vflash_stream_write(struct connection *connection,
+		struct flash_bank *bank, target_addr_t addr, uint32_t length,
+		const uint8_t *data)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	target_addr_t end = gdb_con->vflash_address + gdb_con->vflash_len;
+	uint32_t gap = 0;
+
+	if (gdb_con->vflash_len) {
+		if (bank == gdb_con->vflash_bank && addr >= end &&
+				(addr == end || gdb_vflash_sector_boundary(bank, end - 1, addr) == end - 1)) {
+			/* pad a gap within a sector, like flash_write() does */
+			gap = addr - end;
+		} else {
+			/* not contiguous, do not wait for the rest of the data */
+			gdb_vflash_stream_program(connection, gdb_con->vflash_len);
+		}
+	}
+
+	if (!gdb_con->vflash_len) {
+		gdb_con->vflash_bank = bank;
+		gdb_con->vflash_address = addr;
+	}
+
+	if (gdb_con->vflash_len + gap + length > gdb_con->vflash_size) {
+		uint32_t size = MAX(gdb_con->vflash_len + gap + length, 2 * GDB_VFLASH_STREAM_CHUNK);
+		uint8_t *vflash_data = realloc(gdb_con->vflash_data, size);
+		if (!vflash_data) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		gdb_con->vflash_data = vflash_data;
+		gdb_con->vflash_size = size;
+	}
+	memset(gdb_con->vflash_data + gdb_con->vflash_len, bank->default_padded_value, gap);
+	gdb_con->vflash_len += gap;
+	memcpy(gdb_con->vflash_data + gdb_con->vflash_len, data, length);
+	gdb_con->vflash_len += length;
+
+	if (gdb_con->vflash_error != ERROR_OK) {
+		/* GDB gives up the download */
+		gdb_con->vflash_error = ERROR_OK;
+		gdb_con->vflash_len = 0;
+		gdb_send_error(connection, EIO);
+		return ERROR_OK;
+	}
+
+	gdb_put_packet(connection, "OK", 2);
+
+	if (gdb_con->vflash_len >= GDB_VFLASH_STREAM_CHUNK) {
+		target_addr_t boundary = gdb_vflash_sector_boundary(bank,
+				gdb_con->vflash_address,
+				gdb_con->vflash_address + gdb_con->vflash_len);
+		gdb_vflash_stream_program(connection, boundary - gdb_con->vflash_address);
+	}
+
+	return ERROR_OK;
+}
+
 static int gdb_v_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -3278,6 +4124,9 @@ static int gdb_v_packet(struct connection *connection,
 		return ERROR_OK;
 	}
 
+	if (strncmp(packet, "vStopped", 8) == 0 && gdb_connection->non_stop)
+		return gdb_vstopped_packet(connection);
+
 	/* if flash programming disabled - send a empty reply */
 
 	if (gdb_flash_program == 0) {
@@ -3309,6 +4158,9 @@ static int gdb_v_packet(struct connection *connection,
 			return ERROR_SERVER_REMOTE_CLOSED;
 		}
 
+		/* the streamed data must not end up in sectors erased later */
+		gdb_vflash_stream_program(connection, gdb_connection->vflash_len);
+
 		/* assume all sectors need erasing - stops any problems
 		 * when flash_write is called multiple times */
 		flash_set_dirty();
@@ -3358,6 +4210,18 @@ static int gdb_v_packet(struct connection *connection,
 		}
 		length = packet_size - (parse - packet);
 
+		/* stream unless the bank needs all data in a single write, or the
+		 * image is used already */
+		if (gdb_flash_stream && !gdb_connection->vflash_image) {
+			struct flash_bank *bank;
+			retval = get_flash_bank_by_addr(target, addr, false, &bank);
+			if (retval == ERROR_OK && bank &&
+					bank->minimal_write_gap != FLASH_WRITE_CONTINUOUS &&
+					addr + length - 1 <= bank->base + bank->size - 1)
+				return gdb_vflash_stream_write(connection, bank, addr, length,
+						(const uint8_t *)parse);
+		}
+
 		/* create a new image if there isn't already one */
 		if (!gdb_connection->vflash_image) {
 			gdb_connection->vflash_image = malloc(sizeof(struct image));
@@ -3376,16 +4240,24 @@ static int gdb_v_packet(struct connection *connection,
 	}
 
 	if (strncmp(packet, "vFlashDone", 10) == 0) {
-		uint32_t written;
+		uint32_t written = 0;
+
+		/* program the rest of the streamed data */
+		gdb_vflash_stream_program(connection, gdb_connection->vflash_len);
+		result = gdb_connection->vflash_error;
+		gdb_connection->vflash_error = ERROR_OK;
 
 		/* process the flashing buffer. No need to erase as GDB
 		 * always issues a vFlashErase first. */
-		target_call_event_callbacks(target,
-				TARGET_EVENT_GDB_FLASH_WRITE_START);
-		result = flash_write(target, gdb_connection->vflash_image,
-			&written, false);
+		if (!gdb_connection->vflash_started)
+			target_call_event_callbacks(target,
+					TARGET_EVENT_GDB_FLASH_WRITE_START);
+		if (result == ERROR_OK && gdb_connection->vflash_image)
+			result = flash_write(target, gdb_connection->vflash_image,
+				&written, false);
 		target_call_event_callbacks(target,
 			TARGET_EVENT_GDB_FLASH_WRITE_END);
+		gdb_connection->vflash_started = false;
 		if (result != ERROR_OK) {
 			if (result == ERROR_FLASH_DST_OUT_OF_BANK)
 				gdb_put_packet(connection, "E.memtype", 9);
@@ -3396,9 +4268,11 @@ static int gdb_v_packet(struct connection *connection,
 			gdb_put_packet(connection, "OK", 2);
 		}
 
-		image_close(gdb_connection->vflash_image);
-		free(gdb_connection->vflash_image);
-		gdb_connection->vflash_image = NULL;
+		if (gdb_connection->vflash_image) {
+			image_close(gdb_connection->vflash_image);
+			free(gdb_connection->vflash_image);
+			gdb_connection->vflash_image = NULL;
+		}
 
 		return ERROR_OK;
 	}
@@ -3466,8 +4340,8 @@ static int gdb_fileio_response_packet(struct connection *connection,
 	return ERROR_OK;
 }
 
-static void gdb_log_callback(void *priv, const char *file, unsigned line,
-		const char *function, const char *string)
+static void gdb_log_callback(void *priv, enum log_levels level, const char *file,
+		unsigned int line, const char *function, const char *string)
 {
 	struct connection *connection = priv;
 	struct gdb_connection *gdb_con = connection->priv;
@@ -3528,6 +4402,7 @@ static int gdb_input_inner(struct connection *connection)
 		if (packet_size > 0) {
 
 			gdb_log_incoming_packet(connection, gdb_packet_buffer);
+			metric_add(&gdb_packets_metric, 1);
 
 			retval = ERROR_OK;
 			switch (packet[0]) {
@@ -3557,6 +4432,7 @@ static int gdb_input_inner(struct connection *connection)
 					retval = gdb_set_register_packet(connection, packet, packet_size);
 					break;
 				case 'm':
+				case 'x':
 					retval = gdb_read_memory_packet(connection, packet, packet_size);
 					break;
 				case 'M':
@@ -3567,7 +4443,10 @@ static int gdb_input_inner(struct connection *connection)
 					retval = gdb_breakpoint_watchpoint_packet(connection, packet, packet_size);
 					break;
 				case '?':
-					gdb_last_signal_packet(connection, packet, packet_size);
+					if (gdb_con->non_stop)
+						gdb_non_stop_status_packet(connection);
+					else
+						gdb_last_signal_packet(connection, packet, packet_size);
 					/* '?' is sent after the eventual '!' */
 					if (!warn_use_ext && !gdb_con->extended_protocol) {
 						warn_use_ext = true;
@@ -3736,7 +4615,9 @@ static int gdb_input_inner(struct connection *connection)
 
 static int gdb_input(struct connection *connection)
 {
+	adapter_stats_begin_op();
 	int retval = gdb_input_inner(connection);
+	adapter_stats_end_op();
 	struct gdb_connection *gdb_con = connection->priv;
 	if (retval == ERROR_SERVER_REMOTE_CLOSED)
 		return retval;
@@ -3926,6 +4807,15 @@ COMMAND_HANDLER(handle_gdb_flash_program_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_flash_stream_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ENABLE(CMD_ARGV[0], gdb_flash_stream);
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_report_data_abort_command)
 {
 	if (CMD_ARGC != 1)
@@ -4058,6 +4948,14 @@ static const struct command_registration gdb_command_handlers[] = {
 		.help = "enable or disable flash program",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "gdb_flash_stream",
+		.handler = handle_gdb_flash_stream_command,
+		.mode = COMMAND_CONFIG,
+		.help = "enable or disable programming the flash while GDB "
+			"is still sending the data",
+		.usage = "('enable'|'disable')"
+	},
 	{
 		.name = "gdb_report_data_abort",
 		.handler = handle_gdb_report_data_abort_command,
@@ -4108,4 +5006,5 @@ void gdb_service_free(void)
 {
 	free(gdb_port);
 	free(gdb_port_next);
+	gdb_free_xml_caches();
 }
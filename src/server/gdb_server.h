@@ -21,7 +21,10 @@ struct image;
 struct reg;
 #include <target/target.h>
 
-#define GDB_BUFFER_SIZE 16384
+/* Size of the packets advertised with PacketSize and of the receive buffer.
+ * Large memory writes (X packets) then arrive in few packets and are read
+ * with few socket reads. */
+#define GDB_BUFFER_SIZE 65536
 
 int gdb_target_add_all(struct target *target);
 int gdb_register_commands(struct command_context *command_context);
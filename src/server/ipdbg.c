@@ -19,6 +19,10 @@
 #define IPDBG_MIN_DR_LENGTH 11
 #define IPDBG_MAX_DR_LENGTH 13
 #define IPDBG_TCP_PORT_STR_MAX_LENGTH 6
+/* DR scans queued before a jtag_execute_queue() of a polling tick */
+#define IPDBG_MAX_SCANS_PER_POLL 1024
+#define IPDBG_MIN_POLLING_INTERVAL 1
+#define IPDBG_MAX_POLLING_INTERVAL 20
 
 /* private connection data for IPDBG */
 struct ipdbg_fifo {
@@ -62,6 +66,14 @@ struct ipdbg_hub {
 	uint8_t data_register_length;
 	uint8_t dn_xoff;
 	struct ipdbg_virtual_ir_info *virtual_ir;
+	/* the DR scans of a polling tick, the scan values are 2 bytes each */
+	struct scan_field *scan_fields;
+	uint32_t *scan_dn_words;
+	uint8_t *scan_dn_buf;
+	uint8_t *scan_up_buf;
+	/* scans without dn data to fetch the up data, adapted to the traffic */
+	unsigned int up_scans;
+	unsigned int polling_interval;
 };
 
 static struct ipdbg_hub *ipdbg_first_hub;
@@ -243,8 +255,18 @@ static int ipdbg_create_hub(struct jtag_tap *tap, uint32_t user_instruction, uin
 
 	new_hub->max_tools = ipdbg_max_tools_from_data_register_length(data_register_length);
 	new_hub->connections = calloc(new_hub->max_tools, sizeof(struct connection *));
-	if (!new_hub->connections) {
+	new_hub->scan_fields = calloc(IPDBG_MAX_SCANS_PER_POLL, sizeof(struct scan_field));
+	new_hub->scan_dn_words = calloc(IPDBG_MAX_SCANS_PER_POLL, sizeof(uint32_t));
+	new_hub->scan_dn_buf = calloc(IPDBG_MAX_SCANS_PER_POLL, 2);
+	new_hub->scan_up_buf = calloc(IPDBG_MAX_SCANS_PER_POLL, 2);
+	if (!new_hub->connections || !new_hub->scan_fields || !new_hub->scan_dn_words ||
+			!new_hub->scan_dn_buf || !new_hub->scan_up_buf) {
 		free(virtual_ir);
+		free(new_hub->connections);
+		free(new_hub->scan_fields);
+		free(new_hub->scan_dn_words);
+		free(new_hub->scan_dn_buf);
+		free(new_hub->scan_up_buf);
 		free(new_hub);
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
@@ -269,6 +291,10 @@ static void ipdbg_free_hub(struct ipdbg_hub *hub)
 		return;
 	free(hub->connections);
 	free(hub->virtual_ir);
+	free(hub->scan_fields);
+	free(hub->scan_dn_words);
+	free(hub->scan_dn_buf);
+	free(hub->scan_up_buf);
 	free(hub);
 }
 
@@ -410,27 +436,29 @@ static int ipdbg_distribute_data_from_hub(struct ipdbg_hub *hub, uint32_t up)
 	return ERROR_OK;
 }
 
-static int ipdbg_jtag_transfer_byte(struct ipdbg_hub *hub, size_t tool, struct ipdbg_connection *connection)
-{
-	uint32_t dn = hub->valid_mask | ((tool & hub->tool_mask) << 8) |
-				(0x00fful & ipdbg_get_from_fifo(&connection->dn_fifo));
-	uint32_t up = 0;
-	int ret = ipdbg_shift_data(hub, dn, &up);
-	if (ret != ERROR_OK)
-		return ret;
+static int ipdbg_polling_callback(void *priv);
 
-	ret = ipdbg_distribute_data_from_hub(hub, up);
-	if (ret != ERROR_OK)
-		return ret;
+/* Queue a DR scan of the hub, its up data is read after jtag_execute_queue() */
+static void ipdbg_queue_scan(struct ipdbg_hub *hub, unsigned int index, uint32_t dn)
+{
+	struct scan_field *field = &hub->scan_fields[index];
+	uint8_t *dn_buf = hub->scan_dn_buf + 2 * index;
 
-	if ((up & hub->xoff_mask) && (hub->last_dn_tool != hub->max_tools)) {
-		hub->dn_xoff |= BIT(hub->last_dn_tool);
-		LOG_INFO("tool %d sent xoff", hub->last_dn_tool);
-	}
+	hub->scan_dn_words[index] = dn;
+	buf_set_u32(dn_buf, 0, hub->data_register_length, dn);
+	ipdbg_init_scan_field(field, hub->scan_up_buf + 2 * index, hub->data_register_length, dn_buf);
+	jtag_add_dr_scan(hub->tap, 1, field, TAP_IDLE);
+}
 
-	hub->last_dn_tool = tool;
+static int ipdbg_set_polling_interval(struct ipdbg_hub *hub, unsigned int interval)
+{
+	if (interval == hub->polling_interval)
+		return ERROR_OK;
 
-	return ERROR_OK;
+	hub->polling_interval = interval;
+	target_unregister_timer_callback(ipdbg_polling_callback, hub);
+	return target_register_timer_callback(ipdbg_polling_callback, interval,
+		TARGET_TIMER_TYPE_PERIODIC, hub);
 }
 
 static int ipdbg_polling_callback(void *priv)
@@ -445,33 +473,53 @@ static int ipdbg_polling_callback(void *priv)
 	if (ret != ERROR_OK)
 		return ret;
 
-	/* transfer dn buffers to jtag-hub */
-	unsigned int num_transfers = 0;
+	/* queue the dn buffers for the jtag-hub, one scan per byte */
+	unsigned int num_scans = 0;
 	for (size_t tool = 0; tool < hub->max_tools; ++tool) {
 		struct connection *conn = hub->connections[tool];
-		if (conn && conn->priv) {
-			struct ipdbg_connection *connection = conn->priv;
-			while (((hub->dn_xoff & BIT(tool)) == 0) && !ipdbg_fifo_is_empty(&connection->dn_fifo)) {
-				ret = ipdbg_jtag_transfer_byte(hub, tool, connection);
-				if (ret != ERROR_OK)
-					return ret;
-				++num_transfers;
-			}
+		if (!conn || !conn->priv || (hub->dn_xoff & BIT(tool)))
+			continue;
+
+		struct ipdbg_connection *connection = conn->priv;
+		while (!ipdbg_fifo_is_empty(&connection->dn_fifo) && num_scans < IPDBG_MAX_SCANS_PER_POLL) {
+			uint32_t dn = hub->valid_mask | ((tool & hub->tool_mask) << 8) |
+				(0x00fful & ipdbg_get_from_fifo(&connection->dn_fifo));
+			ipdbg_queue_scan(hub, num_scans++, dn);
 		}
 	}
+	const unsigned int num_dn_scans = num_scans;
 
-	/* some transfers to get data from jtag-hub in case there is no dn data */
-	while (num_transfers++ < hub->max_tools) {
-		uint32_t dn = 0;
-		uint32_t up = 0;
+	/* some scans to get data from jtag-hub in case there is no dn data */
+	unsigned int up_scans = MAX(hub->up_scans, hub->max_tools);
+	while (up_scans-- && num_scans < IPDBG_MAX_SCANS_PER_POLL)
+		ipdbg_queue_scan(hub, num_scans++, 0);
+	const unsigned int num_up_scans = num_scans - num_dn_scans;
 
-		int retval = ipdbg_shift_data(hub, dn, &up);
-		if (retval != ERROR_OK)
-			return ret;
+	ret = jtag_execute_queue();
+	if (ret != ERROR_OK)
+		return ret;
+
+	/* the xoff flag of a scan is about the dn data of the scan before */
+	unsigned int num_up_data = 0;
+	for (unsigned int i = 0; i < num_scans; i++) {
+		uint32_t up = buf_get_u32(hub->scan_up_buf + 2 * i, 0, hub->data_register_length);
+
+		if (up & hub->valid_mask)
+			num_up_data++;
 
-		retval = ipdbg_distribute_data_from_hub(hub, up);
-		if (retval != ERROR_OK)
+		ret = ipdbg_distribute_data_from_hub(hub, up);
+		if (ret != ERROR_OK)
 			return ret;
+
+		if (i >= num_dn_scans)
+			continue;
+
+		if ((up & hub->xoff_mask) && hub->last_dn_tool != hub->max_tools) {
+			hub->dn_xoff |= BIT(hub->last_dn_tool);
+			LOG_INFO("tool %d sent xoff", hub->last_dn_tool);
+		}
+
+		hub->last_dn_tool = (hub->scan_dn_words[i] >> 8) & hub->tool_mask;
 	}
 
 	/* write from up fifos to sockets */
@@ -485,7 +533,20 @@ static int ipdbg_polling_callback(void *priv)
 		}
 	}
 
-	return ERROR_OK;
+	/*
+	 * While the hub keeps sending, fetch more per tick and poll sooner;
+	 * back off to the few scans and the long interval once it is idle.
+	 */
+	unsigned int interval = hub->polling_interval;
+	if ((num_up_data && 2 * num_up_data >= num_up_scans) || num_dn_scans == IPDBG_MAX_SCANS_PER_POLL) {
+		hub->up_scans = MIN(2 * MAX(hub->up_scans, 1u), (unsigned int)IPDBG_MAX_SCANS_PER_POLL);
+		interval = IPDBG_MIN_POLLING_INTERVAL;
+	} else if (!num_up_data && !num_dn_scans) {
+		hub->up_scans = hub->max_tools;
+		interval = MIN(interval + interval / 2 + 1, (unsigned int)IPDBG_MAX_POLLING_INTERVAL);
+	}
+
+	return ipdbg_set_polling_interval(hub, interval);
 }
 
 static int ipdbg_start_polling(struct ipdbg_service *service, struct connection *connection)
@@ -516,9 +577,10 @@ static int ipdbg_start_polling(struct ipdbg_service *service, struct connection
 
 	LOG_INFO("IPDBG start_polling");
 
-	const int time_ms = 20;
-	const int periodic = 1;
-	return target_register_timer_callback(ipdbg_polling_callback, time_ms, periodic, hub);
+	hub->up_scans = hub->max_tools;
+	hub->polling_interval = IPDBG_MAX_POLLING_INTERVAL;
+	return target_register_timer_callback(ipdbg_polling_callback, hub->polling_interval,
+		TARGET_TIMER_TYPE_PERIODIC, hub);
 }
 
 static int ipdbg_stop_polling(struct ipdbg_service *service)
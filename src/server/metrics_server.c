@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ *
+ * Metrics server.
+ *
+ * Answers each HTTP request with the metrics of helper/metrics.c in the
+ * Prometheus text format, then closes the connection. The request itself
+ * is not looked at, any path gives the metrics.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/metrics.h>
+
+#include "server.h"
+#include "metrics_server.h"
+
+/* longest request taken, the headers of a scraper are much shorter */
+#define METRICS_REQUEST_MAX		4096
+
+struct metrics_connection {
+	char request[METRICS_REQUEST_MAX];
+	size_t request_len;
+};
+
+static char *metrics_port;
+
+static int metrics_new_connection(struct connection *connection)
+{
+	struct metrics_connection *m_con = calloc(1, sizeof(*m_con));
+	if (!m_con)
+		return ERROR_CONNECTION_REJECTED;
+
+	connection->priv = m_con;
+
+	return ERROR_OK;
+}
+
+static int metrics_connection_closed(struct connection *connection)
+{
+	free(connection->priv);
+	connection->priv = NULL;
+
+	return ERROR_OK;
+}
+
+static int metrics_reply(struct connection *connection)
+{
+	char *body = metrics_prometheus_text();
+	if (!body) {
+		static const char error[] = "HTTP/1.0 500 Internal Server Error\r\n"
+			"Connection: close\r\n\r\n";
+		connection_write(connection, error, strlen(error));
+		return ERROR_FAIL;
+	}
+
+	char *header = alloc_printf("HTTP/1.0 200 OK\r\n"
+			"Content-Type: text/plain; version=0.0.4\r\n"
+			"Content-Length: %zu\r\n"
+			"Connection: close\r\n\r\n", strlen(body));
+	if (header) {
+		connection_write(connection, header, strlen(header));
+		connection_write(connection, body, strlen(body));
+	}
+	free(header);
+	free(body);
+
+	return ERROR_OK;
+}
+
+static int metrics_input(struct connection *connection)
+{
+	struct metrics_connection *m_con = connection->priv;
+	size_t room = sizeof(m_con->request) - m_con->request_len - 1;
+
+	int bytes_read = connection_read(connection,
+			m_con->request + m_con->request_len, room);
+	if (bytes_read <= 0)
+		return ERROR_SERVER_REMOTE_CLOSED;
+
+	m_con->request_len += bytes_read;
+	m_con->request[m_con->request_len] = '\0';
+
+	/* wait for the empty line at the end of the headers */
+	if (!strstr(m_con->request, "\r\n\r\n") && !strstr(m_con->request, "\n\n")) {
+		if (m_con->request_len < sizeof(m_con->request) - 1)
+			return ERROR_OK;
+		LOG_DEBUG("metrics: request too long");
+	}
+
+	metrics_reply(connection);
+	connection_flush(connection);
+
+	/* one request per connection */
+	return ERROR_SERVER_REMOTE_CLOSED;
+}
+
+static const struct service_driver metrics_service_driver = {
+	.name = "metrics",
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = metrics_new_connection,
+	.input_handler = metrics_input,
+	.connection_closed_handler = metrics_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+int metrics_server_init(void)
+{
+	if (strcmp(metrics_port, "disabled") == 0) {
+		LOG_DEBUG("metrics server disabled");
+		return ERROR_OK;
+	}
+
+	if (strcmp(metrics_port, "pipe") == 0) {
+		LOG_ERROR("metrics server can't use a pipe");
+		return ERROR_FAIL;
+	}
+
+	return add_service(&metrics_service_driver, metrics_port,
+			CONNECTION_LIMIT_UNLIMITED, NULL);
+}
+
+COMMAND_HANDLER(handle_metrics_port_command)
+{
+	return CALL_COMMAND_HANDLER(server_pipe_command, &metrics_port);
+}
+
+static const struct command_registration metrics_command_handlers[] = {
+	{
+		.name = "metrics_port",
+		.handler = handle_metrics_port_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Specify port on which to serve the metrics "
+			"in the Prometheus text format. "
+			"Read help on 'gdb_port'.",
+		.usage = "[port_num]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int metrics_server_register_commands(struct command_context *cmd_ctx)
+{
+	metrics_port = strdup("disabled");
+	return register_commands(cmd_ctx, NULL, metrics_command_handlers);
+}
+
+void metrics_service_free(void)
+{
+	free(metrics_port);
+}
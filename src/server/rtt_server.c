@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include <rtt/rtt.h>
+#include <target/target.h>
 
 #include "server.h"
 #include "rtt_server.h"
@@ -23,10 +24,27 @@
  * connections.
  */
 
+/* Input of a client taken at most before it is written into the target */
+#define RTT_INPUT_BUFFER_SIZE	16384
+
 struct rtt_service {
 	unsigned int channel;
 };
 
+/*
+ * The input of a client is collected and written into the down-channel at
+ * once, by a single descriptor read, data write and write pointer update.
+ * While the target buffer has no room for the data, the rest is written at
+ * the next polls and the input of the client is paused once the input buffer
+ * is full, so that TCP blocks the client instead of the data being dropped.
+ */
+struct rtt_connection {
+	uint8_t input[RTT_INPUT_BUFFER_SIZE];
+	size_t length;
+	/* whether the rest of the input is written by write_callback() */
+	bool writing;
+};
+
 static int read_callback(unsigned int channel, const uint8_t *buffer,
 		size_t length, void *user_data)
 {
@@ -51,19 +69,87 @@ static int read_callback(unsigned int channel, const uint8_t *buffer,
 	return ERROR_OK;
 }
 
+static int write_callback(void *user_data);
+
+static int write_input(struct connection *connection)
+{
+	int ret;
+	struct rtt_service *service;
+	struct rtt_connection *rtt_connection;
+	size_t length;
+
+	service = (struct rtt_service *)connection->service->priv;
+	rtt_connection = connection->priv;
+	length = rtt_connection->length;
+
+	ret = rtt_write_channel(service->channel, rtt_connection->input, &length);
+
+	if (ret != ERROR_OK)
+		return ret;
+
+	rtt_connection->length -= length;
+	memmove(rtt_connection->input, rtt_connection->input + length,
+		rtt_connection->length);
+
+	if (rtt_connection->length && !rtt_connection->writing) {
+		unsigned int interval;
+
+		rtt_get_polling_interval(&interval);
+		target_register_timer_callback(&write_callback, interval,
+			TARGET_TIMER_TYPE_PERIODIC, connection);
+		rtt_connection->writing = true;
+	} else if (!rtt_connection->length && rtt_connection->writing) {
+		target_unregister_timer_callback(&write_callback, connection);
+		rtt_connection->writing = false;
+	}
+
+	connection_pause_input(connection,
+		rtt_connection->length == sizeof(rtt_connection->input));
+
+	return ERROR_OK;
+}
+
+static int write_callback(void *user_data)
+{
+	struct connection *connection = user_data;
+
+	if (write_input(connection) != ERROR_OK) {
+		/* drop the input rather than retrying it forever */
+		struct rtt_connection *rtt_connection = connection->priv;
+
+		rtt_connection->length = 0;
+		return write_input(connection);
+	}
+
+	return ERROR_OK;
+}
+
 static int rtt_new_connection(struct connection *connection)
 {
 	int ret;
 	struct rtt_service *service;
+	struct rtt_connection *rtt_connection;
 
 	service = connection->service->priv;
 
 	LOG_DEBUG("rtt: New connection for channel %u", service->channel);
 
+	rtt_connection = malloc(sizeof(*rtt_connection));
+
+	if (!rtt_connection)
+		return ERROR_FAIL;
+
+	rtt_connection->length = 0;
+	rtt_connection->writing = false;
+	connection->priv = rtt_connection;
+
 	ret = rtt_register_sink(service->channel, &read_callback, connection);
 
-	if (ret != ERROR_OK)
+	if (ret != ERROR_OK) {
+		free(rtt_connection);
+		connection->priv = NULL;
 		return ret;
+	}
 
 	return ERROR_OK;
 }
@@ -71,10 +157,19 @@ static int rtt_new_connection(struct connection *connection)
 static int rtt_connection_closed(struct connection *connection)
 {
 	struct rtt_service *service;
+	struct rtt_connection *rtt_connection;
 
 	service = (struct rtt_service *)connection->service->priv;
 	rtt_unregister_sink(service->channel, &read_callback, connection);
 
+	rtt_connection = connection->priv;
+
+	if (rtt_connection && rtt_connection->writing)
+		target_unregister_timer_callback(&write_callback, connection);
+
+	free(rtt_connection);
+	connection->priv = NULL;
+
 	LOG_DEBUG("rtt: Connection for channel %u closed", service->channel);
 
 	return ERROR_OK;
@@ -83,12 +178,17 @@ static int rtt_connection_closed(struct connection *connection)
 static int rtt_input(struct connection *connection)
 {
 	int bytes_read;
-	unsigned char buffer[1024];
-	struct rtt_service *service;
-	size_t length;
+	struct rtt_connection *rtt_connection;
 
-	service = (struct rtt_service *)connection->service->priv;
-	bytes_read = connection_read(connection, buffer, sizeof(buffer));
+	rtt_connection = connection->priv;
+
+	/* paused, for the rest of the last input */
+	if (rtt_connection->length == sizeof(rtt_connection->input))
+		return ERROR_OK;
+
+	bytes_read = connection_read(connection,
+		rtt_connection->input + rtt_connection->length,
+		sizeof(rtt_connection->input) - rtt_connection->length);
 
 	if (!bytes_read)
 		return ERROR_SERVER_REMOTE_CLOSED;
@@ -97,8 +197,16 @@ static int rtt_input(struct connection *connection)
 		return ERROR_SERVER_REMOTE_CLOSED;
 	}
 
-	length = bytes_read;
-	rtt_write_channel(service->channel, buffer, &length);
+	rtt_connection->length += bytes_read;
+
+	/* collected until the next poll while some input is still pending */
+	if (rtt_connection->writing) {
+		connection_pause_input(connection,
+			rtt_connection->length == sizeof(rtt_connection->input));
+		return ERROR_OK;
+	}
+
+	write_input(connection);
 
 	return ERROR_OK;
 }
@@ -110,6 +218,7 @@ static const struct service_driver rtt_service_driver = {
 	.input_handler = rtt_input,
 	.connection_closed_handler = rtt_connection_closed,
 	.keep_client_alive_handler = NULL,
+	.output_overflow = CONNECTION_OVERFLOW_DROP_OLDEST,
 };
 
 COMMAND_HANDLER(handle_rtt_start_command)
@@ -23,6 +23,7 @@
 #include "openocd.h"
 #include "tcl_server.h"
 #include "telnet_server.h"
+#include "metrics_server.h"
 
 #include <signal.h>
 
@@ -34,8 +35,32 @@
 #include <netinet/tcp.h>
 #endif
 
+/* Windows only knows select(), and only for sockets */
+#if defined(HAVE_POLL_H) && !defined(_WIN32)
+#include <poll.h>
+#define SERVER_USE_POLL
+#endif
+
 static struct service *services;
 
+/*
+ * Descriptors server_loop() waits on. The list only changes when a service
+ * or a connection is added or removed, so it is rebuilt then and not on
+ * every iteration of the loop.
+ */
+static bool server_fds_changed = true;
+
+#ifdef SERVER_USE_POLL
+static struct pollfd *server_pollfds;
+static unsigned int server_num_pollfds;
+static unsigned int server_max_pollfds;
+#else
+static fd_set server_read_fds;
+/* select() returns the active descriptors in place of the monitored ones */
+static fd_set server_ready_fds;
+static int server_fd_max;
+#endif
+
 enum shutdown_reason {
 	CONTINUE_MAIN_LOOP,			/* stay in main event loop */
 	SHUTDOWN_REQUESTED,			/* set by shutdown command; exit the event loop and quit the debugger */
@@ -53,6 +78,184 @@ static int polling_period = 100;
 /* address by name on which to listen for incoming TCP/IP connections */
 static char *bindto_name;
 
+#ifdef SERVER_USE_POLL
+/*
+ * Output to TCP clients which the socket does not take right away is
+ * queued and sent from server_loop() and keep_alive(). A client which reads
+ * slowly then no longer blocks the adapter, e.g. during a long flash erase.
+ * Beyond output_queue_size, the output overflow policy of the service
+ * applies.
+ */
+#endif
+static unsigned int output_queue_size = 1024 * 1024;
+
+#ifdef SERVER_USE_POLL
+
+static void connection_want_write(struct connection *c)
+{
+	/* server_update_fds() sets the events itself */
+	if (c->poll_index < 0 || server_fds_changed)
+		return;
+
+	if (c->tx_len > c->tx_head)
+		server_pollfds[c->poll_index].events |= POLLOUT;
+	else
+		server_pollfds[c->poll_index].events &= ~POLLOUT;
+}
+
+/* Write @a len bytes, waiting for the socket to take them if @a block is set */
+static int connection_send(struct connection *c, const uint8_t *data, size_t len, bool block)
+{
+	size_t sent = 0;
+
+	while (sent < len) {
+		ssize_t n = send(c->fd_out, data + sent, len - sent, MSG_DONTWAIT);
+		if (n >= 0) {
+			sent += n;
+			continue;
+		}
+
+		if (errno == EINTR)
+			continue;
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			return -1;
+		if (!block)
+			break;
+
+		struct pollfd pollfd = { .fd = c->fd_out, .events = POLLOUT };
+		if (poll(&pollfd, 1, -1) < 0 && errno != EINTR)
+			return -1;
+	}
+
+	return sent;
+}
+
+static int connection_send_queue(struct connection *c, bool block)
+{
+	if (c->tx_len == c->tx_head)
+		return 0;
+
+	int n = connection_send(c, c->tx_buf + c->tx_head, c->tx_len - c->tx_head, block);
+	if (n < 0) {
+		LOG_DEBUG("error sending to '%s' connection: %s", c->service->name, strerror(errno));
+		c->tx_error = true;
+		c->tx_head = 0;
+		c->tx_len = 0;
+	} else {
+		c->tx_head += n;
+		if (c->tx_head == c->tx_len) {
+			c->tx_head = 0;
+			c->tx_len = 0;
+			c->tx_dropping = false;
+		}
+	}
+	/* the writes queued meanwhile now go out, they must not be dropped either */
+	if (c->tx_head >= c->tx_mark)
+		c->tx_mark = c->tx_len;
+	connection_want_write(c);
+
+	return n < 0 ? -1 : 0;
+}
+
+/* Make room for @a len more bytes in the output queue of a slow client */
+static int connection_overflow(struct connection *c, size_t len)
+{
+	if (c->service->output_overflow == CONNECTION_OVERFLOW_BLOCK)
+		return connection_send_queue(c, true);
+
+	if (!c->tx_dropping) {
+		LOG_WARNING("'%s' connection does not keep up, dropping its output",
+				c->service->name);
+		c->tx_dropping = true;
+	}
+
+	/* the oldest whole writes not yet on their way */
+	c->tx_dropped += c->tx_len - c->tx_mark;
+	metric_add(&c->service->metric_tx_dropped, c->tx_len - c->tx_mark);
+	c->tx_len = c->tx_mark;
+
+	return 0;
+}
+
+static int connection_queue_write(struct connection *c, const uint8_t *data, size_t len)
+{
+	if (c->tx_error)
+		return -1;
+
+	/* keep the order, only send directly when nothing is queued */
+	if (c->tx_len == c->tx_head) {
+		int n = connection_send(c, data, len, false);
+		if (n < 0)
+			return -1;
+		data += n;
+		len -= n;
+		if (!len)
+			return 0;
+		/* the rest of this write is in transmission */
+		c->tx_mark = c->tx_len + len;
+	}
+
+	if (c->tx_len - c->tx_head + len > output_queue_size) {
+		if (connection_overflow(c, len) < 0)
+			return -1;
+
+		if (c->tx_len - c->tx_head + len > output_queue_size) {
+			if (c->service->output_overflow != CONNECTION_OVERFLOW_BLOCK) {
+				c->tx_dropped += len;
+				return 0;
+			}
+			/* wait for the client to take the whole write */
+			if (connection_send(c, data, len, true) < 0)
+				return -1;
+			return 0;
+		}
+	}
+
+	if (c->tx_head > 0) {
+		memmove(c->tx_buf, c->tx_buf + c->tx_head, c->tx_len - c->tx_head);
+		c->tx_len -= c->tx_head;
+		c->tx_mark -= c->tx_head;
+		c->tx_head = 0;
+	}
+
+	if (c->tx_len + len > c->tx_size) {
+		size_t tx_size = MAX(2 * c->tx_size, c->tx_len + len);
+		uint8_t *tx_buf = realloc(c->tx_buf, tx_size);
+		if (!tx_buf) {
+			LOG_ERROR("Out of memory");
+			return -1;
+		}
+		c->tx_buf = tx_buf;
+		c->tx_size = tx_size;
+	}
+
+	memcpy(c->tx_buf + c->tx_len, data, len);
+	c->tx_len += len;
+	connection_want_write(c);
+
+	return 0;
+}
+#endif
+
+int connection_flush(struct connection *connection)
+{
+#ifdef SERVER_USE_POLL
+	if (connection->service->type == CONNECTION_TCP)
+		return connection_send_queue(connection, true) < 0 ? ERROR_FAIL : ERROR_OK;
+#endif
+
+	return ERROR_OK;
+}
+
+void connection_pause_input(struct connection *connection, bool pause)
+{
+	if (connection->input_paused == pause)
+		return;
+
+	connection->input_paused = pause;
+	server_fds_changed = true;
+}
+
 static int add_connection(struct service *service, struct command_context *cmd_ctx)
 {
 	socklen_t address_size;
@@ -67,6 +270,16 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	c->cmd_ctx = copy_command_context(cmd_ctx);
 	c->service = service;
 	c->input_pending = false;
+	c->input_paused = false;
+	c->poll_index = -1;
+	c->tx_buf = NULL;
+	c->tx_head = 0;
+	c->tx_len = 0;
+	c->tx_size = 0;
+	c->tx_mark = 0;
+	c->tx_error = false;
+	c->tx_dropping = false;
+	c->tx_dropped = 0;
 	c->priv = NULL;
 	c->next = NULL;
 
@@ -149,6 +362,10 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	if (service->max_connections != CONNECTION_LIMIT_UNLIMITED)
 		service->max_connections--;
 
+	metric_gauge_add(&service->metric_connections, 1);
+
+	server_fds_changed = true;
+
 	return ERROR_OK;
 }
 
@@ -161,8 +378,13 @@ static int remove_connection(struct service *service, struct connection *connect
 	while ((c = *p)) {
 		if (c->fd == connection->fd) {
 			service->connection_closed(c);
-			if (service->type == CONNECTION_TCP)
+			if (service->type == CONNECTION_TCP) {
+#ifdef SERVER_USE_POLL
+				/* last words, e.g. the reply to "exit", if the client takes them */
+				connection_send_queue(c, false);
+#endif
 				close_socket(c->fd);
+			}
 			else if (service->type == CONNECTION_PIPE) {
 				/* The service will listen to the pipe again */
 				c->service->fd = c->fd;
@@ -172,11 +394,15 @@ static int remove_connection(struct service *service, struct connection *connect
 
 			/* delete connection */
 			*p = c->next;
+			free(c->tx_buf);
 			free(c);
 
 			if (service->max_connections != CONNECTION_LIMIT_UNLIMITED)
 				service->max_connections++;
 
+			metric_gauge_add(&service->metric_connections, -1);
+
+			server_fds_changed = true;
 			break;
 		}
 
@@ -189,6 +415,9 @@ static int remove_connection(struct service *service, struct connection *connect
 
 static void free_service(struct service *c)
 {
+	metric_unregister(&c->metric_connections);
+	metric_unregister(&c->metric_tx_bytes);
+	metric_unregister(&c->metric_tx_dropped);
 	free(c->name);
 	free(c->port);
 	free(c);
@@ -207,12 +436,25 @@ int add_service(const struct service_driver *driver, const char *port,
 	c->port = strdup(port);
 	c->max_connections = 1;	/* Only TCP/IP ports can support more than one connection */
 	c->fd = -1;
+	c->poll_index = -1;
 	c->connections = NULL;
 	c->new_connection_during_keep_alive = driver->new_connection_during_keep_alive_handler;
 	c->new_connection = driver->new_connection_handler;
 	c->input = driver->input_handler;
 	c->connection_closed = driver->connection_closed_handler;
 	c->keep_client_alive = driver->keep_client_alive_handler;
+	c->flush = driver->flush_handler;
+	c->output_overflow = driver->output_overflow;
+	c->metric_connections = (struct metric)METRIC_GAUGE("server_connections",
+			"Open connections of the service");
+	c->metric_tx_bytes = (struct metric)METRIC_COUNTER("server_tx_bytes_total",
+			"Bytes sent to the clients of the service");
+	c->metric_tx_dropped = (struct metric)METRIC_COUNTER("server_tx_dropped_bytes_total",
+			"Bytes dropped because a client of the service did not keep up");
+	metric_set_labels(&c->metric_connections, "service=\"%s\",port=\"%s\"", c->name, c->port);
+	metric_set_labels(&c->metric_tx_bytes, "service=\"%s\",port=\"%s\"", c->name, c->port);
+	metric_set_labels(&c->metric_tx_dropped, "service=\"%s\",port=\"%s\"", c->name, c->port);
+	metric_register(&c->metric_connections);
 	c->priv = priv;
 	c->next = NULL;
 	long portnumber;
@@ -333,6 +575,8 @@ int add_service(const struct service_driver *driver, const char *port,
 		;
 	*p = c;
 
+	server_fds_changed = true;
+
 	return ERROR_OK;
 }
 
@@ -373,6 +617,8 @@ int remove_service(const char *name, const char *port)
 			free(tmp->priv);
 			free_service(tmp);
 
+			server_fds_changed = true;
+
 			return ERROR_OK;
 		}
 	}
@@ -390,32 +636,160 @@ static int remove_services(void)
 
 		remove_connections(c);
 
-		free(c->name);
-
 		if (c->type == CONNECTION_PIPE) {
 			if (c->fd != -1)
 				close(c->fd);
 		}
-		free(c->port);
 		free(c->priv);
 		/* delete service */
-		free(c);
+		free_service(c);
 
 		/* remember the last service for unlinking */
 		c = next;
 	}
 
 	services = NULL;
+	server_fds_changed = true;
+
+#ifdef SERVER_USE_POLL
+	free(server_pollfds);
+	server_pollfds = NULL;
+	server_num_pollfds = 0;
+	server_max_pollfds = 0;
+#endif
 
 	return ERROR_OK;
 }
 
+/* Pass the output collected by the services and queued on to the clients */
+static void server_send_queued(void)
+{
+	for (struct service *s = services; s; s = s->next)
+		if (s->flush)
+			for (struct connection *c = s->connections; c; c = c->next)
+				s->flush(c);
+
+#ifdef SERVER_USE_POLL
+	for (struct service *s = services; s; s = s->next)
+		for (struct connection *c = s->connections; c; c = c->next)
+			if (c->tx_len > c->tx_head)
+				connection_send_queue(c, false);
+#endif
+}
+
 void server_keep_clients_alive(void)
 {
 	for (struct service *s = services; s; s = s->next)
 		if (s->keep_client_alive)
 			for (struct connection *c = s->connections; c; c = c->next)
 				s->keep_client_alive(c);
+
+	server_send_queued();
+}
+
+#ifdef SERVER_USE_POLL
+static int server_add_pollfd(int fd)
+{
+	if (server_num_pollfds == server_max_pollfds) {
+		unsigned int max_pollfds = MAX(2 * server_max_pollfds, 16);
+		struct pollfd *pollfds = realloc(server_pollfds, max_pollfds * sizeof(*pollfds));
+		if (!pollfds) {
+			LOG_ERROR("Out of memory");
+			return -1;
+		}
+		server_pollfds = pollfds;
+		server_max_pollfds = max_pollfds;
+	}
+
+	struct pollfd *pollfd = &server_pollfds[server_num_pollfds];
+	pollfd->fd = fd;
+	pollfd->events = POLLIN;
+	pollfd->revents = 0;
+
+	return server_num_pollfds++;
+}
+#endif
+
+static void server_update_fds(void)
+{
+#ifdef SERVER_USE_POLL
+	server_num_pollfds = 0;
+#else
+	server_fd_max = 0;
+	FD_ZERO(&server_read_fds);
+#endif
+
+	for (struct service *service = services; service; service = service->next) {
+		/* listen for new connections */
+		service->poll_index = -1;
+		if (service->fd != -1) {
+#ifdef SERVER_USE_POLL
+			service->poll_index = server_add_pollfd(service->fd);
+#else
+			FD_SET(service->fd, &server_read_fds);
+			server_fd_max = MAX(server_fd_max, service->fd);
+#endif
+		}
+
+		/* check for activity on the connections */
+		for (struct connection *c = service->connections; c; c = c->next) {
+			c->poll_index = -1;
+			/* the queued output of a paused connection is sent anyway */
+			if (c->fd < 0 || c->input_paused)
+				continue;
+#ifdef SERVER_USE_POLL
+			c->poll_index = server_add_pollfd(c->fd);
+			if (c->poll_index >= 0 && c->tx_len > c->tx_head)
+				server_pollfds[c->poll_index].events |= POLLOUT;
+#else
+			FD_SET(c->fd, &server_read_fds);
+			server_fd_max = MAX(server_fd_max, c->fd);
+#endif
+		}
+	}
+
+	server_fds_changed = false;
+}
+
+static int server_wait_fds(int timeout_ms)
+{
+#ifdef SERVER_USE_POLL
+	return poll(server_pollfds, server_num_pollfds, timeout_ms);
+#else
+	struct timeval tv;
+	tv.tv_sec = 0;
+	tv.tv_usec = timeout_ms * 1000;
+	server_ready_fds = server_read_fds;
+	return socket_select(server_fd_max + 1, &server_ready_fds, NULL, NULL, &tv);
+#endif
+}
+
+/* Forget the activity reported by the last server_wait_fds() */
+static void server_clear_fds(void)
+{
+#ifdef SERVER_USE_POLL
+	for (unsigned int i = 0; i < server_num_pollfds; i++)
+		server_pollfds[i].revents = 0;
+#else
+	FD_ZERO(&server_ready_fds);
+#endif
+}
+
+/*
+ * Once a service or a connection is added or removed, the reported activity
+ * may belong to another descriptor. It is reported again after the update.
+ */
+static bool server_fd_ready(int fd, int poll_index)
+{
+	if (fd < 0 || server_fds_changed)
+		return false;
+
+#ifdef SERVER_USE_POLL
+	return poll_index >= 0
+		&& (server_pollfds[poll_index].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL));
+#else
+	return FD_ISSET(fd, &server_ready_fds);
+#endif
 }
 
 int server_loop(struct command_context *command_context)
@@ -424,10 +798,6 @@ int server_loop(struct command_context *command_context)
 
 	bool poll_ok = true;
 
-	/* used in select() */
-	fd_set read_fds;
-	int fd_max;
-
 	/* used in accept() */
 	int retval;
 
@@ -439,50 +809,28 @@ int server_loop(struct command_context *command_context)
 #endif
 
 	while (shutdown_openocd == CONTINUE_MAIN_LOOP) {
-		/* monitor sockets for activity */
-		fd_max = 0;
-		FD_ZERO(&read_fds);
-
-		/* add service and connection fds to read_fds */
-		for (service = services; service; service = service->next) {
-			if (service->fd != -1) {
-				/* listen for new connections */
-				FD_SET(service->fd, &read_fds);
-
-				if (service->fd > fd_max)
-					fd_max = service->fd;
-			}
+		/* output collected by the last iteration goes out before waiting */
+		server_send_queued();
 
-			if (service->connections) {
-				struct connection *c;
+		/* monitor sockets for activity */
+		if (server_fds_changed)
+			server_update_fds();
 
-				for (c = service->connections; c; c = c->next) {
-					/* check for activity on the connection */
-					FD_SET(c->fd, &read_fds);
-					if (c->fd > fd_max)
-						fd_max = c->fd;
-				}
-			}
-		}
+		int timeout_ms = 0;
+		if (!poll_ok) {
+			/* nothing to do for now, bring the log file up to date */
+			log_flush();
 
-		struct timeval tv;
-		tv.tv_sec = 0;
-		if (poll_ok) {
-			/* we're just polling this iteration, this is faster on embedded
-			 * hosts */
-			tv.tv_usec = 0;
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
-		} else {
-			/* Timeout socket_select() when a target timer expires or every polling_period */
-			int timeout_ms = next_event - timeval_ms();
+			/* Timeout when a target timer expires or every polling_period */
+			timeout_ms = next_event - timeval_ms();
 			if (timeout_ms < 0)
 				timeout_ms = 0;
 			else if (timeout_ms > polling_period)
 				timeout_ms = polling_period;
-			tv.tv_usec = timeout_ms * 1000;
-			/* Only while we're sleeping we'll let others run */
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
 		}
+		/* we're just polling if poll_ok, this is faster on embedded hosts.
+		 * Only while we're sleeping we'll let others run */
+		retval = server_wait_fds(timeout_ms);
 
 		if (retval == -1) {
 #ifdef _WIN32
@@ -490,7 +838,7 @@ int server_loop(struct command_context *command_context)
 			errno = WSAGetLastError();
 
 			if (errno == WSAEINTR)
-				FD_ZERO(&read_fds);
+				server_clear_fds();
 			else {
 				LOG_ERROR("error during select: %s", strerror(errno));
 				return ERROR_FAIL;
@@ -498,9 +846,9 @@ int server_loop(struct command_context *command_context)
 #else
 
 			if (errno == EINTR)
-				FD_ZERO(&read_fds);
+				server_clear_fds();
 			else {
-				LOG_ERROR("error during select: %s", strerror(errno));
+				LOG_ERROR("error while waiting for activity: %s", strerror(errno));
 				return ERROR_FAIL;
 			}
 #endif
@@ -516,7 +864,7 @@ int server_loop(struct command_context *command_context)
 			next_event = target_timer_next_event();
 			process_jim_events(command_context);
 
-			FD_ZERO(&read_fds);	/* eCos leaves read_fds unchanged in this case!  */
+			server_clear_fds();	/* eCos leaves the fds unchanged in this case! */
 
 			/* We timed out/there was nothing to do, timeout rather than poll next time
 			 **/
@@ -533,10 +881,11 @@ int server_loop(struct command_context *command_context)
 		 */
 		poll_ok = poll_ok || target_got_message();
 
+		server_send_queued();
+
 		for (service = services; service; service = service->next) {
 			/* handle new connections on listeners */
-			if ((service->fd != -1)
-				&& (FD_ISSET(service->fd, &read_fds))) {
+			if (server_fd_ready(service->fd, service->poll_index)) {
 				if (service->max_connections != 0)
 					add_connection(service, command_context);
 				else {
@@ -560,7 +909,7 @@ int server_loop(struct command_context *command_context)
 				struct connection *c;
 
 				for (c = service->connections; c; ) {
-					if ((c->fd >= 0 && FD_ISSET(c->fd, &read_fds)) || c->input_pending) {
+					if (server_fd_ready(c->fd, c->poll_index) || c->input_pending) {
 						retval = service->input(c);
 						if (retval != ERROR_OK) {
 							struct connection *next = c->next;
@@ -691,6 +1040,13 @@ int server_init(struct command_context *cmd_ctx)
 		return ret;
 	}
 
+	ret = metrics_server_init();
+
+	if (ret != ERROR_OK) {
+		remove_services();
+		return ret;
+	}
+
 	return ERROR_OK;
 }
 
@@ -713,6 +1069,7 @@ void server_free(void)
 {
 	tcl_service_free();
 	telnet_service_free();
+	metrics_service_free();
 	jsp_service_free();
 
 	free(bindto_name);
@@ -729,22 +1086,83 @@ void exit_on_signal(int sig)
 
 int connection_write(struct connection *connection, const void *data, int len)
 {
+	int retval;
+
 	if (len == 0) {
 		/* successful no-op. Sockets and pipes behave differently here... */
 		return 0;
 	}
-	if (connection->service->type == CONNECTION_TCP)
-		return write_socket(connection->fd_out, data, len);
-	else
-		return write(connection->fd_out, data, len);
+	if (connection->service->type == CONNECTION_TCP) {
+#ifdef SERVER_USE_POLL
+		retval = connection_queue_write(connection, data, len) < 0 ? -1 : len;
+#else
+		retval = write_socket(connection->fd_out, data, len);
+#endif
+	} else {
+		retval = write(connection->fd_out, data, len);
+	}
+
+	if (retval > 0)
+		metric_add(&connection->service->metric_tx_bytes, retval);
+
+	return retval;
 }
 
 int connection_read(struct connection *connection, void *data, int len)
 {
-	if (connection->service->type == CONNECTION_TCP)
+	if (connection->service->type == CONNECTION_TCP) {
+		/* the client may wait for our output before it sends anything */
+		if (connection_flush(connection) != ERROR_OK)
+			return -1;
 		return read_socket(connection->fd, data, len);
-	else
+	} else {
 		return read(connection->fd, data, len);
+	}
+}
+
+int connection_read_nowait(struct connection *connection, void *data, int len)
+{
+	int n;
+
+	if (connection->service->type == CONNECTION_TCP)
+		n = read_socket(connection->fd, data, len);
+	else
+		n = read(connection->fd, data, len);
+
+	if (n > 0)
+		return n;
+	if (n == 0)
+		return -1;
+
+#ifdef _WIN32
+	if (connection->service->type == CONNECTION_TCP && WSAGetLastError() == WSAEWOULDBLOCK)
+		return 0;
+#endif
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+		return 0;
+
+	return -1;
+}
+
+int connection_wait_input(struct connection *connection)
+{
+	if (connection_flush(connection) != ERROR_OK)
+		return ERROR_FAIL;
+
+#ifdef SERVER_USE_POLL
+	struct pollfd pollfd = { .fd = connection->fd, .events = POLLIN };
+	while (poll(&pollfd, 1, -1) < 0)
+		if (errno != EINTR)
+			return ERROR_FAIL;
+#else
+	fd_set read_fds;
+	FD_ZERO(&read_fds);
+	FD_SET(connection->fd, &read_fds);
+	if (socket_select(connection->fd + 1, &read_fds, NULL, NULL, NULL) < 0)
+		return ERROR_FAIL;
+#endif
+
+	return ERROR_OK;
 }
 
 bool openocd_is_shutdown_pending(void)
@@ -799,6 +1217,24 @@ COMMAND_HANDLER(handle_bindto_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_output_queue_size_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int size;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], size);
+		if (!size)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		output_queue_size = size;
+	}
+
+	command_print(CMD, "%u", output_queue_size);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration server_command_handlers[] = {
 	{
 		.name = "shutdown",
@@ -822,6 +1258,14 @@ static const struct command_registration server_command_handlers[] = {
 		.help = "Specify address by name on which to listen for "
 			"incoming TCP/IP connections",
 	},
+	{
+		.name = "output_queue_size",
+		.handler = &handle_output_queue_size_command,
+		.mode = COMMAND_ANY,
+		.usage = "[bytes]",
+		.help = "set or display how much output is queued for a slow "
+			"TCP/IP client",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -839,6 +1283,10 @@ int server_register_commands(struct command_context *cmd_ctx)
 	if (retval != ERROR_OK)
 		return retval;
 
+	retval = metrics_server_register_commands(cmd_ctx);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return register_commands(cmd_ctx, NULL, server_command_handlers);
 }
 
@@ -19,6 +19,7 @@
 #endif
 
 #include <helper/log.h>
+#include <helper/metrics.h>
 #include <helper/replacements.h>
 
 #ifdef HAVE_NETINET_IN_H
@@ -33,6 +34,14 @@ enum connection_type {
 
 #define CONNECTION_LIMIT_UNLIMITED		(-1)
 
+/* what connection_write() does once a slow client lets the output queue fill up */
+enum connection_overflow {
+	/* wait until the client has taken the queued output */
+	CONNECTION_OVERFLOW_BLOCK,
+	/* drop the queued output, for live streams like trace data */
+	CONNECTION_OVERFLOW_DROP_OLDEST,
+};
+
 struct connection {
 	int fd;
 	int fd_out;	/* When using pipes we're writing to a different fd */
@@ -40,6 +49,20 @@ struct connection {
 	struct command_context *cmd_ctx;
 	struct service *service;
 	bool input_pending;
+	/* input is not waited for, the service cannot take more of it for now */
+	bool input_paused;
+	/* slot of fd in the descriptor list of server_loop(), -1 if none */
+	int poll_index;
+	/* output queued by connection_write(), bytes tx_head to tx_len are pending */
+	uint8_t *tx_buf;
+	size_t tx_head;
+	size_t tx_len;
+	size_t tx_size;
+	/* end of the writes in transmission, only the ones after it may be dropped */
+	size_t tx_mark;
+	bool tx_error;
+	bool tx_dropping;
+	uint64_t tx_dropped;
 	void *priv;
 	struct connection *next;
 };
@@ -62,6 +85,13 @@ struct service_driver {
 	int (*connection_closed_handler)(struct connection *connection);
 	/** called periodically to send keep-alive messages on the connection */
 	void (*keep_client_alive_handler)(struct connection *connection);
+	/**
+	 * called on each iteration of the server loop and from keep_alive() to
+	 * write out the output the service collected for the connection
+	 */
+	void (*flush_handler)(struct connection *connection);
+	/** what to do with the output of a client which does not keep up */
+	enum connection_overflow output_overflow;
 };
 
 struct service {
@@ -70,6 +100,8 @@ struct service {
 	char *port;
 	unsigned short portnumber;
 	int fd;
+	/* slot of fd in the descriptor list of server_loop(), -1 if none */
+	int poll_index;
 	struct sockaddr_in sin;
 	int max_connections;
 	struct connection *connections;
@@ -78,6 +110,12 @@ struct service {
 	int (*input)(struct connection *connection);
 	int (*connection_closed)(struct connection *connection);
 	void (*keep_client_alive)(struct connection *connection);
+	void (*flush)(struct connection *connection);
+	enum connection_overflow output_overflow;
+	/* metrics labelled with the name and port of the service */
+	struct metric metric_connections;
+	struct metric metric_tx_bytes;
+	struct metric metric_tx_dropped;
 	void *priv;
 	struct service *next;
 };
@@ -104,6 +142,32 @@ int server_register_commands(struct command_context *context);
 int connection_write(struct connection *connection, const void *data, int len);
 int connection_read(struct connection *connection, void *data, int len);
 
+/**
+ * Read what the client has sent so far, without sending the queued output or
+ * waiting for more. Returns 0 when nothing is there, -1 on an error or once
+ * the client has closed the connection.
+ */
+int connection_read_nowait(struct connection *connection, void *data, int len);
+
+/**
+ * Send the queued output and wait until the client sends something, for a
+ * service which cannot go on without its input.
+ */
+int connection_wait_input(struct connection *connection);
+
+/**
+ * Wait until the output queued by connection_write() is sent. Call it before
+ * waiting for an answer of the client without connection_read().
+ */
+int connection_flush(struct connection *connection);
+
+/**
+ * Stop or resume waiting for input of the client, for a service which cannot
+ * take more of it for now. The client then blocks once its socket buffers are
+ * full, instead of the input being dropped.
+ */
+void connection_pause_input(struct connection *connection, bool pause);
+
 bool openocd_is_shutdown_pending(void);
 
 /**
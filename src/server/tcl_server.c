@@ -16,6 +16,20 @@
 #define TCL_SERVER_VERSION		"TCL Server 0.1"
 #define TCL_LINE_INITIAL		(4*1024)
 #define TCL_LINE_MAX			(4*1024*1024)
+/* room for a script and the payload of write_memory_bin */
+#define TCL_FRAME_MAX			(64 * 1024 * 1024 + TCL_LINE_INITIAL)
+
+/*
+ * By default commands, replies and notifications end with a ctrl-z. With
+ * length framing, each of them is preceded by its length as a 32 bit big
+ * endian number instead, so they can carry any byte. A command frame may
+ * append binary data to the script, after a NUL byte; the script gets it
+ * with tcl_payload.
+ */
+enum tcl_framing {
+	TCL_FRAMING_TERMINATOR,
+	TCL_FRAMING_LENGTH,
+};
 
 struct tcl_connection {
 	int tc_linedrop;
@@ -26,6 +40,16 @@ struct tcl_connection {
 	enum target_state tc_laststate;
 	bool tc_notify;
 	bool tc_trace;
+	enum tcl_framing tc_framing;
+	/* framing set by tcl_framing, used from the next command on */
+	enum tcl_framing tc_framing_next;
+	/* length prefix of the frame being received */
+	uint8_t tc_header[4];
+	int tc_header_len;
+	uint32_t tc_frame_len;
+	/* binary data of the command being run */
+	const char *tc_payload;
+	int tc_payload_len;
 };
 
 static char *tcl_port;
@@ -35,6 +59,22 @@ static int tcl_new_connection(struct connection *connection);
 static int tcl_input(struct connection *connection);
 static int tcl_output(struct connection *connection, const void *buf, ssize_t len);
 static int tcl_closed(struct connection *connection);
+static int tcl_output_frame(struct connection *connection, const void *data, int len);
+static int tcl_input_frames(struct connection *connection, const unsigned char *in, ssize_t rlen);
+
+/* A notification to the client, without the trailing "\r\n\x1a" */
+static void tcl_notify(struct connection *connection, const char *text)
+{
+	struct tcl_connection *tclc = connection->priv;
+
+	if (tclc->tc_framing == TCL_FRAMING_LENGTH) {
+		tcl_output_frame(connection, text, strlen(text));
+		return;
+	}
+
+	if (tcl_output(connection, text, strlen(text)) == ERROR_OK)
+		tcl_output(connection, "\r\n\x1a", 3);
+}
 
 static int tcl_target_callback_event_handler(struct target *target,
 		enum target_event event, void *priv)
@@ -46,15 +86,15 @@ static int tcl_target_callback_event_handler(struct target *target,
 	tclc = connection->priv;
 
 	if (tclc->tc_notify) {
-		snprintf(buf, sizeof(buf), "type target_event event %s\r\n\x1a", target_event_name(event));
-		tcl_output(connection, buf, strlen(buf));
+		snprintf(buf, sizeof(buf), "type target_event event %s", target_event_name(event));
+		tcl_notify(connection, buf);
 	}
 
 	if (tclc->tc_laststate != target->state) {
 		tclc->tc_laststate = target->state;
 		if (tclc->tc_notify) {
-			snprintf(buf, sizeof(buf), "type target_state state %s\r\n\x1a", target_state_name(target));
-			tcl_output(connection, buf, strlen(buf));
+			snprintf(buf, sizeof(buf), "type target_state state %s", target_state_name(target));
+			tcl_notify(connection, buf);
 		}
 	}
 
@@ -71,8 +111,8 @@ static int tcl_target_callback_reset_handler(struct target *target,
 	tclc = connection->priv;
 
 	if (tclc->tc_notify) {
-		snprintf(buf, sizeof(buf), "type target_reset mode %s\r\n\x1a", target_reset_mode_name(reset_mode));
-		tcl_output(connection, buf, strlen(buf));
+		snprintf(buf, sizeof(buf), "type target_reset mode %s", target_reset_mode_name(reset_mode));
+		tcl_notify(connection, buf);
 	}
 
 	return ERROR_OK;
@@ -84,9 +124,8 @@ static int tcl_target_callback_trace_handler(struct target *target,
 	struct connection *connection = priv;
 	struct tcl_connection *tclc;
 	char *header = "type target_trace data ";
-	char *trailer = "\r\n\x1a";
 	size_t hex_len = len * 2 + 1;
-	size_t max_len = hex_len + strlen(header) + strlen(trailer);
+	size_t max_len = hex_len + strlen(header);
 	char *buf, *hex;
 
 	tclc = connection->priv;
@@ -95,8 +134,8 @@ static int tcl_target_callback_trace_handler(struct target *target,
 		hex = malloc(hex_len);
 		buf = malloc(max_len);
 		hexify(hex, data, len, hex_len);
-		snprintf(buf, max_len, "%s%s%s", header, hex, trailer);
-		tcl_output(connection, buf, strlen(buf));
+		snprintf(buf, max_len, "%s%s", header, hex);
+		tcl_notify(connection, buf);
 		free(hex);
 		free(buf);
 	}
@@ -128,6 +167,18 @@ int tcl_output(struct connection *connection, const void *data, ssize_t len)
 	return ERROR_SERVER_REMOTE_CLOSED;
 }
 
+static int tcl_output_frame(struct connection *connection, const void *data, int len)
+{
+	uint8_t header[4];
+
+	h_u32_to_be(header, len);
+	int retval = tcl_output(connection, header, sizeof(header));
+	if (retval != ERROR_OK)
+		return retval;
+
+	return tcl_output(connection, data, len);
+}
+
 /* connections */
 static int tcl_new_connection(struct connection *connection)
 {
@@ -160,32 +211,19 @@ static int tcl_new_connection(struct connection *connection)
 	return ERROR_OK;
 }
 
-static int tcl_input(struct connection *connection)
+/* Commands terminated by ctrl-z */
+static int tcl_input_lines(struct connection *connection, const unsigned char *in, ssize_t rlen)
 {
 	Jim_Interp *interp = (Jim_Interp *)connection->cmd_ctx->interp;
+	struct tcl_connection *tclc = connection->priv;
 	int retval;
-	int i;
-	ssize_t rlen;
 	const char *result;
 	int reslen;
-	struct tcl_connection *tclc;
-	unsigned char in[256];
 	char *tc_line_new;
 	int tc_line_size_new;
 
-	rlen = connection_read(connection, &in, sizeof(in));
-	if (rlen <= 0) {
-		if (rlen < 0)
-			LOG_ERROR("error during read: %s", strerror(errno));
-		return ERROR_SERVER_REMOTE_CLOSED;
-	}
-
-	tclc = connection->priv;
-	if (!tclc)
-		return ERROR_CONNECTION_REJECTED;
-
 	/* push as much data into the line as possible */
-	for (i = 0; i < rlen; i++) {
+	for (ssize_t i = 0; i < rlen; i++) {
 		/* buffer the data */
 		tclc->tc_line[tclc->tc_lineoffset] = in[i];
 		if (tclc->tc_lineoffset + 1 < tclc->tc_line_size) {
@@ -241,11 +279,124 @@ static int tcl_input(struct connection *connection)
 
 		tclc->tc_lineoffset = 0;
 		tclc->tc_linedrop = 0;
+		tclc->tc_framing = tclc->tc_framing_next;
+		if (tclc->tc_framing == TCL_FRAMING_LENGTH)
+			return tcl_input_frames(connection, in + i + 1, rlen - i - 1);
+	}
+
+	return ERROR_OK;
+}
+
+static int tcl_run_frame(struct connection *connection)
+{
+	Jim_Interp *interp = (Jim_Interp *)connection->cmd_ctx->interp;
+	struct tcl_connection *tclc = connection->priv;
+	char *script = tclc->tc_line;
+	int script_len = strnlen(script, tclc->tc_frame_len);
+
+	script[tclc->tc_frame_len] = '\0';
+	if (script_len < (int)tclc->tc_frame_len) {
+		tclc->tc_payload = script + script_len + 1;
+		tclc->tc_payload_len = tclc->tc_frame_len - script_len - 1;
+	}
+
+	/* the caller gets the result, it is not echoed on the console */
+	command_output_handler_t output_handler = connection->cmd_ctx->output_handler;
+	connection->cmd_ctx->output_handler = NULL;
+	command_run_line(connection->cmd_ctx, script);
+	connection->cmd_ctx->output_handler = output_handler;
+
+	tclc->tc_payload = NULL;
+	tclc->tc_payload_len = 0;
+
+	int reslen;
+	const char *result = Jim_GetString(Jim_GetResult(interp), &reslen);
+
+	return tcl_output_frame(connection, result, reslen);
+}
+
+/* Commands preceded by their length */
+static int tcl_input_frames(struct connection *connection, const unsigned char *in, ssize_t rlen)
+{
+	struct tcl_connection *tclc = connection->priv;
+
+	while (rlen > 0) {
+		if (tclc->tc_header_len < (int)sizeof(tclc->tc_header)) {
+			tclc->tc_header[tclc->tc_header_len++] = *in++;
+			rlen--;
+			if (tclc->tc_header_len < (int)sizeof(tclc->tc_header))
+				continue;
+
+			tclc->tc_frame_len = be_to_h_u32(tclc->tc_header);
+			tclc->tc_lineoffset = 0;
+			tclc->tc_linedrop = tclc->tc_frame_len > TCL_FRAME_MAX;
+			if (!tclc->tc_linedrop && (int)tclc->tc_frame_len >= tclc->tc_line_size) {
+				char *tc_line_new = realloc(tclc->tc_line, tclc->tc_frame_len + 1);
+				if (tc_line_new) {
+					tclc->tc_line = tc_line_new;
+					tclc->tc_line_size = tclc->tc_frame_len + 1;
+				} else {
+					tclc->tc_linedrop = 1;
+				}
+			}
+		}
+
+		/* the frame data, skipped if it does not fit */
+		size_t chunk = MIN((size_t)rlen, tclc->tc_frame_len - tclc->tc_lineoffset);
+		if (!tclc->tc_linedrop)
+			memcpy(tclc->tc_line + tclc->tc_lineoffset, in, chunk);
+		tclc->tc_lineoffset += chunk;
+		in += chunk;
+		rlen -= chunk;
+
+		if ((uint32_t)tclc->tc_lineoffset < tclc->tc_frame_len)
+			break;
+
+		int retval;
+		if (tclc->tc_linedrop) {
+#define ESTR "frame too long"
+			retval = tcl_output_frame(connection, ESTR, strlen(ESTR));
+#undef ESTR
+		} else {
+			retval = tcl_run_frame(connection);
+		}
+		if (retval != ERROR_OK)
+			return retval;
+
+		tclc->tc_header_len = 0;
+		tclc->tc_lineoffset = 0;
+		tclc->tc_linedrop = 0;
+		tclc->tc_framing = tclc->tc_framing_next;
+		if (tclc->tc_framing != TCL_FRAMING_LENGTH)
+			return tcl_input_lines(connection, in, rlen);
 	}
 
 	return ERROR_OK;
 }
 
+static int tcl_input(struct connection *connection)
+{
+	ssize_t rlen;
+	struct tcl_connection *tclc;
+	unsigned char in[4096];
+
+	rlen = connection_read(connection, &in, sizeof(in));
+	if (rlen <= 0) {
+		if (rlen < 0)
+			LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	tclc = connection->priv;
+	if (!tclc)
+		return ERROR_CONNECTION_REJECTED;
+
+	if (tclc->tc_framing == TCL_FRAMING_LENGTH)
+		return tcl_input_frames(connection, in, rlen);
+
+	return tcl_input_lines(connection, in, rlen);
+}
+
 static int tcl_closed(struct connection *connection)
 {
 	struct tcl_connection *tclc;
@@ -323,6 +474,65 @@ COMMAND_HANDLER(handle_tcl_trace_command)
 	}
 }
 
+static struct tcl_connection *tcl_get_connection(struct command_context *cmd_ctx)
+{
+	struct connection *connection = cmd_ctx->output_handler_priv;
+
+	if (connection && !strcmp(connection->service->name, "tcl"))
+		return connection->priv;
+
+	return NULL;
+}
+
+COMMAND_HANDLER(handle_tcl_framing_command)
+{
+	struct tcl_connection *tclc = tcl_get_connection(CMD_CTX);
+
+	if (!tclc) {
+		LOG_ERROR("%s: can only be called from the tcl server", CMD_NAME);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (!strcmp(CMD_ARGV[0], "terminator"))
+			tclc->tc_framing_next = TCL_FRAMING_TERMINATOR;
+		else if (!strcmp(CMD_ARGV[0], "length"))
+			tclc->tc_framing_next = TCL_FRAMING_LENGTH;
+		else
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "%s",
+			tclc->tc_framing == TCL_FRAMING_LENGTH ? "length" : "terminator");
+
+	return ERROR_OK;
+}
+
+/* Binary data sent with the command, as a byte string */
+static int jim_tcl_payload(Jim_Interp *interp, int argc, Jim_Obj * const *argv)
+{
+	if (argc != 1) {
+		Jim_WrongNumArgs(interp, 1, argv, "");
+		return JIM_ERR;
+	}
+
+	struct command_context *cmd_ctx = current_command_context(interp);
+	struct tcl_connection *tclc = cmd_ctx ? tcl_get_connection(cmd_ctx) : NULL;
+	if (!tclc) {
+		Jim_SetResultString(interp, "tcl_payload: can only be called from the tcl server", -1);
+		return JIM_ERR;
+	}
+
+	Jim_SetResult(interp, Jim_NewStringObj(interp, tclc->tc_payload ? tclc->tc_payload : "",
+			tclc->tc_payload_len));
+
+	return JIM_OK;
+}
+
 static const struct command_registration tcl_command_handlers[] = {
 	{
 		.name = "tcl_port",
@@ -347,6 +557,21 @@ static const struct command_registration tcl_command_handlers[] = {
 		.help = "Target trace output",
 		.usage = "[on|off]",
 	},
+	{
+		.name = "tcl_framing",
+		.handler = handle_tcl_framing_command,
+		.mode = COMMAND_EXEC,
+		.help = "end commands and replies with ctrl-z, or send the "
+			"length of each in front of it",
+		.usage = "[terminator|length]",
+	},
+	{
+		.name = "tcl_payload",
+		.jim_handler = jim_tcl_payload,
+		.mode = COMMAND_EXEC,
+		.help = "binary data sent after the script of a length framed command",
+		.usage = "",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
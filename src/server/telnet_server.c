@@ -19,9 +19,14 @@
 #include <target/target_request.h>
 #include <helper/configuration.h>
 #include <helper/list.h>
+#include <helper/time_support.h>
 
 static char *telnet_port;
 
+/* defaults of the sessions, see telnet_log_level and telnet_log_rate */
+static int telnet_log_level = LOG_LVL_INFO;
+static unsigned int telnet_log_rate;
+
 static char *negotiate =
 	"\xFF\xFB\x03"			/* IAC WILL Suppress Go Ahead */
 	"\xFF\xFB\x01"			/* IAC WILL Echo */
@@ -35,19 +40,55 @@ static char *negotiate =
  * we write to it, we will fail. Subsequent write operations will
  * succeed. Shudder!
  */
-static int telnet_write(struct connection *connection, const void *data,
-	int len)
+static int telnet_send(struct connection *connection, const void *data,
+	size_t len)
 {
 	struct telnet_connection *t_con = connection->priv;
 	if (t_con->closed)
 		return ERROR_SERVER_REMOTE_CLOSED;
 
-	if (connection_write(connection, data, len) == len)
+	if (connection_write(connection, data, len) == (int)len)
 		return ERROR_OK;
 	t_con->closed = true;
 	return ERROR_SERVER_REMOTE_CLOSED;
 }
 
+/* Write out the output collected by telnet_write() */
+static void telnet_flush(struct connection *connection)
+{
+	struct telnet_connection *t_con = connection->priv;
+
+	if (!t_con->output_len)
+		return;
+
+	telnet_send(connection, t_con->output, t_con->output_len);
+	t_con->output_len = 0;
+}
+
+/*
+ * Collect the output, e.g. the echo of the characters typed, the command
+ * output and the log messages, into larger writes. It goes out at the end
+ * of telnet_input() and from the server loop and keep_alive().
+ */
+static int telnet_write(struct connection *connection, const void *data,
+	int len)
+{
+	struct telnet_connection *t_con = connection->priv;
+	if (t_con->closed)
+		return ERROR_SERVER_REMOTE_CLOSED;
+
+	if (t_con->output_len + len > TELNET_OUTPUT_SIZE)
+		telnet_flush(connection);
+
+	if (len > TELNET_OUTPUT_SIZE)
+		return telnet_send(connection, data, len);
+
+	memcpy(t_con->output + t_con->output_len, data, len);
+	t_con->output_len += len;
+
+	return t_con->closed ? ERROR_SERVER_REMOTE_CLOSED : ERROR_OK;
+}
+
 /* output an audible bell */
 static int telnet_bell(struct connection *connection)
 {
@@ -93,10 +134,9 @@ static int telnet_output(struct command_context *cmd_ctx, const char *line)
 	return telnet_outputline(connection, line);
 }
 
-static void telnet_log_callback(void *priv, const char *file, unsigned line,
-	const char *function, const char *string)
+/* Show a log message, the command line being edited is put back after it */
+static void telnet_log_output(struct connection *connection, const char *string)
 {
-	struct connection *connection = priv;
 	struct telnet_connection *t_con = connection->priv;
 	size_t i;
 	size_t tmp;
@@ -131,6 +171,57 @@ static void telnet_log_callback(void *priv, const char *file, unsigned line,
 		telnet_write(connection, "\b", 1);
 }
 
+/* Tell about the log messages dropped by the rate limit, once its window is over */
+static void telnet_log_dropped(struct connection *connection, int64_t now)
+{
+	struct telnet_connection *t_con = connection->priv;
+
+	if (now - t_con->log_window_start < 1000)
+		return;
+
+	t_con->log_window_start = now;
+	t_con->log_window_count = 0;
+
+	if (!t_con->log_dropped)
+		return;
+
+	char msg[64];
+	snprintf(msg, sizeof(msg), "%u log messages dropped\n", t_con->log_dropped);
+	t_con->log_dropped = 0;
+	telnet_log_output(connection, msg);
+}
+
+/* @returns false if the rate limit or level of the session hide the message */
+static bool telnet_log_shown(struct connection *connection, enum log_levels level)
+{
+	struct telnet_connection *t_con = connection->priv;
+
+	if (level > t_con->log_level)
+		return false;
+
+	if (!t_con->log_rate)
+		return true;
+
+	telnet_log_dropped(connection, timeval_ms());
+
+	if (t_con->log_window_count >= t_con->log_rate) {
+		t_con->log_dropped++;
+		return false;
+	}
+	t_con->log_window_count++;
+
+	return true;
+}
+
+static void telnet_log_callback(void *priv, enum log_levels level, const char *file,
+	unsigned int line, const char *function, const char *string)
+{
+	struct connection *connection = priv;
+
+	if (telnet_log_shown(connection, level))
+		telnet_log_output(connection, string);
+}
+
 static void telnet_load_history(struct telnet_connection *t_con)
 {
 	FILE *histfp;
@@ -225,6 +316,9 @@ static int telnet_new_connection(struct connection *connection)
 	telnet_connection->prompt = strdup("> ");
 	telnet_connection->prompt_visible = true;
 	telnet_connection->state = TELNET_STATE_DATA;
+	telnet_connection->log_level = telnet_log_level;
+	telnet_connection->log_rate = telnet_log_rate;
+	telnet_connection->log_window_start = timeval_ms();
 
 	/* output goes through telnet connection */
 	command_set_output_handler(connection->cmd_ctx, telnet_output, connection);
@@ -747,7 +841,7 @@ static void telnet_auto_complete(struct connection *connection)
 	Jim_DecrRefCount(command_context->interp, list);
 }
 
-static int telnet_input(struct connection *connection)
+static int telnet_input_data(struct connection *connection)
 {
 	int bytes_read;
 	unsigned char buffer[TELNET_BUFFER_SIZE];
@@ -903,12 +997,34 @@ static int telnet_input(struct connection *connection)
 	return ERROR_OK;
 }
 
+static int telnet_input(struct connection *connection)
+{
+	int retval = telnet_input_data(connection);
+
+	/* the echo, the command output and its log in as few writes as possible */
+	telnet_flush(connection);
+
+	return retval;
+}
+
+/* Write out the output collected during a command or between two inputs */
+static void telnet_flush_handler(struct connection *connection)
+{
+	struct telnet_connection *t_con = connection->priv;
+
+	if (t_con->log_dropped)
+		telnet_log_dropped(connection, timeval_ms());
+
+	telnet_flush(connection);
+}
+
 static int telnet_connection_closed(struct connection *connection)
 {
 	struct telnet_connection *t_con = connection->priv;
 	int i;
 
 	log_remove_callback(telnet_log_callback, connection);
+	telnet_flush(connection);
 
 	free(t_con->prompt);
 	t_con->prompt = NULL;
@@ -937,6 +1053,7 @@ static const struct service_driver telnet_service_driver = {
 	.input_handler = telnet_input,
 	.connection_closed_handler = telnet_connection_closed,
 	.keep_client_alive_handler = NULL,
+	.flush_handler = telnet_flush_handler,
 };
 
 int telnet_init(char *banner)
@@ -978,6 +1095,58 @@ COMMAND_HANDLER(handle_exit_command)
 	return ERROR_COMMAND_CLOSE_CONNECTION;
 }
 
+/* @returns the telnet session running the command, NULL if none */
+static struct telnet_connection *telnet_get_connection(struct command_context *cmd_ctx)
+{
+	struct connection *connection = cmd_ctx->output_handler_priv;
+
+	if (connection && !strcmp(connection->service->name, "telnet"))
+		return connection->priv;
+
+	return NULL;
+}
+
+COMMAND_HANDLER(handle_telnet_log_level_command)
+{
+	struct telnet_connection *t_con = telnet_get_connection(CMD_CTX);
+	int *level = t_con ? &t_con->log_level : &telnet_log_level;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		int new_level;
+		COMMAND_PARSE_NUMBER(int, CMD_ARGV[0], new_level);
+		/* debug messages are never forwarded to the sessions */
+		if (new_level < LOG_LVL_SILENT || new_level > LOG_LVL_INFO) {
+			command_print(CMD, "level must be between %d and %d",
+					LOG_LVL_SILENT, LOG_LVL_INFO);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		*level = new_level;
+	}
+
+	command_print(CMD, "%d", *level);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_telnet_log_rate_command)
+{
+	struct telnet_connection *t_con = telnet_get_connection(CMD_CTX);
+	unsigned int *rate = t_con ? &t_con->log_rate : &telnet_log_rate;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], *rate);
+
+	command_print(CMD, "%u", *rate);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration telnet_command_handlers[] = {
 	{
 		.name = "exit",
@@ -995,6 +1164,24 @@ static const struct command_registration telnet_command_handlers[] = {
 			"Read help on 'gdb_port'.",
 		.usage = "[port_num]",
 	},
+	{
+		.name = "telnet_log_level",
+		.handler = handle_telnet_log_level_command,
+		.mode = COMMAND_ANY,
+		.help = "Set or display the most verbose level of the log messages "
+			"shown in this telnet session, or of new sessions if not "
+			"used from a telnet session.",
+		.usage = "[number]",
+	},
+	{
+		.name = "telnet_log_rate",
+		.handler = handle_telnet_log_rate_command,
+		.mode = COMMAND_ANY,
+		.help = "Set or display the number of log messages per second "
+			"shown at most in this telnet session, or in new sessions "
+			"if not used from a telnet session. 0 means no limit.",
+		.usage = "[messages_per_second]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
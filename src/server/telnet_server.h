@@ -20,6 +20,7 @@
 
 #define TELNET_LINE_HISTORY_SIZE (128)
 #define TELNET_LINE_MAX_SIZE (10*256)
+#define TELNET_OUTPUT_SIZE (16 * 1024)
 
 enum telnet_states {
 	TELNET_STATE_DATA,
@@ -45,6 +46,16 @@ struct telnet_connection {
 	size_t next_history;
 	size_t current_history;
 	bool closed;
+	/* output collected for a single write, see telnet_flush() */
+	char output[TELNET_OUTPUT_SIZE];
+	size_t output_len;
+	/* log messages less severe than log_level are not shown */
+	int log_level;
+	/* at most log_rate log messages per second are shown, 0 for no limit */
+	unsigned int log_rate;
+	int64_t log_window_start;
+	unsigned int log_window_count;
+	unsigned int log_dropped;
 };
 
 struct telnet_service {
@@ -202,8 +202,11 @@ struct svf_check_tdo_para {
 };
 
 #define SVF_CHECK_TDO_PARA_SIZE 1024
+/* the scans queued before a commit, each one takes memory in the JTAG queue */
+#define SVF_MAX_CHECK_TDO_PARA_TO_COMMIT (16 * 1024)
 static struct svf_check_tdo_para *svf_check_tdo_para;
 static int svf_check_tdo_para_index;
+static int svf_check_tdo_para_size;
 
 static int svf_read_command_from_file(FILE *fd);
 static int svf_check_tdo(void);
@@ -219,6 +222,11 @@ static size_t svf_command_buffer_size;
 static int svf_line_number;
 static int svf_getline(char **lineptr, size_t *n, FILE *stream);
 
+/* the file is read in chunks, svf_getline() takes the lines out of them */
+#define SVF_READ_CHUNK_SIZE (64 * 1024)
+static char *svf_read_buf;
+static size_t svf_read_buf_pos, svf_read_buf_len;
+
 #define SVF_MAX_BUFFER_SIZE_TO_COMMIT   (1024 * 1024)
 static uint8_t *svf_tdi_buffer, *svf_tdo_buffer, *svf_mask_buffer;
 static int svf_buffer_index, svf_buffer_size;
@@ -466,6 +474,8 @@ COMMAND_HANDLER(handle_svf_command)
 
 		default:
 			svf_fd = fopen(CMD_ARGV[i], "r");
+			svf_read_buf_pos = 0;
+			svf_read_buf_len = 0;
 			if (!svf_fd) {
 				int err = errno;
 				command_print(CMD, "open(\"%s\"): %s", CMD_ARGV[i], strerror(err));
@@ -489,6 +499,7 @@ COMMAND_HANDLER(handle_svf_command)
 
 	svf_check_tdo_para_index = 0;
 	svf_check_tdo_para = malloc(sizeof(struct svf_check_tdo_para) * SVF_CHECK_TDO_PARA_SIZE);
+	svf_check_tdo_para_size = SVF_CHECK_TDO_PARA_SIZE;
 	if (!svf_check_tdo_para) {
 		LOG_ERROR("not enough memory");
 		ret = ERROR_FAIL;
@@ -562,11 +573,11 @@ COMMAND_HANDLER(handle_svf_command)
 
 	if (svf_progress_enabled) {
 		/* Count total lines in file. */
-		while (!feof(svf_fd)) {
-			svf_getline(&svf_command_buffer, &svf_command_buffer_size, svf_fd);
+		while (svf_getline(&svf_command_buffer, &svf_command_buffer_size, svf_fd) > 0)
 			svf_total_lines++;
-		}
 		rewind(svf_fd);
+		svf_read_buf_pos = 0;
+		svf_read_buf_len = 0;
 	}
 	while (svf_read_command_from_file(svf_fd) == ERROR_OK) {
 		/* Log Output */
@@ -618,12 +629,16 @@ free_all:
 	svf_fd = NULL;
 
 	/* free buffers */
+	free(svf_read_buf);
+	svf_read_buf = NULL;
+
 	free(svf_command_buffer);
 	svf_command_buffer = NULL;
 	svf_command_buffer_size = 0;
 
 	free(svf_check_tdo_para);
 	svf_check_tdo_para = NULL;
+	svf_check_tdo_para_size = 0;
 	svf_check_tdo_para_index = 0;
 
 	free(svf_tdi_buffer);
@@ -660,7 +675,7 @@ free_all:
 
 static int svf_getline(char **lineptr, size_t *n, FILE *stream)
 {
-#define MIN_CHUNK 16	/* Buffer is increased by this size each time as required */
+#define MIN_CHUNK 16	/* Buffer is increased at least by this size each time as required */
 	size_t i = 0;
 
 	if (!*lineptr) {
@@ -670,22 +685,48 @@ static int svf_getline(char **lineptr, size_t *n, FILE *stream)
 			return -1;
 	}
 
-	(*lineptr)[0] = fgetc(stream);
-	while ((*lineptr)[i] != '\n') {
-		(*lineptr)[++i] = fgetc(stream);
-		if (feof(stream)) {
-			(*lineptr)[0] = 0;
+	if (!svf_read_buf) {
+		svf_read_buf = malloc(SVF_READ_CHUNK_SIZE);
+		if (!svf_read_buf)
 			return -1;
+	}
+
+	while (true) {
+		if (svf_read_buf_pos == svf_read_buf_len) {
+			svf_read_buf_pos = 0;
+			svf_read_buf_len = fread(svf_read_buf, 1, SVF_READ_CHUNK_SIZE, stream);
+			if (!svf_read_buf_len) {
+				/* a last line without end is dropped */
+				(*lineptr)[0] = 0;
+				return -1;
+			}
 		}
-		if ((i + 2) > *n) {
-			*n += MIN_CHUNK;
-			*lineptr = realloc(*lineptr, *n);
+
+		const char *start = svf_read_buf + svf_read_buf_pos;
+		size_t avail = svf_read_buf_len - svf_read_buf_pos;
+		const char *end = memchr(start, '\n', avail);
+		size_t len = end ? (size_t)(end - start) + 1 : avail;
+
+		if (i + len + 1 > *n) {
+			size_t size = MAX(2 * *n, i + len + MIN_CHUNK);
+			char *line = realloc(*lineptr, size);
+			if (!line)
+				return -1;
+			*lineptr = line;
+			*n = size;
 		}
+
+		memcpy(*lineptr + i, start, len);
+		i += len;
+		svf_read_buf_pos += len;
+
+		if (end)
+			break;
 	}
 
-	(*lineptr)[++i] = 0;
+	(*lineptr)[i] = 0;
 
-	return sizeof(*lineptr);
+	return i;
 }
 
 #define SVFP_CMD_INC_CNT 1024
@@ -749,8 +790,9 @@ static int svf_read_command_from_file(FILE *fd)
 				 *  - terminating NUL ('\0')
 				 */
 				if (cmd_pos + 3 > svf_command_buffer_size) {
-					svf_command_buffer = realloc(svf_command_buffer, cmd_pos + 3);
-					svf_command_buffer_size = cmd_pos + 3;
+					/* grow in steps, the bit strings of a command can be megabytes */
+					svf_command_buffer_size = MAX(2 * svf_command_buffer_size, cmd_pos + 3);
+					svf_command_buffer = realloc(svf_command_buffer, svf_command_buffer_size);
 					if (!svf_command_buffer) {
 						LOG_ERROR("not enough memory");
 						return ERROR_FAIL;
@@ -861,6 +903,13 @@ static int svf_set_padding(struct svf_xxr_para *para, int len, unsigned char tdi
 	return error;
 }
 
+/* the value of an (upper case) hex digit plus one, 0 for the other characters */
+static const uint8_t svf_hex_digit[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
 static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_len, int bit_len)
 {
 	int i, str_len = strlen(str), str_hbyte_len = (bit_len + 3) >> 2;
@@ -875,7 +924,13 @@ static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_l
 	for (i = 0; i < str_hbyte_len; i++) {
 		ch = 0;
 		while (str_len > 0) {
-			ch = str[--str_len];
+			uint8_t c = str[--str_len];
+			uint8_t digit = svf_hex_digit[c];
+
+			if (digit) {
+				ch = digit - 1;
+				break;
+			}
 
 			/* Skip whitespace.  The SVF specification (rev E) is
 			 * deficient in terms of basic lexical issues like
@@ -883,20 +938,10 @@ static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_l
 			 * require line ends for correctness, since there is
 			 * a hard limit on line length.
 			 */
-			if (!isspace(ch)) {
-				if ((ch >= '0') && (ch <= '9')) {
-					ch = ch - '0';
-					break;
-				} else if ((ch >= 'A') && (ch <= 'F')) {
-					ch = ch - 'A' + 10;
-					break;
-				} else {
-					LOG_ERROR("invalid hex string");
-					return ERROR_FAIL;
-				}
+			if (!isspace(c)) {
+				LOG_ERROR("invalid hex string");
+				return ERROR_FAIL;
 			}
-
-			ch = 0;
 		}
 
 		/* write bin */
@@ -926,16 +971,38 @@ static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_l
 
 static int svf_check_tdo(void)
 {
-	int i, len, index_var;
+	int i, j, len, index_var;
+
+	for (i = 0; i < svf_check_tdo_para_index; i = j) {
+		if (!svf_check_tdo_para[i].enabled) {
+			j = i + 1;
+			continue;
+		}
 
-	for (i = 0; i < svf_check_tdo_para_index; i++) {
+		/*
+		 * The checks of a run of scans follow each other in the buffers,
+		 * without the bits beyond their length in the mask. Compare them
+		 * at once and only look at the single scans for a mismatch.
+		 */
 		index_var = svf_check_tdo_para[i].buffer_offset;
 		len = svf_check_tdo_para[i].bit_len;
-		if ((svf_check_tdo_para[i].enabled)
-				&& buf_cmp_mask(&svf_tdi_buffer[index_var], &svf_tdo_buffer[index_var],
-				&svf_mask_buffer[index_var], len)) {
+		for (j = i + 1; j < svf_check_tdo_para_index && svf_check_tdo_para[j].enabled &&
+				svf_check_tdo_para[j].buffer_offset == index_var + ((len + 7) >> 3); j++)
+			len = 8 * (svf_check_tdo_para[j].buffer_offset - index_var) + svf_check_tdo_para[j].bit_len;
+
+		if (!buf_cmp_mask(&svf_tdi_buffer[index_var], &svf_tdo_buffer[index_var],
+				&svf_mask_buffer[index_var], len))
+			continue;
+
+		for (int k = i; k < j; k++) {
+			index_var = svf_check_tdo_para[k].buffer_offset;
+			len = svf_check_tdo_para[k].bit_len;
+			if (!buf_cmp_mask(&svf_tdi_buffer[index_var], &svf_tdo_buffer[index_var],
+					&svf_mask_buffer[index_var], len))
+				continue;
+
 			LOG_ERROR("tdo check error at line %d",
-				svf_check_tdo_para[i].line_num);
+				svf_check_tdo_para[k].line_num);
 			SVF_BUF_LOG(ERROR, &svf_tdi_buffer[index_var], len, "READ");
 			SVF_BUF_LOG(ERROR, &svf_tdo_buffer[index_var], len, "WANT");
 			SVF_BUF_LOG(ERROR, &svf_mask_buffer[index_var], len, "MASK");
@@ -953,11 +1020,21 @@ static int svf_check_tdo(void)
 
 static int svf_add_check_para(uint8_t enabled, int buffer_offset, int bit_len)
 {
-	if (svf_check_tdo_para_index >= SVF_CHECK_TDO_PARA_SIZE) {
-		LOG_ERROR("toooooo many operation undone");
-		return ERROR_FAIL;
+	if (svf_check_tdo_para_index >= svf_check_tdo_para_size) {
+		int size = 2 * svf_check_tdo_para_size;
+		struct svf_check_tdo_para *para = realloc(svf_check_tdo_para, size * sizeof(*para));
+		if (!para) {
+			LOG_ERROR("not enough memory");
+			return ERROR_FAIL;
+		}
+		svf_check_tdo_para = para;
+		svf_check_tdo_para_size = size;
 	}
 
+	/* svf_check_tdo() compares the bits beyond the length along with the next scan */
+	if (enabled && (bit_len % 8))
+		svf_mask_buffer[buffer_offset + bit_len / 8] &= (1 << (bit_len % 8)) - 1;
+
 	svf_check_tdo_para[svf_check_tdo_para_index].line_num = svf_line_number;
 	svf_check_tdo_para[svf_check_tdo_para_index].bit_len = bit_len;
 	svf_check_tdo_para[svf_check_tdo_para_index].enabled = enabled;
@@ -1262,9 +1339,11 @@ xxr_common:
 							svf_para.tdr_para.len);
 					i += svf_para.tdr_para.len;
 
-					svf_add_check_para(1, svf_buffer_index, i);
-				} else
-					svf_add_check_para(0, svf_buffer_index, i);
+					if (svf_add_check_para(1, svf_buffer_index, i) != ERROR_OK)
+						return ERROR_FAIL;
+				} else if (svf_add_check_para(0, svf_buffer_index, i) != ERROR_OK) {
+					return ERROR_FAIL;
+				}
 				field.num_bits = i;
 				field.out_value = &svf_tdi_buffer[svf_buffer_index];
 				field.in_value = (xxr_para_tmp->data_mask & XXR_TDO) ? &svf_tdi_buffer[svf_buffer_index] : NULL;
@@ -1355,9 +1434,11 @@ xxr_common:
 							svf_para.tir_para.len);
 					i += svf_para.tir_para.len;
 
-					svf_add_check_para(1, svf_buffer_index, i);
-				} else
-					svf_add_check_para(0, svf_buffer_index, i);
+					if (svf_add_check_para(1, svf_buffer_index, i) != ERROR_OK)
+						return ERROR_FAIL;
+				} else if (svf_add_check_para(0, svf_buffer_index, i) != ERROR_OK) {
+					return ERROR_FAIL;
+				}
 				field.num_bits = i;
 				field.out_value = &svf_tdi_buffer[svf_buffer_index];
 				field.in_value = (xxr_para_tmp->data_mask & XXR_TDO) ? &svf_tdi_buffer[svf_buffer_index] : NULL;
@@ -1620,7 +1701,7 @@ xxr_common:
 		/* for fast executing, execute tap if necessary */
 		/* half of the buffer is for the next command */
 		if (((svf_buffer_index >= SVF_MAX_BUFFER_SIZE_TO_COMMIT) ||
-				(svf_check_tdo_para_index >= SVF_CHECK_TDO_PARA_SIZE / 2)) &&
+				(svf_check_tdo_para_index >= SVF_MAX_CHECK_TDO_PARA_TO_COMMIT)) &&
 				(((command != STATE) && (command != RUNTEST)) ||
 						((command == STATE) && (num_of_argu == 2))))
 			return svf_execute_tap();
@@ -21,6 +21,7 @@
 #include "arm_semihosting.h"
 #include "jtag/interface.h"
 #include "smp.h"
+#include <helper/align.h>
 #include <helper/time_support.h>
 
 enum restart_mode {
@@ -28,6 +29,10 @@ enum restart_mode {
 	RESTART_SYNC,
 };
 
+/* software breakpoints closer than the gap, within a range, are written at once */
+#define AARCH64_BKPT_RANGE_SIZE		4096
+#define AARCH64_BKPT_RANGE_GAP		64
+
 enum halt_mode {
 	HALT_LAZY,
 	HALT_SYNC,
@@ -318,6 +323,71 @@ static int aarch64_wait_halt_one(struct target *target)
 	return retval;
 }
 
+static unsigned int aarch64_smp_count(struct target *target)
+{
+	struct target_list *head;
+	unsigned int count = 0;
+
+	foreach_smp_target(head, target->smp_targets)
+		count++;
+
+	return count;
+}
+
+/*
+ * Read PRSR of all the examined PEs of the SMP group, in the order of the
+ * group. The reads are queued and the queue of each DAP is run once, to
+ * collect the state of the group in one round trip.
+ */
+static int aarch64_read_prsr_smp(struct target *target, uint32_t *prsr)
+{
+	struct target_list *head, *prev;
+	unsigned int i = 0;
+	int retval = ERROR_OK;
+
+	foreach_smp_target(head, target->smp_targets) {
+		struct target *curr = head->target;
+		struct armv8_common *armv8 = target_to_armv8(curr);
+
+		prsr[i++] = 0;
+		if (!target_was_examined(curr))
+			continue;
+
+		int retval1 = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_PRSR, &prsr[i - 1]);
+		if (retval == ERROR_OK)
+			retval = retval1;
+	}
+
+	foreach_smp_target(head, target->smp_targets) {
+		struct target *curr = head->target;
+		struct adiv5_dap *dap;
+		bool done = false;
+
+		if (!target_was_examined(curr))
+			continue;
+
+		dap = target_to_armv8(curr)->debug_ap->dap;
+		foreach_smp_target(prev, target->smp_targets) {
+			if (prev == head)
+				break;
+			if (target_was_examined(prev->target) &&
+					target_to_armv8(prev->target)->debug_ap->dap == dap) {
+				done = true;
+				break;
+			}
+		}
+		if (done)
+			continue;
+
+		int retval1 = dap_run(dap);
+		if (retval == ERROR_OK)
+			retval = retval1;
+	}
+
+	return retval;
+}
+
 static int aarch64_prepare_halt_smp(struct target *target, bool exc_target, struct target **p_first)
 {
 	int retval = ERROR_OK;
@@ -411,28 +481,33 @@ static int aarch64_halt_smp(struct target *target, bool exc_target)
 		return retval;
 
 	/* wait for all PEs to halt */
+	uint32_t *prsr = calloc(aarch64_smp_count(target), sizeof(*prsr));
+	if (!prsr) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
 	int64_t then = timeval_ms();
 	for (;;) {
-		bool all_halted = true;
+		struct target *pending = NULL;
 		struct target_list *head;
-		struct target *curr;
-
-		foreach_smp_target(head, target->smp_targets) {
-			int halted;
+		unsigned int i = 0;
 
-			curr = head->target;
+		retval = aarch64_read_prsr_smp(target, prsr);
+		if (retval != ERROR_OK)
+			break;
 
-			if (!target_was_examined(curr))
-				continue;
+		foreach_smp_target(head, target->smp_targets) {
+			struct target *curr = head->target;
 
-			retval = aarch64_check_state_one(curr, PRSR_HALT, PRSR_HALT, &halted, NULL);
-			if (retval != ERROR_OK || !halted) {
-				all_halted = false;
+			if (target_was_examined(curr) && !(prsr[i] & PRSR_HALT)) {
+				pending = curr;
 				break;
 			}
+			i++;
 		}
 
-		if (all_halted)
+		if (!pending)
 			break;
 
 		if (timeval_ms() > then + 1000) {
@@ -447,11 +522,12 @@ static int aarch64_halt_smp(struct target *target, bool exc_target)
 		 * cluster explicitly. So if we find that a core has not halted
 		 * yet, we trigger an explicit halt for the second cluster.
 		 */
-		retval = aarch64_halt_one(curr, HALT_LAZY);
+		retval = aarch64_halt_one(pending, HALT_LAZY);
 		if (retval != ERROR_OK)
 			break;
 	}
 
+	free(prsr);
 	return retval;
 }
 
@@ -722,6 +798,80 @@ static int aarch64_restart_one(struct target *target, enum restart_mode mode)
 	return retval;
 }
 
+/*
+ * Wait for all the PEs of the SMP group but the target to restart, after
+ * the restart event of the target went through the trigger matrix.
+ */
+static int aarch64_wait_restart_smp(struct target *target)
+{
+	unsigned int count = aarch64_smp_count(target);
+	int retval = ERROR_OK;
+
+	uint32_t *prsr = calloc(count, sizeof(*prsr));
+	if (!prsr) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int64_t then = timeval_ms();
+	for (;;) {
+		struct target *pending = NULL;
+		struct target_list *head;
+		unsigned int i = 0;
+
+		retval = aarch64_read_prsr_smp(target, prsr);
+		if (retval != ERROR_OK)
+			break;
+
+		foreach_smp_target(head, target->smp_targets) {
+			struct target *curr = head->target;
+			uint32_t curr_prsr = prsr[i++];
+
+			if (curr == target || !target_was_examined(curr))
+				continue;
+			if (curr->state == TARGET_RUNNING)
+				continue;
+
+			/*
+			 * if PRSR.SDR is set now, the target did restart, even
+			 * if it's now already halted again (e.g. due to breakpoint)
+			 */
+			if (!(curr_prsr & PRSR_SDR) && (curr_prsr & PRSR_HALT)) {
+				if (!pending)
+					pending = curr;
+				continue;
+			}
+
+			curr->state = TARGET_RUNNING;
+			curr->debug_reason = DBG_REASON_NOTHALTED;
+			target_call_event_callbacks(curr, TARGET_EVENT_RESUMED);
+		}
+
+		if (!pending)
+			break;
+
+		if (timeval_ms() > then + 1000) {
+			LOG_ERROR("%s: timeout waiting for target %s to resume", __func__, target_name(pending));
+			retval = ERROR_TARGET_TIMEOUT;
+			break;
+		}
+
+		/*
+		 * HACK: on Hi6220 there are 8 cores organized in 2 clusters
+		 * and it looks like the CTI's are not connected by a common
+		 * trigger matrix. It seems that we need to halt one core in each
+		 * cluster explicitly. So if we find that a core has not halted
+		 * yet, we trigger an explicit resume for the second cluster.
+		 */
+		retval = aarch64_do_restart_one(pending, RESTART_LAZY);
+		if (retval != ERROR_OK)
+			break;
+	}
+
+	free(prsr);
+	return retval;
+}
+
 /*
  * prepare all but the current target for restart
  */
@@ -766,7 +916,6 @@ static int aarch64_prep_restart_smp(struct target *target, int handle_breakpoint
 static int aarch64_step_restart_smp(struct target *target)
 {
 	int retval = ERROR_OK;
-	struct target_list *head;
 	struct target *first = NULL;
 
 	LOG_DEBUG("%s", target_name(target));
@@ -782,58 +931,7 @@ static int aarch64_step_restart_smp(struct target *target)
 		return retval;
 	}
 
-	int64_t then = timeval_ms();
-	for (;;) {
-		struct target *curr = target;
-		bool all_resumed = true;
-
-		foreach_smp_target(head, target->smp_targets) {
-			uint32_t prsr;
-			int resumed;
-
-			curr = head->target;
-
-			if (curr == target)
-				continue;
-
-			if (!target_was_examined(curr))
-				continue;
-
-			retval = aarch64_check_state_one(curr,
-					PRSR_SDR, PRSR_SDR, &resumed, &prsr);
-			if (retval != ERROR_OK || (!resumed && (prsr & PRSR_HALT))) {
-				all_resumed = false;
-				break;
-			}
-
-			if (curr->state != TARGET_RUNNING) {
-				curr->state = TARGET_RUNNING;
-				curr->debug_reason = DBG_REASON_NOTHALTED;
-				target_call_event_callbacks(curr, TARGET_EVENT_RESUMED);
-			}
-		}
-
-		if (all_resumed)
-			break;
-
-		if (timeval_ms() > then + 1000) {
-			LOG_ERROR("%s: timeout waiting for target resume", __func__);
-			retval = ERROR_TARGET_TIMEOUT;
-			break;
-		}
-		/*
-		 * HACK: on Hi6220 there are 8 cores organized in 2 clusters
-		 * and it looks like the CTI's are not connected by a common
-		 * trigger matrix. It seems that we need to halt one core in each
-		 * cluster explicitly. So if we find that a core has not halted
-		 * yet, we trigger an explicit resume for the second cluster.
-		 */
-		retval = aarch64_do_restart_one(curr, RESTART_LAZY);
-		if (retval != ERROR_OK)
-			break;
-}
-
-	return retval;
+	return aarch64_wait_restart_smp(target);
 }
 
 static int aarch64_resume(struct target *target, int current,
@@ -868,58 +966,8 @@ static int aarch64_resume(struct target *target, int current,
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (target->smp) {
-		int64_t then = timeval_ms();
-		for (;;) {
-			struct target *curr = target;
-			struct target_list *head;
-			bool all_resumed = true;
-
-			foreach_smp_target(head, target->smp_targets) {
-				uint32_t prsr;
-				int resumed;
-
-				curr = head->target;
-				if (curr == target)
-					continue;
-				if (!target_was_examined(curr))
-					continue;
-
-				retval = aarch64_check_state_one(curr,
-						PRSR_SDR, PRSR_SDR, &resumed, &prsr);
-				if (retval != ERROR_OK || (!resumed && (prsr & PRSR_HALT))) {
-					all_resumed = false;
-					break;
-				}
-
-				if (curr->state != TARGET_RUNNING) {
-					curr->state = TARGET_RUNNING;
-					curr->debug_reason = DBG_REASON_NOTHALTED;
-					target_call_event_callbacks(curr, TARGET_EVENT_RESUMED);
-				}
-			}
-
-			if (all_resumed)
-				break;
-
-			if (timeval_ms() > then + 1000) {
-				LOG_ERROR("%s: timeout waiting for target %s to resume", __func__, target_name(curr));
-				retval = ERROR_TARGET_TIMEOUT;
-				break;
-			}
-
-			/*
-			 * HACK: on Hi6220 there are 8 cores organized in 2 clusters
-			 * and it looks like the CTI's are not connected by a common
-			 * trigger matrix. It seems that we need to halt one core in each
-			 * cluster explicitly. So if we find that a core has not halted
-			 * yet, we trigger an explicit resume for the second cluster.
-			 */
-			retval = aarch64_do_restart_one(curr, RESTART_LAZY);
-			if (retval != ERROR_OK)
-				break;
-		}
-	}
+	if (target->smp)
+		retval = aarch64_wait_restart_smp(target);
 
 	if (retval != ERROR_OK)
 		return retval;
@@ -1213,6 +1261,37 @@ static int aarch64_restore_context(struct target *target, bool bpwp)
  */
 
 /* Setup hardware Breakpoint Register Pair */
+/* the halting instruction of a software breakpoint, its length adjusted */
+static void aarch64_soft_breakpoint_code(struct target *target,
+	struct breakpoint *breakpoint, uint8_t *code)
+{
+	struct armv8_common *armv8 = target_to_armv8(target);
+	uint32_t opcode;
+
+	if (armv8_dpm_get_core_state(&armv8->dpm) == ARM_STATE_AARCH64) {
+		opcode = ARMV8_HLT(11);
+
+		if (breakpoint->length != 4)
+			LOG_ERROR("bug: breakpoint length should be 4 in AArch64 mode");
+	} else {
+		/**
+		 * core_state is ARM_STATE_ARM
+		 * in that case the opcode depends on breakpoint length:
+		 *  - if length == 4 => A32 opcode
+		 *  - if length == 2 => T32 opcode
+		 *  - if length == 3 => T32 opcode (refer to gdb doc : ARM-Breakpoint-Kinds)
+		 *    in that case the length should be changed from 3 to 4 bytes
+		 **/
+		opcode = (breakpoint->length == 4) ? ARMV8_HLT_A1(11) :
+				(uint32_t)(ARMV8_HLT_T1(11) | ARMV8_HLT_T1(11) << 16);
+
+		if (breakpoint->length == 3)
+			breakpoint->length = 4;
+	}
+
+	buf_set_u32(code, 0, 32, opcode);
+}
+
 static int aarch64_set_breakpoint(struct target *target,
 	struct breakpoint *breakpoint, uint8_t matchmode)
 {
@@ -1270,31 +1349,9 @@ static int aarch64_set_breakpoint(struct target *target,
 			brp_list[brp_i].value);
 
 	} else if (breakpoint->type == BKPT_SOFT) {
-		uint32_t opcode;
 		uint8_t code[4];
 
-		if (armv8_dpm_get_core_state(&armv8->dpm) == ARM_STATE_AARCH64) {
-			opcode = ARMV8_HLT(11);
-
-			if (breakpoint->length != 4)
-				LOG_ERROR("bug: breakpoint length should be 4 in AArch64 mode");
-		} else {
-			/**
-			 * core_state is ARM_STATE_ARM
-			 * in that case the opcode depends on breakpoint length:
-			 *  - if length == 4 => A32 opcode
-			 *  - if length == 2 => T32 opcode
-			 *  - if length == 3 => T32 opcode (refer to gdb doc : ARM-Breakpoint-Kinds)
-			 *    in that case the length should be changed from 3 to 4 bytes
-			 **/
-			opcode = (breakpoint->length == 4) ? ARMV8_HLT_A1(11) :
-					(uint32_t) (ARMV8_HLT_T1(11) | ARMV8_HLT_T1(11) << 16);
-
-			if (breakpoint->length == 3)
-				breakpoint->length = 4;
-		}
-
-		buf_set_u32(code, 0, 32, opcode);
+		aarch64_soft_breakpoint_code(target, breakpoint, code);
 
 		retval = target_read_memory(target,
 				breakpoint->address & 0xFFFFFFFFFFFFFFFE,
@@ -1673,6 +1730,149 @@ static int aarch64_remove_breakpoint(struct target *target, struct breakpoint *b
 	return ERROR_OK;
 }
 
+static int aarch64_breakpoint_compare(const void *a, const void *b)
+{
+	const struct breakpoint *bpa = *(const struct breakpoint * const *)a;
+	const struct breakpoint *bpb = *(const struct breakpoint * const *)b;
+
+	if (bpa->address < bpb->address)
+		return -1;
+	return bpa->address > bpb->address;
+}
+
+/*
+ * Set (or restore) the instructions of software breakpoints sorted by
+ * address, reading and writing each range of close breakpoints within a page
+ * at once, with a single cache maintenance. On a failure the breakpoints of
+ * the ranges already written keep their new is_set.
+ */
+static int aarch64_write_soft_breakpoints(struct target *target,
+	struct breakpoint **list, unsigned int num, bool set)
+{
+	struct armv8_common *armv8 = target_to_armv8(target);
+	uint8_t *buffer = malloc(AARCH64_BKPT_RANGE_SIZE);
+	int retval = ERROR_OK;
+
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0, j; i < num && retval == ERROR_OK; i = j) {
+		target_addr_t start = ALIGN_DOWN(list[i]->address, 4);
+		target_addr_t end = (list[i]->address & ~(target_addr_t)1) + list[i]->length;
+
+		for (j = i + 1; j < num; j++) {
+			target_addr_t address = list[j]->address & ~(target_addr_t)1;
+			if (address < end || address - end > AARCH64_BKPT_RANGE_GAP
+					|| (address + list[j]->length - 1) / AARCH64_BKPT_RANGE_SIZE
+						!= start / AARCH64_BKPT_RANGE_SIZE)
+				break;
+			end = address + list[j]->length;
+		}
+		end = ALIGN_UP(end, 4);
+
+		retval = target_read_memory(target, start, 4, (end - start) / 4, buffer);
+		if (retval != ERROR_OK)
+			break;
+
+		for (unsigned int k = i; k < j; k++) {
+			uint8_t *instr = buffer + (list[k]->address & ~(target_addr_t)1) - start;
+			if (set) {
+				uint8_t code[4];
+
+				aarch64_soft_breakpoint_code(target, list[k], code);
+				memcpy(list[k]->orig_instr, instr, list[k]->length);
+				memcpy(instr, code, list[k]->length);
+			} else {
+				memcpy(instr, list[k]->orig_instr, list[k]->length);
+			}
+		}
+
+		armv8_cache_d_inner_flush_virt(armv8, start, end - start);
+
+		retval = target_write_memory(target, start, 4, (end - start) / 4, buffer);
+		if (retval != ERROR_OK)
+			break;
+
+		armv8_cache_d_inner_flush_virt(armv8, start, end - start);
+		armv8_cache_i_inner_inval_virt(armv8, start, end - start);
+
+		for (unsigned int k = i; k < j; k++)
+			list[k]->is_set = set;
+	}
+
+	free(buffer);
+	return retval;
+}
+
+static int aarch64_add_breakpoints(struct target *target,
+	struct breakpoint **breakpoint_list, unsigned int num_breakpoints)
+{
+	for (unsigned int i = 0; i < num_breakpoints; i++) {
+		struct breakpoint *breakpoint = breakpoint_list[i];
+		if (breakpoint->length == 3)
+			breakpoint->length = 4;
+		if (breakpoint->type != BKPT_SOFT || breakpoint->is_set
+				|| (breakpoint->length != 2 && breakpoint->length != 4)) {
+			LOG_TARGET_INFO(target, "only unset software breakpoints can be batched");
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+	}
+
+	struct breakpoint **list = malloc(num_breakpoints * sizeof(*list));
+	if (!list) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	memcpy(list, breakpoint_list, num_breakpoints * sizeof(*list));
+	qsort(list, num_breakpoints, sizeof(*list), aarch64_breakpoint_compare);
+
+	int retval = aarch64_write_soft_breakpoints(target, list, num_breakpoints, true);
+	if (retval == ERROR_OK)
+		retval = aarch64_set_dscr_bits(target, DSCR_HDE, DSCR_HDE);
+
+	if (retval != ERROR_OK) {
+		/* leave none of them set */
+		for (unsigned int i = 0; i < num_breakpoints; i++)
+			if (list[i]->is_set)
+				aarch64_unset_breakpoint(target, list[i]);
+	} else {
+		LOG_TARGET_DEBUG(target, "set %u software breakpoints", num_breakpoints);
+	}
+
+	free(list);
+	return retval;
+}
+
+static int aarch64_remove_breakpoints(struct target *target,
+	struct breakpoint **breakpoint_list, unsigned int num_breakpoints)
+{
+	struct breakpoint **list = malloc(num_breakpoints * sizeof(*list));
+	unsigned int num_soft = 0;
+	int retval = ERROR_OK;
+
+	if (list) {
+		for (unsigned int i = 0; i < num_breakpoints; i++)
+			if (breakpoint_list[i]->is_set && breakpoint_list[i]->type == BKPT_SOFT)
+				list[num_soft++] = breakpoint_list[i];
+		qsort(list, num_soft, sizeof(*list), aarch64_breakpoint_compare);
+
+		if (aarch64_write_soft_breakpoints(target, list, num_soft, false) != ERROR_OK)
+			LOG_TARGET_DEBUG(target, "batched restore failed, restoring one by one");
+		free(list);
+	}
+
+	/* hardware breakpoints and, on a failure, the software ones one by one */
+	for (unsigned int i = 0; i < num_breakpoints; i++) {
+		int ret = aarch64_remove_breakpoint(target, breakpoint_list[i]);
+		if (retval == ERROR_OK)
+			retval = ret;
+	}
+
+	return retval;
+}
+
 /* Setup hardware Watchpoint Register Pair */
 static int aarch64_set_watchpoint(struct target *target,
 	struct watchpoint *watchpoint)
@@ -2095,28 +2295,30 @@ static int aarch64_write_cpu_memory_fast(struct target *target,
 
 	armv8_reg_current(arm, 1)->dirty = true;
 
+	/* The whole transfer is queued and run at once, the sticky abort
+	 * flags in DSCR are checked by the caller at the end */
+
 	/* Step 1.d   - Change DCC to memory mode */
 	*dscr |= DSCR_MA;
-	retval =  mem_ap_write_atomic_u32(armv8->debug_ap,
+	retval = mem_ap_write_u32(armv8->debug_ap,
 			armv8->debug_base + CPUV8_DBG_DSCR, *dscr);
-	if (retval != ERROR_OK)
-		return retval;
-
 
 	/* Step 2.a   - Do the write */
-	retval = mem_ap_write_buf_noincr(armv8->debug_ap,
-					buffer, 4, count, armv8->debug_base + CPUV8_DBG_DTRRX);
-	if (retval != ERROR_OK)
-		return retval;
+	if (retval == ERROR_OK)
+		retval = mem_ap_write_buf_noincr_queued(armv8->debug_ap,
+				buffer, 4, count, armv8->debug_base + CPUV8_DBG_DTRRX);
 
 	/* Step 3.a   - Switch DTR mode back to Normal mode */
 	*dscr &= ~DSCR_MA;
-	retval = mem_ap_write_atomic_u32(armv8->debug_ap,
+	if (retval == ERROR_OK)
+		retval = mem_ap_write_u32(armv8->debug_ap,
 				armv8->debug_base + CPUV8_DBG_DSCR, *dscr);
-	if (retval != ERROR_OK)
-		return retval;
 
-	return ERROR_OK;
+	int run_retval = mem_ap_run_queued(armv8->debug_ap->dap);
+	if (retval == ERROR_OK)
+		retval = run_retval;
+
+	return retval;
 }
 
 static int aarch64_write_cpu_memory(struct target *target,
@@ -2272,7 +2474,7 @@ static int aarch64_read_cpu_memory_fast(struct target *target,
 	struct arm_dpm *dpm = &armv8->dpm;
 	struct arm *arm = &armv8->arm;
 	int retval;
-	uint32_t value;
+	uint32_t value, discard;
 
 	/* Mark X1 as dirty */
 	armv8_reg_current(arm, 1)->dirty = true;
@@ -2288,18 +2490,18 @@ static int aarch64_read_cpu_memory_fast(struct target *target,
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* The whole transfer is queued and run at once, the sticky abort
+	 * flags in DSCR are checked by the caller at the end */
+
 	/* Step 1.e - Change DCC to memory mode */
 	*dscr |= DSCR_MA;
-	retval =  mem_ap_write_atomic_u32(armv8->debug_ap,
+	retval = mem_ap_write_u32(armv8->debug_ap,
 			armv8->debug_base + CPUV8_DBG_DSCR, *dscr);
-	if (retval != ERROR_OK)
-		return retval;
 
 	/* Step 1.f - read DBGDTRTX and discard the value */
-	retval = mem_ap_read_atomic_u32(armv8->debug_ap,
-			armv8->debug_base + CPUV8_DBG_DTRTX, &value);
-	if (retval != ERROR_OK)
-		return retval;
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DTRTX, &discard);
 
 	count--;
 	/* Read the data - Each read of the DTRTX register causes the instruction to be reissued
@@ -2308,25 +2510,27 @@ static int aarch64_read_cpu_memory_fast(struct target *target,
 	 * This data is read in aligned to 32 bit boundary.
 	 */
 
-	if (count) {
+	if (count && retval == ERROR_OK) {
 		/* Step 2.a - Loop n-1 times, each read of DBGDTRTX reads the data from [X0] and
 		 * increments X0 by 4. */
-		retval = mem_ap_read_buf_noincr(armv8->debug_ap, buffer, 4, count,
-									armv8->debug_base + CPUV8_DBG_DTRTX);
-		if (retval != ERROR_OK)
-			return retval;
+		retval = mem_ap_read_buf_noincr_queued(armv8->debug_ap, buffer, 4, count,
+				armv8->debug_base + CPUV8_DBG_DTRTX);
 	}
 
 	/* Step 3.a - set DTR access mode back to Normal mode	*/
 	*dscr &= ~DSCR_MA;
-	retval =  mem_ap_write_atomic_u32(armv8->debug_ap,
-					armv8->debug_base + CPUV8_DBG_DSCR, *dscr);
-	if (retval != ERROR_OK)
-		return retval;
+	if (retval == ERROR_OK)
+		retval = mem_ap_write_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DSCR, *dscr);
 
 	/* Step 3.b - read DBGDTRTX for the final value */
-	retval = mem_ap_read_atomic_u32(armv8->debug_ap,
-			armv8->debug_base + CPUV8_DBG_DTRTX, &value);
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DTRTX, &value);
+
+	int run_retval = mem_ap_run_queued(armv8->debug_ap->dap);
+	if (retval == ERROR_OK)
+		retval = run_retval;
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -2425,6 +2629,93 @@ static int aarch64_read_cpu_memory(struct target *target,
 	return ERROR_OK;
 }
 
+/* Memory accesses of at least this size go through the system bus AP */
+#define AARCH64_SYSBUS_MIN_BYTES	1024
+/* Smallest translation granule, the range is translated page by page */
+#define AARCH64_SYSBUS_PAGE_SIZE	4096
+
+static bool aarch64_use_sysbus(struct target *target, target_addr_t address,
+	uint32_t size, uint32_t count)
+{
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+
+	return aarch64->sysbus_ap_num != DP_APSEL_INVALID &&
+		size * count >= AARCH64_SYSBUS_MIN_BYTES &&
+		!(address & (size - 1));
+}
+
+/*
+ * Access the memory through the system bus AP. The D-cache lines of the
+ * range are cleaned and invalidated by the core first, so the bus sees
+ * the data of the core and the core sees the data written on the bus;
+ * the range is then translated by the core when the MMU is on.
+ */
+static int aarch64_sysbus_access(struct target *target, target_addr_t address,
+	uint32_t size, uint32_t count, uint8_t *rbuf, const uint8_t *wbuf)
+{
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+	struct armv8_common *armv8 = &aarch64->armv8_common;
+	struct armv8_cache_common *cache = &armv8->armv8_mmu.armv8_cache;
+	target_addr_t va = address;
+	uint32_t len = size * count;
+	int retval;
+
+	if (!aarch64->sysbus_ap) {
+		aarch64->sysbus_ap = dap_get_ap(armv8->arm.dap, aarch64->sysbus_ap_num);
+		if (!aarch64->sysbus_ap) {
+			LOG_ERROR("Cannot get AP 0x%" PRIx64 " for the system bus",
+				aarch64->sysbus_ap_num);
+			return ERROR_FAIL;
+		}
+		retval = mem_ap_init(aarch64->sysbus_ap);
+		if (retval != ERROR_OK) {
+			dap_put_ap(aarch64->sysbus_ap);
+			aarch64->sysbus_ap = NULL;
+			return retval;
+		}
+	}
+
+	if (cache->d_u_cache_enabled) {
+		retval = armv8_cache_d_inner_flush_virt(armv8, va, len);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	while (len) {
+		target_addr_t pa = va;
+		uint32_t chunk = len;
+
+		if (armv8->armv8_mmu.mmu_enabled) {
+			chunk = MIN(len, AARCH64_SYSBUS_PAGE_SIZE -
+					(va & (AARCH64_SYSBUS_PAGE_SIZE - 1)));
+			retval = armv8_mmu_translate_va_pa(target, va, &pa, 0);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		if (rbuf) {
+			retval = mem_ap_read_buf(aarch64->sysbus_ap, rbuf, size,
+					chunk / size, pa);
+			rbuf += chunk;
+		} else {
+			retval = mem_ap_write_buf(aarch64->sysbus_ap, wbuf, size,
+					chunk / size, pa);
+			wbuf += chunk;
+		}
+		if (retval != ERROR_OK)
+			return retval;
+
+		va += chunk;
+		len -= chunk;
+	}
+
+	/* the range may hold code */
+	if (wbuf && cache->i_cache_enabled)
+		return armv8_cache_i_inner_inval_virt(armv8, address, size * count);
+
+	return ERROR_OK;
+}
+
 static int aarch64_read_phys_memory(struct target *target,
 	target_addr_t address, uint32_t size,
 	uint32_t count, uint8_t *buffer)
@@ -2458,6 +2749,10 @@ static int aarch64_read_memory(struct target *target, target_addr_t address,
 		if (retval != ERROR_OK)
 			return retval;
 	}
+
+	if (aarch64_use_sysbus(target, address, size, count))
+		return aarch64_sysbus_access(target, address, size, count, buffer, NULL);
+
 	return aarch64_read_cpu_memory(target, address, size, count, buffer);
 }
 
@@ -2495,6 +2790,10 @@ static int aarch64_write_memory(struct target *target, target_addr_t address,
 		if (retval != ERROR_OK)
 			return retval;
 	}
+
+	if (aarch64_use_sysbus(target, address, size, count))
+		return aarch64_sysbus_access(target, address, size, count, NULL, buffer);
+
 	return aarch64_write_cpu_memory(target, address, size, count, buffer);
 }
 
@@ -2711,6 +3010,7 @@ static int aarch64_init_arch_info(struct target *target,
 
 	/* Setup struct aarch64_common */
 	aarch64->common_magic = AARCH64_COMMON_MAGIC;
+	aarch64->sysbus_ap_num = DP_APSEL_INVALID;
 	armv8->arm.dap = dap;
 
 	/* register arch-specific functions */
@@ -2751,6 +3051,8 @@ static void aarch64_deinit_target(struct target *target)
 
 	if (armv8->debug_ap)
 		dap_put_ap(armv8->debug_ap);
+	if (aarch64->sysbus_ap)
+		dap_put_ap(aarch64->sysbus_ap);
 
 	armv8_free_reg_cache(target);
 	free(aarch64->brp_list);
@@ -2952,6 +3254,35 @@ COMMAND_HANDLER(aarch64_mask_interrupts_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(aarch64_handle_sysbus_ap_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		uint64_t ap_num = DP_APSEL_INVALID;
+
+		if (strcmp(CMD_ARGV[0], "off"))
+			COMMAND_PARSE_NUMBER(u64, CMD_ARGV[0], ap_num);
+
+		if (aarch64->sysbus_ap) {
+			dap_put_ap(aarch64->sysbus_ap);
+			aarch64->sysbus_ap = NULL;
+		}
+		aarch64->sysbus_ap_num = ap_num;
+	}
+
+	if (aarch64->sysbus_ap_num == DP_APSEL_INVALID)
+		command_print(CMD, "off");
+	else
+		command_print(CMD, "0x%" PRIx64, aarch64->sysbus_ap_num);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(aarch64_mcrmrc_command)
 {
 	bool is_mcr = false;
@@ -3096,6 +3427,16 @@ static const struct command_registration aarch64_exec_command_handlers[] = {
 		.help = "read coprocessor register",
 		.usage = "cpnum op1 CRn CRm op2",
 	},
+	{
+		.name = "sysbus_ap",
+		.handler = aarch64_handle_sysbus_ap_command,
+		.mode = COMMAND_ANY,
+		.help = "set the MEM-AP used for bulk memory accesses",
+		.usage = "[ap_num|'off']",
+	},
+	{
+		.chain = arm_tlb_command_handlers,
+	},
 	{
 		.chain = smp_command_handlers,
 	},
@@ -3149,6 +3490,8 @@ struct target_type aarch64_target = {
 	.add_context_breakpoint = aarch64_add_context_breakpoint,
 	.add_hybrid_breakpoint = aarch64_add_hybrid_breakpoint,
 	.remove_breakpoint = aarch64_remove_breakpoint,
+	.add_breakpoints = aarch64_add_breakpoints,
+	.remove_breakpoints = aarch64_remove_breakpoints,
 	.add_watchpoint = aarch64_add_watchpoint,
 	.remove_watchpoint = aarch64_remove_watchpoint,
 	.hit_watchpoint = aarch64_hit_watchpoint,
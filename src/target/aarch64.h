@@ -58,6 +58,10 @@ struct aarch64_common {
 	struct aarch64_brp *wp_list;
 
 	enum aarch64_isrmasking_mode isrmasking_mode;
+
+	/* System bus MEM-AP for bulk memory accesses, DP_APSEL_INVALID if none */
+	uint64_t sysbus_ap_num;
+	struct adiv5_ap *sysbus_ap;
 };
 
 static inline struct aarch64_common *
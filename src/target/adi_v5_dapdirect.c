@@ -20,6 +20,8 @@
  * FIXME: in JTAG mode, trst is not managed
  */
 
+#define LOG_CATEGORY LOG_CAT_DAP
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
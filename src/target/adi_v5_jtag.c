@@ -21,6 +21,8 @@
  the ARM Debug Interface version 5 (ADIv5) and version 6 (ADIv6).
  */
 
+#define LOG_CATEGORY LOG_CAT_DAP
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -279,8 +281,8 @@ static int adi_jtag_dp_scan_cmd(struct adiv5_dap *dap, struct dap_cmd *cmd, uint
 	 * They provide more time for the (MEM) AP to complete the read ...
 	 * See "Minimum Response Time" for JTAG-DP, in the ADIv5/ADIv6 spec.
 	 */
-	if (cmd->instr == JTAG_DP_APACC && cmd->memaccess_tck != 0)
-		jtag_add_runtest(cmd->memaccess_tck, TAP_IDLE);
+	if (cmd->instr == JTAG_DP_APACC && cmd->memaccess_tck + dap->wait_tck != 0)
+		jtag_add_runtest(cmd->memaccess_tck + dap->wait_tck, TAP_IDLE);
 
 	return ERROR_OK;
 }
@@ -352,9 +354,14 @@ static int adi_jtag_dp_scan_u32(struct adiv5_dap *dap,
 	int retval;
 	uint64_t sel = (reg_addr >> 4) & 0xf;
 
-	/* No need to change SELECT or RDBUFF as they are not banked */
-	if (instr == JTAG_DP_DPACC && reg_addr != DP_SELECT && reg_addr != DP_RDBUFF &&
-			sel != (dap->select & 0xf)) {
+	/* No need to change SELECT or RDBUFF as they are not banked.
+	 * An invalid cache has DPBANKSEL field zero, don't take it as a hit. */
+	bool banked = instr == JTAG_DP_DPACC && reg_addr != DP_SELECT && reg_addr != DP_RDBUFF;
+	bool hit = dap->select != DP_SELECT_INVALID && sel == (dap->select & 0xf);
+	if (banked)
+		dap_account_select(dap, hit);
+
+	if (banked && !hit) {
 		if (dap->select != DP_SELECT_INVALID)
 			sel |= dap->select & ~0xfull;
 		dap->select = sel;
@@ -417,14 +424,42 @@ static int adi_jtag_scan_inout_check_u32(struct adiv5_dap *dap,
 	return jtag_execute_queue();
 }
 
+static struct metric jtagdp_wait_metric = METRIC_COUNTER("dap_jtag_wait_retries_total",
+		"DAP transactions replayed because the DAP answered WAIT");
+
+/* Double the idle cycles added after APACC scans when the DAP answers WAIT */
+static void jtagdp_wait_tck_raise(struct adiv5_dap *dap)
+{
+	uint32_t wait_tck = dap->wait_tck ? 2 * dap->wait_tck : 8;
+
+	dap->wait_tck = MIN(wait_tck, dap->wait_tck_max);
+	dap->wait_clean_runs = 0;
+}
+
+/* Try a shorter delay once the queue ran without WAIT for a while */
+static void jtagdp_wait_tck_relax(struct adiv5_dap *dap)
+{
+	if (++dap->wait_clean_runs < 16)
+		return;
+
+	dap->wait_clean_runs = 0;
+	dap->wait_tck = dap->wait_tck * 3 / 4;
+}
+
 static int jtagdp_overrun_check(struct adiv5_dap *dap)
 {
 	int retval;
-	struct dap_cmd *el, *tmp, *prev = NULL;
-	int found_wait = 0;
+	struct dap_cmd *el, *tmp, *prev;
+	int found_wait;
+	bool replayed = false;
 	int64_t time_now;
+	int64_t start = timeval_ms();
 	LIST_HEAD(replay_list);
 
+ replay:
+	prev = NULL;
+	found_wait = 0;
+
 	/* make sure all queued transactions are complete */
 	retval = jtag_execute_queue();
 	if (retval != ERROR_OK)
@@ -439,6 +474,11 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 		 */
 		if (el->ack == JTAG_ACK_OK_FAULT || (is_adiv6(dap) && el->ack == JTAG_ACK_OK)) {
 			log_dap_cmd(dap, "LOG", el);
+			/* replayed scans have no endianness conversion callback */
+			if (replayed && el->invalue != el->invalue_buf) {
+				uint32_t invalue = le_to_h_u32(el->invalue);
+				memcpy(el->invalue, &invalue, sizeof(uint32_t));
+			}
 		} else if (el->ack == JTAG_ACK_WAIT) {
 			found_wait = 1;
 			break;
@@ -555,7 +595,10 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 
 	/* check for overrun condition in the last batch of transactions */
 	if (found_wait) {
-		LOG_INFO("DAP transaction stalled (WAIT) - slowing down and resending");
+		if (!replayed)
+			dap->wait_recoveries++;
+		if (!dap->wait_tck_max)
+			LOG_INFO("DAP transaction stalled (WAIT) - slowing down and resending");
 		/* clear the sticky overrun condition */
 		retval = adi_jtag_scan_inout_check_u32(dap, JTAG_DP_DPACC,
 				DP_CTRL_STAT, DPAP_WRITE,
@@ -576,6 +619,7 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 				retval = ERROR_JTAG_DEVICE_ERROR;
 				goto done;
 			}
+			tmp->dp_select = el->dp_select;
 			list_add(&tmp->lh, &replay_list);
 
 			/* TODO: ADIv6 DP SELECT1 handling */
@@ -583,6 +627,39 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 			dap->select = DP_SELECT_INVALID;
 		}
 
+		/* Resend the stalled tail in one batch with more idle cycles
+		 * after each APACC scan and check it like the original queue */
+		if (dap->wait_tck_max) {
+			flush_journal(dap, &dap->cmd_journal);
+
+			if (timeval_ms() - start >= 1000) {
+				LOG_ERROR("Timeout during WAIT recovery");
+				dap->select = DP_SELECT_INVALID;
+				jtag_ap_q_abort(dap, NULL);
+				/* clear the sticky overrun condition */
+				adi_jtag_scan_inout_check_u32(dap, JTAG_DP_DPACC,
+					DP_CTRL_STAT, DPAP_WRITE,
+					dap->dp_ctrl_stat | SSTICKYORUN, NULL, 0);
+				retval = ERROR_JTAG_DEVICE_ERROR;
+				goto done;
+			}
+
+			jtagdp_wait_tck_raise(dap);
+			metric_add(&jtagdp_wait_metric, 1);
+			LOG_DEBUG("DAP transaction stalled (WAIT) - resending with %" PRIu32 " idle tck",
+					dap->wait_tck);
+
+			list_for_each_entry(el, &replay_list, lh) {
+				retval = adi_jtag_dp_scan_cmd(dap, el, NULL);
+				if (retval != ERROR_OK)
+					goto done;
+			}
+			list_splice_tail_init(&replay_list, &dap->cmd_journal);
+			dap->wait_replays++;
+			replayed = true;
+			goto replay;
+		}
+
 		list_for_each_entry_safe(el, tmp, &replay_list, lh) {
 			time_now = timeval_ms();
 			do {
@@ -627,6 +704,8 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 			} else
 				break;
 		}
+	} else if (!replayed && dap->wait_tck) {
+		jtagdp_wait_tck_relax(dap);
 	}
 
  done:
@@ -757,6 +836,7 @@ static int jtag_ap_q_bankselect(struct adiv5_ap *ap, unsigned reg)
 
 	if (is_adiv6(dap)) {
 		sel = ap->ap_num | (reg & 0x00000FF0);
+		dap_account_select(dap, sel == (dap->select & ~0xfull));
 		if (sel == (dap->select & ~0xfull))
 			return ERROR_OK;
 
@@ -777,6 +857,7 @@ static int jtag_ap_q_bankselect(struct adiv5_ap *ap, unsigned reg)
 	/* ADIv5 */
 	sel = (ap->ap_num << 24) | (reg & 0x000000F0);
 
+	dap_account_select(dap, sel == dap->select);
 	if (sel == dap->select)
 		return ERROR_OK;
 
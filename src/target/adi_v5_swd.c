@@ -30,6 +30,8 @@
  *
  */
 
+#define LOG_CATEGORY LOG_CAT_DAP
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -39,6 +41,7 @@
 #include <helper/time_support.h>
 
 #include <transport/transport.h>
+#include <jtag/adapter.h>
 #include <jtag/interface.h>
 
 #include <jtag/swd.h>
@@ -48,6 +51,37 @@ static bool do_sync;
 
 static struct adiv5_dap *swd_multidrop_selected_dap;
 
+/* queue the TARGETSEL sequence on a switch between known multidrop DAPs
+ * instead of running it, the DAP identification is checked after the run */
+static bool swd_multidrop_fast_switch = true;
+static struct adiv5_dap *swd_multidrop_switch_dap;
+static uint32_t swd_multidrop_switch_dpidr;
+static uint32_t swd_multidrop_switch_dlpidr;
+static unsigned int swd_multidrop_switches;
+
+/* SWD transactions queued since the last run, for the flush statistics */
+static unsigned int swd_queued_transfers;
+static uint64_t swd_queued_bits;
+
+/* request, turnarounds, ack, data and parity of a single transaction */
+#define SWD_TRANSFER_BITS 46
+
+static void swd_read_reg(const struct swd_driver *swd, uint8_t cmd, uint32_t *value,
+		uint32_t ap_delay_hint)
+{
+	swd_queued_transfers++;
+	swd_queued_bits += SWD_TRANSFER_BITS + ap_delay_hint;
+	swd->read_reg(cmd, value, ap_delay_hint);
+}
+
+static void swd_write_reg(const struct swd_driver *swd, uint8_t cmd, uint32_t value,
+		uint32_t ap_delay_hint)
+{
+	swd_queued_transfers++;
+	swd_queued_bits += SWD_TRANSFER_BITS + ap_delay_hint;
+	swd->write_reg(cmd, value, ap_delay_hint);
+}
+
 
 static int swd_queue_dp_write_inner(struct adiv5_dap *dap, unsigned int reg,
 		uint32_t data);
@@ -65,7 +99,7 @@ static void swd_finish_read(struct adiv5_dap *dap)
 {
 	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
 	if (dap->last_read) {
-		swd->read_reg(swd_cmd(true, false, DP_RDBUFF), dap->last_read, 0);
+		swd_read_reg(swd, swd_cmd(true, false, DP_RDBUFF), dap->last_read, 0);
 		dap->last_read = NULL;
 	}
 }
@@ -75,22 +109,45 @@ static void swd_clear_sticky_errors(struct adiv5_dap *dap)
 	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
 	assert(swd);
 
-	swd->write_reg(swd_cmd(false, false, DP_ABORT),
+	swd_write_reg(swd, swd_cmd(false, false, DP_ABORT),
 		STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR, 0);
 }
 
+static int swd_multidrop_check_ids(struct adiv5_dap *dap, uint32_t dpidr,
+		uint32_t dlpidr);
+
 static int swd_run_inner(struct adiv5_dap *dap)
 {
 	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
 	int retval;
+	int64_t start = timeval_us();
 
 	retval = swd->run();
 
+	adapter_stats_flush(ADAPTER_STATS_SWD, start, swd_queued_transfers, swd_queued_bits, retval);
+	swd_queued_transfers = 0;
+	swd_queued_bits = 0;
+
 	if (retval != ERROR_OK) {
 		/* fault response */
 		dap->do_reconnect = true;
 	}
 
+	struct adiv5_dap *switch_dap = swd_multidrop_switch_dap;
+	if (switch_dap) {
+		swd_multidrop_switch_dap = NULL;
+		if (retval == ERROR_OK)
+			retval = swd_multidrop_check_ids(switch_dap,
+					swd_multidrop_switch_dpidr, swd_multidrop_switch_dlpidr);
+		if (retval != ERROR_OK) {
+			/* the transfers after the switch went to an unknown DP,
+			 * the next access does a full selection with retries */
+			LOG_DEBUG("Failed to switch to multidrop %s",
+					  adiv5_dap_name(switch_dap));
+			swd_multidrop_selected_dap = NULL;
+		}
+	}
+
 	return retval;
 }
 
@@ -110,6 +167,7 @@ static int swd_queue_dp_bankselect(struct adiv5_dap *dap, unsigned int reg)
 	if (dap->select != DP_SELECT_INVALID)
 		sel |= dap->select & ~0xfULL;
 
+	dap_account_select(dap, sel == dap->select);
 	if (sel == dap->select)
 		return ERROR_OK;
 
@@ -132,7 +190,7 @@ static int swd_queue_dp_read_inner(struct adiv5_dap *dap, unsigned int reg,
 	if (retval != ERROR_OK)
 		return retval;
 
-	swd->read_reg(swd_cmd(true, false, reg), data, 0);
+	swd_read_reg(swd, swd_cmd(true, false, reg), data, 0);
 
 	return check_sync(dap);
 }
@@ -149,7 +207,7 @@ static int swd_queue_dp_write_inner(struct adiv5_dap *dap, unsigned int reg,
 	if (reg == DP_SELECT) {
 		dap->select = data & (DP_SELECT_APSEL | DP_SELECT_APBANK | DP_SELECT_DPBANK);
 
-		swd->write_reg(swd_cmd(false, false, reg), data, 0);
+		swd_write_reg(swd, swd_cmd(false, false, reg), data, 0);
 
 		retval = check_sync(dap);
 		if (retval != ERROR_OK)
@@ -162,17 +220,39 @@ static int swd_queue_dp_write_inner(struct adiv5_dap *dap, unsigned int reg,
 	if (retval != ERROR_OK)
 		return retval;
 
-	swd->write_reg(swd_cmd(false, false, reg), data, 0);
+	swd_write_reg(swd, swd_cmd(false, false, reg), data, 0);
 
 	return check_sync(dap);
 }
 
 
-static int swd_multidrop_select_inner(struct adiv5_dap *dap, uint32_t *dpidr_ptr,
-		uint32_t *dlpidr_ptr, bool clear_sticky)
+static int swd_multidrop_check_ids(struct adiv5_dap *dap, uint32_t dpidr,
+		uint32_t dlpidr)
+{
+	if ((dpidr & DP_DPIDR_VERSION_MASK) < (2UL << DP_DPIDR_VERSION_SHIFT)) {
+		LOG_INFO("Read DPIDR 0x%08" PRIx32
+				 " has version < 2. A non multidrop capable device connected?",
+				 dpidr);
+		return ERROR_FAIL;
+	}
+
+	/* TODO: check TARGETID if DLIPDR is same for more than one DP */
+	uint32_t expected_dlpidr = DP_DLPIDR_PROTVSN |
+			(dap->multidrop_targetsel & DP_TARGETSEL_INSTANCEID_MASK);
+	if (dlpidr != expected_dlpidr) {
+		LOG_INFO("Read incorrect DLPIDR 0x%08" PRIx32
+				 " (possibly CTRL/STAT value)",
+				 dlpidr);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static int swd_multidrop_queue_select(struct adiv5_dap *dap, uint32_t *dpidr,
+		uint32_t *dlpidr, bool clear_sticky)
 {
 	int retval;
-	uint32_t dpidr, dlpidr;
 
 	assert(dap_is_multidrop(dap));
 
@@ -195,7 +275,7 @@ static int swd_multidrop_select_inner(struct adiv5_dap *dap, uint32_t *dpidr_ptr
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = swd_queue_dp_read_inner(dap, DP_DPIDR, &dpidr);
+	retval = swd_queue_dp_read_inner(dap, DP_DPIDR, dpidr);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -211,7 +291,16 @@ static int swd_multidrop_select_inner(struct adiv5_dap *dap, uint32_t *dpidr_ptr
 
 	dap->select = DP_SELECT_INVALID;
 
-	retval = swd_queue_dp_read_inner(dap, DP_DLPIDR, &dlpidr);
+	return swd_queue_dp_read_inner(dap, DP_DLPIDR, dlpidr);
+}
+
+static int swd_multidrop_select_inner(struct adiv5_dap *dap, uint32_t *dpidr_ptr,
+		uint32_t *dlpidr_ptr, bool clear_sticky)
+{
+	int retval;
+	uint32_t dpidr, dlpidr;
+
+	retval = swd_multidrop_queue_select(dap, &dpidr, &dlpidr, clear_sticky);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -219,22 +308,9 @@ static int swd_multidrop_select_inner(struct adiv5_dap *dap, uint32_t *dpidr_ptr
 	if (retval != ERROR_OK)
 		return retval;
 
-	if ((dpidr & DP_DPIDR_VERSION_MASK) < (2UL << DP_DPIDR_VERSION_SHIFT)) {
-		LOG_INFO("Read DPIDR 0x%08" PRIx32
-				 " has version < 2. A non multidrop capable device connected?",
-				 dpidr);
-		return ERROR_FAIL;
-	}
-
-	/* TODO: check TARGETID if DLIPDR is same for more than one DP */
-	uint32_t expected_dlpidr = DP_DLPIDR_PROTVSN |
-			(dap->multidrop_targetsel & DP_TARGETSEL_INSTANCEID_MASK);
-	if (dlpidr != expected_dlpidr) {
-		LOG_INFO("Read incorrect DLPIDR 0x%08" PRIx32
-				 " (possibly CTRL/STAT value)",
-				 dlpidr);
-		return ERROR_FAIL;
-	}
+	retval = swd_multidrop_check_ids(dap, dpidr, dlpidr);
+	if (retval != ERROR_OK)
+		return retval;
 
 	LOG_DEBUG_IO("Selected DP_TARGETSEL 0x%08" PRIx32, dap->multidrop_targetsel);
 	swd_multidrop_selected_dap = dap;
@@ -248,6 +324,35 @@ static int swd_multidrop_select_inner(struct adiv5_dap *dap, uint32_t *dpidr_ptr
 	return retval;
 }
 
+/* Switch to a DAP which is already known on the bus without flushing the
+ * queue: the selection sequence is queued in front of the accesses to the
+ * new DAP and its identification is checked by the next swd_run_inner(). */
+static int swd_multidrop_queue_switch(struct adiv5_dap *dap)
+{
+	struct adiv5_dap *prev = swd_multidrop_selected_dap;
+
+	/* Only one switch is checked per run, and the posted read of the
+	 * previous DAP has to be collected before the line reset */
+	swd_finish_read(prev);
+	if (swd_multidrop_switch_dap) {
+		int retval = swd_run_inner(prev);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	int retval = swd_multidrop_queue_select(dap, &swd_multidrop_switch_dpidr,
+			&swd_multidrop_switch_dlpidr, false);
+	if (retval != ERROR_OK)
+		return retval;
+
+	LOG_DEBUG_IO("Queued DP_TARGETSEL 0x%08" PRIx32, dap->multidrop_targetsel);
+	swd_multidrop_switch_dap = dap;
+	swd_multidrop_selected_dap = dap;
+	swd_multidrop_switches++;
+
+	return ERROR_OK;
+}
+
 static int swd_multidrop_select(struct adiv5_dap *dap)
 {
 	if (!dap_is_multidrop(dap))
@@ -256,6 +361,12 @@ static int swd_multidrop_select(struct adiv5_dap *dap)
 	if (swd_multidrop_selected_dap == dap)
 		return ERROR_OK;
 
+	if (swd_multidrop_fast_switch && swd_multidrop_selected_dap)
+		return swd_multidrop_queue_switch(dap);
+
+	if (swd_multidrop_selected_dap)
+		swd_finish_read(swd_multidrop_selected_dap);
+
 	int retval = ERROR_OK;
 	for (unsigned int retry = 0; ; retry++) {
 		bool clear_sticky = retry > 0;
@@ -458,7 +569,7 @@ static int swd_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 	if (retval != ERROR_OK)
 		return retval;
 
-	swd->write_reg(swd_cmd(false, false, DP_ABORT),
+	swd_write_reg(swd, swd_cmd(false, false, DP_ABORT),
 		DAPABORT | STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR, 0);
 	return check_sync(dap);
 }
@@ -503,6 +614,7 @@ static int swd_queue_ap_bankselect(struct adiv5_ap *ap, unsigned reg)
 
 	if (is_adiv6(dap)) {
 		sel = ap->ap_num | (reg & 0x00000FF0);
+		dap_account_select(dap, sel == (dap->select & ~0xfULL));
 		if (sel == (dap->select & ~0xfULL))
 			return ERROR_OK;
 
@@ -527,6 +639,7 @@ static int swd_queue_ap_bankselect(struct adiv5_ap *ap, unsigned reg)
 	if (dap->select != DP_SELECT_INVALID)
 		sel |= dap->select & DP_SELECT_DPBANK;
 
+	dap_account_select(dap, sel == dap->select);
 	if (sel == dap->select)
 		return ERROR_OK;
 
@@ -558,7 +671,7 @@ static int swd_queue_ap_read(struct adiv5_ap *ap, unsigned reg,
 	if (retval != ERROR_OK)
 		return retval;
 
-	swd->read_reg(swd_cmd(true, true, reg), dap->last_read, ap->memaccess_tck);
+	swd_read_reg(swd, swd_cmd(true, true, reg), dap->last_read, ap->memaccess_tck);
 	dap->last_read = data;
 
 	return check_sync(dap);
@@ -585,7 +698,7 @@ static int swd_queue_ap_write(struct adiv5_ap *ap, unsigned reg,
 	if (retval != ERROR_OK)
 		return retval;
 
-	swd->write_reg(swd_cmd(false, true, reg), data, ap->memaccess_tck);
+	swd_write_reg(swd, swd_cmd(false, true, reg), data, ap->memaccess_tck);
 
 	return check_sync(dap);
 }
@@ -647,6 +760,41 @@ const struct dap_ops swd_dap_ops = {
 	.quit = swd_quit,
 };
 
+COMMAND_HANDLER(handle_swd_stats)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		adapter_stats_reset(ADAPTER_STATS_SWD);
+		swd_multidrop_switches = 0;
+		return ERROR_OK;
+	}
+
+	adapter_stats_print(CMD, ADAPTER_STATS_SWD);
+	if (swd_multidrop_switches)
+		command_print(CMD, "multidrop switches without flush: %u",
+			swd_multidrop_switches);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_swd_multidrop_fast_switch)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], swd_multidrop_fast_switch);
+
+	command_print(CMD, "multidrop fast switch is %s",
+		swd_multidrop_fast_switch ? "on" : "off");
+
+	return ERROR_OK;
+}
+
 static const struct command_registration swd_commands[] = {
 	{
 		/*
@@ -661,6 +809,22 @@ static const struct command_registration swd_commands[] = {
 		.mode = COMMAND_CONFIG,
 		.help = "declare a new SWD DAP"
 	},
+	{
+		.name = "stats",
+		.handler = handle_swd_stats,
+		.mode = COMMAND_ANY,
+		.help = "Report histograms of SWD queue flush latency, depth, "
+			"bits shifted and flushes per operation, or clear them.",
+		.usage = "['reset']",
+	},
+	{
+		.name = "multidrop_fast_switch",
+		.handler = handle_swd_multidrop_fast_switch,
+		.mode = COMMAND_ANY,
+		.help = "Queue the selection of a multidrop DAP together with "
+			"the following accesses instead of flushing it separately.",
+		.usage = "['on'|'off']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
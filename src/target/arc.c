@@ -794,7 +794,7 @@ static int arc_halt(struct target *target)
 	CHECK_RETVAL(target_call_event_callbacks(target, TARGET_EVENT_HALTED));
 
 	/* some more debug information */
-	if (debug_level >= LOG_LVL_DEBUG) {
+	if (LOG_LEVEL_IS(LOG_LVL_DEBUG)) {
 		LOG_DEBUG("core stopped (halted) DEGUB-REG: 0x%08" PRIx32, value);
 		CHECK_RETVAL(arc_get_register_value(target, "status32", &value));
 		LOG_DEBUG("core STATUS32: 0x%08" PRIx32, value);
@@ -863,22 +863,13 @@ static int arc_save_context(struct target *target)
 		}
 	}
 
-	/* Read data from target. */
-	if (core_cnt > 0) {
-		retval = arc_jtag_read_core_reg(&arc->jtag_info, core_addrs, core_cnt, core_values);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Attempt to read core registers failed.");
-			retval = ERROR_FAIL;
-			goto exit;
-		}
-	}
-	if (aux_cnt > 0) {
-		retval = arc_jtag_read_aux_reg(&arc->jtag_info, aux_addrs, aux_cnt, aux_values);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Attempt to read aux registers failed.");
-			retval = ERROR_FAIL;
-			goto exit;
-		}
+	/* Read data from target, core and aux registers in one go. */
+	retval = arc_jtag_read_core_aux_reg(&arc->jtag_info, core_addrs, core_cnt, core_values,
+		aux_addrs, aux_cnt, aux_values);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Attempt to read core and aux registers failed.");
+		retval = ERROR_FAIL;
+		goto exit;
 	}
 
 	/* Parse core regs */
@@ -1124,7 +1115,7 @@ static int arc_arch_state(struct target *target)
 {
 	uint32_t pc_value;
 
-	if (debug_level < LOG_LVL_DEBUG)
+	if (!LOG_LEVEL_IS(LOG_LVL_DEBUG))
 		return ERROR_OK;
 
 	CHECK_RETVAL(arc_get_register_value(target, "pc", &pc_value));
@@ -1193,21 +1184,13 @@ static int arc_restore_context(struct target *target)
 		}
 	}
 
-	/* Write data to target.
+	/* Write data to target, core and aux registers in one go.
 	 * Check before write, if aux and core count is greater than 0. */
-	if (core_cnt > 0) {
-		retval = arc_jtag_write_core_reg(&arc->jtag_info, core_addrs, core_cnt, core_values);
+	if (core_cnt > 0 || aux_cnt > 0) {
+		retval = arc_jtag_write_core_aux_reg(&arc->jtag_info, core_addrs, core_cnt, core_values,
+			aux_addrs, aux_cnt, aux_values);
 		if (retval != ERROR_OK) {
-			LOG_ERROR("Attempt to write to core registers failed.");
-			retval = ERROR_FAIL;
-			goto exit;
-		}
-	}
-
-	if (aux_cnt > 0) {
-		retval = arc_jtag_write_aux_reg(&arc->jtag_info, aux_addrs, aux_cnt, aux_values);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Attempt to write to aux registers failed.");
+			LOG_ERROR("Attempt to write to core and aux registers failed.");
 			retval = ERROR_FAIL;
 			goto exit;
 		}
@@ -1698,16 +1681,11 @@ static void arc_reset_actionpoints(struct target *target)
 {
 	struct arc_common *arc = target_to_arc(target);
 	struct arc_actionpoint *ap_list = arc->actionpoints_list;
-	struct breakpoint *next_b;
 	struct watchpoint *next_w;
 
-	while (target->breakpoints) {
-		next_b = target->breakpoints->next;
-		arc_remove_breakpoint(target, target->breakpoints);
-		free(target->breakpoints->orig_instr);
-		free(target->breakpoints);
-		target->breakpoints = next_b;
-	}
+	for (struct breakpoint *b = target->breakpoints; b; b = b->next)
+		arc_remove_breakpoint(target, b);
+	breakpoint_forget_all(target);
 	while (target->watchpoints) {
 		next_w = target->watchpoints->next;
 		arc_remove_watchpoint(target, target->watchpoints);
@@ -228,6 +228,35 @@ static void arc_jtag_enque_register_rw(struct arc_jtag *jtag_info, uint32_t *add
 	arc_jtag_enque_reset_transaction(jtag_info);
 }
 
+/* Queue the write of registers of one type, see arc_jtag_write_registers(). */
+static void arc_jtag_enque_write_registers(struct arc_jtag *jtag_info, uint32_t type,
+	uint32_t *addr, uint32_t count, const uint32_t *buffer)
+{
+	arc_jtag_enque_reset_transaction(jtag_info);
+
+	/* What registers are we writing to? */
+	const uint32_t transaction = (type == ARC_JTAG_CORE_REG ?
+			ARC_JTAG_WRITE_TO_CORE_REG : ARC_JTAG_WRITE_TO_AUX_REG);
+	arc_jtag_enque_set_transaction(jtag_info, transaction, TAP_DRPAUSE);
+
+	arc_jtag_enque_register_rw(jtag_info, addr, NULL, buffer, count);
+}
+
+/* Queue the read of registers of one type into byte-buffer, see
+ * arc_jtag_read_registers(). */
+static void arc_jtag_enque_read_registers(struct arc_jtag *jtag_info, uint32_t type,
+	uint32_t *addr, uint32_t count, uint8_t *data_buf)
+{
+	arc_jtag_enque_reset_transaction(jtag_info);
+
+	/* What type of registers we are reading? */
+	const uint32_t transaction = (type == ARC_JTAG_CORE_REG ?
+			ARC_JTAG_READ_FROM_CORE_REG : ARC_JTAG_READ_FROM_AUX_REG);
+	arc_jtag_enque_set_transaction(jtag_info, transaction, TAP_DRPAUSE);
+
+	arc_jtag_enque_register_rw(jtag_info, addr, data_buf, NULL, count);
+}
+
 /**
  * Write registers. addr is an array of addresses, and those addresses can be
  * in any order, though it is recommended that they are in sequential order
@@ -251,14 +280,7 @@ static int arc_jtag_write_registers(struct arc_jtag *jtag_info, uint32_t type,
 		return ERROR_FAIL;
 	}
 
-	arc_jtag_enque_reset_transaction(jtag_info);
-
-	/* What registers are we writing to? */
-	const uint32_t transaction = (type == ARC_JTAG_CORE_REG ?
-			ARC_JTAG_WRITE_TO_CORE_REG : ARC_JTAG_WRITE_TO_AUX_REG);
-	arc_jtag_enque_set_transaction(jtag_info, transaction, TAP_DRPAUSE);
-
-	arc_jtag_enque_register_rw(jtag_info, addr, NULL, buffer, count);
+	arc_jtag_enque_write_registers(jtag_info, type, addr, count, buffer);
 
 	return jtag_execute_queue();
 }
@@ -291,16 +313,13 @@ static int arc_jtag_read_registers(struct arc_jtag *jtag_info, uint32_t type,
 		return ERROR_FAIL;
 	}
 
-	arc_jtag_enque_reset_transaction(jtag_info);
-
-	/* What type of registers we are reading? */
-	const uint32_t transaction = (type == ARC_JTAG_CORE_REG ?
-			ARC_JTAG_READ_FROM_CORE_REG : ARC_JTAG_READ_FROM_AUX_REG);
-	arc_jtag_enque_set_transaction(jtag_info, transaction, TAP_DRPAUSE);
-
 	uint8_t *data_buf = calloc(sizeof(uint8_t), count * 4);
+	if (!data_buf) {
+		LOG_ERROR("Unable to allocate memory");
+		return ERROR_FAIL;
+	}
 
-	arc_jtag_enque_register_rw(jtag_info, addr, data_buf, NULL, count);
+	arc_jtag_enque_read_registers(jtag_info, type, addr, count, data_buf);
 
 	retval = jtag_execute_queue();
 	if (retval != ERROR_OK) {
@@ -418,6 +437,96 @@ int arc_jtag_read_aux_reg(struct arc_jtag *jtag_info, uint32_t *addr,
 			buffer);
 }
 
+/**
+ * Write core and AUX registers with a single JTAG queue execution. Arrays are
+ * the same as for arc_jtag_write_core_reg() and arc_jtag_write_aux_reg(),
+ * either count can be 0.
+ *
+ * @param jtag_info
+ * @param core_addr	Array of core register numbers.
+ * @param core_count	Amount of core registers.
+ * @param core_buffer	Array of core register values.
+ * @param aux_addr	Array of AUX register numbers.
+ * @param aux_count	Amount of AUX registers.
+ * @param aux_buffer	Array of AUX register values.
+ */
+int arc_jtag_write_core_aux_reg(struct arc_jtag *jtag_info,
+	uint32_t *core_addr, uint32_t core_count, const uint32_t *core_buffer,
+	uint32_t *aux_addr, uint32_t aux_count, const uint32_t *aux_buffer)
+{
+	assert(jtag_info);
+	assert(jtag_info->tap);
+
+	if (core_count)
+		arc_jtag_enque_write_registers(jtag_info, ARC_JTAG_CORE_REG, core_addr,
+			core_count, core_buffer);
+	if (aux_count)
+		arc_jtag_enque_write_registers(jtag_info, ARC_JTAG_AUX_REG, aux_addr,
+			aux_count, aux_buffer);
+
+	return jtag_execute_queue();
+}
+
+/**
+ * Read core and AUX registers with a single JTAG queue execution, so the
+ * whole register context costs one round trip. Arrays are the same as for
+ * arc_jtag_read_core_reg() and arc_jtag_read_aux_reg(), either count can be 0.
+ *
+ * @param jtag_info
+ * @param core_addr	Array of core register numbers.
+ * @param core_count	Amount of core registers.
+ * @param core_buffer	Array of core register values.
+ * @param aux_addr	Array of AUX register numbers.
+ * @param aux_count	Amount of AUX registers.
+ * @param aux_buffer	Array of AUX register values.
+ */
+int arc_jtag_read_core_aux_reg(struct arc_jtag *jtag_info,
+	uint32_t *core_addr, uint32_t core_count, uint32_t *core_buffer,
+	uint32_t *aux_addr, uint32_t aux_count, uint32_t *aux_buffer)
+{
+	uint32_t i;
+
+	assert(jtag_info);
+	assert(jtag_info->tap);
+
+	LOG_DEBUG("Reading %" PRIu32 " core and %" PRIu32 " aux registers",
+		core_count, aux_count);
+
+	if (!core_count && !aux_count)
+		return ERROR_OK;
+
+	uint8_t *data_buf = calloc(sizeof(uint8_t), (core_count + aux_count) * 4);
+	if (!data_buf) {
+		LOG_ERROR("Unable to allocate memory");
+		return ERROR_FAIL;
+	}
+
+	if (core_count)
+		arc_jtag_enque_read_registers(jtag_info, ARC_JTAG_CORE_REG, core_addr,
+			core_count, data_buf);
+	if (aux_count)
+		arc_jtag_enque_read_registers(jtag_info, ARC_JTAG_AUX_REG, aux_addr,
+			aux_count, data_buf + core_count * 4);
+
+	int retval = jtag_execute_queue();
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Failed to execute jtag queue: %d", retval);
+		retval = ERROR_FAIL;
+		goto exit;
+	}
+
+	/* Convert byte-buffers to host presentation. */
+	for (i = 0; i < core_count; i++)
+		core_buffer[i] = buf_get_u32(data_buf + 4 * i, 0, 32);
+	for (i = 0; i < aux_count; i++)
+		aux_buffer[i] = buf_get_u32(data_buf + 4 * (core_count + i), 0, 32);
+
+exit:
+	free(data_buf);
+
+	return retval;
+}
+
 /**
  * Write a sequence of 4-byte words into target memory.
  *
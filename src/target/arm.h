@@ -19,6 +19,7 @@
 
 #include <helper/command.h>
 #include "target.h"
+#include "arm_tlb.h"
 
 /**
  * @file
@@ -207,6 +208,9 @@ struct arm {
 	/** Handle for the Embedded Trace Module, if one is present. */
 	struct etm_context *etm;
 
+	/** Cache of the address translations done by the core. */
+	struct arm_tlb tlb;
+
 	/* FIXME all these methods should take "struct arm *" not target */
 
 	/** Retrieve all core registers, for display. */
@@ -301,6 +305,11 @@ int armv4_5_run_algorithm_inner(struct target *target,
 		int (*run_it)(struct target *target, uint32_t exit_point,
 				int timeout_ms, void *arch_info));
 
+/* Working area the table driven CRC loaders build their tables in, and the
+ * region size from which building them on the target is worth it. */
+#define ARM_CRC_TABLE_SIZE		(4 * 256 * sizeof(uint32_t))
+#define ARM_CRC_TABLE_MIN_COUNT	1024
+
 int arm_checksum_memory(struct target *target,
 		target_addr_t address, uint32_t count, uint32_t *checksum);
 int arm_blank_check_memory(struct target *target,
@@ -866,7 +866,11 @@ static int arm11_read_memory_inner(struct target *target,
 
 			/* LDC p14,c5,[R0],#4 */
 			/* LDC p14,c5,[R0] */
-			CHECK_RETVAL(arm11_run_instr_data_from_core(arm11, instr, words, count));
+			if (arm11->memread_burst && count > 1)
+				CHECK_RETVAL(arm11_run_instr_data_from_core_noack(arm11, instr,
+						words, count));
+			else
+				CHECK_RETVAL(arm11_run_instr_data_from_core(arm11, instr, words, count));
 			break;
 		}
 	}
@@ -1107,6 +1111,7 @@ static int arm11_target_create(struct target *target, Jim_Interp *interp)
 	arm11->jtag_info.intest_instr = ARM11_INTEST;
 
 	arm11->memwrite_burst = true;
+	arm11->memread_burst = false;
 	arm11->memwrite_error_fatal = true;
 
 	return ERROR_OK;
@@ -1243,6 +1248,7 @@ static int arm11_examine(struct target *target)
 	}
 
 ARM11_BOOL_WRAPPER(memwrite_burst, "memory write burst mode")
+ARM11_BOOL_WRAPPER(memread_burst, "memory read burst mode")
 ARM11_BOOL_WRAPPER(memwrite_error_fatal, "fatal error mode for memory writes")
 ARM11_BOOL_WRAPPER(step_irq_enable, "IRQs while stepping")
 ARM11_BOOL_WRAPPER(hardware_step, "hardware single step")
@@ -1290,6 +1296,17 @@ static const struct command_registration arm11_mw_command_handlers[] = {
 	},
 	COMMAND_REGISTRATION_DONE
 };
+static const struct command_registration arm11_mr_command_handlers[] = {
+	{
+		.name = "burst",
+		.handler = arm11_handle_bool_memread_burst,
+		.mode = COMMAND_ANY,
+		.help = "Display or modify flag controlling potentially "
+			"risky fast burst mode for word reads (default: disabled)",
+		.usage = "['enable'|'disable']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
 static const struct command_registration arm11_any_command_handlers[] = {
 	{
 		/* "hardware_step" is only here to check if the default
@@ -1302,6 +1319,13 @@ static const struct command_registration arm11_any_command_handlers[] = {
 			" (default: disabled)",
 		.usage = "['enable'|'disable']",
 	},
+	{
+		.name = "memread",
+		.mode = COMMAND_ANY,
+		.help = "memread command group",
+		.usage = "",
+		.chain = arm11_mr_command_handlers,
+	},
 	{
 		.name = "memwrite",
 		.mode = COMMAND_ANY,
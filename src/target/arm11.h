@@ -59,6 +59,7 @@ struct arm11_common {
 	 * once the relevant code is known to work correctly.
 	 */
 	bool memwrite_burst;
+	bool memread_burst;
 	bool memwrite_error_fatal;
 	bool step_irq_enable;
 	bool hardware_step;
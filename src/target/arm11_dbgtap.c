@@ -529,7 +529,8 @@ int arm11_run_instr_data_to_core(struct arm11_common *arm11,
 	return ERROR_OK;
 }
 
-/** JTAG path for arm11_run_instr_data_to_core_noack
+/** JTAG path for arm11_run_instr_data_to_core_noack and
+ *  arm11_run_instr_data_from_core_noack
  *
  *  The repeated TAP_IDLE's do not cause a repeated execution
  *  if passed without leaving the state.
@@ -540,6 +541,7 @@ int arm11_run_instr_data_to_core(struct arm11_common *arm11,
  *  the core but still shorter than any manually inducible delays.
  *
  *  To disable this code, try "memwrite burst false"
+ *  (reads only use it after "memread burst true")
  *
  *  FIX!!! should we use multiple TAP_IDLE here or not???
  *
@@ -551,10 +553,19 @@ static const tap_state_t arm11_move_drpause_idle_drpause_with_delay[] = {
 	TAP_DRSHIFT
 };
 
-static int arm11_run_instr_data_to_core_noack_inner(struct jtag_tap *tap,
-	uint32_t opcode,
-	uint32_t *data,
-	size_t count)
+/* Queue one chain 5 DR scan per data word, each followed by the delayed
+ * pass through TAP_IDLE that executes the instruction in ITR again, and
+ * check all the Ready flags after a single flush.
+ *
+ * \p data_out words are shifted into DTR (instruction reads DTR), or
+ * \p data_in receives the DTR captured before each execution (instruction
+ * writes DTR). \p last_state is the end state of the final scan.
+ */
+static int arm11_run_instr_data_burst_inner(struct jtag_tap *tap,
+	const uint32_t *data_out,
+	uint32_t *data_in,
+	size_t count,
+	tap_state_t last_state)
 {
 	struct scan_field chain5_fields[3];
 
@@ -582,7 +593,10 @@ static int arm11_run_instr_data_to_core_noack_inner(struct jtag_tap *tap,
 
 	uint8_t *ready_pos                      = readies;
 	while (count--) {
-		chain5_fields[0].out_value      = (uint8_t *)(data++);
+		if (data_out)
+			chain5_fields[0].out_value      = (const uint8_t *)(data_out++);
+		if (data_in)
+			chain5_fields[0].in_value       = (uint8_t *)(data_in++);
 		chain5_fields[1].in_value       = ready_pos++;
 
 		if (count > 0) {
@@ -591,7 +605,7 @@ static int arm11_run_instr_data_to_core_noack_inner(struct jtag_tap *tap,
 			jtag_add_pathmove(ARRAY_SIZE(arm11_move_drpause_idle_drpause_with_delay),
 				arm11_move_drpause_idle_drpause_with_delay);
 		} else
-			jtag_add_dr_scan(tap, ARRAY_SIZE(chain5_fields), chain5_fields, TAP_IDLE);
+			jtag_add_dr_scan(tap, ARRAY_SIZE(chain5_fields), chain5_fields, last_state);
 	}
 
 	int retval = jtag_execute_queue();
@@ -644,10 +658,8 @@ int arm11_run_instr_data_to_core_noack(struct arm11_common *arm11,
 
 	arm11_add_ir(arm11, ARM11_EXTEST, ARM11_TAP_DEFAULT);
 
-	int retval = arm11_run_instr_data_to_core_noack_inner(arm11->arm.target->tap,
-			opcode,
-			data,
-			count);
+	int retval = arm11_run_instr_data_burst_inner(arm11->arm.target->tap,
+			data, NULL, count, TAP_IDLE);
 
 	if (retval != ERROR_OK)
 		return retval;
@@ -778,6 +790,38 @@ int arm11_run_instr_data_from_core(struct arm11_common *arm11,
 	return ERROR_OK;
 }
 
+/** Execute one instruction via ITR repeatedly while
+ *  reading data from the core via DTR on each execution.
+ *
+ * Same preconditions as arm11_run_instr_data_from_core(), but without
+ * a Ready check per word: all the words are read in a single JTAG flush
+ * and the Ready flags are only checked afterwards.
+ *
+ *  The executed instruction \em must write data to DTR.
+ *
+ * \pre arm11_run_instr_data_prepare() /  arm11_run_instr_data_finish() block
+ *
+ * \param arm11		Target state variable.
+ * \param opcode	ARM opcode
+ * \param data		Pointer to an array that receives the data words from the core
+ * \param count		Number of data words and instruction repetitions
+ *
+ */
+int arm11_run_instr_data_from_core_noack(struct arm11_common *arm11,
+	uint32_t opcode,
+	uint32_t *data,
+	size_t count)
+{
+	arm11_add_ir(arm11, ARM11_ITRSEL, ARM11_TAP_DEFAULT);
+
+	arm11_add_debug_inst(arm11, opcode, NULL, TAP_IDLE);
+
+	arm11_add_ir(arm11, ARM11_INTEST, ARM11_TAP_DEFAULT);
+
+	return arm11_run_instr_data_burst_inner(arm11->arm.target->tap,
+			NULL, data, count, TAP_DRPAUSE);
+}
+
 /** Execute one instruction via ITR
  *  then load r0 into DTR and read DTR from core.
  *
@@ -704,18 +704,26 @@ static int arm7_9_execute_fast_sys_speed(struct target *target)
  * @param size The number of 32bit words to be read
  * @param buffer Pointer to the buffer that will hold the data
  * @return The result of receiving data from the Embedded ICE unit
+ *
+ * The DCC control register is read after the data, for
+ * arm7_9_handle_target_request() to see if there is another request.
  */
 int arm7_9_target_request_data(struct target *target, uint32_t size, uint8_t *buffer)
 {
 	struct arm7_9_common *arm7_9 = target_to_arm7_9(target);
 	struct arm_jtag *jtag_info = &arm7_9->jtag_info;
+	struct reg *dcc_control = &arm7_9->eice_cache->reg_list[EICE_COMMS_CTRL];
 	uint32_t *data;
 	int retval = ERROR_OK;
 	uint32_t i;
 
 	data = malloc(size * (sizeof(uint32_t)));
+	if (!data) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 
-	retval = embeddedice_receive(jtag_info, data, size);
+	retval = embeddedice_receive_ctrl(jtag_info, data, size, dcc_control->value);
 
 	/* return the 32-bit ints in the 8-bit array */
 	for (i = 0; i < size; i++)
@@ -726,11 +734,18 @@ int arm7_9_target_request_data(struct target *target, uint32_t size, uint8_t *bu
 	return retval;
 }
 
+/* requests drained per poll of the DCC, the other timers get their turn then */
+#define ARM7_9_DCC_MAX_REQUESTS_PER_POLL 256
+
 /**
  * Handles requests to an ARM7/9 target.  If debug messaging is enabled, the
  * target is running and the DCC control register has the W bit high, this will
  * execute the request on the target.
  *
+ * Drains up to ARM7_9_DCC_MAX_REQUESTS_PER_POLL requests while the target
+ * keeps writing them, the DCC control register is read together with each
+ * request and its data.
+ *
  * @param priv Void pointer expected to be a struct target pointer
  * @return ERROR_OK unless there are issues with the JTAG queue or when reading
  * from the Embedded ICE unit
@@ -755,16 +770,19 @@ static int arm7_9_handle_target_request(void *priv)
 		if (retval != ERROR_OK)
 			return retval;
 
-		/* check W bit */
-		if (buf_get_u32(dcc_control->value, 1, 1) == 1) {
+		/* check W bit, target_request() reads the data of a request with the control register */
+		for (unsigned int i = 0; i < ARM7_9_DCC_MAX_REQUESTS_PER_POLL &&
+				buf_get_u32(dcc_control->value, 1, 1) == 1; i++) {
 			uint32_t request;
 
-			retval = embeddedice_receive(jtag_info, &request, 1);
+			retval = embeddedice_receive_ctrl(jtag_info, &request, 1, dcc_control->value);
 			if (retval != ERROR_OK)
 				return retval;
 			retval = target_request(target, request);
 			if (retval != ERROR_OK)
 				return retval;
+			if (!target->dbg_msg_enabled)
+				break;
 		}
 	}
 
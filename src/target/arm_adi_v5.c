@@ -57,6 +57,8 @@
  * Cortex-M3(tm) TRM, ARM DDI 0337G
  */
 
+#define LOG_CATEGORY LOG_CAT_DAP
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -73,6 +75,11 @@
 #include <helper/list.h>
 #include <helper/jim-nvp.h>
 
+struct metric dap_run_metric = METRIC_HISTOGRAM("dap_run_microseconds",
+		"Time taken to run the queued DAP transactions");
+struct metric dap_run_errors = METRIC_COUNTER("dap_run_errors_total",
+		"Failed runs of the queued DAP transactions");
+
 /* ARM ADI Specification requires at least 10 bits used for TAR autoincrement  */
 
 /*
@@ -84,6 +91,18 @@ static uint32_t max_tar_block_size(uint32_t tar_autoincr_block, target_addr_t ad
 	return tar_autoincr_block - ((tar_autoincr_block - 1) & address);
 }
 
+/*
+ * Check if the next DRW access of a block transfer can move a whole word of
+ * packed 8 or 16 bits elements. A packed access must not cross the TAR
+ * auto-increment boundary.
+ */
+static bool mem_ap_packed_transfer_possible(struct adiv5_ap *ap, size_t nbytes,
+		target_addr_t address, bool addrinc)
+{
+	return addrinc && ap->packed_transfers && nbytes >= 4
+		&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4;
+}
+
 /***************************************************************************
  *                                                                         *
  * DP and MEM-AP  register access  through APACC and DPACC                 *
@@ -95,6 +114,7 @@ static int mem_ap_setup_csw(struct adiv5_ap *ap, uint32_t csw)
 	csw |= ap->csw_default;
 
 	if (csw != ap->csw_value) {
+		ap->dap->cache_stats.csw_writes++;
 		/* LOG_DEBUG("DAP: Set CSW %x",csw); */
 		int retval = dap_queue_ap_write(ap, MEM_AP_REG_CSW(ap->dap), csw);
 		if (retval != ERROR_OK) {
@@ -102,6 +122,8 @@ static int mem_ap_setup_csw(struct adiv5_ap *ap, uint32_t csw)
 			return retval;
 		}
 		ap->csw_value = csw;
+	} else {
+		ap->dap->cache_stats.csw_elided++;
 	}
 	return ERROR_OK;
 }
@@ -109,6 +131,7 @@ static int mem_ap_setup_csw(struct adiv5_ap *ap, uint32_t csw)
 static int mem_ap_setup_tar(struct adiv5_ap *ap, target_addr_t tar)
 {
 	if (!ap->tar_valid || tar != ap->tar_value) {
+		ap->dap->cache_stats.tar_writes++;
 		/* LOG_DEBUG("DAP: Set TAR %x",tar); */
 		int retval = dap_queue_ap_write(ap, MEM_AP_REG_TAR(ap->dap), (uint32_t)(tar & 0xffffffffUL));
 		if (retval == ERROR_OK && is_64bit_ap(ap)) {
@@ -122,6 +145,8 @@ static int mem_ap_setup_tar(struct adiv5_ap *ap, target_addr_t tar)
 		}
 		ap->tar_value = tar;
 		ap->tar_valid = true;
+	} else {
+		ap->dap->cache_stats.tar_elided++;
 	}
 	return ERROR_OK;
 }
@@ -320,18 +345,10 @@ int mem_ap_write_atomic_u32(struct adiv5_ap *ap, target_addr_t address,
 }
 
 /**
- * Synchronous write of a block of memory, using a specific access size.
- *
- * @param ap The MEM-AP to access.
- * @param buffer The data buffer to write. No particular alignment is assumed.
- * @param size Which access size to use, in bytes. 1, 2 or 4.
- * @param count The number of writes to do (in size units, not bytes).
- * @param address Address to be written; it must be writable by the currently selected MEM-AP.
- * @param addrinc Whether the target address should be increased for each write or not. This
- *  should normally be true, except when writing to e.g. a FIFO.
- * @return ERROR_OK on success, otherwise an error code.
+ * Queue the writes of a block of memory, using a specific access size,
+ * without running the queue. See mem_ap_write() for the parameters.
  */
-static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t size, uint32_t count,
+static int mem_ap_write_queue(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t size, uint32_t count,
 		target_addr_t address, bool addrinc)
 {
 	struct adiv5_dap *dap = ap->dap;
@@ -374,8 +391,7 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
 		uint32_t this_size = size;
 
 		/* Select packed transfer if possible */
-		if (addrinc && ap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
+		if (mem_ap_packed_transfer_possible(ap, nbytes, address, addrinc)) {
 			this_size = 4;
 			retval = mem_ap_setup_csw(ap, csw_size | CSW_ADDRINC_PACKED);
 		} else {
@@ -454,9 +470,30 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
 			address += this_size;
 	}
 
-	/* REVISIT: Might want to have a queued version of this function that does not run. */
+	return retval;
+}
+
+/**
+ * Synchronous write of a block of memory, using a specific access size.
+ *
+ * @param ap The MEM-AP to access.
+ * @param buffer The data buffer to write. No particular alignment is assumed.
+ * @param size Which access size to use, in bytes. 1, 2 or 4.
+ * @param count The number of writes to do (in size units, not bytes).
+ * @param address Address to be written; it must be writable by the currently selected MEM-AP.
+ * @param addrinc Whether the target address should be increased for each write or not. This
+ *  should normally be true, except when writing to e.g. a FIFO.
+ * @return ERROR_OK on success, otherwise an error code.
+ */
+static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t size, uint32_t count,
+		target_addr_t address, bool addrinc)
+{
+	int retval = mem_ap_write_queue(ap, buffer, size, count, address, addrinc);
+	if (retval == ERROR_TARGET_UNALIGNED_ACCESS)
+		return retval;
+
 	if (retval == ERROR_OK)
-		retval = dap_run(dap);
+		retval = dap_run(ap->dap);
 
 	if (retval != ERROR_OK) {
 		target_addr_t tar;
@@ -469,20 +506,27 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
 	return retval;
 }
 
+/** A queued block read, unpacked into the caller's buffer after the run. */
+struct mem_ap_deferred_read {
+	struct list_head lh;
+	struct adiv5_ap *ap;
+	uint8_t *buffer;
+	uint32_t size;
+	uint32_t count;
+	target_addr_t address;
+	bool addrinc;
+	/** DRW words the queued reads land in */
+	uint32_t *read_buf;
+};
+
 /**
- * Synchronous read of a block of memory, using a specific access size.
- *
- * @param ap The MEM-AP to access.
- * @param buffer The data buffer to receive the data. No particular alignment is assumed.
- * @param size Which access size to use, in bytes. 1, 2 or 4.
- * @param count The number of reads to do (in size units, not bytes).
- * @param adr Address to be read; it must be readable by the currently selected MEM-AP.
- * @param addrinc Whether the target address should be increased after each read or not. This
- *  should normally be true, except when reading from e.g. a FIFO.
- * @return ERROR_OK on success, otherwise an error code.
+ * Queue the DRW reads for a block of memory, using a specific access size.
+ * The raw DRW words are stored in a newly allocated buffer returned in
+ * @a read_buf, which mem_ap_read_unpack() turns into the data once the
+ * queue has been run. The caller owns and frees @a read_buf.
  */
-static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint32_t count,
-		target_addr_t adr, bool addrinc)
+static int mem_ap_read_queue(struct adiv5_ap *ap, uint32_t size, uint32_t count,
+		target_addr_t adr, bool addrinc, uint32_t **read_buf)
 {
 	struct adiv5_dap *dap = ap->dap;
 	size_t nbytes = size * count;
@@ -491,6 +535,8 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 	target_addr_t address = adr;
 	int retval = ERROR_OK;
 
+	*read_buf = NULL;
+
 	/* TI BE-32 Quirks mode:
 	 * Reads on big-endian TMS570 behave strangely differently than writes.
 	 * They read from the physical address requested, but with DRW byte-reversed.
@@ -510,16 +556,27 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 	if (ap->unaligned_access_bad && (adr % size != 0))
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
-	/* Allocate buffer to hold the sequence of DRW reads that will be made. This is a significant
-	 * over-allocation if packed transfers are going to be used, but determining the real need at
-	 * this point would be messy. */
-	uint32_t *read_buf = calloc(count, sizeof(uint32_t));
+	/* Allocate buffer to hold the sequence of DRW reads that will be made. With packed
+	 * transfers a single read covers up to four elements, so walk the transfer once to
+	 * size the buffer instead of allocating a word per element. */
+	size_t drw_reads = 0;
+	for (size_t left = nbytes; left > 0; drw_reads++) {
+		uint32_t this_size = size;
+		if (mem_ap_packed_transfer_possible(ap, left, address, addrinc))
+			this_size = 4;
+		left -= this_size;
+		if (addrinc)
+			address += this_size;
+	}
+	address = adr;
+
 	/* Multiplication count * sizeof(uint32_t) may overflow, calloc() is safe */
-	uint32_t *read_ptr = read_buf;
-	if (!read_buf) {
+	uint32_t *read_ptr = calloc(drw_reads, sizeof(uint32_t));
+	if (!read_ptr) {
 		LOG_ERROR("Failed to allocate read buffer");
 		return ERROR_FAIL;
 	}
+	*read_buf = read_ptr;
 
 	/* Queue up all reads. Each read will store the entire DRW word in the read buffer. How many
 	 * useful bytes it contains, and their location in the word, depends on the type of transfer
@@ -528,8 +585,7 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 		uint32_t this_size = size;
 
 		/* Select packed transfer if possible */
-		if (addrinc && ap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
+		if (mem_ap_packed_transfer_possible(ap, nbytes, address, addrinc)) {
 			this_size = 4;
 			retval = mem_ap_setup_csw(ap, csw_size | CSW_ADDRINC_PACKED);
 		} else {
@@ -553,37 +609,23 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 		mem_ap_update_tar_cache(ap);
 	}
 
-	if (retval == ERROR_OK)
-		retval = dap_run(dap);
-
-	/* Restore state */
-	address = adr;
-	nbytes = size * count;
-	read_ptr = read_buf;
+	return retval;
+}
 
-	/* If something failed, read TAR to find out how much data was successfully read, so we can
-	 * at least give the caller what we have. */
-	if (retval != ERROR_OK) {
-		target_addr_t tar;
-		if (mem_ap_read_tar(ap, &tar) == ERROR_OK) {
-			/* TAR is incremented after failed transfer on some devices (eg Cortex-M4) */
-			LOG_ERROR("Failed to read memory at " TARGET_ADDR_FMT, tar);
-			if (nbytes > tar - address)
-				nbytes = tar - address;
-		} else {
-			LOG_ERROR("Failed to read memory and, additionally, failed to find out where");
-			nbytes = 0;
-		}
-	}
+/**
+ * Populate the caller's buffer with @a nbytes of data from the DRW words
+ * collected by mem_ap_read_queue(), picking the correct word and byte lane.
+ */
+static void mem_ap_read_unpack(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size,
+		size_t nbytes, target_addr_t address, bool addrinc, const uint32_t *read_ptr)
+{
+	struct adiv5_dap *dap = ap->dap;
 
-	/* Replay loop to populate caller's buffer from the correct word and byte lane */
 	while (nbytes > 0) {
 		uint32_t this_size = size;
 
-		if (addrinc && ap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
+		if (mem_ap_packed_transfer_possible(ap, nbytes, address, addrinc))
 			this_size = 4;
-		}
 
 		if (dap->ti_be_32_quirks) {
 			switch (this_size) {
@@ -614,6 +656,49 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 		read_ptr++;
 		nbytes -= this_size;
 	}
+}
+
+/**
+ * Synchronous read of a block of memory, using a specific access size.
+ *
+ * @param ap The MEM-AP to access.
+ * @param buffer The data buffer to receive the data. No particular alignment is assumed.
+ * @param size Which access size to use, in bytes. 1, 2 or 4.
+ * @param count The number of reads to do (in size units, not bytes).
+ * @param adr Address to be read; it must be readable by the currently selected MEM-AP.
+ * @param addrinc Whether the target address should be increased after each read or not. This
+ *  should normally be true, except when reading from e.g. a FIFO.
+ * @return ERROR_OK on success, otherwise an error code.
+ */
+static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint32_t count,
+		target_addr_t adr, bool addrinc)
+{
+	size_t nbytes = size * count;
+	uint32_t *read_buf;
+
+	int retval = mem_ap_read_queue(ap, size, count, adr, addrinc, &read_buf);
+	if (!read_buf)
+		return retval;
+
+	if (retval == ERROR_OK)
+		retval = dap_run(ap->dap);
+
+	/* If something failed, read TAR to find out how much data was successfully read, so we can
+	 * at least give the caller what we have. */
+	if (retval != ERROR_OK) {
+		target_addr_t tar;
+		if (mem_ap_read_tar(ap, &tar) == ERROR_OK) {
+			/* TAR is incremented after failed transfer on some devices (eg Cortex-M4) */
+			LOG_ERROR("Failed to read memory at " TARGET_ADDR_FMT, tar);
+			if (nbytes > tar - adr)
+				nbytes = tar - adr;
+		} else {
+			LOG_ERROR("Failed to read memory and, additionally, failed to find out where");
+			nbytes = 0;
+		}
+	}
+
+	mem_ap_read_unpack(ap, buffer, size, nbytes, adr, addrinc, read_buf);
 
 	free(read_buf);
 	return retval;
@@ -643,6 +728,80 @@ int mem_ap_write_buf_noincr(struct adiv5_ap *ap,
 	return mem_ap_write(ap, buffer, size, count, address, false);
 }
 
+static int mem_ap_read_queued(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size,
+		uint32_t count, target_addr_t address, bool addrinc)
+{
+	struct adiv5_dap *dap = ap->dap;
+
+	struct mem_ap_deferred_read *read = malloc(sizeof(*read));
+	if (!read) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = mem_ap_read_queue(ap, size, count, address, addrinc, &read->read_buf);
+	if (!read->read_buf) {
+		free(read);
+		return retval;
+	}
+
+	/* Keep the entry even on error, its reads may already be queued */
+	read->ap = ap;
+	read->buffer = buffer;
+	read->size = size;
+	read->count = count;
+	read->address = address;
+	read->addrinc = addrinc;
+	list_add_tail(&read->lh, &dap->deferred_reads);
+
+	return retval;
+}
+
+int mem_ap_read_buf_queued(struct adiv5_ap *ap,
+		uint8_t *buffer, uint32_t size, uint32_t count, target_addr_t address)
+{
+	return mem_ap_read_queued(ap, buffer, size, count, address, true);
+}
+
+int mem_ap_write_buf_queued(struct adiv5_ap *ap,
+		const uint8_t *buffer, uint32_t size, uint32_t count, target_addr_t address)
+{
+	return mem_ap_write_queue(ap, buffer, size, count, address, true);
+}
+
+int mem_ap_read_buf_noincr_queued(struct adiv5_ap *ap,
+		uint8_t *buffer, uint32_t size, uint32_t count, target_addr_t address)
+{
+	return mem_ap_read_queued(ap, buffer, size, count, address, false);
+}
+
+int mem_ap_write_buf_noincr_queued(struct adiv5_ap *ap,
+		const uint8_t *buffer, uint32_t size, uint32_t count, target_addr_t address)
+{
+	return mem_ap_write_queue(ap, buffer, size, count, address, false);
+}
+
+int mem_ap_run_queued(struct adiv5_dap *dap)
+{
+	struct mem_ap_deferred_read *read, *tmp;
+
+	int retval = dap_run(dap);
+	if (retval != ERROR_OK)
+		LOG_ERROR("Failed to access memory");
+
+	list_for_each_entry_safe(read, tmp, &dap->deferred_reads, lh) {
+		if (retval == ERROR_OK)
+			mem_ap_read_unpack(read->ap, read->buffer, read->size,
+					read->size * read->count, read->address, read->addrinc,
+					read->read_buf);
+		list_del(&read->lh);
+		free(read->read_buf);
+		free(read);
+	}
+
+	return retval;
+}
+
 /*--------------------------------------------------------------------------*/
 
 
@@ -651,10 +810,15 @@ int mem_ap_write_buf_noincr(struct adiv5_ap *ap,
 /*--------------------------------------------------------------------------*/
 
 /**
- * Invalidate cached DP select and cached TAR and CSW of all APs
+ * Invalidate cached DP select and cached TAR and CSW of all APs.
+ * Called when the transport loses the DP state: (re)connection, line
+ * reset, power-up of the debug domain. Switching between APs or targets
+ * sharing the DAP does not need it, the SELECT cache tracks the AP and
+ * each AP keeps its own CSW and TAR.
  */
 void dap_invalidate_cache(struct adiv5_dap *dap)
 {
+	dap->cache_stats.invalidations++;
 	dap->select = DP_SELECT_INVALID;
 	dap->last_read = NULL;
 
@@ -1236,6 +1400,366 @@ static int dap_queue_read_reg(enum coresight_access_mode mode, struct adiv5_ap *
 	return mem_ap_read_u32(ap, component_base + reg, value);
 }
 
+/*
+ * Optional persistent cache of the CoreSight topology.
+ *
+ * Parsing the ROM tables reads the identification registers of every
+ * component and every ROM table entry, which on large SoCs means hundreds
+ * of transactions at each examine. When enabled, the values found are
+ * recorded and saved in a file, then used in place of the reads by the
+ * following runs.
+ * The file is keyed on DPIDR and TARGETID of the DP. At each parse the AP
+ * IDR and BASE registers are still read and compared with the cache, and
+ * before the first use the PIDRs of some cached components are read back.
+ * Any mismatch discards the cache, which is then rebuilt.
+ */
+#define DAP_TOPOLOGY_SPOT_CHECKS 3
+
+enum dap_topology_entry_type {
+	DAP_TOPOLOGY_AP,
+	DAP_TOPOLOGY_CS,
+	DAP_TOPOLOGY_ROM,
+};
+
+struct dap_topology_entry {
+	enum dap_topology_entry_type type;
+	uint64_t ap_num;
+	enum coresight_access_mode mode;
+	/* AP: debug base; CS: component base; ROM: ROM table base */
+	target_addr_t base;
+	/* ROM: offset of the entry in the ROM table */
+	unsigned int offset;
+	/* AP: IDR; ROM: value of the entry */
+	uint64_t value;
+	/* CS: identification registers */
+	uint64_t pid;
+	uint32_t cid;
+	uint32_t devarch;
+	uint32_t devid;
+	uint32_t devtype_memtype;
+};
+
+struct dap_topology_cache {
+	char *filename;
+	/* the file has been read */
+	bool loaded;
+	/* the DP ids could be read, the cache can be used */
+	bool usable;
+	/* the spot check of the cached components succeeded */
+	bool checked;
+	/* the entries differ from the file */
+	bool dirty;
+	uint32_t dpidr;
+	uint32_t targetid;
+	struct dap_topology_entry *entries;
+	unsigned int num_entries;
+	unsigned int max_entries;
+	unsigned int hits;
+};
+
+static void dap_topology_cache_clear(struct dap_topology_cache *cache)
+{
+	free(cache->entries);
+	cache->entries = NULL;
+	cache->num_entries = 0;
+	cache->max_entries = 0;
+	cache->dirty = true;
+}
+
+static struct dap_topology_entry *dap_topology_cache_find(struct dap_topology_cache *cache,
+		enum dap_topology_entry_type type, uint64_t ap_num, enum coresight_access_mode mode,
+		target_addr_t base, unsigned int offset)
+{
+	for (unsigned int i = 0; i < cache->num_entries; i++) {
+		struct dap_topology_entry *e = &cache->entries[i];
+
+		if (e->type != type || e->ap_num != ap_num)
+			continue;
+		/* a single AP entry per AP */
+		if (type == DAP_TOPOLOGY_AP)
+			return e;
+		if (e->mode == mode && e->base == base && (type != DAP_TOPOLOGY_ROM || e->offset == offset))
+			return e;
+	}
+
+	return NULL;
+}
+
+/* @returns the topology cache of the DAP, NULL if disabled or not usable */
+static struct dap_topology_cache *dap_topology_cache_get(struct adiv5_dap *dap)
+{
+	struct dap_topology_cache *cache = dap->topology_cache;
+
+	return (cache && cache->usable) ? cache : NULL;
+}
+
+static void dap_topology_cache_add(struct dap_topology_cache *cache,
+		const struct dap_topology_entry *entry)
+{
+	if (cache->num_entries == cache->max_entries) {
+		unsigned int max_entries = cache->max_entries ? 2 * cache->max_entries : 64;
+		struct dap_topology_entry *entries = realloc(cache->entries, max_entries * sizeof(*entries));
+
+		if (!entries) {
+			LOG_ERROR("Out of memory for the CoreSight topology cache");
+			return;
+		}
+		cache->entries = entries;
+		cache->max_entries = max_entries;
+	}
+
+	cache->entries[cache->num_entries++] = *entry;
+	cache->dirty = true;
+}
+
+/* Read DPIDR and TARGETID identifying the DP */
+static int dap_topology_read_dp_ids(struct adiv5_dap *dap, uint32_t *dpidr, uint32_t *targetid)
+{
+	int retval = dap_dp_read_atomic(dap, DP_DPIDR, dpidr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	*targetid = 0;
+	if ((*dpidr & DP_DPIDR_VERSION_MASK) >= (2UL << DP_DPIDR_VERSION_SHIFT))
+		retval = dap_dp_read_atomic(dap, DP_TARGETID, targetid);
+
+	return retval;
+}
+
+static void dap_topology_cache_load(struct adiv5_dap *dap, struct dap_topology_cache *cache)
+{
+	uint32_t dpidr, targetid;
+
+	cache->loaded = true;
+	dap_topology_cache_clear(cache);
+
+	if (dap_topology_read_dp_ids(dap, &dpidr, &targetid) != ERROR_OK) {
+		LOG_WARNING("Failed to read the DP ids, CoreSight topology cache disabled");
+		return;
+	}
+	cache->usable = true;
+	cache->dpidr = dpidr;
+	cache->targetid = targetid;
+
+	FILE *f = fopen(cache->filename, "r");
+	if (!f) {
+		LOG_DEBUG("no CoreSight topology cache in %s", cache->filename);
+		return;
+	}
+
+	bool dp_match = false;
+	bool valid = true;
+	char line[256];
+
+	while (valid && fgets(line, sizeof(line), f)) {
+		struct dap_topology_entry e = { 0 };
+		unsigned int mode;
+		uint64_t base;
+
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '#' || line[0] == '\0')
+			continue;
+
+		if (sscanf(line, "dp 0x%" SCNx32 " 0x%" SCNx32, &dpidr, &targetid) == 2) {
+			dp_match = dpidr == cache->dpidr && targetid == cache->targetid;
+			valid = dp_match;
+			continue;
+		}
+
+		if (sscanf(line, "ap 0x%" SCNx64 " 0x%" SCNx64 " 0x%" SCNx64,
+				&e.ap_num, &e.value, &base) == 3) {
+			e.type = DAP_TOPOLOGY_AP;
+		} else if (sscanf(line, "cs 0x%" SCNx64 " %u 0x%" SCNx64 " 0x%" SCNx64
+				" 0x%" SCNx32 " 0x%" SCNx32 " 0x%" SCNx32 " 0x%" SCNx32,
+				&e.ap_num, &mode, &base, &e.pid, &e.cid, &e.devarch, &e.devid,
+				&e.devtype_memtype) == 8) {
+			e.type = DAP_TOPOLOGY_CS;
+			e.mode = mode;
+		} else if (sscanf(line, "rom 0x%" SCNx64 " %u 0x%" SCNx64 " 0x%x 0x%" SCNx64,
+				&e.ap_num, &mode, &base, &e.offset, &e.value) == 5) {
+			e.type = DAP_TOPOLOGY_ROM;
+			e.mode = mode;
+		} else {
+			valid = false;
+			continue;
+		}
+
+		e.base = base;
+		valid = dp_match && (e.type == DAP_TOPOLOGY_AP || mode <= CS_ACCESS_MEM_AP);
+		if (valid)
+			dap_topology_cache_add(cache, &e);
+	}
+
+	fclose(f);
+
+	if (!valid || !dp_match) {
+		LOG_INFO("CoreSight topology cache %s does not match the DAP", cache->filename);
+		dap_topology_cache_clear(cache);
+		return;
+	}
+
+	cache->dirty = false;
+	LOG_DEBUG("CoreSight topology cache: %u entries loaded", cache->num_entries);
+}
+
+/* Read back the PIDRs of some cached components behind the AP */
+static bool dap_topology_cache_spot_check(struct dap_topology_cache *cache, struct adiv5_ap *ap)
+{
+	unsigned int checks = 0;
+
+	for (unsigned int i = 0; i < cache->num_entries && checks < DAP_TOPOLOGY_SPOT_CHECKS; i++) {
+		const struct dap_topology_entry *e = &cache->entries[i];
+		uint32_t pid0, pid1, pid2;
+
+		if (e->type != DAP_TOPOLOGY_CS || e->ap_num != ap->ap_num || !is_valid_arm_cs_cidr(e->cid))
+			continue;
+
+		int retval = dap_queue_read_reg(e->mode, ap, e->base, ARM_CS_PIDR0, &pid0);
+		if (retval == ERROR_OK)
+			retval = dap_queue_read_reg(e->mode, ap, e->base, ARM_CS_PIDR1, &pid1);
+		if (retval == ERROR_OK)
+			retval = dap_queue_read_reg(e->mode, ap, e->base, ARM_CS_PIDR2, &pid2);
+		if (retval == ERROR_OK)
+			retval = dap_run(ap->dap);
+		if (retval != ERROR_OK)
+			return false;
+
+		uint32_t pid = (pid2 & 0xff) << 16 | (pid1 & 0xff) << 8 | (pid0 & 0xff);
+		if (pid != (e->pid & 0xffffff))
+			return false;
+		checks++;
+	}
+
+	return true;
+}
+
+/* Prepare the topology cache before parsing the ROM tables from the AP */
+static void dap_topology_cache_prepare(struct adiv5_ap *ap)
+{
+	struct dap_topology_cache *cache = ap->dap->topology_cache;
+
+	if (!cache)
+		return;
+
+	if (!cache->loaded)
+		dap_topology_cache_load(ap->dap, cache);
+
+	if (!cache->usable)
+		return;
+
+	if (!cache->checked && cache->num_entries) {
+		if (!dap_topology_cache_spot_check(cache, ap)) {
+			LOG_INFO("CoreSight topology cache %s is stale, rebuilding it", cache->filename);
+			dap_topology_cache_clear(cache);
+		}
+		cache->checked = true;
+	}
+}
+
+/* Compare the AP registers read at each parse with the cache */
+static void dap_topology_cache_check_ap(struct adiv5_ap *ap, target_addr_t dbgbase, uint32_t apid)
+{
+	struct dap_topology_cache *cache = dap_topology_cache_get(ap->dap);
+
+	if (!cache)
+		return;
+
+	struct dap_topology_entry *e = dap_topology_cache_find(cache, DAP_TOPOLOGY_AP, ap->ap_num, 0, 0, 0);
+	if (e && e->value == apid && e->base == dbgbase)
+		return;
+
+	if (e) {
+		LOG_INFO("AP 0x%" PRIx64 " differs from the CoreSight topology cache, rebuilding it",
+			ap->ap_num);
+		dap_topology_cache_clear(cache);
+	}
+
+	struct dap_topology_entry entry = {
+		.type = DAP_TOPOLOGY_AP,
+		.ap_num = ap->ap_num,
+		.base = dbgbase,
+		.value = apid,
+	};
+	dap_topology_cache_add(cache, &entry);
+}
+
+static void dap_topology_cache_save(struct adiv5_dap *dap)
+{
+	struct dap_topology_cache *cache = dap_topology_cache_get(dap);
+
+	if (!cache || !cache->dirty)
+		return;
+
+	FILE *f = fopen(cache->filename, "w");
+	if (!f) {
+		LOG_WARNING("unable to write the CoreSight topology cache %s", cache->filename);
+		return;
+	}
+
+	fprintf(f, "# OpenOCD CoreSight topology cache, written by '%s topology_cache'\n",
+		adiv5_dap_name(dap));
+	fprintf(f, "dp 0x%08" PRIx32 " 0x%08" PRIx32 "\n", cache->dpidr, cache->targetid);
+	for (unsigned int i = 0; i < cache->num_entries; i++) {
+		const struct dap_topology_entry *e = &cache->entries[i];
+
+		switch (e->type) {
+		case DAP_TOPOLOGY_AP:
+			fprintf(f, "ap 0x%" PRIx64 " 0x%08" PRIx64 " 0x%" PRIx64 "\n",
+				e->ap_num, e->value, (uint64_t)e->base);
+			break;
+		case DAP_TOPOLOGY_CS:
+			fprintf(f, "cs 0x%" PRIx64 " %u 0x%" PRIx64 " 0x%010" PRIx64
+				" 0x%08" PRIx32 " 0x%08" PRIx32 " 0x%08" PRIx32 " 0x%08" PRIx32 "\n",
+				e->ap_num, e->mode, (uint64_t)e->base, e->pid,
+				e->cid, e->devarch, e->devid, e->devtype_memtype);
+			break;
+		case DAP_TOPOLOGY_ROM:
+			fprintf(f, "rom 0x%" PRIx64 " %u 0x%" PRIx64 " 0x%x 0x%" PRIx64 "\n",
+				e->ap_num, e->mode, (uint64_t)e->base, e->offset, e->value);
+			break;
+		}
+	}
+
+	if (fclose(f)) {
+		LOG_WARNING("unable to write the CoreSight topology cache %s", cache->filename);
+		return;
+	}
+
+	cache->dirty = false;
+	LOG_DEBUG("CoreSight topology cache: %u hits, %u entries saved",
+		cache->hits, cache->num_entries);
+}
+
+int dap_set_topology_cache(struct adiv5_dap *dap, const char *filename)
+{
+	struct dap_topology_cache *cache = dap->topology_cache;
+
+	if (cache) {
+		free(cache->filename);
+		free(cache->entries);
+		free(cache);
+		dap->topology_cache = NULL;
+	}
+
+	if (!filename)
+		return ERROR_OK;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	cache->filename = strdup(filename);
+	if (!cache->filename) {
+		free(cache);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	dap->topology_cache = cache;
+
+	return ERROR_OK;
+}
+
 /**
  * Read the CoreSight registers needed during ROM Table Parsing (RTP).
  *
@@ -1260,6 +1784,20 @@ static int rtp_read_cs_regs(enum coresight_access_mode mode, struct adiv5_ap *ap
 	v->component_base = component_base;
 	v->mode = mode;
 
+	struct dap_topology_cache *cache = dap_topology_cache_get(ap->dap);
+	const struct dap_topology_entry *e = NULL;
+	if (cache)
+		e = dap_topology_cache_find(cache, DAP_TOPOLOGY_CS, ap->ap_num, mode, component_base, 0);
+	if (e) {
+		v->pid = e->pid;
+		v->cid = e->cid;
+		v->devarch = e->devarch;
+		v->devid = e->devid;
+		v->devtype_memtype = e->devtype_memtype;
+		cache->hits++;
+		return ERROR_OK;
+	}
+
 	/* sort by offset to gain speed */
 
 	/*
@@ -1315,6 +1853,73 @@ static int rtp_read_cs_regs(enum coresight_access_mode mode, struct adiv5_ap *ap
 			| (pid1 & 0xff) << 8
 			| (pid0 & 0xff);
 
+	if (cache) {
+		struct dap_topology_entry entry = {
+			.type = DAP_TOPOLOGY_CS,
+			.ap_num = ap->ap_num,
+			.mode = mode,
+			.base = component_base,
+			.pid = v->pid,
+			.cid = v->cid,
+			.devarch = v->devarch,
+			.devid = v->devid,
+			.devtype_memtype = v->devtype_memtype,
+		};
+		dap_topology_cache_add(cache, &entry);
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Read an entry of a ROM table, from the topology cache when possible.
+ *
+ * @param mode           Method to access the component (AP or MEM-AP).
+ * @param ap             Pointer to AP containing the ROM table.
+ * @param base_address   Base address of the ROM table.
+ * @param offset         Offset of the entry in the ROM table.
+ * @param width          Width of the entries, 32 or 64 bits.
+ * @param romentry       Pointer to store the value of the entry.
+ *
+ * @return ERROR_OK on success, else a fault code.
+ */
+static int rtp_read_rom_entry(enum coresight_access_mode mode, struct adiv5_ap *ap,
+		target_addr_t base_address, unsigned int offset, unsigned int width, uint64_t *romentry)
+{
+	uint32_t romentry_low, romentry_high = 0;
+
+	struct dap_topology_cache *cache = dap_topology_cache_get(ap->dap);
+	const struct dap_topology_entry *e = NULL;
+	if (cache)
+		e = dap_topology_cache_find(cache, DAP_TOPOLOGY_ROM, ap->ap_num, mode, base_address, offset);
+	if (e) {
+		*romentry = e->value;
+		cache->hits++;
+		return ERROR_OK;
+	}
+
+	int retval = dap_queue_read_reg(mode, ap, base_address, offset, &romentry_low);
+	if (retval == ERROR_OK && width == 64)
+		retval = dap_queue_read_reg(mode, ap, base_address, offset + 4, &romentry_high);
+	if (retval == ERROR_OK)
+		retval = dap_run(ap->dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	*romentry = (((uint64_t)romentry_high) << 32) | romentry_low;
+
+	if (cache) {
+		struct dap_topology_entry entry = {
+			.type = DAP_TOPOLOGY_ROM,
+			.ap_num = ap->ap_num,
+			.mode = mode,
+			.base = base_address,
+			.offset = offset,
+			.value = *romentry,
+		};
+		dap_topology_cache_add(cache, &entry);
+	}
+
 	return ERROR_OK;
 }
 
@@ -1755,29 +2360,22 @@ static int rtp_rom_loop(enum coresight_access_mode mode, const struct rtp_ops *o
 	unsigned int offset = 0;
 	while (max_entries--) {
 		uint64_t romentry;
-		uint32_t romentry_low, romentry_high;
 		target_addr_t component_base;
 		unsigned int saved_offset = offset;
 
-		int retval = dap_queue_read_reg(mode, ap, base_address, offset, &romentry_low);
-		offset += 4;
-		if (retval == ERROR_OK && width == 64) {
-			retval = dap_queue_read_reg(mode, ap, base_address, offset, &romentry_high);
-			offset += 4;
-		}
-		if (retval == ERROR_OK)
-			retval = dap_run(ap->dap);
+		int retval = rtp_read_rom_entry(mode, ap, base_address, offset, width, &romentry);
+		offset += width / 8;
 		if (retval != ERROR_OK) {
 			LOG_DEBUG("Failed read ROM table entry");
 			return retval;
 		}
 
+		uint32_t romentry_low = (uint32_t)romentry;
+		uint32_t romentry_high = (uint32_t)(romentry >> 32);
 		if (width == 64) {
-			romentry = (((uint64_t)romentry_high) << 32) | romentry_low;
 			component_base = base_address +
 				((((uint64_t)romentry_high) << 32) | (romentry_low & ARM_CS_ROMENTRY_OFFSET_MASK));
 		} else {
-			romentry = romentry_low;
 			/* "romentry" is signed */
 			component_base = base_address + (int32_t)(romentry_low & ARM_CS_ROMENTRY_OFFSET_MASK);
 			if (!is_64bit_ap(ap))
@@ -1905,6 +2503,7 @@ static int rtp_ap(const struct rtp_ops *ops, struct adiv5_ap *ap, int depth)
 	retval = dap_get_debugbase(ap, &dbgbase, &apid);
 	if (retval != ERROR_OK)
 		return retval;
+	dap_topology_cache_check_ap(ap, dbgbase, apid);
 	retval = rtp_ops_mem_ap_header(ops, retval, ap, dbgbase, apid, depth);
 	if (retval != ERROR_OK)
 		return retval;
@@ -1934,6 +2533,18 @@ static int rtp_ap(const struct rtp_ops *ops, struct adiv5_ap *ap, int depth)
 	return ERROR_OK;
 }
 
+/* Parse the ROM tables from the AP, through the topology cache if enabled */
+static int rtp_walk(const struct rtp_ops *ops, struct adiv5_ap *ap)
+{
+	dap_topology_cache_prepare(ap);
+
+	int retval = rtp_ap(ops, ap, 0);
+
+	dap_topology_cache_save(ap->dap);
+
+	return retval;
+}
+
 /* Actions for command "dap info" */
 
 static int dap_info_ap_header(struct adiv5_ap *ap, int depth, void *priv)
@@ -2131,7 +2742,7 @@ int dap_info_command(struct command_invocation *cmd, struct adiv5_ap *ap)
 		.priv            = cmd,
 	};
 
-	return rtp_ap(&dap_info_ops, ap, 0);
+	return rtp_walk(&dap_info_ops, ap);
 }
 
 /* Actions for dap_lookup_cs_component() */
@@ -2190,7 +2801,7 @@ int dap_lookup_cs_component(struct adiv5_ap *ap, uint8_t type,
 		.priv            = &lookup,
 	};
 
-	int retval = rtp_ap(&dap_lookup_cs_component_ops, ap, 0);
+	int retval = rtp_walk(&dap_lookup_cs_component_ops, ap);
 	if (retval == CORESIGHT_COMPONENT_FOUND) {
 		if (lookup.ap_num != ap->ap_num) {
 			/* TODO: handle search from root ROM table */
@@ -2530,6 +3141,26 @@ COMMAND_HANDLER(dap_memaccess_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(dap_wait_tck_command)
+{
+	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], dap->wait_tck_max);
+		dap->wait_tck = MIN(dap->wait_tck, dap->wait_tck_max);
+	}
+
+	command_print(CMD, "WAIT delay %" PRIu32 " tck (limit %" PRIu32 "), "
+		"%" PRIu64 " WAIT recoveries, %" PRIu64 " replays",
+		dap->wait_tck, dap->wait_tck_max,
+		dap->wait_recoveries, dap->wait_replays);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(dap_apsel_command)
 {
 	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
@@ -2775,6 +3406,50 @@ COMMAND_HANDLER(dap_ti_be_32_quirks_command)
 		"TI BE-32 quirks mode");
 }
 
+COMMAND_HANDLER(dap_topology_cache_command)
+{
+	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		int retval = dap_set_topology_cache(dap, strcmp(CMD_ARGV[0], "none") ? CMD_ARGV[0] : NULL);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	command_print(CMD, "%s", dap->topology_cache ? dap->topology_cache->filename : "none");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(dap_stats_command)
+{
+	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(&dap->cache_stats, 0, sizeof(dap->cache_stats));
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "SELECT: %" PRIu64 " writes (%" PRIu64 " forced by invalid cache), %" PRIu64 " elided",
+		dap->cache_stats.select_writes, dap->cache_stats.select_forced,
+		dap->cache_stats.select_elided);
+	command_print(CMD, "CSW:    %" PRIu64 " writes, %" PRIu64 " elided",
+		dap->cache_stats.csw_writes, dap->cache_stats.csw_elided);
+	command_print(CMD, "TAR:    %" PRIu64 " writes, %" PRIu64 " elided",
+		dap->cache_stats.tar_writes, dap->cache_stats.tar_elided);
+	command_print(CMD, "cache invalidations: %" PRIu64, dap->cache_stats.invalidations);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(dap_nu_npcx_quirks_command)
 {
 	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
@@ -2847,6 +3522,13 @@ const struct command_registration dap_instance_commands[] = {
 			"bus access [0-255]",
 		.usage = "[cycles]",
 	},
+	{
+		.name = "wait_tck",
+		.handler = dap_wait_tck_command,
+		.mode = COMMAND_ANY,
+		.help = "set/get the limit of idle tck learned from JTAG-DP WAIT responses",
+		.usage = "[max_cycles]",
+	},
 	{
 		.name = "ti_be_32_quirks",
 		.handler = dap_ti_be_32_quirks_command,
@@ -2861,5 +3543,19 @@ const struct command_registration dap_instance_commands[] = {
 		.help = "set/get quirks mode for Nuvoton NPCX controllers",
 		.usage = "[enable]",
 	},
+	{
+		.name = "topology_cache",
+		.handler = dap_topology_cache_command,
+		.mode = COMMAND_ANY,
+		.help = "set the file caching the CoreSight topology found in the ROM tables",
+		.usage = "[filename|'none']",
+	},
+	{
+		.name = "stats",
+		.handler = dap_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "display or reset the counters of the DAP SELECT, CSW and TAR caches",
+		.usage = "['reset']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
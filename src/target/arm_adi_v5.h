@@ -20,7 +20,9 @@
  * resources accessed through a MEM-AP.
  */
 
+#include <helper/event_trace.h>
 #include <helper/list.h>
+#include <helper/metrics.h>
 #include "arm_jtag.h"
 #include "helper/bits.h"
 
@@ -329,12 +331,38 @@ struct adiv5_dap {
 	/* number of dap_cmd objects in the pool */
 	size_t cmd_pool_size;
 
+	/** MEM-AP block reads waiting for mem_ap_run_queued() to unpack them */
+	struct list_head deferred_reads;
+
+	/** JTAG-DP: extra idle tck after APACC scans, learned from WAIT responses */
+	uint32_t wait_tck;
+	/** JTAG-DP: limit of wait_tck, 0 replays a stalled queue scan by scan */
+	uint32_t wait_tck_max;
+	/** JTAG-DP: queue runs without WAIT since wait_tck was last lowered */
+	unsigned int wait_clean_runs;
+	/** JTAG-DP: WAIT recoveries and bulk replays of the stalled tail */
+	uint64_t wait_recoveries;
+	uint64_t wait_replays;
+
 	struct jtag_tap *tap;
 	/* Control config */
 	uint32_t dp_ctrl_stat;
 
 	struct adiv5_ap ap[DP_APSEL_MAX + 1];
 
+	/** Accounting of the SELECT, CSW and TAR caches, see "$dap_name stats" */
+	struct {
+		uint64_t select_writes;
+		/** SELECT writes needed because the cache was invalid */
+		uint64_t select_forced;
+		uint64_t select_elided;
+		uint64_t csw_writes;
+		uint64_t csw_elided;
+		uint64_t tar_writes;
+		uint64_t tar_elided;
+		uint64_t invalidations;
+	} cache_stats;
+
 	/* The current manually selected AP by the "dap apsel" command */
 	uint64_t apsel;
 
@@ -396,6 +424,9 @@ struct adiv5_dap {
 
 	/* ADIv6 only field indicating ROM Table address size */
 	unsigned int asize;
+
+	/** Optional persistent cache of the CoreSight topology, or NULL */
+	struct dap_topology_cache *topology_cache;
 };
 
 /**
@@ -481,6 +512,25 @@ static inline bool is_adiv6(const struct adiv5_dap *dap)
 	return dap->adi_version == 6;
 }
 
+/**
+ * Account a lookup in the DP_SELECT cache by a transport bank select.
+ * Must be called before updating dap->select.
+ *
+ * @param dap The DAP
+ * @param hit true if the cached value allows eliding the SELECT write
+ */
+static inline void dap_account_select(struct adiv5_dap *dap, bool hit)
+{
+	if (hit) {
+		dap->cache_stats.select_elided++;
+		return;
+	}
+
+	dap->cache_stats.select_writes++;
+	if (dap->select == DP_SELECT_INVALID)
+		dap->cache_stats.select_forced++;
+}
+
 /**
  * Send an adi-v5 sequence to the DAP.
  *
@@ -512,7 +562,10 @@ static inline int dap_queue_dp_read(struct adiv5_dap *dap,
 		unsigned reg, uint32_t *data)
 {
 	assert(dap->ops);
-	return dap->ops->queue_dp_read(dap, reg, data);
+	int64_t trace_begin = event_trace_begin();
+	int retval = dap->ops->queue_dp_read(dap, reg, data);
+	event_trace_end(EVENT_TRACE_DAP_DP_READ, trace_begin, 0, reg, 0, retval);
+	return retval;
 }
 
 /**
@@ -530,7 +583,10 @@ static inline int dap_queue_dp_write(struct adiv5_dap *dap,
 		unsigned reg, uint32_t data)
 {
 	assert(dap->ops);
-	return dap->ops->queue_dp_write(dap, reg, data);
+	int64_t trace_begin = event_trace_begin();
+	int retval = dap->ops->queue_dp_write(dap, reg, data);
+	event_trace_end(EVENT_TRACE_DAP_DP_WRITE, trace_begin, 0, reg, data, retval);
+	return retval;
 }
 
 /**
@@ -551,7 +607,10 @@ static inline int dap_queue_ap_read(struct adiv5_ap *ap,
 		ap->refcount = 1;
 		LOG_ERROR("BUG: refcount AP#0x%" PRIx64 " used without get", ap->ap_num);
 	}
-	return ap->dap->ops->queue_ap_read(ap, reg, data);
+	int64_t trace_begin = event_trace_begin();
+	int retval = ap->dap->ops->queue_ap_read(ap, reg, data);
+	event_trace_end(EVENT_TRACE_DAP_AP_READ, trace_begin, ap->ap_num, reg, 0, retval);
+	return retval;
 }
 
 /**
@@ -571,7 +630,10 @@ static inline int dap_queue_ap_write(struct adiv5_ap *ap,
 		ap->refcount = 1;
 		LOG_ERROR("BUG: refcount AP#0x%" PRIx64 " used without get", ap->ap_num);
 	}
-	return ap->dap->ops->queue_ap_write(ap, reg, data);
+	int64_t trace_begin = event_trace_begin();
+	int retval = ap->dap->ops->queue_ap_write(ap, reg, data);
+	event_trace_end(EVENT_TRACE_DAP_AP_WRITE, trace_begin, ap->ap_num, reg, data, retval);
+	return retval;
 }
 
 /**
@@ -591,6 +653,10 @@ static inline int dap_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 	return dap->ops->queue_ap_abort(dap, ack);
 }
 
+/* time taken by dap_run(), in microseconds, and its failures */
+extern struct metric dap_run_metric;
+extern struct metric dap_run_errors;
+
 /**
  * Perform all queued DAP operations, and clear any errors posted in the
  * CTRL_STAT register when they are done.  Note that if more than one AP
@@ -604,7 +670,13 @@ static inline int dap_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 static inline int dap_run(struct adiv5_dap *dap)
 {
 	assert(dap->ops);
-	return dap->ops->run(dap);
+	int64_t begin = timeval_us();
+	int retval = dap->ops->run(dap);
+	event_trace_end(EVENT_TRACE_DAP_RUN, begin, 0, 0, 0, retval);
+	metric_histogram_add(&dap_run_metric, timeval_us() - begin);
+	if (retval != ERROR_OK)
+		metric_add(&dap_run_errors, 1);
+	return retval;
 }
 
 static inline int dap_sync(struct adiv5_dap *dap)
@@ -680,6 +752,18 @@ int mem_ap_read_buf_noincr(struct adiv5_ap *ap,
 int mem_ap_write_buf_noincr(struct adiv5_ap *ap,
 		const uint8_t *buffer, uint32_t size, uint32_t count, target_addr_t address);
 
+/* Queued MEM-AP memory mapped bus block transfers. A read buffer is only
+ * filled by mem_ap_run_queued(), which runs the DAP queue and must follow. */
+int mem_ap_read_buf_queued(struct adiv5_ap *ap,
+		uint8_t *buffer, uint32_t size, uint32_t count, target_addr_t address);
+int mem_ap_write_buf_queued(struct adiv5_ap *ap,
+		const uint8_t *buffer, uint32_t size, uint32_t count, target_addr_t address);
+int mem_ap_read_buf_noincr_queued(struct adiv5_ap *ap,
+		uint8_t *buffer, uint32_t size, uint32_t count, target_addr_t address);
+int mem_ap_write_buf_noincr_queued(struct adiv5_ap *ap,
+		const uint8_t *buffer, uint32_t size, uint32_t count, target_addr_t address);
+int mem_ap_run_queued(struct adiv5_dap *dap);
+
 /* Initialisation of the debug system, power domains and registers */
 int dap_dp_init(struct adiv5_dap *dap);
 int dap_dp_init_or_reconnect(struct adiv5_dap *dap);
@@ -718,6 +802,9 @@ static inline bool dap_is_multidrop(struct adiv5_dap *dap)
 int dap_lookup_cs_component(struct adiv5_ap *ap,
 			uint8_t type, target_addr_t *addr, int32_t idx);
 
+/* Set the file of the CoreSight topology cache, or disable it with NULL */
+int dap_set_topology_cache(struct adiv5_dap *dap, const char *filename);
+
 struct target;
 
 /* Put debug link into SWD mode */
@@ -5,6 +5,8 @@
  *                                                                         *
  ***************************************************************************/
 
+#define LOG_CATEGORY LOG_CAT_DAP
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -51,6 +53,8 @@ static void dap_instance_init(struct adiv5_dap *dap)
 	}
 	INIT_LIST_HEAD(&dap->cmd_journal);
 	INIT_LIST_HEAD(&dap->cmd_pool);
+	INIT_LIST_HEAD(&dap->deferred_reads);
+	dap->wait_tck_max = 1024;
 }
 
 const char *adiv5_dap_name(struct adiv5_dap *self)
@@ -163,6 +167,7 @@ int dap_cleanup_all(void)
 		}
 		if (dap->ops && dap->ops->quit)
 			dap->ops->quit(dap);
+		dap_set_topology_cache(dap, NULL);
 
 		free(obj->name);
 		free(obj);
@@ -79,6 +79,10 @@ static int dpm_mcr(struct target *target, int cpnum,
 		(int) op1, (int) crn,
 		(int) crm, (int) op2);
 
+	/* may change the translations, e.g. TTBR, TTBCR or SCTLR */
+	if (cpnum == 15)
+		arm_tlb_flush(&arm->tlb);
+
 	/* read DCC into r0; then write coprocessor register from R0 */
 	retval = dpm->instr_write_data_r0(dpm,
 			ARMV4_5_MCR(cpnum, op1, 0, crn, crm, op2),
@@ -337,6 +341,9 @@ int arm_dpm_read_current_registers(struct arm_dpm *dpm)
 	int retval;
 	struct reg *r;
 
+	/* translations of the previous halt are stale */
+	arm_tlb_flush(&arm->tlb);
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		return retval;
@@ -445,6 +452,9 @@ int arm_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 	int retval;
 	bool did_write;
 
+	/* the core may run with other translations */
+	arm_tlb_flush(&arm->tlb);
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		goto done;
@@ -0,0 +1,644 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Streaming decoder of the ITM and DWT packets captured by a TPIU/SWO.
+ *
+ * The payload of each ITM stimulus port is written to an output of its own,
+ * a file or a TCP port, while the ports without output are skipped without
+ * copying them. The DWT periodic PC samples are added to the Cortex-M
+ * profiler of a target, and the exception trace is counted per exception.
+ */
+
+/*
+ * Relevant specifications from ARM include:
+ *
+ * ARMv7-M Architecture Reference Manual, Appendix D4    ARM DDI 0403E
+ * ARMv8-M Architecture Reference Manual, Appendix D1    ARM DDI 0553B
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/bits.h>
+#include <helper/command.h>
+#include <helper/list.h>
+#include <helper/log.h>
+#include <server/server.h>
+#include "arm_itm_decoder.h"
+#include "cortex_m.h"
+#include "target.h"
+
+#define ITM_SERVICE_NAME		"itm_stimulus"
+
+#define ITM_NUM_PORTS			32
+#define ITM_NUM_EXCEPTIONS		512
+#define ITM_SINK_BUF_SIZE		4096
+
+/* a synchronization packet is at least 47 zero bits followed by a one */
+#define ITM_SYNC_ZEROS			5
+#define ITM_SYNC_END			0x80
+#define ITM_OVERFLOW			0x70
+
+/* hardware source packets of the DWT */
+#define ITM_HW_EXCEPTION_TRACE		1
+#define ITM_HW_PC_SAMPLE		2
+#define ITM_HW_EXCEPTION_ENTERED	1
+
+enum arm_itm_state {
+	ITM_STATE_HEADER,
+	ITM_STATE_SYNC,
+	/* the payload of an instrumentation packet */
+	ITM_STATE_SWIT,
+	/* the payload of a hardware source packet */
+	ITM_STATE_HW,
+	/* the bytes of a timestamp or of an extension packet */
+	ITM_STATE_CONTINUATION,
+};
+
+struct arm_itm_connection {
+	struct list_head lh;
+	struct connection *connection;
+};
+
+/* where the payload of a stimulus port goes */
+struct arm_itm_sink {
+	unsigned int port;
+	/* a file name, or ':' and a TCP port */
+	char *dest;
+	FILE *file;
+	bool service;
+	struct list_head connections;
+	uint8_t buf[ITM_SINK_BUF_SIZE];
+	size_t len;
+	uint64_t bytes;
+};
+
+struct arm_itm_priv_connection {
+	struct arm_itm_sink *sink;
+};
+
+struct arm_itm_decoder {
+	/* of the TPIU/SWO, for the messages */
+	const char *name;
+	bool open;
+	struct arm_itm_sink *sinks[ITM_NUM_PORTS];
+	/* the ports with a sink, to drop the other ones early */
+	uint32_t port_mask;
+	/* the Cortex-M receiving the PC samples */
+	struct target *profile_target;
+
+	enum arm_itm_state state;
+	uint8_t header;
+	unsigned int remaining;
+	unsigned int zeros;
+	unsigned int shift;
+	uint32_t value;
+	/* of the current instrumentation packet, NULL to drop it */
+	struct arm_itm_sink *sink;
+
+	uint64_t bytes;
+	uint64_t swit_packets;
+	uint64_t dropped_bytes;
+	uint64_t hw_packets;
+	uint64_t pc_samples;
+	uint64_t sleep_samples;
+	uint64_t syncs;
+	uint64_t overflows;
+	uint64_t timestamps;
+	uint64_t errors;
+	uint64_t exceptions[ITM_NUM_EXCEPTIONS];
+};
+
+static void itm_sink_flush(struct arm_itm_sink *sink)
+{
+	struct arm_itm_connection *c;
+
+	if (!sink->len)
+		return;
+
+	if (sink->file) {
+		if (fwrite(sink->buf, 1, sink->len, sink->file) == sink->len)
+			fflush(sink->file);
+		else
+			LOG_ERROR("Error writing ITM stimulus port %u to \"%s\"", sink->port, sink->dest);
+	}
+
+	list_for_each_entry(c, &sink->connections, lh)
+		if (connection_write(c->connection, sink->buf, sink->len) != (int)sink->len)
+			LOG_ERROR("Error writing ITM stimulus port %u to connection", sink->port);
+
+	sink->len = 0;
+}
+
+static inline void itm_sink_append(struct arm_itm_sink *sink, const uint8_t *data, size_t size)
+{
+	if (sink->len + size > sizeof(sink->buf))
+		itm_sink_flush(sink);
+
+	memcpy(sink->buf + sink->len, data, size);
+	sink->len += size;
+	sink->bytes += size;
+}
+
+static int itm_service_new_connection(struct connection *connection)
+{
+	struct arm_itm_priv_connection *priv = connection->service->priv;
+	struct arm_itm_connection *c = malloc(sizeof(*c));
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	c->connection = connection;
+	list_add(&c->lh, &priv->sink->connections);
+	return ERROR_OK;
+}
+
+static int itm_service_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int itm_service_connection_closed(struct connection *connection)
+{
+	struct arm_itm_priv_connection *priv = connection->service->priv;
+	struct arm_itm_connection *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &priv->sink->connections, lh)
+		if (c->connection == connection) {
+			list_del(&c->lh);
+			free(c);
+			return ERROR_OK;
+		}
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
+}
+
+static const struct service_driver itm_service_driver = {
+	.name = ITM_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = itm_service_new_connection,
+	.input_handler = itm_service_input,
+	.connection_closed_handler = itm_service_connection_closed,
+	.keep_client_alive_handler = NULL,
+	.output_overflow = CONNECTION_OVERFLOW_DROP_OLDEST,
+};
+
+static int itm_sink_open(struct arm_itm_decoder *dec, struct arm_itm_sink *sink)
+{
+	sink->len = 0;
+
+	if (sink->dest[0] == ':') {
+		struct arm_itm_priv_connection *priv = malloc(sizeof(*priv));
+		if (!priv) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		priv->sink = sink;
+		LOG_INFO("starting ITM stimulus port %u server for %s on %s", sink->port,
+			dec->name, &sink->dest[1]);
+		int retval = add_service(&itm_service_driver, &sink->dest[1],
+			CONNECTION_LIMIT_UNLIMITED, priv);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Can't configure ITM stimulus port %u TCP port %s", sink->port,
+				&sink->dest[1]);
+			return retval;
+		}
+		sink->service = true;
+		return ERROR_OK;
+	}
+
+	sink->file = fopen(sink->dest, "ab");
+	if (!sink->file) {
+		LOG_ERROR("Can't open ITM stimulus port %u destination file \"%s\"", sink->port,
+			sink->dest);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static void itm_sink_close(struct arm_itm_sink *sink)
+{
+	itm_sink_flush(sink);
+
+	if (sink->file) {
+		fclose(sink->file);
+		sink->file = NULL;
+	}
+	if (sink->service) {
+		remove_service(ITM_SERVICE_NAME, &sink->dest[1]);
+		sink->service = false;
+	}
+}
+
+static void itm_sink_free(struct arm_itm_sink *sink)
+{
+	if (!sink)
+		return;
+
+	itm_sink_close(sink);
+	free(sink->dest);
+	free(sink);
+}
+
+struct arm_itm_decoder *arm_itm_decoder_new(const char *name)
+{
+	struct arm_itm_decoder *dec = calloc(1, sizeof(*dec));
+	if (!dec) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+	dec->name = name;
+
+	return dec;
+}
+
+void arm_itm_decoder_free(struct arm_itm_decoder *dec)
+{
+	if (!dec)
+		return;
+
+	for (unsigned int port = 0; port < ITM_NUM_PORTS; port++)
+		itm_sink_free(dec->sinks[port]);
+	free(dec);
+}
+
+bool arm_itm_decoder_in_use(const struct arm_itm_decoder *dec)
+{
+	return dec->port_mask || dec->profile_target;
+}
+
+int arm_itm_decoder_open(struct arm_itm_decoder *dec)
+{
+	for (unsigned int port = 0; port < ITM_NUM_PORTS; port++) {
+		if (!dec->sinks[port])
+			continue;
+
+		int retval = itm_sink_open(dec, dec->sinks[port]);
+		if (retval != ERROR_OK) {
+			while (port--)
+				if (dec->sinks[port])
+					itm_sink_close(dec->sinks[port]);
+			return retval;
+		}
+	}
+
+	/* the capture starts at any byte, hope for a packet boundary */
+	dec->state = ITM_STATE_HEADER;
+	dec->open = true;
+
+	return ERROR_OK;
+}
+
+void arm_itm_decoder_close(struct arm_itm_decoder *dec)
+{
+	if (!dec->open)
+		return;
+
+	for (unsigned int port = 0; port < ITM_NUM_PORTS; port++)
+		if (dec->sinks[port])
+			itm_sink_close(dec->sinks[port]);
+	dec->open = false;
+}
+
+static void itm_decode_header(struct arm_itm_decoder *dec, uint8_t header)
+{
+	/* source packet, with a payload of 1, 2 or 4 bytes */
+	if (header & 0x03) {
+		dec->header = header;
+		dec->remaining = (header & 0x03) == 0x03 ? 4 : header & 0x03;
+
+		if (header & 0x04) {
+			dec->hw_packets++;
+			dec->value = 0;
+			dec->shift = 0;
+			dec->state = ITM_STATE_HW;
+		} else {
+			unsigned int port = header >> 3;
+
+			dec->swit_packets++;
+			dec->sink = (dec->port_mask & BIT(port)) ? dec->sinks[port] : NULL;
+			dec->state = ITM_STATE_SWIT;
+		}
+		return;
+	}
+
+	if (header == 0x00) {
+		dec->zeros = 1;
+		dec->state = ITM_STATE_SYNC;
+		return;
+	}
+
+	if (header == ITM_OVERFLOW) {
+		dec->overflows++;
+		return;
+	}
+
+	/* local timestamp, or global timestamp GTS1 and GTS2 */
+	if ((header & 0x0f) == 0x00 || (header & 0xdf) == 0x94) {
+		dec->timestamps++;
+		if (header & 0x80)
+			dec->state = ITM_STATE_CONTINUATION;
+		return;
+	}
+
+	/* extension, the page number of the stimulus ports on ARMv8-M */
+	if ((header & 0x0b) == 0x08) {
+		if (header & 0x80)
+			dec->state = ITM_STATE_CONTINUATION;
+		return;
+	}
+
+	dec->errors++;
+}
+
+static void itm_decode_hw(struct arm_itm_decoder *dec)
+{
+	unsigned int id = dec->header >> 3;
+	unsigned int size = dec->shift / 8;
+
+	switch (id) {
+	case ITM_HW_EXCEPTION_TRACE:
+		if (size == 2 && ((dec->value >> 12) & 0x3) == ITM_HW_EXCEPTION_ENTERED)
+			dec->exceptions[dec->value & 0x1ff]++;
+		break;
+	case ITM_HW_PC_SAMPLE:
+		/* a single zero byte when the core is sleeping */
+		if (size == 4) {
+			dec->pc_samples++;
+			if (dec->profile_target)
+				cortex_m_profiler_trace_sample(dec->profile_target, dec->value, false);
+		} else {
+			dec->sleep_samples++;
+			if (dec->profile_target)
+				cortex_m_profiler_trace_sample(dec->profile_target, 0, true);
+		}
+		break;
+	default:
+		/* event counters and data trace are not decoded */
+		break;
+	}
+}
+
+void arm_itm_decoder_feed(struct arm_itm_decoder *dec, const uint8_t *buf, size_t size)
+{
+	size_t i = 0;
+
+	dec->bytes += size;
+
+	while (i < size) {
+		uint8_t byte = buf[i];
+		size_t n;
+
+		switch (dec->state) {
+		case ITM_STATE_HEADER:
+			i++;
+			itm_decode_header(dec, byte);
+			break;
+		case ITM_STATE_SYNC:
+			i++;
+			if (byte == 0x00) {
+				dec->zeros++;
+				break;
+			}
+			dec->state = ITM_STATE_HEADER;
+			if (byte == ITM_SYNC_END && dec->zeros >= ITM_SYNC_ZEROS)
+				dec->syncs++;
+			else
+				dec->errors++;
+			break;
+		case ITM_STATE_SWIT:
+			n = MIN(dec->remaining, size - i);
+			if (dec->sink)
+				itm_sink_append(dec->sink, buf + i, n);
+			else
+				dec->dropped_bytes += n;
+			i += n;
+			dec->remaining -= n;
+			if (!dec->remaining)
+				dec->state = ITM_STATE_HEADER;
+			break;
+		case ITM_STATE_HW:
+			i++;
+			dec->value |= (uint32_t)byte << dec->shift;
+			dec->shift += 8;
+			if (!--dec->remaining) {
+				itm_decode_hw(dec);
+				dec->state = ITM_STATE_HEADER;
+			}
+			break;
+		case ITM_STATE_CONTINUATION:
+			i++;
+			if (!(byte & 0x80))
+				dec->state = ITM_STATE_HEADER;
+			break;
+		}
+	}
+
+	for (unsigned int port = 0; port < ITM_NUM_PORTS; port++)
+		if (dec->port_mask & BIT(port))
+			itm_sink_flush(dec->sinks[port]);
+}
+
+COMMAND_HANDLER(handle_arm_itm_decoder_port)
+{
+	struct arm_itm_decoder *dec = CMD_DATA;
+
+	if (CMD_ARGC != 1 && CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int port;
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], port);
+	if (port >= ITM_NUM_PORTS) {
+		command_print(CMD, "stimulus port must be from 0 to %d", ITM_NUM_PORTS - 1);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct arm_itm_sink *sink = dec->sinks[port];
+	if (CMD_ARGC == 1) {
+		command_print(CMD, "%s", sink ? sink->dest : "off");
+		return ERROR_OK;
+	}
+
+	/* the pending payload is flushed by the close */
+	dec->port_mask &= ~BIT(port);
+	dec->sinks[port] = NULL;
+	if (dec->sink && dec->sink == sink)
+		dec->sink = NULL;
+	itm_sink_free(sink);
+
+	if (!strcmp(CMD_ARGV[1], "off"))
+		return ERROR_OK;
+
+	if (!CMD_ARGV[1][0] || !strcmp(CMD_ARGV[1], ":")) {
+		command_print(CMD, "missing file name or TCP port");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	sink = calloc(1, sizeof(*sink));
+	if (!sink) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	sink->port = port;
+	INIT_LIST_HEAD(&sink->connections);
+	sink->dest = strdup(CMD_ARGV[1]);
+	if (!sink->dest) {
+		LOG_ERROR("Out of memory");
+		free(sink);
+		return ERROR_FAIL;
+	}
+
+	if (dec->open) {
+		int retval = itm_sink_open(dec, sink);
+		if (retval != ERROR_OK) {
+			itm_sink_free(sink);
+			return retval;
+		}
+	}
+
+	dec->sinks[port] = sink;
+	dec->port_mask |= BIT(port);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_itm_decoder_profile)
+{
+	struct arm_itm_decoder *dec = CMD_DATA;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!CMD_ARGC) {
+		command_print(CMD, "%s", dec->profile_target ?
+			target_name(dec->profile_target) : "off");
+		return ERROR_OK;
+	}
+
+	if (!strcmp(CMD_ARGV[0], "off")) {
+		dec->profile_target = NULL;
+		return ERROR_OK;
+	}
+
+	struct target *target = get_target(CMD_ARGV[0]);
+	if (!target) {
+		command_print(CMD, "unknown target %s", CMD_ARGV[0]);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	if (!is_cortex_m_or_hla(target_to_cm(target))) {
+		command_print(CMD, "target %s is not a Cortex-M", CMD_ARGV[0]);
+		return ERROR_TARGET_INVALID;
+	}
+
+	dec->profile_target = target;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_itm_decoder_status)
+{
+	struct arm_itm_decoder *dec = CMD_DATA;
+
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD, "decoder %s, %" PRIu64 " bytes", dec->open ? "running" : "stopped",
+		dec->bytes);
+	command_print(CMD, "%" PRIu64 " instrumentation packets, %" PRIu64 " bytes of the other ports dropped",
+		dec->swit_packets, dec->dropped_bytes);
+	for (unsigned int port = 0; port < ITM_NUM_PORTS; port++)
+		if (dec->sinks[port])
+			command_print(CMD, "port %2u: %" PRIu64 " bytes to %s", port,
+				dec->sinks[port]->bytes, dec->sinks[port]->dest);
+	command_print(CMD, "%" PRIu64 " hardware packets, %" PRIu64 " PC samples, %" PRIu64 " sleeping",
+		dec->hw_packets, dec->pc_samples, dec->sleep_samples);
+	command_print(CMD, "%" PRIu64 " syncs, %" PRIu64 " overflows, %" PRIu64 " timestamps, %" PRIu64 " errors",
+		dec->syncs, dec->overflows, dec->timestamps, dec->errors);
+	for (unsigned int i = 0; i < ITM_NUM_EXCEPTIONS; i++)
+		if (dec->exceptions[i])
+			command_print(CMD, "exception %3u: %" PRIu64 " entries", i, dec->exceptions[i]);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_itm_decoder_clear)
+{
+	struct arm_itm_decoder *dec = CMD_DATA;
+
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	dec->bytes = 0;
+	dec->swit_packets = 0;
+	dec->dropped_bytes = 0;
+	dec->hw_packets = 0;
+	dec->pc_samples = 0;
+	dec->sleep_samples = 0;
+	dec->syncs = 0;
+	dec->overflows = 0;
+	dec->timestamps = 0;
+	dec->errors = 0;
+	memset(dec->exceptions, 0, sizeof(dec->exceptions));
+	for (unsigned int port = 0; port < ITM_NUM_PORTS; port++)
+		if (dec->sinks[port])
+			dec->sinks[port]->bytes = 0;
+
+	return ERROR_OK;
+}
+
+static const struct command_registration arm_itm_decoder_subcommand_handlers[] = {
+	{
+		.name = "port",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_itm_decoder_port,
+		.help = "write the payload of an ITM stimulus port to a file or a TCP port",
+		.usage = "port [filename|:tcp_port|off]",
+	},
+	{
+		.name = "profile",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_itm_decoder_profile,
+		.help = "add the DWT PC samples to the profiler of a Cortex-M target",
+		.usage = "[target_name|off]",
+	},
+	{
+		.name = "status",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_itm_decoder_status,
+		.help = "display the counters of the ITM decoder",
+		.usage = "",
+	},
+	{
+		.name = "clear",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_itm_decoder_clear,
+		.help = "reset the counters of the ITM decoder",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration arm_itm_decoder_command_handlers[] = {
+	{
+		.name = "decode",
+		.mode = COMMAND_ANY,
+		.help = "ITM/DWT trace decoder command group",
+		.usage = "",
+		.chain = arm_itm_decoder_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ARM_ITM_DECODER_H
+#define OPENOCD_TARGET_ARM_ITM_DECODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct arm_itm_decoder;
+
+struct arm_itm_decoder *arm_itm_decoder_new(const char *name);
+void arm_itm_decoder_free(struct arm_itm_decoder *dec);
+
+/* true if any output of the decoder is configured */
+bool arm_itm_decoder_in_use(const struct arm_itm_decoder *dec);
+
+/* open the outputs and start from a packet boundary, or stop */
+int arm_itm_decoder_open(struct arm_itm_decoder *dec);
+void arm_itm_decoder_close(struct arm_itm_decoder *dec);
+
+/* decode a chunk of a raw ITM/DWT stream, without the TPIU formatter */
+void arm_itm_decoder_feed(struct arm_itm_decoder *dec, const uint8_t *buf, size_t size);
+
+/* the "decode" group of the commands of a TPIU/SWO, the decoder as data */
+extern const struct command_registration arm_itm_decoder_command_handlers[];
+
+#endif /* OPENOCD_TARGET_ARM_ITM_DECODER_H */
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Page granular cache of the address translations of the ARMv7-A and
+ * ARMv8 cores, each of them costs an AT instruction and a PAR read through
+ * the DCC. Translations smaller than a page are not cached.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/log.h>
+
+#include "arm.h"
+#include "arm_tlb.h"
+
+static struct arm_tlb_entry *arm_tlb_slot(struct arm_tlb *tlb, target_addr_t va)
+{
+	return &tlb->entries[(va / ARM_TLB_PAGE_SIZE) % ARM_TLB_ENTRIES];
+}
+
+void arm_tlb_flush(struct arm_tlb *tlb)
+{
+	for (unsigned int i = 0; i < ARM_TLB_ENTRIES; i++)
+		tlb->entries[i].valid = false;
+	tlb->flushes++;
+}
+
+bool arm_tlb_lookup(struct arm_tlb *tlb, int regime, target_addr_t va,
+		target_addr_t *pa)
+{
+	if (tlb->disabled)
+		return false;
+
+	struct arm_tlb_entry *entry = arm_tlb_slot(tlb, va);
+	target_addr_t va_page = va & ~(target_addr_t)(ARM_TLB_PAGE_SIZE - 1);
+
+	if (!entry->valid || entry->regime != regime || entry->va_page != va_page) {
+		tlb->misses++;
+		return false;
+	}
+
+	*pa = entry->pa_page | (va & (ARM_TLB_PAGE_SIZE - 1));
+	tlb->hits++;
+	return true;
+}
+
+void arm_tlb_insert(struct arm_tlb *tlb, int regime, target_addr_t va,
+		target_addr_t pa)
+{
+	if (tlb->disabled)
+		return;
+
+	struct arm_tlb_entry *entry = arm_tlb_slot(tlb, va);
+
+	entry->valid = true;
+	entry->regime = regime;
+	entry->va_page = va & ~(target_addr_t)(ARM_TLB_PAGE_SIZE - 1);
+	entry->pa_page = pa & ~(target_addr_t)(ARM_TLB_PAGE_SIZE - 1);
+}
+
+COMMAND_HANDLER(arm_tlb_handle_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct arm *arm = target_to_arm(target);
+	struct arm_tlb *tlb = &arm->tlb;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (!strcmp(CMD_ARGV[0], "flush")) {
+			arm_tlb_flush(tlb);
+		} else {
+			bool enable;
+			COMMAND_PARSE_ON_OFF(CMD_ARGV[0], enable);
+			tlb->disabled = !enable;
+			arm_tlb_flush(tlb);
+		}
+	}
+
+	unsigned int used = 0;
+	for (unsigned int i = 0; i < ARM_TLB_ENTRIES; i++)
+		if (tlb->entries[i].valid)
+			used++;
+
+	command_print(CMD, "tlb %s, %u/%u entries, %" PRIu64 " hits, %" PRIu64
+			" misses, %" PRIu64 " flushes",
+			tlb->disabled ? "off" : "on", used, ARM_TLB_ENTRIES,
+			tlb->hits, tlb->misses, tlb->flushes);
+
+	return ERROR_OK;
+}
+
+const struct command_registration arm_tlb_command_handlers[] = {
+	{
+		.name = "tlb",
+		.handler = arm_tlb_handle_command,
+		.mode = COMMAND_EXEC,
+		.help = "show the address translation cache statistics, "
+			"flush, enable or disable it",
+		.usage = "['flush'|'on'|'off']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
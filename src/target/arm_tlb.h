@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ARM_TLB_H
+#define OPENOCD_TARGET_ARM_TLB_H
+
+#include <helper/command.h>
+#include <helper/types.h>
+
+#define ARM_TLB_PAGE_SIZE	4096
+#define ARM_TLB_ENTRIES		64
+
+struct arm_tlb_entry {
+	bool valid;
+	/* translation regime, the core mode of the translation */
+	int regime;
+	target_addr_t va_page;
+	target_addr_t pa_page;
+};
+
+/**
+ * Software TLB of the virtual to physical translations done by the core
+ * while it is halted. The ASID and VMID of the translations cannot change
+ * on a halted core unless a system register is written, so the entries
+ * are only keyed by the core mode and dropped on debug entry, on restore
+ * of the context and on any coprocessor register write.
+ */
+struct arm_tlb {
+	bool disabled;
+	struct arm_tlb_entry entries[ARM_TLB_ENTRIES];
+
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t flushes;
+};
+
+void arm_tlb_flush(struct arm_tlb *tlb);
+bool arm_tlb_lookup(struct arm_tlb *tlb, int regime, target_addr_t va,
+		target_addr_t *pa);
+void arm_tlb_insert(struct arm_tlb *tlb, int regime, target_addr_t va,
+		target_addr_t pa);
+
+extern const struct command_registration arm_tlb_command_handlers[];
+
+#endif /* OPENOCD_TARGET_ARM_TLB_H */
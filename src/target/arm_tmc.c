@@ -0,0 +1,516 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Readout of the trace captured by a CoreSight Trace Memory Controller.
+ *
+ * The TMC is an ETB, an ETF with its own RAM, or an ETR writing to the system
+ * memory. The RAM of an ETB or ETF is drained through its RAM Read Data
+ * register with non-incrementing block reads of the MEM-AP, the buffer of an
+ * ETR is read directly through the MEM-AP of the system bus.
+ */
+
+/*
+ * Relevant specifications from ARM include:
+ *
+ * CoreSight Trace Memory Controller Technical Reference Manual  ARM DDI 0461B
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/bits.h>
+#include <helper/command.h>
+#include <helper/list.h>
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include "arm_adi_v5.h"
+#include "arm_coresight.h"
+#include "arm_tmc.h"
+
+#define TMC_RSZ			0x004
+#define TMC_STS			0x00c
+#define TMC_RRD			0x010
+#define TMC_RRP			0x014
+#define TMC_RWP			0x018
+#define TMC_CTL			0x020
+#define TMC_MODE		0x028
+#define TMC_CBUFLEVEL		0x030
+#define TMC_RRPHI		0x038
+#define TMC_RWPHI		0x03c
+#define TMC_AXICTL		0x110
+#define TMC_DBALO		0x118
+#define TMC_DBAHI		0x11c
+#define TMC_FFCR		0x304
+#define TMC_LAR			0xfb0
+
+#define TMC_STS_FULL		BIT(0)
+#define TMC_STS_TRIGGERED	BIT(1)
+#define TMC_STS_TMCREADY	BIT(2)
+#define TMC_STS_EMPTY		BIT(4)
+#define TMC_STS_MEMERR		BIT(5)
+#define TMC_CTL_TRACECAPTEN	BIT(0)
+#define TMC_MODE_CIRCULAR	0
+#define TMC_AXICTL_SG		BIT(7)
+#define TMC_FFCR_FONMAN		BIT(6)
+#define TMC_FFCR_STOPONFL	BIT(12)
+#define TMC_LAR_KEY		0xc5acce55
+
+#define TMC_DEVID_CONFIG(devid)	(((devid) >> 6) & 0x3)
+#define TMC_CONFIG_ETB		0
+#define TMC_CONFIG_ETR		1
+#define TMC_CONFIG_ETF		2
+
+/* words per block read, to keep the other sessions alive in between */
+#define TMC_READ_CHUNK		4096
+#define TMC_TIMEOUT_MS		1000
+
+struct arm_tmc {
+	struct list_head lh;
+	char *name;
+	struct adiv5_mem_ap_spot spot;
+	struct adiv5_ap *ap;
+};
+
+static LIST_HEAD(all_tmc);
+
+static const char * const tmc_config_names[] = {
+	[TMC_CONFIG_ETB] = "ETB",
+	[TMC_CONFIG_ETR] = "ETR",
+	[TMC_CONFIG_ETF] = "ETF",
+	[3] = "unknown",
+};
+
+static int tmc_read_reg(struct arm_tmc *tmc, unsigned int reg, uint32_t *value)
+{
+	return mem_ap_read_atomic_u32(tmc->ap, tmc->spot.base + reg, value);
+}
+
+static int tmc_write_reg(struct arm_tmc *tmc, unsigned int reg, uint32_t value)
+{
+	return mem_ap_write_atomic_u32(tmc->ap, tmc->spot.base + reg, value);
+}
+
+/* flush the formatter and stop the capture, the RAM keeps the trace */
+static int tmc_stop(struct arm_tmc *tmc)
+{
+	uint32_t ctl, ffcr, sts;
+
+	int retval = tmc_read_reg(tmc, TMC_CTL, &ctl);
+	if (retval != ERROR_OK)
+		return retval;
+	if (!(ctl & TMC_CTL_TRACECAPTEN))
+		return ERROR_OK;
+
+	retval = tmc_read_reg(tmc, TMC_FFCR, &ffcr);
+	if (retval == ERROR_OK)
+		retval = tmc_write_reg(tmc, TMC_FFCR, ffcr | TMC_FFCR_STOPONFL);
+	if (retval == ERROR_OK)
+		retval = tmc_write_reg(tmc, TMC_FFCR, ffcr | TMC_FFCR_STOPONFL | TMC_FFCR_FONMAN);
+	if (retval != ERROR_OK)
+		return retval;
+
+	int64_t then = timeval_ms();
+	for (;;) {
+		retval = tmc_read_reg(tmc, TMC_STS, &sts);
+		if (retval != ERROR_OK)
+			return retval;
+		if (sts & TMC_STS_TMCREADY)
+			break;
+		if (timeval_ms() > then + TMC_TIMEOUT_MS) {
+			LOG_ERROR("%s: timeout waiting for the trace to be flushed", tmc->name);
+			return ERROR_TIMEOUT_REACHED;
+		}
+	}
+
+	return tmc_write_reg(tmc, TMC_CTL, ctl & ~TMC_CTL_TRACECAPTEN);
+}
+
+/* the RAM of an ETB or ETF, from the read pointer on */
+static int tmc_drain_ram(struct arm_tmc *tmc, uint8_t *buf, uint32_t count)
+{
+	for (uint32_t done = 0; done < count; ) {
+		uint32_t n = MIN(count - done, TMC_READ_CHUNK);
+
+		int retval = mem_ap_read_buf_noincr(tmc->ap, buf + 4 * done, 4, n,
+			tmc->spot.base + TMC_RRD);
+		if (retval != ERROR_OK)
+			return retval;
+
+		done += n;
+		keep_alive();
+	}
+
+	return ERROR_OK;
+}
+
+static int tmc_read_sysmem(struct adiv5_ap *ap, uint8_t *buf, uint32_t count,
+		target_addr_t address)
+{
+	for (uint32_t done = 0; done < count; ) {
+		uint32_t n = MIN(count - done, TMC_READ_CHUNK);
+
+		int retval = mem_ap_read_buf(ap, buf + 4 * done, 4, n, address + 4 * done);
+		if (retval != ERROR_OK)
+			return retval;
+
+		done += n;
+		keep_alive();
+	}
+
+	return ERROR_OK;
+}
+
+int arm_tmc_cleanup_all(void)
+{
+	struct arm_tmc *obj, *tmp;
+
+	list_for_each_entry_safe(obj, tmp, &all_tmc, lh) {
+		if (obj->ap)
+			dap_put_ap(obj->ap);
+		free(obj->name);
+		free(obj);
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_tmc_status)
+{
+	struct arm_tmc *tmc = CMD_DATA;
+	uint32_t devid, rsz, sts, ctl, mode, rwp, level;
+
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int retval = tmc_read_reg(tmc, ARM_CS_C9_DEVID, &devid);
+	if (retval == ERROR_OK)
+		retval = tmc_read_reg(tmc, TMC_RSZ, &rsz);
+	if (retval == ERROR_OK)
+		retval = tmc_read_reg(tmc, TMC_STS, &sts);
+	if (retval == ERROR_OK)
+		retval = tmc_read_reg(tmc, TMC_CTL, &ctl);
+	if (retval == ERROR_OK)
+		retval = tmc_read_reg(tmc, TMC_MODE, &mode);
+	if (retval == ERROR_OK)
+		retval = tmc_read_reg(tmc, TMC_RWP, &rwp);
+	if (retval == ERROR_OK)
+		retval = tmc_read_reg(tmc, TMC_CBUFLEVEL, &level);
+	if (retval != ERROR_OK) {
+		command_print(CMD, "failed to read the registers of %s", tmc->name);
+		return retval;
+	}
+
+	unsigned int config = TMC_DEVID_CONFIG(devid);
+	command_print(CMD, "%s, %" PRIu32 " bytes, capture %s, mode %" PRIu32,
+		tmc_config_names[config], 4 * rsz,
+		(ctl & TMC_CTL_TRACECAPTEN) ? "enabled" : "disabled", mode & 0x3);
+	command_print(CMD, "write pointer 0x%08" PRIx32 ", %" PRIu32 " bytes filled%s%s%s%s",
+		rwp, 4 * level,
+		(sts & TMC_STS_FULL) ? ", full" : "",
+		(sts & TMC_STS_TRIGGERED) ? ", triggered" : "",
+		(sts & TMC_STS_EMPTY) ? ", empty" : "",
+		(sts & TMC_STS_MEMERR) ? ", memory error" : "");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_tmc_dump)
+{
+	struct arm_tmc *tmc = CMD_DATA;
+	struct adiv5_ap *sysmem_ap = NULL;
+	uint32_t devid, rsz, sts, mode, rwp;
+	uint8_t *buf = NULL;
+	uint32_t count;
+
+	if (CMD_ARGC != 1 && CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int retval = tmc_write_reg(tmc, TMC_LAR, TMC_LAR_KEY);
+	if (retval == ERROR_OK)
+		retval = tmc_read_reg(tmc, ARM_CS_C9_DEVID, &devid);
+	if (retval == ERROR_OK)
+		retval = tmc_read_reg(tmc, TMC_MODE, &mode);
+	if (retval != ERROR_OK) {
+		command_print(CMD, "failed to read the registers of %s", tmc->name);
+		return retval;
+	}
+
+	unsigned int config = TMC_DEVID_CONFIG(devid);
+	if (config != TMC_CONFIG_ETB && config != TMC_CONFIG_ETR && config != TMC_CONFIG_ETF) {
+		command_print(CMD, "%s is not a known TMC configuration", tmc->name);
+		return ERROR_FAIL;
+	}
+	if ((mode & 0x3) != TMC_MODE_CIRCULAR) {
+		command_print(CMD, "%s is not in circular buffer mode", tmc->name);
+		return ERROR_FAIL;
+	}
+
+	if (config == TMC_CONFIG_ETR) {
+		if (CMD_ARGC != 2) {
+			command_print(CMD, "the MEM-AP of the system memory is needed for an ETR");
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		}
+
+		uint64_t ap_num;
+		COMMAND_PARSE_NUMBER(u64, CMD_ARGV[1], ap_num);
+		if (!is_ap_num_valid(tmc->spot.dap, ap_num)) {
+			command_print(CMD, "Invalid AP number");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+
+		uint32_t axictl;
+		retval = tmc_read_reg(tmc, TMC_AXICTL, &axictl);
+		if (retval != ERROR_OK)
+			return retval;
+		if (axictl & TMC_AXICTL_SG) {
+			command_print(CMD, "scatter-gather mode of %s is not supported", tmc->name);
+			return ERROR_FAIL;
+		}
+
+		sysmem_ap = dap_get_ap(tmc->spot.dap, ap_num);
+		if (!sysmem_ap) {
+			command_print(CMD, "Cannot get AP");
+			return ERROR_FAIL;
+		}
+	}
+
+	retval = tmc_stop(tmc);
+	if (retval == ERROR_OK)
+		retval = tmc_read_reg(tmc, TMC_RSZ, &rsz);
+	if (retval == ERROR_OK)
+		retval = tmc_read_reg(tmc, TMC_STS, &sts);
+	if (retval == ERROR_OK)
+		retval = tmc_read_reg(tmc, TMC_RWP, &rwp);
+	if (retval != ERROR_OK)
+		goto out;
+
+	buf = malloc(4 * rsz);
+	if (!buf) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	if (config == TMC_CONFIG_ETR) {
+		uint32_t dbalo, dbahi, rwphi;
+
+		retval = tmc_read_reg(tmc, TMC_DBALO, &dbalo);
+		if (retval == ERROR_OK)
+			retval = tmc_read_reg(tmc, TMC_DBAHI, &dbahi);
+		if (retval == ERROR_OK)
+			retval = tmc_read_reg(tmc, TMC_RWPHI, &rwphi);
+		if (retval != ERROR_OK)
+			goto out;
+
+		target_addr_t base = ((target_addr_t)dbahi << 32) | dbalo;
+		target_addr_t wp = ((target_addr_t)rwphi << 32) | rwp;
+		if (wp < base || wp - base > 4 * (target_addr_t)rsz) {
+			command_print(CMD, "write pointer of %s out of its buffer", tmc->name);
+			retval = ERROR_FAIL;
+			goto out;
+		}
+		uint32_t written = (wp - base) / 4;
+
+		/* after a wrap around, the oldest trace is at the write pointer */
+		if (sts & TMC_STS_FULL) {
+			count = rsz;
+			retval = tmc_read_sysmem(sysmem_ap, buf, rsz - written, wp);
+			if (retval == ERROR_OK)
+				retval = tmc_read_sysmem(sysmem_ap, buf + 4 * (rsz - written), written, base);
+		} else {
+			count = written;
+			retval = tmc_read_sysmem(sysmem_ap, buf, written, base);
+		}
+	} else {
+		/* the pointers are byte addresses within the RAM */
+		if (sts & TMC_STS_FULL) {
+			count = rsz;
+			retval = tmc_write_reg(tmc, TMC_RRP, rwp);
+		} else {
+			count = rwp / 4;
+			retval = tmc_write_reg(tmc, TMC_RRP, 0);
+		}
+		if (retval == ERROR_OK)
+			retval = tmc_drain_ram(tmc, buf, count);
+	}
+	if (retval != ERROR_OK) {
+		command_print(CMD, "failed to read the trace of %s", tmc->name);
+		goto out;
+	}
+
+	FILE *f = fopen(CMD_ARGV[0], "wb");
+	if (!f) {
+		command_print(CMD, "Can't open \"%s\"", CMD_ARGV[0]);
+		retval = ERROR_FAIL;
+		goto out;
+	}
+	if (fwrite(buf, 4, count, f) != count) {
+		command_print(CMD, "Error writing \"%s\"", CMD_ARGV[0]);
+		retval = ERROR_FAIL;
+	}
+	fclose(f);
+
+	if (retval == ERROR_OK)
+		command_print(CMD, "%" PRIu32 " bytes of trace written to %s", 4 * count, CMD_ARGV[0]);
+
+out:
+	free(buf);
+	if (sysmem_ap)
+		dap_put_ap(sysmem_ap);
+	return retval;
+}
+
+static const struct command_registration tmc_instance_command_handlers[] = {
+	{
+		.name = "status",
+		.mode = COMMAND_EXEC,
+		.handler = handle_tmc_status,
+		.help = "display the configuration and state of the TMC",
+		.usage = "",
+	},
+	{
+		.name = "dump",
+		.mode = COMMAND_EXEC,
+		.handler = handle_tmc_dump,
+		.help = "stop the capture and write the trace buffer to a file",
+		.usage = "filename [sysmem_ap_num]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static int tmc_create(struct jim_getopt_info *goi)
+{
+	struct command_context *cmd_ctx = current_command_context(goi->interp);
+	Jim_Obj *new_cmd;
+
+	jim_getopt_obj(goi, &new_cmd);
+	if (Jim_GetCommand(goi->interp, new_cmd, JIM_NONE)) {
+		Jim_SetResultFormatted(goi->interp, "Command: %s Exists",
+			Jim_GetString(new_cmd, NULL));
+		return JIM_ERR;
+	}
+
+	struct arm_tmc *tmc = calloc(1, sizeof(*tmc));
+	if (!tmc) {
+		LOG_ERROR("Out of memory");
+		return JIM_ERR;
+	}
+	adiv5_mem_ap_spot_init(&tmc->spot);
+
+	goi->isconfigure = 1;
+	while (goi->argc > 0) {
+		int e = adiv5_jim_mem_ap_spot_configure(&tmc->spot, goi);
+
+		if (e == JIM_CONTINUE)
+			Jim_SetResultFormatted(goi->interp, "unknown option '%s'",
+				Jim_String(goi->argv[0]));
+
+		if (e != JIM_OK) {
+			free(tmc);
+			return JIM_ERR;
+		}
+	}
+
+	if (!tmc->spot.dap || tmc->spot.ap_num == DP_APSEL_INVALID) {
+		Jim_SetResultString(goi->interp, "-dap and -ap-num required when creating TMC", -1);
+		free(tmc);
+		return JIM_ERR;
+	}
+
+	tmc->name = strdup(Jim_GetString(new_cmd, NULL));
+	if (!tmc->name) {
+		LOG_ERROR("Out of memory");
+		free(tmc);
+		return JIM_ERR;
+	}
+
+	tmc->ap = dap_get_ap(tmc->spot.dap, tmc->spot.ap_num);
+	if (!tmc->ap) {
+		Jim_SetResultString(goi->interp, "Cannot get AP", -1);
+		free(tmc->name);
+		free(tmc);
+		return JIM_ERR;
+	}
+
+	const struct command_registration tmc_commands[] = {
+		{
+			.name = tmc->name,
+			.mode = COMMAND_ANY,
+			.help = "tmc instance command group",
+			.usage = "",
+			.chain = tmc_instance_command_handlers,
+		},
+		COMMAND_REGISTRATION_DONE
+	};
+	if (register_commands_with_data(cmd_ctx, NULL, tmc_commands, tmc) != ERROR_OK) {
+		dap_put_ap(tmc->ap);
+		free(tmc->name);
+		free(tmc);
+		return JIM_ERR;
+	}
+
+	list_add_tail(&tmc->lh, &all_tmc);
+
+	return JIM_OK;
+}
+
+static int jim_tmc_create(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
+{
+	struct jim_getopt_info goi;
+	jim_getopt_setup(&goi, interp, argc - 1, argv + 1);
+	if (goi.argc < 2) {
+		Jim_WrongNumArgs(goi.interp, goi.argc, goi.argv,
+			"<name> [<tmc_options> ...]");
+		return JIM_ERR;
+	}
+	return tmc_create(&goi);
+}
+
+COMMAND_HANDLER(handle_tmc_names)
+{
+	struct arm_tmc *obj;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	list_for_each_entry(obj, &all_tmc, lh)
+		command_print(CMD, "%s", obj->name);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration tmc_subcommand_handlers[] = {
+	{
+		.name = "create",
+		.mode = COMMAND_ANY,
+		.jim_handler = jim_tmc_create,
+		.usage = "name -dap dap -ap-num apn -baseaddr base_address",
+		.help = "Creates a new TMC object",
+	},
+	{
+		.name = "names",
+		.mode = COMMAND_ANY,
+		.handler = handle_tmc_names,
+		.usage = "",
+		.help = "Lists all registered TMC objects by name",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration tmc_command_handlers[] = {
+	{
+		.name = "tmc",
+		.mode = COMMAND_CONFIG,
+		.help = "CoreSight Trace Memory Controller commands",
+		.chain = tmc_subcommand_handlers,
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int tmc_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, tmc_command_handlers);
+}
@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ARM_TMC_H
+#define OPENOCD_TARGET_ARM_TMC_H
+
+struct command_context;
+
+int tmc_register_commands(struct command_context *cmd_ctx);
+int arm_tmc_cleanup_all(void);
+
+#endif /* OPENOCD_TARGET_ARM_TMC_H */
@@ -0,0 +1,597 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Demultiplexer of the formatter stream captured from a TPIU.
+ *
+ * With the formatter enabled, the trace of the sources behind the TPIU comes
+ * in frames of 16 bytes, each byte tagged with the ATB ID of its source. The
+ * bytes of each source are written to an output of their own, a file or a TCP
+ * port, or fed to the ITM decoder of the TPIU, while the sources without
+ * output are skipped.
+ */
+
+/*
+ * Relevant specifications from ARM include:
+ *
+ * CoreSight Architecture Specification v3.0, Chapter D4    ARM IHI 0029F
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/bits.h>
+#include <helper/command.h>
+#include <helper/list.h>
+#include <helper/log.h>
+#include <server/server.h>
+#include "arm_itm_decoder.h"
+#include "arm_tpiu_demux.h"
+
+#define DEMUX_SERVICE_NAME		"tpiu_source"
+
+/* ATB IDs are 7 bits, 0x01 to 0x6f are the ones of the trace sources */
+#define DEMUX_NUM_IDS			128
+#define DEMUX_ID_NULL			0x00
+#define DEMUX_ID_MAX			0x6f
+
+#define DEMUX_FRAME_SIZE		16
+#define DEMUX_SINK_BUF_SIZE		4096
+
+/* full synchronization packet, 0x7fffffff little endian, between frames */
+#define DEMUX_FULL_SYNC			0xffffff7f
+#define DEMUX_SYNC_END			0x7f
+
+struct arm_tpiu_demux_connection {
+	struct list_head lh;
+	struct connection *connection;
+};
+
+/* where the bytes of a trace source go */
+struct arm_tpiu_demux_sink {
+	unsigned int id;
+	/* a file name, ':' and a TCP port, or "itm" */
+	char *dest;
+	bool itm;
+	FILE *file;
+	bool service;
+	struct list_head connections;
+	uint8_t buf[DEMUX_SINK_BUF_SIZE];
+	size_t len;
+	uint64_t bytes;
+};
+
+struct arm_tpiu_demux_priv_connection {
+	struct arm_tpiu_demux_sink *sink;
+};
+
+struct arm_tpiu_demux {
+	/* of the TPIU/SWO, for the messages */
+	const char *name;
+	struct arm_itm_decoder *itm;
+	bool open;
+	struct arm_tpiu_demux_sink *sinks[DEMUX_NUM_IDS];
+
+	bool synced;
+	/* the last bytes seen while looking for a synchronization */
+	uint32_t window;
+	uint8_t frame[DEMUX_FRAME_SIZE];
+	unsigned int frame_len;
+	/* of the current source, NULL to drop its bytes */
+	struct arm_tpiu_demux_sink *sink;
+
+	uint64_t bytes;
+	uint64_t frames;
+	uint64_t syncs;
+	uint64_t sync_losses;
+	uint64_t dropped_bytes;
+};
+
+static void demux_sink_flush(struct arm_tpiu_demux *demux, struct arm_tpiu_demux_sink *sink)
+{
+	struct arm_tpiu_demux_connection *c;
+
+	if (!sink->len)
+		return;
+
+	if (sink->itm)
+		arm_itm_decoder_feed(demux->itm, sink->buf, sink->len);
+
+	if (sink->file) {
+		if (fwrite(sink->buf, 1, sink->len, sink->file) == sink->len)
+			fflush(sink->file);
+		else
+			LOG_ERROR("Error writing TPIU source 0x%02x to \"%s\"", sink->id, sink->dest);
+	}
+
+	list_for_each_entry(c, &sink->connections, lh)
+		if (connection_write(c->connection, sink->buf, sink->len) != (int)sink->len)
+			LOG_ERROR("Error writing TPIU source 0x%02x to connection", sink->id);
+
+	sink->len = 0;
+}
+
+static inline void demux_byte(struct arm_tpiu_demux *demux, uint8_t byte)
+{
+	struct arm_tpiu_demux_sink *sink = demux->sink;
+
+	if (!sink) {
+		demux->dropped_bytes++;
+		return;
+	}
+
+	if (sink->len == sizeof(sink->buf))
+		demux_sink_flush(demux, sink);
+
+	sink->buf[sink->len++] = byte;
+	sink->bytes++;
+}
+
+static void demux_set_id(struct arm_tpiu_demux *demux, uint8_t id)
+{
+	demux->sink = demux->sinks[id];
+}
+
+/*
+ * The even bytes of a frame hold either data, its LSB in the auxiliary byte
+ * 15, or a new ID. The auxiliary bit of an ID tells whether the following
+ * byte is still of the previous source. An ID in byte 14 applies to the next
+ * frame.
+ */
+static void demux_frame(struct arm_tpiu_demux *demux, const uint8_t *frame)
+{
+	uint8_t aux = frame[DEMUX_FRAME_SIZE - 1];
+
+	demux->frames++;
+
+	for (unsigned int k = 0; k < 8; k++) {
+		uint8_t byte = frame[2 * k];
+		bool aux_bit = aux & BIT(k);
+
+		if (byte & 0x01) {
+			if (k == 7) {
+				demux_set_id(demux, byte >> 1);
+				break;
+			}
+			if (aux_bit) {
+				demux_byte(demux, frame[2 * k + 1]);
+				demux_set_id(demux, byte >> 1);
+			} else {
+				demux_set_id(demux, byte >> 1);
+				demux_byte(demux, frame[2 * k + 1]);
+			}
+			continue;
+		}
+
+		demux_byte(demux, (byte & 0xfe) | (aux_bit ? 0x01 : 0x00));
+		if (k < 7)
+			demux_byte(demux, frame[2 * k + 1]);
+	}
+}
+
+static void demux_shift_window(struct arm_tpiu_demux *demux, const uint8_t *buf, size_t size)
+{
+	for (size_t i = size > 4 ? size - 4 : 0; i < size; i++)
+		demux->window = (demux->window << 8) | buf[i];
+}
+
+/* wait for a full synchronization, the frames start right after it */
+static size_t demux_find_sync(struct arm_tpiu_demux *demux, const uint8_t *buf, size_t size)
+{
+	size_t i = 0;
+
+	while (i < size) {
+		/* memchr() is vectorized, the other bytes are only looked at around a match */
+		const uint8_t *end = memchr(buf + i, DEMUX_SYNC_END, size - i);
+
+		if (!end) {
+			demux_shift_window(demux, buf + i, size - i);
+			return size;
+		}
+
+		size_t n = end - (buf + i) + 1;
+		demux_shift_window(demux, buf + i, n);
+		i += n;
+
+		if (demux->window == DEMUX_FULL_SYNC) {
+			demux->synced = true;
+			demux->syncs++;
+			demux->frame_len = 0;
+			return i;
+		}
+	}
+
+	return i;
+}
+
+void arm_tpiu_demux_feed(struct arm_tpiu_demux *demux, const uint8_t *buf, size_t size)
+{
+	size_t i = 0;
+
+	demux->bytes += size;
+
+	while (i < size) {
+		if (!demux->synced) {
+			i += demux_find_sync(demux, buf + i, size - i);
+			continue;
+		}
+
+		/* whole frames straight from the buffer */
+		if (!demux->frame_len && size - i >= DEMUX_FRAME_SIZE && buf[i] != 0xff) {
+			demux_frame(demux, buf + i);
+			i += DEMUX_FRAME_SIZE;
+			continue;
+		}
+
+		size_t n = MIN(DEMUX_FRAME_SIZE - demux->frame_len, size - i);
+		memcpy(demux->frame + demux->frame_len, buf + i, n);
+		demux->frame_len += n;
+		i += n;
+
+		if (demux->frame_len < DEMUX_FRAME_SIZE)
+			break;
+
+		/* an ID 0x7f is reserved, 0xff starts a synchronization between frames */
+		if (demux->frame[0] == 0xff) {
+			unsigned int skip;
+
+			if (demux->frame[1] == DEMUX_SYNC_END) {
+				skip = 2;
+			} else if (demux->frame[1] == 0xff && demux->frame[2] == 0xff &&
+					demux->frame[3] == DEMUX_SYNC_END) {
+				demux->syncs++;
+				skip = 4;
+			} else {
+				demux->sync_losses++;
+				demux->synced = false;
+				demux->window = 0;
+				demux->sink = NULL;
+				demux_shift_window(demux, demux->frame, demux->frame_len);
+				demux->frame_len = 0;
+				continue;
+			}
+
+			memmove(demux->frame, demux->frame + skip, DEMUX_FRAME_SIZE - skip);
+			demux->frame_len -= skip;
+			continue;
+		}
+
+		demux_frame(demux, demux->frame);
+		demux->frame_len = 0;
+	}
+
+	for (unsigned int id = 0; id < DEMUX_NUM_IDS; id++)
+		if (demux->sinks[id])
+			demux_sink_flush(demux, demux->sinks[id]);
+}
+
+static int demux_service_new_connection(struct connection *connection)
+{
+	struct arm_tpiu_demux_priv_connection *priv = connection->service->priv;
+	struct arm_tpiu_demux_connection *c = malloc(sizeof(*c));
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	c->connection = connection;
+	list_add(&c->lh, &priv->sink->connections);
+	return ERROR_OK;
+}
+
+static int demux_service_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int demux_service_connection_closed(struct connection *connection)
+{
+	struct arm_tpiu_demux_priv_connection *priv = connection->service->priv;
+	struct arm_tpiu_demux_connection *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &priv->sink->connections, lh)
+		if (c->connection == connection) {
+			list_del(&c->lh);
+			free(c);
+			return ERROR_OK;
+		}
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
+}
+
+static const struct service_driver demux_service_driver = {
+	.name = DEMUX_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = demux_service_new_connection,
+	.input_handler = demux_service_input,
+	.connection_closed_handler = demux_service_connection_closed,
+	.keep_client_alive_handler = NULL,
+	.output_overflow = CONNECTION_OVERFLOW_DROP_OLDEST,
+};
+
+static int demux_sink_open(struct arm_tpiu_demux *demux, struct arm_tpiu_demux_sink *sink)
+{
+	sink->len = 0;
+
+	if (sink->itm)
+		return ERROR_OK;
+
+	if (sink->dest[0] == ':') {
+		struct arm_tpiu_demux_priv_connection *priv = malloc(sizeof(*priv));
+		if (!priv) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		priv->sink = sink;
+		LOG_INFO("starting TPIU source 0x%02x server for %s on %s", sink->id,
+			demux->name, &sink->dest[1]);
+		int retval = add_service(&demux_service_driver, &sink->dest[1],
+			CONNECTION_LIMIT_UNLIMITED, priv);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Can't configure TPIU source 0x%02x TCP port %s", sink->id,
+				&sink->dest[1]);
+			return retval;
+		}
+		sink->service = true;
+		return ERROR_OK;
+	}
+
+	sink->file = fopen(sink->dest, "ab");
+	if (!sink->file) {
+		LOG_ERROR("Can't open TPIU source 0x%02x destination file \"%s\"", sink->id,
+			sink->dest);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static void demux_sink_close(struct arm_tpiu_demux *demux, struct arm_tpiu_demux_sink *sink)
+{
+	demux_sink_flush(demux, sink);
+
+	if (sink->file) {
+		fclose(sink->file);
+		sink->file = NULL;
+	}
+	if (sink->service) {
+		remove_service(DEMUX_SERVICE_NAME, &sink->dest[1]);
+		sink->service = false;
+	}
+}
+
+static void demux_sink_free(struct arm_tpiu_demux *demux, struct arm_tpiu_demux_sink *sink)
+{
+	if (!sink)
+		return;
+
+	demux_sink_close(demux, sink);
+	free(sink->dest);
+	free(sink);
+}
+
+struct arm_tpiu_demux *arm_tpiu_demux_new(const char *name, struct arm_itm_decoder *itm)
+{
+	struct arm_tpiu_demux *demux = calloc(1, sizeof(*demux));
+	if (!demux) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+	demux->name = name;
+	demux->itm = itm;
+
+	return demux;
+}
+
+void arm_tpiu_demux_free(struct arm_tpiu_demux *demux)
+{
+	if (!demux)
+		return;
+
+	for (unsigned int id = 0; id < DEMUX_NUM_IDS; id++)
+		demux_sink_free(demux, demux->sinks[id]);
+	free(demux);
+}
+
+bool arm_tpiu_demux_in_use(const struct arm_tpiu_demux *demux)
+{
+	for (unsigned int id = 0; id < DEMUX_NUM_IDS; id++)
+		if (demux->sinks[id])
+			return true;
+
+	return false;
+}
+
+bool arm_tpiu_demux_to_itm(const struct arm_tpiu_demux *demux)
+{
+	for (unsigned int id = 0; id < DEMUX_NUM_IDS; id++)
+		if (demux->sinks[id] && demux->sinks[id]->itm)
+			return true;
+
+	return false;
+}
+
+int arm_tpiu_demux_open(struct arm_tpiu_demux *demux)
+{
+	for (unsigned int id = 0; id < DEMUX_NUM_IDS; id++) {
+		if (!demux->sinks[id])
+			continue;
+
+		int retval = demux_sink_open(demux, demux->sinks[id]);
+		if (retval != ERROR_OK) {
+			while (id--)
+				if (demux->sinks[id])
+					demux_sink_close(demux, demux->sinks[id]);
+			return retval;
+		}
+	}
+
+	/* the frames are only aligned after a full synchronization */
+	demux->synced = false;
+	demux->window = 0;
+	demux->frame_len = 0;
+	demux->sink = NULL;
+	demux->open = true;
+
+	return ERROR_OK;
+}
+
+void arm_tpiu_demux_close(struct arm_tpiu_demux *demux)
+{
+	if (!demux->open)
+		return;
+
+	for (unsigned int id = 0; id < DEMUX_NUM_IDS; id++)
+		if (demux->sinks[id])
+			demux_sink_close(demux, demux->sinks[id]);
+	demux->open = false;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_demux_source)
+{
+	struct arm_tpiu_demux *demux = CMD_DATA;
+
+	if (CMD_ARGC != 1 && CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int id;
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], id);
+	if (id == DEMUX_ID_NULL || id > DEMUX_ID_MAX) {
+		command_print(CMD, "trace source ID must be from 0x01 to 0x%02x", DEMUX_ID_MAX);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct arm_tpiu_demux_sink *sink = demux->sinks[id];
+	if (CMD_ARGC == 1) {
+		command_print(CMD, "%s", sink ? sink->dest : "off");
+		return ERROR_OK;
+	}
+
+	/* the pending bytes are flushed by the close */
+	demux->sinks[id] = NULL;
+	if (demux->sink && demux->sink == sink)
+		demux->sink = NULL;
+	demux_sink_free(demux, sink);
+
+	if (!strcmp(CMD_ARGV[1], "off"))
+		return ERROR_OK;
+
+	if (!CMD_ARGV[1][0] || !strcmp(CMD_ARGV[1], ":")) {
+		command_print(CMD, "missing file name or TCP port");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	sink = calloc(1, sizeof(*sink));
+	if (!sink) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	sink->id = id;
+	sink->itm = !strcmp(CMD_ARGV[1], "itm");
+	INIT_LIST_HEAD(&sink->connections);
+	sink->dest = strdup(CMD_ARGV[1]);
+	if (!sink->dest) {
+		LOG_ERROR("Out of memory");
+		free(sink);
+		return ERROR_FAIL;
+	}
+
+	if (demux->open) {
+		int retval = demux_sink_open(demux, sink);
+		if (retval != ERROR_OK) {
+			demux_sink_free(demux, sink);
+			return retval;
+		}
+	}
+
+	demux->sinks[id] = sink;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_demux_status)
+{
+	struct arm_tpiu_demux *demux = CMD_DATA;
+
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD, "demultiplexer %s, %s, %" PRIu64 " bytes",
+		demux->open ? "running" : "stopped",
+		demux->synced ? "synchronized" : "not synchronized", demux->bytes);
+	command_print(CMD, "%" PRIu64 " frames, %" PRIu64 " syncs, %" PRIu64 " losses of sync",
+		demux->frames, demux->syncs, demux->sync_losses);
+	command_print(CMD, "%" PRIu64 " bytes of the other sources dropped", demux->dropped_bytes);
+	for (unsigned int id = 0; id < DEMUX_NUM_IDS; id++)
+		if (demux->sinks[id])
+			command_print(CMD, "source 0x%02x: %" PRIu64 " bytes to %s", id,
+				demux->sinks[id]->bytes, demux->sinks[id]->dest);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_demux_clear)
+{
+	struct arm_tpiu_demux *demux = CMD_DATA;
+
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	demux->bytes = 0;
+	demux->frames = 0;
+	demux->syncs = 0;
+	demux->sync_losses = 0;
+	demux->dropped_bytes = 0;
+	for (unsigned int id = 0; id < DEMUX_NUM_IDS; id++)
+		if (demux->sinks[id])
+			demux->sinks[id]->bytes = 0;
+
+	return ERROR_OK;
+}
+
+static const struct command_registration arm_tpiu_demux_subcommand_handlers[] = {
+	{
+		.name = "source",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_demux_source,
+		.help = "write the trace of a TPIU source to a file, a TCP port or the ITM decoder",
+		.usage = "id [filename|:tcp_port|itm|off]",
+	},
+	{
+		.name = "status",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_demux_status,
+		.help = "display the counters of the TPIU demultiplexer",
+		.usage = "",
+	},
+	{
+		.name = "clear",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_demux_clear,
+		.help = "reset the counters of the TPIU demultiplexer",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration arm_tpiu_demux_command_handlers[] = {
+	{
+		.name = "demux",
+		.mode = COMMAND_ANY,
+		.help = "TPIU formatter demultiplexer command group",
+		.usage = "",
+		.chain = arm_tpiu_demux_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ARM_TPIU_DEMUX_H
+#define OPENOCD_TARGET_ARM_TPIU_DEMUX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct arm_itm_decoder;
+struct arm_tpiu_demux;
+
+/* the sources routed to the ITM decoder are fed to @a itm */
+struct arm_tpiu_demux *arm_tpiu_demux_new(const char *name, struct arm_itm_decoder *itm);
+void arm_tpiu_demux_free(struct arm_tpiu_demux *demux);
+
+/* true if any source of the demultiplexer has a sink */
+bool arm_tpiu_demux_in_use(const struct arm_tpiu_demux *demux);
+/* true if a source is routed to the ITM decoder */
+bool arm_tpiu_demux_to_itm(const struct arm_tpiu_demux *demux);
+
+/* open the sinks and wait for a synchronization, or stop */
+int arm_tpiu_demux_open(struct arm_tpiu_demux *demux);
+void arm_tpiu_demux_close(struct arm_tpiu_demux *demux);
+
+/* split a chunk of the formatter stream of a TPIU into its trace sources */
+void arm_tpiu_demux_feed(struct arm_tpiu_demux *demux, const uint8_t *buf, size_t size);
+
+/* the "demux" group of the commands of a TPIU/SWO, the demultiplexer as data */
+extern const struct command_registration arm_tpiu_demux_command_handlers[];
+
+#endif /* OPENOCD_TARGET_ARM_TPIU_DEMUX_H */
@@ -36,6 +36,8 @@
 #include <target/arm_adi_v5.h>
 #include <target/target.h>
 #include <transport/transport.h>
+#include "arm_itm_decoder.h"
+#include "arm_tpiu_demux.h"
 #include "arm_tpiu_swo.h"
 
 /* START_DEPRECATED_TPIU */
@@ -105,6 +107,10 @@ struct arm_tpiu_swo_object {
 	unsigned int pin_protocol;
 	/** Enable formatter */
 	bool en_formatter;
+	/** the ITM decoder is open, fed the captured data without the formatter */
+	bool en_itm_decode;
+	/** the captured formatter stream goes through the demultiplexer */
+	bool en_demux;
 	/** frequency of TRACECLKIN (usually matches HCLK) */
 	unsigned int traceclkin_freq;
 	/** SWO pin frequency */
@@ -113,6 +119,13 @@ struct arm_tpiu_swo_object {
 	char *out_filename;
 	/** track TCP connections */
 	struct list_head connections;
+	/** decoder of the captured ITM/DWT packets */
+	struct arm_itm_decoder *itm;
+	/** demultiplexer of the trace sources in the formatter stream */
+	struct arm_tpiu_demux *demux;
+	/** buffer of the captured data, grown while the polls fill it up */
+	uint8_t *trace_buf;
+	size_t trace_buf_size;
 	/* START_DEPRECATED_TPIU */
 	bool recheck_ap_cur_target;
 	/* END_DEPRECATED_TPIU */
@@ -130,20 +143,44 @@ struct arm_tpiu_swo_priv_connection {
 static LIST_HEAD(all_tpiu_swo);
 
 #define ARM_TPIU_SWO_TRACE_BUF_SIZE	4096
+#define ARM_TPIU_SWO_TRACE_BUF_MAX	(64 * 1024)
 
 static int arm_tpiu_swo_poll_trace(void *priv)
 {
 	struct arm_tpiu_swo_object *obj = priv;
-	uint8_t buf[ARM_TPIU_SWO_TRACE_BUF_SIZE];
-	size_t size = sizeof(buf);
+	size_t size = obj->trace_buf_size;
 	struct arm_tpiu_swo_connection *c;
 
-	int retval = adapter_poll_trace(buf, &size);
+	int retval = adapter_poll_trace(obj->trace_buf, &size);
 	if (retval != ERROR_OK || !size)
 		return retval;
 
+	uint8_t *buf = obj->trace_buf;
+
+	/*
+	 * A full buffer means that more data was waiting in the adapter, take
+	 * more at each poll before it overflows there.
+	 */
+	if (size == obj->trace_buf_size && obj->trace_buf_size < ARM_TPIU_SWO_TRACE_BUF_MAX) {
+		uint8_t *trace_buf = malloc(2 * obj->trace_buf_size);
+		if (trace_buf) {
+			LOG_DEBUG("TPIU/SWO: %s trace buffer grown to %zu bytes", obj->name,
+				2 * obj->trace_buf_size);
+			memcpy(trace_buf, buf, size);
+			free(obj->trace_buf);
+			obj->trace_buf = trace_buf;
+			obj->trace_buf_size *= 2;
+			buf = trace_buf;
+		}
+	}
+
 	target_call_trace_callbacks(/*target*/NULL, size, buf);
 
+	if (obj->en_demux)
+		arm_tpiu_demux_feed(obj->demux, buf, size);
+	else if (obj->en_itm_decode)
+		arm_itm_decoder_feed(obj->itm, buf, size);
+
 	if (obj->file) {
 		if (fwrite(buf, 1, size, obj->file) == size) {
 			fflush(obj->file);
@@ -203,6 +240,15 @@ static void arm_tpiu_swo_close_output(struct arm_tpiu_swo_object *obj)
 	}
 	if (obj->out_filename && obj->out_filename[0] == ':')
 		remove_service(TCP_SERVICE_NAME, &obj->out_filename[1]);
+	/* the demultiplexer flushes the last bytes into the ITM decoder */
+	if (obj->en_demux) {
+		arm_tpiu_demux_close(obj->demux);
+		obj->en_demux = false;
+	}
+	if (obj->en_itm_decode) {
+		arm_itm_decoder_close(obj->itm);
+		obj->en_itm_decode = false;
+	}
 }
 
 int arm_tpiu_swo_cleanup_all(void)
@@ -237,6 +283,9 @@ int arm_tpiu_swo_cleanup_all(void)
 		if (obj->ap)
 			dap_put_ap(obj->ap);
 
+		arm_tpiu_demux_free(obj->demux);
+		arm_itm_decoder_free(obj->itm);
+		free(obj->trace_buf);
 		free(obj->name);
 		free(obj->out_filename);
 		free(obj);
@@ -593,6 +642,7 @@ static const struct service_driver arm_tpiu_swo_service_driver = {
 	.input_handler = arm_tpiu_swo_service_input,
 	.connection_closed_handler = arm_tpiu_swo_service_connection_closed,
 	.keep_client_alive_handler = NULL,
+	.output_overflow = CONNECTION_OVERFLOW_DROP_OLDEST,
 };
 
 COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
@@ -728,6 +778,45 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
 			}
 		}
 
+		if (arm_tpiu_demux_in_use(obj->demux)) {
+			if (!obj->en_formatter) {
+				command_print(CMD, "TPIU demultiplexer needs the formatter enabled");
+			} else {
+				retval = arm_tpiu_demux_open(obj->demux);
+				if (retval != ERROR_OK) {
+					command_print(CMD, "Can't start the TPIU demultiplexer");
+					arm_tpiu_swo_close_output(obj);
+					return retval;
+				}
+				obj->en_demux = true;
+			}
+		}
+
+		/* with the formatter, the ITM decoder gets one of the sources */
+		bool itm_source = obj->en_formatter ? obj->en_demux && arm_tpiu_demux_to_itm(obj->demux)
+			: arm_itm_decoder_in_use(obj->itm);
+		if (arm_itm_decoder_in_use(obj->itm) && !itm_source)
+			command_print(CMD, "ITM decoder needs 'demux source <id> itm' with the formatter enabled");
+		if (itm_source) {
+			retval = arm_itm_decoder_open(obj->itm);
+			if (retval != ERROR_OK) {
+				command_print(CMD, "Can't start the ITM decoder");
+				arm_tpiu_swo_close_output(obj);
+				return retval;
+			}
+			obj->en_itm_decode = true;
+		}
+
+		if (!obj->trace_buf) {
+			obj->trace_buf = malloc(ARM_TPIU_SWO_TRACE_BUF_SIZE);
+			if (!obj->trace_buf) {
+				LOG_ERROR("Out of memory");
+				arm_tpiu_swo_close_output(obj);
+				return ERROR_FAIL;
+			}
+			obj->trace_buf_size = ARM_TPIU_SWO_TRACE_BUF_SIZE;
+		}
+
 		retval = adapter_config_trace(true, obj->pin_protocol, obj->port_width,
 			&swo_pin_freq, obj->traceclkin_freq, &prescaler);
 		if (retval != ERROR_OK) {
@@ -924,6 +1013,14 @@ static int arm_tpiu_swo_create(Jim_Interp *interp, struct arm_tpiu_swo_object *o
 	if (e != ERROR_OK)
 		return JIM_ERR;
 
+	e = register_commands_with_data(cmd_ctx, obj->name, arm_itm_decoder_command_handlers, obj->itm);
+	if (e != ERROR_OK)
+		return JIM_ERR;
+
+	e = register_commands_with_data(cmd_ctx, obj->name, arm_tpiu_demux_command_handlers, obj->demux);
+	if (e != ERROR_OK)
+		return JIM_ERR;
+
 	list_add_tail(&obj->lh, &all_tpiu_swo);
 
 	return JIM_OK;
@@ -957,6 +1054,21 @@ static int jim_arm_tpiu_swo_create(Jim_Interp *interp, int argc, Jim_Obj *const
 		return JIM_ERR;
 	}
 
+	obj->itm = arm_itm_decoder_new(obj->name);
+	if (!obj->itm) {
+		free(obj->name);
+		free(obj);
+		return JIM_ERR;
+	}
+
+	obj->demux = arm_tpiu_demux_new(obj->name, obj->itm);
+	if (!obj->demux) {
+		arm_itm_decoder_free(obj->itm);
+		free(obj->name);
+		free(obj);
+		return JIM_ERR;
+	}
+
 	/* Do the rest as "configure" options */
 	goi.isconfigure = 1;
 	int e = arm_tpiu_swo_configure(&goi, obj);
@@ -975,6 +1087,8 @@ static int jim_arm_tpiu_swo_create(Jim_Interp *interp, int argc, Jim_Obj *const
 	return JIM_OK;
 
 err_exit:
+	arm_tpiu_demux_free(obj->demux);
+	arm_itm_decoder_free(obj->itm);
 	free(obj->name);
 	free(obj->out_filename);
 	free(obj);
@@ -1496,10 +1496,10 @@ int armv4_5_run_algorithm(struct target *target,
 int arm_checksum_memory(struct target *target,
 	target_addr_t address, uint32_t count, uint32_t *checksum)
 {
-	struct working_area *crc_algorithm;
+	struct working_area *crc_algorithm = NULL;
 	struct arm_algorithm arm_algo;
 	struct arm *arm = target_to_arm(target);
-	struct reg_param reg_params[2];
+	struct reg_param reg_params[3];
 	int retval;
 	uint32_t i;
 	uint32_t exit_var = 0;
@@ -1507,21 +1507,48 @@ int arm_checksum_memory(struct target *target,
 	static const uint8_t arm_crc_code_le[] = {
 #include "../../contrib/loaders/checksum/armv4_5_crc.inc"
 	};
+	static const uint8_t arm_crc_table_code_le[] = {
+#include "../../contrib/loaders/checksum/armv4_5_crc_table.inc"
+	};
+	uint8_t crc_code[sizeof(arm_crc_table_code_le)];
+	size_t crc_code_size = sizeof(arm_crc_code_le);
+	target_addr_t crc_table = 0;
 
 	assert(sizeof(arm_crc_code_le) % 4 == 0);
+	assert(sizeof(arm_crc_table_code_le) % 4 == 0);
+	assert(sizeof(arm_crc_code_le) <= sizeof(crc_code));
+
+	/* the table driven loader builds its tables past the code; the
+	 * loaders stay resident between the checksums of an image */
+	if (count >= ARM_CRC_TABLE_MIN_COUNT) {
+		/* convert code into a buffer in target endianness */
+		for (i = 0; i < sizeof(arm_crc_table_code_le) / 4; i++)
+			target_buffer_set_u32(target, &crc_code[i * 4],
+					le_to_h_u32(&arm_crc_table_code_le[i * 4]));
+
+		retval = target_alloc_loader_working_area(target, crc_code,
+				sizeof(arm_crc_table_code_le),
+				sizeof(arm_crc_table_code_le) + ARM_CRC_TABLE_SIZE, &crc_algorithm);
+		if (retval == ERROR_OK) {
+			crc_code_size = sizeof(arm_crc_table_code_le);
+			crc_table = crc_algorithm->address + crc_code_size;
+		} else if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+			return retval;
+		}
+	}
 
-	retval = target_alloc_working_area(target,
-			sizeof(arm_crc_code_le), &crc_algorithm);
-	if (retval != ERROR_OK)
-		return retval;
+	if (!crc_algorithm) {
+		for (i = 0; i < sizeof(arm_crc_code_le) / 4; i++)
+			target_buffer_set_u32(target, &crc_code[i * 4],
+					le_to_h_u32(&arm_crc_code_le[i * 4]));
 
-	/* convert code into a buffer in target endianness */
-	for (i = 0; i < ARRAY_SIZE(arm_crc_code_le) / 4; i++) {
-		retval = target_write_u32(target,
-				crc_algorithm->address + i * sizeof(uint32_t),
-				le_to_h_u32(&arm_crc_code_le[i * 4]));
-		if (retval != ERROR_OK)
-			goto cleanup;
+		retval = target_alloc_loader_working_area(target, crc_code,
+				crc_code_size, crc_code_size, &crc_algorithm);
+		if (retval != ERROR_OK) {
+			if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+				LOG_WARNING("not enough working area available(requested %zu)", crc_code_size);
+			return retval;
+		}
 	}
 
 	arm_algo.common_magic = ARM_COMMON_MAGIC;
@@ -1530,18 +1557,20 @@ int arm_checksum_memory(struct target *target,
 
 	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);
 	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);
 
 	buf_set_u32(reg_params[0].value, 0, 32, address);
 	buf_set_u32(reg_params[1].value, 0, 32, count);
+	buf_set_u32(reg_params[2].value, 0, 32, crc_table);
 
 	/* 20 second timeout/megabyte */
 	int timeout = 20000 * (1 + (count / (1024 * 1024)));
 
 	/* armv4 must exit using a hardware breakpoint */
 	if (arm->arch == ARM_ARCH_V4)
-		exit_var = crc_algorithm->address + sizeof(arm_crc_code_le) - 8;
+		exit_var = crc_algorithm->address + crc_code_size - 8;
 
-	retval = target_run_algorithm(target, 0, NULL, 2, reg_params,
+	retval = target_run_algorithm(target, 0, NULL, crc_table ? 3 : 2, reg_params,
 			crc_algorithm->address,
 			exit_var,
 			timeout, &arm_algo);
@@ -1553,8 +1582,8 @@ int arm_checksum_memory(struct target *target,
 
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
+	destroy_reg_param(&reg_params[2]);
 
-cleanup:
 	target_free_working_area(target, crc_algorithm);
 
 	return retval;
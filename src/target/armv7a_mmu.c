@@ -32,6 +32,10 @@ int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
 	struct arm_dpm *dpm = armv7a->arm.dpm;
 	uint32_t virt = va & ~0xfff, value;
 	uint32_t NOS, NS, INNER, OUTER, SS;
+
+	if (!meminfo && arm_tlb_lookup(&armv7a->arm.tlb, armv7a->arm.core_mode, va, val))
+		return ERROR_OK;
+
 	*val = 0xdeadbeef;
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
@@ -66,6 +70,8 @@ int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
 	} else {
 		*val = (value & ~0xfff)  +  (va & 0xfff);
 	}
+	arm_tlb_insert(&armv7a->arm.tlb, armv7a->arm.core_mode, va, *val);
+
 	if (meminfo) {
 		LOG_INFO("%" PRIx32 " : %" TARGET_PRIxADDR " %s outer shareable %s secured %s super section",
 			va, *val,
@@ -179,11 +179,25 @@ int armv7m_restore_context(struct target *target)
 	/* The descending order of register writes is crucial for correct
 	 * packing of ARMV7M_PMSK_BPRI_FLTMSK_CTRL!
 	 * See also comments in the register table above */
+	struct reg *reg_list[ARMV7M_LAST_REG];
+	unsigned int n = 0;
+
+	for (i = MIN(cache->num_regs, ARMV7M_LAST_REG) - 1; i >= 0; i--) {
+		struct reg *r = &cache->reg_list[i];
+		if (r->exist && r->dirty)
+			reg_list[n++] = r;
+	}
+
+	/* write in one batch where possible, the loop below takes the rest */
+	int retval = target_write_registers(target, reg_list, n);
+	if (retval != ERROR_OK)
+		return retval;
+
 	for (i = cache->num_regs - 1; i >= 0; i--) {
 		struct reg *r = &cache->reg_list[i];
 
 		if (r->exist && r->dirty) {
-			int retval = armv7m->arm.write_core_reg(target, r, i, ARM_MODE_ANY, r->value);
+			retval = armv7m->arm.write_core_reg(target, r, i, ARM_MODE_ANY, r->value);
 			if (retval != ERROR_OK)
 				return retval;
 		}
@@ -529,6 +543,13 @@ int armv7m_start_algorithm(struct target *target,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	/* Fetch the registers not cached yet in one go */
+	struct reg *reg_list[ARMV7M_LAST_REG];
+	unsigned int num_regs = MIN(armv7m->arm.core_cache->num_regs, ARMV7M_LAST_REG);
+	for (unsigned int i = 0; i < num_regs; i++)
+		reg_list[i] = &armv7m->arm.core_cache->reg_list[i];
+	target_read_registers(target, reg_list, num_regs);
+
 	/* Store all non-debug execution registers to armv7m_algorithm_info context */
 	for (unsigned i = 0; i < armv7m->arm.core_cache->num_regs; i++) {
 		struct reg *reg = &armv7m->arm.core_cache->reg_list[i];
@@ -882,37 +903,62 @@ int armv7m_init_arch_info(struct target *target, struct armv7m_common *armv7m)
 int armv7m_checksum_memory(struct target *target,
 	target_addr_t address, uint32_t count, uint32_t *checksum)
 {
-	struct working_area *crc_algorithm;
+	struct working_area *crc_algorithm = NULL;
 	struct armv7m_algorithm armv7m_info;
-	struct reg_param reg_params[2];
+	struct reg_param reg_params[3];
 	int retval;
 
 	static const uint8_t cortex_m_crc_code[] = {
 #include "../../contrib/loaders/checksum/armv7m_crc.inc"
 	};
+	static const uint8_t cortex_m_crc_table_code[] = {
+#include "../../contrib/loaders/checksum/armv7m_crc_table.inc"
+	};
+	size_t crc_code_size = sizeof(cortex_m_crc_code);
+	target_addr_t crc_table = 0;
+
+	/* The table driven loader builds its tables in 4 KiB of working area
+	 * past the code, and reads whole words with "rev" so it is only good
+	 * for little endian targets. Fall back to the bit serial loader.
+	 * The loaders stay resident between the checksums of an image. */
+	if (count >= ARM_CRC_TABLE_MIN_COUNT && target->endianness == TARGET_LITTLE_ENDIAN) {
+		retval = target_alloc_loader_working_area(target, cortex_m_crc_table_code,
+				sizeof(cortex_m_crc_table_code),
+				sizeof(cortex_m_crc_table_code) + ARM_CRC_TABLE_SIZE, &crc_algorithm);
+		if (retval == ERROR_OK) {
+			crc_code_size = sizeof(cortex_m_crc_table_code);
+			crc_table = crc_algorithm->address + crc_code_size;
+		} else if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+			return retval;
+		}
+	}
 
-	retval = target_alloc_working_area(target, sizeof(cortex_m_crc_code), &crc_algorithm);
-	if (retval != ERROR_OK)
-		return retval;
-
-	retval = target_write_buffer(target, crc_algorithm->address,
-			sizeof(cortex_m_crc_code), (uint8_t *)cortex_m_crc_code);
-	if (retval != ERROR_OK)
-		goto cleanup;
+	if (!crc_algorithm) {
+		retval = target_alloc_loader_working_area(target, cortex_m_crc_code,
+				crc_code_size, crc_code_size, &crc_algorithm);
+		if (retval != ERROR_OK) {
+			if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+				LOG_WARNING("not enough working area available(requested %zu)", crc_code_size);
+			return retval;
+		}
+	}
 
 	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
 	armv7m_info.core_mode = ARM_MODE_THREAD;
 
 	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);
 	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);
 
 	buf_set_u32(reg_params[0].value, 0, 32, address);
 	buf_set_u32(reg_params[1].value, 0, 32, count);
+	buf_set_u32(reg_params[2].value, 0, 32, crc_table);
 
 	int timeout = 20000 * (1 + (count / (1024 * 1024)));
 
-	retval = target_run_algorithm(target, 0, NULL, 2, reg_params, crc_algorithm->address,
-			crc_algorithm->address + (sizeof(cortex_m_crc_code) - 6),
+	retval = target_run_algorithm(target, 0, NULL, crc_table ? 3 : 2, reg_params,
+			crc_algorithm->address,
+			crc_algorithm->address + (crc_code_size - 6),
 			timeout, &armv7m_info);
 
 	if (retval == ERROR_OK)
@@ -922,13 +968,197 @@ int armv7m_checksum_memory(struct target *target,
 
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
+	destroy_reg_param(&reg_params[2]);
 
-cleanup:
 	target_free_working_area(target, crc_algorithm);
 
 	return retval;
 }
 
+/*
+ * Run length compression of armv7m_write_compressed_memory(): a control
+ * byte n below 0x80 is followed by n + 1 literal bytes, a control byte n
+ * from 0x80 by a byte repeated n - 0x80 + 3 times.
+ */
+#define ARMV7M_RLE_MAX_LITERAL	128
+#define ARMV7M_RLE_MIN_REPEAT	3
+#define ARMV7M_RLE_MAX_REPEAT	(0x7f + ARMV7M_RLE_MIN_REPEAT)
+
+/* compressed data sent per run of the decompressor, at most */
+#define ARMV7M_RLE_BUFFER_SIZE	(16 * 1024)
+
+/*
+ * Compress @a count bytes of @a in up to the @a out_size bytes of @a out.
+ * @returns the compressed size, @a consumed the number of bytes compressed.
+ */
+static uint32_t armv7m_rle_compress(const uint8_t *in, uint32_t count,
+	uint8_t *out, uint32_t out_size, uint32_t *consumed)
+{
+	uint32_t in_pos = 0;
+	uint32_t out_pos = 0;
+	/* literal bytes at in_pos not stored yet */
+	uint32_t literals = 0;
+
+	while (in_pos + literals < count) {
+		const uint8_t *p = in + in_pos + literals;
+		uint32_t left = count - in_pos - literals;
+		uint32_t run = 1;
+
+		while (run < left && run < ARMV7M_RLE_MAX_REPEAT && p[run] == p[0])
+			run++;
+
+		if (run < ARMV7M_RLE_MIN_REPEAT) {
+			/* room for the literals with this one */
+			if (literals + 2 > out_size - out_pos)
+				break;
+			if (++literals < ARMV7M_RLE_MAX_LITERAL)
+				continue;
+		} else if ((literals ? literals + 1 : 0) + 2 > out_size - out_pos) {
+			break;
+		}
+
+		if (literals) {
+			out[out_pos++] = literals - 1;
+			memcpy(out + out_pos, in + in_pos, literals);
+			out_pos += literals;
+			in_pos += literals;
+			literals = 0;
+		}
+
+		if (run >= ARMV7M_RLE_MIN_REPEAT) {
+			out[out_pos++] = 0x80 + run - ARMV7M_RLE_MIN_REPEAT;
+			out[out_pos++] = p[0];
+			in_pos += run;
+		}
+	}
+
+	if (literals) {
+		out[out_pos++] = literals - 1;
+		memcpy(out + out_pos, in + in_pos, literals);
+		out_pos += literals;
+		in_pos += literals;
+	}
+
+	*consumed = in_pos;
+	return out_pos;
+}
+
+/**
+ * Writes a memory region through a run length decompressor running on
+ * the target, which sends much less data over the debug link for the
+ * large zero or constant regions of firmware images. The parts which
+ * hardly compress are written as they are.
+ */
+int armv7m_write_compressed_memory(struct target *target,
+	target_addr_t address, uint32_t count, const uint8_t *buffer)
+{
+	struct working_area *unrle_algorithm;
+	struct working_area *source;
+	struct armv7m_algorithm armv7m_info;
+	struct reg_param reg_params[3];
+	int retval;
+
+	static const uint8_t unrle_code[] = {
+#include "../../contrib/loaders/decompress/armv7m_unrle.inc"
+	};
+
+	retval = target_alloc_loader_working_area(target, unrle_code,
+			sizeof(unrle_code), sizeof(unrle_code), &unrle_algorithm);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t buffer_size = MIN(target_get_working_area_avail(target),
+			ARMV7M_RLE_BUFFER_SIZE) & ~3;
+	if (buffer_size < 256 || target_alloc_working_area(target, buffer_size, &source) != ERROR_OK) {
+		target_free_working_area(target, unrle_algorithm);
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	/* the decompressor must not overwrite itself */
+	if ((address < source->address + source->size && address + count > source->address)
+			|| (address < unrle_algorithm->address + unrle_algorithm->size
+				&& address + count > unrle_algorithm->address)) {
+		target_free_working_area(target, source);
+		target_free_working_area(target, unrle_algorithm);
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	uint8_t *compressed = malloc(buffer_size);
+	if (!compressed) {
+		LOG_ERROR("Out of memory");
+		target_free_working_area(target, source);
+		target_free_working_area(target, unrle_algorithm);
+		return ERROR_FAIL;
+	}
+
+	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_info.core_mode = ARM_MODE_THREAD;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_IN_OUT);
+
+	uint32_t done = 0;
+	uint32_t transferred = 0;
+
+	while (done < count) {
+		uint32_t consumed;
+		uint32_t size = armv7m_rle_compress(buffer + done, count - done,
+				compressed, buffer_size, &consumed);
+
+		if (size > consumed - consumed / 8) {
+			/* hardly compressible, write it as it is */
+			retval = target_write_buffer(target, address + done, consumed, buffer + done);
+			transferred += consumed;
+		} else {
+			retval = target_write_buffer(target, source->address, size, compressed);
+			if (retval != ERROR_OK)
+				break;
+
+			buf_set_u32(reg_params[0].value, 0, 32, source->address);
+			buf_set_u32(reg_params[1].value, 0, 32, source->address + size);
+			buf_set_u32(reg_params[2].value, 0, 32, address + done);
+
+			/* assume CPU clk at least 1 MHz */
+			retval = target_run_algorithm(target, 0, NULL,
+					ARRAY_SIZE(reg_params), reg_params,
+					unrle_algorithm->address,
+					unrle_algorithm->address + (sizeof(unrle_code) - 2),
+					1000 + consumed / 100, &armv7m_info);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("error executing cortex_m decompression algorithm");
+				break;
+			}
+
+			if (buf_get_u32(reg_params[2].value, 0, 32) != address + done + consumed) {
+				LOG_ERROR("cortex_m decompression algorithm wrote up to 0x%8.8" PRIx32
+					" instead of " TARGET_ADDR_FMT, buf_get_u32(reg_params[2].value, 0, 32),
+					address + done + consumed);
+				retval = ERROR_FAIL;
+			}
+			transferred += size;
+		}
+		if (retval != ERROR_OK)
+			break;
+
+		done += consumed;
+	}
+
+	if (retval == ERROR_OK)
+		LOG_DEBUG("wrote %" PRIu32 " bytes at " TARGET_ADDR_FMT " transferring %" PRIu32,
+			count, address, transferred);
+
+	destroy_reg_param(&reg_params[0]);
+	destroy_reg_param(&reg_params[1]);
+	destroy_reg_param(&reg_params[2]);
+
+	free(compressed);
+	target_free_working_area(target, source);
+	target_free_working_area(target, unrle_algorithm);
+
+	return retval;
+}
+
 /** Checks an array of memory regions whether they are erased. */
 int armv7m_blank_check_memory(struct target *target,
 	struct target_memory_check_block *blocks, int num_blocks, uint8_t erased_value)
@@ -341,6 +341,8 @@ int armv7m_checksum_memory(struct target *target,
 		target_addr_t address, uint32_t count, uint32_t *checksum);
 int armv7m_blank_check_memory(struct target *target,
 		struct target_memory_check_block *blocks, int num_blocks, uint8_t erased_value);
+int armv7m_write_compressed_memory(struct target *target,
+		target_addr_t address, uint32_t count, const uint8_t *buffer);
 
 int armv7m_maybe_skip_bkpt_inst(struct target *target, bool *inst_found);
 
@@ -967,6 +967,9 @@ int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	if (!meminfo && arm_tlb_lookup(&arm->tlb, arm->core_mode, va, val))
+		return ERROR_OK;
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		return retval;
@@ -1019,6 +1022,7 @@ int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
 		retval = ERROR_FAIL;
 	} else {
 		*val = (par & 0xFFFFFFFFF000UL) | (va & 0xFFF);
+		arm_tlb_insert(&arm->tlb, arm->core_mode, va, *val);
 		if (meminfo) {
 			int SH = (par >> 7) & 3;
 			int NS = (par >> 9) & 1;
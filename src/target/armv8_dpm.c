@@ -521,6 +521,10 @@ static int dpmv8_mcr(struct target *target, int cpnum,
 		(int) op1, (int) crn,
 		(int) crm, (int) op2);
 
+	/* may change the translations, e.g. TTBR, TTBCR or SCTLR */
+	if (cpnum == 15)
+		arm_tlb_flush(&arm->tlb);
+
 	/* read DCC into r0; then write coprocessor register from R0 */
 	retval = dpm->instr_write_data_r0(dpm,
 			ARMV4_5_MCR(cpnum, op1, 0, crn, crm, op2),
@@ -721,6 +725,91 @@ static int dpmv8_write_reg(struct arm_dpm *dpm, struct reg *r, unsigned regnum)
 	return retval;
 }
 
+/*
+ * Read the general purpose registers, SP and PC of a core in AArch64 state
+ * with a single run of the DAP queue. The instruction completion and the
+ * DCC state are not polled between the accesses, each instruction completes
+ * well before the next access reaches the core. Would one not, the overrun
+ * of ITR or the underrun of DTRTX sets a sticky flag of DSCR, checked at the
+ * end; the registers are then left invalid, to be read one by one.
+ */
+static int dpmv8_read_core_regs_queued(struct arm_dpm *dpm)
+{
+	struct arm *arm = dpm->arm;
+	struct armv8_common *armv8 = arm->arch_info;
+	struct adiv5_ap *ap = armv8->debug_ap;
+	uint32_t lo[ARMV8_PC + 1], hi[ARMV8_PC + 1];
+	bool queued[ARMV8_PC + 1] = { false };
+	unsigned int count = 0;
+	uint32_t dscr = 0;
+	int retval = ERROR_OK;
+
+	for (unsigned int i = ARMV8_R0; i <= ARMV8_PC && retval == ERROR_OK; i++) {
+		struct reg *r = armv8_reg_current(arm, i);
+		uint32_t opcode = ARMV8_MSR_GP(SYSTEM_DBG_DBGDTR_EL0, i);
+
+		if (!r->exist || r->valid)
+			continue;
+
+		/* X0 is saved already, it is the scratch register for SP and PC */
+		if (i == ARMV8_SP || i == ARMV8_PC) {
+			uint32_t mov = ARMV8_MRS_DLR(0);
+
+			if (i == ARMV8_SP)
+				mov = ARMV8_MOVFSP_64(0);
+			retval = mem_ap_write_u32(ap, armv8->debug_base + CPUV8_DBG_ITR, mov);
+			opcode = ARMV8_MSR_GP(SYSTEM_DBG_DBGDTR_EL0, 0);
+		}
+		if (retval == ERROR_OK)
+			retval = mem_ap_write_u32(ap, armv8->debug_base + CPUV8_DBG_ITR, opcode);
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(ap, armv8->debug_base + CPUV8_DBG_DTRTX, &lo[i]);
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(ap, armv8->debug_base + CPUV8_DBG_DTRRX, &hi[i]);
+		queued[i] = true;
+		count++;
+	}
+
+	if (!count)
+		return ERROR_OK;
+
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_u32(ap, armv8->debug_base + CPUV8_DBG_DSCR, &dscr);
+
+	int run_retval = dap_run(ap->dap);
+	if (retval == ERROR_OK)
+		retval = run_retval;
+	if (retval != ERROR_OK)
+		return retval;
+
+	dpm->dscr = dscr;
+	dpm->last_el = (dscr >> 8) & 3;
+
+	if (dscr & (DSCR_ERR | DSCR_TXU | DSCR_ITO)) {
+		LOG_DEBUG("queued register read failed, dscr 0x%08" PRIx32, dscr);
+		/* clear the sticky flags */
+		retval = mem_ap_write_atomic_u32(ap, armv8->debug_base + CPUV8_DBG_DRCR,
+				DRCR_CSE);
+		if (dscr & DSCR_ERR)
+			armv8_dpm_handle_exception(dpm, true);
+		return retval;
+	}
+
+	for (unsigned int i = ARMV8_R0; i <= ARMV8_PC; i++) {
+		struct reg *r = armv8_reg_current(arm, i);
+
+		if (!queued[i])
+			continue;
+
+		buf_set_u64(r->value, 0, r->size, (uint64_t)hi[i] << 32 | lo[i]);
+		r->valid = true;
+		r->dirty = false;
+		LOG_DEBUG("READ: %s, %16.8" PRIx64, r->name, (uint64_t)hi[i] << 32 | lo[i]);
+	}
+
+	return ERROR_OK;
+}
+
 /**
  * Read basic registers of the current context:  R0 to R15, and CPSR;
  * sets the core mode (such as USR or IRQ) and state (such as ARM or Thumb).
@@ -737,6 +826,9 @@ int armv8_dpm_read_current_registers(struct arm_dpm *dpm)
 	uint32_t cpsr;
 	int retval;
 
+	/* translations of the previous halt are stale */
+	arm_tlb_flush(&arm->tlb);
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		return retval;
@@ -769,6 +861,12 @@ int armv8_dpm_read_current_registers(struct arm_dpm *dpm)
 	/* update core mode and state */
 	armv8_set_cpsr(arm, cpsr);
 
+	if (arm->core_state == ARM_STATE_AARCH64) {
+		retval = dpmv8_read_core_regs_queued(dpm);
+		if (retval != ERROR_OK)
+			goto fail;
+	}
+
 	for (unsigned int i = ARMV8_PC; i < cache->num_regs ; i++) {
 		struct arm_reg *arm_reg;
 
@@ -866,6 +964,9 @@ int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 	struct reg_cache *cache = arm->core_cache;
 	int retval;
 
+	/* the core may run with other translations */
+	arm_tlb_flush(&arm->tlb);
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		goto done;
@@ -31,30 +31,80 @@ static const char * const watchpoint_rw_strings[] = {
 /* monotonic counter/id-number for breakpoints and watch points */
 static int bpwp_unique_id;
 
+/* Thumb and compressed RISC-V instructions are 2 byte aligned; fold in higher
+ * address bits too, so 4 byte aligned breakpoints use all buckets */
+static unsigned int breakpoint_hash(target_addr_t address)
+{
+	return ((address >> 1) ^ (address >> 7)) % TARGET_BREAKPOINT_HASH_SIZE;
+}
+
+/* Append to the bucket, keeping the order of target->breakpoints */
+static void breakpoint_index(struct target *target, struct breakpoint *breakpoint)
+{
+	struct breakpoint **bucket_p = &target->breakpoint_hash[breakpoint_hash(breakpoint->address)];
+
+	while (*bucket_p)
+		bucket_p = &(*bucket_p)->hash_next;
+	breakpoint->hash_next = NULL;
+	*bucket_p = breakpoint;
+}
+
+/* @a address is the one the breakpoint was indexed at */
+static void breakpoint_unindex_at(struct target *target, struct breakpoint *breakpoint,
+		target_addr_t address)
+{
+	struct breakpoint **bucket_p = &target->breakpoint_hash[breakpoint_hash(address)];
+
+	while (*bucket_p) {
+		if (*bucket_p == breakpoint) {
+			*bucket_p = breakpoint->hash_next;
+			breakpoint->hash_next = NULL;
+			return;
+		}
+		bucket_p = &(*bucket_p)->hash_next;
+	}
+}
+
+static void breakpoint_unindex(struct target *target, struct breakpoint *breakpoint)
+{
+	breakpoint_unindex_at(target, breakpoint, breakpoint->address);
+}
+
+static bool breakpoint_indexed(struct target *target, struct breakpoint *breakpoint)
+{
+	struct breakpoint *indexed = target->breakpoint_hash[breakpoint_hash(breakpoint->address)];
+
+	for (; indexed; indexed = indexed->hash_next) {
+		if (indexed == breakpoint)
+			return true;
+	}
+
+	return false;
+}
+
 static int breakpoint_add_internal(struct target *target,
 	target_addr_t address,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
 	struct breakpoint **breakpoint_p = &target->breakpoints;
 	const char *reason;
 	int retval;
 
-	while (breakpoint) {
-		if (breakpoint->address == address) {
-			/* FIXME don't assume "same address" means "same
-			 * breakpoint" ... check all the parameters before
-			 * succeeding.
-			 */
-			LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
-				address, breakpoint->unique_id);
-			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
-		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+	if (breakpoint) {
+		/* FIXME don't assume "same address" means "same
+		 * breakpoint" ... check all the parameters before
+		 * succeeding.
+		 */
+		LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
+			address, breakpoint->unique_id);
+		return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 	}
 
+	while (*breakpoint_p)
+		breakpoint_p = &(*breakpoint_p)->next;
+
 	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
 	(*breakpoint_p)->address = address;
 	(*breakpoint_p)->asid = 0;
@@ -63,6 +113,7 @@ static int breakpoint_add_internal(struct target *target,
 	(*breakpoint_p)->is_set = false;
 	(*breakpoint_p)->orig_instr = malloc(length);
 	(*breakpoint_p)->next = NULL;
+	(*breakpoint_p)->hash_next = NULL;
 	(*breakpoint_p)->unique_id = bpwp_unique_id++;
 
 	retval = target_add_breakpoint(target, *breakpoint_p);
@@ -85,6 +136,8 @@ fail:
 			return retval;
 	}
 
+	breakpoint_index(target, *breakpoint_p);
+
 	LOG_DEBUG("[%d] added %s breakpoint at " TARGET_ADDR_FMT
 			" of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		target->coreid,
@@ -126,6 +179,7 @@ static int context_breakpoint_add_internal(struct target *target,
 	(*breakpoint_p)->is_set = false;
 	(*breakpoint_p)->orig_instr = malloc(length);
 	(*breakpoint_p)->next = NULL;
+	(*breakpoint_p)->hash_next = NULL;
 	(*breakpoint_p)->unique_id = bpwp_unique_id++;
 	retval = target_add_context_breakpoint(target, *breakpoint_p);
 	if (retval != ERROR_OK) {
@@ -136,6 +190,8 @@ static int context_breakpoint_add_internal(struct target *target,
 		return retval;
 	}
 
+	breakpoint_index(target, *breakpoint_p);
+
 	LOG_DEBUG("added %s Context breakpoint at 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		breakpoint_type_strings[(*breakpoint_p)->type],
 		(*breakpoint_p)->asid, (*breakpoint_p)->length,
@@ -180,6 +236,7 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 	(*breakpoint_p)->is_set = false;
 	(*breakpoint_p)->orig_instr = malloc(length);
 	(*breakpoint_p)->next = NULL;
+	(*breakpoint_p)->hash_next = NULL;
 	(*breakpoint_p)->unique_id = bpwp_unique_id++;
 
 
@@ -191,6 +248,7 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 		*breakpoint_p = NULL;
 		return retval;
 	}
+	breakpoint_index(target, *breakpoint_p);
 	LOG_DEBUG(
 		"added %s Hybrid breakpoint at address " TARGET_ADDR_FMT " of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		breakpoint_type_strings[(*breakpoint_p)->type],
@@ -227,6 +285,90 @@ int breakpoint_add(struct target *target,
 	}
 }
 
+int breakpoint_add_batch(struct target *target, const target_addr_t *addresses,
+		unsigned int count, uint32_t length)
+{
+	if (!count)
+		return ERROR_OK;
+
+	/* software breakpoints of a SMP group go to the first core, as in
+	 * breakpoint_add() */
+	if (target->smp) {
+		struct target_list *head = list_first_entry(target->smp_targets, struct target_list, lh);
+		target = head->target;
+	}
+
+	struct breakpoint **breakpoint_list = calloc(count, sizeof(*breakpoint_list));
+	if (!breakpoint_list) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	unsigned int num_breakpoints;
+	for (num_breakpoints = 0; num_breakpoints < count; num_breakpoints++) {
+		target_addr_t address = addresses[num_breakpoints];
+		struct breakpoint *breakpoint = breakpoint_find(target, address);
+		if (breakpoint) {
+			LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
+				address, breakpoint->unique_id);
+			retval = ERROR_TARGET_DUPLICATE_BREAKPOINT;
+			break;
+		}
+
+		breakpoint = calloc(1, sizeof(*breakpoint));
+		if (breakpoint)
+			breakpoint->orig_instr = malloc(length);
+		if (!breakpoint || !breakpoint->orig_instr) {
+			free(breakpoint);
+			LOG_ERROR("Out of memory");
+			retval = ERROR_FAIL;
+			break;
+		}
+		breakpoint->address = address;
+		breakpoint->length = length;
+		breakpoint->type = BKPT_SOFT;
+		breakpoint->unique_id = bpwp_unique_id++;
+		/* index right away to catch duplicates within the batch */
+		breakpoint_index(target, breakpoint);
+		breakpoint_list[num_breakpoints] = breakpoint;
+	}
+
+	if (retval == ERROR_OK) {
+		retval = target_add_breakpoints(target, breakpoint_list, count);
+		if (retval != ERROR_OK)
+			LOG_ERROR("can't add %u breakpoints", count);
+	}
+
+	/* the target may have adjusted the addresses, e.g. MIPS64 sign extension */
+	for (unsigned int i = 0; i < num_breakpoints; i++)
+		breakpoint_unindex_at(target, breakpoint_list[i], addresses[i]);
+
+	if (retval != ERROR_OK) {
+		for (unsigned int i = 0; i < num_breakpoints; i++) {
+			free(breakpoint_list[i]->orig_instr);
+			free(breakpoint_list[i]);
+		}
+		free(breakpoint_list);
+		return retval;
+	}
+
+	struct breakpoint **breakpoint_p = &target->breakpoints;
+	while (*breakpoint_p)
+		breakpoint_p = &(*breakpoint_p)->next;
+	for (unsigned int i = 0; i < count; i++) {
+		breakpoint_index(target, breakpoint_list[i]);
+		*breakpoint_p = breakpoint_list[i];
+		breakpoint_p = &breakpoint_list[i]->next;
+	}
+	free(breakpoint_list);
+
+	LOG_DEBUG("[%d] added %u software breakpoints of length 0x%8.8" PRIx32,
+		target->coreid, count, length);
+
+	return ERROR_OK;
+}
+
 int context_breakpoint_add(struct target *target,
 	uint32_t asid,
 	uint32_t length,
@@ -290,20 +432,59 @@ static void breakpoint_free(struct target *target, struct breakpoint *breakpoint
 
 	LOG_DEBUG("free BPID: %" PRIu32 " --> %d", breakpoint->unique_id, retval);
 	(*breakpoint_p) = breakpoint->next;
+	breakpoint_unindex(target, breakpoint);
 	free(breakpoint->orig_instr);
 	free(breakpoint);
 }
 
-static int breakpoint_remove_internal(struct target *target, target_addr_t address)
+/* free up the @a num_breakpoints breakpoints of @a breakpoint_list, which
+ * are already dropped from the address index */
+static void breakpoint_free_batch(struct target *target,
+		struct breakpoint **breakpoint_list, unsigned int num_breakpoints)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	if (!num_breakpoints)
+		return;
 
-	while (breakpoint) {
-		if ((breakpoint->address == address) ||
-		    (breakpoint->address == 0 && breakpoint->asid == address))
-			break;
-		breakpoint = breakpoint->next;
+	int retval = target_remove_breakpoints(target, breakpoint_list, num_breakpoints);
+	LOG_DEBUG("free %u breakpoints --> %d", num_breakpoints, retval);
+
+	/* a single pass unlinks all of them */
+	struct breakpoint **breakpoint_p = &target->breakpoints;
+	while (*breakpoint_p) {
+		if (breakpoint_indexed(target, *breakpoint_p))
+			breakpoint_p = &(*breakpoint_p)->next;
+		else
+			*breakpoint_p = (*breakpoint_p)->next;
+	}
+
+	for (unsigned int i = 0; i < num_breakpoints; i++) {
+		free(breakpoint_list[i]->orig_instr);
+		free(breakpoint_list[i]);
 	}
+}
+
+/* the breakpoint @a address or the context breakpoint of ASID @a address */
+static struct breakpoint *breakpoint_find_for_removal(struct target *target,
+		target_addr_t address)
+{
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
+
+	if (breakpoint)
+		return breakpoint;
+
+	/* context breakpoints are indexed at address 0 */
+	breakpoint = target->breakpoint_hash[breakpoint_hash(0)];
+	for (; breakpoint; breakpoint = breakpoint->hash_next) {
+		if (breakpoint->address == 0 && breakpoint->asid == address)
+			return breakpoint;
+	}
+
+	return NULL;
+}
+
+static int breakpoint_remove_internal(struct target *target, target_addr_t address)
+{
+	struct breakpoint *breakpoint = breakpoint_find_for_removal(target, address);
 
 	if (breakpoint) {
 		breakpoint_free(target, breakpoint);
@@ -317,13 +498,52 @@ static int breakpoint_remove_internal(struct target *target, target_addr_t addre
 
 static void breakpoint_remove_all_internal(struct target *target)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	unsigned int num_breakpoints = 0;
 
-	while (breakpoint) {
-		struct breakpoint *tmp = breakpoint;
-		breakpoint = breakpoint->next;
-		breakpoint_free(target, tmp);
+	for (struct breakpoint *breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next)
+		num_breakpoints++;
+	if (!num_breakpoints)
+		return;
+
+	struct breakpoint **breakpoint_list = malloc(num_breakpoints * sizeof(*breakpoint_list));
+	if (!breakpoint_list) {
+		/* one at a time then */
+		while (target->breakpoints)
+			breakpoint_free(target, target->breakpoints);
+		return;
 	}
+
+	unsigned int i = 0;
+	for (struct breakpoint *breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next)
+		breakpoint_list[i++] = breakpoint;
+	memset(target->breakpoint_hash, 0, sizeof(target->breakpoint_hash));
+
+	breakpoint_free_batch(target, breakpoint_list, num_breakpoints);
+	free(breakpoint_list);
+}
+
+static unsigned int breakpoint_remove_batch_internal(struct target *target,
+		const target_addr_t *addresses, unsigned int count)
+{
+	struct breakpoint **breakpoint_list = malloc(count * sizeof(*breakpoint_list));
+	if (!breakpoint_list) {
+		LOG_ERROR("Out of memory");
+		return 0;
+	}
+
+	unsigned int num_breakpoints = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		struct breakpoint *breakpoint = breakpoint_find_for_removal(target, addresses[i]);
+		if (!breakpoint)
+			continue;
+		breakpoint_unindex(target, breakpoint);
+		breakpoint_list[num_breakpoints++] = breakpoint;
+	}
+
+	breakpoint_free_batch(target, breakpoint_list, num_breakpoints);
+	free(breakpoint_list);
+
+	return num_breakpoints;
 }
 
 void breakpoint_remove(struct target *target, target_addr_t address)
@@ -343,6 +563,28 @@ void breakpoint_remove(struct target *target, target_addr_t address)
 	}
 }
 
+unsigned int breakpoint_remove_batch(struct target *target,
+		const target_addr_t *addresses, unsigned int count)
+{
+	unsigned int num_breakpoints = 0;
+
+	if (!count)
+		return 0;
+
+	if (target->smp) {
+		struct target_list *head;
+
+		foreach_smp_target(head, target->smp_targets) {
+			struct target *curr = head->target;
+			num_breakpoints += breakpoint_remove_batch_internal(curr, addresses, count);
+		}
+	} else {
+		num_breakpoints = breakpoint_remove_batch_internal(target, addresses, count);
+	}
+
+	return num_breakpoints;
+}
+
 void breakpoint_remove_all(struct target *target)
 {
 	if (target->smp) {
@@ -361,8 +603,7 @@ static void breakpoint_clear_target_internal(struct target *target)
 {
 	LOG_DEBUG("Delete all breakpoints for target: %s",
 		target_name(target));
-	while (target->breakpoints)
-		breakpoint_free(target, target->breakpoints);
+	breakpoint_remove_all_internal(target);
 }
 
 void breakpoint_clear_target(struct target *target)
@@ -379,14 +620,24 @@ void breakpoint_clear_target(struct target *target)
 	}
 }
 
+void breakpoint_forget_all(struct target *target)
+{
+	while (target->breakpoints) {
+		struct breakpoint *next = target->breakpoints->next;
+		free(target->breakpoints->orig_instr);
+		free(target->breakpoints);
+		target->breakpoints = next;
+	}
+	memset(target->breakpoint_hash, 0, sizeof(target->breakpoint_hash));
+}
+
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = target->breakpoint_hash[breakpoint_hash(address)];
 
-	while (breakpoint) {
+	for (; breakpoint; breakpoint = breakpoint->hash_next) {
 		if (breakpoint->address == address)
 			return breakpoint;
-		breakpoint = breakpoint->next;
 	}
 
 	return NULL;
@@ -32,6 +32,8 @@ struct breakpoint {
 	unsigned int number;
 	uint8_t *orig_instr;
 	struct breakpoint *next;
+	/** next breakpoint in the same bucket of the target's address index */
+	struct breakpoint *hash_next;
 	uint32_t unique_id;
 	int linked_brp;
 };
@@ -58,6 +60,25 @@ int hybrid_breakpoint_add(struct target *target,
 void breakpoint_remove(struct target *target, target_addr_t address);
 void breakpoint_remove_all(struct target *target);
 
+/**
+ * Add software breakpoints of @a length bytes at all @a count @a addresses,
+ * setting them with a single batch of target memory accesses where the
+ * target supports it. Either all breakpoints get added or none.
+ */
+int breakpoint_add_batch(struct target *target, const target_addr_t *addresses,
+		unsigned int count, uint32_t length);
+/**
+ * Remove the breakpoints at all @a count @a addresses at once.
+ * @returns the number of breakpoints removed.
+ */
+unsigned int breakpoint_remove_batch(struct target *target,
+		const target_addr_t *addresses, unsigned int count);
+/**
+ * Drop all breakpoints of @a target without accessing the target, e.g.
+ * after a reset cleared them in hardware and memory.
+ */
+void breakpoint_forget_all(struct target *target);
+
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address);
 
 static inline void breakpoint_hw_set(struct breakpoint *breakpoint, unsigned int hw_number)
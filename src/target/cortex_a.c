@@ -2678,6 +2678,99 @@ static int cortex_a_read_cpu_memory(struct target *target,
  * ap number for every access.
  */
 
+/* Memory accesses of at least this size go through the system bus AP */
+#define CORTEX_A_SYSBUS_MIN_BYTES	1024
+/* Smallest page, the range is translated page by page */
+#define CORTEX_A_SYSBUS_PAGE_SIZE	4096
+
+static bool cortex_a_use_sysbus(struct target *target, target_addr_t address,
+	uint32_t size, uint32_t count)
+{
+	struct cortex_a_common *cortex_a = target_to_cortex_a(target);
+
+	return cortex_a->sysbus_ap_num != DP_APSEL_INVALID &&
+		size * count >= CORTEX_A_SYSBUS_MIN_BYTES &&
+		!(address & (size - 1));
+}
+
+/*
+ * Access the memory through the system bus AP. The D-cache lines of the
+ * range are cleaned and invalidated by the core first, so the bus sees
+ * the data of the core and the core sees the data written on the bus;
+ * the range is then translated by the core when the MMU is on.
+ */
+static int cortex_a_sysbus_access(struct target *target, target_addr_t address,
+	uint32_t size, uint32_t count, uint8_t *rbuf, const uint8_t *wbuf)
+{
+	struct cortex_a_common *cortex_a = target_to_cortex_a(target);
+	struct armv7a_common *armv7a = &cortex_a->armv7a_common;
+	struct armv7a_cache_common *cache = &armv7a->armv7a_mmu.armv7a_cache;
+	target_addr_t va = address;
+	uint32_t len = size * count;
+	int mmu_enabled = 0;
+	int retval;
+
+	if (!cortex_a->sysbus_ap) {
+		cortex_a->sysbus_ap = dap_get_ap(armv7a->arm.dap, cortex_a->sysbus_ap_num);
+		if (!cortex_a->sysbus_ap) {
+			LOG_ERROR("Cannot get AP 0x%" PRIx64 " for the system bus",
+				cortex_a->sysbus_ap_num);
+			return ERROR_FAIL;
+		}
+		retval = mem_ap_init(cortex_a->sysbus_ap);
+		if (retval != ERROR_OK) {
+			dap_put_ap(cortex_a->sysbus_ap);
+			cortex_a->sysbus_ap = NULL;
+			return retval;
+		}
+	}
+
+	retval = cortex_a_mmu(target, &mmu_enabled);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (cache->d_u_cache_enabled)
+		armv7a_cache_flush_virt(target, va, len);
+
+	cortex_a_prep_memaccess(target, 0);
+
+	while (len) {
+		target_addr_t pa = va;
+		uint32_t chunk = len;
+
+		if (mmu_enabled) {
+			chunk = MIN(len, CORTEX_A_SYSBUS_PAGE_SIZE -
+					(va & (CORTEX_A_SYSBUS_PAGE_SIZE - 1)));
+			retval = armv7a_mmu_translate_va_pa(target, va, &pa, 0);
+			if (retval != ERROR_OK)
+				break;
+		}
+
+		if (rbuf) {
+			retval = mem_ap_read_buf(cortex_a->sysbus_ap, rbuf, size,
+					chunk / size, pa);
+			rbuf += chunk;
+		} else {
+			retval = mem_ap_write_buf(cortex_a->sysbus_ap, wbuf, size,
+					chunk / size, pa);
+			wbuf += chunk;
+		}
+		if (retval != ERROR_OK)
+			break;
+
+		va += chunk;
+		len -= chunk;
+	}
+
+	cortex_a_post_memaccess(target, 0);
+
+	/* the range may hold code */
+	if (retval == ERROR_OK && wbuf && cache->i_cache_enabled)
+		retval = armv7a_l1_i_cache_inval_virt(target, address, size * count);
+
+	return retval;
+}
+
 static int cortex_a_read_phys_memory(struct target *target,
 	target_addr_t address, uint32_t size,
 	uint32_t count, uint8_t *buffer)
@@ -2707,6 +2800,9 @@ static int cortex_a_read_memory(struct target *target, target_addr_t address,
 	LOG_DEBUG("Reading memory at address " TARGET_ADDR_FMT "; size %" PRIu32 "; count %" PRIu32,
 		address, size, count);
 
+	if (cortex_a_use_sysbus(target, address, size, count))
+		return cortex_a_sysbus_access(target, address, size, count, buffer, NULL);
+
 	cortex_a_prep_memaccess(target, 0);
 	retval = cortex_a_read_cpu_memory(target, address, size, count, buffer);
 	cortex_a_post_memaccess(target, 0);
@@ -2743,6 +2839,9 @@ static int cortex_a_write_memory(struct target *target, target_addr_t address,
 	LOG_DEBUG("Writing memory at address " TARGET_ADDR_FMT "; size %" PRIu32 "; count %" PRIu32,
 		address, size, count);
 
+	if (cortex_a_use_sysbus(target, address, size, count))
+		return cortex_a_sysbus_access(target, address, size, count, NULL, buffer);
+
 	/* memory writes bypass the caches, must flush before writing */
 	armv7a_cache_auto_flush_on_write(target, address, size * count);
 
@@ -3083,6 +3182,7 @@ static int cortex_a_init_arch_info(struct target *target,
 
 	/* Setup struct cortex_a_common */
 	cortex_a->common_magic = CORTEX_A_COMMON_MAGIC;
+	cortex_a->sysbus_ap_num = DP_APSEL_INVALID;
 	armv7a->arm.dap = dap;
 
 	/* register arch-specific functions */
@@ -3167,6 +3267,8 @@ static void cortex_a_deinit_target(struct target *target)
 
 	if (armv7a->debug_ap)
 		dap_put_ap(armv7a->debug_ap);
+	if (cortex_a->sysbus_ap)
+		dap_put_ap(cortex_a->sysbus_ap);
 
 	free(cortex_a->wrp_list);
 	free(cortex_a->brp_list);
@@ -3295,6 +3397,35 @@ COMMAND_HANDLER(handle_cortex_a_dacrfixup_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_cortex_a_sysbus_ap_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct cortex_a_common *cortex_a = target_to_cortex_a(target);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		uint64_t ap_num = DP_APSEL_INVALID;
+
+		if (strcmp(CMD_ARGV[0], "off"))
+			COMMAND_PARSE_NUMBER(u64, CMD_ARGV[0], ap_num);
+
+		if (cortex_a->sysbus_ap) {
+			dap_put_ap(cortex_a->sysbus_ap);
+			cortex_a->sysbus_ap = NULL;
+		}
+		cortex_a->sysbus_ap_num = ap_num;
+	}
+
+	if (cortex_a->sysbus_ap_num == DP_APSEL_INVALID)
+		command_print(CMD, "off");
+	else
+		command_print(CMD, "0x%" PRIx64, cortex_a->sysbus_ap_num);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration cortex_a_exec_command_handlers[] = {
 	{
 		.name = "cache_info",
@@ -3325,9 +3456,19 @@ static const struct command_registration cortex_a_exec_command_handlers[] = {
 			"on memory access",
 		.usage = "['on'|'off']",
 	},
+	{
+		.name = "sysbus_ap",
+		.handler = handle_cortex_a_sysbus_ap_command,
+		.mode = COMMAND_ANY,
+		.help = "set the MEM-AP used for bulk memory accesses",
+		.usage = "[ap_num|'off']",
+	},
 	{
 		.chain = armv7a_mmu_command_handlers,
 	},
+	{
+		.chain = arm_tlb_command_handlers,
+	},
 	{
 		.chain = smp_command_handlers,
 	},
@@ -98,6 +98,10 @@ struct cortex_a_common {
 
 	enum cortex_a_isrmasking_mode isrmasking_mode;
 	enum cortex_a_dacrfixup_mode dacrfixup_mode;
+
+	/* System bus MEM-AP for bulk memory accesses, DP_APSEL_INVALID if none */
+	uint64_t sysbus_ap_num;
+	struct adiv5_ap *sysbus_ap;
 };
 
 static inline struct cortex_a_common *
@@ -46,6 +46,9 @@
 /* Timeout for register r/w */
 #define DHCSR_S_REGRDY_TIMEOUT (500)
 
+/* smaller memory writes are not worth running the decompressor */
+#define CORTEX_M_COMPRESSED_WRITE_MIN	1024
+
 /* Supported Cortex-M Cores */
 static const struct cortex_m_part_info cortex_m_parts[] = {
 	{
@@ -144,6 +147,81 @@ static int cortex_m_read_dhcsr_atomic_sticky(struct target *target)
 	return ERROR_OK;
 }
 
+/* A prefetched DHCSR is only for the poll of the same poll tick */
+#define DHCSR_PREFETCH_MS	50
+
+static bool cortex_m_dhcsr_prefetch_fresh(const struct cortex_m_common *cortex_m)
+{
+	return cortex_m->dhcsr_prefetch_valid &&
+		timeval_ms() - cortex_m->dhcsr_prefetch_ms < DHCSR_PREFETCH_MS;
+}
+
+static bool cortex_m_dhcsr_prefetch_peer(struct target *target, struct adiv5_dap *dap)
+{
+	if (!target_was_examined(target) || !target->tap->enabled)
+		return false;
+
+	struct cortex_m_common *cortex_m = target_to_cortex_m_safe(target);
+	if (!cortex_m || !is_cortex_m_with_dap_access(cortex_m) ||
+			!cortex_m->armv7m.debug_ap || cortex_m->armv7m.debug_ap->dap != dap)
+		return false;
+
+	return !cortex_m_dhcsr_prefetch_fresh(cortex_m);
+}
+
+/** Read the DHCSR of all the Cortex-M cores on the DAP of the target, whose
+ * prefetched DHCSR isn't fresh, with a single DAP run. A poll tick then costs
+ * one run for all of them, instead of one per core. The sticky bits are
+ * cumulated right away, as the read clears them.
+ */
+static int cortex_m_prefetch_dhcsr(struct target *target)
+{
+	struct adiv5_dap *dap = target_to_armv7m(target)->debug_ap->dap;
+	unsigned int count = 0;
+	int retval = ERROR_OK;
+
+	for (struct target *t = all_targets; t; t = t->next)
+		if (cortex_m_dhcsr_prefetch_peer(t, dap))
+			count++;
+
+	/* nothing to share */
+	if (count < 2)
+		return ERROR_OK;
+
+	for (struct target *t = all_targets; t; t = t->next) {
+		if (!cortex_m_dhcsr_prefetch_peer(t, dap))
+			continue;
+
+		struct cortex_m_common *cortex_m = target_to_cm(t);
+		retval = mem_ap_read_u32(cortex_m->armv7m.debug_ap, DCB_DHCSR,
+				&cortex_m->dhcsr_prefetched);
+		if (retval != ERROR_OK)
+			break;
+		cortex_m->dhcsr_prefetch_queued = true;
+	}
+
+	int retval2 = dap_run(dap);
+	if (retval == ERROR_OK)
+		retval = retval2;
+	int64_t now = timeval_ms();
+
+	for (struct target *t = all_targets; t; t = t->next) {
+		struct cortex_m_common *cortex_m = target_to_cortex_m_safe(t);
+		if (!cortex_m || !cortex_m->dhcsr_prefetch_queued)
+			continue;
+
+		cortex_m->dhcsr_prefetch_queued = false;
+		if (retval != ERROR_OK)
+			continue;
+
+		cortex_m_cumulate_dhcsr_sticky(cortex_m, cortex_m->dhcsr_prefetched);
+		cortex_m->dhcsr_prefetch_valid = true;
+		cortex_m->dhcsr_prefetch_ms = now;
+	}
+
+	return retval;
+}
+
 static int cortex_m_load_core_reg_u32(struct target *target,
 		uint32_t regsel, uint32_t *value)
 {
@@ -241,7 +319,11 @@ static int cortex_m_queue_reg_read(struct target *target, uint32_t regsel,
 	return mem_ap_read_u32(armv7m->debug_ap, DCB_DCRDR, reg_value);
 }
 
-static int cortex_m_fast_read_all_regs(struct target *target)
+/* Read the 32 and 64-bit registers @a reg_ids of the core cache in one
+ * DAP transaction. Fails with ERROR_TIMEOUT_REACHED if the core wasn't fast
+ * enough, the caller has to fall back to reads polling S_REGRDY then. */
+static int cortex_m_fast_read_reg_ids(struct target *target,
+		const unsigned int *reg_ids, unsigned int num_ids)
 {
 	struct cortex_m_common *cortex_m = target_to_cm(target);
 	struct armv7m_common *armv7m = target_to_armv7m(target);
@@ -256,7 +338,6 @@ static int cortex_m_fast_read_all_regs(struct target *target)
 			return retval;
 	}
 
-	const unsigned int num_regs = armv7m->arm.core_cache->num_regs;
 	const unsigned int n_r32 = ARMV7M_LAST_REG - ARMV7M_CORE_FIRST_REG + 1
 							   + ARMV7M_FPU_LAST_REG - ARMV7M_FPU_FIRST_REG + 1;
 	/* we need one 32-bit word for each register except FP D0..D15, which
@@ -265,17 +346,9 @@ static int cortex_m_fast_read_all_regs(struct target *target)
 	uint32_t dhcsr[n_r32];
 
 	unsigned int wi = 0; /* write index to r_vals and dhcsr arrays */
-	unsigned int reg_id; /* register index in the reg_list, ARMV7M_R0... */
-	for (reg_id = 0; reg_id < num_regs; reg_id++) {
+	for (unsigned int i = 0; i < num_ids; i++) {
+		unsigned int reg_id = reg_ids[i];
 		struct reg *r = &armv7m->arm.core_cache->reg_list[reg_id];
-		if (!r->exist)
-			continue;	/* skip non existent registers */
-
-		if (r->size <= 8) {
-			/* Any 8-bit or shorter register is unpacked from a 32-bit
-			 * container register. Skip it now. */
-			continue;
-		}
 
 		uint32_t regsel = armv7m_map_id_to_regsel(reg_id);
 		retval = cortex_m_queue_reg_read(target, regsel, &r_vals[wi],
@@ -329,12 +402,55 @@ static int cortex_m_fast_read_all_regs(struct target *target)
 	LOG_TARGET_DEBUG(target, "read %u 32-bit registers", wi);
 
 	unsigned int ri = 0; /* read index from r_vals array */
+	for (unsigned int i = 0; i < num_ids; i++) {
+		unsigned int reg_id = reg_ids[i];
+		struct reg *r = &armv7m->arm.core_cache->reg_list[reg_id];
+
+		buf_set_u32(r->value, 0, 32, r_vals[ri++]);
+		if (r->size == 64) {
+			/* the odd part of FP register (S1, S3...) */
+			buf_set_u32(r->value + 4, 0, 32, r_vals[ri++]);
+		}
+		r->dirty = false;
+		r->valid = true;
+	}
+	assert(ri == wi);
+
+	return ERROR_OK;
+}
+
+static int cortex_m_fast_read_all_regs(struct target *target)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	const unsigned int num_regs = armv7m->arm.core_cache->num_regs;
+	unsigned int reg_ids[ARMV7M_LAST_REG] = { 0 };
+	unsigned int num_ids = 0;
+	unsigned int reg_id; /* register index in the reg_list, ARMV7M_R0... */
+
+	assert(num_regs <= ARMV7M_LAST_REG);
+
 	for (reg_id = 0; reg_id < num_regs; reg_id++) {
 		struct reg *r = &armv7m->arm.core_cache->reg_list[reg_id];
 		if (!r->exist)
 			continue;	/* skip non existent registers */
 
-		r->dirty = false;
+		if (r->size <= 8) {
+			/* Any 8-bit or shorter register is unpacked from a 32-bit
+			 * container register. Skip it now. */
+			continue;
+		}
+
+		reg_ids[num_ids++] = reg_id;
+	}
+
+	int retval = cortex_m_fast_read_reg_ids(target, reg_ids, num_ids);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (reg_id = 0; reg_id < num_regs; reg_id++) {
+		struct reg *r = &armv7m->arm.core_cache->reg_list[reg_id];
+		if (!r->exist)
+			continue;	/* skip non existent registers */
 
 		unsigned int reg32_id;
 		uint32_t offset;
@@ -347,22 +463,84 @@ static int cortex_m_fast_read_all_regs(struct target *target)
 			 * to unpack */
 			assert(r32->valid);
 			buf_cpy(r32->value + offset, r->value, r->size);
+			r->dirty = false;
+			r->valid = true;
+		}
+	}
 
-		} else {
-			assert(r->size == 32 || r->size == 64);
-			buf_set_u32(r->value, 0, 32, r_vals[ri++]);
+	return retval;
+}
+
+/* Index of @a reg in the core register cache, or -1 if it belongs
+ * to another cache */
+static int cortex_m_core_reg_id(struct target *target, const struct reg *reg)
+{
+	struct reg_cache *cache = target_to_armv7m(target)->arm.core_cache;
+
+	if (reg < cache->reg_list || reg >= cache->reg_list + cache->num_regs)
+		return -1;
+
+	return reg - cache->reg_list;
+}
 
-			if (r->size == 64) {
-				assert(reg_id >= ARMV7M_FPU_FIRST_REG && reg_id <= ARMV7M_FPU_LAST_REG);
-				/* the odd part of FP register (S1, S3...) */
-				buf_set_u32(r->value + 4, 0, 32, r_vals[ri++]);
+static int cortex_m_read_registers(struct target *target, struct reg **reg_list,
+		unsigned int num_regs)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct reg_cache *cache = armv7m->arm.core_cache;
+	bool selected[ARMV7M_LAST_REG] = { false };
+	unsigned int reg_ids[ARMV7M_LAST_REG];
+	unsigned int num_ids = 0;
+
+	if (target->state == TARGET_HALTED && !cortex_m->slow_register_read) {
+		/* collect the 32 and 64-bit registers to read, including the
+		 * containers of packed registers */
+		for (unsigned int i = 0; i < num_regs; i++) {
+			struct reg *r = reg_list[i];
+			if (!r || !r->exist || r->valid)
+				continue;
+
+			int reg_id = cortex_m_core_reg_id(target, r);
+			if (reg_id < 0)
+				continue;
+
+			unsigned int reg32_id;
+			uint32_t offset;
+			if (armv7m_map_reg_packing(reg_id, &reg32_id, &offset)) {
+				if (cache->reg_list[reg32_id].valid)
+					continue;
+				reg_id = reg32_id;
+			}
+
+			if (!selected[reg_id]) {
+				selected[reg_id] = true;
+				reg_ids[num_ids++] = reg_id;
 			}
 		}
-		r->valid = true;
 	}
-	assert(ri == wi);
 
-	return retval;
+	if (num_ids > 1) {
+		int retval = cortex_m_fast_read_reg_ids(target, reg_ids, num_ids);
+		if (retval == ERROR_TIMEOUT_REACHED) {
+			cortex_m->slow_register_read = true;
+			LOG_TARGET_DEBUG(target, "Switched to slow register read");
+		}
+		/* on errors, fall back to reading the registers one by one */
+	}
+
+	/* unpack the packed registers and read anything left */
+	for (unsigned int i = 0; i < num_regs; i++) {
+		struct reg *r = reg_list[i];
+		if (!r || !r->exist || r->valid)
+			continue;
+
+		int retval = r->type->get(r);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
 }
 
 static int cortex_m_store_core_reg_u32(struct target *target,
@@ -415,12 +593,139 @@ static int cortex_m_store_core_reg_u32(struct target *target,
 	return retval;
 }
 
+/* Write the dirty registers of @a reg_list in one DAP transaction. Any
+ * register left dirty, e.g. because the core was not fast enough, is
+ * written by armv7m_restore_context() polling S_REGRDY. */
+static int cortex_m_write_registers(struct target *target, struct reg **reg_list,
+		unsigned int num_regs)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct reg_cache *cache = armv7m->arm.core_cache;
+	bool selected[ARMV7M_LAST_REG] = { false };
+	unsigned int reg_ids[ARMV7M_LAST_REG];
+	unsigned int num_ids = 0;
+	int retval;
+
+	if (target->state != TARGET_HALTED || cortex_m->slow_register_read)
+		return ERROR_OK;
+
+	/* merge the packed registers into their containers first */
+	for (unsigned int i = 0; i < num_regs; i++) {
+		struct reg *r = reg_list[i];
+		if (!r || !r->exist || !r->dirty || r->size > 8)
+			continue;
+
+		int reg_id = cortex_m_core_reg_id(target, r);
+		if (reg_id < 0)
+			continue;
+
+		retval = armv7m->arm.write_core_reg(target, r, reg_id, ARM_MODE_ANY, r->value);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	for (unsigned int i = 0; i < num_regs; i++) {
+		struct reg *r = reg_list[i];
+		if (!r || !r->exist)
+			continue;
+
+		int reg_id = cortex_m_core_reg_id(target, r);
+		if (reg_id < 0)
+			continue;
+
+		unsigned int reg32_id;
+		uint32_t offset;
+		if (armv7m_map_reg_packing(reg_id, &reg32_id, &offset))
+			reg_id = reg32_id;
+
+		if (cache->reg_list[reg_id].dirty && !selected[reg_id]) {
+			selected[reg_id] = true;
+			reg_ids[num_ids++] = reg_id;
+		}
+	}
+
+	if (num_ids < 2)
+		return ERROR_OK;
+
+	uint32_t dcrdr;
+	/* because the DCB_DCRDR is used for the emulated dcc channel
+	 * we have to save/restore the DCB_DCRDR when used */
+	if (target->dbg_msg_enabled) {
+		retval = mem_ap_read_u32(armv7m->debug_ap, DCB_DCRDR, &dcrdr);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	/* one DHCSR value per 32-bit word written */
+	uint32_t dhcsr[2 * num_ids];
+	unsigned int wi = 0;
+	for (unsigned int i = 0; i < num_ids; i++) {
+		struct reg *r = &cache->reg_list[reg_ids[i]];
+		uint32_t regsel = armv7m_map_id_to_regsel(reg_ids[i]);
+
+		assert(r->size == 32 || r->size == 64);
+		for (unsigned int word = 0; word < r->size / 32; word++) {
+			retval = mem_ap_write_u32(armv7m->debug_ap, DCB_DCRDR,
+					buf_get_u32(r->value + 4 * word, 0, 32));
+			if (retval == ERROR_OK)
+				retval = mem_ap_write_u32(armv7m->debug_ap, DCB_DCRSR,
+						(regsel + word) | DCRSR_WNR);
+			if (retval == ERROR_OK)
+				retval = mem_ap_read_u32(armv7m->debug_ap, DCB_DHCSR, &dhcsr[wi++]);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	retval = dap_run(armv7m->debug_ap->dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (target->dbg_msg_enabled) {
+		/* restore DCB_DCRDR - this needs to be in a separate
+		 * transaction otherwise the emulated DCC channel breaks */
+		retval = mem_ap_write_atomic_u32(armv7m->debug_ap, DCB_DCRDR, dcrdr);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	bool not_ready = false;
+	for (unsigned int i = 0; i < wi; i++) {
+		if (!(dhcsr[i] & S_REGRDY))
+			not_ready = true;
+		cortex_m_cumulate_dhcsr_sticky(cortex_m, dhcsr[i]);
+	}
+
+	if (not_ready) {
+		/* a later write may have overtaken an earlier one, the
+		 * registers stay dirty and are all written again */
+		cortex_m->slow_register_read = true;
+		LOG_TARGET_DEBUG(target, "Register not ready during fast write, "
+				"switched to slow register access");
+		return ERROR_OK;
+	}
+
+	for (unsigned int i = 0; i < num_ids; i++) {
+		struct reg *r = &cache->reg_list[reg_ids[i]];
+		r->valid = true;
+		r->dirty = false;
+	}
+
+	LOG_TARGET_DEBUG(target, "wrote %u 32-bit registers", wi);
+
+	return ERROR_OK;
+}
+
 static int cortex_m_write_debug_halt_mask(struct target *target,
 	uint32_t mask_on, uint32_t mask_off)
 {
 	struct cortex_m_common *cortex_m = target_to_cm(target);
 	struct armv7m_common *armv7m = &cortex_m->armv7m;
 
+	/* the state changes, don't poll an older one */
+	cortex_m->dhcsr_prefetch_valid = false;
+
 	/* mask off status bits */
 	cortex_m->dcb_dhcsr &= ~((0xFFFFul << 16) | mask_off);
 	/* create new register mask */
@@ -880,11 +1185,20 @@ static int cortex_m_poll_one(struct target *target)
 	struct cortex_m_common *cortex_m = target_to_cm(target);
 	struct armv7m_common *armv7m = &cortex_m->armv7m;
 
-	/* Read from Debug Halting Control and Status Register */
-	retval = cortex_m_read_dhcsr_atomic_sticky(target);
-	if (retval != ERROR_OK) {
-		target->state = TARGET_UNKNOWN;
-		return retval;
+	/* Read from Debug Halting Control and Status Register, along with the
+	 * other cores on the DAP. A failure is reported by the read of this core */
+	if (!cortex_m_dhcsr_prefetch_fresh(cortex_m))
+		cortex_m_prefetch_dhcsr(target);
+
+	if (cortex_m_dhcsr_prefetch_fresh(cortex_m)) {
+		cortex_m->dcb_dhcsr = cortex_m->dhcsr_prefetched;
+		cortex_m->dhcsr_prefetch_valid = false;
+	} else {
+		retval = cortex_m_read_dhcsr_atomic_sticky(target);
+		if (retval != ERROR_OK) {
+			target->state = TARGET_UNKNOWN;
+			return retval;
+		}
 	}
 
 	/* Recover from lockup.  See ARMv7-M architecture spec,
@@ -1195,11 +1509,36 @@ static int cortex_m_soft_reset_halt(struct target *target)
 	return ERROR_OK;
 }
 
+static int cortex_m_add_breakpoints(struct target *target,
+		struct breakpoint **breakpoint_list, unsigned int num_breakpoints);
+
 void cortex_m_enable_breakpoints(struct target *target)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint;
+	unsigned int num_soft = 0;
+
+	/* set the pending software breakpoints with a batch, when queued... */
+	if (is_cortex_m_with_dap_access(target_to_cm(target))) {
+		for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next)
+			if (!breakpoint->is_set && breakpoint->type == BKPT_SOFT)
+				num_soft++;
+	}
+
+	if (num_soft > 1) {
+		struct breakpoint **list = malloc(num_soft * sizeof(*list));
+		if (list) {
+			unsigned int n = 0;
+			for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next)
+				if (!breakpoint->is_set && breakpoint->type == BKPT_SOFT)
+					list[n++] = breakpoint;
+			if (cortex_m_add_breakpoints(target, list, n) != ERROR_OK)
+				LOG_TARGET_DEBUG(target, "batched breakpoints failed, setting them one by one");
+			free(list);
+		}
+	}
 
-	/* set any pending breakpoints */
+	/* ... and any other pending breakpoints */
+	breakpoint = target->breakpoints;
 	while (breakpoint) {
 		if (!breakpoint->is_set)
 			cortex_m_set_breakpoint(target, breakpoint);
@@ -1587,6 +1926,8 @@ static int cortex_m_assert_reset(struct target *target)
 		target_state_name(target),
 		target_was_examined(target) ? "" : " not");
 
+	cortex_m->dhcsr_prefetch_valid = false;
+
 	enum reset_types jtag_reset_config = jtag_get_reset_config();
 
 	if (target_has_event_action(target, TARGET_EVENT_RESET_ASSERT)) {
@@ -1755,6 +2096,8 @@ static int cortex_m_deassert_reset(struct target *target)
 		target_state_name(target),
 		target_was_examined(target) ? "" : " not");
 
+	target_to_cm(target)->dhcsr_prefetch_valid = false;
+
 	/* deassert reset lines */
 	adapter_deassert_reset();
 
@@ -2148,16 +2491,23 @@ void cortex_m_enable_watchpoints(struct target *target)
 	}
 }
 
+static bool cortex_m_access_aligned(struct armv7m_common *armv7m,
+	target_addr_t address, uint32_t size)
+{
+	/* armv6m does not handle unaligned memory access */
+	if (armv7m->arm.arch == ARM_ARCH_V6M)
+		return address % size == 0;
+
+	return true;
+}
+
 static int cortex_m_read_memory(struct target *target, target_addr_t address,
 	uint32_t size, uint32_t count, uint8_t *buffer)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
 
-	if (armv7m->arm.arch == ARM_ARCH_V6M) {
-		/* armv6m does not handle unaligned memory access */
-		if (((size == 4) && (address & 0x3u)) || ((size == 2) && (address & 0x1u)))
-			return ERROR_TARGET_UNALIGNED_ACCESS;
-	}
+	if (!cortex_m_access_aligned(armv7m, address, size))
+		return ERROR_TARGET_UNALIGNED_ACCESS;
 
 	return mem_ap_read_buf(armv7m->debug_ap, buffer, size, count, address);
 }
@@ -2166,16 +2516,140 @@ static int cortex_m_write_memory(struct target *target, target_addr_t address,
 	uint32_t size, uint32_t count, const uint8_t *buffer)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+
+	if (!cortex_m_access_aligned(armv7m, address, size))
+		return ERROR_TARGET_UNALIGNED_ACCESS;
 
-	if (armv7m->arm.arch == ARM_ARCH_V6M) {
-		/* armv6m does not handle unaligned memory access */
-		if (((size == 4) && (address & 0x3u)) || ((size == 2) && (address & 0x1u)))
-			return ERROR_TARGET_UNALIGNED_ACCESS;
+	if (cortex_m->compressed_write && !cortex_m->compressed_write_busy
+			&& target->state == TARGET_HALTED
+			&& size * count >= CORTEX_M_COMPRESSED_WRITE_MIN) {
+		cortex_m->compressed_write_busy = true;
+		int retval = armv7m_write_compressed_memory(target, address, size * count, buffer);
+		cortex_m->compressed_write_busy = false;
+
+		/* without working area, write it as it is */
+		if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			return retval;
 	}
 
 	return mem_ap_write_buf(armv7m->debug_ap, buffer, size, count, address);
 }
 
+static int cortex_m_queue_read_memory(struct target *target, target_addr_t address,
+	uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	if (!cortex_m_access_aligned(armv7m, address, size))
+		return ERROR_TARGET_UNALIGNED_ACCESS;
+
+	return mem_ap_read_buf_queued(armv7m->debug_ap, buffer, size, count, address);
+}
+
+static int cortex_m_queue_write_memory(struct target *target, target_addr_t address,
+	uint32_t size, uint32_t count, const uint8_t *buffer)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	if (!cortex_m_access_aligned(armv7m, address, size))
+		return ERROR_TARGET_UNALIGNED_ACCESS;
+
+	return mem_ap_write_buf_queued(armv7m->debug_ap, buffer, size, count, address);
+}
+
+static int cortex_m_run_queued_memory(struct target *target)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	return mem_ap_run_queued(armv7m->debug_ap->dap);
+}
+
+static int cortex_m_add_breakpoints(struct target *target,
+		struct breakpoint **breakpoint_list, unsigned int num_breakpoints)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < num_breakpoints; i++) {
+		struct breakpoint *breakpoint = breakpoint_list[i];
+		if (breakpoint->length == 3)
+			breakpoint->length = 2;
+		if (breakpoint->type != BKPT_SOFT || breakpoint->length != 2) {
+			LOG_TARGET_INFO(target, "only software breakpoints of two bytes length can be batched");
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+	}
+
+	/* save all original instructions with a single queue run ... */
+	for (unsigned int i = 0; i < num_breakpoints && retval == ERROR_OK; i++)
+		retval = cortex_m_queue_read_memory(target, breakpoint_list[i]->address & 0xFFFFFFFE,
+				2, 1, breakpoint_list[i]->orig_instr);
+	int run_retval = cortex_m_run_queued_memory(target);
+	if (retval == ERROR_OK)
+		retval = run_retval;
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* ... and set all BKPT instructions with another one, see
+	 * cortex_m_set_breakpoint() */
+	uint8_t code[4];
+	buf_set_u32(code, 0, 32, ARMV5_T_BKPT(0x11));
+	for (unsigned int i = 0; i < num_breakpoints && retval == ERROR_OK; i++)
+		retval = cortex_m_queue_write_memory(target, breakpoint_list[i]->address & 0xFFFFFFFE,
+				2, 1, code);
+	run_retval = cortex_m_run_queued_memory(target);
+	if (retval == ERROR_OK)
+		retval = run_retval;
+	if (retval != ERROR_OK) {
+		/* any of them may have been written, restore them all */
+		for (unsigned int i = 0; i < num_breakpoints; i++)
+			target_write_memory(target, breakpoint_list[i]->address & 0xFFFFFFFE,
+					2, 1, breakpoint_list[i]->orig_instr);
+		return retval;
+	}
+
+	for (unsigned int i = 0; i < num_breakpoints; i++)
+		breakpoint_list[i]->is_set = true;
+
+	LOG_TARGET_DEBUG(target, "set %u software breakpoints", num_breakpoints);
+
+	return ERROR_OK;
+}
+
+static int cortex_m_remove_breakpoints(struct target *target,
+		struct breakpoint **breakpoint_list, unsigned int num_breakpoints)
+{
+	int retval = ERROR_OK;
+
+	/* restore the original instructions with a single queue run */
+	for (unsigned int i = 0; i < num_breakpoints && retval == ERROR_OK; i++) {
+		struct breakpoint *breakpoint = breakpoint_list[i];
+		if (breakpoint->is_set && breakpoint->type == BKPT_SOFT)
+			retval = cortex_m_queue_write_memory(target, breakpoint->address & 0xFFFFFFFE,
+					breakpoint->length, 1, breakpoint->orig_instr);
+	}
+	int run_retval = cortex_m_run_queued_memory(target);
+	if (retval == ERROR_OK)
+		retval = run_retval;
+
+	/* hardware breakpoints and, on a failure, the software ones one by one */
+	int unset_retval = ERROR_OK;
+	for (unsigned int i = 0; i < num_breakpoints; i++) {
+		struct breakpoint *breakpoint = breakpoint_list[i];
+		if (!breakpoint->is_set)
+			continue;
+		if (breakpoint->type == BKPT_SOFT && retval == ERROR_OK) {
+			breakpoint->is_set = false;
+			continue;
+		}
+		int ret = cortex_m_unset_breakpoint(target, breakpoint);
+		if (unset_retval == ERROR_OK)
+			unset_retval = ret;
+	}
+
+	return unset_retval;
+}
+
 static int cortex_m_init_target(struct command_context *cmd_ctx,
 	struct target *target)
 {
@@ -2192,6 +2666,7 @@ void cortex_m_deinit_target(struct target *target)
 	if (!armv7m->is_hla_target && armv7m->debug_ap)
 		dap_put_ap(armv7m->debug_ap);
 
+	cortex_m_profiler_free(target);
 	free(cortex_m->fp_comparator_list);
 
 	cortex_m_dwt_free(target);
@@ -2499,6 +2974,8 @@ int cortex_m_examine(struct target *target)
 	struct adiv5_dap *swjdp = cortex_m->armv7m.arm.dap;
 	struct armv7m_common *armv7m = target_to_armv7m(target);
 
+	cortex_m->dhcsr_prefetch_valid = false;
+
 	/* hla_target shares the examine handler but does not support
 	 * all its calls */
 	if (!armv7m->is_hla_target) {
@@ -3013,6 +3490,27 @@ COMMAND_HANDLER(handle_cortex_m_reset_config_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_cortex_m_compressed_write_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+
+	int retval = cortex_m_verify_pointer(CMD, cortex_m);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], cortex_m->compressed_write);
+
+	command_print(CMD, "cortex_m compressed_write %s",
+		cortex_m->compressed_write ? "on" : "off");
+
+	return ERROR_OK;
+}
+
 static const struct command_registration cortex_m_exec_command_handlers[] = {
 	{
 		.name = "maskisr",
@@ -3035,6 +3533,21 @@ static const struct command_registration cortex_m_exec_command_handlers[] = {
 		.help = "configure software reset handling",
 		.usage = "['sysresetreq'|'vectreset']",
 	},
+	{
+		.name = "compressed_write",
+		.handler = handle_cortex_m_compressed_write_command,
+		.mode = COMMAND_ANY,
+		.help = "write large memory regions through a decompressor "
+			"running on the target",
+		.usage = "['on'|'off']",
+	},
+	{
+		.name = "profiler",
+		.mode = COMMAND_EXEC,
+		.help = "sample the PC of the running core",
+		.usage = "",
+		.chain = cortex_m_profiler_command_handlers,
+	},
 	{
 		.chain = smp_command_handlers,
 	},
@@ -3083,9 +3596,14 @@ struct target_type cortexm_target = {
 
 	.get_gdb_arch = arm_get_gdb_arch,
 	.get_gdb_reg_list = armv7m_get_gdb_reg_list,
+	.read_registers = cortex_m_read_registers,
+	.write_registers = cortex_m_write_registers,
 
 	.read_memory = cortex_m_read_memory,
 	.write_memory = cortex_m_write_memory,
+	.queue_read_memory = cortex_m_queue_read_memory,
+	.queue_write_memory = cortex_m_queue_write_memory,
+	.run_queued_memory = cortex_m_run_queued_memory,
 	.checksum_memory = armv7m_checksum_memory,
 	.blank_check_memory = armv7m_blank_check_memory,
 
@@ -3095,6 +3613,8 @@ struct target_type cortexm_target = {
 
 	.add_breakpoint = cortex_m_add_breakpoint,
 	.remove_breakpoint = cortex_m_remove_breakpoint,
+	.add_breakpoints = cortex_m_add_breakpoints,
+	.remove_breakpoints = cortex_m_remove_breakpoints,
 	.add_watchpoint = cortex_m_add_watchpoint,
 	.remove_watchpoint = cortex_m_remove_watchpoint,
 	.hit_watchpoint = cortex_m_hit_watchpoint,
@@ -242,6 +242,21 @@ struct cortex_m_common {
 	/* Whether this target has the erratum that makes C_MASKINTS not apply to
 	 * already pending interrupts */
 	bool maskints_erratum;
+
+	/* Large memory writes go through a decompressor on the target */
+	bool compressed_write;
+	/* Memory writes of the compressed write itself are written as they are */
+	bool compressed_write_busy;
+
+	/* DHCSR read along with those of the other cores on the same DAP, for
+	 * the next poll of this core */
+	uint32_t dhcsr_prefetched;
+	int64_t dhcsr_prefetch_ms;
+	bool dhcsr_prefetch_valid;
+	bool dhcsr_prefetch_queued;
+
+	/* PC sampling while the core runs, allocated by its first command */
+	struct cortex_m_profiler *profiler;
 };
 
 static inline bool is_cortex_m_or_hla(const struct cortex_m_common *cortex_m)
@@ -321,4 +336,8 @@ void cortex_m_deinit_target(struct target *target);
 int cortex_m_profiling(struct target *target, uint32_t *samples,
 	uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
 
+extern const struct command_registration cortex_m_profiler_command_handlers[];
+void cortex_m_profiler_free(struct target *target);
+void cortex_m_profiler_trace_sample(struct target *target, uint32_t pc, bool sleeping);
+
 #endif /* OPENOCD_TARGET_CORTEX_M_H */
@@ -0,0 +1,1050 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Continuous PC sampling of a running Cortex-M through DWT_PCSR.
+ *
+ * A timer callback reads a batch of PCSR samples per period, while the
+ * other commands keep working, and adds them to a histogram of the PCs for
+ * as long as the profiler runs. The histogram is written on demand as a
+ * gmon.out, or binned with the function symbols of an ELF file as a report
+ * or as collapsed stacks, the input of the flame graph tools.
+ * The DWT PC samples decoded from the SWO trace go to the same histogram.
+ * Optionally each sample is queued with a read of the current thread
+ * pointer of the RTOS, to bin the samples per thread as well.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/command.h>
+#include <helper/fileio.h>
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include "arm_adi_v5.h"
+#include "cortex_m.h"
+#include "image.h"
+#include "target.h"
+#include "rtos/rtos.h"
+
+#ifndef SHT_SYMTAB
+#define SHT_SYMTAB		2
+#endif
+#ifndef STT_FUNC
+#define STT_FUNC		2
+#endif
+
+#define PROFILER_DEFAULT_PERIOD_MS	10
+#define PROFILER_DEFAULT_BATCH		256
+#define PROFILER_MAX_BATCH		4096
+#define PROFILER_MIN_BINS		1024
+#define PROFILER_MAX_THREADS		256
+
+/* PCSR reads all ones when the core is halted or can't be sampled */
+#define PCSR_NO_SAMPLE			0xffffffff
+
+struct profiler_bin {
+	uint32_t pc;
+	/* 0 for a free bin */
+	uint64_t count;
+};
+
+struct profiler_symbol {
+	uint32_t address;
+	uint32_t size;
+	const char *name;
+};
+
+/* open addressing hash table of the PCs, bins_size a power of 2 */
+struct profiler_histogram {
+	struct profiler_bin *bins;
+	unsigned int bins_size;
+	unsigned int num_bins;
+	uint64_t samples;
+};
+
+/* the samples taken while the current thread pointer held id */
+struct profiler_thread {
+	uint32_t id;
+	struct profiler_histogram hist;
+};
+
+/* the samples of a function, or of a PC out of the functions */
+struct profiler_entry {
+	const struct profiler_symbol *symbol;
+	uint32_t pc;
+	uint64_t count;
+};
+
+struct cortex_m_profiler {
+	struct target *target;
+	bool running;
+	unsigned int period_ms;
+	unsigned int batch;
+	uint8_t *buffer;
+	struct profiler_histogram hist;
+	uint64_t no_samples;
+	uint64_t errors;
+	/* sampling time of the earlier runs, start of the current one */
+	int64_t elapsed_ms;
+	int64_t start_ms;
+	/* with thread_pointer, or the address from the RTOS if 0, read
+	 * with each PC sample to bin the samples per thread */
+	bool track_threads;
+	target_addr_t thread_pointer;
+	target_addr_t sampled_pointer;
+	struct profiler_thread *threads;
+	unsigned int num_threads;
+	/* function symbols sorted by address, their names in strtab */
+	struct profiler_symbol *symbols;
+	unsigned int num_symbols;
+	char *strtab;
+};
+
+static unsigned int profiler_hash(uint32_t pc, unsigned int size)
+{
+	return ((pc >> 1) * 2654435761u) & (size - 1);
+}
+
+static struct profiler_bin *profiler_find(struct profiler_bin *bins, unsigned int size,
+		uint32_t pc)
+{
+	unsigned int i = profiler_hash(pc, size);
+
+	while (bins[i].count && bins[i].pc != pc)
+		i = (i + 1) & (size - 1);
+
+	return &bins[i];
+}
+
+static int profiler_grow(struct profiler_histogram *h)
+{
+	unsigned int size = h->bins_size ? 2 * h->bins_size : PROFILER_MIN_BINS;
+	struct profiler_bin *bins = calloc(size, sizeof(*bins));
+	if (!bins)
+		return ERROR_FAIL;
+
+	for (unsigned int i = 0; i < h->bins_size; i++)
+		if (h->bins[i].count)
+			*profiler_find(bins, size, h->bins[i].pc) = h->bins[i];
+
+	free(h->bins);
+	h->bins = bins;
+	h->bins_size = size;
+
+	return ERROR_OK;
+}
+
+static int profiler_add(struct profiler_histogram *h, uint32_t pc)
+{
+	/* at most 3/4 full */
+	if (4 * (h->num_bins + 1) > 3 * h->bins_size && profiler_grow(h) != ERROR_OK)
+		return ERROR_FAIL;
+
+	struct profiler_bin *bin = profiler_find(h->bins, h->bins_size, pc);
+	if (!bin->count) {
+		bin->pc = pc;
+		h->num_bins++;
+	}
+	bin->count++;
+	h->samples++;
+
+	return ERROR_OK;
+}
+
+static int profiler_add_thread(struct cortex_m_profiler *p, uint32_t id, uint32_t pc)
+{
+	unsigned int i = 0;
+
+	while (i < p->num_threads && p->threads[i].id != id)
+		i++;
+
+	if (i == p->num_threads) {
+		if (p->num_threads == PROFILER_MAX_THREADS)
+			return ERROR_FAIL;
+		struct profiler_thread *threads = realloc(p->threads,
+				(p->num_threads + 1) * sizeof(*threads));
+		if (!threads)
+			return ERROR_FAIL;
+		threads[i] = (struct profiler_thread) { .id = id };
+		p->threads = threads;
+		p->num_threads++;
+	}
+
+	return profiler_add(&p->threads[i].hist, pc);
+}
+
+static void profiler_free_threads(struct cortex_m_profiler *p)
+{
+	for (unsigned int i = 0; i < p->num_threads; i++)
+		free(p->threads[i].hist.bins);
+	free(p->threads);
+	p->threads = NULL;
+	p->num_threads = 0;
+}
+
+static void profiler_clear(struct cortex_m_profiler *p)
+{
+	free(p->hist.bins);
+	p->hist.bins = NULL;
+	p->hist.bins_size = 0;
+	p->hist.num_bins = 0;
+	p->hist.samples = 0;
+	profiler_free_threads(p);
+	p->no_samples = 0;
+	p->errors = 0;
+	p->elapsed_ms = 0;
+	p->start_ms = timeval_ms();
+}
+
+static int64_t profiler_duration_ms(const struct cortex_m_profiler *p)
+{
+	return p->elapsed_ms + (p->running ? timeval_ms() - p->start_ms : 0);
+}
+
+/* each PC sample queued with a read of the current thread pointer */
+static int cortex_m_profiler_tick_threads(struct cortex_m_profiler *p)
+{
+	struct target *target = p->target;
+	struct adiv5_ap *ap = target_to_armv7m(target)->debug_ap;
+	uint32_t *values = (uint32_t *)p->buffer;
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < p->batch && retval == ERROR_OK; i++) {
+		retval = mem_ap_read_u32(ap, DWT_PCSR, &values[2 * i]);
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(ap, p->sampled_pointer, &values[2 * i + 1]);
+	}
+	if (retval == ERROR_OK)
+		retval = dap_run(ap->dap);
+	if (retval != ERROR_OK) {
+		p->errors++;
+		LOG_TARGET_DEBUG(target, "PCSR and thread read failed: %d", retval);
+		return ERROR_OK;
+	}
+
+	for (unsigned int i = 0; i < p->batch; i++) {
+		uint32_t pc = values[2 * i];
+
+		if (pc == PCSR_NO_SAMPLE)
+			p->no_samples++;
+		else if (profiler_add(&p->hist, pc) != ERROR_OK ||
+				profiler_add_thread(p, values[2 * i + 1], pc) != ERROR_OK)
+			p->errors++;
+	}
+
+	return ERROR_OK;
+}
+
+static int cortex_m_profiler_tick(void *priv)
+{
+	struct cortex_m_profiler *p = priv;
+	struct target *target = p->target;
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	/* the samples of a halted core are all ones, don't read them */
+	if (!target_was_examined(target) || target->state != TARGET_RUNNING)
+		return ERROR_OK;
+
+	if (p->sampled_pointer)
+		return cortex_m_profiler_tick_threads(p);
+
+	int retval = mem_ap_read_buf_noincr(armv7m->debug_ap, p->buffer, 4,
+			p->batch, DWT_PCSR);
+	if (retval != ERROR_OK) {
+		p->errors++;
+		LOG_TARGET_DEBUG(target, "PCSR read failed: %d", retval);
+		return ERROR_OK;
+	}
+
+	for (unsigned int i = 0; i < p->batch; i++) {
+		uint32_t pc = target_buffer_get_u32(target, p->buffer + 4 * i);
+
+		if (pc == PCSR_NO_SAMPLE)
+			p->no_samples++;
+		else if (profiler_add(&p->hist, pc) != ERROR_OK)
+			p->errors++;
+	}
+
+	return ERROR_OK;
+}
+
+static void profiler_stop(struct cortex_m_profiler *p)
+{
+	if (!p->running)
+		return;
+
+	target_unregister_timer_callback(cortex_m_profiler_tick, p);
+	p->elapsed_ms += timeval_ms() - p->start_ms;
+	p->running = false;
+	p->sampled_pointer = 0;
+	free(p->buffer);
+	p->buffer = NULL;
+}
+
+static void profiler_free_symbols(struct cortex_m_profiler *p)
+{
+	free(p->symbols);
+	p->symbols = NULL;
+	p->num_symbols = 0;
+	free(p->strtab);
+	p->strtab = NULL;
+}
+
+void cortex_m_profiler_free(struct target *target)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct cortex_m_profiler *p = cortex_m->profiler;
+
+	if (!p)
+		return;
+
+	profiler_stop(p);
+	free(p->hist.bins);
+	profiler_free_threads(p);
+	profiler_free_symbols(p);
+	free(p);
+	cortex_m->profiler = NULL;
+}
+
+static int profiler_symbol_compare(const void *a, const void *b)
+{
+	const struct profiler_symbol *sa = a;
+	const struct profiler_symbol *sb = b;
+
+	if (sa->address != sb->address)
+		return sa->address < sb->address ? -1 : 1;
+	/* of the aliases, the one with a size first */
+	if (!sa->size != !sb->size)
+		return sa->size ? -1 : 1;
+	return 0;
+}
+
+/* the function of the PC, up to the next one if its size is unknown */
+static const struct profiler_symbol *profiler_lookup(const struct cortex_m_profiler *p,
+		uint32_t pc)
+{
+	unsigned int low = 0;
+	unsigned int high = p->num_symbols;
+
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+		if (p->symbols[mid].address <= pc)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (!low)
+		return NULL;
+
+	const struct profiler_symbol *s = &p->symbols[low - 1];
+	if (s->size && pc - s->address >= s->size)
+		return NULL;
+
+	return s;
+}
+
+static int profiler_parse_symbols(struct cortex_m_profiler *p, const uint8_t *data,
+		size_t size)
+{
+	if (size < sizeof(Elf32_Ehdr) || memcmp(data, ELFMAG, SELFMAG)) {
+		LOG_ERROR("not an ELF file");
+		return ERROR_FAIL;
+	}
+	if (data[EI_CLASS] != ELFCLASS32 || data[EI_DATA] != ELFDATA2LSB) {
+		LOG_ERROR("only the 32 bit little endian ELF files are supported");
+		return ERROR_FAIL;
+	}
+
+	uint32_t shoff = le_to_h_u32(data + 0x20);
+	uint32_t shentsize = le_to_h_u16(data + 0x2e);
+	uint32_t shnum = le_to_h_u16(data + 0x30);
+	if (shentsize < 40 || shoff > size || (uint64_t)shnum * shentsize > size - shoff) {
+		LOG_ERROR("invalid ELF section headers");
+		return ERROR_FAIL;
+	}
+
+	for (uint32_t i = 0; i < shnum; i++) {
+		const uint8_t *sh = data + shoff + i * shentsize;
+		if (le_to_h_u32(sh + 4) != SHT_SYMTAB)
+			continue;
+
+		uint32_t offset = le_to_h_u32(sh + 16);
+		uint32_t symtab_size = le_to_h_u32(sh + 20);
+		uint32_t link = le_to_h_u32(sh + 24);
+		uint32_t entsize = le_to_h_u32(sh + 36);
+		if (entsize < 16 || link >= shnum || offset > size || symtab_size > size - offset) {
+			LOG_ERROR("invalid ELF symbol table");
+			return ERROR_FAIL;
+		}
+
+		const uint8_t *strsh = data + shoff + link * shentsize;
+		uint32_t stroff = le_to_h_u32(strsh + 16);
+		uint32_t strsize = le_to_h_u32(strsh + 20);
+		if (stroff > size || strsize > size - stroff) {
+			LOG_ERROR("invalid ELF string table");
+			return ERROR_FAIL;
+		}
+
+		unsigned int count = symtab_size / entsize;
+		p->symbols = malloc(count * sizeof(*p->symbols));
+		p->strtab = malloc(strsize + 1);
+		if (!p->symbols || !p->strtab) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		memcpy(p->strtab, data + stroff, strsize);
+		p->strtab[strsize] = '\0';
+
+		for (unsigned int j = 0; j < count; j++) {
+			const uint8_t *sym = data + offset + j * entsize;
+			uint32_t name = le_to_h_u32(sym);
+			uint32_t value = le_to_h_u32(sym + 4);
+
+			/* the defined functions, without the Thumb bit */
+			if ((sym[12] & 0xf) != STT_FUNC || !le_to_h_u16(sym + 14) ||
+					name >= strsize)
+				continue;
+
+			p->symbols[p->num_symbols++] = (struct profiler_symbol) {
+				.address = value & ~1u,
+				.size = le_to_h_u32(sym + 8),
+				.name = p->strtab + name,
+			};
+		}
+
+		qsort(p->symbols, p->num_symbols, sizeof(*p->symbols), profiler_symbol_compare);
+
+		/* one symbol per address */
+		unsigned int n = 0;
+		for (unsigned int j = 0; j < p->num_symbols; j++)
+			if (!n || p->symbols[n - 1].address != p->symbols[j].address)
+				p->symbols[n++] = p->symbols[j];
+		p->num_symbols = n;
+
+		return ERROR_OK;
+	}
+
+	LOG_ERROR("no symbol table in the ELF file");
+	return ERROR_FAIL;
+}
+
+static int profiler_load_symbols(struct cortex_m_profiler *p, const char *filename)
+{
+	struct fileio *fileio;
+	size_t size, size_read;
+
+	profiler_free_symbols(p);
+
+	int retval = fileio_open(&fileio, filename, FILEIO_READ, FILEIO_BINARY);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = fileio_size(fileio, &size);
+	if (retval != ERROR_OK) {
+		fileio_close(fileio);
+		return retval;
+	}
+
+	uint8_t *data = malloc(size);
+	if (!data) {
+		LOG_ERROR("Out of memory");
+		fileio_close(fileio);
+		return ERROR_FAIL;
+	}
+
+	retval = fileio_read(fileio, size, data, &size_read);
+	fileio_close(fileio);
+	if (retval == ERROR_OK && size_read != size)
+		retval = ERROR_FAIL;
+	if (retval == ERROR_OK)
+		retval = profiler_parse_symbols(p, data, size);
+	free(data);
+
+	if (retval != ERROR_OK)
+		profiler_free_symbols(p);
+
+	return retval;
+}
+
+static int profiler_entry_compare_pc(const void *a, const void *b)
+{
+	const struct profiler_entry *ea = a;
+	const struct profiler_entry *eb = b;
+
+	if (ea->pc != eb->pc)
+		return ea->pc < eb->pc ? -1 : 1;
+	return 0;
+}
+
+static int profiler_entry_compare_count(const void *a, const void *b)
+{
+	const struct profiler_entry *ea = a;
+	const struct profiler_entry *eb = b;
+
+	if (ea->count != eb->count)
+		return ea->count > eb->count ? -1 : 1;
+	return profiler_entry_compare_pc(a, b);
+}
+
+/*
+ * The samples per function, and per PC out of the functions, the most
+ * sampled first. free() *entries.
+ */
+static int profiler_entries(const struct cortex_m_profiler *p,
+		const struct profiler_histogram *h,
+		struct profiler_entry **entries, unsigned int *num_entries)
+{
+	struct profiler_entry *e = malloc(MAX(h->num_bins, 1) * sizeof(*e));
+	if (!e) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < h->bins_size; i++) {
+		if (!h->bins[i].count)
+			continue;
+		const struct profiler_symbol *s = profiler_lookup(p, h->bins[i].pc);
+		e[n++] = (struct profiler_entry) {
+			.symbol = s,
+			.pc = s ? s->address : h->bins[i].pc,
+			.count = h->bins[i].count,
+		};
+	}
+
+	/* a PC at the address of a function is in the function */
+	qsort(e, n, sizeof(*e), profiler_entry_compare_pc);
+	unsigned int merged = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		if (merged && e[merged - 1].pc == e[i].pc)
+			e[merged - 1].count += e[i].count;
+		else
+			e[merged++] = e[i];
+	}
+	qsort(e, merged, sizeof(*e), profiler_entry_compare_count);
+
+	*entries = e;
+	*num_entries = merged;
+
+	return ERROR_OK;
+}
+
+static struct cortex_m_profiler *profiler_alloc(struct target *target)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+
+	if (!cortex_m->profiler) {
+		cortex_m->profiler = calloc(1, sizeof(*cortex_m->profiler));
+		if (!cortex_m->profiler) {
+			LOG_ERROR("Out of memory");
+			return NULL;
+		}
+		cortex_m->profiler->target = target;
+		cortex_m->profiler->period_ms = PROFILER_DEFAULT_PERIOD_MS;
+		cortex_m->profiler->batch = PROFILER_DEFAULT_BATCH;
+	}
+
+	return cortex_m->profiler;
+}
+
+void cortex_m_profiler_trace_sample(struct target *target, uint32_t pc, bool sleeping)
+{
+	struct cortex_m_profiler *p = profiler_alloc(target);
+
+	if (!p)
+		return;
+
+	if (sleeping)
+		p->no_samples++;
+	else if (profiler_add(&p->hist, pc) != ERROR_OK)
+		p->errors++;
+}
+
+static int cortex_m_profiler_get(struct command_invocation *cmd,
+		struct cortex_m_profiler **profiler)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+
+	if (!is_cortex_m_or_hla(cortex_m)) {
+		command_print(cmd, "target is not a Cortex-M");
+		return ERROR_TARGET_INVALID;
+	}
+
+	*profiler = profiler_alloc(target);
+	if (!*profiler)
+		return ERROR_FAIL;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_cortex_m_profiler_start_command)
+{
+	struct cortex_m_profiler *p;
+	int retval = cortex_m_profiler_get(CMD, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int period_ms = p->period_ms;
+	unsigned int batch = p->batch;
+	if (CMD_ARGC > 0)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], period_ms);
+	if (CMD_ARGC > 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], batch);
+	if (!period_ms || !batch || batch > PROFILER_MAX_BATCH) {
+		command_print(CMD, "period must be at least 1 ms, samples from 1 to %d",
+				PROFILER_MAX_BATCH);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (p->running) {
+		command_print(CMD, "profiler already running");
+		return ERROR_FAIL;
+	}
+
+	struct target *target = p->target;
+	if (!is_cortex_m_with_dap_access(target_to_cm(target))) {
+		command_print(CMD, "PCSR sampling needs the DAP of the target");
+		return ERROR_TARGET_INVALID;
+	}
+	if (!target_was_examined(target)) {
+		command_print(CMD, "target not examined yet");
+		return ERROR_TARGET_NOT_EXAMINED;
+	}
+
+	uint32_t pcsr;
+	retval = target_read_u32(target, DWT_PCSR, &pcsr);
+	if (retval != ERROR_OK) {
+		command_print(CMD, "error while reading PCSR");
+		return retval;
+	}
+	if (pcsr == 0) {
+		command_print(CMD, "PCSR sampling not supported on this processor");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	target_addr_t pointer = 0;
+	if (p->track_threads) {
+		pointer = p->thread_pointer;
+		if (!pointer && rtos_get_current_thread_address(target, &pointer) != ERROR_OK) {
+			command_print(CMD, "no RTOS current thread pointer known, give its address");
+			return ERROR_FAIL;
+		}
+	}
+
+	/* the thread pointer read after each PC */
+	p->buffer = malloc((pointer ? 8 : 4) * batch);
+	if (!p->buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	p->period_ms = period_ms;
+	p->batch = batch;
+	p->sampled_pointer = pointer;
+
+	retval = target_register_timer_callback(cortex_m_profiler_tick, period_ms,
+			TARGET_TIMER_TYPE_PERIODIC, p);
+	if (retval != ERROR_OK) {
+		free(p->buffer);
+		p->buffer = NULL;
+		p->sampled_pointer = 0;
+		return retval;
+	}
+
+	p->running = true;
+	p->start_ms = timeval_ms();
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_cortex_m_profiler_stop_command)
+{
+	struct cortex_m_profiler *p;
+	int retval = cortex_m_profiler_get(CMD, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	profiler_stop(p);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_cortex_m_profiler_clear_command)
+{
+	struct cortex_m_profiler *p;
+	int retval = cortex_m_profiler_get(CMD, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	profiler_clear(p);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_cortex_m_profiler_status_command)
+{
+	struct cortex_m_profiler *p;
+	int retval = cortex_m_profiler_get(CMD, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD, "profiler %s, %u samples every %u ms",
+			p->running ? "running" : "stopped", p->batch, p->period_ms);
+	command_print(CMD, "%" PRIu64 " samples of %u PCs in %" PRId64 " ms, "
+			"%" PRIu64 " without PC, %" PRIu64 " errors",
+			p->hist.samples, p->hist.num_bins, profiler_duration_ms(p),
+			p->no_samples, p->errors);
+	command_print(CMD, "%u function symbols", p->num_symbols);
+	if (p->num_threads)
+		command_print(CMD, "%u threads", p->num_threads);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_cortex_m_profiler_threads_command)
+{
+	struct cortex_m_profiler *p;
+	int retval = cortex_m_profiler_get(CMD, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (p->running) {
+			command_print(CMD, "stop the profiler first");
+			return ERROR_FAIL;
+		}
+
+		if (!strcmp(CMD_ARGV[0], "on")) {
+			p->track_threads = true;
+			p->thread_pointer = 0;
+		} else if (!strcmp(CMD_ARGV[0], "off")) {
+			p->track_threads = false;
+		} else {
+			COMMAND_PARSE_ADDRESS(CMD_ARGV[0], p->thread_pointer);
+			p->track_threads = true;
+		}
+	}
+
+	if (!p->track_threads)
+		command_print(CMD, "threads off");
+	else if (p->thread_pointer)
+		command_print(CMD, "threads from the pointer at " TARGET_ADDR_FMT, p->thread_pointer);
+	else
+		command_print(CMD, "threads from the RTOS current thread pointer");
+
+	return ERROR_OK;
+}
+
+static int profiler_thread_compare(const void *a, const void *b)
+{
+	const struct profiler_thread *ta = a;
+	const struct profiler_thread *tb = b;
+
+	if (ta->hist.samples != tb->hist.samples)
+		return ta->hist.samples > tb->hist.samples ? -1 : 1;
+	return 0;
+}
+
+static const char *profiler_thread_name(const struct cortex_m_profiler *p, uint32_t id)
+{
+	struct rtos *rtos = p->target->rtos;
+
+	if (!rtos)
+		return NULL;
+
+	for (int i = 0; i < rtos->thread_count; i++)
+		if (rtos->thread_details[i].threadid == id)
+			return rtos_get_thread_name(rtos, &rtos->thread_details[i]);
+
+	return NULL;
+}
+
+COMMAND_HANDLER(handle_cortex_m_profiler_load_command)
+{
+	struct cortex_m_profiler *p;
+	int retval = cortex_m_profiler_get(CMD, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int count = 3;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], count);
+
+	qsort(p->threads, p->num_threads, sizeof(*p->threads), profiler_thread_compare);
+
+	for (unsigned int t = 0; t < p->num_threads; t++) {
+		const struct profiler_thread *thread = &p->threads[t];
+		const char *name = profiler_thread_name(p, thread->id);
+
+		command_print(CMD, "%6.2f%% %10" PRIu64 " thread 0x%08" PRIx32 " %s",
+				100.0 * thread->hist.samples / p->hist.samples,
+				thread->hist.samples, thread->id, name ? name : "");
+
+		struct profiler_entry *entries;
+		unsigned int num_entries;
+		retval = profiler_entries(p, &thread->hist, &entries, &num_entries);
+		if (retval != ERROR_OK)
+			return retval;
+
+		for (unsigned int i = 0; i < MIN(count, num_entries); i++) {
+			double percent = 100.0 * entries[i].count / thread->hist.samples;
+			if (entries[i].symbol)
+				command_print(CMD, "        %6.2f%% %10" PRIu64 " %s", percent,
+						entries[i].count, entries[i].symbol->name);
+			else
+				command_print(CMD, "        %6.2f%% %10" PRIu64 " 0x%08" PRIx32, percent,
+						entries[i].count, entries[i].pc);
+		}
+		free(entries);
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_cortex_m_profiler_symbols_command)
+{
+	struct cortex_m_profiler *p;
+	int retval = cortex_m_profiler_get(CMD, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	retval = profiler_load_symbols(p, CMD_ARGV[0]);
+	if (retval != ERROR_OK)
+		return retval;
+
+	command_print(CMD, "%u function symbols", p->num_symbols);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_cortex_m_profiler_gmon_command)
+{
+	struct cortex_m_profiler *p;
+	int retval = cortex_m_profiler_get(CMD, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC != 1 && CMD_ARGC != 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint32_t start_address = 0;
+	uint32_t end_address = 0;
+	if (CMD_ARGC == 3) {
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], start_address);
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], end_address);
+		if (start_address > end_address || (end_address - start_address) < 2) {
+			command_print(CMD, "Error: end - start < 2");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	if (!p->hist.num_bins) {
+		command_print(CMD, "no samples");
+		return ERROR_FAIL;
+	}
+
+	uint32_t *samples = malloc(p->hist.num_bins * sizeof(*samples));
+	uint32_t *counts = malloc(p->hist.num_bins * sizeof(*counts));
+	if (!samples || !counts) {
+		LOG_ERROR("Out of memory");
+		free(samples);
+		free(counts);
+		return ERROR_FAIL;
+	}
+
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < p->hist.bins_size; i++) {
+		if (!p->hist.bins[i].count)
+			continue;
+		samples[n] = p->hist.bins[i].pc;
+		counts[n++] = MIN(p->hist.bins[i].count, UINT32_MAX);
+	}
+
+	retval = target_write_gmon(p->target, samples, counts, n, CMD_ARGV[0],
+			CMD_ARGC == 3, start_address, end_address,
+			MAX(profiler_duration_ms(p), 1));
+	if (retval == ERROR_OK)
+		command_print(CMD, "Wrote %s", CMD_ARGV[0]);
+
+	free(samples);
+	free(counts);
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_cortex_m_profiler_collapsed_command)
+{
+	struct cortex_m_profiler *p;
+	int retval = cortex_m_profiler_get(CMD, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct profiler_entry *entries;
+	unsigned int num_entries;
+	retval = profiler_entries(p, &p->hist, &entries, &num_entries);
+	if (retval != ERROR_OK)
+		return retval;
+
+	FILE *f = fopen(CMD_ARGV[0], "w");
+	if (!f) {
+		command_print(CMD, "couldn't create %s: %s", CMD_ARGV[0], strerror(errno));
+		free(entries);
+		return ERROR_FAIL;
+	}
+
+	/* a single frame per stack, the sampled PC has no caller */
+	for (unsigned int i = 0; i < num_entries; i++) {
+		if (entries[i].symbol)
+			fprintf(f, "%s %" PRIu64 "\n", entries[i].symbol->name, entries[i].count);
+		else
+			fprintf(f, "0x%08" PRIx32 " %" PRIu64 "\n", entries[i].pc, entries[i].count);
+	}
+
+	if (fclose(f) != 0) {
+		command_print(CMD, "couldn't write %s: %s", CMD_ARGV[0], strerror(errno));
+		retval = ERROR_FAIL;
+	} else {
+		command_print(CMD, "Wrote %s", CMD_ARGV[0]);
+	}
+	free(entries);
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_cortex_m_profiler_report_command)
+{
+	struct cortex_m_profiler *p;
+	int retval = cortex_m_profiler_get(CMD, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int count = 20;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], count);
+
+	struct profiler_entry *entries;
+	unsigned int num_entries;
+	retval = profiler_entries(p, &p->hist, &entries, &num_entries);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < MIN(count, num_entries); i++) {
+		double percent = 100.0 * entries[i].count / p->hist.samples;
+		if (entries[i].symbol)
+			command_print(CMD, "%6.2f%% %10" PRIu64 " %s", percent,
+					entries[i].count, entries[i].symbol->name);
+		else
+			command_print(CMD, "%6.2f%% %10" PRIu64 " 0x%08" PRIx32, percent,
+					entries[i].count, entries[i].pc);
+	}
+	free(entries);
+
+	return ERROR_OK;
+}
+
+const struct command_registration cortex_m_profiler_command_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_cortex_m_profiler_start_command,
+		.mode = COMMAND_EXEC,
+		.help = "start sampling the PC of the running core, "
+			"a batch of samples every period",
+		.usage = "[period_ms [samples]]",
+	},
+	{
+		.name = "stop",
+		.handler = handle_cortex_m_profiler_stop_command,
+		.mode = COMMAND_EXEC,
+		.help = "stop sampling, the samples are kept",
+		.usage = "",
+	},
+	{
+		.name = "clear",
+		.handler = handle_cortex_m_profiler_clear_command,
+		.mode = COMMAND_EXEC,
+		.help = "drop the samples",
+		.usage = "",
+	},
+	{
+		.name = "status",
+		.handler = handle_cortex_m_profiler_status_command,
+		.mode = COMMAND_EXEC,
+		.help = "display the state and the counters of the profiler",
+		.usage = "",
+	},
+	{
+		.name = "threads",
+		.handler = handle_cortex_m_profiler_threads_command,
+		.mode = COMMAND_EXEC,
+		.help = "read the current thread pointer of the RTOS, or at address, "
+			"with each sample",
+		.usage = "[on|off|address]",
+	},
+	{
+		.name = "load",
+		.handler = handle_cortex_m_profiler_load_command,
+		.mode = COMMAND_EXEC,
+		.help = "display the share of the samples of each thread "
+			"and its most sampled functions",
+		.usage = "[count]",
+	},
+	{
+		.name = "symbols",
+		.handler = handle_cortex_m_profiler_symbols_command,
+		.mode = COMMAND_EXEC,
+		.help = "load the function symbols of an ELF file, "
+			"to bin the samples per function",
+		.usage = "elf_file",
+	},
+	{
+		.name = "gmon",
+		.handler = handle_cortex_m_profiler_gmon_command,
+		.mode = COMMAND_EXEC,
+		.help = "write the samples as a gmon.out file",
+		.usage = "filename [start end]",
+	},
+	{
+		.name = "collapsed",
+		.handler = handle_cortex_m_profiler_collapsed_command,
+		.mode = COMMAND_EXEC,
+		.help = "write the samples per function as collapsed stacks",
+		.usage = "filename",
+	},
+	{
+		.name = "report",
+		.handler = handle_cortex_m_profiler_report_command,
+		.mode = COMMAND_EXEC,
+		.help = "display the most sampled functions",
+		.usage = "[count]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -174,7 +174,7 @@ int dsp563xx_once_read_register(struct jtag_tap *tap, int flush, struct once_reg
 	int err = ERROR_OK;
 
 	for (i = 0; i < len; i++) {
-		err = dsp563xx_once_reg_read_ex(tap, flush, regs[i].addr, regs[i].len, &regs[i].reg);
+		err = dsp563xx_once_reg_read_ex(tap, 0, regs[i].addr, regs[i].len, &regs[i].reg);
 		if (err != ERROR_OK)
 			return err;
 	}
@@ -189,7 +189,7 @@ int dsp563xx_once_reg_read_ex(struct jtag_tap *tap, int flush, uint8_t reg, uint
 {
 	int err;
 
-	err = dsp563xx_once_ir_exec(tap, 1, reg, 1, 0, 0);
+	err = dsp563xx_once_ir_exec(tap, 0, reg, 1, 0, 0);
 	if (err != ERROR_OK)
 		return err;
 	err = dsp563xx_write_dr_u32(tap, data, 0x00, len, 0);
@@ -206,7 +206,7 @@ int dsp563xx_once_reg_read(struct jtag_tap *tap, int flush, uint8_t reg, uint32_
 {
 	int err;
 
-	err = dsp563xx_once_ir_exec(tap, flush, reg, 1, 0, 0);
+	err = dsp563xx_once_ir_exec(tap, 0, reg, 1, 0, 0);
 	if (err != ERROR_OK)
 		return err;
 	err = dsp563xx_write_dr_u32(tap, data, 0x00, 24, 0);
@@ -223,7 +223,7 @@ int dsp563xx_once_reg_write(struct jtag_tap *tap, int flush, uint8_t reg, uint32
 {
 	int err;
 
-	err = dsp563xx_once_ir_exec(tap, flush, reg, 0, 0, 0);
+	err = dsp563xx_once_ir_exec(tap, 0, reg, 0, 0, 0);
 	if (err != ERROR_OK)
 		return err;
 	err = dsp563xx_write_dr_u32(tap, 0x00, data, 24, 0);
@@ -239,7 +239,7 @@ int dsp563xx_once_execute_sw_ir(struct jtag_tap *tap, int flush, uint32_t opcode
 {
 	int err;
 
-	err = dsp563xx_once_ir_exec(tap, flush, DSP563XX_ONCE_OPDBR, 0, 1, 0);
+	err = dsp563xx_once_ir_exec(tap, 0, DSP563XX_ONCE_OPDBR, 0, 1, 0);
 	if (err != ERROR_OK)
 		return err;
 	err = dsp563xx_write_dr_u32(tap, 0, opcode, 24, 0);
@@ -255,19 +255,14 @@ int dsp563xx_once_execute_dw_ir(struct jtag_tap *tap, int flush, uint32_t opcode
 {
 	int err;
 
-	err = dsp563xx_once_ir_exec(tap, flush, DSP563XX_ONCE_OPDBR, 0, 0, 0);
+	err = dsp563xx_once_ir_exec(tap, 0, DSP563XX_ONCE_OPDBR, 0, 0, 0);
 	if (err != ERROR_OK)
 		return err;
 	err = dsp563xx_write_dr_u32(tap, 0, opcode, 24, 0);
 	if (err != ERROR_OK)
 		return err;
-	if (flush) {
-		err = jtag_execute_queue();
-		if (err != ERROR_OK)
-			return err;
-	}
 
-	err = dsp563xx_once_ir_exec(tap, flush, DSP563XX_ONCE_OPDBR, 0, 1, 0);
+	err = dsp563xx_once_ir_exec(tap, 0, DSP563XX_ONCE_OPDBR, 0, 1, 0);
 	if (err != ERROR_OK)
 		return err;
 	err = dsp563xx_write_dr_u32(tap, 0, operand, 24, 0);
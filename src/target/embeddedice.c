@@ -410,6 +410,17 @@ int embeddedice_read_reg_w_check(struct reg *reg,
  * allow hundreds of instruction cycles (per word) in the target.
  */
 int embeddedice_receive(struct arm_jtag *jtag_info, uint32_t *data, uint32_t size)
+{
+	return embeddedice_receive_ctrl(jtag_info, data, size, NULL);
+}
+
+/**
+ * Receive a block of size 32-bit words from the DCC, like embeddedice_receive(),
+ * and read the DCC control register after the last word into @a ctrl in the
+ * same JTAG queue, so the W bit tells if the target has written another one.
+ */
+int embeddedice_receive_ctrl(struct arm_jtag *jtag_info, uint32_t *data, uint32_t size,
+		uint8_t *ctrl)
 {
 	struct scan_field fields[3];
 	uint8_t field1_out[1];
@@ -454,6 +465,12 @@ int embeddedice_receive(struct arm_jtag *jtag_info, uint32_t *data, uint32_t siz
 		size--;
 	}
 
+	/* the address is the DCC control reg after the last item */
+	if (ctrl) {
+		fields[0].in_value = ctrl;
+		jtag_add_dr_scan(jtag_info->tap, 3, fields, TAP_IDLE);
+	}
+
 	return jtag_execute_queue();
 }
 
@@ -634,6 +651,9 @@ int embeddedice_handshake(struct arm_jtag *jtag_info, int hsbit, uint32_t timeou
 	return ERROR_TARGET_TIMEOUT;
 }
 
+/* words written to the DCC before the queue is posted to the adapter */
+#define EICE_DCC_POST_WORDS 1024
+
 /**
  * This is an inner loop of the open loop DCC write of data to target
  */
@@ -646,5 +666,9 @@ void embeddedice_write_dcc(struct jtag_tap *tap,
 		embeddedice_write_reg_inner(tap, reg_addr,
 				fast_target_buffer_get_u32(buffer, little));
 		buffer += 4;
+
+		/* nothing is read back, let the adapter start on this chunk */
+		if ((i + 1) % EICE_DCC_POST_WORDS == 0)
+			jtag_execute_queue_posted();
 	}
 }
@@ -91,6 +91,8 @@ void embeddedice_store_reg(struct reg *reg);
 void embeddedice_set_reg(struct reg *reg, uint32_t value);
 
 int embeddedice_receive(struct arm_jtag *jtag_info, uint32_t *data, uint32_t size);
+int embeddedice_receive_ctrl(struct arm_jtag *jtag_info, uint32_t *data, uint32_t size,
+		uint8_t *ctrl);
 int embeddedice_send(struct arm_jtag *jtag_info, uint32_t *data, uint32_t size);
 
 int embeddedice_handshake(struct arm_jtag *jtag_info, int hsbit, uint32_t timeout);
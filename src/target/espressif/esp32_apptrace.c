@@ -347,9 +347,11 @@ struct esp32_apptrace_block *esp32_apptrace_free_block_get(struct esp32_apptrace
 static int esp32_apptrace_ready_block_put(struct esp32_apptrace_cmd_ctx *ctx, struct esp32_apptrace_block *block)
 {
 	LOG_DEBUG("esp32_apptrace_ready_block_put");
-	/* add to ready blocks list */
+	/* add to the tail of ready blocks list, they are processed in order */
 	INIT_LIST_HEAD(&block->node);
-	list_add(&block->node, &ctx->ready_trace_blocks);
+	list_add_tail(&block->node, &ctx->ready_trace_blocks);
+	if (++ctx->ready_blocks_num > ctx->stats.max_ready_blocks)
+		ctx->stats.max_ready_blocks = ctx->ready_blocks_num;
 
 	return ERROR_OK;
 }
@@ -359,14 +361,10 @@ static struct esp32_apptrace_block *esp32_apptrace_ready_block_get(struct esp32_
 	struct esp32_apptrace_block *block = NULL;
 
 	if (!list_empty(&ctx->ready_trace_blocks)) {
-		struct list_head *head = &ctx->ready_trace_blocks;
-		struct list_head *tmp, *pos;
-
-		list_for_each_safe(pos, tmp, head) {
-			block = list_entry(pos, struct esp32_apptrace_block, node);
-		}
-		/* remove it from ready list */
+		/* get the oldest one */
+		block = list_first_entry(&ctx->ready_trace_blocks, struct esp32_apptrace_block, node);
 		list_del(&block->node);
+		ctx->ready_blocks_num--;
 	}
 
 	return block;
@@ -387,7 +385,8 @@ static int esp32_apptrace_wait_tracing_finished(struct esp32_apptrace_cmd_ctx *c
 	while (!list_empty(&ctx->ready_trace_blocks)) {
 		alive_sleep(100);
 		if (timeval_ms() >= timeout) {
-			LOG_ERROR("Failed to wait for pended trace blocks!");
+			ctx->stats.dropped_blocks += ctx->ready_blocks_num;
+			LOG_ERROR("Failed to wait for pended trace blocks, %u dropped!", ctx->ready_blocks_num);
 			return ERROR_FAIL;
 		}
 	}
@@ -631,6 +630,11 @@ static void esp32_apptrace_print_stats(struct esp32_apptrace_cmd_ctx *ctx)
 	LOG_USER("Data: blocks incomplete %" PRId32 ", lost bytes: %" PRId32,
 		ctx->stats.incompl_blocks,
 		ctx->stats.lost_bytes);
+	LOG_USER("Blocks: max queued %" PRIu32 " of %d, pool full %" PRIu32 " times, dropped %" PRIu32,
+		ctx->stats.max_ready_blocks,
+		ESP_APPTRACE_BLOCKS_POOL_SZ,
+		ctx->stats.pool_full,
+		ctx->stats.dropped_blocks);
 	if (s_time_stats_enable) {
 		LOG_USER("Block read time [%f..%f] ms",
 			1000 * ctx->stats.min_blk_read_time,
@@ -1110,9 +1114,11 @@ static int esp32_apptrace_poll(void *priv)
 	}
 	struct esp32_apptrace_block *block = esp32_apptrace_free_block_get(ctx);
 	if (!block) {
-		ctx->running = 0;
-		LOG_TARGET_ERROR(ctx->cpus[fired_target_num], "Failed to get free block for data!");
-		return ERROR_FAIL;
+		/* the destination does not keep up, leave the data unacked on the target
+		 * until the data processor releases a block */
+		ctx->stats.pool_full++;
+		LOG_TARGET_DEBUG(ctx->cpus[fired_target_num], "No free block for data, retry in next poll");
+		return ERROR_OK;
 	}
 	if (s_time_stats_enable) {
 		/* read block */
@@ -71,6 +71,12 @@ struct esp32_apptrace_cmd_stats {
 	float max_blk_read_time;
 	float min_blk_proc_time;
 	float max_blk_proc_time;
+	/* peak number of blocks waiting for the destination */
+	uint32_t max_ready_blocks;
+	/* polls which left the data on the target, all blocks were busy */
+	uint32_t pool_full;
+	/* received blocks never written to the destination */
+	uint32_t dropped_blocks;
 };
 
 struct esp32_apptrace_cmd_ctx {
@@ -85,6 +91,7 @@ struct esp32_apptrace_cmd_ctx {
 	uint32_t last_blk_id;
 	struct list_head free_trace_blocks;
 	struct list_head ready_trace_blocks;
+	unsigned int ready_blocks_num;
 	uint32_t max_trace_block_sz;
 	struct esp32_apptrace_format trace_format;
 	int (*process_data)(struct esp32_apptrace_cmd_ctx *ctx, unsigned int core_id, uint8_t *data, uint32_t data_len);
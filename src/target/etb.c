@@ -194,9 +194,8 @@ static int etb_read_ram(struct etb *etb, uint32_t *data, int num_frames)
 		jtag_add_callback(etb_getbuf, (jtag_callback_data_t)(data + i));
 	}
 
-	jtag_execute_queue();
-
-	return ERROR_OK;
+	/* all of the frames in a single queue, the read pointer auto-increments */
+	return jtag_execute_queue();
 }
 
 static int etb_read_reg_w_check(struct reg *reg,
@@ -535,7 +534,17 @@ static int etb_read_trace(struct etm_context *etm_ctx)
 
 	/* read data into temporary array for unpacking */
 	trace_data = malloc(sizeof(uint32_t) * num_frames);
-	etb_read_ram(etb, trace_data, num_frames);
+	if (!trace_data) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = etb_read_ram(etb, trace_data, num_frames);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("failed to read the ETB RAM");
+		free(trace_data);
+		return retval;
+	}
 
 	if (etm_ctx->trace_depth > 0)
 		free(etm_ctx->trace_data);
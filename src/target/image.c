@@ -23,7 +23,11 @@
 
 #include "image.h"
 #include "target.h"
+#include <helper/configuration.h>
 #include <helper/log.h>
+#include <helper/crc32.h>
+
+#include <sys/stat.h>
 
 /* convert ELF header field to host endianness */
 #define field16(elf, field) \
@@ -111,7 +115,113 @@ static int identify_image_type(struct image *image, const char *type_string, con
 	return ERROR_OK;
 }
 
+/* a text image, read from the file mapping or else in large blocks */
+#define IMAGE_TEXT_BLOCK_SIZE	(256 * 1024)
+
+struct image_text {
+	struct fileio *fileio;
+	const char *data;
+	size_t len;
+	size_t pos;
+	/* the block read, if the file isn't mapped */
+	char *block;
+	bool eof;
+};
+
+static int image_text_open(struct image_text *text, struct fileio *fileio)
+{
+	const uint8_t *map;
+
+	memset(text, 0, sizeof(*text));
+	text->fileio = fileio;
+
+	if (fileio_map(fileio, &map) == ERROR_OK) {
+		text->data = (const char *)map;
+		return fileio_size(fileio, &text->len);
+	}
+
+	text->block = malloc(IMAGE_TEXT_BLOCK_SIZE);
+	if (!text->block) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	text->data = text->block;
+
+	return ERROR_OK;
+}
+
+static void image_text_close(struct image_text *text)
+{
+	free(text->block);
+	text->block = NULL;
+}
+
+/* the next line, as fileio_fgets() would get it */
+static int image_text_gets(struct image_text *text, size_t size, char *line)
+{
+	size_t n = 0;
+
+	while (n < size - 1) {
+		if (text->pos == text->len) {
+			if (!text->block)
+				break;
+			int retval = fileio_read(text->fileio, IMAGE_TEXT_BLOCK_SIZE, text->block,
+					&text->len);
+			text->pos = 0;
+			if (retval != ERROR_OK || text->len == 0) {
+				text->len = 0;
+				break;
+			}
+		}
+
+		const char *p = text->data + text->pos;
+		size_t chunk = MIN(text->len - text->pos, size - 1 - n);
+		const char *nl = memchr(p, '\n', chunk);
+		if (nl)
+			chunk = nl - p + 1;
+
+		memcpy(line + n, p, chunk);
+		n += chunk;
+		text->pos += chunk;
+		if (nl)
+			break;
+	}
+
+	if (n == 0) {
+		text->eof = true;
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+	line[n] = '\0';
+
+	return ERROR_OK;
+}
+
+/* the hex digits with bit 4 set, 0 for the other characters */
+static const uint8_t image_hex_digits[256] = {
+	['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+	['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+	['a'] = 0x1a, ['b'] = 0x1b, ['c'] = 0x1c, ['d'] = 0x1d, ['e'] = 0x1e, ['f'] = 0x1f,
+	['A'] = 0x1a, ['B'] = 0x1b, ['C'] = 0x1c, ['D'] = 0x1d, ['E'] = 0x1e, ['F'] = 0x1f,
+};
+
+/* the value of @a digits hex digits of a record, stopping at the end of the line */
+static inline int image_hex(const char *s, unsigned int digits, uint32_t *value)
+{
+	uint32_t v = 0;
+
+	for (unsigned int i = 0; i < digits; i++) {
+		uint8_t d = image_hex_digits[(uint8_t)s[i]];
+		if (!d)
+			return ERROR_IMAGE_FORMAT_ERROR;
+		v = (v << 4) | (d & 0xf);
+	}
+	*value = v;
+
+	return ERROR_OK;
+}
+
 static int image_ihex_buffer_complete_inner(struct image *image,
+	struct image_text *text,
 	char *lpsz_line,
 	struct imagesection *section)
 {
@@ -131,17 +241,21 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 		return retval;
 
 	ihex->buffer = malloc(filesize >> 1);
+	if (!ihex->buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 	cooked_bytes = 0x0;
 	image->num_sections = 0;
 
-	while (!fileio_feof(fileio)) {
+	while (!text->eof) {
 		full_address = 0x0;
 		section[image->num_sections].private = &ihex->buffer[cooked_bytes];
 		section[image->num_sections].base_address = 0x0;
 		section[image->num_sections].size = 0x0;
 		section[image->num_sections].flags = 0;
 
-		while (fileio_fgets(fileio, 1023, lpsz_line) == ERROR_OK) {
+		while (image_text_gets(text, 1023, lpsz_line) == ERROR_OK) {
 			uint32_t count;
 			uint32_t address;
 			uint32_t record_type;
@@ -153,8 +267,10 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 			if ((lpsz_line[0] == '#') || (strlen(lpsz_line + strspn(lpsz_line, "\n\t\r ")) == 0))
 				continue;
 
-			if (sscanf(&lpsz_line[bytes_read], ":%2" SCNx32 "%4" SCNx32 "%2" SCNx32, &count,
-				&address, &record_type) != 3)
+			if (lpsz_line[0] != ':' ||
+				image_hex(&lpsz_line[1], 2, &count) != ERROR_OK ||
+				image_hex(&lpsz_line[3], 4, &address) != ERROR_OK ||
+				image_hex(&lpsz_line[7], 2, &record_type) != ERROR_OK)
 				return ERROR_IMAGE_FORMAT_ERROR;
 			bytes_read += 9;
 
@@ -186,22 +302,29 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 					full_address = (full_address & 0xffff0000) | address;
 				}
 
-				while (count-- > 0) {
-					unsigned value;
-					sscanf(&lpsz_line[bytes_read], "%2x", &value);
-					ihex->buffer[cooked_bytes] = (uint8_t)value;
-					cal_checksum += (uint8_t)ihex->buffer[cooked_bytes];
+				uint8_t *data = &ihex->buffer[cooked_bytes];
+				for (uint32_t i = 0; i < count; i++) {
+					uint32_t value;
+					if (image_hex(&lpsz_line[bytes_read], 2, &value) != ERROR_OK)
+						return ERROR_IMAGE_FORMAT_ERROR;
+					data[i] = value;
+					cal_checksum += value;
 					bytes_read += 2;
-					cooked_bytes += 1;
-					section[image->num_sections].size += 1;
-					full_address++;
 				}
+				cooked_bytes += count;
+				section[image->num_sections].size += count;
+				full_address += count;
 			} else if (record_type == 1) {	/* End of File Record */
 				/* finish the current section */
 				image->num_sections++;
 
 				/* copy section information */
+				free(image->sections);
 				image->sections = malloc(sizeof(struct imagesection) * image->num_sections);
+				if (!image->sections) {
+					LOG_ERROR("Out of memory");
+					return ERROR_FAIL;
+				}
 				for (unsigned int i = 0; i < image->num_sections; i++) {
 					image->sections[i].private = section[i].private;
 					image->sections[i].base_address = section[i].base_address;
@@ -212,9 +335,10 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 				end_rec = true;
 				break;
 			} else if (record_type == 2) {	/* Linear Address Record */
-				uint16_t upper_address;
+				uint32_t upper_address;
 
-				sscanf(&lpsz_line[bytes_read], "%4hx", &upper_address);
+				if (image_hex(&lpsz_line[bytes_read], 4, &upper_address) != ERROR_OK)
+					return ERROR_IMAGE_FORMAT_ERROR;
 				cal_checksum += (uint8_t)(upper_address >> 8);
 				cal_checksum += (uint8_t)upper_address;
 				bytes_read += 4;
@@ -246,14 +370,16 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 				/* "Start Segment Address Record" will not be supported
 				 * but we must consume it, and do not create an error.  */
 				while (count-- > 0) {
-					sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &dummy);
+					if (image_hex(&lpsz_line[bytes_read], 2, &dummy) != ERROR_OK)
+						return ERROR_IMAGE_FORMAT_ERROR;
 					cal_checksum += (uint8_t)dummy;
 					bytes_read += 2;
 				}
 			} else if (record_type == 4) {	/* Extended Linear Address Record */
-				uint16_t upper_address;
+				uint32_t upper_address;
 
-				sscanf(&lpsz_line[bytes_read], "%4hx", &upper_address);
+				if (image_hex(&lpsz_line[bytes_read], 4, &upper_address) != ERROR_OK)
+					return ERROR_IMAGE_FORMAT_ERROR;
 				cal_checksum += (uint8_t)(upper_address >> 8);
 				cal_checksum += (uint8_t)upper_address;
 				bytes_read += 4;
@@ -282,7 +408,8 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 			} else if (record_type == 5) {	/* Start Linear Address Record */
 				uint32_t start_address;
 
-				sscanf(&lpsz_line[bytes_read], "%8" SCNx32, &start_address);
+				if (image_hex(&lpsz_line[bytes_read], 8, &start_address) != ERROR_OK)
+					return ERROR_IMAGE_FORMAT_ERROR;
 				cal_checksum += (uint8_t)(start_address >> 24);
 				cal_checksum += (uint8_t)(start_address >> 16);
 				cal_checksum += (uint8_t)(start_address >> 8);
@@ -296,7 +423,8 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 				return ERROR_IMAGE_FORMAT_ERROR;
 			}
 
-			sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &checksum);
+			if (image_hex(&lpsz_line[bytes_read], 2, &checksum) != ERROR_OK)
+				return ERROR_IMAGE_FORMAT_ERROR;
 
 			if ((uint8_t)checksum != (uint8_t)(~cal_checksum + 1)) {
 				/* checksum failed */
@@ -336,9 +464,12 @@ static int image_ihex_buffer_complete(struct image *image)
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
-	int retval;
-
-	retval = image_ihex_buffer_complete_inner(image, lpsz_line, section);
+	struct image_ihex *ihex = image->type_private;
+	struct image_text text;
+	int retval = image_text_open(&text, ihex->fileio);
+	if (retval == ERROR_OK)
+		retval = image_ihex_buffer_complete_inner(image, &text, lpsz_line, section);
+	image_text_close(&text);
 
 	free(section);
 	free(lpsz_line);
@@ -758,6 +889,7 @@ static int image_elf_read_section(struct image *image,
 }
 
 static int image_mot_buffer_complete_inner(struct image *image,
+	struct image_text *text,
 	char *lpsz_line,
 	struct imagesection *section)
 {
@@ -777,17 +909,21 @@ static int image_mot_buffer_complete_inner(struct image *image,
 		return retval;
 
 	mot->buffer = malloc(filesize >> 1);
+	if (!mot->buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 	cooked_bytes = 0x0;
 	image->num_sections = 0;
 
-	while (!fileio_feof(fileio)) {
+	while (!text->eof) {
 		full_address = 0x0;
 		section[image->num_sections].private = &mot->buffer[cooked_bytes];
 		section[image->num_sections].base_address = 0x0;
 		section[image->num_sections].size = 0x0;
 		section[image->num_sections].flags = 0;
 
-		while (fileio_fgets(fileio, 1023, lpsz_line) == ERROR_OK) {
+		while (image_text_gets(text, 1023, lpsz_line) == ERROR_OK) {
 			uint32_t count;
 			uint32_t address;
 			uint32_t record_type;
@@ -800,8 +936,9 @@ static int image_mot_buffer_complete_inner(struct image *image,
 				continue;
 
 			/* get record type and record length */
-			if (sscanf(&lpsz_line[bytes_read], "S%1" SCNx32 "%2" SCNx32, &record_type,
-				&count) != 2)
+			if (lpsz_line[0] != 'S' ||
+				image_hex(&lpsz_line[1], 1, &record_type) != ERROR_OK ||
+				image_hex(&lpsz_line[2], 2, &count) != ERROR_OK || count == 0)
 				return ERROR_IMAGE_FORMAT_ERROR;
 
 			bytes_read += 4;
@@ -812,10 +949,11 @@ static int image_mot_buffer_complete_inner(struct image *image,
 
 			if (record_type == 0) {
 				/* S0 - starting record (optional) */
-				int value;
+				uint32_t value;
 
 				while (count-- > 0) {
-					sscanf(&lpsz_line[bytes_read], "%2x", &value);
+					if (image_hex(&lpsz_line[bytes_read], 2, &value) != ERROR_OK)
+						return ERROR_IMAGE_FORMAT_ERROR;
 					cal_checksum += (uint8_t)value;
 					bytes_read += 2;
 				}
@@ -823,7 +961,8 @@ static int image_mot_buffer_complete_inner(struct image *image,
 				switch (record_type) {
 					case 1:
 						/* S1 - 16 bit address data record */
-						sscanf(&lpsz_line[bytes_read], "%4" SCNx32, &address);
+						if (image_hex(&lpsz_line[bytes_read], 4, &address) != ERROR_OK)
+							return ERROR_IMAGE_FORMAT_ERROR;
 						cal_checksum += (uint8_t)(address >> 8);
 						cal_checksum += (uint8_t)address;
 						bytes_read += 4;
@@ -832,7 +971,8 @@ static int image_mot_buffer_complete_inner(struct image *image,
 
 					case 2:
 						/* S2 - 24 bit address data record */
-						sscanf(&lpsz_line[bytes_read], "%6" SCNx32, &address);
+						if (image_hex(&lpsz_line[bytes_read], 6, &address) != ERROR_OK)
+							return ERROR_IMAGE_FORMAT_ERROR;
 						cal_checksum += (uint8_t)(address >> 16);
 						cal_checksum += (uint8_t)(address >> 8);
 						cal_checksum += (uint8_t)address;
@@ -842,7 +982,8 @@ static int image_mot_buffer_complete_inner(struct image *image,
 
 					case 3:
 						/* S3 - 32 bit address data record */
-						sscanf(&lpsz_line[bytes_read], "%8" SCNx32, &address);
+						if (image_hex(&lpsz_line[bytes_read], 8, &address) != ERROR_OK)
+							return ERROR_IMAGE_FORMAT_ERROR;
 						cal_checksum += (uint8_t)(address >> 24);
 						cal_checksum += (uint8_t)(address >> 16);
 						cal_checksum += (uint8_t)(address >> 8);
@@ -869,22 +1010,25 @@ static int image_mot_buffer_complete_inner(struct image *image,
 					full_address = address;
 				}
 
-				while (count-- > 0) {
-					unsigned value;
-					sscanf(&lpsz_line[bytes_read], "%2x", &value);
-					mot->buffer[cooked_bytes] = (uint8_t)value;
-					cal_checksum += (uint8_t)mot->buffer[cooked_bytes];
+				uint8_t *data = &mot->buffer[cooked_bytes];
+				for (uint32_t i = 0; i < count; i++) {
+					uint32_t value;
+					if (image_hex(&lpsz_line[bytes_read], 2, &value) != ERROR_OK)
+						return ERROR_IMAGE_FORMAT_ERROR;
+					data[i] = value;
+					cal_checksum += value;
 					bytes_read += 2;
-					cooked_bytes += 1;
-					section[image->num_sections].size += 1;
-					full_address++;
 				}
+				cooked_bytes += count;
+				section[image->num_sections].size += count;
+				full_address += count;
 			} else if (record_type == 5 || record_type == 6) {
 				/* S5 and S6 are the data count records, we ignore them */
 				uint32_t dummy;
 
 				while (count-- > 0) {
-					sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &dummy);
+					if (image_hex(&lpsz_line[bytes_read], 2, &dummy) != ERROR_OK)
+						return ERROR_IMAGE_FORMAT_ERROR;
 					cal_checksum += (uint8_t)dummy;
 					bytes_read += 2;
 				}
@@ -893,7 +1037,12 @@ static int image_mot_buffer_complete_inner(struct image *image,
 				image->num_sections++;
 
 				/* copy section information */
+				free(image->sections);
 				image->sections = malloc(sizeof(struct imagesection) * image->num_sections);
+				if (!image->sections) {
+					LOG_ERROR("Out of memory");
+					return ERROR_FAIL;
+				}
 				for (unsigned int i = 0; i < image->num_sections; i++) {
 					image->sections[i].private = section[i].private;
 					image->sections[i].base_address = section[i].base_address;
@@ -909,7 +1058,8 @@ static int image_mot_buffer_complete_inner(struct image *image,
 			}
 
 			/* account for checksum, will always be 0xFF */
-			sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &checksum);
+			if (image_hex(&lpsz_line[bytes_read], 2, &checksum) != ERROR_OK)
+				return ERROR_IMAGE_FORMAT_ERROR;
 			cal_checksum += (uint8_t)checksum;
 
 			if (cal_checksum != 0xFF) {
@@ -950,9 +1100,12 @@ static int image_mot_buffer_complete(struct image *image)
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
-	int retval;
-
-	retval = image_mot_buffer_complete_inner(image, lpsz_line, section);
+	struct image_mot *mot = image->type_private;
+	struct image_text text;
+	int retval = image_text_open(&text, mot->fileio);
+	if (retval == ERROR_OK)
+		retval = image_mot_buffer_complete_inner(image, &text, lpsz_line, section);
+	image_text_close(&text);
 
 	free(section);
 	free(lpsz_line);
@@ -960,6 +1113,159 @@ static int image_mot_buffer_complete(struct image *image)
 	return retval;
 }
 
+/*
+ * The IHEX and S19 images parsed, kept for the next commands opening the
+ * same file, as long as the file isn't changed.
+ */
+#define IMAGE_CACHE_MAX		8
+
+struct image_cache {
+	char *path;
+	enum image_type type;
+	struct stat stat;
+	uint8_t *buffer;
+	unsigned int num_sections;
+	struct imagesection *sections;
+	bool start_address_set;
+	uint32_t start_address;
+	/* the images open from it */
+	unsigned int users;
+	/* out of the list, freed by its last user */
+	bool dropped;
+	struct image_cache *next;
+};
+
+static struct image_cache *image_cache_list;
+
+static void image_cache_free(struct image_cache *cache)
+{
+	free(cache->path);
+	free(cache->buffer);
+	free(cache->sections);
+	free(cache);
+}
+
+static void image_cache_drop(struct image_cache **p)
+{
+	struct image_cache *cache = *p;
+
+	*p = cache->next;
+	cache->dropped = true;
+	if (!cache->users)
+		image_cache_free(cache);
+}
+
+static void image_cache_put(struct image_cache *cache)
+{
+	if (!cache)
+		return;
+
+	cache->users--;
+	if (cache->dropped && !cache->users)
+		image_cache_free(cache);
+}
+
+static bool image_cache_stat(const char *url, char **path, struct stat *st)
+{
+	*path = find_file(url);
+	if (*path && stat(*path, st) == 0)
+		return true;
+
+	free(*path);
+	*path = NULL;
+	return false;
+}
+
+static bool image_cache_match(const struct stat *a, const struct stat *b)
+{
+	return a->st_mtime == b->st_mtime && a->st_ctime == b->st_ctime
+		&& a->st_size == b->st_size && a->st_ino == b->st_ino && a->st_dev == b->st_dev;
+}
+
+/* the image parsed earlier from the file, with its own copy of the sections */
+static struct image_cache *image_cache_get(struct image *image, const char *url)
+{
+	struct stat st;
+	char *path;
+
+	if (!image_cache_stat(url, &path, &st))
+		return NULL;
+
+	for (struct image_cache **p = &image_cache_list; *p; p = &(*p)->next) {
+		struct image_cache *cache = *p;
+		if (cache->type != image->type || strcmp(cache->path, path))
+			continue;
+
+		free(path);
+
+		if (!image_cache_match(&cache->stat, &st)) {
+			LOG_DEBUG("%s changed, parsing it again", cache->path);
+			image_cache_drop(p);
+			return NULL;
+		}
+
+		image->sections = malloc(cache->num_sections * sizeof(*image->sections));
+		if (!image->sections)
+			return NULL;
+		memcpy(image->sections, cache->sections,
+			cache->num_sections * sizeof(*image->sections));
+		image->num_sections = cache->num_sections;
+		if (cache->start_address_set) {
+			image->start_address_set = true;
+			image->start_address = cache->start_address;
+		}
+
+		cache->users++;
+		LOG_DEBUG("%s from the image cache", cache->path);
+		return cache;
+	}
+
+	free(path);
+	return NULL;
+}
+
+/* keep the image just parsed, the cache takes over @a buffer */
+static struct image_cache *image_cache_add(struct image *image, const char *url,
+	uint8_t **buffer)
+{
+	struct image_cache *cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	if (!image_cache_stat(url, &cache->path, &cache->stat)) {
+		free(cache);
+		return NULL;
+	}
+
+	cache->sections = malloc(image->num_sections * sizeof(*cache->sections));
+	if (!cache->sections) {
+		image_cache_free(cache);
+		return NULL;
+	}
+	memcpy(cache->sections, image->sections, image->num_sections * sizeof(*cache->sections));
+	cache->num_sections = image->num_sections;
+	cache->type = image->type;
+	cache->start_address_set = image->start_address_set;
+	cache->start_address = image->start_address;
+	cache->buffer = *buffer;
+	*buffer = NULL;
+	cache->users = 1;
+
+	/* the most recent first, the oldest beyond the limit dropped */
+	cache->next = image_cache_list;
+	image_cache_list = cache;
+
+	unsigned int n = 0;
+	for (struct image_cache **p = &image_cache_list; *p; ) {
+		if (++n > IMAGE_CACHE_MAX)
+			image_cache_drop(p);
+		else
+			p = &(*p)->next;
+	}
+
+	return cache;
+}
+
 int image_open(struct image *image, const char *url, const char *type_string)
 {
 	int retval = ERROR_OK;
@@ -991,18 +1297,23 @@ int image_open(struct image *image, const char *url, const char *type_string)
 	} else if (image->type == IMAGE_IHEX) {
 		struct image_ihex *image_ihex;
 
-		image_ihex = image->type_private = malloc(sizeof(struct image_ihex));
+		image_ihex = image->type_private = calloc(1, sizeof(struct image_ihex));
 
-		retval = fileio_open(&image_ihex->fileio, url, FILEIO_READ, FILEIO_TEXT);
-		if (retval != ERROR_OK)
-			return retval;
+		image_ihex->cache = image_cache_get(image, url);
+		if (!image_ihex->cache) {
+			retval = fileio_open(&image_ihex->fileio, url, FILEIO_READ, FILEIO_TEXT);
+			if (retval != ERROR_OK)
+				return retval;
 
-		retval = image_ihex_buffer_complete(image);
-		if (retval != ERROR_OK) {
-			LOG_ERROR(
-				"failed buffering IHEX image, check server output for additional information");
-			fileio_close(image_ihex->fileio);
-			return retval;
+			retval = image_ihex_buffer_complete(image);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("failed buffering IHEX image, check server output "
+					"for additional information");
+				fileio_close(image_ihex->fileio);
+				return retval;
+			}
+
+			image_ihex->cache = image_cache_add(image, url, &image_ihex->buffer);
 		}
 	} else if (image->type == IMAGE_ELF) {
 		struct image_elf *image_elf;
@@ -1042,18 +1353,23 @@ int image_open(struct image *image, const char *url, const char *type_string)
 	} else if (image->type == IMAGE_SRECORD) {
 		struct image_mot *image_mot;
 
-		image_mot = image->type_private = malloc(sizeof(struct image_mot));
+		image_mot = image->type_private = calloc(1, sizeof(struct image_mot));
 
-		retval = fileio_open(&image_mot->fileio, url, FILEIO_READ, FILEIO_TEXT);
-		if (retval != ERROR_OK)
-			return retval;
+		image_mot->cache = image_cache_get(image, url);
+		if (!image_mot->cache) {
+			retval = fileio_open(&image_mot->fileio, url, FILEIO_READ, FILEIO_TEXT);
+			if (retval != ERROR_OK)
+				return retval;
 
-		retval = image_mot_buffer_complete(image);
-		if (retval != ERROR_OK) {
-			LOG_ERROR(
-				"failed buffering S19 image, check server output for additional information");
-			fileio_close(image_mot->fileio);
-			return retval;
+			retval = image_mot_buffer_complete(image);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("failed buffering S19 image, check server output "
+					"for additional information");
+				fileio_close(image_mot->fileio);
+				return retval;
+			}
+
+			image_mot->cache = image_cache_add(image, url, &image_mot->buffer);
 		}
 	} else if (image->type == IMAGE_BUILDER) {
 		image->num_sections = 0;
@@ -1095,6 +1411,17 @@ int image_read_section(struct image *image,
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	}
 
+	/* from the mapping of the file, without the seeks and the stdio copies */
+	if (image->type == IMAGE_BINARY || image->type == IMAGE_ELF) {
+		const uint8_t *data;
+
+		if (image_section_data(image, section, offset, size, &data) == ERROR_OK) {
+			memcpy(buffer, data, size);
+			*size_read = size;
+			return ERROR_OK;
+		}
+	}
+
 	if (image->type == IMAGE_BINARY) {
 		struct image_binary *image_binary = image->type_private;
 
@@ -1171,6 +1498,224 @@ int image_read_section(struct image *image,
 	return ERROR_OK;
 }
 
+int image_section_data(struct image *image, int section, target_addr_t offset,
+		uint32_t size, const uint8_t **data)
+{
+	struct fileio *fileio;
+	uint64_t file_offset;
+	const uint8_t *map;
+	size_t file_size;
+	int retval;
+
+	if (offset + size > image->sections[section].size)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	switch (image->type) {
+	case IMAGE_IHEX:
+	case IMAGE_SRECORD:
+	case IMAGE_BUILDER:
+		*data = (const uint8_t *)image->sections[section].private + offset;
+		return ERROR_OK;
+	case IMAGE_BINARY: {
+		struct image_binary *image_binary = image->type_private;
+
+		fileio = image_binary->fileio;
+		file_offset = offset;
+		break;
+	}
+	case IMAGE_ELF: {
+		struct image_elf *elf = image->type_private;
+
+		/* the bss part isn't in the file */
+		if (elf->is_64_bit) {
+			Elf64_Phdr *segment = image->sections[section].private;
+			if (offset + size > field64(elf, segment->p_filesz))
+				return ERROR_NOT_IMPLEMENTED;
+			file_offset = field64(elf, segment->p_offset) + offset;
+		} else {
+			Elf32_Phdr *segment = image->sections[section].private;
+			if (offset + size > field32(elf, segment->p_filesz))
+				return ERROR_NOT_IMPLEMENTED;
+			file_offset = field32(elf, segment->p_offset) + offset;
+		}
+		fileio = elf->fileio;
+		break;
+	}
+	default:
+		return ERROR_NOT_IMPLEMENTED;
+	}
+
+	retval = fileio_map(fileio, &map);
+	if (retval != ERROR_OK)
+		return ERROR_NOT_IMPLEMENTED;
+
+	fileio_size(fileio, &file_size);
+	if (file_offset + size > file_size)
+		return ERROR_IMAGE_FORMAT_ERROR;
+
+	*data = map + file_offset;
+
+	return ERROR_OK;
+}
+
+int image_get_section(struct image *image, int section, const uint8_t **data,
+		uint8_t **copy, size_t *size)
+{
+	uint32_t section_size = image->sections[section].size;
+
+	*copy = NULL;
+	if (image_section_data(image, section, 0, section_size, data) == ERROR_OK) {
+		*size = section_size;
+		return ERROR_OK;
+	}
+
+	*copy = malloc(section_size);
+	if (!*copy) {
+		LOG_ERROR("error allocating buffer for section (%" PRIu32 " bytes)", section_size);
+		return ERROR_FAIL;
+	}
+
+	int retval = image_read_section(image, section, 0, section_size, *copy, size);
+	if (retval != ERROR_OK) {
+		free(*copy);
+		*copy = NULL;
+		return retval;
+	}
+
+	*data = *copy;
+	return ERROR_OK;
+}
+
+static int image_plan_compare(const void *a, const void *b)
+{
+	const struct imagesection *sa = *(const struct imagesection * const *)a;
+	const struct imagesection *sb = *(const struct imagesection * const *)b;
+
+	if (sa->base_address != sb->base_address)
+		return sa->base_address < sb->base_address ? -1 : 1;
+
+	/* in the order of the image, for the same address */
+	return sa < sb ? -1 : 1;
+}
+
+int image_plan_runs(struct image *image, uint32_t gap, uint8_t padding,
+		struct image_plan *plan)
+{
+	memset(plan, 0, sizeof(*plan));
+	plan->padding = padding;
+
+	if (!image->num_sections)
+		return ERROR_OK;
+
+	struct imagesection **sorted = malloc(image->num_sections * sizeof(*sorted));
+	plan->order = malloc(image->num_sections * sizeof(*plan->order));
+	plan->runs = malloc(image->num_sections * sizeof(*plan->runs));
+	if (!sorted || !plan->order || !plan->runs) {
+		LOG_ERROR("Out of memory");
+		free(sorted);
+		image_plan_free(plan);
+		return ERROR_FAIL;
+	}
+
+	unsigned int num_order = 0;
+	for (unsigned int i = 0; i < image->num_sections; i++)
+		if (image->sections[i].size)
+			sorted[num_order++] = &image->sections[i];
+
+	qsort(sorted, num_order, sizeof(*sorted), image_plan_compare);
+
+	bool overlap = false;
+	for (unsigned int i = 1; i < num_order; i++)
+		if (sorted[i]->base_address < sorted[i - 1]->base_address + sorted[i - 1]->size)
+			overlap = true;
+
+	/* the later sections overwrite the earlier ones, keep their order */
+	if (overlap) {
+		LOG_DEBUG("overlapping sections, written in the order of the image");
+		num_order = 0;
+		for (unsigned int i = 0; i < image->num_sections; i++)
+			if (image->sections[i].size)
+				sorted[num_order++] = &image->sections[i];
+	}
+
+	for (unsigned int i = 0; i < num_order; i++)
+		plan->order[i] = sorted[i] - image->sections;
+	free(sorted);
+
+	struct image_run *run = NULL;
+	for (unsigned int i = 0; i < num_order; i++) {
+		const struct imagesection *section = &image->sections[plan->order[i]];
+
+		if (run) {
+			target_addr_t end = run->base_address + run->size;
+			if (section->base_address >= end && section->base_address - end <= gap
+					&& section->base_address + section->size - run->base_address <= UINT32_MAX) {
+				run->size = section->base_address + section->size - run->base_address;
+				run->num_sections++;
+				continue;
+			}
+		}
+
+		run = &plan->runs[plan->num_runs++];
+		run->base_address = section->base_address;
+		run->size = section->size;
+		run->first = i;
+		run->num_sections = 1;
+	}
+
+	LOG_DEBUG("%u sections in %u runs", image->num_sections, plan->num_runs);
+
+	return ERROR_OK;
+}
+
+int image_get_run(struct image *image, const struct image_plan *plan,
+		unsigned int run, const uint8_t **data, uint8_t **copy)
+{
+	const struct image_run *r = &plan->runs[run];
+	size_t size;
+
+	if (r->num_sections == 1)
+		return image_get_section(image, plan->order[r->first], data, copy, &size);
+
+	*copy = malloc(r->size);
+	if (!*copy) {
+		LOG_ERROR("error allocating buffer for section (%" PRIu32 " bytes)", r->size);
+		return ERROR_FAIL;
+	}
+	memset(*copy, plan->padding, r->size);
+
+	for (unsigned int i = r->first; i < r->first + r->num_sections; i++) {
+		const struct imagesection *section = &image->sections[plan->order[i]];
+		uint8_t *dst = *copy + (section->base_address - r->base_address);
+		const uint8_t *src;
+
+		int retval = image_section_data(image, plan->order[i], 0, section->size, &src);
+		if (retval == ERROR_OK) {
+			memcpy(dst, src, section->size);
+			continue;
+		}
+
+		retval = image_read_section(image, plan->order[i], 0, section->size, dst, &size);
+		if (retval != ERROR_OK) {
+			free(*copy);
+			*copy = NULL;
+			return retval;
+		}
+	}
+
+	*data = *copy;
+	return ERROR_OK;
+}
+
+void image_plan_free(struct image_plan *plan)
+{
+	free(plan->order);
+	plan->order = NULL;
+	free(plan->runs);
+	plan->runs = NULL;
+	plan->num_runs = 0;
+}
+
 int image_add_section(struct image *image, target_addr_t base, uint32_t size, uint64_t flags, uint8_t const *data)
 {
 	struct imagesection *section;
@@ -1217,10 +1762,12 @@ void image_close(struct image *image)
 	} else if (image->type == IMAGE_IHEX) {
 		struct image_ihex *image_ihex = image->type_private;
 
-		fileio_close(image_ihex->fileio);
+		if (image_ihex->fileio)
+			fileio_close(image_ihex->fileio);
 
 		free(image_ihex->buffer);
 		image_ihex->buffer = NULL;
+		image_cache_put(image_ihex->cache);
 	} else if (image->type == IMAGE_ELF) {
 		struct image_elf *image_elf = image->type_private;
 
@@ -1247,10 +1794,12 @@ void image_close(struct image *image)
 	} else if (image->type == IMAGE_SRECORD) {
 		struct image_mot *image_mot = image->type_private;
 
-		fileio_close(image_mot->fileio);
+		if (image_mot->fileio)
+			fileio_close(image_mot->fileio);
 
 		free(image_mot->buffer);
 		image_mot->buffer = NULL;
+		image_cache_put(image_mot->cache);
 	} else if (image->type == IMAGE_BUILDER) {
 		for (unsigned int i = 0; i < image->num_sections; i++) {
 			free(image->sections[i].private);
@@ -1270,31 +1819,14 @@ int image_calculate_checksum(const uint8_t *buffer, uint32_t nbytes, uint32_t *c
 	uint32_t crc = 0xffffffff;
 	LOG_DEBUG("Calculating checksum");
 
-	static uint32_t crc32_table[256];
-
-	static bool first_init;
-	if (!first_init) {
-		/* Initialize the CRC table and the decoding table.  */
-		unsigned int i, j, c;
-		for (i = 0; i < 256; i++) {
-			/* as per gdb */
-			for (c = i << 24, j = 8; j > 0; --j)
-				c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
-			crc32_table[i] = c;
-		}
-
-		first_init = true;
-	}
-
 	while (nbytes > 0) {
-		int run = nbytes;
+		uint32_t run = nbytes;
 		if (run > 32768)
 			run = 32768;
 		nbytes -= run;
-		while (run--) {
-			/* as per gdb */
-			crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ *buffer++) & 255];
-		}
+		/* as per gdb */
+		crc = crc32_be(CRC32_POLY_BE, crc, buffer, run);
+		buffer += run;
 		keep_alive();
 	}
 
@@ -1303,3 +1835,50 @@ int image_calculate_checksum(const uint8_t *buffer, uint32_t nbytes, uint32_t *c
 	*checksum = crc;
 	return ERROR_OK;
 }
+
+COMMAND_HANDLER(handle_image_cache_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "clear"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		while (image_cache_list)
+			image_cache_drop(&image_cache_list);
+		return ERROR_OK;
+	}
+
+	for (struct image_cache *cache = image_cache_list; cache; cache = cache->next) {
+		uint64_t size = 0;
+		for (unsigned int i = 0; i < cache->num_sections; i++)
+			size += cache->sections[i].size;
+		command_print(CMD, "%s: %u sections, %" PRIu64 " bytes", cache->path,
+				cache->num_sections, size);
+	}
+
+	return ERROR_OK;
+}
+
+static const struct command_registration image_subcommand_handlers[] = {
+	{
+		.name = "cache",
+		.handler = handle_image_cache_command,
+		.mode = COMMAND_ANY,
+		.help = "list the IHEX and S19 images kept parsed, or forget them",
+		.usage = "['clear']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration image_command_handlers[] = {
+	{
+		.name = "image",
+		.mode = COMMAND_ANY,
+		.help = "image commands",
+		.chain = image_subcommand_handlers,
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
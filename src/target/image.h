@@ -17,6 +17,7 @@
 #ifndef OPENOCD_TARGET_IMAGE_H
 #define OPENOCD_TARGET_IMAGE_H
 
+#include <helper/command.h>
 #include <helper/fileio.h>
 #include <helper/replacements.h>
 
@@ -56,13 +57,35 @@ struct image {
 	uint32_t start_address;		/* start address, if one is set */
 };
 
+/* sections next to each other, or with gaps filled, written in one go */
+struct image_run {
+	target_addr_t base_address;
+	uint32_t size;
+	/* the sections of the run, image_plan.order[first] onwards */
+	unsigned int first;
+	unsigned int num_sections;
+};
+
+struct image_plan {
+	/* the numbers of the sections, by address unless some overlap */
+	unsigned int *order;
+	struct image_run *runs;
+	unsigned int num_runs;
+	/* the value of the bytes of the gaps inside the runs */
+	uint8_t padding;
+};
+
 struct image_binary {
 	struct fileio *fileio;
 };
 
+struct image_cache;
+
 struct image_ihex {
 	struct fileio *fileio;
 	uint8_t *buffer;
+	/* the parsed image of the cache, NULL if not cached */
+	struct image_cache *cache;
 };
 
 struct image_memory {
@@ -89,11 +112,37 @@ struct image_elf {
 struct image_mot {
 	struct fileio *fileio;
 	uint8_t *buffer;
+	/* the parsed image of the cache, NULL if not cached */
+	struct image_cache *cache;
 };
 
 int image_open(struct image *image, const char *url, const char *type_string);
 int image_read_section(struct image *image, int section, target_addr_t offset,
 		uint32_t size, uint8_t *buffer, size_t *size_read);
+/*
+ * Point @a data to @a size bytes of a section without copying them, valid
+ * until image_close(). Fails with ERROR_NOT_IMPLEMENTED for the images,
+ * or the parts of them, only image_read_section() can read.
+ */
+int image_section_data(struct image *image, int section, target_addr_t offset,
+		uint32_t size, const uint8_t **data);
+/*
+ * Point @a data to a whole section, in place when image_section_data() can,
+ * else to a copy in @a copy, which the caller frees (NULL when in place).
+ */
+int image_get_section(struct image *image, int section, const uint8_t **data,
+		uint8_t **copy, size_t *size);
+/*
+ * Merge the sections of an image into runs, those apart by up to @a gap
+ * bytes included, the gaps filled with @a padding. Empty sections are left
+ * out. Free the plan with image_plan_free().
+ */
+int image_plan_runs(struct image *image, uint32_t gap, uint8_t padding,
+		struct image_plan *plan);
+/* Like image_get_section(), for a run of image_plan_runs() */
+int image_get_run(struct image *image, const struct image_plan *plan,
+		unsigned int run, const uint8_t **data, uint8_t **copy);
+void image_plan_free(struct image_plan *plan);
 void image_close(struct image *image);
 
 int image_add_section(struct image *image, target_addr_t base, uint32_t size,
@@ -102,6 +151,8 @@ int image_add_section(struct image *image, target_addr_t base, uint32_t size,
 int image_calculate_checksum(const uint8_t *buffer, uint32_t nbytes,
 		uint32_t *checksum);
 
+extern const struct command_registration image_command_handlers[];
+
 #define ERROR_IMAGE_FORMAT_ERROR	(-1400)
 #define ERROR_IMAGE_TYPE_UNKNOWN	(-1401)
 #define ERROR_IMAGE_TEMPORARILY_UNAVAILABLE		(-1402)
@@ -45,6 +45,7 @@ static int do_halt(struct target *t);
 static int do_resume(struct target *t);
 static int read_all_core_hw_regs(struct target *t);
 static int write_all_core_hw_regs(struct target *t);
+static int queue_read_hw_reg(struct target *t, int reg, uint8_t *pdr);
 static int read_hw_reg(struct target *t,
 			int reg, uint32_t *regval, uint8_t cache);
 static int write_hw_reg(struct target *t,
@@ -596,19 +597,44 @@ static int do_resume(struct target *t)
 static int read_all_core_hw_regs(struct target *t)
 {
 	int err;
-	uint32_t regval;
 	unsigned i;
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	uint8_t *pdr = calloc(x86_32->cache->num_regs, PDR_SIZE / 8);
+	if (!pdr) {
+		LOG_ERROR("%s out of memory", __func__);
+		return ERROR_FAIL;
+	}
+
+	/* queue the reads of the whole context and flush them once */
 	for (i = 0; i < (x86_32->cache->num_regs); i++) {
 		if (regs[i].pm_idx == NOT_AVAIL_REG)
 			continue;
-		err = read_hw_reg(t, regs[i].id, &regval, 1);
+		err = queue_read_hw_reg(t, regs[i].id, pdr + i * PDR_SIZE / 8);
 		if (err != ERROR_OK) {
+			x86_32->flush = 1;
 			LOG_ERROR("%s error saving reg %s",
 					__func__, x86_32->cache->reg_list[i].name);
+			free(pdr);
 			return err;
 		}
 	}
+	x86_32->flush = 1;
+	err = jtag_execute_queue();
+	if (err != ERROR_OK) {
+		LOG_ERROR("%s failed to execute queue", __func__);
+		free(pdr);
+		return err;
+	}
+
+	for (i = 0; i < (x86_32->cache->num_regs); i++) {
+		if (regs[i].pm_idx == NOT_AVAIL_REG)
+			continue;
+		struct reg *r = &x86_32->cache->reg_list[regs[i].id];
+		buf_set_u32(r->value, 0, 32, buf_get_u32(pdr + i * PDR_SIZE / 8, 0, 32));
+		r->valid = true;
+		r->dirty = false;
+	}
+	free(pdr);
 	LOG_DEBUG("read_all_core_hw_regs read %u registers ok", i);
 	return ERROR_OK;
 }
@@ -618,26 +644,36 @@ static int write_all_core_hw_regs(struct target *t)
 	int err;
 	unsigned i;
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
+
+	/* queue the writes of the whole context and flush them once */
+	x86_32->flush = 0;
 	for (i = 0; i < (x86_32->cache->num_regs); i++) {
 		if (regs[i].pm_idx == NOT_AVAIL_REG)
 			continue;
 		err = write_hw_reg(t, i, 0, 1);
 		if (err != ERROR_OK) {
+			x86_32->flush = 1;
 			LOG_ERROR("%s error restoring reg %s",
 					__func__, x86_32->cache->reg_list[i].name);
 			return err;
 		}
 	}
+	x86_32->flush = 1;
+	err = jtag_execute_queue();
+	if (err != ERROR_OK) {
+		LOG_ERROR("%s failed to execute queue", __func__);
+		return err;
+	}
 	LOG_DEBUG("write_all_core_hw_regs wrote %u registers ok", i);
 	return ERROR_OK;
 }
 
-/* read reg from lakemont core shadow ram, update reg cache if needed */
-static int read_hw_reg(struct target *t, int reg, uint32_t *regval, uint8_t cache)
+/* queue the read of a reg from lakemont core shadow ram into pdr, which is
+ * only valid after the queue is flushed; leaves flushing disabled
+ */
+static int queue_read_hw_reg(struct target *t, int reg, uint8_t *pdr)
 {
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
-	struct lakemont_core_reg *arch_info;
-	arch_info = x86_32->cache->reg_list[reg].arch_info;
 	x86_32->flush = 0; /* don't flush scans till we have a batch */
 	if (submit_reg_pir(t, reg) != ERROR_OK)
 		return ERROR_FAIL;
@@ -645,14 +681,32 @@ static int read_hw_reg(struct target *t, int reg, uint32_t *regval, uint8_t cach
 		return ERROR_FAIL;
 	if (submit_instruction_pir(t, SRAM2PDR) != ERROR_OK)
 		return ERROR_FAIL;
-	x86_32->flush = 1;
 	scan.out[0] = RDWRPDR;
 	if (irscan(t, scan.out, NULL, LMT_IRLEN) != ERROR_OK)
 		return ERROR_FAIL;
-	if (drscan(t, NULL, scan.out, PDR_SIZE) != ERROR_OK)
+	if (drscan(t, NULL, pdr, PDR_SIZE) != ERROR_OK)
 		return ERROR_FAIL;
 
 	jtag_add_sleep(DELAY_SUBMITPIR);
+	return ERROR_OK;
+}
+
+/* read reg from lakemont core shadow ram, update reg cache if needed */
+static int read_hw_reg(struct target *t, int reg, uint32_t *regval, uint8_t cache)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	struct lakemont_core_reg *arch_info;
+	arch_info = x86_32->cache->reg_list[reg].arch_info;
+	int err = queue_read_hw_reg(t, reg, scan.out);
+	x86_32->flush = 1;
+	if (err != ERROR_OK)
+		return err;
+	err = jtag_execute_queue();
+	if (err != ERROR_OK) {
+		LOG_ERROR("%s failed to execute queue", __func__);
+		return err;
+	}
+
 	*regval = buf_get_u32(scan.out, 0, 32);
 	if (cache) {
 		buf_set_u32(x86_32->cache->reg_list[reg].value, 0, 32, *regval);
@@ -682,6 +736,8 @@ static int write_hw_reg(struct target *t, int reg, uint32_t regval, uint8_t cach
 			arch_info->op,
 			regval);
 
+	/* the caller may be batching writes already, flush as it asked */
+	int flush = x86_32->flush;
 	x86_32->flush = 0; /* don't flush scans till we have a batch */
 	if (submit_reg_pir(t, reg) != ERROR_OK)
 		return ERROR_FAIL;
@@ -692,7 +748,7 @@ static int write_hw_reg(struct target *t, int reg, uint32_t regval, uint8_t cach
 		return ERROR_FAIL;
 	if (drscan(t, reg_buf, scan.out, PDR_SIZE) != ERROR_OK)
 		return ERROR_FAIL;
-	x86_32->flush = 1;
+	x86_32->flush = flush;
 	if (submit_instruction_pir(t, PDR2SRAM) != ERROR_OK)
 		return ERROR_FAIL;
 
@@ -262,6 +262,35 @@ static int mem_ap_write_memory(struct target *target, target_addr_t address,
 	return mem_ap_write_buf(mem_ap->ap, buffer, size, count, address);
 }
 
+static int mem_ap_queue_read_memory(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	struct mem_ap *mem_ap = target->arch_info;
+
+	if (count == 0 || !buffer)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	return mem_ap_read_buf_queued(mem_ap->ap, buffer, size, count, address);
+}
+
+static int mem_ap_queue_write_memory(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, const uint8_t *buffer)
+{
+	struct mem_ap *mem_ap = target->arch_info;
+
+	if (count == 0 || !buffer)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	return mem_ap_write_buf_queued(mem_ap->ap, buffer, size, count, address);
+}
+
+static int mem_ap_run_queued_memory(struct target *target)
+{
+	struct mem_ap *mem_ap = target->arch_info;
+
+	return mem_ap_run_queued(mem_ap->dap);
+}
+
 struct target_type mem_ap_target = {
 	.name = "mem_ap",
 
@@ -286,4 +315,7 @@ struct target_type mem_ap_target = {
 
 	.read_memory = mem_ap_read_memory,
 	.write_memory = mem_ap_write_memory,
+	.queue_read_memory = mem_ap_queue_read_memory,
+	.queue_write_memory = mem_ap_queue_write_memory,
+	.run_queued_memory = mem_ap_run_queued_memory,
 };
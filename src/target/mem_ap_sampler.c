@@ -0,0 +1,731 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Periodic sampling of memory through a MEM-AP while the target runs.
+ * All the words of all the regions of a sampler are queued on the DAP and
+ * read back with a single run per tick. Each tick produces one binary
+ * record sent to a file or to the clients of a TCP port.
+ */
+
+#define LOG_CATEGORY LOG_CAT_DAP
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <jim.h>
+
+#include <helper/command.h>
+#include <helper/jim-nvp.h>
+#include <helper/list.h>
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include <helper/types.h>
+#include <server/server.h>
+#include <target/arm_adi_v5.h>
+#include <target/target.h>
+#include <transport/transport.h>
+#include "mem_ap_sampler.h"
+
+#define TCP_SERVICE_NAME                "mem_ap_sampler"
+
+#define SAMPLER_DEFAULT_PERIOD_MS       10
+
+/* timestamp in us and sequence number in front of the sampled data */
+#define SAMPLER_RECORD_HEADER_SIZE      12
+
+struct mem_ap_sampler_region {
+	struct list_head lh;
+	target_addr_t address;
+	uint32_t size;
+};
+
+struct mem_ap_sampler_object {
+	struct list_head lh;
+	struct adiv5_mem_ap_spot spot;
+	struct adiv5_ap *ap;
+	char *name;
+	/** regions to sample, in record order */
+	struct list_head regions;
+	/** sum of the region sizes in bytes */
+	uint32_t data_size;
+	/** tick period in ms */
+	unsigned int period_ms;
+	/** where to send the records, a file name or ":port" */
+	char *out_filename;
+	FILE *file;
+	/** track TCP connections */
+	struct list_head connections;
+	bool running;
+	/** per tick buffers, allocated while running */
+	uint32_t *words;
+	uint8_t *record;
+	/** statistics since the last start */
+	uint32_t sequence;
+	uint64_t errors;
+	int64_t start_us;
+};
+
+struct mem_ap_sampler_connection {
+	struct list_head lh;
+	struct connection *connection;
+};
+
+struct mem_ap_sampler_priv_connection {
+	struct mem_ap_sampler_object *obj;
+};
+
+static LIST_HEAD(all_mem_ap_sampler);
+
+static size_t mem_ap_sampler_record_size(struct mem_ap_sampler_object *obj)
+{
+	return SAMPLER_RECORD_HEADER_SIZE + obj->data_size;
+}
+
+static int mem_ap_sampler_tick(void *priv)
+{
+	struct mem_ap_sampler_object *obj = priv;
+	struct mem_ap_sampler_region *region;
+	struct mem_ap_sampler_connection *c;
+	uint32_t *word = obj->words;
+	int retval = ERROR_OK;
+
+	int64_t now = timeval_us();
+
+	list_for_each_entry(region, &obj->regions, lh) {
+		for (uint32_t offset = 0; offset < region->size; offset += 4) {
+			retval = mem_ap_read_u32(obj->ap, region->address + offset, word++);
+			if (retval != ERROR_OK)
+				break;
+		}
+		if (retval != ERROR_OK)
+			break;
+	}
+
+	/* run also a partially queued tick, not to leave it to the next one */
+	int retval_run = dap_run(obj->ap->dap);
+	if (retval == ERROR_OK)
+		retval = retval_run;
+
+	if (retval != ERROR_OK) {
+		/* keep sampling, a running target may block the bus for a while */
+		LOG_DEBUG("%s: sample %" PRIu32 " failed", obj->name, obj->sequence);
+		obj->errors++;
+		obj->sequence++;
+		return ERROR_OK;
+	}
+
+	uint8_t *p = obj->record;
+	h_u64_to_le(p, now - obj->start_us);
+	h_u32_to_le(p + 8, obj->sequence++);
+	p += SAMPLER_RECORD_HEADER_SIZE;
+	for (uint32_t i = 0; i < obj->data_size / 4; i++, p += 4)
+		h_u32_to_le(p, obj->words[i]);
+
+	size_t size = mem_ap_sampler_record_size(obj);
+
+	if (obj->file) {
+		if (fwrite(obj->record, 1, size, obj->file) == size) {
+			fflush(obj->file);
+		} else {
+			LOG_ERROR("Error writing to the sampler destination file");
+			return ERROR_FAIL;
+		}
+	}
+
+	list_for_each_entry(c, &obj->connections, lh)
+		if (connection_write(c->connection, obj->record, size) != (int)size)
+			LOG_ERROR("Error writing to connection");
+
+	return ERROR_OK;
+}
+
+static void mem_ap_sampler_close_output(struct mem_ap_sampler_object *obj)
+{
+	if (obj->file) {
+		fclose(obj->file);
+		obj->file = NULL;
+	}
+	if (obj->out_filename && obj->out_filename[0] == ':')
+		remove_service(TCP_SERVICE_NAME, &obj->out_filename[1]);
+}
+
+static void mem_ap_sampler_stop(struct mem_ap_sampler_object *obj)
+{
+	if (!obj->running)
+		return;
+
+	target_unregister_timer_callback(mem_ap_sampler_tick, obj);
+	mem_ap_sampler_close_output(obj);
+
+	free(obj->words);
+	obj->words = NULL;
+	free(obj->record);
+	obj->record = NULL;
+
+	obj->running = false;
+}
+
+static void mem_ap_sampler_clear_regions(struct mem_ap_sampler_object *obj)
+{
+	struct mem_ap_sampler_region *region, *tmp;
+
+	list_for_each_entry_safe(region, tmp, &obj->regions, lh) {
+		list_del(&region->lh);
+		free(region);
+	}
+	obj->data_size = 0;
+}
+
+int mem_ap_sampler_cleanup_all(void)
+{
+	struct mem_ap_sampler_object *obj, *tmp;
+
+	list_for_each_entry_safe(obj, tmp, &all_mem_ap_sampler, lh) {
+		mem_ap_sampler_stop(obj);
+		mem_ap_sampler_clear_regions(obj);
+
+		if (obj->ap)
+			dap_put_ap(obj->ap);
+
+		free(obj->name);
+		free(obj->out_filename);
+		free(obj);
+	}
+
+	return ERROR_OK;
+}
+
+static int mem_ap_sampler_service_new_connection(struct connection *connection)
+{
+	struct mem_ap_sampler_priv_connection *priv = connection->service->priv;
+	struct mem_ap_sampler_object *obj = priv->obj;
+	struct mem_ap_sampler_connection *c = malloc(sizeof(*c));
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	c->connection = connection;
+	list_add(&c->lh, &obj->connections);
+	return ERROR_OK;
+}
+
+static int mem_ap_sampler_service_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int mem_ap_sampler_service_connection_closed(struct connection *connection)
+{
+	struct mem_ap_sampler_priv_connection *priv = connection->service->priv;
+	struct mem_ap_sampler_object *obj = priv->obj;
+	struct mem_ap_sampler_connection *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &obj->connections, lh)
+		if (c->connection == connection) {
+			list_del(&c->lh);
+			free(c);
+			return ERROR_OK;
+		}
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
+}
+
+static const struct service_driver mem_ap_sampler_service_driver = {
+	.name = TCP_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = mem_ap_sampler_service_new_connection,
+	.input_handler = mem_ap_sampler_service_input,
+	.connection_closed_handler = mem_ap_sampler_service_connection_closed,
+	.keep_client_alive_handler = NULL,
+	.output_overflow = CONNECTION_OVERFLOW_DROP_OLDEST,
+};
+
+enum mem_ap_sampler_cfg_param {
+	CFG_PERIOD,
+	CFG_OUTFILE,
+};
+
+static const struct jim_nvp nvp_mem_ap_sampler_config_opts[] = {
+	{ .name = "-period",        .value = CFG_PERIOD },
+	{ .name = "-output",        .value = CFG_OUTFILE },
+	/* handled by mem_ap_spot, added for jim_getopt_nvp_unknown() */
+	{ .name = "-dap",           .value = -1 },
+	{ .name = "-ap-num",        .value = -1 },
+	{ .name = NULL,             .value = -1 },
+};
+
+static int mem_ap_sampler_configure(struct jim_getopt_info *goi, struct mem_ap_sampler_object *obj)
+{
+	assert(obj);
+
+	if (goi->isconfigure && obj->running) {
+		Jim_SetResultFormatted(goi->interp, "Cannot configure sampler; %s is running!", obj->name);
+		return JIM_ERR;
+	}
+
+	/* parse config or cget options ... */
+	while (goi->argc > 0) {
+		Jim_SetEmptyResult(goi->interp);
+
+		int e = adiv5_jim_mem_ap_spot_configure(&obj->spot, goi);
+		if (e == JIM_OK)
+			continue;
+		if (e == JIM_ERR)
+			return e;
+
+		struct jim_nvp *n;
+		e = jim_getopt_nvp(goi, nvp_mem_ap_sampler_config_opts, &n);
+		if (e != JIM_OK) {
+			jim_getopt_nvp_unknown(goi, nvp_mem_ap_sampler_config_opts, 0);
+			return e;
+		}
+
+		switch (n->value) {
+		case CFG_PERIOD:
+			if (goi->isconfigure) {
+				jim_wide period;
+				e = jim_getopt_wide(goi, &period);
+				if (e != JIM_OK)
+					return e;
+				if (period < 1 || period > UINT16_MAX) {
+					Jim_SetResultString(goi->interp, "Invalid period!", -1);
+					return JIM_ERR;
+				}
+				obj->period_ms = period;
+			} else {
+				if (goi->argc)
+					goto err_no_params;
+				Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, obj->period_ms));
+			}
+			break;
+		case CFG_OUTFILE:
+			if (goi->isconfigure) {
+				const char *s;
+				e = jim_getopt_string(goi, &s, NULL);
+				if (e != JIM_OK)
+					return e;
+				if (s[0] == ':') {
+					char *end;
+					long port = strtol(s + 1, &end, 0);
+					if (port <= 0 || port > UINT16_MAX || *end != '\0') {
+						Jim_SetResultFormatted(goi->interp, "Invalid TCP port \'%s\'", s + 1);
+						return JIM_ERR;
+					}
+				}
+				free(obj->out_filename);
+				obj->out_filename = strdup(s);
+				if (!obj->out_filename) {
+					LOG_ERROR("Out of memory");
+					return JIM_ERR;
+				}
+			} else {
+				if (goi->argc)
+					goto err_no_params;
+				if (obj->out_filename)
+					Jim_SetResult(goi->interp, Jim_NewStringObj(goi->interp, obj->out_filename, -1));
+			}
+			break;
+		}
+	}
+
+	return JIM_OK;
+
+err_no_params:
+	Jim_WrongNumArgs(goi->interp, goi->argc, goi->argv, "NO PARAMS");
+	return JIM_ERR;
+}
+
+static int jim_mem_ap_sampler_configure(Jim_Interp *interp, int argc, Jim_Obj * const *argv)
+{
+	struct command *c = jim_to_command(interp);
+	struct jim_getopt_info goi;
+
+	jim_getopt_setup(&goi, interp, argc - 1, argv + 1);
+	goi.isconfigure = !strcmp(c->name, "configure");
+	if (goi.argc < 1) {
+		Jim_WrongNumArgs(goi.interp, goi.argc, goi.argv,
+			"missing: -option ...");
+		return JIM_ERR;
+	}
+	struct mem_ap_sampler_object *obj = c->jim_handler_data;
+	return mem_ap_sampler_configure(&goi, obj);
+}
+
+COMMAND_HANDLER(handle_mem_ap_sampler_add)
+{
+	struct mem_ap_sampler_object *obj = CMD_DATA;
+	target_addr_t address;
+	uint32_t size;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (obj->running) {
+		command_print(CMD, "Cannot add a region; %s is running", obj->name);
+		return ERROR_FAIL;
+	}
+
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+
+	if (!size || (address & 3) || (size & 3)) {
+		command_print(CMD, "Address and size must be non zero multiples of 4");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (size > UINT32_MAX - SAMPLER_RECORD_HEADER_SIZE - obj->data_size) {
+		command_print(CMD, "Sampled data too large");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct mem_ap_sampler_region *region = malloc(sizeof(*region));
+	if (!region) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	region->address = address;
+	region->size = size;
+	list_add_tail(&region->lh, &obj->regions);
+	obj->data_size += size;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_mem_ap_sampler_clear)
+{
+	struct mem_ap_sampler_object *obj = CMD_DATA;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (obj->running) {
+		command_print(CMD, "Cannot clear the regions; %s is running", obj->name);
+		return ERROR_FAIL;
+	}
+
+	mem_ap_sampler_clear_regions(obj);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_mem_ap_sampler_info)
+{
+	struct mem_ap_sampler_object *obj = CMD_DATA;
+	struct mem_ap_sampler_region *region;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD, "%s: %s, period %u ms, output %s",
+		obj->name, obj->running ? "running" : "stopped", obj->period_ms,
+		obj->out_filename ? obj->out_filename : "none");
+	list_for_each_entry(region, &obj->regions, lh)
+		command_print(CMD, "  " TARGET_ADDR_FMT " %" PRIu32 " bytes",
+			region->address, region->size);
+	command_print(CMD, "record size %zu bytes, %" PRIu32 " samples, %" PRIu64 " failed",
+		mem_ap_sampler_record_size(obj), obj->sequence, obj->errors);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_mem_ap_sampler_start)
+{
+	struct mem_ap_sampler_object *obj = CMD_DATA;
+	int retval;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (obj->running)
+		return ERROR_OK;
+
+	if (transport_is_hla()) {
+		command_print(CMD, "Sampler is not supported with hla transport");
+		return ERROR_FAIL;
+	}
+
+	if (list_empty(&obj->regions)) {
+		command_print(CMD, "No region to sample");
+		return ERROR_FAIL;
+	}
+
+	if (!obj->out_filename) {
+		command_print(CMD, "No output configured");
+		return ERROR_FAIL;
+	}
+
+	if (!obj->ap) {
+		obj->ap = dap_get_ap(obj->spot.dap, obj->spot.ap_num);
+		if (!obj->ap) {
+			command_print(CMD, "Cannot get AP");
+			return ERROR_FAIL;
+		}
+	}
+
+	obj->words = malloc(obj->data_size);
+	obj->record = malloc(mem_ap_sampler_record_size(obj));
+	if (!obj->words || !obj->record) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto error_exit;
+	}
+
+	if (obj->out_filename[0] == ':') {
+		struct mem_ap_sampler_priv_connection *priv = malloc(sizeof(*priv));
+		if (!priv) {
+			LOG_ERROR("Out of memory");
+			retval = ERROR_FAIL;
+			goto error_exit;
+		}
+		priv->obj = obj;
+		LOG_INFO("starting sampler server for %s on %s", obj->name, &obj->out_filename[1]);
+		retval = add_service(&mem_ap_sampler_service_driver, &obj->out_filename[1],
+			CONNECTION_LIMIT_UNLIMITED, priv);
+		if (retval != ERROR_OK) {
+			command_print(CMD, "Can't configure sampler TCP port %s", &obj->out_filename[1]);
+			goto error_exit;
+		}
+	} else {
+		obj->file = fopen(obj->out_filename, "ab");
+		if (!obj->file) {
+			command_print(CMD, "Can't open sampler destination file \"%s\"", obj->out_filename);
+			retval = ERROR_FAIL;
+			goto error_exit;
+		}
+	}
+
+	obj->sequence = 0;
+	obj->errors = 0;
+	obj->start_us = timeval_us();
+
+	retval = target_register_timer_callback(mem_ap_sampler_tick, obj->period_ms,
+		TARGET_TIMER_TYPE_PERIODIC, obj);
+	if (retval != ERROR_OK) {
+		mem_ap_sampler_close_output(obj);
+		goto error_exit;
+	}
+
+	obj->running = true;
+	return ERROR_OK;
+
+error_exit:
+	free(obj->words);
+	obj->words = NULL;
+	free(obj->record);
+	obj->record = NULL;
+	return retval;
+}
+
+COMMAND_HANDLER(handle_mem_ap_sampler_stop)
+{
+	struct mem_ap_sampler_object *obj = CMD_DATA;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	mem_ap_sampler_stop(obj);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration mem_ap_sampler_instance_command_handlers[] = {
+	{
+		.name = "configure",
+		.mode = COMMAND_ANY,
+		.jim_handler = jim_mem_ap_sampler_configure,
+		.help  = "configure the sampler",
+		.usage = "[attribute value ...]",
+	},
+	{
+		.name = "cget",
+		.mode = COMMAND_ANY,
+		.jim_handler = jim_mem_ap_sampler_configure,
+		.help  = "returns the specified sampler attribute",
+		.usage = "attribute",
+	},
+	{
+		.name = "add",
+		.mode = COMMAND_ANY,
+		.handler = handle_mem_ap_sampler_add,
+		.help = "add a memory region to the sampled ones",
+		.usage = "address size",
+	},
+	{
+		.name = "clear",
+		.mode = COMMAND_ANY,
+		.handler = handle_mem_ap_sampler_clear,
+		.help = "remove all the sampled memory regions",
+		.usage = "",
+	},
+	{
+		.name = "info",
+		.mode = COMMAND_ANY,
+		.handler = handle_mem_ap_sampler_info,
+		.help = "display the sampler configuration and statistics",
+		.usage = "",
+	},
+	{
+		.name = "start",
+		.mode = COMMAND_EXEC,
+		.handler = handle_mem_ap_sampler_start,
+		.help = "start sampling",
+		.usage = "",
+	},
+	{
+		.name = "stop",
+		.mode = COMMAND_EXEC,
+		.handler = handle_mem_ap_sampler_stop,
+		.help = "stop sampling",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static int mem_ap_sampler_create(Jim_Interp *interp, struct mem_ap_sampler_object *obj)
+{
+	struct command_context *cmd_ctx;
+	Jim_Cmd *cmd;
+	int e;
+
+	cmd_ctx = current_command_context(interp);
+	assert(cmd_ctx);
+
+	/* does this command exist? */
+	cmd = Jim_GetCommand(interp, Jim_NewStringObj(interp, obj->name, -1), JIM_NONE);
+	if (cmd) {
+		Jim_SetResultFormatted(interp, "cannot create sampler because a command with name '%s' already exists",
+			obj->name);
+		return JIM_ERR;
+	}
+
+	/* now - create the new sampler name command */
+	const struct command_registration obj_commands[] = {
+		{
+			.name = obj->name,
+			.mode = COMMAND_ANY,
+			.help = "sampler instance command group",
+			.usage = "",
+			.chain = mem_ap_sampler_instance_command_handlers,
+		},
+		COMMAND_REGISTRATION_DONE
+	};
+	e = register_commands_with_data(cmd_ctx, NULL, obj_commands, obj);
+	if (e != ERROR_OK)
+		return JIM_ERR;
+
+	list_add_tail(&obj->lh, &all_mem_ap_sampler);
+
+	return JIM_OK;
+}
+
+static int jim_mem_ap_sampler_create(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
+{
+	struct jim_getopt_info goi;
+	jim_getopt_setup(&goi, interp, argc - 1, argv + 1);
+	if (goi.argc < 1) {
+		Jim_WrongNumArgs(interp, 1, argv, "name ?option option ...?");
+		return JIM_ERR;
+	}
+
+	struct mem_ap_sampler_object *obj = calloc(1, sizeof(struct mem_ap_sampler_object));
+	if (!obj) {
+		LOG_ERROR("Out of memory");
+		return JIM_ERR;
+	}
+	INIT_LIST_HEAD(&obj->regions);
+	INIT_LIST_HEAD(&obj->connections);
+	adiv5_mem_ap_spot_init(&obj->spot);
+	obj->period_ms = SAMPLER_DEFAULT_PERIOD_MS;
+
+	Jim_Obj *n;
+	jim_getopt_obj(&goi, &n);
+	obj->name = strdup(Jim_GetString(n, NULL));
+	if (!obj->name) {
+		LOG_ERROR("Out of memory");
+		free(obj);
+		return JIM_ERR;
+	}
+
+	/* Do the rest as "configure" options */
+	goi.isconfigure = 1;
+	int e = mem_ap_sampler_configure(&goi, obj);
+	if (e != JIM_OK)
+		goto err_exit;
+
+	if (!obj->spot.dap || obj->spot.ap_num == DP_APSEL_INVALID) {
+		Jim_SetResultString(goi.interp, "-dap and -ap-num required when creating sampler", -1);
+		goto err_exit;
+	}
+
+	e = mem_ap_sampler_create(goi.interp, obj);
+	if (e != JIM_OK)
+		goto err_exit;
+
+	return JIM_OK;
+
+err_exit:
+	free(obj->name);
+	free(obj->out_filename);
+	free(obj);
+	return JIM_ERR;
+}
+
+COMMAND_HANDLER(handle_mem_ap_sampler_names)
+{
+	struct mem_ap_sampler_object *obj;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	list_for_each_entry(obj, &all_mem_ap_sampler, lh)
+		command_print(CMD, "%s", obj->name);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration mem_ap_sampler_subcommand_handlers[] = {
+	{
+		.name = "create",
+		.mode = COMMAND_ANY,
+		.jim_handler = jim_mem_ap_sampler_create,
+		.usage = "name -dap dap -ap-num num [-period ms] [-output (filename | :port)]",
+		.help = "Creates a new MEM-AP sampler object",
+	},
+	{
+		.name = "names",
+		.mode = COMMAND_ANY,
+		.handler = handle_mem_ap_sampler_names,
+		.usage = "",
+		.help = "Lists all registered sampler objects by name",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration mem_ap_sampler_command_handlers[] = {
+	{
+		.name = "sampler",
+		.chain = mem_ap_sampler_subcommand_handlers,
+		.usage = "",
+		.help = "MEM-AP sampler command group",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int mem_ap_sampler_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, mem_ap_sampler_command_handlers);
+}
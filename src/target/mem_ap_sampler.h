@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_MEM_AP_SAMPLER_H
+#define OPENOCD_TARGET_MEM_AP_SAMPLER_H
+
+int mem_ap_sampler_register_commands(struct command_context *cmd_ctx);
+int mem_ap_sampler_cleanup_all(void);
+
+#endif /* OPENOCD_TARGET_MEM_AP_SAMPLER_H */
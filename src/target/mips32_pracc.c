@@ -463,6 +463,10 @@ static int mips32_pracc_read_u32(struct mips_ejtag *ejtag_info, uint32_t addr, u
 	return ctx.retval;
 }
 
+/* A read takes up to 3 instructions per word: lui, load and store, plus 6 to restore $8, $9 and return */
+#define PRACC_READ_WORD_CODE	3
+#define PRACC_READ_TAIL_CODE	6
+
 int mips32_pracc_read_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int size, int count, void *buf)
 {
 	if (count == 1 && size == 4)
@@ -473,7 +477,7 @@ int mips32_pracc_read_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int size
 
 	uint32_t *data = NULL;
 	if (size != 4) {
-		data = malloc(256 * sizeof(uint32_t));
+		data = malloc(PRACC_MAX_INSTRUCTIONS / 2 * sizeof(uint32_t));
 		if (!data) {
 			LOG_ERROR("Out of memory");
 			goto exit;
@@ -488,13 +492,16 @@ int mips32_pracc_read_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int size
 		ctx.code_count = 0;
 		ctx.store_count = 0;
 
-		int this_round_count = (count > 256) ? 256 : count;
+		int this_round_count = 0;
 		uint32_t last_upper_base_addr = UPPER16((addr + 0x8000));
 
 		pracc_add(&ctx, 0, MIPS32_LUI(ctx.isa, 15, PRACC_UPPER_BASE_ADDR)); /* $15 = MIPS32_PRACC_BASE_ADDR */
 		pracc_add(&ctx, 0, MIPS32_LUI(ctx.isa, 9, last_upper_base_addr));	/* upper memory addr to $9 */
 
-		for (int i = 0; i != this_round_count; i++) {			/* Main code loop */
+		/* Main code loop, as many words as the pracc text can take */
+		while (this_round_count != count &&
+				ctx.code_count + PRACC_READ_WORD_CODE + PRACC_READ_TAIL_CODE <= (int)PRACC_MAX_INSTRUCTIONS) {
+			int i = this_round_count++;
 			uint32_t upper_base_addr = UPPER16((addr + 0x8000));
 			if (last_upper_base_addr != upper_base_addr) {	/* if needed, change upper addr in $9 */
 				pracc_add(&ctx, 0, MIPS32_LUI(ctx.isa, 9, upper_base_addr));
@@ -662,7 +669,6 @@ static int mips32_pracc_synchronize_cache(struct mips_ejtag *ejtag_info,
 	ctx.code_count = 0;
 	ctx.store_count = 0;
 
-	int count = 0;
 	uint32_t last_upper_base_addr = UPPER16((start_addr + 0x8000));
 
 	pracc_add(&ctx, 0, MIPS32_LUI(ctx.isa, 15, last_upper_base_addr)); /* load upper memory base addr to $15 */
@@ -685,8 +691,9 @@ static int mips32_pracc_synchronize_cache(struct mips_ejtag *ejtag_info,
 							LOWER16(start_addr), 15));
 		}
 		start_addr += clsiz;
-		count++;
-		if (count == 256 && start_addr <= end_addr) {			/* more ?, then execute code list */
+		/* pracc text full (room for a line, the jump back and the final sync) and more ?,
+		 * then execute code list */
+		if (ctx.code_count + 3 + 3 > (int)PRACC_MAX_INSTRUCTIONS && start_addr <= end_addr) {
 			pracc_add(&ctx, 0, MIPS32_B(ctx.isa, NEG16((ctx.code_count + 1) << ctx.isa)));	/* to start */
 			pracc_add(&ctx, 0, MIPS32_NOP);					/* nop in delay slot */
 
@@ -696,7 +703,6 @@ static int mips32_pracc_synchronize_cache(struct mips_ejtag *ejtag_info,
 
 			ctx.code_count = 0;	/* reset counters for another loop */
 			ctx.store_count = 0;
-			count = 0;
 		}
 	}
 	pracc_add(&ctx, 0, MIPS32_SYNC(ctx.isa));
@@ -709,6 +715,10 @@ exit:
 	return ctx.retval;
 }
 
+/* A write takes up to 4 instructions per word: lui, li32 and store, plus 4 to restore $8 and return */
+#define PRACC_WRITE_WORD_CODE	4
+#define PRACC_WRITE_TAIL_CODE	4
+
 static int mips32_pracc_write_mem_generic(struct mips_ejtag *ejtag_info,
 		uint32_t addr, int size, int count, const void *buf)
 {
@@ -723,12 +733,15 @@ static int mips32_pracc_write_mem_generic(struct mips_ejtag *ejtag_info,
 		ctx.code_count = 0;
 		ctx.store_count = 0;
 
-		int this_round_count = (count > 128) ? 128 : count;
+		int this_round_count = 0;
 		uint32_t last_upper_base_addr = UPPER16((addr + 0x8000));
 			      /* load $15 with memory base address */
 		pracc_add(&ctx, 0, MIPS32_LUI(ctx.isa, 15, last_upper_base_addr));
 
-		for (int i = 0; i != this_round_count; i++) {
+		/* as many words as the pracc text can take */
+		while (this_round_count != count &&
+				ctx.code_count + PRACC_WRITE_WORD_CODE + PRACC_WRITE_TAIL_CODE <= (int)PRACC_MAX_INSTRUCTIONS) {
+			this_round_count++;
 			uint32_t upper_base_addr = UPPER16((addr + 0x8000));
 			if (last_upper_base_addr != upper_base_addr) {	/* if needed, change upper address in $15*/
 				pracc_add(&ctx, 0, MIPS32_LUI(ctx.isa, 15, upper_base_addr));
@@ -768,11 +781,10 @@ exit:
 	return ctx.retval;
 }
 
-int mips32_pracc_write_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int size, int count, const void *buf)
+/* Synchronize the caches once for a whole region just written */
+static int mips32_pracc_sync_cache_region(struct mips_ejtag *ejtag_info, uint32_t addr, uint32_t len)
 {
-	int retval = mips32_pracc_write_mem_generic(ejtag_info, addr, size, count, buf);
-	if (retval != ERROR_OK)
-		return retval;
+	int retval = ERROR_OK;
 
 	/**
 	 * If we are in the cacheable region and cache is activated,
@@ -811,7 +823,7 @@ int mips32_pracc_write_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int siz
 	 */
 	if (cached == 3 || cached == 0) {		/* Write back cache or write through cache */
 		uint32_t start_addr = addr;
-		uint32_t end_addr = addr + count * size;
+		uint32_t end_addr = addr + len;
 		uint32_t rel = (conf & MIPS32_CONFIG0_AR_MASK) >> MIPS32_CONFIG0_AR_SHIFT;
 		if (rel > 1) {
 			LOG_DEBUG("Unknown release in cache code");
@@ -823,6 +835,15 @@ int mips32_pracc_write_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int siz
 	return retval;
 }
 
+int mips32_pracc_write_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int size, int count, const void *buf)
+{
+	int retval = mips32_pracc_write_mem_generic(ejtag_info, addr, size, count, buf);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return mips32_pracc_sync_cache_region(ejtag_info, addr, count * size);
+}
+
 int mips32_pracc_write_regs(struct mips_ejtag *ejtag_info, uint32_t *regs)
 {
 	struct pracc_queue_info ctx = {.ejtag_info = ejtag_info};
@@ -1020,5 +1041,9 @@ int mips32_pracc_fastdata_xfer(struct mips_ejtag *ejtag_info, struct working_are
 	if (ejtag_info->pa_addr != MIPS32_PRACC_TEXT)
 		LOG_ERROR("mini program did not return to start");
 
+	/* the handler stores through the caches, like the pracc writes */
+	if (write_t)
+		retval = mips32_pracc_sync_cache_region(ejtag_info, addr, count * 4);
+
 	return retval;
 }
@@ -69,6 +69,157 @@ struct reg *register_get_by_name(struct reg_cache *first,
 	return NULL;
 }
 
+struct reg_name_index_cache {
+	const struct reg_cache *cache;
+	const struct reg *reg_list;
+	unsigned int num_regs;
+};
+
+struct reg_name_index_entry {
+	struct reg *reg;
+	uint32_t hash;
+	/* position of the register cache in the list */
+	unsigned int cache;
+	/* next entry of the bucket + 1, 0 at the end */
+	unsigned int next;
+};
+
+struct reg_name_index {
+	/* the caches indexed, to notice changes of the list */
+	struct reg_name_index_cache *caches;
+	unsigned int num_caches;
+
+	/* first entry of each bucket + 1, 0 if empty */
+	unsigned int *buckets;
+	unsigned int num_buckets;
+	struct reg_name_index_entry *entries;
+};
+
+static uint32_t register_name_hash(const char *name)
+{
+	/* FNV-1a */
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+void register_name_index_free(struct reg_name_index *index)
+{
+	if (!index)
+		return;
+
+	free(index->caches);
+	free(index->buckets);
+	free(index->entries);
+	free(index);
+}
+
+static bool register_name_index_is_current(const struct reg_name_index *index,
+		const struct reg_cache *first)
+{
+	unsigned int i = 0;
+
+	for (const struct reg_cache *cache = first; cache; cache = cache->next, i++) {
+		if (i == index->num_caches)
+			return false;
+		const struct reg_name_index_cache *c = &index->caches[i];
+		if (c->cache != cache || c->reg_list != cache->reg_list || c->num_regs != cache->num_regs)
+			return false;
+	}
+
+	return i == index->num_caches;
+}
+
+static struct reg_name_index *register_name_index_build(struct reg_cache *first)
+{
+	unsigned int num_caches = 0;
+	unsigned int num_regs = 0;
+
+	for (struct reg_cache *cache = first; cache; cache = cache->next) {
+		num_caches++;
+		num_regs += cache->num_regs;
+	}
+
+	struct reg_name_index *index = calloc(1, sizeof(*index));
+	if (!index)
+		return NULL;
+
+	index->num_buckets = 16;
+	while (index->num_buckets < num_regs)
+		index->num_buckets *= 2;
+
+	index->caches = calloc(num_caches, sizeof(*index->caches));
+	index->buckets = calloc(index->num_buckets, sizeof(*index->buckets));
+	index->entries = calloc(num_regs ? num_regs : 1, sizeof(*index->entries));
+	if (!index->caches || !index->buckets || !index->entries) {
+		register_name_index_free(index);
+		return NULL;
+	}
+
+	unsigned int n = 0;
+	for (struct reg_cache *cache = first; cache; cache = cache->next) {
+		struct reg_name_index_cache *c = &index->caches[index->num_caches];
+		c->cache = cache;
+		c->reg_list = cache->reg_list;
+		c->num_regs = cache->num_regs;
+
+		for (unsigned int i = 0; i < cache->num_regs; i++) {
+			struct reg *reg = &cache->reg_list[i];
+			if (!reg->name)
+				continue;
+			struct reg_name_index_entry *entry = &index->entries[n];
+			entry->reg = reg;
+			entry->hash = register_name_hash(reg->name);
+			entry->cache = index->num_caches;
+			n++;
+		}
+		index->num_caches++;
+	}
+
+	/* link the entries backwards, so that buckets are in list order and
+	 * the first register of a name is found first, as by a linear search */
+	while (n--) {
+		struct reg_name_index_entry *entry = &index->entries[n];
+		unsigned int *bucket = &index->buckets[entry->hash & (index->num_buckets - 1)];
+		entry->next = *bucket;
+		*bucket = n + 1;
+	}
+
+	return index;
+}
+
+struct reg *register_get_by_name_indexed(struct reg_name_index **index,
+		struct reg_cache *first, const char *name, bool search_all)
+{
+	if (!*index || !register_name_index_is_current(*index, first)) {
+		register_name_index_free(*index);
+		*index = register_name_index_build(first);
+		if (!*index)
+			return register_get_by_name(first, name, search_all);
+	}
+
+	const struct reg_name_index *idx = *index;
+	uint32_t hash = register_name_hash(name);
+
+	for (unsigned int e = idx->buckets[hash & (idx->num_buckets - 1)]; e;
+			e = idx->entries[e - 1].next) {
+		const struct reg_name_index_entry *entry = &idx->entries[e - 1];
+		if (entry->cache && !search_all)
+			break;
+		if (entry->hash != hash || !entry->reg->exist)
+			continue;
+		if (strcmp(entry->reg->name, name) == 0)
+			return entry->reg;
+	}
+
+	return NULL;
+}
+
 struct reg_cache **register_get_last_cache_p(struct reg_cache **first)
 {
 	struct reg_cache **cache_p = first;
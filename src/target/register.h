@@ -157,6 +157,19 @@ struct reg *register_get_by_number(struct reg_cache *first,
 		uint32_t reg_num, bool search_all);
 struct reg *register_get_by_name(struct reg_cache *first,
 		const char *name, bool search_all);
+
+struct reg_name_index;
+
+/**
+ * Same as register_get_by_name(), using a hash index of the register names
+ * of all caches linked from @a first. The index is built on first use and
+ * rebuilt whenever a cache was linked, unlinked or its register list
+ * replaced. Register names must not change while the index exists.
+ */
+struct reg *register_get_by_name_indexed(struct reg_name_index **index,
+		struct reg_cache *first, const char *name, bool search_all);
+void register_name_index_free(struct reg_name_index *index);
+
 struct reg_cache **register_get_last_cache_p(struct reg_cache **first);
 void register_unlink_cache(struct reg_cache **cache_p, const struct reg_cache *cache);
 void register_cache_invalidate(struct reg_cache *cache);
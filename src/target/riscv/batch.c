@@ -4,6 +4,8 @@
 #include "config.h"
 #endif
 
+#include <helper/event_trace.h>
+
 #include "batch.h"
 #include "debug_defines.h"
 #include "riscv.h"
@@ -15,12 +17,54 @@
 #define DMI_SCAN_MAX_BIT_LENGTH (DTM_DMI_MAX_ADDRESS_LENGTH + DTM_DMI_DATA_LENGTH + DTM_DMI_OP_LENGTH)
 #define DMI_SCAN_BUF_SIZE (DIV_ROUND_UP(DMI_SCAN_MAX_BIT_LENGTH, 8))
 
+/* The number of freed batches a target keeps for reuse. */
+#define RISCV_BATCH_POOL_SIZE	2
+
 static void dump_field(int idle, const struct scan_field *field);
 
+static void riscv_batch_release(struct riscv_batch *batch)
+{
+	free(batch->data_in);
+	free(batch->data_out);
+	free(batch->fields);
+	free(batch->bscan_ctxt);
+	free(batch->read_keys);
+	free(batch);
+}
+
+/* a batch kept by the target with room for the scans, NULL if none */
+static struct riscv_batch *riscv_batch_reuse(struct target *target, size_t scans, size_t idle)
+{
+	struct riscv_info *r = riscv_info(target);
+
+	for (struct riscv_batch **p = &r->batch_pool; *p; p = &(*p)->next) {
+		struct riscv_batch *batch = *p;
+
+		/* the BSCAN tunnel may have been set up since */
+		if (batch->allocated_scans < scans ||
+				!batch->bscan_ctxt != !bscan_tunnel_ir_width)
+			continue;
+
+		*p = batch->next;
+		batch->next = NULL;
+		batch->used_scans = 0;
+		batch->read_keys_used = 0;
+		batch->idle_count = idle;
+		batch->last_scan = RISCV_SCAN_TYPE_INVALID;
+		return batch;
+	}
+
+	return NULL;
+}
+
 struct riscv_batch *riscv_batch_alloc(struct target *target, size_t scans, size_t idle)
 {
 	scans += 4;
-	struct riscv_batch *out = calloc(1, sizeof(*out));
+	struct riscv_batch *out = riscv_batch_reuse(target, scans, idle);
+	if (out)
+		return out;
+
+	out = calloc(1, sizeof(*out));
 	if (!out)
 		goto error0;
 	out->target = target;
@@ -72,12 +116,42 @@ error0:
 
 void riscv_batch_free(struct riscv_batch *batch)
 {
-	free(batch->data_in);
-	free(batch->data_out);
-	free(batch->fields);
-	free(batch->bscan_ctxt);
-	free(batch->read_keys);
-	free(batch);
+	struct riscv_info *r = riscv_info(batch->target);
+	unsigned int kept = 0;
+
+	for (struct riscv_batch *b = r->batch_pool; b; b = b->next)
+		kept++;
+
+	if (kept == RISCV_BATCH_POOL_SIZE) {
+		/* make room by dropping the smallest batch, maybe this one */
+		struct riscv_batch **smallest = &r->batch_pool;
+		for (struct riscv_batch **p = &r->batch_pool; *p; p = &(*p)->next)
+			if ((*p)->allocated_scans < (*smallest)->allocated_scans)
+				smallest = p;
+
+		if ((*smallest)->allocated_scans >= batch->allocated_scans) {
+			riscv_batch_release(batch);
+			return;
+		}
+
+		struct riscv_batch *dropped = *smallest;
+		*smallest = dropped->next;
+		riscv_batch_release(dropped);
+	}
+
+	batch->next = r->batch_pool;
+	r->batch_pool = batch;
+}
+
+void riscv_batch_pool_free(struct target *target)
+{
+	struct riscv_info *r = riscv_info(target);
+
+	while (r->batch_pool) {
+		struct riscv_batch *batch = r->batch_pool;
+		r->batch_pool = batch->next;
+		riscv_batch_release(batch);
+	}
 }
 
 bool riscv_batch_full(struct riscv_batch *batch)
@@ -94,6 +168,8 @@ int riscv_batch_run(struct riscv_batch *batch)
 
 	riscv_batch_add_nop(batch);
 
+	int64_t trace_begin = event_trace_begin();
+
 	for (size_t i = 0; i < batch->used_scans; ++i) {
 		if (bscan_tunnel_ir_width != 0)
 			riscv_add_bscan_tunneled_scan(batch->target, batch->fields+i, batch->bscan_ctxt+i);
@@ -106,7 +182,10 @@ int riscv_batch_run(struct riscv_batch *batch)
 
 	keep_alive();
 
-	if (jtag_execute_queue() != ERROR_OK) {
+	int retval = jtag_execute_queue();
+	event_trace_end(EVENT_TRACE_RISCV_BATCH_RUN, trace_begin, batch->target->coreid,
+			0, batch->used_scans, retval);
+	if (retval != ERROR_OK) {
 		LOG_ERROR("Unable to execute JTAG queue");
 		return ERROR_FAIL;
 	}
@@ -192,7 +271,7 @@ void dump_field(int idle, const struct scan_field *field)
 	static const char * const op_string[] = {"-", "r", "w", "?"};
 	static const char * const status_string[] = {"+", "?", "F", "b"};
 
-	if (debug_level < LOG_LVL_DEBUG)
+	if (!LOG_LEVEL_IS(LOG_LVL_DEBUG))
 		return;
 
 	assert(field->out_value);
@@ -44,14 +44,26 @@ struct riscv_batch {
 	/* The read keys. */
 	size_t *read_keys;
 	size_t read_keys_used;
+
+	/* The next batch kept for reuse by the target. */
+	struct riscv_batch *next;
 };
 
+/* The default, and the limit, of the number of scans of the batches of the
+ * memory accesses, see 'riscv set_batch_scans'. */
+#define RISCV_BATCH_SCANS_MAX	1024
+#define RISCV_BATCH_SCANS_LIMIT	65536
+
 /* Allocates (or frees) a new scan set.  "scans" is the maximum number of JTAG
  * scans that can be issued to this object, and idle is the number of JTAG idle
- * cycles between every real scan. */
+ * cycles between every real scan.  A freed batch is kept by its target, and
+ * handed out again by the next allocation it is large enough for. */
 struct riscv_batch *riscv_batch_alloc(struct target *target, size_t scans, size_t idle);
 void riscv_batch_free(struct riscv_batch *batch);
 
+/* Frees the batches kept by the target. */
+void riscv_batch_pool_free(struct target *target);
+
 /* Checks to see if this batch is full. */
 bool riscv_batch_full(struct riscv_batch *batch);
 
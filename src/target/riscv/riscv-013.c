@@ -22,6 +22,7 @@
 #include "target/breakpoints.h"
 #include "helper/time_support.h"
 #include "helper/list.h"
+#include "helper/event_trace.h"
 #include "riscv.h"
 #include "debug_defines.h"
 #include "rtos/rtos.h"
@@ -33,6 +34,8 @@ static int riscv013_on_step_or_resume(struct target *target, bool step);
 static int riscv013_step_or_resume_current_hart(struct target *target,
 		bool step, bool use_hasel);
 static void riscv013_clear_abstract_error(struct target *target);
+static int select_all_harts(struct target *target, bool *use_hasel);
+static int batch_run(const struct target *target, struct riscv_batch *batch);
 
 /* Implementations of the functions in struct riscv_info. */
 static int riscv013_get_register(struct target *target,
@@ -124,6 +127,9 @@ struct trigger {
 	int unique_id;
 };
 
+/* The hawindow registers remembered per DM, enough for 128 harts. */
+#define HAWINDOW_CACHE_SIZE	4
+
 typedef enum {
 	YNM_MAYBE,
 	YNM_YES,
@@ -143,6 +149,11 @@ typedef struct {
 	/* The currently selected hartid on this DM. */
 	int current_hartid;
 	bool hasel_supported;
+	/* The last hawindowsel and hawindow written, to not write them again
+	 * when the same harts are halted and resumed together. */
+	int hawindowsel;
+	bool hawindow_valid;
+	uint32_t hawindow_cache[HAWINDOW_CACHE_SIZE];
 
 	/* The program buffer stores executable code. 0 is an illegal instruction,
 	 * so we use 0 to mean the cached value is invalid. */
@@ -154,6 +165,29 @@ typedef struct {
 	struct target *target;
 } target_list_t;
 
+/* The run-test/idle delays, each grown on the busy responses of its kind of
+ * access. */
+enum busy_delay_class {
+	BUSY_DELAY_DMI,
+	BUSY_DELAY_ABSTRACT,
+	BUSY_DELAY_PROGBUF,
+	BUSY_DELAY_SB_READ,
+	BUSY_DELAY_SB_WRITE,
+	BUSY_DELAY_CLASSES
+};
+
+/* A delay is lowered after this many accesses without a busy response. */
+#define BUSY_DELAY_DECAY_RUN	1000
+
+struct busy_delay_stats {
+	/* busy responses, and times the delay was lowered */
+	uint64_t busy;
+	uint64_t decays;
+	/* accesses without a busy response since the last change */
+	unsigned int run;
+	unsigned int peak;
+};
+
 typedef struct {
 	/* The indexed used to address this hart in its DM. */
 	unsigned index;
@@ -191,6 +225,12 @@ typedef struct {
 	 * go low. */
 	unsigned int ac_busy_delay;
 
+	/* The same for the program buffer runs of the memory accesses, started by
+	 * the reads and writes of data0 with abstractauto set. */
+	unsigned int progbuf_busy_delay;
+
+	struct busy_delay_stats busy_stats[BUSY_DELAY_CLASSES];
+
 	bool abstract_read_csr_supported;
 	bool abstract_write_csr_supported;
 	bool abstract_read_fpr_supported;
@@ -213,6 +253,20 @@ typedef struct {
 
 	/* DM that provides access to this target. */
 	dm013_info_t *dm;
+
+	/* Number of scans of the next batch of a memory access, 0 until the
+	 * first one. */
+	unsigned int batch_scans;
+
+	/* The GPRs the memory accesses use as scratch are restored when the hart
+	 * resumes or steps, not after each access: the bits of the GPRs whose
+	 * value for the debugged program is not on the hart but here. */
+	uint32_t clobbered_gprs;
+	uint64_t saved_gprs[32];
+
+	/* The fence before a memory read through the program buffer was done,
+	 * and the hart didn't run, nor was the memory written, since. */
+	bool fenced;
 } riscv013_info_t;
 
 static LIST_HEAD(dm_list);
@@ -255,6 +309,7 @@ static dm013_info_t *get_dm(struct target *target)
 		dm->abs_chain_position = abs_chain_position;
 		dm->current_hartid = -1;
 		dm->hart_count = -1;
+		dm->hawindowsel = -1;
 		INIT_LIST_HEAD(&dm->target_list);
 		list_add(&dm->list, &dm_list);
 	}
@@ -374,7 +429,7 @@ static void dump_field(int idle, const struct scan_field *field)
 	static const char * const op_string[] = {"-", "r", "w", "?"};
 	static const char * const status_string[] = {"+", "?", "F", "b"};
 
-	if (debug_level < LOG_LVL_DEBUG)
+	if (!LOG_LEVEL_IS(LOG_LVL_DEBUG))
 		return;
 
 	uint64_t out = buf_get_u64(field->out_value, 0, field->num_bits);
@@ -447,13 +502,78 @@ static uint32_t dtmcontrol_scan(struct target *target, uint32_t out)
 	return in;
 }
 
-static void increase_dmi_busy_delay(struct target *target)
+static const char * const busy_delay_names[BUSY_DELAY_CLASSES] = {
+	[BUSY_DELAY_DMI] = "dmi",
+	[BUSY_DELAY_ABSTRACT] = "abstract",
+	[BUSY_DELAY_PROGBUF] = "progbuf",
+	[BUSY_DELAY_SB_READ] = "sb_read",
+	[BUSY_DELAY_SB_WRITE] = "sb_write",
+};
+
+static unsigned int *busy_delay(riscv013_info_t *info, enum busy_delay_class class)
+{
+	switch (class) {
+	case BUSY_DELAY_DMI:
+		return &info->dmi_busy_delay;
+	case BUSY_DELAY_ABSTRACT:
+		return &info->ac_busy_delay;
+	case BUSY_DELAY_PROGBUF:
+		return &info->progbuf_busy_delay;
+	case BUSY_DELAY_SB_READ:
+		return &info->bus_master_read_delay;
+	case BUSY_DELAY_SB_WRITE:
+	default:
+		return &info->bus_master_write_delay;
+	}
+}
+
+static void increase_busy_delay(const struct target *target, enum busy_delay_class class)
 {
 	riscv013_info_t *info = get_info(target);
-	info->dmi_busy_delay += info->dmi_busy_delay / 10 + 1;
-	LOG_DEBUG("dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d",
-			info->dtmcs_idle, info->dmi_busy_delay,
-			info->ac_busy_delay);
+	struct busy_delay_stats *stats = &info->busy_stats[class];
+	unsigned int *delay = busy_delay(info, class);
+
+	*delay += *delay / 10 + 1;
+	stats->busy++;
+	stats->run = 0;
+	stats->peak = MAX(stats->peak, *delay);
+	LOG_DEBUG("%s busy: dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d, "
+			"progbuf_busy_delay=%d, bus_master_read_delay=%d, "
+			"bus_master_write_delay=%d", busy_delay_names[class],
+			info->dtmcs_idle, info->dmi_busy_delay, info->ac_busy_delay,
+			info->progbuf_busy_delay, info->bus_master_read_delay,
+			info->bus_master_write_delay);
+}
+
+/*
+ * The delays grow on the busy responses, a slow access (e.g. to a slow
+ * peripheral) would slow the later ones for good. After a run of accesses
+ * without a busy response, a delay is lowered by the step it grows by; a
+ * delay the target does need costs a busy response per run.
+ */
+static void busy_delay_success(const struct target *target, enum busy_delay_class class,
+		unsigned int accesses)
+{
+	riscv013_info_t *info = get_info(target);
+	struct busy_delay_stats *stats = &info->busy_stats[class];
+	unsigned int *delay = busy_delay(info, class);
+
+	stats->run += accesses;
+	if (stats->run < BUSY_DELAY_DECAY_RUN)
+		return;
+
+	stats->run = 0;
+	if (*delay == 0)
+		return;
+
+	*delay -= *delay / 10 + 1;
+	stats->decays++;
+	LOG_DEBUG("%s busy delay lowered to %d", busy_delay_names[class], *delay);
+}
+
+static void increase_dmi_busy_delay(struct target *target)
+{
+	increase_busy_delay(target, BUSY_DELAY_DMI);
 
 	dtmcontrol_scan(target, DTM_DTMCS_DMIRESET);
 }
@@ -462,6 +582,19 @@ static void increase_dmi_busy_delay(struct target *target)
  * exec: If this is set, assume the scan results in an execution, so more
  * run-test/idle cycles may be required.
  */
+static void dmi_trace(struct target *target, int64_t begin, dmi_op_t op,
+		uint32_t address, uint32_t data, int status)
+{
+	enum event_trace_type type = EVENT_TRACE_RISCV_DMI_NOP;
+
+	if (op == DMI_OP_READ)
+		type = EVENT_TRACE_RISCV_DMI_READ;
+	else if (op == DMI_OP_WRITE)
+		type = EVENT_TRACE_RISCV_DMI_WRITE;
+
+	event_trace_end(type, begin, target->coreid, address, data, status);
+}
+
 static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 		uint32_t *data_in, dmi_op_t op, uint32_t address_out, uint32_t data_out,
 		bool exec)
@@ -484,6 +617,7 @@ static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 		if (r->reset_delays_wait < 0) {
 			info->dmi_busy_delay = 0;
 			info->ac_busy_delay = 0;
+			info->progbuf_busy_delay = 0;
 		}
 	}
 
@@ -492,6 +626,8 @@ static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 
 	assert(info->abits != 0);
 
+	int64_t trace_begin = event_trace_begin();
+
 	buf_set_u32(out, DTM_DMI_OP_OFFSET, DTM_DMI_OP_LENGTH, op);
 	buf_set_u32(out, DTM_DMI_DATA_OFFSET, DTM_DMI_DATA_LENGTH, data_out);
 	buf_set_u32(out, DTM_DMI_ADDRESS_OFFSET, info->abits, address_out);
@@ -518,6 +654,7 @@ static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 
 	int retval = jtag_execute_queue();
 	if (retval != ERROR_OK) {
+		dmi_trace(target, trace_begin, op, address_out, data_out, retval);
 		LOG_ERROR("dmi_scan failed jtag scan");
 		if (data_in)
 			*data_in = ~0;
@@ -535,7 +672,21 @@ static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 	if (address_in)
 		*address_in = buf_get_u32(in, DTM_DMI_ADDRESS_OFFSET, info->abits);
 	dump_field(idle_count, &field);
-	return buf_get_u32(in, DTM_DMI_OP_OFFSET, DTM_DMI_OP_LENGTH);
+
+	dmi_status_t status = buf_get_u32(in, DTM_DMI_OP_OFFSET, DTM_DMI_OP_LENGTH);
+	if (status == DMI_STATUS_SUCCESS)
+		busy_delay_success(target, BUSY_DELAY_DMI, 1);
+	if (event_trace_enabled) {
+		if (status == DMI_STATUS_BUSY)
+			retval = ERROR_WAIT;
+		else if (status != DMI_STATUS_SUCCESS)
+			retval = ERROR_FAIL;
+		dmi_trace(target, trace_begin, op, address_out,
+				op == DMI_OP_WRITE ? data_out
+					: buf_get_u32(in, DTM_DMI_DATA_OFFSET, DTM_DMI_DATA_LENGTH),
+				retval);
+	}
+	return status;
 }
 
 /**
@@ -708,11 +859,7 @@ static int dmstatus_read(struct target *target, uint32_t *dmstatus,
 
 static void increase_ac_busy_delay(struct target *target)
 {
-	riscv013_info_t *info = get_info(target);
-	info->ac_busy_delay += info->ac_busy_delay / 10 + 1;
-	LOG_DEBUG("dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d",
-			info->dtmcs_idle, info->dmi_busy_delay,
-			info->ac_busy_delay);
+	increase_busy_delay(target, BUSY_DELAY_ABSTRACT);
 }
 
 static uint32_t __attribute__((unused)) abstract_register_size(unsigned width)
@@ -770,7 +917,7 @@ static int wait_for_idle(struct target *target, uint32_t *abstractcs)
 static int execute_abstract_command(struct target *target, uint32_t command)
 {
 	RISCV013_INFO(info);
-	if (debug_level >= LOG_LVL_DEBUG) {
+	if (LOG_LEVEL_IS(LOG_LVL_DEBUG)) {
 		switch (get_field(command, DM_COMMAND_CMDTYPE)) {
 			case 0:
 				LOG_DEBUG("command=0x%x; access register, size=%d, postexec=%d, "
@@ -797,11 +944,16 @@ static int execute_abstract_command(struct target *target, uint32_t command)
 	info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
 	if (info->cmderr != 0 || result != ERROR_OK) {
 		LOG_DEBUG("command 0x%x failed; abstractcs=0x%x", command, abstractcs);
+		/* issued before the previous one completed */
+		if (info->cmderr == CMDERR_BUSY)
+			increase_ac_busy_delay(target);
 		/* Clear the error. */
 		dmi_write(target, DM_ABSTRACTCS, DM_ABSTRACTCS_CMDERR);
 		return ERROR_FAIL;
 	}
 
+	busy_delay_success(target, BUSY_DELAY_ABSTRACT, 1);
+
 	return ERROR_OK;
 }
 
@@ -1299,6 +1451,10 @@ static int register_write_direct(struct target *target, unsigned number,
 
 	int result = register_write_abstract(target, number, value,
 			register_size(target, number));
+	if (result == ERROR_OK && number <= GDB_REGNO_XPR31) {
+		RISCV013_INFO(info);
+		info->clobbered_gprs &= ~(1u << number);
+	}
 	if (result == ERROR_OK || !has_sufficient_progbuf(target, 2) ||
 			!riscv_is_halted(target))
 		return result;
@@ -1391,10 +1547,16 @@ static int register_write_direct(struct target *target, unsigned number,
 /** Read register value from the target. Also update the cached value. */
 static int register_read(struct target *target, uint64_t *value, uint32_t number)
 {
+	RISCV013_INFO(info);
+
 	if (number == GDB_REGNO_ZERO) {
 		*value = 0;
 		return ERROR_OK;
 	}
+	if (number <= GDB_REGNO_XPR31 && (info->clobbered_gprs & (1u << number))) {
+		*value = info->saved_gprs[number];
+		return ERROR_OK;
+	}
 	int result = register_read_direct(target, value, number);
 	if (result != ERROR_OK)
 		return ERROR_FAIL;
@@ -1405,6 +1567,37 @@ static int register_read(struct target *target, uint64_t *value, uint32_t number
 	return ERROR_OK;
 }
 
+/* Restores a GPR a memory access used as scratch, only when the hart resumes
+ * or steps: the next memory accesses don't need to save it again. */
+static void register_restore_lazily(struct target *target, uint32_t number,
+		uint64_t value)
+{
+	RISCV013_INFO(info);
+
+	info->saved_gprs[number] = value;
+	info->clobbered_gprs |= 1u << number;
+	if (target->reg_cache) {
+		struct reg *reg = &target->reg_cache->reg_list[number];
+		buf_set_u64(reg->value, 0, reg->size, value);
+	}
+}
+
+/* Writes back the GPRs restored lazily. */
+static int register_restore_flush(struct target *target)
+{
+	RISCV013_INFO(info);
+
+	for (unsigned int number = GDB_REGNO_ZERO + 1; number <= GDB_REGNO_XPR31; number++) {
+		if (!(info->clobbered_gprs & (1u << number)))
+			continue;
+		/* clears the bit */
+		if (register_write_direct(target, number, info->saved_gprs[number]) != ERROR_OK)
+			return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
 /** Actually read registers from the target right now. */
 static int register_read_direct(struct target *target, uint64_t *value, uint32_t number)
 {
@@ -1522,6 +1715,14 @@ static void deinit_target(struct target *target)
 	if (!info)
 		return;
 
+	/* leave the debugged program its GPRs */
+	if (target_was_examined(target) && get_info(target)->clobbered_gprs) {
+		if (riscv_select_current_hart(target) != ERROR_OK ||
+				register_restore_flush(target) != ERROR_OK)
+			LOG_WARNING("[%s] couldn't restore the scratch registers",
+					target_name(target));
+	}
+
 	free(info->version_specific);
 	/* TODO: free register arch_info */
 	info->version_specific = NULL;
@@ -1581,6 +1782,8 @@ static int examine(struct target *target)
 	riscv013_info_t *info = get_info(target);
 	/* TODO: This won't be true if there are multiple DMs. */
 	info->index = target->coreid;
+	info->clobbered_gprs = 0;
+	info->fenced = false;
 	info->abits = get_field(dtmcontrol, DTM_DTMCS_ABITS);
 	info->dtmcs_idle = get_field(dtmcontrol, DTM_DTMCS_IDLE);
 
@@ -1592,6 +1795,8 @@ static int examine(struct target *target)
 		dmi_write(target, DM_DMCONTROL, 0);
 		dmi_write(target, DM_DMCONTROL, DM_DMCONTROL_DMACTIVE);
 		dm->was_reset = true;
+		dm->hawindowsel = -1;
+		dm->hawindow_valid = false;
 	}
 
 	dmi_write(target, DM_DMCONTROL, DM_DMCONTROL_HARTSELLO |
@@ -1867,6 +2072,27 @@ static unsigned riscv013_data_bits(struct target *target)
 	return 32;
 }
 
+static COMMAND_HELPER(riscv013_print_stats, struct target *target)
+{
+	RISCV013_INFO(info);
+
+	/* Same format as 'riscv info', for "array set". */
+	for (unsigned int i = 0; i < BUSY_DELAY_CLASSES; i++) {
+		const struct busy_delay_stats *stats = &info->busy_stats[i];
+		char key[80];
+
+		riscv_print_info_line(CMD, busy_delay_names[i], "delay",
+				*busy_delay(info, i));
+		riscv_print_info_line(CMD, busy_delay_names[i], "peak", stats->peak);
+		snprintf(key, sizeof(key), "%s.busy", busy_delay_names[i]);
+		command_print(CMD, "%-21s %3" PRIu64, key, stats->busy);
+		snprintf(key, sizeof(key), "%s.decays", busy_delay_names[i]);
+		command_print(CMD, "%-21s %3" PRIu64, key, stats->decays);
+	}
+
+	return 0;
+}
+
 static COMMAND_HELPER(riscv013_print_info, struct target *target)
 {
 	RISCV013_INFO(info);
@@ -1946,6 +2172,111 @@ static int cleanup_after_vector_access(struct target *target, uint64_t vtype,
 	return ERROR_OK;
 }
 
+/*
+ * Read the elements of a vector register in a batch, an abstract command that
+ * transfers s0 and executes the next vmv.x.s/vslide1down per element. s1
+ * counts the slides, to finish the rotation of the register if the batch
+ * fails. *done is false if the register is to be read the slow way.
+ */
+static int read_vector_register_batch(struct target *target, uint8_t *value,
+		unsigned int vnum, unsigned int debug_vl, bool *done)
+{
+	RISCV013_INFO(info);
+	unsigned int xlen = riscv_xlen(target);
+
+	*done = false;
+
+	riscv_reg_t s1;
+	if (register_read(target, &s1, GDB_REGNO_S1) != ERROR_OK)
+		return ERROR_FAIL;
+	if (register_write_direct(target, GDB_REGNO_S1, 0) != ERROR_OK)
+		return ERROR_FAIL;
+
+	struct riscv_program program;
+	riscv_program_init(&program, target);
+	riscv_program_insert(&program, vmv_x_s(S0, vnum));
+	riscv_program_insert(&program, vslide1down_vx(vnum, vnum, S0, true));
+	riscv_program_insert(&program, addi(S1, S1, 1));
+	if (riscv_program_ebreak(&program) != ERROR_OK ||
+			riscv_program_write(&program) != ERROR_OK)
+		return ERROR_FAIL;
+
+	/* as riscv013_execute_debug_buffer() */
+	uint32_t exec = access_register_command(target, GDB_REGNO_ZERO, 32,
+			AC_ACCESS_REGISTER_POSTEXEC);
+	uint32_t transfer_exec = access_register_command(target, GDB_REGNO_S0, xlen,
+			AC_ACCESS_REGISTER_TRANSFER | AC_ACCESS_REGISTER_POSTEXEC);
+	uint32_t transfer = access_register_command(target, GDB_REGNO_S0, xlen,
+			AC_ACCESS_REGISTER_TRANSFER);
+
+	/* a command, and one or two data reads, per element */
+	struct riscv_batch *batch = riscv_batch_alloc(target, 3 * debug_vl + 2,
+			info->dmi_busy_delay + info->ac_busy_delay + info->progbuf_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
+
+	riscv_batch_add_dmi_write(batch, DM_COMMAND, exec);
+	size_t first_key = 0;
+	for (unsigned int i = 0; i < debug_vl; i++) {
+		riscv_batch_add_dmi_write(batch, DM_COMMAND,
+				i + 1 < debug_vl ? transfer_exec : transfer);
+		size_t key = riscv_batch_add_dmi_read(batch, DM_DATA0);
+		if (i == 0)
+			first_key = key;
+		if (xlen > 32)
+			riscv_batch_add_dmi_read(batch, DM_DATA1);
+	}
+	size_t abstractcs_key = riscv_batch_add_dmi_read(batch, DM_ABSTRACTCS);
+
+	if (batch_run(target, batch) != ERROR_OK) {
+		riscv_batch_free(batch);
+		return ERROR_FAIL;
+	}
+
+	/* a busy DMI response sticks, the last one tells about all of them */
+	uint32_t abstractcs = 0;
+	if (riscv_batch_get_dmi_read_op(batch, abstractcs_key) != DMI_STATUS_SUCCESS) {
+		LOG_DEBUG("[%s] vector read: DMI busy", target_name(target));
+		increase_dmi_busy_delay(target);
+	} else {
+		abstractcs = riscv_batch_get_dmi_read_data(batch, abstractcs_key);
+		info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+		if (info->cmderr == CMDERR_NONE && !get_field(abstractcs, DM_ABSTRACTCS_BUSY))
+			*done = true;
+		else if (info->cmderr == CMDERR_BUSY)
+			increase_busy_delay(target, BUSY_DELAY_PROGBUF);
+	}
+
+	if (*done) {
+		unsigned int words = xlen > 32 ? 2 : 1;
+		for (unsigned int i = 0; i < debug_vl; i++) {
+			size_t key = first_key + i * (words + 1);
+			uint64_t v = riscv_batch_get_dmi_read_data(batch, key);
+			if (xlen > 32)
+				v |= (uint64_t)riscv_batch_get_dmi_read_data(batch, key + 1) << 32;
+			buf_set_u64(value, xlen * i, xlen, v);
+		}
+		busy_delay_success(target, BUSY_DELAY_PROGBUF, debug_vl);
+	}
+	riscv_batch_free(batch);
+
+	if (!*done) {
+		LOG_DEBUG("[%s] vector read batch failed; abstractcs=0x%x",
+				target_name(target), abstractcs);
+		riscv013_clear_abstract_error(target);
+
+		/* have the register back where it was, for the slow way */
+		riscv_reg_t slides;
+		if (register_read_direct(target, &slides, GDB_REGNO_S1) != ERROR_OK)
+			return ERROR_FAIL;
+		for (; slides < debug_vl; slides++)
+			if (execute_abstract_command(target, exec) != ERROR_OK)
+				return ERROR_FAIL;
+	}
+
+	return register_write_direct(target, GDB_REGNO_S1, s1);
+}
+
 static int riscv013_get_register_buf(struct target *target,
 		uint8_t *value, int regno)
 {
@@ -1970,13 +2301,18 @@ static int riscv013_get_register_buf(struct target *target,
 	unsigned vnum = regno - GDB_REGNO_V0;
 	unsigned xlen = riscv_xlen(target);
 
+	bool done = false;
+	if (has_sufficient_progbuf(target, 4) &&
+			read_vector_register_batch(target, value, vnum, debug_vl, &done) != ERROR_OK)
+		return ERROR_FAIL;
+
 	struct riscv_program program;
 	riscv_program_init(&program, target);
 	riscv_program_insert(&program, vmv_x_s(S0, vnum));
 	riscv_program_insert(&program, vslide1down_vx(vnum, vnum, S0, true));
 
 	int result = ERROR_OK;
-	for (unsigned i = 0; i < debug_vl; i++) {
+	for (unsigned int i = 0; !done && i < debug_vl; i++) {
 		/* Executing the program might result in an exception if there is some
 		 * issue with the vector implementation/instructions we're using. If that
 		 * happens, attempt to restore as usual. We may have clobbered the
@@ -2087,6 +2423,36 @@ static int sb_write_address(struct target *target, target_addr_t address,
 				  false, ensure_success);
 }
 
+/* The batches of the memory accesses start with this many scans. */
+#define BATCH_SCANS_MIN	32
+
+/* The number of scans of the next batch of a memory access. */
+static size_t batch_scans(const struct target *target)
+{
+	RISCV013_INFO(info);
+
+	if (!info->batch_scans || info->batch_scans > riscv_batch_scans_max)
+		info->batch_scans = MIN(BATCH_SCANS_MIN, riscv_batch_scans_max);
+
+	return info->batch_scans;
+}
+
+/* Doubles the batches after one that went through, up to the limit set with
+ * 'riscv set_batch_scans', halves them after one the target was busy for,
+ * whose scans after the busy one are redone. */
+static void batch_scans_update(const struct target *target, bool busy)
+{
+	RISCV013_INFO(info);
+	size_t scans = batch_scans(target);
+
+	if (busy)
+		scans = MAX(scans / 2, MIN(BATCH_SCANS_MIN, riscv_batch_scans_max));
+	else
+		scans = MIN(2 * scans, riscv_batch_scans_max);
+
+	info->batch_scans = scans;
+}
+
 static int batch_run(const struct target *target, struct riscv_batch *batch)
 {
 	RISCV013_INFO(info);
@@ -2097,9 +2463,22 @@ static int batch_run(const struct target *target, struct riscv_batch *batch)
 			batch->idle_count = 0;
 			info->dmi_busy_delay = 0;
 			info->ac_busy_delay = 0;
+			info->progbuf_busy_delay = 0;
 		}
 	}
-	return riscv_batch_run(batch);
+
+	int retval = riscv_batch_run(batch);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the callers see the busy responses later on, and slow down */
+	for (size_t i = 0; i < batch->used_scans; i++)
+		if (buf_get_u32(batch->fields[i].in_value, DTM_DMI_OP_OFFSET,
+				DTM_DMI_OP_LENGTH) == DMI_STATUS_BUSY)
+			return ERROR_OK;
+	busy_delay_success(target, BUSY_DELAY_DMI, batch->used_scans);
+
+	return ERROR_OK;
 }
 
 static int sba_supports_access(struct target *target, unsigned int size_bytes)
@@ -2209,6 +2588,7 @@ static int sample_memory_bus_v1(struct target *target,
 		}
 
 		if (buf->used + result_bytes >= buf->size) {
+			buf->dropped += repeat * enabled_count;
 			riscv_batch_free(batch);
 			break;
 		}
@@ -2223,7 +2603,7 @@ static int sample_memory_bus_v1(struct target *target,
 		if (get_field(sbcs_read, DM_SBCS_SBBUSYERROR)) {
 			/* Discard this batch (too much hassle to try to recover partial
 			 * data) and try again with a larger delay. */
-			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
+			increase_busy_delay(target, BUSY_DELAY_SB_READ);
 			dmi_write(target, DM_SBCS, sbcs_read | DM_SBCS_SBBUSYERROR | DM_SBCS_SBERROR);
 			riscv_batch_free(batch);
 			continue;
@@ -2234,6 +2614,7 @@ static int sample_memory_bus_v1(struct target *target,
 			riscv_batch_free(batch);
 			return ERROR_FAIL;
 		}
+		busy_delay_success(target, BUSY_DELAY_SB_READ, repeat);
 
 		unsigned int read = 0;
 		for (unsigned int n = 0; n < repeat; n++) {
@@ -2269,6 +2650,22 @@ static int sample_memory(struct target *target,
 	return sample_memory_bus_v1(target, buf, config, until_ms);
 }
 
+/* Only the system bus reaches the memory without halting the hart. */
+static bool access_memory_running(struct target *target)
+{
+	RISCV_INFO(r);
+
+	for (unsigned int i = 0; i < RISCV_NUM_MEM_ACCESS_METHODS; i++) {
+		if (r->mem_access_methods[i] == RISCV_MEM_ACCESS_SYSBUS)
+			return sba_supports_access(target, 1) && sba_supports_access(target, 2) &&
+				sba_supports_access(target, 4);
+		if (r->mem_access_methods[i] == RISCV_MEM_ACCESS_UNSPECIFIED)
+			break;
+	}
+
+	return false;
+}
+
 static int init_target(struct command_context *cmd_ctx,
 		struct target *target)
 {
@@ -2301,9 +2698,11 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->dmi_read = &dmi_read;
 	generic_info->dmi_write = &dmi_write;
 	generic_info->read_memory = read_memory;
+	generic_info->access_memory_running = access_memory_running;
 	generic_info->hart_count = &riscv013_hart_count;
 	generic_info->data_bits = &riscv013_data_bits;
 	generic_info->print_info = &riscv013_print_info;
+	generic_info->print_stats = &riscv013_print_stats;
 	if (!generic_info->version_specific) {
 		generic_info->version_specific = calloc(1, sizeof(riscv013_info_t));
 		if (!generic_info->version_specific)
@@ -2318,6 +2717,7 @@ static int init_target(struct command_context *cmd_ctx,
 	info->bus_master_read_delay = 0;
 	info->bus_master_write_delay = 0;
 	info->ac_busy_delay = 0;
+	info->progbuf_busy_delay = 0;
 
 	/* Assume all these abstract commands are supported until we learn
 	 * otherwise.
@@ -2349,7 +2749,12 @@ static int assert_reset(struct target *target)
 		/* There's only one target, and OpenOCD thinks each hart is a thread.
 		 * We must reset them all. */
 
-		/* TODO: Try to use hasel in dmcontrol */
+		/* All the harts at once, with hasel, or only this one. */
+		bool use_hasel;
+		if (select_all_harts(target, &use_hasel) != ERROR_OK)
+			return ERROR_FAIL;
+		if (use_hasel)
+			control_base |= DM_DMCONTROL_HASEL;
 
 		/* Set haltreq for each hart. */
 		uint32_t control = set_hartsel(control_base, target->coreid);
@@ -2372,6 +2777,11 @@ static int assert_reset(struct target *target)
 
 	target->state = TARGET_RESET;
 
+	/* the reset sets the GPRs anew */
+	RISCV013_INFO(info);
+	info->clobbered_gprs = 0;
+	info->fenced = false;
+
 	dm013_info_t *dm = get_dm(target);
 	if (!dm)
 		return ERROR_FAIL;
@@ -2380,6 +2790,8 @@ static int assert_reset(struct target *target)
 	 * involves SRST being toggled. So clear our cache which may be out of
 	 * date. */
 	memset(dm->progbuf_cache, 0, sizeof(dm->progbuf_cache));
+	dm->hawindowsel = -1;
+	dm->hawindow_valid = false;
 
 	return ERROR_OK;
 }
@@ -2393,6 +2805,14 @@ static int deassert_reset(struct target *target)
 	/* Clear the reset, but make sure haltreq is still set */
 	uint32_t control = 0, control_haltreq;
 	control = set_field(control, DM_DMCONTROL_DMACTIVE, 1);
+	if (target->rtos) {
+		/* the harts selected in assert_reset() */
+		bool use_hasel;
+		if (select_all_harts(target, &use_hasel) != ERROR_OK)
+			return ERROR_FAIL;
+		if (use_hasel)
+			control |= DM_DMCONTROL_HASEL;
+	}
 	control_haltreq = set_field(control, DM_DMCONTROL_HALTREQ, target->reset_halt ? 1 : 0);
 	dmi_write(target, DM_DMCONTROL,
 			set_hartsel(control_haltreq, r->current_hartid));
@@ -2476,7 +2896,7 @@ static int execute_fence(struct target *target)
 static void log_memory_access(target_addr_t address, uint64_t value,
 		unsigned size_bytes, bool read)
 {
-	if (debug_level < LOG_LVL_DEBUG)
+	if (!LOG_LEVEL_IS(LOG_LVL_DEBUG))
 		return;
 
 	char fmt[80];
@@ -2787,12 +3207,14 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 			if (dmi_write(target, DM_SBCS, sbcs_read | DM_SBCS_SBBUSYERROR) != ERROR_OK)
 				return ERROR_FAIL;
 			next_address = sb_read_address(target);
-			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
+			increase_busy_delay(target, BUSY_DELAY_SB_READ);
 			continue;
 		}
 
 		unsigned error = get_field(sbcs_read, DM_SBCS_SBERROR);
 		if (error == 0) {
+			busy_delay_success(target, BUSY_DELAY_SB_READ,
+					(end_address - next_address) / size);
 			next_address = end_address;
 		} else {
 			/* Some error indicating the bus access failed, but not because of
@@ -3155,8 +3577,8 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 		 * dm_data0 contains[read_addr-size*2]
 		 */
 
-		struct riscv_batch *batch = riscv_batch_alloc(target, 32,
-				info->dmi_busy_delay + info->ac_busy_delay);
+		struct riscv_batch *batch = riscv_batch_alloc(target, batch_scans(target),
+				info->dmi_busy_delay + info->progbuf_busy_delay);
 		if (!batch)
 			return ERROR_FAIL;
 
@@ -3190,11 +3612,14 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 			case CMDERR_NONE:
 				LOG_DEBUG("successful (partial?) memory read");
 				next_index = index + reads;
+				batch_scans_update(target, false);
+				busy_delay_success(target, BUSY_DELAY_PROGBUF, reads);
 				break;
 			case CMDERR_BUSY:
 				LOG_DEBUG("memory read resulted in busy response");
 
-				increase_ac_busy_delay(target);
+				increase_busy_delay(target, BUSY_DELAY_PROGBUF);
+				batch_scans_update(target, true);
 				riscv013_clear_abstract_error(target);
 
 				dmi_write(target, DM_ABSTRACTAUTO, 0);
@@ -3390,15 +3815,14 @@ static int read_memory_progbuf_one(struct target *target, target_addr_t address,
 		goto restore_s0;
 
 	uint64_t value;
-	if (register_read(target, &value, GDB_REGNO_S0) != ERROR_OK)
+	if (register_read_direct(target, &value, GDB_REGNO_S0) != ERROR_OK)
 		goto restore_s0;
 	buf_set_u64(buffer, 0, 8 * size, value);
 	log_memory_access(address, value, size, true);
 	result = ERROR_OK;
 
 restore_s0:
-	if (riscv_set_register(target, GDB_REGNO_S0, s0) != ERROR_OK)
-		result = ERROR_FAIL;
+	register_restore_lazily(target, GDB_REGNO_S0, s0);
 
 restore_mstatus:
 	if (mstatus != mstatus_old)
@@ -3429,8 +3853,12 @@ static int read_memory_progbuf(struct target *target, target_addr_t address,
 
 	memset(buffer, 0, count*size);
 
-	if (execute_fence(target) != ERROR_OK)
-		return ERROR_FAIL;
+	RISCV013_INFO(info);
+	if (!info->fenced) {
+		if (execute_fence(target) != ERROR_OK)
+			return ERROR_FAIL;
+		info->fenced = true;
+	}
 
 	if (count == 1)
 		return read_memory_progbuf_one(target, address, size, buffer);
@@ -3514,10 +3942,10 @@ static int read_memory_progbuf(struct target *target, target_addr_t address,
 		result = ERROR_OK;
 	}
 
-	riscv_set_register(target, GDB_REGNO_S0, s0);
-	riscv_set_register(target, GDB_REGNO_S1, s1);
+	register_restore_lazily(target, GDB_REGNO_S0, s0);
+	register_restore_lazily(target, GDB_REGNO_S1, s1);
 	if (increment == 0)
-		riscv_set_register(target, GDB_REGNO_S2, s2);
+		register_restore_lazily(target, GDB_REGNO_S2, s2);
 
 	/* Restore MSTATUS */
 	if (mstatus != mstatus_old)
@@ -3661,10 +4089,11 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 	while (next_address < end_address) {
 		LOG_DEBUG("transferring burst starting at address 0x%" TARGET_PRIxADDR,
 				next_address);
+		target_addr_t burst_address = next_address;
 
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
-				32,
+				batch_scans(target),
 				info->dmi_busy_delay + info->bus_master_write_delay);
 		if (!batch)
 			return ERROR_FAIL;
@@ -3707,20 +4136,27 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 			next_address += size;
 		}
 
+		/* The status of the whole batch, in the same flush: the writes
+		 * stop at the first busy one, sbaddress tells where. */
+		size_t sbcs_key = riscv_batch_add_dmi_read(batch, DM_SBCS);
+
 		/* Execute the batch of writes */
 		result = batch_run(target, batch);
-		riscv_batch_free(batch);
-		if (result != ERROR_OK)
+		if (result != ERROR_OK) {
+			riscv_batch_free(batch);
 			return result;
+		}
 
-		/* Read sbcs value.
-		 * At the same time, detect if DMI busy has occurred during the batch write. */
-		bool dmi_busy_encountered;
-		if (dmi_op(target, &sbcs, &dmi_busy_encountered, DMI_OP_READ,
-				DM_SBCS, 0, false, true) != ERROR_OK)
-			return ERROR_FAIL;
-		if (dmi_busy_encountered)
+		/* A DMI busy sticks, the read of sbcs tells if the batch got one. */
+		bool dmi_busy_encountered = riscv_batch_get_dmi_read_op(batch, sbcs_key) != DMI_STATUS_SUCCESS;
+		sbcs = riscv_batch_get_dmi_read_data(batch, sbcs_key);
+		riscv_batch_free(batch);
+		if (dmi_busy_encountered) {
 			LOG_DEBUG("DMI busy encountered during system bus write.");
+			increase_dmi_busy_delay(target);
+			if (dmi_read(target, &sbcs, DM_SBCS) != ERROR_OK)
+				return ERROR_FAIL;
+		}
 
 		/* Wait until sbbusy goes low */
 		time_t start = time(NULL);
@@ -3741,9 +4177,11 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 			/* Clear the sticky error flag. */
 			dmi_write(target, DM_SBCS, sbcs | DM_SBCS_SBBUSYERROR);
 			/* Slow down before trying again. */
-			info->bus_master_write_delay += info->bus_master_write_delay / 10 + 1;
+			increase_busy_delay(target, BUSY_DELAY_SB_WRITE);
 		}
 
+		batch_scans_update(target, get_field(sbcs, DM_SBCS_SBBUSYERROR) || dmi_busy_encountered);
+
 		if (get_field(sbcs, DM_SBCS_SBBUSYERROR) || dmi_busy_encountered) {
 			/* Recover from the case when the write commands were issued too fast.
 			 * Determine the address from which to resume writing. */
@@ -3779,6 +4217,8 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 			/* Fail the whole operation */
 			return ERROR_FAIL;
 		}
+
+		busy_delay_success(target, BUSY_DELAY_SB_WRITE, (next_address - burst_address) / size);
 	}
 
 	return ERROR_OK;
@@ -3859,8 +4299,8 @@ static int write_memory_progbuf(struct target *target, target_addr_t address,
 
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
-				32,
-				info->dmi_busy_delay + info->ac_busy_delay);
+				batch_scans(target),
+				info->dmi_busy_delay + info->progbuf_busy_delay);
 		if (!batch)
 			goto error;
 
@@ -3936,13 +4376,16 @@ static int write_memory_progbuf(struct target *target, target_addr_t address,
 		info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
 		if (info->cmderr == CMDERR_NONE && !dmi_busy_encountered) {
 			LOG_DEBUG("successful (partial?) memory write");
+			batch_scans_update(target, false);
+			busy_delay_success(target, BUSY_DELAY_PROGBUF, (cur_addr - address) / size - start);
 		} else if (info->cmderr == CMDERR_BUSY || dmi_busy_encountered) {
+			batch_scans_update(target, true);
 			if (info->cmderr == CMDERR_BUSY)
 				LOG_DEBUG("Memory write resulted in abstract command busy response.");
 			else if (dmi_busy_encountered)
 				LOG_DEBUG("Memory write resulted in DMI busy response.");
 			riscv013_clear_abstract_error(target);
-			increase_ac_busy_delay(target);
+			increase_busy_delay(target, BUSY_DELAY_PROGBUF);
 
 			dmi_write(target, DM_ABSTRACTAUTO, 0);
 			result = register_read_direct(target, &cur_addr, GDB_REGNO_S0);
@@ -3960,10 +4403,8 @@ static int write_memory_progbuf(struct target *target, target_addr_t address,
 error:
 	dmi_write(target, DM_ABSTRACTAUTO, 0);
 
-	if (register_write_direct(target, GDB_REGNO_S1, s1) != ERROR_OK)
-		return ERROR_FAIL;
-	if (register_write_direct(target, GDB_REGNO_S0, s0) != ERROR_OK)
-		return ERROR_FAIL;
+	register_restore_lazily(target, GDB_REGNO_S1, s1);
+	register_restore_lazily(target, GDB_REGNO_S0, s0);
 
 	/* Restore MSTATUS */
 	if (mstatus != mstatus_old)
@@ -3972,6 +4413,7 @@ error:
 
 	if (execute_fence(target) != ERROR_OK)
 		return ERROR_FAIL;
+	info->fenced = true;
 
 	return result;
 }
@@ -3988,6 +4430,9 @@ static int write_memory(struct target *target, target_addr_t address,
 	RISCV_INFO(r);
 	RISCV013_INFO(info);
 
+	/* the progbuf write fences again */
+	info->fenced = false;
+
 	char *progbuf_result = "disabled";
 	char *sysbus_result = "disabled";
 	char *abstract_result = "disabled";
@@ -4074,12 +4519,13 @@ static int riscv013_get_register(struct target *target,
 	int result = ERROR_OK;
 	if (rid == GDB_REGNO_PC) {
 		/* TODO: move this into riscv.c. */
-		result = register_read(target, value, GDB_REGNO_DPC);
+		/* DPC is cached, e.g. fetched on the halt */
+		result = riscv_get_register(target, value, GDB_REGNO_DPC);
 		LOG_DEBUG("[%d] read PC from DPC: 0x%" PRIx64, target->coreid, *value);
 	} else if (rid == GDB_REGNO_PRIV) {
 		uint64_t dcsr;
 		/* TODO: move this into riscv.c. */
-		result = register_read(target, &dcsr, GDB_REGNO_DCSR);
+		result = riscv_get_register(target, &dcsr, GDB_REGNO_DCSR);
 		*value = set_field(0, VIRT_PRIV_V, get_field(dcsr, CSR_DCSR_V));
 		*value = set_field(*value, VIRT_PRIV_PRV, get_field(dcsr, CSR_DCSR_PRV));
 	} else {
@@ -4110,11 +4556,16 @@ static int riscv013_set_register(struct target *target, int rid, uint64_t value)
 					"value (0x%" PRIx64 ")", value, actual_value);
 			return ERROR_FAIL;
 		}
+		struct reg *dpc = &target->reg_cache->reg_list[GDB_REGNO_DPC];
+		buf_set_u64(dpc->value, 0, dpc->size, actual_value);
+		dpc->valid = true;
 	} else if (rid == GDB_REGNO_PRIV) {
 		uint64_t dcsr;
-		register_read(target, &dcsr, GDB_REGNO_DCSR);
+		riscv_get_register(target, &dcsr, GDB_REGNO_DCSR);
 		dcsr = set_field(dcsr, CSR_DCSR_PRV, get_field(value, VIRT_PRIV_PRV));
 		dcsr = set_field(dcsr, CSR_DCSR_V, get_field(value, VIRT_PRIV_V));
+		/* WARL, read it again when needed */
+		target->reg_cache->reg_list[GDB_REGNO_DCSR].valid = false;
 		return register_write_direct(target, GDB_REGNO_DCSR, dcsr);
 	} else {
 		return register_write_direct(target, rid, value);
@@ -4143,6 +4594,42 @@ static int riscv013_select_current_hart(struct target *target)
 	return result;
 }
 
+/* Write the hart array window, skipping the registers that already hold the
+ * value: halting and resuming the same harts costs a single DMCONTROL write. */
+static int write_hawindow(struct target *target, const uint32_t *hawindow,
+		unsigned int hawindow_count)
+{
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+
+	/* a failed write leaves the registers unknown */
+	bool valid = dm->hawindow_valid;
+	dm->hawindow_valid = false;
+
+	for (unsigned int i = 0; i < hawindow_count; i++) {
+		bool cached = i < HAWINDOW_CACHE_SIZE;
+		if (cached && valid && dm->hawindow_cache[i] == hawindow[i])
+			continue;
+
+		if (dm->hawindowsel != (int)i) {
+			dm->hawindowsel = -1;
+			if (dmi_write(target, DM_HAWINDOWSEL, i) != ERROR_OK)
+				return ERROR_FAIL;
+			dm->hawindowsel = i;
+		}
+		if (dmi_write(target, DM_HAWINDOW, hawindow[i]) != ERROR_OK)
+			return ERROR_FAIL;
+		if (cached)
+			dm->hawindow_cache[i] = hawindow[i];
+	}
+
+	/* the windows past the cache are always written */
+	dm->hawindow_valid = true;
+
+	return ERROR_OK;
+}
+
 /* Select all harts that were prepped and that are selectable, clearing the
  * prepped flag on the harts that actually were selected. */
 static int select_prepped_harts(struct target *target, bool *use_hasel)
@@ -4186,12 +4673,34 @@ static int select_prepped_harts(struct target *target, bool *use_hasel)
 		return ERROR_OK;
 	}
 
-	for (unsigned i = 0; i < hawindow_count; i++) {
-		if (dmi_write(target, DM_HAWINDOWSEL, i) != ERROR_OK)
-			return ERROR_FAIL;
-		if (dmi_write(target, DM_HAWINDOW, hawindow[i]) != ERROR_OK)
-			return ERROR_FAIL;
-	}
+	if (write_hawindow(target, hawindow, hawindow_count) != ERROR_OK)
+		return ERROR_FAIL;
+
+	*use_hasel = true;
+	return ERROR_OK;
+}
+
+/* Select all the harts of the DM with hasel, e.g. to reset them together.
+ * Only a DM with several harts that supports hasel uses it. */
+static int select_all_harts(struct target *target, bool *use_hasel)
+{
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+
+	*use_hasel = false;
+	if (!dm->hasel_supported || dm->hart_count <= 1)
+		return ERROR_OK;
+
+	unsigned int hawindow_count = (dm->hart_count + 31) / 32;
+	uint32_t hawindow[hawindow_count];
+
+	memset(hawindow, 0xff, sizeof(uint32_t) * hawindow_count);
+	if (dm->hart_count % 32)
+		hawindow[hawindow_count - 1] = (1u << (dm->hart_count % 32)) - 1;
+
+	if (write_hawindow(target, hawindow, hawindow_count) != ERROR_OK)
+		return ERROR_FAIL;
 
 	*use_hasel = true;
 	return ERROR_OK;
@@ -4244,6 +4753,8 @@ static int riscv013_halt_go(struct target *target)
 			return ERROR_FAIL;
 		list_for_each_entry(entry, &dm->target_list, list) {
 			struct target *t = entry->target;
+			if (!riscv_info(t)->selected)
+				continue;
 			t->state = TARGET_HALTED;
 			if (t->debug_reason == DBG_REASON_NOTHALTED)
 				t->debug_reason = DBG_REASON_DBGRQ;
@@ -4278,11 +4789,104 @@ static int riscv013_on_step(struct target *target)
 	return riscv013_on_step_or_resume(target, true);
 }
 
-static int riscv013_on_halt(struct target *target)
+/* Reads the GPRs, DPC and DCSR of the current hart into the register cache,
+ * with one batch of abstract commands: what the debugger asks for first after
+ * a halt costs a single JTAG flush, not a command and a wait per register.
+ * On any error the cache is left alone, the registers are read one by one as
+ * they are needed. */
+static int register_cache_fetch(struct target *target)
 {
+	RISCV013_INFO(info);
+
+	if (!target->reg_cache)
+		return ERROR_OK;
+
+	struct reg *reg_list = target->reg_cache->reg_list;
+	/* already fetched since the hart halted */
+	if (reg_list[GDB_REGNO_DPC].valid)
+		return ERROR_OK;
+
+	enum gdb_regno regs[GDB_REGNO_XPR31 + 2];
+	unsigned int count = 0;
+	unsigned int last_gpr = riscv_supports_extension(target, 'E') ?
+		GDB_REGNO_XPR15 : GDB_REGNO_XPR31;
+	for (unsigned int number = GDB_REGNO_ZERO + 1; number <= last_gpr; number++)
+		regs[count++] = number;
+	if (info->abstract_read_csr_supported) {
+		regs[count++] = GDB_REGNO_DPC;
+		regs[count++] = GDB_REGNO_DCSR;
+	}
+
+	if (riscv_select_current_hart(target) != ERROR_OK)
+		return ERROR_FAIL;
+
+	/* a command, and one or two data reads, per register */
+	struct riscv_batch *batch = riscv_batch_alloc(target, 3 * count + 2,
+			info->dmi_busy_delay + info->ac_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
+
+	size_t keys[ARRAY_SIZE(regs)];
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int size = register_size(target, regs[i]);
+		riscv_batch_add_dmi_write(batch, DM_COMMAND,
+				access_register_command(target, regs[i], size,
+					AC_ACCESS_REGISTER_TRANSFER));
+		keys[i] = riscv_batch_add_dmi_read(batch, DM_DATA0);
+		if (size > 32)
+			riscv_batch_add_dmi_read(batch, DM_DATA1);
+	}
+	size_t abstractcs_key = riscv_batch_add_dmi_read(batch, DM_ABSTRACTCS);
+
+	if (batch_run(target, batch) != ERROR_OK) {
+		riscv_batch_free(batch);
+		return ERROR_FAIL;
+	}
+
+	/* a busy DMI response sticks, the last one tells about all of them */
+	if (riscv_batch_get_dmi_read_op(batch, abstractcs_key) != DMI_STATUS_SUCCESS) {
+		LOG_DEBUG("[%s] register fetch: DMI busy", target_name(target));
+		riscv_batch_free(batch);
+		increase_dmi_busy_delay(target);
+		return ERROR_OK;
+	}
+
+	uint32_t abstractcs = riscv_batch_get_dmi_read_data(batch, abstractcs_key);
+	info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+	if (info->cmderr != CMDERR_NONE || get_field(abstractcs, DM_ABSTRACTCS_BUSY)) {
+		LOG_DEBUG("[%s] register fetch failed; abstractcs=0x%x",
+				target_name(target), abstractcs);
+		riscv_batch_free(batch);
+		if (info->cmderr == CMDERR_BUSY)
+			increase_ac_busy_delay(target);
+		riscv013_clear_abstract_error(target);
+		return ERROR_OK;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct reg *reg = &reg_list[regs[i]];
+		uint64_t value = riscv_batch_get_dmi_read_data(batch, keys[i]);
+		if (register_size(target, regs[i]) > 32)
+			value |= (uint64_t)riscv_batch_get_dmi_read_data(batch, keys[i] + 1) << 32;
+		/* the hart holds the scratch value of a memory access */
+		if (regs[i] <= GDB_REGNO_XPR31 && (info->clobbered_gprs & (1u << regs[i])))
+			value = info->saved_gprs[regs[i]];
+		buf_set_u64(reg->value, 0, reg->size, value);
+		reg->valid = true;
+	}
+	riscv_batch_free(batch);
+
+	busy_delay_success(target, BUSY_DELAY_ABSTRACT, count);
+	LOG_DEBUG("[%s] fetched %u registers", target_name(target), count);
+
 	return ERROR_OK;
 }
 
+static int riscv013_on_halt(struct target *target)
+{
+	return register_cache_fetch(target);
+}
+
 static bool riscv013_is_halted(struct target *target)
 {
 	uint32_t dmstatus;
@@ -4314,7 +4918,7 @@ static bool riscv013_is_halted(struct target *target)
 static enum riscv_halt_reason riscv013_halt_reason(struct target *target)
 {
 	riscv_reg_t dcsr;
-	int result = register_read(target, &dcsr, GDB_REGNO_DCSR);
+	int result = riscv_get_register(target, &dcsr, GDB_REGNO_DCSR);
 	if (result != ERROR_OK)
 		return RISCV_HALT_UNKNOWN;
 
@@ -4417,6 +5021,12 @@ static int maybe_execute_fence_i(struct target *target)
 /* Helper Functions. */
 static int riscv013_on_step_or_resume(struct target *target, bool step)
 {
+	RISCV013_INFO(info);
+
+	if (register_restore_flush(target) != ERROR_OK)
+		return ERROR_FAIL;
+	info->fenced = false;
+
 	if (maybe_execute_fence_i(target) != ERROR_OK)
 		return ERROR_FAIL;
 
@@ -17,7 +17,9 @@
 #include "jtag/jtag.h"
 #include "target/register.h"
 #include "target/breakpoints.h"
+#include "server/server.h"
 #include "riscv.h"
+#include "batch.h"
 #include "gdb_regs.h"
 #include "rtos/rtos.h"
 #include "debug_defines.h"
@@ -205,6 +207,10 @@ int riscv_command_timeout_sec = DEFAULT_COMMAND_TIMEOUT_SEC;
 /* Wall-clock timeout after reset. Settable via RISC-V Target commands.*/
 int riscv_reset_timeout_sec = DEFAULT_RESET_TIMEOUT_SEC;
 
+/* Largest number of scans of the batches of the memory accesses. Settable via
+ * RISC-V Target commands. */
+unsigned int riscv_batch_scans_max = RISCV_BATCH_SCANS_MAX;
+
 static bool riscv_enable_virt2phys = true;
 bool riscv_ebreakm = true;
 bool riscv_ebreaks = true;
@@ -260,6 +266,7 @@ static enum riscv_halt_reason riscv_halt_reason(struct target *target, int harti
 static void riscv_info_init(struct target *target, struct riscv_info *r);
 static void riscv_invalidate_register_cache(struct target *target);
 static int riscv_step_rtos_hart(struct target *target);
+static void riscv_sample_output_close(struct riscv_sample_output *output);
 
 static void riscv_sample_buf_maybe_add_timestamp(struct target *target, bool before)
 {
@@ -478,12 +485,16 @@ static void riscv_free_registers(struct target *target)
 			/* Free the ones we allocated separately. */
 			for (unsigned i = GDB_REGNO_COUNT; i < target->reg_cache->num_regs; i++)
 				free(target->reg_cache->reg_list[i].arch_info);
-			for (unsigned int i = 0; i < target->reg_cache->num_regs; i++)
-				free(target->reg_cache->reg_list[i].value);
+			/* The values of all the registers are in one block. */
+			free(target->reg_cache->reg_list[0].value);
 			free(target->reg_cache->reg_list);
 		}
 		free(target->reg_cache);
 	}
+
+	/* the names are rebuilt in place, drop their index */
+	register_name_index_free(target->reg_name_index);
+	target->reg_name_index = NULL;
 }
 
 static void riscv_deinit_target(struct target *target)
@@ -501,6 +512,8 @@ static void riscv_deinit_target(struct target *target)
 	if (!info)
 		return;
 
+	riscv_batch_pool_free(target);
+
 	range_list_t *entry, *tmp;
 	list_for_each_entry_safe(entry, tmp, &info->expose_csr, list) {
 		free(entry->name);
@@ -512,6 +525,9 @@ static void riscv_deinit_target(struct target *target)
 		free(entry);
 	}
 
+	riscv_sample_output_close(info->sample_output);
+	free(info->sample_buf.buf);
+
 	free(info->reg_names);
 	free(target->arch_info);
 
@@ -1220,6 +1236,12 @@ static int halt_go(struct target *target)
 
 static int halt_finish(struct target *target)
 {
+	RISCV_INFO(r);
+
+	/* fill the register cache before the debugger asks for the registers */
+	if (r->is_halted && target->state == TARGET_HALTED)
+		r->on_halt(target);
+
 	return target_call_event_callbacks(target, TARGET_EVENT_HALTED);
 }
 
@@ -1827,10 +1849,10 @@ static int riscv_arch_state(struct target *target)
 }
 
 /* Algorithm must end with a software breakpoint instruction. */
-static int riscv_run_algorithm(struct target *target, int num_mem_params,
+static int riscv_start_algorithm(struct target *target, int num_mem_params,
 		struct mem_param *mem_params, int num_reg_params,
 		struct reg_param *reg_params, target_addr_t entry_point,
-		target_addr_t exit_point, int timeout_ms, void *arch_info)
+		target_addr_t exit_point, void *arch_info)
 {
 	RISCV_INFO(info);
 
@@ -1845,16 +1867,15 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 	}
 
 	/* Save registers */
-	struct reg *reg_pc = register_get_by_name(target->reg_cache, "pc", true);
+	struct reg *reg_pc = target_reg_get_by_name(target, "pc", true);
 	if (!reg_pc || reg_pc->type->get(reg_pc) != ERROR_OK)
 		return ERROR_FAIL;
-	uint64_t saved_pc = buf_get_u64(reg_pc->value, 0, reg_pc->size);
-	LOG_DEBUG("saved_pc=0x%" PRIx64, saved_pc);
+	info->algorithm_saved_pc = buf_get_u64(reg_pc->value, 0, reg_pc->size);
+	LOG_DEBUG("saved_pc=0x%" PRIx64, info->algorithm_saved_pc);
 
-	uint64_t saved_regs[32];
 	for (int i = 0; i < num_reg_params; i++) {
 		LOG_DEBUG("save %s", reg_params[i].reg_name);
-		struct reg *r = register_get_by_name(target->reg_cache, reg_params[i].reg_name, false);
+		struct reg *r = target_reg_get_by_name(target, reg_params[i].reg_name, false);
 		if (!r) {
 			LOG_ERROR("Couldn't find register named '%s'", reg_params[i].reg_name);
 			return ERROR_FAIL;
@@ -1873,7 +1894,7 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 
 		if (r->type->get(r) != ERROR_OK)
 			return ERROR_FAIL;
-		saved_regs[r->number] = buf_get_u64(r->value, 0, r->size);
+		info->algorithm_saved_regs[r->number] = buf_get_u64(r->value, 0, r->size);
 
 		if (reg_params[i].direction == PARAM_OUT || reg_params[i].direction == PARAM_IN_OUT) {
 			if (r->type->set(r, reg_params[i].value) != ERROR_OK)
@@ -1883,21 +1904,19 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 
 
 	/* Disable Interrupts before attempting to run the algorithm. */
-	uint64_t current_mstatus;
 	uint8_t mstatus_bytes[8] = { 0 };
 
 	LOG_DEBUG("Disabling Interrupts");
-	struct reg *reg_mstatus = register_get_by_name(target->reg_cache,
-			"mstatus", true);
+	struct reg *reg_mstatus = target_reg_get_by_name(target, "mstatus", true);
 	if (!reg_mstatus) {
 		LOG_ERROR("Couldn't find mstatus!");
 		return ERROR_FAIL;
 	}
 
 	reg_mstatus->type->get(reg_mstatus);
-	current_mstatus = buf_get_u64(reg_mstatus->value, 0, reg_mstatus->size);
+	info->algorithm_saved_mstatus = buf_get_u64(reg_mstatus->value, 0, reg_mstatus->size);
 	uint64_t ie_mask = MSTATUS_MIE | MSTATUS_HIE | MSTATUS_SIE | MSTATUS_UIE;
-	buf_set_u64(mstatus_bytes, 0, info->xlen, set_field(current_mstatus,
+	buf_set_u64(mstatus_bytes, 0, info->xlen, set_field(info->algorithm_saved_mstatus,
 				ie_mask, 0));
 
 	reg_mstatus->type->set(reg_mstatus, mstatus_bytes);
@@ -1907,6 +1926,16 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 	if (riscv_resume(target, 0, entry_point, 0, 0, true) != ERROR_OK)
 		return ERROR_FAIL;
 
+	return ERROR_OK;
+}
+
+static int riscv_wait_algorithm(struct target *target, int num_mem_params,
+		struct mem_param *mem_params, int num_reg_params,
+		struct reg_param *reg_params, target_addr_t exit_point,
+		int timeout_ms, void *arch_info)
+{
+	RISCV_INFO(info);
+
 	int64_t start = timeval_ms();
 	while (target->state != TARGET_HALTED) {
 		LOG_DEBUG("poll()");
@@ -1946,7 +1975,8 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 	if (riscv_select_current_hart(target) != ERROR_OK)
 		return ERROR_FAIL;
 
-	if (reg_pc->type->get(reg_pc) != ERROR_OK)
+	struct reg *reg_pc = target_reg_get_by_name(target, "pc", true);
+	if (!reg_pc || reg_pc->type->get(reg_pc) != ERROR_OK)
 		return ERROR_FAIL;
 	uint64_t final_pc = buf_get_u64(reg_pc->value, 0, reg_pc->size);
 	if (exit_point && final_pc != exit_point) {
@@ -1957,19 +1987,25 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 
 	/* Restore Interrupts */
 	LOG_DEBUG("Restoring Interrupts");
-	buf_set_u64(mstatus_bytes, 0, info->xlen, current_mstatus);
+	uint8_t mstatus_bytes[8] = { 0 };
+	struct reg *reg_mstatus = target_reg_get_by_name(target, "mstatus", true);
+	if (!reg_mstatus) {
+		LOG_ERROR("Couldn't find mstatus!");
+		return ERROR_FAIL;
+	}
+	buf_set_u64(mstatus_bytes, 0, info->xlen, info->algorithm_saved_mstatus);
 	reg_mstatus->type->set(reg_mstatus, mstatus_bytes);
 
 	/* Restore registers */
 	uint8_t buf[8] = { 0 };
-	buf_set_u64(buf, 0, info->xlen, saved_pc);
+	buf_set_u64(buf, 0, info->xlen, info->algorithm_saved_pc);
 	if (reg_pc->type->set(reg_pc, buf) != ERROR_OK)
 		return ERROR_FAIL;
 
 	for (int i = 0; i < num_reg_params; i++) {
 		if (reg_params[i].direction == PARAM_IN ||
 				reg_params[i].direction == PARAM_IN_OUT) {
-			struct reg *r = register_get_by_name(target->reg_cache, reg_params[i].reg_name, false);
+			struct reg *r = target_reg_get_by_name(target, reg_params[i].reg_name, false);
 			if (r->type->get(r) != ERROR_OK) {
 				LOG_ERROR("get(%s) failed", r->name);
 				return ERROR_FAIL;
@@ -1977,8 +2013,8 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 			buf_cpy(r->value, reg_params[i].value, reg_params[i].size);
 		}
 		LOG_DEBUG("restore %s", reg_params[i].reg_name);
-		struct reg *r = register_get_by_name(target->reg_cache, reg_params[i].reg_name, false);
-		buf_set_u64(buf, 0, info->xlen, saved_regs[r->number]);
+		struct reg *r = target_reg_get_by_name(target, reg_params[i].reg_name, false);
+		buf_set_u64(buf, 0, info->xlen, info->algorithm_saved_regs[r->number]);
 		if (r->type->set(r, buf) != ERROR_OK) {
 			LOG_ERROR("set(%s) failed", r->name);
 			return ERROR_FAIL;
@@ -1988,12 +2024,36 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 	return ERROR_OK;
 }
 
+static int riscv_run_algorithm(struct target *target, int num_mem_params,
+		struct mem_param *mem_params, int num_reg_params,
+		struct reg_param *reg_params, target_addr_t entry_point,
+		target_addr_t exit_point, int timeout_ms, void *arch_info)
+{
+	int retval = riscv_start_algorithm(target, num_mem_params, mem_params,
+			num_reg_params, reg_params, entry_point, exit_point, arch_info);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return riscv_wait_algorithm(target, num_mem_params, mem_params,
+			num_reg_params, reg_params, exit_point, timeout_ms, arch_info);
+}
+
+bool riscv_access_memory_running(struct target *target)
+{
+	RISCV_INFO(r);
+
+	return r->access_memory_running && r->access_memory_running(target);
+}
+
+/* the 4 tables of the slice-by-4 loader, built by the loader */
+#define RISCV_CRC_TABLE_SIZE		(4 * 256 * sizeof(uint32_t))
+#define RISCV_CRC_TABLE_MIN_COUNT	(16 * 1024)
+
 static int riscv_checksum_memory(struct target *target,
 		target_addr_t address, uint32_t count,
 		uint32_t *checksum)
 {
-	struct working_area *crc_algorithm;
-	struct reg_param reg_params[2];
+	struct working_area *crc_algorithm = NULL;
 	int retval;
 
 	LOG_DEBUG("address=0x%" TARGET_PRIxADDR "; count=0x%" PRIx32, address, count);
@@ -2004,6 +2064,12 @@ static int riscv_checksum_memory(struct target *target,
 	static const uint8_t riscv64_crc_code[] = {
 #include "../../../contrib/loaders/checksum/riscv64_crc.inc"
 	};
+	static const uint8_t riscv32_crc_table_code[] = {
+#include "../../../contrib/loaders/checksum/riscv32_crc_table.inc"
+	};
+	static const uint8_t riscv64_crc_table_code[] = {
+#include "../../../contrib/loaders/checksum/riscv64_crc_table.inc"
+	};
 
 	static const uint8_t *crc_code;
 
@@ -2024,9 +2090,29 @@ static int riscv_checksum_memory(struct target *target,
 		return ERROR_FAIL;
 	}
 
-	retval = target_alloc_working_area(target, crc_code_size, &crc_algorithm);
-	if (retval != ERROR_OK)
-		return retval;
+	/* The table driven loader builds its tables in 4 KiB of working area
+	 * past the code, which takes about as long as the byte loader needs
+	 * for a few KiB. Fall back to the byte loader. */
+	target_addr_t crc_table = 0;
+	if (count >= RISCV_CRC_TABLE_MIN_COUNT) {
+		const uint8_t *table_code = xlen == 32 ? riscv32_crc_table_code :
+			riscv64_crc_table_code;
+		unsigned int table_code_size = xlen == 32 ? sizeof(riscv32_crc_table_code) :
+			sizeof(riscv64_crc_table_code);
+		retval = target_alloc_working_area_try(target,
+				table_code_size + RISCV_CRC_TABLE_SIZE, &crc_algorithm);
+		if (retval == ERROR_OK) {
+			crc_code = table_code;
+			crc_code_size = table_code_size;
+			crc_table = crc_algorithm->address + crc_code_size;
+		}
+	}
+
+	if (!crc_algorithm) {
+		retval = target_alloc_working_area(target, crc_code_size, &crc_algorithm);
+		if (retval != ERROR_OK)
+			return retval;
+	}
 
 	if (crc_algorithm->address + crc_algorithm->size > address &&
 			crc_algorithm->address < address + count) {
@@ -2046,15 +2132,28 @@ static int riscv_checksum_memory(struct target *target,
 		return retval;
 	}
 
-	init_reg_param(&reg_params[0], "a0", xlen, PARAM_IN_OUT);
-	init_reg_param(&reg_params[1], "a1", xlen, PARAM_OUT);
+	/* the arguments, then the registers the table loader uses, to have
+	 * them restored */
+	static char * const reg_names[] = {
+		"a0", "a1", "a2", "a3", "a4", "a5", "t0", "t1", "t2", "s0", "s1",
+	};
+	struct reg_param reg_params[ARRAY_SIZE(reg_names)];
+	unsigned int num_reg_params = crc_table ? ARRAY_SIZE(reg_names) : 2;
+
+	for (unsigned int i = 0; i < num_reg_params; i++) {
+		init_reg_param(&reg_params[i], reg_names[i], xlen,
+				i == 0 ? PARAM_IN_OUT : PARAM_OUT);
+		buf_set_u64(reg_params[i].value, 0, xlen, 0);
+	}
 	buf_set_u64(reg_params[0].value, 0, xlen, address);
 	buf_set_u64(reg_params[1].value, 0, xlen, count);
+	if (crc_table)
+		buf_set_u64(reg_params[2].value, 0, xlen, crc_table);
 
 	/* 20 second timeout/megabyte */
 	int timeout = 20000 * (1 + (count / (1024 * 1024)));
 
-	retval = target_run_algorithm(target, 0, NULL, 2, reg_params,
+	retval = target_run_algorithm(target, 0, NULL, num_reg_params, reg_params,
 			crc_algorithm->address,
 			0,	/* Leave exit point unspecified because we don't know. */
 			timeout, NULL);
@@ -2064,8 +2163,8 @@ static int riscv_checksum_memory(struct target *target,
 	else
 		LOG_ERROR("error executing RISC-V CRC algorithm");
 
-	destroy_reg_param(&reg_params[0]);
-	destroy_reg_param(&reg_params[1]);
+	for (unsigned int i = 0; i < num_reg_params; i++)
+		destroy_reg_param(&reg_params[i]);
 
 	target_free_working_area(target, crc_algorithm);
 
@@ -2133,6 +2232,183 @@ static int set_debug_reason(struct target *target, enum riscv_halt_reason halt_r
 	return ERROR_OK;
 }
 
+/* A file or the clients of a TCP port, the samples are streamed to. */
+struct riscv_sample_output {
+	/* the file name, or ':' and the port */
+	char *name;
+	FILE *file;
+	struct list_head connections;
+	/* the number of dropped samples last sent */
+	uint32_t dropped;
+};
+
+struct riscv_sample_connection {
+	struct list_head lh;
+	struct connection *connection;
+};
+
+/* the priv of the service, freed by remove_service() */
+struct riscv_sample_service {
+	struct riscv_sample_output *output;
+};
+
+#define RISCV_SAMPLE_SERVICE_NAME	"riscv_sample"
+#define RISCV_SAMPLE_BUF_SIZE		(64 * 1024)
+
+static int riscv_sample_new_connection(struct connection *connection)
+{
+	struct riscv_sample_service *service = connection->service->priv;
+	struct riscv_sample_connection *c = malloc(sizeof(*c));
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	c->connection = connection;
+	list_add(&c->lh, &service->output->connections);
+	return ERROR_OK;
+}
+
+static int riscv_sample_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int riscv_sample_connection_closed(struct connection *connection)
+{
+	struct riscv_sample_service *service = connection->service->priv;
+	struct riscv_sample_connection *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &service->output->connections, lh)
+		if (c->connection == connection) {
+			list_del(&c->lh);
+			free(c);
+			return ERROR_OK;
+		}
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
+}
+
+/* a client not keeping up loses the oldest samples, not the target */
+static const struct service_driver riscv_sample_service_driver = {
+	.name = RISCV_SAMPLE_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = riscv_sample_new_connection,
+	.input_handler = riscv_sample_input,
+	.connection_closed_handler = riscv_sample_connection_closed,
+	.keep_client_alive_handler = NULL,
+	.output_overflow = CONNECTION_OVERFLOW_DROP_OLDEST,
+};
+
+static void riscv_sample_output_close(struct riscv_sample_output *output)
+{
+	if (!output)
+		return;
+
+	if (output->file)
+		fclose(output->file);
+	else
+		remove_service(RISCV_SAMPLE_SERVICE_NAME, output->name + 1);
+
+	free(output->name);
+	free(output);
+}
+
+static int riscv_sample_output_open(struct riscv_sample_output **output, const char *name)
+{
+	struct riscv_sample_output *out = calloc(1, sizeof(*out));
+	if (!out) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	INIT_LIST_HEAD(&out->connections);
+
+	out->name = strdup(name);
+	if (!out->name) {
+		LOG_ERROR("Out of memory");
+		free(out);
+		return ERROR_FAIL;
+	}
+
+	if (name[0] == ':') {
+		struct riscv_sample_service *service = malloc(sizeof(*service));
+		if (!service) {
+			LOG_ERROR("Out of memory");
+			free(out->name);
+			free(out);
+			return ERROR_FAIL;
+		}
+		service->output = out;
+		int retval = add_service(&riscv_sample_service_driver, name + 1,
+				CONNECTION_LIMIT_UNLIMITED, service);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Can't configure the memory sample TCP port %s", name + 1);
+			free(out->name);
+			free(out);
+			return retval;
+		}
+	} else {
+		out->file = fopen(name, "ab");
+		if (!out->file) {
+			LOG_ERROR("Can't open the memory sample file \"%s\": %s", name,
+					strerror(errno));
+			free(out->name);
+			free(out);
+			return ERROR_FAIL;
+		}
+	}
+
+	*output = out;
+
+	return ERROR_OK;
+}
+
+static void riscv_sample_output_write(struct riscv_sample_output *output,
+		const uint8_t *data, size_t size)
+{
+	struct riscv_sample_connection *c;
+
+	if (output->file && fwrite(data, 1, size, output->file) != size)
+		LOG_ERROR("Error writing to the memory sample file \"%s\"", output->name);
+
+	list_for_each_entry(c, &output->connections, lh)
+		if (connection_write(c->connection, data, size) != (int)size)
+			LOG_ERROR("Error writing to a memory sample connection");
+}
+
+/* Stream the samples taken so far, and make room for the next ones. */
+static void riscv_sample_output_flush(struct target *target)
+{
+	RISCV_INFO(r);
+	struct riscv_sample_output *output = r->sample_output;
+
+	if (!output)
+		return;
+
+	if (r->sample_buf.dropped != output->dropped) {
+		uint8_t record[5] = { RISCV_SAMPLE_BUF_DROPPED };
+		h_u32_to_le(record + 1, r->sample_buf.dropped);
+		riscv_sample_output_write(output, record, sizeof(record));
+		output->dropped = r->sample_buf.dropped;
+	}
+
+	riscv_sample_output_write(output, r->sample_buf.buf, r->sample_buf.used);
+	if (output->file)
+		fflush(output->file);
+
+	r->sample_buf.used = 0;
+}
+
 static int sample_memory(struct target *target)
 {
 	RISCV_INFO(r);
@@ -2155,24 +2431,28 @@ static int sample_memory(struct target *target)
 	/* Default slow path. */
 	while (timeval_ms() - start < TARGET_DEFAULT_POLLING_INTERVAL) {
 		for (unsigned int i = 0; i < ARRAY_SIZE(r->sample_config.bucket); i++) {
-			if (r->sample_config.bucket[i].enabled &&
-					r->sample_buf.used + 1 + r->sample_config.bucket[i].size_bytes < r->sample_buf.size) {
-				assert(i < RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE);
-				r->sample_buf.buf[r->sample_buf.used] = i;
-				result = riscv_read_phys_memory(
-					target, r->sample_config.bucket[i].address,
-					r->sample_config.bucket[i].size_bytes, 1,
-					r->sample_buf.buf + r->sample_buf.used + 1);
-				if (result == ERROR_OK)
-					r->sample_buf.used += 1 + r->sample_config.bucket[i].size_bytes;
-				else
-					goto exit;
+			if (!r->sample_config.bucket[i].enabled)
+				continue;
+			if (r->sample_buf.used + 1 + r->sample_config.bucket[i].size_bytes >=
+					r->sample_buf.size) {
+				r->sample_buf.dropped++;
+				goto exit;
 			}
+			assert(i < RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE);
+			r->sample_buf.buf[r->sample_buf.used] = i;
+			result = riscv_read_phys_memory(target, r->sample_config.bucket[i].address,
+				r->sample_config.bucket[i].size_bytes, 1,
+				r->sample_buf.buf + r->sample_buf.used + 1);
+			if (result == ERROR_OK)
+				r->sample_buf.used += 1 + r->sample_config.bucket[i].size_bytes;
+			else
+				goto exit;
 		}
 	}
 
 exit:
 	riscv_sample_buf_maybe_add_timestamp(target, false);
+	riscv_sample_output_flush(target);
 	if (result != ERROR_OK) {
 		LOG_INFO("Turning off memory sampling because it failed.");
 		r->sample_config.enabled = false;
@@ -2351,6 +2631,26 @@ COMMAND_HANDLER(riscv_set_command_timeout_sec)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(riscv_set_batch_scans)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int scans;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], scans);
+		if (scans == 0 || scans > RISCV_BATCH_SCANS_LIMIT) {
+			LOG_ERROR("the number of scans must be 1 .. %u", RISCV_BATCH_SCANS_LIMIT);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		riscv_batch_scans_max = scans;
+	}
+
+	command_print(CMD, "%u", riscv_batch_scans_max);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(riscv_set_reset_timeout_sec)
 {
 	if (CMD_ARGC != 1) {
@@ -2863,6 +3163,149 @@ COMMAND_HANDLER(handle_info)
 	return 0;
 }
 
+COMMAND_HANDLER(handle_memory_sample_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "Memory sample configuration for %s:", target_name(target));
+		for (unsigned int i = 0; i < ARRAY_SIZE(r->sample_config.bucket); i++) {
+			if (r->sample_config.bucket[i].enabled)
+				command_print(CMD, "bucket %d; address=0x%" TARGET_PRIxADDR "; size=%d", i,
+						r->sample_config.bucket[i].address,
+						r->sample_config.bucket[i].size_bytes);
+			else
+				command_print(CMD, "bucket %d; unused", i);
+		}
+		command_print(CMD, "dropped samples: %" PRIu32, r->sample_buf.dropped);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC < 2 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint32_t bucket;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], bucket);
+	if (bucket >= ARRAY_SIZE(r->sample_config.bucket)) {
+		command_print(CMD, "Max bucket number is %zu.", ARRAY_SIZE(r->sample_config.bucket) - 1);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (!strcmp(CMD_ARGV[1], "clear")) {
+		r->sample_config.bucket[bucket].enabled = false;
+	} else {
+		target_addr_t address;
+		uint32_t size_bytes = 4;
+
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
+		if (CMD_ARGC > 2)
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], size_bytes);
+		if (size_bytes != 1 && size_bytes != 2 && size_bytes != 4 && size_bytes != 8) {
+			command_print(CMD, "Only 1, 2, 4 and 8 byte sizes are supported.");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+
+		r->sample_config.bucket[bucket].address = address;
+		r->sample_config.bucket[bucket].size_bytes = size_bytes;
+		r->sample_config.bucket[bucket].enabled = true;
+	}
+
+	if (!r->sample_buf.buf) {
+		r->sample_buf.buf = malloc(RISCV_SAMPLE_BUF_SIZE);
+		if (!r->sample_buf.buf) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		r->sample_buf.size = RISCV_SAMPLE_BUF_SIZE;
+	}
+
+	r->sample_config.enabled = false;
+	for (unsigned int i = 0; i < ARRAY_SIZE(r->sample_config.bucket); i++)
+		r->sample_config.enabled |= r->sample_config.bucket[i].enabled;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_dump_sample_buf_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int i = 0;
+	while (i < r->sample_buf.used) {
+		uint8_t command = r->sample_buf.buf[i++];
+
+		if (command == RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE ||
+				command == RISCV_SAMPLE_BUF_TIMESTAMP_AFTER) {
+			command_print(CMD, "timestamp %s: %" PRIu32,
+					command == RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE ? "before" : "after",
+					le_to_h_u32(r->sample_buf.buf + i));
+			i += 4;
+		} else if (command < ARRAY_SIZE(r->sample_config.bucket)) {
+			unsigned int size_bytes = r->sample_config.bucket[command].size_bytes;
+			uint64_t value = buf_get_u64(r->sample_buf.buf + i, 0, 8 * size_bytes);
+
+			command_print(CMD, "0x%" TARGET_PRIxADDR ": 0x%0*" PRIx64,
+					r->sample_config.bucket[command].address, 2 * size_bytes, value);
+			i += size_bytes;
+		} else {
+			LOG_ERROR("Found invalid value in sample buf: 0x%x", command);
+			break;
+		}
+	}
+	if (r->sample_buf.dropped)
+		command_print(CMD, "dropped: %" PRIu32, r->sample_buf.dropped);
+
+	/* Clear the sample buffer even when there was an error. */
+	r->sample_buf.used = 0;
+	if (!r->sample_output)
+		r->sample_buf.dropped = 0;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sample_output_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		riscv_sample_output_close(r->sample_output);
+		r->sample_output = NULL;
+
+		if (strcmp(CMD_ARGV[0], "none")) {
+			int retval = riscv_sample_output_open(&r->sample_output, CMD_ARGV[0]);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	command_print(CMD, "%s", r->sample_output ? r->sample_output->name : "none");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_stats)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (r->print_stats)
+		return CALL_COMMAND_HANDLER(r->print_stats, target);
+
+	return 0;
+}
+
 static const struct command_registration riscv_exec_command_handlers[] = {
 	{
 		.name = "info",
@@ -2871,6 +3314,38 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 		.usage = "",
 		.help = "Displays some information OpenOCD detected about the target."
 	},
+	{
+		.name = "memory_sample",
+		.handler = handle_memory_sample_command,
+		.mode = COMMAND_ANY,
+		.usage = "[bucket (address|'clear') [size]]",
+		.help = "Sample the memory at the address, while the target is "
+			"running, into the bucket (0 to 15), or stop sampling it. "
+			"Without arguments, display the buckets."
+	},
+	{
+		.name = "dump_sample_buf",
+		.handler = handle_dump_sample_buf_command,
+		.mode = COMMAND_ANY,
+		.usage = "",
+		.help = "Display the samples taken since the last dump, and clear them."
+	},
+	{
+		.name = "memory_sample_output",
+		.handler = handle_memory_sample_output_command,
+		.mode = COMMAND_EXEC,
+		.usage = "[(filename|:port|'none')]",
+		.help = "Stream the samples to the file or to the clients of the "
+			"TCP port, instead of keeping them for dump_sample_buf."
+	},
+	{
+		.name = "stats",
+		.handler = handle_stats,
+		.mode = COMMAND_EXEC,
+		.usage = "",
+		.help = "Displays the run-test/idle delays of the accesses to the "
+			"target, and the busy responses that grew them."
+	},
 	{
 		.name = "set_command_timeout_sec",
 		.handler = riscv_set_command_timeout_sec,
@@ -2878,6 +3353,14 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 		.usage = "[sec]",
 		.help = "Set the wall-clock timeout (in seconds) for individual commands"
 	},
+	{
+		.name = "set_batch_scans",
+		.handler = riscv_set_batch_scans,
+		.mode = COMMAND_ANY,
+		.usage = "[scans]",
+		.help = "Set the largest number of scans queued at once by the "
+			"memory accesses"
+	},
 	{
 		.name = "set_reset_timeout_sec",
 		.handler = riscv_set_reset_timeout_sec,
@@ -3108,6 +3591,8 @@ struct target_type riscv_target = {
 
 	.arch_state = riscv_arch_state,
 
+	.start_algorithm = riscv_start_algorithm,
+	.wait_algorithm = riscv_wait_algorithm,
 	.run_algorithm = riscv_run_algorithm,
 
 	.commands = riscv_command_handlers,
@@ -3786,6 +4271,34 @@ static int cmp_csr_info(const void *p1, const void *p2)
 	return (int) (((struct csr_info *)p1)->number) - (int) (((struct csr_info *)p2)->number);
 }
 
+static struct csr_info csr_info[] = {
+#define DECLARE_CSR(name, number) { number, #name },
+#include "encoding.h"
+#undef DECLARE_CSR
+};
+
+/* The names that do not depend on the configuration of a hart, shared by all
+ * the register caches so that they are built only once. */
+static char riscv_csr_names[GDB_REGNO_CSR4095 - GDB_REGNO_CSR0 + 1][sizeof("csr4095")];
+static char riscv_vector_names[GDB_REGNO_V31 - GDB_REGNO_V0 + 1][sizeof("v31")];
+
+static void riscv_init_shared_names(void)
+{
+	static bool initialized;
+
+	if (initialized)
+		return;
+	initialized = true;
+
+	/* encoding.h does not contain the registers in sorted order. */
+	qsort(csr_info, ARRAY_SIZE(csr_info), sizeof(*csr_info), cmp_csr_info);
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(riscv_csr_names); i++)
+		sprintf(riscv_csr_names[i], "csr%u", i);
+	for (unsigned int i = 0; i < ARRAY_SIZE(riscv_vector_names); i++)
+		sprintf(riscv_vector_names[i], "v%u", i);
+}
+
 int riscv_init_registers(struct target *target)
 {
 	RISCV_INFO(info);
@@ -3812,12 +4325,18 @@ int riscv_init_registers(struct target *target)
 	if (!target->reg_cache->reg_list)
 		return ERROR_FAIL;
 
+	riscv_init_shared_names();
+
+	/* Only the custom registers need names of their own. */
 	const unsigned int max_reg_name_len = 12;
+	const unsigned int num_custom_regs = target->reg_cache->num_regs - GDB_REGNO_COUNT;
 	free(info->reg_names);
-	info->reg_names =
-		calloc(target->reg_cache->num_regs, max_reg_name_len);
-	if (!info->reg_names)
-		return ERROR_FAIL;
+	info->reg_names = NULL;
+	if (num_custom_regs) {
+		info->reg_names = calloc(num_custom_regs, max_reg_name_len);
+		if (!info->reg_names)
+			return ERROR_FAIL;
+	}
 	char *reg_name = info->reg_names;
 
 	static struct reg_feature feature_cpu = {
@@ -3950,16 +4469,10 @@ int riscv_init_registers(struct target *target)
 	info->type_vector.type_class = REG_TYPE_CLASS_UNION;
 	info->type_vector.reg_type_union = &info->vector_union;
 
-	struct csr_info csr_info[] = {
-#define DECLARE_CSR(name, number) { number, #name },
-#include "encoding.h"
-#undef DECLARE_CSR
-	};
-	/* encoding.h does not contain the registers in sorted order. */
-	qsort(csr_info, ARRAY_SIZE(csr_info), sizeof(*csr_info), cmp_csr_info);
 	unsigned csr_info_index = 0;
 
 	int custom_within_range = 0;
+	size_t values_size = 0;
 
 	riscv_reg_info_t *shared_reg_info = calloc(1, sizeof(riscv_reg_info_t));
 	if (!shared_reg_info)
@@ -4092,7 +4605,7 @@ int riscv_init_registers(struct target *target)
 			r->feature = &feature_cpu;
 		} else if (number == GDB_REGNO_PC) {
 			r->caller_save = true;
-			sprintf(reg_name, "pc");
+			r->name = "pc";
 			r->group = "general";
 			r->feature = &feature_cpu;
 		} else if (number >= GDB_REGNO_FPR0 && number <= GDB_REGNO_FPR31) {
@@ -4221,7 +4734,7 @@ int riscv_init_registers(struct target *target)
 			if (csr_info[csr_info_index].number == csr_number) {
 				r->name = csr_info[csr_info_index].name;
 			} else {
-				sprintf(reg_name, "csr%d", csr_number);
+				r->name = riscv_csr_names[csr_number];
 				/* Assume unnamed registers don't exist, unless we have some
 				 * configuration that tells us otherwise. That's important
 				 * because eg. Eclipse crashes if a target has too many
@@ -4341,13 +4854,11 @@ int riscv_init_registers(struct target *target)
 				range_list_t *entry;
 				list_for_each_entry(entry, &info->expose_csr, list)
 					if ((entry->low <= csr_number) && (csr_number <= entry->high)) {
-						if (entry->name) {
-							*reg_name = 0;
+						if (entry->name)
 							r->name = entry->name;
-						}
 
 						LOG_DEBUG("Exposing additional CSR %d (name=%s)",
-								csr_number, entry->name ? entry->name : reg_name);
+								csr_number, r->name);
 
 						r->exist = true;
 						break;
@@ -4355,7 +4866,7 @@ int riscv_init_registers(struct target *target)
 			}
 
 		} else if (number == GDB_REGNO_PRIV) {
-			sprintf(reg_name, "priv");
+			r->name = "priv";
 			r->group = "general";
 			r->feature = &feature_virtual;
 			r->size = 8;
@@ -4364,7 +4875,7 @@ int riscv_init_registers(struct target *target)
 			r->caller_save = false;
 			r->exist = riscv_supports_extension(target, 'V') && info->vlenb;
 			r->size = info->vlenb * 8;
-			sprintf(reg_name, "v%d", number - GDB_REGNO_V0);
+			r->name = riscv_vector_names[number - GDB_REGNO_V0];
 			r->group = "vector";
 			r->feature = &feature_vector;
 			r->reg_data_type = &info->type_vector;
@@ -4384,15 +4895,17 @@ int riscv_init_registers(struct target *target)
 				return ERROR_FAIL;
 			((riscv_reg_info_t *) r->arch_info)->target = target;
 			((riscv_reg_info_t *) r->arch_info)->custom_number = custom_number;
-			sprintf(reg_name, "custom%d", custom_number);
-
 			if (range->name) {
-				*reg_name = 0;
 				r->name = range->name;
+			} else {
+				sprintf(reg_name, "custom%d", custom_number);
+				r->name = reg_name;
+				reg_name += strlen(reg_name) + 1;
+				assert(reg_name <= info->reg_names + num_custom_regs * max_reg_name_len);
 			}
 
 			LOG_DEBUG("Exposing additional custom register %d (name=%s)",
-					number, range->name ? range->name : reg_name);
+					number, r->name);
 
 			custom_within_range++;
 			if (custom_within_range > range->high - range->low) {
@@ -4401,13 +4914,18 @@ int riscv_init_registers(struct target *target)
 			}
 		}
 
-		if (reg_name[0]) {
-			r->name = reg_name;
-			reg_name += strlen(reg_name) + 1;
-			assert(reg_name < info->reg_names + target->reg_cache->num_regs *
-					max_reg_name_len);
-		}
-		r->value = calloc(1, DIV_ROUND_UP(r->size, 8));
+		values_size += DIV_ROUND_UP(r->size, 8);
+	}
+
+	/* Allocate the values of all the registers at once, instead of one
+	 * small block per register. */
+	uint8_t *value = calloc(1, values_size);
+	if (!value)
+		return ERROR_FAIL;
+	for (uint32_t number = 0; number < target->reg_cache->num_regs; number++) {
+		struct reg *r = &target->reg_cache->reg_list[number];
+		r->value = value;
+		value += DIV_ROUND_UP(r->size, 8);
 	}
 
 	return ERROR_OK;
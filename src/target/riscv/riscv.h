@@ -4,6 +4,8 @@
 #define RISCV_H
 
 struct riscv_program;
+struct riscv_batch;
+struct riscv_sample_output;
 
 #include <stdint.h>
 #include "opcodes.h"
@@ -64,12 +66,18 @@ typedef struct {
 	unsigned custom_number;
 } riscv_reg_info_t;
 
+/* The records of the sample buffer: the bucket number followed by the value
+ * read, little endian, or one of these followed by 4 bytes little endian. */
 #define RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE	0x80
 #define RISCV_SAMPLE_BUF_TIMESTAMP_AFTER	0x81
+/* the total number of samples dropped so far, only in the output streams */
+#define RISCV_SAMPLE_BUF_DROPPED		0x82
 struct riscv_sample_buf {
 	uint8_t *buf;
 	unsigned int used;
 	unsigned int size;
+	/* samples not taken as the buffer was full */
+	uint32_t dropped;
 };
 
 typedef struct {
@@ -105,6 +113,9 @@ struct riscv_info {
 	 * malloc for each register. Needs to be freed when reg_list is freed. */
 	char *reg_names;
 
+	/* Batches freed by riscv_batch_free(), kept for the next ones. */
+	struct riscv_batch *batch_pool;
+
 	/* It's possible that each core has a different supported ISA set. */
 	int xlen;
 	riscv_reg_t misa;
@@ -181,12 +192,15 @@ struct riscv_info {
 
 	int (*read_memory)(struct target *target, target_addr_t address,
 			uint32_t size, uint32_t count, uint8_t *buffer, uint32_t increment);
+	/* Can memory be read and written while the hart is running? */
+	bool (*access_memory_running)(struct target *target);
 
 	/* How many harts are attached to the DM that this target is attached to? */
 	int (*hart_count)(struct target *target);
 	unsigned (*data_bits)(struct target *target);
 
 	COMMAND_HELPER((*print_info), struct target *target);
+	COMMAND_HELPER((*print_stats), struct target *target);
 
 	/* Storage for vector register types. */
 	struct reg_data_type_vector vector_uint8;
@@ -226,6 +240,14 @@ struct riscv_info {
 
 	riscv_sample_config_t sample_config;
 	struct riscv_sample_buf sample_buf;
+	/* Where the samples are streamed to, NULL to keep them in sample_buf. */
+	struct riscv_sample_output *sample_output;
+
+	/* The pc, the argument registers and mstatus of the program stopped
+	 * by riscv_start_algorithm(), restored by riscv_wait_algorithm(). */
+	uint64_t algorithm_saved_pc;
+	uint64_t algorithm_saved_regs[32];
+	uint64_t algorithm_saved_mstatus;
 };
 
 COMMAND_HELPER(riscv_print_info_line, const char *section, const char *key,
@@ -255,6 +277,10 @@ extern int riscv_command_timeout_sec;
 /* Wall-clock timeout after reset. Settable via RISC-V Target commands.*/
 extern int riscv_reset_timeout_sec;
 
+/* Largest number of scans of the batches of the memory accesses. Settable via
+ * RISC-V Target commands. */
+extern unsigned int riscv_batch_scans_max;
+
 extern bool riscv_enable_virtual;
 extern bool riscv_ebreakm;
 extern bool riscv_ebreaks;
@@ -333,6 +359,10 @@ int riscv_get_register(struct target *target, riscv_reg_t *value,
  * on-device register. */
 bool riscv_is_halted(struct target *target);
 
+/* Can the memory be accessed while the hart runs, e.g. by the async flash
+ * algorithms? */
+bool riscv_access_memory_running(struct target *target);
+
 /* These helper functions let the generic program interface get target-specific
  * information. */
 size_t riscv_debug_buffer_size(struct target *target);
@@ -13,10 +13,23 @@
 #include <helper/log.h>
 #include <helper/binarybuffer.h>
 #include <helper/command.h>
+#include <helper/metrics.h>
 #include <rtt/rtt.h>
 
 #include "target.h"
 
+static void decode_rtt_channel(target_addr_t address, const uint8_t *buf,
+		struct rtt_channel *channel)
+{
+	channel->address = address;
+	channel->name_addr = buf_get_u32(buf + 0, 0, 32);
+	channel->buffer_addr = buf_get_u32(buf + 4, 0, 32);
+	channel->size = buf_get_u32(buf + 8, 0, 32);
+	channel->write_pos = buf_get_u32(buf + 12, 0, 32);
+	channel->read_pos = buf_get_u32(buf + 16, 0, 32);
+	channel->flags = buf_get_u32(buf + 20, 0, 32);
+}
+
 static int read_rtt_channel(struct target *target,
 		const struct rtt_control *ctrl, unsigned int channel_index,
 		enum rtt_channel_type type, struct rtt_channel *channel)
@@ -35,13 +48,7 @@ static int read_rtt_channel(struct target *target,
 	if (ret != ERROR_OK)
 		return ret;
 
-	channel->address = address;
-	channel->name_addr = buf_get_u32(buf + 0, 0, 32);
-	channel->buffer_addr = buf_get_u32(buf + 4, 0, 32);
-	channel->size = buf_get_u32(buf + 8, 0, 32);
-	channel->write_pos = buf_get_u32(buf + 12, 0, 32);
-	channel->read_pos = buf_get_u32(buf + 16, 0, 32);
-	channel->flags = buf_get_u32(buf + 20, 0, 32);
+	decode_rtt_channel(address, buf, channel);
 
 	return ERROR_OK;
 }
@@ -178,6 +185,11 @@ static bool channel_is_active(const struct rtt_channel *channel)
 	return true;
 }
 
+static struct metric rtt_up_bytes_metric = METRIC_COUNTER("rtt_up_bytes_total",
+		"Bytes read from the RTT up-channels");
+static struct metric rtt_down_bytes_metric = METRIC_COUNTER("rtt_down_bytes_total",
+		"Bytes written to the RTT down-channels");
+
 int target_rtt_write_callback(struct target *target, struct rtt_control *ctrl,
 		unsigned int channel_index, const uint8_t *buffer, size_t *length,
 		void *user_data)
@@ -212,6 +224,7 @@ int target_rtt_write_callback(struct target *target, struct rtt_control *ctrl,
 
 	LOG_DEBUG("rtt: Wrote %zu bytes into down-channel %u", *length,
 		channel_index);
+	metric_add(&rtt_down_bytes_metric, *length);
 
 	return ERROR_OK;
 }
@@ -364,26 +377,48 @@ static int read_from_channel(struct target *target,
 
 int target_rtt_read_callback(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data)
+		struct rtt_channel_stats *stats, size_t num_channels,
+		void *user_data)
 {
+	int ret;
+
 	num_channels = MIN(num_channels, ctrl->num_up_channels);
 
+	/* Only up to the last channel with a sink */
+	while (num_channels > 0 && !sinks[num_channels - 1])
+		num_channels--;
+
+	if (!num_channels)
+		return ERROR_OK;
+
+	/* The descriptors of the up-channels are read at once */
+	const target_addr_t descs_addr = ctrl->address + RTT_CB_SIZE;
+	uint8_t *descs = malloc(num_channels * RTT_CHANNEL_SIZE);
+
+	if (!descs) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	ret = target_read_buffer(target, descs_addr,
+		num_channels * RTT_CHANNEL_SIZE, descs);
+
+	if (ret != ERROR_OK) {
+		LOG_ERROR("rtt: Failed to read up-channel descriptions");
+		free(descs);
+		return ret;
+	}
+
 	for (size_t i = 0; i < num_channels; i++) {
-		int ret;
 		struct rtt_channel channel;
-		uint8_t buffer[1024];
+		uint8_t *buffer;
 		size_t length;
 
 		if (!sinks[i])
 			continue;
 
-		ret = read_rtt_channel(target, ctrl, i, RTT_CHANNEL_TYPE_UP,
-			&channel);
-
-		if (ret != ERROR_OK) {
-			LOG_ERROR("rtt: Failed to read up-channel %zu description", i);
-			return ret;
-		}
+		decode_rtt_channel(descs_addr + i * RTT_CHANNEL_SIZE,
+			descs + i * RTT_CHANNEL_SIZE, &channel);
 
 		if (!channel_is_active(&channel)) {
 			LOG_WARNING("rtt: Up-channel %zu is not active", i);
@@ -395,17 +430,58 @@ int target_rtt_read_callback(struct target *target,
 			continue;
 		}
 
-		length = sizeof(buffer);
+		/* One byte of the buffer is never used, to tell full from empty */
+		const uint32_t fill = (channel.write_pos + channel.size -
+			channel.read_pos) % channel.size;
+
+		if (stats) {
+			stats[i].last_fill_percent = fill * 100 / (channel.size - 1);
+			stats[i].max_fill = MAX(stats[i].max_fill, fill);
+
+			if (fill)
+				stats[i].polls_with_data++;
+
+			if (fill == channel.size - 1)
+				stats[i].polls_full++;
+		}
+
+		if (!fill)
+			continue;
+
+		/*
+		 * All of the pending data is read at once, and the same buffer is
+		 * handed to every sink, which queue their output without blocking.
+		 */
+		length = MIN(fill, channel.size);
+		buffer = malloc(length);
+
+		if (!buffer) {
+			LOG_ERROR("Out of memory");
+			free(descs);
+			return ERROR_FAIL;
+		}
+
 		ret = read_from_channel(target, &channel, buffer, &length);
 
 		if (ret != ERROR_OK) {
 			LOG_ERROR("rtt: Failed to read from up-channel %zu", i);
+			free(buffer);
+			free(descs);
 			return ret;
 		}
 
+		metric_add(&rtt_up_bytes_metric, length);
+
+		if (stats)
+			stats[i].bytes += length;
+
 		for (struct rtt_sink_list *sink = sinks[i]; sink; sink = sink->next)
 			sink->read(i, buffer, length, sink->user_data);
+
+		free(buffer);
 	}
 
+	free(descs);
+
 	return ERROR_OK;
 }
@@ -103,6 +103,8 @@ extern int gdb_actual_connections;
  * @param post_result
  * @return An error status if there is a problem during initialization.
  */
+static int semihosting_console_timer(void *priv);
+
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result)
 {
@@ -146,19 +148,33 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->setup = setup;
 	semihosting->post_result = post_result;
 	semihosting->user_command_extension = NULL;
+	semihosting->console_len = 0;
+	semihosting->readahead_fd = -1;
+	semihosting->readahead_buf = NULL;
+	semihosting->readahead_head = 0;
+	semihosting->readahead_len = 0;
 
 	target->semihosting = semihosting;
 
+	target_register_timer_callback(semihosting_console_timer,
+		SEMIHOSTING_CONSOLE_FLUSH_MS, TARGET_TIMER_TYPE_PERIODIC, semihosting);
+
 	target->type->get_gdb_fileio_info = semihosting_common_fileio_info;
 	target->type->gdb_fileio_end = semihosting_common_fileio_end;
 
 	return ERROR_OK;
 }
 
+/* input of the client not yet read by the target, beyond it the client waits */
+#define SEMIHOSTING_TCP_INPUT_SIZE 4096
+
 struct semihosting_tcp_service {
 	struct semihosting *semihosting;
 	char *name;
 	int error;
+	uint8_t input[SEMIHOSTING_TCP_INPUT_SIZE];
+	unsigned int input_head;
+	unsigned int input_len;
 };
 
 static bool semihosting_is_redirected(struct semihosting *semihosting, int fd)
@@ -228,6 +244,34 @@ static ssize_t semihosting_write(struct semihosting *semihosting, int fd, void *
 	return write(fd, buf, size);
 }
 
+/* Buffer the input the client has sent so far, without waiting for more */
+static int semihosting_tcp_read_input(struct connection *connection)
+{
+	struct semihosting_tcp_service *service = connection->service->priv;
+
+	if (service->error != ERROR_OK)
+		return service->error;
+
+	if (service->input_head > 0) {
+		memmove(service->input, service->input + service->input_head, service->input_len);
+		service->input_head = 0;
+	}
+
+	unsigned int room = sizeof(service->input) - service->input_len;
+	if (room) {
+		int n = connection_read_nowait(connection, service->input + service->input_len, room);
+		if (n < 0)
+			service->error = ERROR_SERVER_REMOTE_CLOSED;
+		else
+			service->input_len += n;
+	}
+
+	/* let the client wait until the target has read the buffered input */
+	connection_pause_input(connection, service->input_len == sizeof(service->input));
+
+	return service->error;
+}
+
 static ssize_t semihosting_redirect_read(struct semihosting *semihosting, void *buf, int size)
 {
 	if (!semihosting->tcp_connection) {
@@ -236,31 +280,145 @@ static ssize_t semihosting_redirect_read(struct semihosting *semihosting, void *
 		return -1;
 	}
 
-	struct semihosting_tcp_service *service = semihosting->tcp_connection->service->priv;
+	struct connection *connection = semihosting->tcp_connection;
+	struct semihosting_tcp_service *service = connection->service->priv;
 
-	service->error = ERROR_OK;
-	semihosting->tcp_connection->input_pending = true;
+	/* return what is buffered, only wait for the client when there is nothing */
+	if (!service->input_len && service->error == ERROR_OK) {
+		if (connection_wait_input(connection) != ERROR_OK) {
+			log_socket_error(service->name);
+			service->error = ERROR_SERVER_REMOTE_CLOSED;
+		} else {
+			semihosting_tcp_read_input(connection);
+		}
+	}
 
-	int retval = connection_read(semihosting->tcp_connection, buf, size);
+	/* the server closes the connection, the target sees the end of file */
+	if (!service->input_len)
+		return 0;
 
-	if (retval <= 0)
-		service->error = ERROR_SERVER_REMOTE_CLOSED;
+	unsigned int n = MIN(service->input_len, (unsigned int)size);
+	memcpy(buf, service->input + service->input_head, n);
+	service->input_head += n;
+	service->input_len -= n;
+	if (!service->input_len)
+		service->input_head = 0;
 
-	if (retval < 0)
-		log_socket_error(service->name);
+	connection_pause_input(connection, false);
 
-	semihosting->tcp_connection->input_pending = false;
+	return n;
+}
 
-	return retval;
+/* the debug channel is redirected for the CFG DEBUG and ALL */
+static bool semihosting_console_is_redirected(struct semihosting *semihosting)
+{
+	return semihosting->redirect_cfg == SEMIHOSTING_REDIRECT_CFG_DEBUG ||
+		semihosting->redirect_cfg == SEMIHOSTING_REDIRECT_CFG_ALL;
 }
 
-static inline int semihosting_putchar(struct semihosting *semihosting, int fd, int c)
+static void semihosting_console_flush(struct semihosting *semihosting)
 {
-	if (semihosting_is_redirected(semihosting, fd))
-		return semihosting_redirect_write(semihosting, &c, 1);
+	if (!semihosting->console_len)
+		return;
+
+	if (semihosting_console_is_redirected(semihosting)) {
+		semihosting_redirect_write(semihosting, semihosting->console_buf,
+			semihosting->console_len);
+	} else {
+		fwrite(semihosting->console_buf, 1, semihosting->console_len, stdout);
+		fflush(stdout);
+	}
+
+	semihosting->console_len = 0;
+}
 
-	/* default putchar */
-	return putchar(c);
+static int semihosting_console_timer(void *priv)
+{
+	semihosting_console_flush(priv);
+	return ERROR_OK;
+}
+
+/* Buffer the output of the debug channel, up to the end of a line */
+static void semihosting_console_write(struct semihosting *semihosting,
+	const char *buf, size_t size)
+{
+	while (size) {
+		size_t len = MIN(size, SEMIHOSTING_CONSOLE_BUF_SIZE - semihosting->console_len);
+		const char *nl = memchr(buf, '\n', len);
+
+		if (nl)
+			len = nl - buf + 1;
+
+		memcpy(semihosting->console_buf + semihosting->console_len, buf, len);
+		semihosting->console_len += len;
+		buf += len;
+		size -= len;
+
+		if (nl || semihosting->console_len == SEMIHOSTING_CONSOLE_BUF_SIZE)
+			semihosting_console_flush(semihosting);
+	}
+}
+
+#define SEMIHOSTING_STR_CHUNK	64
+
+/**
+ * Read a null-terminated string from the target, in chunks that do not
+ * cross a SEMIHOSTING_STR_CHUNK boundary so the read does not go past
+ * the memory region of the string. Calls @a cb for each chunk of the
+ * string, without the terminator.
+ */
+
+static int semihosting_read_string(struct target *target, uint64_t addr,
+	void (*cb)(struct semihosting *semihosting, const char *buf, size_t size))
+{
+	struct semihosting *semihosting = target->semihosting;
+	char buf[SEMIHOSTING_STR_CHUNK];
+
+	for (;;) {
+		size_t len = SEMIHOSTING_STR_CHUNK - (addr % SEMIHOSTING_STR_CHUNK);
+
+		int retval = target_read_buffer(target, addr, len, (uint8_t *)buf);
+		if (retval != ERROR_OK) {
+			/* e.g. the end of the memory within the chunk */
+			len = 1;
+			retval = target_read_buffer(target, addr, len, (uint8_t *)buf);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		const char *end = memchr(buf, '\0', len);
+		if (end)
+			len = end - buf;
+		if (len)
+			cb(semihosting, buf, len);
+		if (end)
+			return ERROR_OK;
+		addr += len;
+	}
+}
+
+static void semihosting_count_string(struct semihosting *semihosting,
+	const char *buf, size_t size)
+{
+	semihosting->result += size;
+}
+
+/**
+ * Flush the console output and release the semihosting state of a target.
+ */
+void semihosting_common_free(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+
+	if (!semihosting)
+		return;
+
+	semihosting_console_flush(semihosting);
+	target_unregister_timer_callback(semihosting_console_timer, semihosting);
+	free(semihosting->readahead_buf);
+	free(semihosting->basedir);
+	free(semihosting);
+	target->semihosting = NULL;
 }
 
 static inline ssize_t semihosting_read(struct semihosting *semihosting, int fd, void *buf, int size)
@@ -275,6 +433,79 @@ static inline ssize_t semihosting_read(struct semihosting *semihosting, int fd,
 	return result;
 }
 
+/*
+ * Forget the read-ahead of @a fd, or of any file if @a fd is -1. With
+ * @a rewind, the host file offset is moved back to the one of the target.
+ */
+static void semihosting_readahead_drop(struct semihosting *semihosting, int fd, bool rewind)
+{
+	if (semihosting->readahead_fd < 0 || (fd >= 0 && semihosting->readahead_fd != fd))
+		return;
+
+	size_t unread = semihosting->readahead_len - semihosting->readahead_head;
+	if (rewind && unread)
+		lseek(semihosting->readahead_fd, -(off_t)unread, SEEK_CUR);
+
+	semihosting->readahead_fd = -1;
+	semihosting->readahead_head = 0;
+	semihosting->readahead_len = 0;
+}
+
+/*
+ * Read a regular file through the read-ahead, so that a firmware reading a
+ * file in small pieces does not cost a host read for each; the reads of at
+ * least a whole read-ahead go straight to the file.
+ */
+static ssize_t semihosting_read_file(struct semihosting *semihosting, int fd, uint8_t *buf, size_t size)
+{
+	struct stat st;
+
+	if (semihosting->readahead_fd != fd) {
+		semihosting_readahead_drop(semihosting, -1, true);
+
+		if (semihosting_is_redirected(semihosting, fd) || fstat(fd, &st) || !S_ISREG(st.st_mode))
+			return semihosting_read(semihosting, fd, buf, size);
+
+		if (!semihosting->readahead_buf) {
+			semihosting->readahead_buf = malloc(SEMIHOSTING_IO_CHUNK_SIZE);
+			if (!semihosting->readahead_buf)
+				return semihosting_read(semihosting, fd, buf, size);
+		}
+		semihosting->readahead_fd = fd;
+	}
+
+	size_t done = 0;
+	while (done < size) {
+		if (semihosting->readahead_head == semihosting->readahead_len) {
+			ssize_t n;
+
+			if (size - done >= SEMIHOSTING_IO_CHUNK_SIZE) {
+				n = semihosting_read(semihosting, fd, buf + done, size - done);
+				if (n < 0)
+					return done ? (ssize_t)done : n;
+				return done + n;
+			}
+
+			n = semihosting_read(semihosting, fd, semihosting->readahead_buf,
+				SEMIHOSTING_IO_CHUNK_SIZE);
+			if (n < 0)
+				return done ? (ssize_t)done : n;
+			semihosting->readahead_head = 0;
+			semihosting->readahead_len = n;
+			/* end of file */
+			if (!n)
+				break;
+		}
+
+		size_t n = MIN(semihosting->readahead_len - semihosting->readahead_head, size - done);
+		memcpy(buf + done, semihosting->readahead_buf + semihosting->readahead_head, n);
+		semihosting->readahead_head += n;
+		done += n;
+	}
+
+	return done;
+}
+
 static inline int semihosting_getchar(struct semihosting *semihosting, int fd)
 {
 	if (semihosting_is_redirected(semihosting, fd)) {
@@ -328,6 +559,11 @@ int semihosting_common(struct target *target)
 	LOG_DEBUG("op=0x%x, param=0x%" PRIx64, semihosting->op,
 		semihosting->param);
 
+	/* keep the order of the console output with any other I/O */
+	if (semihosting->op != SEMIHOSTING_SYS_WRITEC &&
+			semihosting->op != SEMIHOSTING_SYS_WRITE0)
+		semihosting_console_flush(semihosting);
+
 	switch (semihosting->op) {
 
 		case SEMIHOSTING_SYS_CLOCK:	/* 0x10 */
@@ -404,6 +640,7 @@ int semihosting_common(struct target *target)
 					fileio_info->identifier = "close";
 					fileio_info->param_1 = fd;
 				} else {
+					semihosting_readahead_drop(semihosting, fd, false);
 					semihosting->result = close(fd);
 					semihosting->sys_errno = errno;
 					LOG_DEBUG("close(%d)=%" PRId64, fd, semihosting->result);
@@ -980,30 +1217,41 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = addr;
 					fileio_info->param_3 = len;
 				} else {
-					uint8_t *buf = malloc(len);
+					/* in chunks, not to hold the whole of a large read */
+					size_t chunk = MIN(len, SEMIHOSTING_IO_CHUNK_SIZE);
+					uint8_t *buf = malloc(chunk);
 					if (!buf) {
 						semihosting->result = -1;
 						semihosting->sys_errno = ENOMEM;
 					} else {
-						semihosting->result = semihosting_read(semihosting, fd, buf, len);
-						LOG_DEBUG("read(%d, 0x%" PRIx64 ", %zu)=%" PRId64,
-							fd,
-							addr,
-							len,
-							semihosting->result);
-						if (semihosting->result >= 0) {
-							retval = target_write_buffer(target, addr,
-									semihosting->result,
-									buf);
+						size_t done = 0;
+						ssize_t n = 0;
+						while (done < len) {
+							size_t size = MIN(len - done, chunk);
+							n = semihosting_read_file(semihosting, fd, buf, size);
+							if (n <= 0)
+								break;
+							retval = target_write_buffer(target, addr + done, n, buf);
 							if (retval != ERROR_OK) {
 								free(buf);
 								return retval;
 							}
-							/* the number of bytes NOT filled in */
-							semihosting->result = len -
-								semihosting->result;
+							done += n;
+							/* a short read, end of file or an interactive device */
+							if ((size_t)n < size)
+								break;
 						}
 						free(buf);
+						LOG_DEBUG("read(%d, 0x%" PRIx64 ", %zu)=%zu",
+							fd,
+							addr,
+							len,
+							done);
+						/* the number of bytes NOT filled in */
+						if (n < 0 && !done)
+							semihosting->result = -1;
+						else
+							semihosting->result = len - done;
 					}
 				}
 			}
@@ -1184,6 +1432,7 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = pos;
 					fileio_info->param_3 = SEEK_SET;
 				} else {
+					semihosting_readahead_drop(semihosting, fd, false);
 					semihosting->result = lseek(fd, pos, SEEK_SET);
 					semihosting->sys_errno = errno;
 					LOG_DEBUG("lseek(%d, %d)=%" PRId64, fd, (int)pos, semihosting->result);
@@ -1312,6 +1561,7 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = addr;
 					fileio_info->param_3 = len;
 				} else {
+					semihosting_readahead_drop(semihosting, fd, true);
 					uint8_t *buf = malloc(len);
 					if (!buf) {
 						semihosting->result = -1;
@@ -1367,7 +1617,7 @@ int semihosting_common(struct target *target)
 				retval = target_read_memory(target, addr, 1, 1, &c);
 				if (retval != ERROR_OK)
 					return retval;
-				semihosting_putchar(semihosting, semihosting->stdout_fd, c);
+				semihosting_console_write(semihosting, (char *)&c, 1);
 				semihosting->result = 0;
 			}
 			break;
@@ -1386,33 +1636,21 @@ int semihosting_common(struct target *target)
 			 * None. The RETURN REGISTER is corrupted.
 			 */
 			if (semihosting->is_fileio) {
-				size_t count = 0;
-				uint64_t addr = semihosting->param;
-				for (;; addr++) {
-					unsigned char c;
-					retval = target_read_memory(target, addr, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (c == '\0')
-						break;
-					count++;
-				}
+				semihosting->result = 0;
+				retval = semihosting_read_string(target, semihosting->param,
+					semihosting_count_string);
+				if (retval != ERROR_OK)
+					return retval;
 				semihosting->hit_fileio = true;
 				fileio_info->identifier = "write";
 				fileio_info->param_1 = 1;
 				fileio_info->param_2 = semihosting->param;
-				fileio_info->param_3 = count;
+				fileio_info->param_3 = semihosting->result;
 			} else {
-				uint64_t addr = semihosting->param;
-				do {
-					unsigned char c;
-					retval = target_read_memory(target, addr++, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (!c)
-						break;
-					semihosting_putchar(semihosting, semihosting->stdout_fd, c);
-				} while (1);
+				retval = semihosting_read_string(target, semihosting->param,
+					semihosting_console_write);
+				if (retval != ERROR_OK)
+					return retval;
 				semihosting->result = 0;
 			}
 			break;
@@ -1696,29 +1934,18 @@ static int semihosting_service_new_connection_handler(struct connection *connect
 {
 	struct semihosting_tcp_service *service = connection->service->priv;
 	service->semihosting->tcp_connection = connection;
+	service->error = ERROR_OK;
+	service->input_head = 0;
+	service->input_len = 0;
 
 	return ERROR_OK;
 }
 
 static int semihosting_service_input_handler(struct connection *connection)
 {
-	struct semihosting_tcp_service *service = connection->service->priv;
-
-	if (!connection->input_pending) {
-		/* consume received data, not for semihosting IO */
-		const int buf_len = 100;
-		char buf[buf_len];
-		int bytes_read = connection_read(connection, buf, buf_len);
-
-		if (bytes_read == 0) {
-			return ERROR_SERVER_REMOTE_CLOSED;
-		} else if (bytes_read == -1) {
-			LOG_ERROR("error during read: %s", strerror(errno));
-			return ERROR_SERVER_REMOTE_CLOSED;
-		}
-	} else if (service->error != ERROR_OK) {
+	/* keep the input for the next SYS_READ or SYS_READC of the target */
+	if (semihosting_tcp_read_input(connection) != ERROR_OK)
 		return ERROR_SERVER_REMOTE_CLOSED;
-	}
 
 	return ERROR_OK;
 }
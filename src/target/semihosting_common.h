@@ -104,6 +104,15 @@ struct target;
 /*
  * A pointer to this structure was added to the target structure.
  */
+/* Size of the buffer of the semihosting console output */
+#define SEMIHOSTING_CONSOLE_BUF_SIZE	256
+
+/* Size of the read-ahead of a file, and of the chunks of a SYS_READ */
+#define SEMIHOSTING_IO_CHUNK_SIZE	(64 * 1024)
+
+/* Period of the flush of the semihosting console output, in ms */
+#define SEMIHOSTING_CONSOLE_FLUSH_MS	100
+
 struct semihosting {
 
 	/** A flag reporting whether semihosting is active. */
@@ -184,10 +193,28 @@ struct semihosting {
 
 	int (*setup)(struct target *target, int enable);
 	int (*post_result)(struct target *target);
+
+	/**
+	 * Output of SYS_WRITEC and SYS_WRITE0 not yet written to the debug
+	 * channel. Written on a newline, when full, before any other
+	 * semihosting operation and periodically.
+	 */
+	char console_buf[SEMIHOSTING_CONSOLE_BUF_SIZE];
+	size_t console_len;
+
+	/**
+	 * Read-ahead of the regular file read last, -1 if none. The host file
+	 * offset is ahead of the one of the target by the bytes not taken yet.
+	 */
+	int readahead_fd;
+	uint8_t *readahead_buf;
+	size_t readahead_head;
+	size_t readahead_len;
 };
 
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result);
+void semihosting_common_free(struct target *target);
 int semihosting_common(struct target *target);
 
 /* utility functions which may also be used by semihosting extensions (custom vendor-defined syscalls) */
@@ -94,6 +94,34 @@ int gdb_write_smp_packet(struct connection *connection,
 	return retval;
 }
 
+/* In non-stop mode the cores of a SMP group halt, resume and step on their
+ * own. The drivers propagate run control to the whole group whenever
+ * target->smp is set, so the group is hidden from them for the duration of
+ * a single core operation, like the drivers already do while polling. */
+int smp_core_enter(struct target *target)
+{
+	int smp = target->smp;
+
+	if (target->smp_non_stop)
+		target->smp = 0;
+
+	return smp;
+}
+
+void smp_core_leave(struct target *target, int smp)
+{
+	target->smp = smp;
+}
+
+void smp_set_non_stop(struct target *target, bool non_stop)
+{
+	struct target_list *head;
+
+	target->smp_non_stop = non_stop;
+	foreach_smp_target(head, target->smp_targets)
+		head->target->smp_non_stop = non_stop;
+}
+
 COMMAND_HANDLER(default_handle_smp_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -18,6 +18,17 @@
 #define foreach_smp_target_direction(forward, pos, head) \
 	list_for_each_entry_direction(forward, pos, head, lh)
 
+/**
+ * Hide the SMP group from the driver of @a target if the group is in
+ * non-stop mode, so that the following run control call only affects this
+ * core. @returns the value to pass to smp_core_leave().
+ */
+int smp_core_enter(struct target *target);
+void smp_core_leave(struct target *target, int smp);
+
+/** Let the cores of the SMP group of @a target halt and resume individually */
+void smp_set_non_stop(struct target *target, bool non_stop);
+
 extern const struct command_registration smp_command_handlers[];
 
 /* DEPRECATED */
@@ -109,6 +109,7 @@ proc ocd_process_reset_inner { MODE } {
 	# assert/deassert) to happen.  Ideally it takes effect without
 	# first executing any instructions.
 	if { $halt } {
+		set wait_targets {}
 		foreach t $targets {
 			if {[using_jtag] && ![jtag tapisenabled [$t cget -chain-position]]} {
 				continue
@@ -131,15 +132,22 @@ proc ocd_process_reset_inner { MODE } {
 				}
 			}
 
-			# Wait up to 1 second for target to halt. Why 1sec? Cause
-			# the JTAG tap reset signal might be hooked to a slow
-			# resistor/capacitor circuit - and it might take a while
-			# to charge
+			lappend wait_targets $t
+		}
+
+		# Wait up to 1 second for the targets to halt. Why 1sec? Cause
+		# the JTAG tap reset signal might be hooked to a slow
+		# resistor/capacitor circuit - and it might take a while
+		# to charge. All targets are waited for together, so the
+		# timeouts of several slow targets don't add up.
 
-			# Catch, but ignore any errors.
-			catch { $t arp_waitstate halted 1000 }
+		# Catch, but ignore any errors.
+		if { [llength $wait_targets] } {
+			catch { target wait_state halted 1000 {*}$wait_targets }
+		}
 
-			# Did we succeed?
+		# Did we succeed?
+		foreach t $wait_targets {
 			set s [$t curstate]
 
 			if { $s != "halted" } {
@@ -11,6 +11,7 @@
 #endif
 
 #include <helper/log.h>
+#include <helper/time_support.h>
 #include "target.h"
 #include "target_type.h"
 #include "hello.h"
@@ -113,6 +114,9 @@ static const struct {
 #define PUL 0x02
 #define WR_PG_DIS 0x01
 
+/* upper bound of a block erase and program, a few ms on all parts */
+#define FLASH_EOP_TIMEOUT_MS 50
+
 /* FLASH_CR2 */
 #define OPT 0x80
 #define WPRG 0x40
@@ -644,6 +648,57 @@ static int stm8_unlock_eeprom(struct target *target)
 	return ERROR_OK;
 }
 
+/* select the programming mode, with the complement in NCR2 if any */
+static int stm8_set_flash_cr2(struct target *target, uint8_t cr2)
+{
+	struct stm8_common *stm8 = target_to_stm8(target);
+	uint8_t buf[2];
+
+	if (!stm8->flash_cr2)
+		return ERROR_OK;
+
+	if (!stm8->flash_ncr2)
+		return stm8_write_u8(target, stm8->flash_cr2, cr2);
+
+	/* one SWIM write when NCR2 follows CR2, as on STM8S */
+	if (stm8->flash_ncr2 == stm8->flash_cr2 + 1) {
+		buf[0] = cr2;
+		buf[1] = ~cr2;
+		return stm8_adapter_write_memory(target, stm8->flash_cr2, 1, 2, buf);
+	}
+
+	int res = stm8_write_u8(target, stm8->flash_cr2, cr2);
+	if (res != ERROR_OK)
+		return res;
+	return stm8_write_u8(target, stm8->flash_ncr2, ~cr2);
+}
+
+/* lets hang here until end of program (EOP) */
+static int stm8_wait_flash_eop(struct target *target)
+{
+	struct stm8_common *stm8 = target_to_stm8(target);
+	int64_t then = timeval_ms();
+	uint8_t iapsr;
+	int res;
+
+	for (;;) {
+		res = stm8_read_u8(target, stm8->flash_iapsr, &iapsr);
+		if (res != ERROR_OK)
+			return res;
+		if (iapsr & EOP)
+			return ERROR_OK;
+		if (iapsr & WR_PG_DIS) {
+			LOG_ERROR("attempt to program a write protected page");
+			return ERROR_FAIL;
+		}
+		if (timeval_ms() - then > FLASH_EOP_TIMEOUT_MS) {
+			LOG_ERROR("timeout waiting for the end of programming");
+			return ERROR_FAIL;
+		}
+		usleep(1000);
+	}
+}
+
 static int stm8_write_flash(struct target *target, enum mem_type type,
 		uint32_t address,
 		uint32_t size, uint32_t count, uint32_t blocksize_param,
@@ -651,9 +706,7 @@ static int stm8_write_flash(struct target *target, enum mem_type type,
 {
 	struct stm8_common *stm8 = target_to_stm8(target);
 
-	uint8_t iapsr;
 	uint8_t opt = 0;
-	unsigned int i;
 	uint32_t blocksize = 0;
 	uint32_t bytecnt;
 	int res;
@@ -683,27 +736,21 @@ static int stm8_write_flash(struct target *target, enum mem_type type,
 	bytecnt = count * size;
 
 	while (bytecnt) {
+		res = ERROR_OK;
 		if ((bytecnt >= blocksize_param) && ((address & (blocksize_param-1)) == 0)) {
-			if (stm8->flash_cr2)
-				stm8_write_u8(target, stm8->flash_cr2, PRG + opt);
-			if (stm8->flash_ncr2)
-				stm8_write_u8(target, stm8->flash_ncr2, ~(PRG + opt));
+			res = stm8_set_flash_cr2(target, PRG + opt);
 			blocksize = blocksize_param;
 		} else
 		if ((bytecnt >= 4) && ((address & 0x3) == 0)) {
-			if (stm8->flash_cr2)
-				stm8_write_u8(target, stm8->flash_cr2, WPRG + opt);
-			if (stm8->flash_ncr2)
-				stm8_write_u8(target, stm8->flash_ncr2, ~(WPRG + opt));
+			res = stm8_set_flash_cr2(target, WPRG + opt);
 			blocksize = 4;
 		} else
 		if (blocksize != 1) {
-			if (stm8->flash_cr2)
-				stm8_write_u8(target, stm8->flash_cr2, opt);
-			if (stm8->flash_ncr2)
-				stm8_write_u8(target, stm8->flash_ncr2, ~opt);
+			res = stm8_set_flash_cr2(target, opt);
 			blocksize = 1;
 		}
+		if (res != ERROR_OK)
+			return res;
 
 		res = stm8_adapter_write_memory(target, address, 1, blocksize, buffer);
 		if (res != ERROR_OK)
@@ -712,16 +759,9 @@ static int stm8_write_flash(struct target *target, enum mem_type type,
 		buffer += blocksize;
 		bytecnt -= blocksize;
 
-		/* lets hang here until end of program (EOP) */
-		for (i = 0; i < 16; i++) {
-			stm8_read_u8(target, stm8->flash_iapsr, &iapsr);
-			if (iapsr & EOP)
-				break;
-			else
-				usleep(1000);
-		}
-		if (i == 16)
-			return ERROR_FAIL;
+		res = stm8_wait_flash_eop(target);
+		if (res != ERROR_OK)
+			return res;
 	}
 
 	/* disable write access */
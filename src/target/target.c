@@ -31,6 +31,7 @@
 #endif
 
 #include <helper/align.h>
+#include <helper/crc32.h>
 #include <helper/time_support.h>
 #include <jtag/jtag.h>
 #include <flash/nor/core.h>
@@ -38,6 +39,7 @@
 #include "target.h"
 #include "target_type.h"
 #include "target_request.h"
+#include "target_memcache.h"
 #include "breakpoints.h"
 #include "register.h"
 #include "trace.h"
@@ -62,6 +64,7 @@ static int target_mem2array(Jim_Interp *interp, struct target *target,
 static int target_register_user_commands(struct command_context *cmd_ctx);
 static int target_get_gdb_fileio_info_default(struct target *target,
 		struct gdb_fileio_info *fileio_info);
+static void target_resident_working_areas_written(target_addr_t address, uint64_t size);
 static int target_gdb_fileio_end_default(struct target *target, int retcode,
 		int fileio_errno, bool ctrl_c);
 
@@ -155,11 +158,25 @@ static struct target_type *target_types[] = {
 
 struct target *all_targets;
 static struct target_event_callback *target_event_callbacks;
-static struct target_timer_callback *target_timer_callbacks;
+/* Binary min-heap of the timer callbacks, ordered by deadline */
+static struct target_timer_callback **target_timer_heap;
+static unsigned int target_timer_heap_len;
+static unsigned int target_timer_heap_max;
+/* Callbacks taken off the heap by the current target_call_timer_callbacks() */
+static struct target_timer_callback **target_timer_due;
+static unsigned int target_timer_due_len;
+static unsigned int target_timer_due_max;
+static uint64_t target_timer_seq;
 static int64_t target_timer_next_event_value;
+
+#define TARGET_TIMER_NOT_QUEUED		UINT_MAX
+
 static LIST_HEAD(target_reset_callback_list);
 static LIST_HEAD(target_trace_callback_list);
 static const int polling_interval = TARGET_DEFAULT_POLLING_INTERVAL;
+/* period of handle_target(), the fastest polling interval of all targets */
+static unsigned int handle_target_tick_ms;
+static Jim_Interp *handle_target_interp;
 static LIST_HEAD(empty_smp_targets);
 
 static const struct jim_nvp nvp_assert[] = {
@@ -442,52 +459,99 @@ static void target_buffer_set_u8(struct target *target, uint8_t *buffer, uint8_t
 	*buffer = value;
 }
 
-/* write a uint64_t array to a buffer in target memory endianness */
+/* true if the target stores values like the host does, folded to a
+ * constant by the compiler apart from the target->endianness check */
+static bool target_endianness_is_host(struct target *target)
+{
+	const uint16_t probe = 1;
+	bool host_little_endian = *(const uint8_t *)&probe == 1;
+
+	return host_little_endian == (target->endianness == TARGET_LITTLE_ENDIAN);
+}
+
+/*
+ * The array helpers below copy the buffer as is if the target endianness
+ * matches the host. Otherwise they check the endianness once and leave
+ * a plain loop, which the compiler turns into byte swapping loads and
+ * stores or vectorizes. The buffer and the array may be the same memory.
+ */
+
+/* read a uint64_t array from a buffer in target memory endianness */
 void target_buffer_get_u64_array(struct target *target, const uint8_t *buffer, uint32_t count, uint64_t *dstbuf)
 {
-	uint32_t i;
-	for (i = 0; i < count; i++)
-		dstbuf[i] = target_buffer_get_u64(target, &buffer[i * 8]);
+	if (target_endianness_is_host(target))
+		memmove(dstbuf, buffer, count * sizeof(*dstbuf));
+	else if (target->endianness == TARGET_LITTLE_ENDIAN)
+		for (uint32_t i = 0; i < count; i++)
+			dstbuf[i] = le_to_h_u64(&buffer[i * 8]);
+	else
+		for (uint32_t i = 0; i < count; i++)
+			dstbuf[i] = be_to_h_u64(&buffer[i * 8]);
 }
 
-/* write a uint32_t array to a buffer in target memory endianness */
+/* read a uint32_t array from a buffer in target memory endianness */
 void target_buffer_get_u32_array(struct target *target, const uint8_t *buffer, uint32_t count, uint32_t *dstbuf)
 {
-	uint32_t i;
-	for (i = 0; i < count; i++)
-		dstbuf[i] = target_buffer_get_u32(target, &buffer[i * 4]);
+	if (target_endianness_is_host(target))
+		memmove(dstbuf, buffer, count * sizeof(*dstbuf));
+	else if (target->endianness == TARGET_LITTLE_ENDIAN)
+		for (uint32_t i = 0; i < count; i++)
+			dstbuf[i] = le_to_h_u32(&buffer[i * 4]);
+	else
+		for (uint32_t i = 0; i < count; i++)
+			dstbuf[i] = be_to_h_u32(&buffer[i * 4]);
 }
 
-/* write a uint16_t array to a buffer in target memory endianness */
+/* read a uint16_t array from a buffer in target memory endianness */
 void target_buffer_get_u16_array(struct target *target, const uint8_t *buffer, uint32_t count, uint16_t *dstbuf)
 {
-	uint32_t i;
-	for (i = 0; i < count; i++)
-		dstbuf[i] = target_buffer_get_u16(target, &buffer[i * 2]);
+	if (target_endianness_is_host(target))
+		memmove(dstbuf, buffer, count * sizeof(*dstbuf));
+	else if (target->endianness == TARGET_LITTLE_ENDIAN)
+		for (uint32_t i = 0; i < count; i++)
+			dstbuf[i] = le_to_h_u16(&buffer[i * 2]);
+	else
+		for (uint32_t i = 0; i < count; i++)
+			dstbuf[i] = be_to_h_u16(&buffer[i * 2]);
 }
 
 /* write a uint64_t array to a buffer in target memory endianness */
 void target_buffer_set_u64_array(struct target *target, uint8_t *buffer, uint32_t count, const uint64_t *srcbuf)
 {
-	uint32_t i;
-	for (i = 0; i < count; i++)
-		target_buffer_set_u64(target, &buffer[i * 8], srcbuf[i]);
+	if (target_endianness_is_host(target))
+		memmove(buffer, srcbuf, count * sizeof(*srcbuf));
+	else if (target->endianness == TARGET_LITTLE_ENDIAN)
+		for (uint32_t i = 0; i < count; i++)
+			h_u64_to_le(&buffer[i * 8], srcbuf[i]);
+	else
+		for (uint32_t i = 0; i < count; i++)
+			h_u64_to_be(&buffer[i * 8], srcbuf[i]);
 }
 
 /* write a uint32_t array to a buffer in target memory endianness */
 void target_buffer_set_u32_array(struct target *target, uint8_t *buffer, uint32_t count, const uint32_t *srcbuf)
 {
-	uint32_t i;
-	for (i = 0; i < count; i++)
-		target_buffer_set_u32(target, &buffer[i * 4], srcbuf[i]);
+	if (target_endianness_is_host(target))
+		memmove(buffer, srcbuf, count * sizeof(*srcbuf));
+	else if (target->endianness == TARGET_LITTLE_ENDIAN)
+		for (uint32_t i = 0; i < count; i++)
+			h_u32_to_le(&buffer[i * 4], srcbuf[i]);
+	else
+		for (uint32_t i = 0; i < count; i++)
+			h_u32_to_be(&buffer[i * 4], srcbuf[i]);
 }
 
 /* write a uint16_t array to a buffer in target memory endianness */
 void target_buffer_set_u16_array(struct target *target, uint8_t *buffer, uint32_t count, const uint16_t *srcbuf)
 {
-	uint32_t i;
-	for (i = 0; i < count; i++)
-		target_buffer_set_u16(target, &buffer[i * 2], srcbuf[i]);
+	if (target_endianness_is_host(target))
+		memmove(buffer, srcbuf, count * sizeof(*srcbuf));
+	else if (target->endianness == TARGET_LITTLE_ENDIAN)
+		for (uint32_t i = 0; i < count; i++)
+			h_u16_to_le(&buffer[i * 2], srcbuf[i]);
+	else
+		for (uint32_t i = 0; i < count; i++)
+			h_u16_to_be(&buffer[i * 2], srcbuf[i]);
 }
 
 /* return a pointer to a configured target; id is name or number */
@@ -564,7 +628,18 @@ int target_poll(struct target *target)
 		return ERROR_FAIL;
 	}
 
+	int64_t begin = timeval_us();
+	int smp = smp_core_enter(target);
 	retval = target->type->poll(target);
+	smp_core_leave(target, smp);
+
+	if (!target->poll_metric.name) {
+		target->poll_metric = (struct metric)METRIC_HISTOGRAM("target_poll_microseconds",
+				"Time taken to poll the target");
+		metric_set_labels(&target->poll_metric, "target=\"%s\"", target_name(target));
+	}
+	metric_histogram_add(&target->poll_metric, timeval_us() - begin);
+
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -593,12 +668,15 @@ int target_halt(struct target *target)
 		return ERROR_FAIL;
 	}
 
+	int smp = smp_core_enter(target);
 	retval = target->type->halt(target);
+	smp_core_leave(target, smp);
 	if (retval != ERROR_OK)
 		return retval;
 
 	target->halt_issued = true;
 	target->halt_issued_time = timeval_ms();
+	target_poll_soon(target);
 
 	return ERROR_OK;
 }
@@ -658,8 +736,12 @@ int target_resume(struct target *target, int current, target_addr_t address,
 	 * Disable polling during resume() to guarantee the execution of handlers
 	 * in the correct order.
 	 */
+	target_memcache_invalidate_all();
+
 	bool save_poll_mask = jtag_poll_mask();
+	int smp = smp_core_enter(target);
 	retval = target->type->resume(target, current, address, handle_breakpoints, debug_execution);
+	smp_core_leave(target, smp);
 	jtag_poll_unmask(save_poll_mask);
 
 	if (retval != ERROR_OK)
@@ -863,6 +945,8 @@ int target_run_algorithm(struct target *target,
 		goto done;
 	}
 
+	target_memcache_invalidate_all();
+
 	target->running_alg = true;
 	retval = target->type->run_algorithm(target,
 			num_mem_params, mem_params,
@@ -908,6 +992,8 @@ int target_start_algorithm(struct target *target,
 		goto done;
 	}
 
+	target_memcache_invalidate_all();
+
 	target->running_alg = true;
 	retval = target->type->start_algorithm(target,
 			num_mem_params, mem_params,
@@ -1002,6 +1088,103 @@ done:
  * @param arch_info
  */
 
+/* the algorithm made no progress for so long, in ms */
+#define ASYNC_ALGORITHM_TIMEOUT		5000
+/* longest wait for the target to process the fifo, in ms */
+#define ASYNC_ALGORITHM_MAX_WAIT	50
+
+static struct metric async_algorithm_bytes = METRIC_COUNTER("async_algorithm_bytes_total",
+		"Bytes streamed through the fifo of the async flash algorithms");
+static struct metric async_algorithm_waits = METRIC_COUNTER("async_algorithm_waits_total",
+		"Waits for the target to process the fifo of an async flash algorithm");
+static struct metric async_algorithm_wait_ms = METRIC_COUNTER("async_algorithm_wait_milliseconds_total",
+		"Time waited for the target to process the fifo of an async flash algorithm");
+
+/*
+ * Pacing of the fifo pointer polls of the async algorithms. Once the fifo is
+ * full (empty for reads), the host waits for the time the target takes to
+ * process a quarter of the fifo at the rate seen so far, then moves a large
+ * chunk with each poll instead of a few blocks.
+ */
+struct async_algorithm_pace {
+	int64_t start;
+	/* last time the target moved its fifo pointer */
+	int64_t progress;
+	uint32_t fifo_size;
+	/* bytes processed by the target */
+	uint64_t done;
+	unsigned int polls;
+	unsigned int waits;
+};
+
+static void async_algorithm_pace_init(struct async_algorithm_pace *pace, uint32_t fifo_size)
+{
+	pace->start = timeval_ms();
+	pace->progress = pace->start;
+	pace->fifo_size = fifo_size;
+	pace->done = 0;
+	pace->polls = 0;
+	pace->waits = 0;
+}
+
+/* Account the target pointer moving from @a old to @a new */
+static void async_algorithm_pace_poll(struct async_algorithm_pace *pace,
+		uint32_t old, uint32_t new)
+{
+	pace->polls++;
+
+	if (new == old)
+		return;
+
+	pace->done += new > old ? new - old : new + pace->fifo_size - old;
+	pace->progress = timeval_ms();
+}
+
+static int async_algorithm_pace_wait(struct async_algorithm_pace *pace)
+{
+	int64_t now = timeval_ms();
+
+	/* to stop an infinite loop on some targets check for a timeout
+	 * this issue was observed on a stellaris using the new ICDI interface */
+	if (now - pace->progress > ASYNC_ALGORITHM_TIMEOUT) {
+		LOG_ERROR("timeout waiting for algorithm, a target reset is recommended");
+		return ERROR_FLASH_OPERATION_FAILED;
+	}
+
+	/* until the rate is known, the former fixed 2 ms */
+	int64_t wait = 2;
+	if (pace->done && now > pace->start) {
+		/* bytes per ms */
+		uint64_t rate = pace->done / (now - pace->start);
+		wait = rate ? (int64_t)(pace->fifo_size / 4 / rate) : ASYNC_ALGORITHM_MAX_WAIT;
+		wait = MIN(wait, ASYNC_ALGORITHM_MAX_WAIT);
+	}
+
+	pace->waits++;
+	metric_add(&async_algorithm_waits, 1);
+
+	metric_add(&async_algorithm_wait_ms, wait);
+
+	/* with a fast target just poll again */
+	if (wait)
+		alive_sleep(wait);
+	else
+		keep_alive();
+
+	return ERROR_OK;
+}
+
+static void async_algorithm_pace_done(struct async_algorithm_pace *pace,
+		const char *what, uint32_t bytes)
+{
+	int64_t elapsed = timeval_ms() - pace->start;
+
+	metric_add(&async_algorithm_bytes, bytes);
+	LOG_DEBUG("%s %" PRIu32 " bytes in %" PRId64 " ms (%" PRId64 " KiB/s), %u polls, %u waits",
+			what, bytes, elapsed, elapsed ? (int64_t)bytes * 1000 / 1024 / elapsed : 0,
+			pace->polls, pace->waits);
+}
+
 int target_run_flash_async_algorithm(struct target *target,
 		const uint8_t *buffer, uint32_t count, int block_size,
 		int num_mem_params, struct mem_param *mem_params,
@@ -1010,9 +1193,10 @@ int target_run_flash_async_algorithm(struct target *target,
 		uint32_t entry_point, uint32_t exit_point, void *arch_info)
 {
 	int retval;
-	int timeout = 0;
+	struct async_algorithm_pace pace;
 
 	const uint8_t *buffer_orig = buffer;
+	uint32_t bytes = count * block_size;
 
 	/* Set up working area. First word is write pointer, second word is read pointer,
 	 * rest is fifo data area. */
@@ -1046,29 +1230,10 @@ int target_run_flash_async_algorithm(struct target *target,
 		return retval;
 	}
 
-	while (count > 0) {
-
-		retval = target_read_u32(target, rp_addr, &rp);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("failed to get read pointer");
-			break;
-		}
-
-		LOG_DEBUG("offs 0x%zx count 0x%" PRIx32 " wp 0x%" PRIx32 " rp 0x%" PRIx32,
-			(size_t) (buffer - buffer_orig), count, wp, rp);
-
-		if (rp == 0) {
-			LOG_ERROR("flash write algorithm aborted by target");
-			retval = ERROR_FLASH_OPERATION_FAILED;
-			break;
-		}
-
-		if (!IS_ALIGNED(rp - fifo_start_addr, block_size) || rp < fifo_start_addr || rp >= fifo_end_addr) {
-			LOG_ERROR("corrupted fifo read pointer 0x%" PRIx32, rp);
-			break;
-		}
+	async_algorithm_pace_init(&pace, fifo_end_addr - fifo_start_addr);
 
-		/* Count the number of bytes available in the fifo without
+	while (count > 0) {
+		/* Count the number of bytes known free in the fifo without
 		 * crossing the wrap around. Make sure to not fill it completely,
 		 * because that would make wp == rp and that's the empty condition. */
 		uint32_t thisrun_bytes;
@@ -1079,25 +1244,43 @@ int target_run_flash_async_algorithm(struct target *target,
 		else
 			thisrun_bytes = fifo_end_addr - wp - block_size;
 
+		/* Only poll the read pointer once the space known free is used up */
 		if (thisrun_bytes == 0) {
-			/* Throttle polling a bit if transfer is (much) faster than flash
-			 * programming. The exact delay shouldn't matter as long as it's
-			 * less than buffer size / flash speed. This is very unlikely to
-			 * run when using high latency connections such as USB. */
-			alive_sleep(2);
-
-			/* to stop an infinite loop on some targets check and increment a timeout
-			 * this issue was observed on a stellaris using the new ICDI interface */
-			if (timeout++ >= 2500) {
-				LOG_ERROR("timeout waiting for algorithm, a target reset is recommended");
-				return ERROR_FLASH_OPERATION_FAILED;
+			uint32_t last_rp = rp;
+
+			retval = target_read_u32(target, rp_addr, &rp);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("failed to get read pointer");
+				break;
+			}
+
+			LOG_DEBUG("offs 0x%zx count 0x%" PRIx32 " wp 0x%" PRIx32 " rp 0x%" PRIx32,
+				(size_t) (buffer - buffer_orig), count, wp, rp);
+
+			if (rp == 0) {
+				LOG_ERROR("flash write algorithm aborted by target");
+				retval = ERROR_FLASH_OPERATION_FAILED;
+				break;
+			}
+
+			if (!IS_ALIGNED(rp - fifo_start_addr, block_size) || rp < fifo_start_addr || rp >= fifo_end_addr) {
+				LOG_ERROR("corrupted fifo read pointer 0x%" PRIx32, rp);
+				break;
+			}
+
+			async_algorithm_pace_poll(&pace, last_rp, rp);
+
+			if (rp == last_rp) {
+				/* Throttle polling if transfer is (much) faster than flash
+				 * programming. This is very unlikely to run when using
+				 * high latency connections such as USB. */
+				retval = async_algorithm_pace_wait(&pace);
+				if (retval != ERROR_OK)
+					return retval;
 			}
 			continue;
 		}
 
-		/* reset our timeout */
-		timeout = 0;
-
 		/* Limit to the amount of data we actually want to write */
 		if (thisrun_bytes > count * block_size)
 			thisrun_bytes = count * block_size;
@@ -1152,6 +1335,9 @@ int target_run_flash_async_algorithm(struct target *target,
 		}
 	}
 
+	if (retval == ERROR_OK)
+		async_algorithm_pace_done(&pace, "flash write algorithm wrote", bytes);
+
 	return retval;
 }
 
@@ -1163,9 +1349,10 @@ int target_run_read_async_algorithm(struct target *target,
 		uint32_t entry_point, uint32_t exit_point, void *arch_info)
 {
 	int retval;
-	int timeout = 0;
+	struct async_algorithm_pace pace;
 
 	const uint8_t *buffer_orig = buffer;
+	uint32_t bytes = count * block_size;
 
 	/* Set up working area. First word is write pointer, second word is read pointer,
 	 * rest is fifo data area. */
@@ -1199,28 +1386,10 @@ int target_run_read_async_algorithm(struct target *target,
 		return retval;
 	}
 
-	while (count > 0) {
-		retval = target_read_u32(target, wp_addr, &wp);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("failed to get write pointer");
-			break;
-		}
-
-		LOG_DEBUG("offs 0x%zx count 0x%" PRIx32 " wp 0x%" PRIx32 " rp 0x%" PRIx32,
-			(size_t)(buffer - buffer_orig), count, wp, rp);
-
-		if (wp == 0) {
-			LOG_ERROR("flash read algorithm aborted by target");
-			retval = ERROR_FLASH_OPERATION_FAILED;
-			break;
-		}
-
-		if (!IS_ALIGNED(wp - fifo_start_addr, block_size) || wp < fifo_start_addr || wp >= fifo_end_addr) {
-			LOG_ERROR("corrupted fifo write pointer 0x%" PRIx32, wp);
-			break;
-		}
+	async_algorithm_pace_init(&pace, fifo_end_addr - fifo_start_addr);
 
-		/* Count the number of bytes available in the fifo without
+	while (count > 0) {
+		/* Count the number of bytes known available in the fifo without
 		 * crossing the wrap around. */
 		uint32_t thisrun_bytes;
 		if (wp >= rp)
@@ -1228,25 +1397,43 @@ int target_run_read_async_algorithm(struct target *target,
 		else
 			thisrun_bytes = fifo_end_addr - rp;
 
+		/* Only poll the write pointer once the data known available is read */
 		if (thisrun_bytes == 0) {
-			/* Throttle polling a bit if transfer is (much) faster than flash
-			 * reading. The exact delay shouldn't matter as long as it's
-			 * less than buffer size / flash speed. This is very unlikely to
-			 * run when using high latency connections such as USB. */
-			alive_sleep(2);
-
-			/* to stop an infinite loop on some targets check and increment a timeout
-			 * this issue was observed on a stellaris using the new ICDI interface */
-			if (timeout++ >= 2500) {
-				LOG_ERROR("timeout waiting for algorithm, a target reset is recommended");
-				return ERROR_FLASH_OPERATION_FAILED;
+			uint32_t last_wp = wp;
+
+			retval = target_read_u32(target, wp_addr, &wp);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("failed to get write pointer");
+				break;
+			}
+
+			LOG_DEBUG("offs 0x%zx count 0x%" PRIx32 " wp 0x%" PRIx32 " rp 0x%" PRIx32,
+				(size_t)(buffer - buffer_orig), count, wp, rp);
+
+			if (wp == 0) {
+				LOG_ERROR("flash read algorithm aborted by target");
+				retval = ERROR_FLASH_OPERATION_FAILED;
+				break;
+			}
+
+			if (!IS_ALIGNED(wp - fifo_start_addr, block_size) || wp < fifo_start_addr || wp >= fifo_end_addr) {
+				LOG_ERROR("corrupted fifo write pointer 0x%" PRIx32, wp);
+				break;
+			}
+
+			async_algorithm_pace_poll(&pace, last_wp, wp);
+
+			if (wp == last_wp) {
+				/* Throttle polling if transfer is (much) faster than flash
+				 * reading. This is very unlikely to run when using
+				 * high latency connections such as USB. */
+				retval = async_algorithm_pace_wait(&pace);
+				if (retval != ERROR_OK)
+					return retval;
 			}
 			continue;
 		}
 
-		/* Reset our timeout */
-		timeout = 0;
-
 		/* Limit to the amount of data we actually want to read */
 		if (thisrun_bytes > count * block_size)
 			thisrun_bytes = count * block_size;
@@ -1274,7 +1461,6 @@ int target_run_read_async_algorithm(struct target *target,
 
 		/* Avoid GDB timeouts */
 		keep_alive();
-
 	}
 
 	if (retval != ERROR_OK) {
@@ -1302,6 +1488,9 @@ int target_run_read_async_algorithm(struct target *target,
 		}
 	}
 
+	if (retval == ERROR_OK)
+		async_algorithm_pace_done(&pace, "flash read algorithm read", bytes);
+
 	return retval;
 }
 
@@ -1316,6 +1505,10 @@ int target_read_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	/* Single elements are how peripheral registers get polled, never
+	 * serve them from the cache */
+	if (count > 1 && target_memcache_read(target, address, size, count, buffer))
+		return ERROR_OK;
 	return target->type->read_memory(target, address, size, count, buffer);
 }
 
@@ -1344,6 +1537,8 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	target_memcache_invalidate_all();
+	target_resident_working_areas_written(address, (uint64_t)size * count);
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1358,6 +1553,8 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	target_memcache_invalidate_all();
+	target_resident_working_areas_written(address, (uint64_t)size * count);
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1397,6 +1594,59 @@ int target_remove_breakpoint(struct target *target,
 	return target->type->remove_breakpoint(target, breakpoint);
 }
 
+/* The batched hooks may bypass target_write_memory() */
+static void target_breakpoints_written(struct breakpoint **breakpoint_list,
+		unsigned int num_breakpoints)
+{
+	target_memcache_invalidate_all();
+	for (unsigned int i = 0; i < num_breakpoints; i++)
+		target_resident_working_areas_written(breakpoint_list[i]->address,
+				breakpoint_list[i]->length);
+}
+
+int target_add_breakpoints(struct target *target,
+		struct breakpoint **breakpoint_list, unsigned int num_breakpoints)
+{
+	if (target->state != TARGET_HALTED) {
+		LOG_WARNING("target %s is not halted (add breakpoints)", target_name(target));
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	if (target->type->add_breakpoints) {
+		target_breakpoints_written(breakpoint_list, num_breakpoints);
+		return target->type->add_breakpoints(target, breakpoint_list, num_breakpoints);
+	}
+
+	for (unsigned int i = 0; i < num_breakpoints; i++) {
+		int retval = target->type->add_breakpoint(target, breakpoint_list[i]);
+		if (retval != ERROR_OK) {
+			while (i--)
+				target->type->remove_breakpoint(target, breakpoint_list[i]);
+			return retval;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+int target_remove_breakpoints(struct target *target,
+		struct breakpoint **breakpoint_list, unsigned int num_breakpoints)
+{
+	if (target->type->remove_breakpoints) {
+		target_breakpoints_written(breakpoint_list, num_breakpoints);
+		return target->type->remove_breakpoints(target, breakpoint_list, num_breakpoints);
+	}
+
+	int retval = ERROR_OK;
+	for (unsigned int i = 0; i < num_breakpoints; i++) {
+		int ret = target->type->remove_breakpoint(target, breakpoint_list[i]);
+		if (retval == ERROR_OK)
+			retval = ret;
+	}
+
+	return retval;
+}
+
 int target_add_watchpoint(struct target *target,
 		struct watchpoint *watchpoint)
 {
@@ -1436,6 +1686,13 @@ const char *target_get_gdb_arch(struct target *target)
 	return target->type->get_gdb_arch(target);
 }
 
+struct reg *target_reg_get_by_name(struct target *target, const char *name,
+		bool search_all)
+{
+	return register_get_by_name_indexed(&target->reg_name_index,
+			target->reg_cache, name, search_all);
+}
+
 int target_get_gdb_reg_list(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class)
@@ -1469,6 +1726,33 @@ int target_get_gdb_reg_list_noread(struct target *target,
 	return target_get_gdb_reg_list(target, reg_list, reg_list_size, reg_class);
 }
 
+int target_read_registers(struct target *target, struct reg **reg_list,
+		unsigned int num_regs)
+{
+	if (target->type->read_registers)
+		return target->type->read_registers(target, reg_list, num_regs);
+
+	for (unsigned int i = 0; i < num_regs; i++) {
+		struct reg *reg = reg_list[i];
+		if (!reg || !reg->exist || reg->valid)
+			continue;
+		int retval = reg->type->get(reg);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
+int target_write_registers(struct target *target, struct reg **reg_list,
+		unsigned int num_regs)
+{
+	if (!target->type->write_registers)
+		return ERROR_OK;
+
+	return target->type->write_registers(target, reg_list, num_regs);
+}
+
 bool target_supports_gdb_connection(struct target *target)
 {
 	/*
@@ -1485,7 +1769,11 @@ int target_step(struct target *target,
 
 	target_call_event_callbacks(target, TARGET_EVENT_STEP_START);
 
+	target_memcache_invalidate_all();
+
+	int smp = smp_core_enter(target);
 	retval = target->type->step(target, current, address, handle_breakpoints);
+	smp_core_leave(target, smp);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -1543,6 +1831,7 @@ static int target_profiling(struct target *target, uint32_t *samples,
 }
 
 static int handle_target(void *priv);
+static int target_poll_update_tick(void);
 
 static int target_init_one(struct command_context *cmd_ctx,
 		struct target *target)
@@ -1622,8 +1911,8 @@ static int target_init(struct command_context *cmd_ctx)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = target_register_timer_callback(&handle_target,
-			polling_interval, TARGET_TIMER_TYPE_PERIODIC, cmd_ctx->interp);
+	handle_target_interp = cmd_ctx->interp;
+	retval = target_poll_update_tick();
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -1726,31 +2015,110 @@ int target_register_trace_callback(int (*callback)(struct target *target,
 	return ERROR_OK;
 }
 
+static bool target_timer_before(const struct target_timer_callback *a,
+		const struct target_timer_callback *b)
+{
+	return a->when < b->when || (a->when == b->when && a->seq < b->seq);
+}
+
+static void target_timer_heap_set(unsigned int i, struct target_timer_callback *cb)
+{
+	target_timer_heap[i] = cb;
+	cb->heap_index = i;
+}
+
+static void target_timer_heap_sift_up(unsigned int i)
+{
+	struct target_timer_callback *cb = target_timer_heap[i];
+
+	while (i > 0) {
+		unsigned int parent = (i - 1) / 2;
+		if (!target_timer_before(cb, target_timer_heap[parent]))
+			break;
+		target_timer_heap_set(i, target_timer_heap[parent]);
+		i = parent;
+	}
+	target_timer_heap_set(i, cb);
+}
+
+static void target_timer_heap_sift_down(unsigned int i)
+{
+	struct target_timer_callback *cb = target_timer_heap[i];
+
+	while (2 * i + 1 < target_timer_heap_len) {
+		unsigned int child = 2 * i + 1;
+		if (child + 1 < target_timer_heap_len
+				&& target_timer_before(target_timer_heap[child + 1], target_timer_heap[child]))
+			child++;
+		if (!target_timer_before(target_timer_heap[child], cb))
+			break;
+		target_timer_heap_set(i, target_timer_heap[child]);
+		i = child;
+	}
+	target_timer_heap_set(i, cb);
+}
+
+static int target_timer_heap_insert(struct target_timer_callback *cb)
+{
+	if (target_timer_heap_len == target_timer_heap_max) {
+		unsigned int max = target_timer_heap_max ? 2 * target_timer_heap_max : 16;
+		struct target_timer_callback **heap = realloc(target_timer_heap,
+				max * sizeof(*heap));
+		if (!heap) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		target_timer_heap = heap;
+		target_timer_heap_max = max;
+	}
+
+	target_timer_heap_set(target_timer_heap_len, cb);
+	target_timer_heap_sift_up(target_timer_heap_len++);
+
+	return ERROR_OK;
+}
+
+static void target_timer_heap_remove(struct target_timer_callback *cb)
+{
+	unsigned int i = cb->heap_index;
+
+	cb->heap_index = TARGET_TIMER_NOT_QUEUED;
+	if (i == --target_timer_heap_len)
+		return;
+
+	target_timer_heap_set(i, target_timer_heap[target_timer_heap_len]);
+	if (i > 0 && target_timer_before(target_timer_heap[i], target_timer_heap[(i - 1) / 2]))
+		target_timer_heap_sift_up(i);
+	else
+		target_timer_heap_sift_down(i);
+}
+
 int target_register_timer_callback(int (*callback)(void *priv),
 		unsigned int time_ms, enum target_timer_type type, void *priv)
 {
-	struct target_timer_callback **callbacks_p = &target_timer_callbacks;
-
 	if (!callback)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	if (*callbacks_p) {
-		while ((*callbacks_p)->next)
-			callbacks_p = &((*callbacks_p)->next);
-		callbacks_p = &((*callbacks_p)->next);
+	struct target_timer_callback *cb = calloc(1, sizeof(*cb));
+	if (!cb) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
 	}
 
-	(*callbacks_p) = malloc(sizeof(struct target_timer_callback));
-	(*callbacks_p)->callback = callback;
-	(*callbacks_p)->type = type;
-	(*callbacks_p)->time_ms = time_ms;
-	(*callbacks_p)->removed = false;
+	cb->callback = callback;
+	cb->type = type;
+	cb->time_ms = time_ms;
+	cb->removed = false;
+	cb->when = timeval_ms() + time_ms;
+	cb->priv = priv;
+	cb->seq = target_timer_seq++;
 
-	(*callbacks_p)->when = timeval_ms() + time_ms;
-	target_timer_next_event_value = MIN(target_timer_next_event_value, (*callbacks_p)->when);
+	if (target_timer_heap_insert(cb) != ERROR_OK) {
+		free(cb);
+		return ERROR_FAIL;
+	}
 
-	(*callbacks_p)->priv = priv;
-	(*callbacks_p)->next = NULL;
+	target_timer_next_event_value = MIN(target_timer_next_event_value, cb->when);
 
 	return ERROR_OK;
 }
@@ -1821,9 +2189,19 @@ int target_unregister_timer_callback(int (*callback)(void *priv), void *priv)
 	if (!callback)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	for (struct target_timer_callback *c = target_timer_callbacks;
-	     c; c = c->next) {
-		if ((c->callback == callback) && (c->priv == priv)) {
+	for (unsigned int i = 0; i < target_timer_heap_len; i++) {
+		struct target_timer_callback *c = target_timer_heap[i];
+		if (c->callback == callback && c->priv == priv) {
+			target_timer_heap_remove(c);
+			free(c);
+			return ERROR_OK;
+		}
+	}
+
+	/* callbacks being called are off the heap and freed by the caller */
+	for (unsigned int i = 0; i < target_timer_due_len; i++) {
+		struct target_timer_callback *c = target_timer_due[i];
+		if (c && !c->removed && c->callback == callback && c->priv == priv) {
 			c->removed = true;
 			return ERROR_OK;
 		}
@@ -1837,6 +2215,18 @@ int target_call_event_callbacks(struct target *target, enum target_event event)
 	struct target_event_callback *callback = target_event_callbacks;
 	struct target_event_callback *next_callback;
 
+	/* halt, reset, flash and any other event may come with changed memory */
+	target_memcache_invalidate_all();
+
+	if (event == TARGET_EVENT_RESUMED) {
+		target_poll_soon(target);
+	} else if (event == TARGET_EVENT_HALTED && target->smp) {
+		/* the other cores of the group usually halt along */
+		struct target_list *head;
+		foreach_smp_target(head, target->smp_targets)
+			target_poll_soon(head->target);
+	}
+
 	if (event == TARGET_EVENT_HALTED) {
 		/* execute early halted first */
 		target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
@@ -1880,22 +2270,69 @@ int target_call_trace_callbacks(struct target *target, size_t len, uint8_t *data
 	return ERROR_OK;
 }
 
-static int target_timer_callback_periodic_restart(
-		struct target_timer_callback *cb, int64_t *now)
+static int target_timer_cmp_due(const void *a, const void *b)
+{
+	const struct target_timer_callback *cb_a = *(struct target_timer_callback * const *)a;
+	const struct target_timer_callback *cb_b = *(struct target_timer_callback * const *)b;
+
+	return target_timer_before(cb_a, cb_b) ? -1 : 1;
+}
+
+/* Move the callbacks to call now from the heap into target_timer_due,
+ * in deadline order */
+static int target_timer_collect_due(int checktime, int64_t now)
 {
-	cb->when = *now + cb->time_ms;
+	if (target_timer_due_max < target_timer_heap_len) {
+		free(target_timer_due);
+		target_timer_due = malloc(target_timer_heap_max * sizeof(*target_timer_due));
+		if (!target_timer_due) {
+			target_timer_due_max = 0;
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		target_timer_due_max = target_timer_heap_max;
+	}
+
+	target_timer_due_len = 0;
+
+	if (checktime) {
+		while (target_timer_heap_len && target_timer_heap[0]->when <= now) {
+			struct target_timer_callback *cb = target_timer_heap[0];
+			target_timer_heap_remove(cb);
+			target_timer_due[target_timer_due_len++] = cb;
+		}
+		return ERROR_OK;
+	}
+
+	/* all periodic callbacks are due, whatever their deadline */
+	for (unsigned int i = 0; i < target_timer_heap_len; i++) {
+		struct target_timer_callback *cb = target_timer_heap[i];
+		if (cb->type == TARGET_TIMER_TYPE_PERIODIC || cb->when <= now)
+			target_timer_due[target_timer_due_len++] = cb;
+	}
+	for (unsigned int i = 0; i < target_timer_due_len; i++)
+		target_timer_heap_remove(target_timer_due[i]);
+	qsort(target_timer_due, target_timer_due_len, sizeof(*target_timer_due),
+			target_timer_cmp_due);
+
 	return ERROR_OK;
 }
 
-static int target_call_timer_callback(struct target_timer_callback *cb,
-		int64_t *now)
+static void target_call_timer_callback(struct target_timer_callback *cb,
+		int64_t now)
 {
-	cb->callback(cb->priv);
+	int64_t late = now - cb->when;
 
-	if (cb->type == TARGET_TIMER_TYPE_PERIODIC)
-		return target_timer_callback_periodic_restart(cb, now);
+	if (late > 0) {
+		cb->max_late_ms = MAX(cb->max_late_ms, late);
+		if (cb->type == TARGET_TIMER_TYPE_PERIODIC && cb->time_ms && late >= cb->time_ms)
+			cb->overruns++;
+	}
+	cb->calls++;
 
-	return target_unregister_timer_callback(cb->callback, cb->priv);
+	int64_t start = timeval_ms();
+	cb->callback(cb->priv);
+	cb->max_run_ms = MAX(cb->max_run_ms, timeval_ms() - start);
 }
 
 static int target_call_timer_callbacks_check_time(int checktime)
@@ -1912,38 +2349,36 @@ static int target_call_timer_callbacks_check_time(int checktime)
 
 	int64_t now = timeval_ms();
 
-	/* Initialize to a default value that's a ways into the future.
-	 * The loop below will make it closer to now if there are
-	 * callbacks that want to be called sooner. */
-	target_timer_next_event_value = now + 1000;
-
-	/* Store an address of the place containing a pointer to the
-	 * next item; initially, that's a standalone "root of the
-	 * list" variable. */
-	struct target_timer_callback **callback = &target_timer_callbacks;
-	while (callback && *callback) {
-		if ((*callback)->removed) {
-			struct target_timer_callback *p = *callback;
-			*callback = (*callback)->next;
-			free(p);
-			continue;
-		}
+	int retval = target_timer_collect_due(checktime, now);
 
-		bool call_it = (*callback)->callback &&
-			((!checktime && (*callback)->type == TARGET_TIMER_TYPE_PERIODIC) ||
-			 now >= (*callback)->when);
+	for (unsigned int i = 0; i < target_timer_due_len; i++) {
+		struct target_timer_callback *cb = target_timer_due[i];
 
-		if (call_it)
-			target_call_timer_callback(*callback, &now);
+		if (!cb->removed)
+			target_call_timer_callback(cb, now);
 
-		if (!(*callback)->removed && (*callback)->when < target_timer_next_event_value)
-			target_timer_next_event_value = (*callback)->when;
+		target_timer_due[i] = NULL;
+		if (cb->removed || cb->type != TARGET_TIMER_TYPE_PERIODIC) {
+			free(cb);
+			continue;
+		}
 
-		callback = &(*callback)->next;
+		cb->when = now + cb->time_ms;
+		if (target_timer_heap_insert(cb) != ERROR_OK) {
+			free(cb);
+			retval = ERROR_FAIL;
+		}
 	}
+	target_timer_due_len = 0;
+
+	/* Without any timer, wake up again a ways into the future */
+	if (target_timer_heap_len)
+		target_timer_next_event_value = target_timer_heap[0]->when;
+	else
+		target_timer_next_event_value = now + 1000;
 
 	callback_processing = false;
-	return ERROR_OK;
+	return retval;
 }
 
 int target_call_timer_callbacks()
@@ -1969,7 +2404,7 @@ static void print_wa_layout(struct target *target)
 
 	while (c) {
 		LOG_DEBUG("%c%c " TARGET_ADDR_FMT "-" TARGET_ADDR_FMT " (%" PRIu32 " bytes)",
-			c->backup ? 'b' : ' ', c->free ? ' ' : '*',
+			c->backup ? 'b' : ' ', c->free ? ' ' : (c->parked ? 'r' : '*'),
 			c->address, c->address + c->size - 1, c->size);
 		c = c->next;
 	}
@@ -1994,6 +2429,9 @@ static void target_split_working_area(struct working_area *area, uint32_t size)
 		new_wa->backup = NULL;
 		new_wa->user = NULL;
 		new_wa->free = true;
+		new_wa->resident = NULL;
+		new_wa->parked = false;
+		new_wa->code_size = 0;
 
 		area->next = new_wa;
 		area->size = size;
@@ -2034,7 +2472,72 @@ static void target_merge_working_areas(struct target *target)
 	}
 }
 
-int target_alloc_working_area_try(struct target *target, uint32_t size, struct working_area **area)
+static int target_restore_working_area(struct target *target, struct working_area *area)
+{
+	int retval = ERROR_OK;
+
+	if (target->backup_working_area && area->backup) {
+		retval = target_write_memory(target, area->address, 4, area->size / 4, area->backup);
+		if (retval != ERROR_OK)
+			LOG_ERROR("failed to restore %" PRIu32 " bytes of working area at address " TARGET_ADDR_FMT,
+					area->size, area->address);
+	}
+
+	return retval;
+}
+
+/* Release the parked resident areas, returns true if there were any */
+static bool target_evict_resident_working_areas(struct target *target)
+{
+	bool evicted = false;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (!c->parked)
+			continue;
+
+		target_restore_working_area(target, c);
+		c->free = true;
+		c->parked = false;
+		c->resident = NULL;
+		evicted = true;
+	}
+
+	if (evicted) {
+		LOG_DEBUG("evicted resident working areas");
+		target_merge_working_areas(target);
+	}
+
+	return evicted;
+}
+
+/* Find a free area of at least size bytes, preferring the highest
+ * addresses for resident areas to keep them out of the way of the
+ * transient allocations at the bottom */
+static struct working_area *target_find_free_working_area(struct target *target,
+		uint32_t size, bool top)
+{
+	struct working_area *found = NULL;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->free && c->size >= size) {
+			found = c;
+			if (!top)
+				break;
+		}
+	}
+
+	if (found && top && found->size > size) {
+		uint32_t below = found->size - size;
+		target_split_working_area(found, below);
+		if (found->size == below)
+			found = found->next;
+	}
+
+	return found;
+}
+
+static int target_alloc_working_area_inner(struct target *target, uint32_t size,
+		struct working_area **area, const void *resident)
 {
 	/* Reevaluate working area address based on MMU state*/
 	if (!target->working_areas) {
@@ -2078,6 +2581,9 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 			new_wa->backup = NULL;
 			new_wa->user = NULL;
 			new_wa->free = true;
+			new_wa->resident = NULL;
+			new_wa->parked = false;
+			new_wa->code_size = 0;
 		}
 
 		target->working_areas = new_wa;
@@ -2086,14 +2592,11 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	/* only allocate multiples of 4 byte */
 	size = ALIGN_UP(size, 4);
 
-	struct working_area *c = target->working_areas;
+	struct working_area *c = target_find_free_working_area(target, size, resident);
 
-	/* Find the first large enough working area */
-	while (c) {
-		if (c->free && c->size >= size)
-			break;
-		c = c->next;
-	}
+	/* Make room by releasing the resident areas not in use */
+	if (!c && target_evict_resident_working_areas(target))
+		c = target_find_free_working_area(target, size, resident);
 
 	if (!c)
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
@@ -2118,6 +2621,8 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 
 	/* mark as used, and return the new (reused) area */
 	c->free = false;
+	c->resident = resident;
+	c->code_size = 0;
 	*area = c;
 
 	/* user pointer */
@@ -2128,37 +2633,124 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	return ERROR_OK;
 }
 
-int target_alloc_working_area(struct target *target, uint32_t size, struct working_area **area)
+int target_alloc_working_area_try(struct target *target, uint32_t size, struct working_area **area)
 {
-	int retval;
+	return target_alloc_working_area_inner(target, size, area, NULL);
+}
 
-	retval = target_alloc_working_area_try(target, size, area);
-	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
-		LOG_WARNING("not enough working area available(requested %"PRIu32")", size);
-	return retval;
+/* Take a parked resident area back into use */
+static void target_unpark_working_area(struct working_area *c, struct working_area **area)
+{
+	c->parked = false;
+	c->user = area;
+	*area = c;
+	LOG_DEBUG("reusing resident working area at " TARGET_ADDR_FMT, c->address);
+}
+
+int target_alloc_resident_working_area(struct target *target, const void *tag,
+		uint32_t size, struct working_area **area, bool *loaded)
+{
+	*loaded = false;
 
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->resident != tag || !c->parked)
+			continue;
+
+		if (c->size == ALIGN_UP(size, 4)) {
+			*loaded = !c->written;
+			target_unpark_working_area(c, area);
+			return ERROR_OK;
+		}
+
+		/* same loader with another size, drop the old copy */
+		target_restore_working_area(target, c);
+		c->free = true;
+		c->parked = false;
+		c->resident = NULL;
+		target_merge_working_areas(target);
+		break;
+	}
+
+	return target_alloc_working_area_inner(target, size, area, tag);
 }
 
-static int target_restore_working_area(struct target *target, struct working_area *area)
+/* Tag of the areas allocated by target_alloc_loader_working_area() */
+static const char loader_working_area_tag;
+
+int target_alloc_loader_working_area(struct target *target, const uint8_t *code,
+		uint32_t code_size, uint32_t size, struct working_area **area)
 {
-	int retval = ERROR_OK;
+	uint32_t code_crc = crc32_le(CRC32_POLY_LE, 0xffffffff, code, code_size);
 
-	if (target->backup_working_area && area->backup) {
-		retval = target_write_memory(target, area->address, 4, area->size / 4, area->backup);
-		if (retval != ERROR_OK)
-			LOG_ERROR("failed to restore %" PRIu32 " bytes of working area at address " TARGET_ADDR_FMT,
-					area->size, area->address);
+	size = ALIGN_UP(MAX(size, code_size), 4);
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->resident == &loader_working_area_tag && c->parked && !c->written
+				&& c->size == size && c->code_size == code_size
+				&& c->code_crc == code_crc) {
+			target_unpark_working_area(c, area);
+			return ERROR_OK;
+		}
+	}
+
+	int retval = target_alloc_working_area_inner(target, size, area,
+			&loader_working_area_tag);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = target_write_buffer(target, (*area)->address, code_size, code);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, *area);
+		return retval;
+	}
+
+	(*area)->code_size = code_size;
+	(*area)->code_crc = code_crc;
+
+	return ERROR_OK;
+}
+
+/* Note a write to the target memory in the resident areas it overlaps.
+ * Working areas of several targets often share the same memory, so the
+ * areas of all targets are checked. */
+static void target_resident_working_areas_written(target_addr_t address, uint64_t size)
+{
+	for (struct target *target = all_targets; target; target = target->next) {
+		for (struct working_area *c = target->working_areas; c; c = c->next) {
+			if (c->resident && address < c->address + c->size
+					&& c->address < address + size)
+				c->written = true;
+		}
 	}
+}
+
+int target_alloc_working_area(struct target *target, uint32_t size, struct working_area **area)
+{
+	int retval;
 
+	retval = target_alloc_working_area_try(target, size, area);
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+		LOG_WARNING("not enough working area available(requested %"PRIu32")", size);
 	return retval;
+
 }
 
 /* Restore the area's backup memory, if any, and return the area to the allocation pool */
 static int target_free_working_area_restore(struct target *target, struct working_area *area, int restore)
 {
-	if (!area || area->free)
+	if (!area || area->free || area->parked)
 		return ERROR_OK;
 
+	if (area->resident) {
+		/* keep the area and its content for the next user of the tag */
+		area->parked = true;
+		area->written = false;
+		*area->user = NULL;
+		area->user = NULL;
+		print_wa_layout(target);
+		return ERROR_OK;
+	}
+
 	int retval = ERROR_OK;
 	if (restore) {
 		retval = target_restore_working_area(target, area);
@@ -2206,7 +2798,10 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 			if (restore)
 				target_restore_working_area(target, c);
 			c->free = true;
-			*c->user = NULL; /* Same as above */
+			c->parked = false;
+			c->resident = NULL;
+			if (c->user)
+				*c->user = NULL; /* Same as above */
 			c->user = NULL;
 		}
 		c = c->next;
@@ -2240,6 +2835,11 @@ uint32_t target_get_working_area_avail(struct target *target)
 	if (!c)
 		return ALIGN_DOWN(target->working_area_size, 4);
 
+	/* The caller is about to size an allocation, make the resident
+	 * areas not in use available to it */
+	if (target_evict_resident_working_areas(target))
+		c = target->working_areas;
+
 	while (c) {
 		if (c->free && max_size < c->size)
 			max_size = c->size;
@@ -2255,9 +2855,8 @@ static void target_destroy(struct target *target)
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
-	if (target->semihosting)
-		free(target->semihosting->basedir);
-	free(target->semihosting);
+	semihosting_common_free(target);
+	target_request_free(target);
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
 
@@ -2271,6 +2870,9 @@ static void target_destroy(struct target *target)
 
 	target_free_all_working_areas(target);
 
+	target_memcache_free(target);
+	register_name_index_free(target->reg_name_index);
+
 	/* release the targets SMP list */
 	if (target->smp) {
 		struct target_list *head, *tmp;
@@ -2286,6 +2888,7 @@ static void target_destroy(struct target *target)
 	}
 
 	rtos_destroy(target);
+	metric_unregister(&target->poll_metric);
 
 	free(target->gdb_port_override);
 	free(target->type);
@@ -2305,13 +2908,15 @@ void target_quit(void)
 	}
 	target_event_callbacks = NULL;
 
-	struct target_timer_callback *pt = target_timer_callbacks;
-	while (pt) {
-		struct target_timer_callback *t = pt->next;
-		free(pt);
-		pt = t;
-	}
-	target_timer_callbacks = NULL;
+	for (unsigned int i = 0; i < target_timer_heap_len; i++)
+		free(target_timer_heap[i]);
+	free(target_timer_heap);
+	target_timer_heap = NULL;
+	target_timer_heap_len = 0;
+	target_timer_heap_max = 0;
+	free(target_timer_due);
+	target_timer_due = NULL;
+	target_timer_due_max = 0;
 
 	for (struct target *target = all_targets; target;) {
 		struct target *tmp;
@@ -2428,14 +3033,28 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	target_memcache_invalidate_all();
+	target_resident_working_areas_written(address, size);
+
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
+/* One piece of an unaligned buffer access, queued if the target supports it */
+static int target_write_buffer_piece(struct target *target, bool queued,
+		target_addr_t address, uint32_t size, uint32_t count, const uint8_t *buffer)
+{
+	if (queued)
+		return target->type->queue_write_memory(target, address, size, count, buffer);
+	return target_write_memory(target, address, size, count, buffer);
+}
+
 static int target_write_buffer_default(struct target *target,
 	target_addr_t address, uint32_t count, const uint8_t *buffer)
 {
 	uint32_t size;
 	unsigned int data_bytes = target_data_bits(target) / 8;
+	bool queued = target->type->queue_write_memory && target->type->run_queued_memory;
+	int retval = ERROR_OK;
 
 	/* Align up to maximum bytes. The loop condition makes sure the next pass
 	 * will have something to do with the size we leave to it. */
@@ -2443,9 +3062,9 @@ static int target_write_buffer_default(struct target *target,
 			size < data_bytes && count >= size * 2 + (address & size);
 			size *= 2) {
 		if (address & size) {
-			int retval = target_write_memory(target, address, size, 1, buffer);
+			retval = target_write_buffer_piece(target, queued, address, size, 1, buffer);
 			if (retval != ERROR_OK)
-				return retval;
+				goto out;
 			address += size;
 			count -= size;
 			buffer += size;
@@ -2456,16 +3075,24 @@ static int target_write_buffer_default(struct target *target,
 	for (; size > 0; size /= 2) {
 		uint32_t aligned = count - count % size;
 		if (aligned > 0) {
-			int retval = target_write_memory(target, address, size, aligned / size, buffer);
+			retval = target_write_buffer_piece(target, queued, address, size, aligned / size, buffer);
 			if (retval != ERROR_OK)
-				return retval;
+				goto out;
 			address += aligned;
 			count -= aligned;
 			buffer += aligned;
 		}
 	}
 
-	return ERROR_OK;
+out:
+	/* run what got queued before a failure too */
+	if (queued) {
+		int run_retval = target->type->run_queued_memory(target);
+		if (retval == ERROR_OK)
+			retval = run_retval;
+	}
+
+	return retval;
 }
 
 /* Single aligned words are guaranteed to use 16 or 32 bit access
@@ -2493,13 +3120,27 @@ int target_read_buffer(struct target *target, target_addr_t address, uint32_t si
 		return ERROR_FAIL;
 	}
 
+	if (target_memcache_read(target, address, 1, size, buffer))
+		return ERROR_OK;
+
 	return target->type->read_buffer(target, address, size, buffer);
 }
 
+/* One piece of an unaligned buffer access, queued if the target supports it */
+static int target_read_buffer_piece(struct target *target, bool queued,
+		target_addr_t address, uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	if (queued)
+		return target->type->queue_read_memory(target, address, size, count, buffer);
+	return target_read_memory(target, address, size, count, buffer);
+}
+
 static int target_read_buffer_default(struct target *target, target_addr_t address, uint32_t count, uint8_t *buffer)
 {
 	uint32_t size;
 	unsigned int data_bytes = target_data_bits(target) / 8;
+	bool queued = target->type->queue_read_memory && target->type->run_queued_memory;
+	int retval = ERROR_OK;
 
 	/* Align up to maximum bytes. The loop condition makes sure the next pass
 	 * will have something to do with the size we leave to it. */
@@ -2507,9 +3148,9 @@ static int target_read_buffer_default(struct target *target, target_addr_t addre
 			size < data_bytes && count >= size * 2 + (address & size);
 			size *= 2) {
 		if (address & size) {
-			int retval = target_read_memory(target, address, size, 1, buffer);
+			retval = target_read_buffer_piece(target, queued, address, size, 1, buffer);
 			if (retval != ERROR_OK)
-				return retval;
+				goto out;
 			address += size;
 			count -= size;
 			buffer += size;
@@ -2520,58 +3161,86 @@ static int target_read_buffer_default(struct target *target, target_addr_t addre
 	for (; size > 0; size /= 2) {
 		uint32_t aligned = count - count % size;
 		if (aligned > 0) {
-			int retval = target_read_memory(target, address, size, aligned / size, buffer);
+			retval = target_read_buffer_piece(target, queued, address, size, aligned / size, buffer);
 			if (retval != ERROR_OK)
-				return retval;
+				goto out;
 			address += aligned;
 			count -= aligned;
 			buffer += aligned;
 		}
 	}
 
-	return ERROR_OK;
+out:
+	/* run what got queued before a failure too */
+	if (queued) {
+		int run_retval = target->type->run_queued_memory(target);
+		if (retval == ERROR_OK)
+			retval = run_retval;
+	}
+
+	return retval;
+}
+
+/* Host side checksum for targets without a loader. The memory is read in
+ * chunks, so that large ranges need no buffer of their full size. */
+#define TARGET_CHECKSUM_CHUNK_SIZE		(64 * 1024)
+
+static int target_checksum_memory_host(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t *crc)
+{
+	uint32_t chunk_size = MIN(size, TARGET_CHECKSUM_CHUNK_SIZE);
+	uint32_t checksum = 0xffffffff;
+	int retval = ERROR_OK;
+
+	uint8_t *buffer = malloc(MAX(chunk_size, 1));
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	while (size > 0) {
+		uint32_t count = MIN(size, chunk_size);
+
+		retval = target_read_buffer(target, address, count, buffer);
+		if (retval != ERROR_OK)
+			break;
+
+		/* the buffer is in target endianness already, as is the image;
+		 * the CRC is the one of gdb, see image_calculate_checksum() */
+		checksum = crc32_be(CRC32_POLY_BE, checksum, buffer, count);
+
+		address += count;
+		size -= count;
+		keep_alive();
+	}
+
+	free(buffer);
+
+	if (retval == ERROR_OK)
+		*crc = checksum;
+
+	return retval;
 }
 
 int target_checksum_memory(struct target *target, target_addr_t address, uint32_t size, uint32_t *crc)
 {
-	uint8_t *buffer;
 	int retval;
-	uint32_t i;
 	uint32_t checksum = 0;
 	if (!target_was_examined(target)) {
 		LOG_ERROR("Target not examined yet");
 		return ERROR_FAIL;
 	}
-	if (!target->type->checksum_memory) {
-		LOG_ERROR("Target %s doesn't support checksum_memory", target_name(target));
-		return ERROR_FAIL;
-	}
 
-	retval = target->type->checksum_memory(target, address, size, &checksum);
-	if (retval != ERROR_OK) {
-		buffer = malloc(size);
-		if (!buffer) {
-			LOG_ERROR("error allocating buffer for section (%" PRIu32 " bytes)", size);
-			return ERROR_COMMAND_SYNTAX_ERROR;
-		}
-		retval = target_read_buffer(target, address, size, buffer);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			return retval;
-		}
-
-		/* convert to target endianness */
-		for (i = 0; i < (size/sizeof(uint32_t)); i++) {
-			uint32_t target_data;
-			target_data = target_buffer_get_u32(target, &buffer[i*sizeof(uint32_t)]);
-			target_buffer_set_u32(target, &buffer[i*sizeof(uint32_t)], target_data);
-		}
-
-		retval = image_calculate_checksum(buffer, size, &checksum);
-		free(buffer);
-	}
+	/* targets without an algorithm, and those whose algorithm cannot be
+	 * used for this range, checksum on the host */
+	retval = ERROR_NOT_IMPLEMENTED;
+	if (target->type->checksum_memory)
+		retval = target->type->checksum_memory(target, address, size, &checksum);
+	if (retval != ERROR_OK)
+		retval = target_checksum_memory_host(target, address, size, &checksum);
 
-	*crc = checksum;
+	if (retval == ERROR_OK)
+		*crc = checksum;
 
 	return retval;
 }
@@ -2974,6 +3643,55 @@ static int sense_handler(void)
 	return ERROR_OK;
 }
 
+void target_poll_soon(struct target *target)
+{
+	target->poll.current_ms = target->poll.interval_ms;
+	target->poll.next = 0;
+}
+
+/* Run handle_target() at the fastest polling interval of all targets */
+static int target_poll_update_tick(void)
+{
+	/* before 'init' */
+	if (!handle_target_interp)
+		return ERROR_OK;
+
+	unsigned int tick = polling_interval;
+	for (struct target *target = all_targets; target; target = target->next)
+		tick = MIN(tick, target->poll.interval_ms);
+
+	if (tick == handle_target_tick_ms)
+		return ERROR_OK;
+
+	if (handle_target_tick_ms)
+		target_unregister_timer_callback(&handle_target, handle_target_interp);
+	handle_target_tick_ms = tick;
+
+	return target_register_timer_callback(&handle_target, tick,
+			TARGET_TIMER_TYPE_PERIODIC, handle_target_interp);
+}
+
+static void target_poll_account(struct target *target, int64_t start_us, int retval)
+{
+	struct target_poll *poll = &target->poll;
+	int64_t cost = timeval_us() - start_us;
+
+	poll->polls++;
+	if (retval != ERROR_OK)
+		poll->failures++;
+	poll->total_us += cost;
+	poll->max_us = MAX(poll->max_us, cost);
+
+	/* back off exponentially while the target keeps running */
+	if (target->state == TARGET_RUNNING && poll->current_ms)
+		poll->current_ms = MIN(2 * poll->current_ms,
+				MAX(poll->interval_max_ms, poll->interval_ms));
+	else
+		poll->current_ms = poll->interval_ms;
+
+	poll->next = start_us / 1000 + poll->current_ms;
+}
+
 /* process target state changes */
 static int handle_target(void *priv)
 {
@@ -3042,6 +3760,10 @@ static int handle_target(void *priv)
 		if (!target->tap->enabled)
 			continue;
 
+		/* not due yet, allowing for half a period of timer jitter */
+		if (target->poll.next - timeval_ms() > handle_target_tick_ms / 2)
+			continue;
+
 		if (target->backoff.times > target->backoff.count) {
 			/* do not poll this time as we failed previously */
 			target->backoff.count++;
@@ -3052,10 +3774,12 @@ static int handle_target(void *priv)
 		/* only poll target if we've got power and srst isn't asserted */
 		if (!power_dropout && !srst_asserted) {
 			/* polling may fail silently until the target has been examined */
+			int64_t start = timeval_us();
 			retval = target_poll(target);
+			target_poll_account(target, start, retval);
 			if (retval != ERROR_OK) {
-				/* 100ms polling interval. Increase interval between polling up to 5000ms */
-				if (target->backoff.times * polling_interval < 5000) {
+				/* Increase interval between polling up to 5000ms */
+				if (target->backoff.times * handle_target_tick_ms < 5000) {
 					target->backoff.times *= 2;
 					target->backoff.times++;
 				}
@@ -3073,8 +3797,8 @@ static int handle_target(void *priv)
 				 * but we set the examined flag anyway to repoll it later */
 				if (retval != ERROR_OK) {
 					target_set_examined(target);
-					LOG_USER("Examination failed, GDB will be halted. Polling again in %dms",
-						 target->backoff.times * polling_interval);
+					LOG_USER("Examination failed, GDB will be halted. Polling again in %ums",
+						 target->backoff.times * handle_target_tick_ms);
 					return retval;
 				}
 			}
@@ -3160,7 +3884,7 @@ COMMAND_HANDLER(handle_reg_command)
 		}
 	} else {
 		/* access a single register by its name */
-		reg = register_get_by_name(target->reg_cache, CMD_ARGV[0], true);
+		reg = target_reg_get_by_name(target, CMD_ARGV[0], true);
 
 		if (!reg)
 			goto not_found;
@@ -3302,6 +4026,65 @@ int target_wait_state(struct target *target, enum target_state state, int ms)
 	return ERROR_OK;
 }
 
+int target_wait_state_all(struct target **targets, unsigned int num_targets,
+		enum target_state state, int ms, int *status)
+{
+	const char *state_name = jim_nvp_value2name_simple(nvp_target_state, state)->name;
+	int64_t then = timeval_ms();
+	unsigned int num_waiting = num_targets;
+
+	bool *waiting = malloc(num_targets * sizeof(*waiting));
+	if (!waiting) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	for (unsigned int i = 0; i < num_targets; i++) {
+		waiting[i] = true;
+		status[i] = ERROR_TARGET_TIMEOUT;
+	}
+
+	LOG_DEBUG("waiting for %u targets %s...", num_targets, state_name);
+
+	while (num_waiting) {
+		/* poll all of them in each round, the timeout is shared */
+		for (unsigned int i = 0; i < num_targets; i++) {
+			if (!waiting[i])
+				continue;
+
+			int retval = target_poll(targets[i]);
+			if (retval == ERROR_OK && targets[i]->state != state)
+				continue;
+
+			status[i] = retval;
+			waiting[i] = false;
+			num_waiting--;
+		}
+		if (!num_waiting)
+			break;
+
+		int64_t cur = timeval_ms();
+		if (cur - then > 500)
+			keep_alive();
+
+		if (cur - then > ms) {
+			for (unsigned int i = 0; i < num_targets; i++) {
+				if (waiting[i])
+					LOG_TARGET_ERROR(targets[i], "timed out while waiting for target %s",
+							state_name);
+			}
+			break;
+		}
+	}
+	free(waiting);
+
+	for (unsigned int i = 0; i < num_targets; i++) {
+		if (status[i] != ERROR_OK)
+			return status[i];
+	}
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_halt_command)
 {
 	LOG_DEBUG("-");
@@ -3658,8 +4441,29 @@ static COMMAND_HELPER(parse_load_image_command, struct image *image,
 	return ERROR_OK;
 }
 
+/* the gaps between sections load_image and fast_load_image fill to merge them */
+static uint32_t image_merge_gap;
+static uint8_t image_merge_padding = 0xff;
+
+COMMAND_HANDLER(handle_image_merge_gap_command)
+{
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC >= 1)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], image_merge_gap);
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_NUMBER(u8, CMD_ARGV[1], image_merge_padding);
+
+	command_print(CMD, "image merge gap %" PRIu32 " bytes, padding 0x%02" PRIx8,
+			image_merge_gap, image_merge_padding);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_load_image_command)
 {
+	const uint8_t *data;
 	uint8_t *buffer;
 	size_t buf_cnt;
 	uint32_t image_size;
@@ -3677,46 +4481,54 @@ COMMAND_HANDLER(handle_load_image_command)
 	struct duration bench;
 	duration_start(&bench);
 
+	/* the time spent decoding and reading the image, and writing the target */
+	int64_t read_us = 0;
+	int64_t write_us = 0;
+	int64_t begin = timeval_us();
+
 	if (image_open(&image, CMD_ARGV[0], (CMD_ARGC >= 3) ? CMD_ARGV[2] : NULL) != ERROR_OK)
 		return ERROR_FAIL;
 
+	/* the sections next to each other written at once */
+	struct image_plan plan;
+	retval = image_plan_runs(&image, image_merge_gap, image_merge_padding, &plan);
+	if (retval != ERROR_OK) {
+		image_close(&image);
+		return retval;
+	}
+
 	image_size = 0x0;
-	retval = ERROR_OK;
-	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD,
-						  "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
-			break;
-		}
+	for (unsigned int i = 0; i < plan.num_runs; i++) {
+		struct image_run *run = &plan.runs[i];
 
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+		/* in place, from the mapping of the file, whenever possible */
+		retval = image_get_run(&image, &plan, i, &data, &buffer);
+		read_us += timeval_us() - begin;
+		if (retval != ERROR_OK)
 			break;
-		}
+		buf_cnt = run->size;
 
 		uint32_t offset = 0;
 		uint32_t length = buf_cnt;
 
 		/* DANGER!!! beware of unsigned comparison here!!! */
 
-		if ((image.sections[i].base_address + buf_cnt >= min_address) &&
-				(image.sections[i].base_address < max_address)) {
+		if (run->base_address + buf_cnt >= min_address &&
+				run->base_address < max_address) {
 
-			if (image.sections[i].base_address < min_address) {
+			if (run->base_address < min_address) {
 				/* clip addresses below */
-				offset += min_address-image.sections[i].base_address;
+				offset += min_address - run->base_address;
 				length -= offset;
 			}
 
-			if (image.sections[i].base_address + buf_cnt > max_address)
-				length -= (image.sections[i].base_address + buf_cnt)-max_address;
+			if (run->base_address + buf_cnt > max_address)
+				length -= (run->base_address + buf_cnt) - max_address;
 
+			begin = timeval_us();
 			retval = target_write_buffer(target,
-					image.sections[i].base_address + offset, length, buffer + offset);
+					run->base_address + offset, length, data + offset);
+			write_us += timeval_us() - begin;
 			if (retval != ERROR_OK) {
 				free(buffer);
 				break;
@@ -3724,18 +4536,22 @@ COMMAND_HANDLER(handle_load_image_command)
 			image_size += length;
 			command_print(CMD, "%u bytes written at address " TARGET_ADDR_FMT "",
 					(unsigned int)length,
-					image.sections[i].base_address + offset);
+					run->base_address + offset);
 		}
 
 		free(buffer);
+		begin = timeval_us();
 	}
 
 	if ((retval == ERROR_OK) && (duration_measure(&bench) == ERROR_OK)) {
 		command_print(CMD, "downloaded %" PRIu32 " bytes "
 				"in %fs (%0.3f KiB/s)", image_size,
 				duration_elapsed(&bench), duration_kbps(&bench, image_size));
+		command_print(CMD, "image read in %.3fs, target written in %.3fs",
+				read_us / 1000000.0, write_us / 1000000.0);
 	}
 
+	image_plan_free(&plan);
 	image_close(&image);
 
 	return retval;
@@ -3757,7 +4573,8 @@ COMMAND_HANDLER(handle_dump_image_command)
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[2], size);
 
-	uint32_t buf_size = (size > 4096) ? 4096 : size;
+	/* large chunks, each read is a round trip of the adapter */
+	uint32_t buf_size = (size > 65536) ? 65536 : size;
 	buffer = malloc(buf_size);
 	if (!buffer)
 		return ERROR_FAIL;
@@ -3770,6 +4587,10 @@ COMMAND_HANDLER(handle_dump_image_command)
 
 	duration_start(&bench);
 
+	/* the checksum of verify_image, computed on the way */
+	uint32_t crc = 0xffffffff;
+	retval = ERROR_OK;
+
 	while (size > 0) {
 		size_t size_written;
 		uint32_t this_run_size = (size > buf_size) ? buf_size : size;
@@ -3781,8 +4602,11 @@ COMMAND_HANDLER(handle_dump_image_command)
 		if (retval != ERROR_OK)
 			break;
 
+		crc = crc32_be(CRC32_POLY_BE, crc, buffer, this_run_size);
+
 		size -= this_run_size;
 		address += this_run_size;
+		keep_alive();
 	}
 
 	free(buffer);
@@ -3793,8 +4617,9 @@ COMMAND_HANDLER(handle_dump_image_command)
 		if (retval != ERROR_OK)
 			return retval;
 		command_print(CMD,
-				"dumped %zu bytes in %fs (%0.3f KiB/s)", filesize,
-				duration_elapsed(&bench), duration_kbps(&bench, filesize));
+				"dumped %zu bytes in %fs (%0.3f KiB/s), checksum 0x%08" PRIx32,
+				filesize, duration_elapsed(&bench), duration_kbps(&bench, filesize),
+				crc);
 	}
 
 	retvaltemp = fileio_close(fileio);
@@ -3810,9 +4635,77 @@ enum verify_mode {
 	IMAGE_CHECKSUM_ONLY = 2
 };
 
+/* the differences of verify_image listed */
+#define VERIFY_IMAGE_MAX_DIFFS		128
+/* the pieces of a mismatch read back to list the differences */
+#define VERIFY_IMAGE_COMPARE_SIZE	4096
+
+/*
+ * List the differences of a range whose checksum differs from the image.
+ * With a checksum algorithm on the target, cut the range in halves and give
+ * up those whose checksums match until the pieces are small, to read back
+ * only them.
+ */
+static int verify_image_compare(struct command_invocation *cmd, struct target *target,
+	target_addr_t address, const uint8_t *buffer, uint32_t size, int *diffs)
+{
+	if (size > VERIFY_IMAGE_COMPARE_SIZE && target->type->checksum_memory) {
+		uint32_t half = (size / 2) & ~3u;
+		uint32_t offsets[2] = { 0, half };
+		uint32_t sizes[2] = { half, size - half };
+
+		for (unsigned int i = 0; i < 2; i++) {
+			uint32_t checksum, mem_checksum;
+
+			int retval = image_calculate_checksum(buffer + offsets[i], sizes[i],
+					&checksum);
+			if (retval == ERROR_OK)
+				retval = target_checksum_memory(target, address + offsets[i], sizes[i],
+						&mem_checksum);
+			if (retval != ERROR_OK)
+				return retval;
+			if (checksum == mem_checksum)
+				continue;
+
+			retval = verify_image_compare(cmd, target, address + offsets[i],
+					buffer + offsets[i], sizes[i], diffs);
+			if (retval != ERROR_OK || *diffs >= VERIFY_IMAGE_MAX_DIFFS)
+				return retval;
+		}
+
+		return ERROR_OK;
+	}
+
+	uint8_t *data = malloc(size);
+	if (!data) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = target_read_buffer(target, address, size, data);
+	if (retval == ERROR_OK) {
+		for (uint32_t t = 0; t < size; t++) {
+			if (data[t] != buffer[t]) {
+				command_print(cmd,
+						"diff %d address 0x%08x. Was 0x%02x instead of 0x%02x",
+						*diffs, (unsigned int)(t + address), data[t], buffer[t]);
+				if (++*diffs >= VERIFY_IMAGE_MAX_DIFFS) {
+					command_print(cmd, "More than 128 errors, the rest are not printed.");
+					break;
+				}
+			}
+		}
+		keep_alive();
+	}
+	free(data);
+
+	return retval;
+}
+
 static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode verify)
 {
-	uint8_t *buffer;
+	const uint8_t *buffer;
+	uint8_t *copy;
 	size_t buf_cnt;
 	uint32_t image_size;
 	int retval;
@@ -3850,81 +4743,63 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* the sections next to each other checked at once, never the gaps */
+	struct image_plan plan;
+	retval = image_plan_runs(&image, 0, 0, &plan);
+	if (retval != ERROR_OK) {
+		image_close(&image);
+		return retval;
+	}
+
 	image_size = 0x0;
 	int diffs = 0;
-	retval = ERROR_OK;
-	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD,
-					"error allocating buffer for section (%" PRIu32 " bytes)",
-					image.sections[i].size);
-			break;
-		}
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+	for (unsigned int i = 0; i < plan.num_runs; i++) {
+		struct image_run *run = &plan.runs[i];
+
+		/* in place, from the mapping of the file, whenever possible */
+		retval = image_get_run(&image, &plan, i, &buffer, &copy);
+		if (retval != ERROR_OK)
 			break;
-		}
+		buf_cnt = run->size;
 
 		if (verify >= IMAGE_VERIFY) {
 			/* calculate checksum of image */
 			retval = image_calculate_checksum(buffer, buf_cnt, &checksum);
 			if (retval != ERROR_OK) {
-				free(buffer);
+				free(copy);
 				break;
 			}
 
-			retval = target_checksum_memory(target, image.sections[i].base_address, buf_cnt, &mem_checksum);
+			retval = target_checksum_memory(target, run->base_address, buf_cnt, &mem_checksum);
 			if (retval != ERROR_OK) {
-				free(buffer);
+				free(copy);
 				break;
 			}
 			if ((checksum != mem_checksum) && (verify == IMAGE_CHECKSUM_ONLY)) {
 				LOG_ERROR("checksum mismatch");
-				free(buffer);
+				free(copy);
 				retval = ERROR_FAIL;
 				goto done;
 			}
 			if (checksum != mem_checksum) {
 				/* failed crc checksum, fall back to a binary compare */
-				uint8_t *data;
-
 				if (diffs == 0)
 					LOG_ERROR("checksum mismatch - attempting binary compare");
 
-				data = malloc(buf_cnt);
-
-				retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, data);
-				if (retval == ERROR_OK) {
-					uint32_t t;
-					for (t = 0; t < buf_cnt; t++) {
-						if (data[t] != buffer[t]) {
-							command_print(CMD,
-										  "diff %d address 0x%08x. Was 0x%02x instead of 0x%02x",
-										  diffs,
-										  (unsigned)(t + image.sections[i].base_address),
-										  data[t],
-										  buffer[t]);
-							if (diffs++ >= 127) {
-								command_print(CMD, "More than 128 errors, the rest are not printed.");
-								free(data);
-								free(buffer);
-								goto done;
-							}
-						}
-						keep_alive();
-					}
+				retval = verify_image_compare(CMD, target, run->base_address,
+						buffer, buf_cnt, &diffs);
+				if (retval != ERROR_OK || diffs >= VERIFY_IMAGE_MAX_DIFFS) {
+					free(copy);
+					goto done;
 				}
-				free(data);
 			}
 		} else {
 			command_print(CMD, "address " TARGET_ADDR_FMT " length 0x%08zx",
-						  image.sections[i].base_address,
+						  run->base_address,
 						  buf_cnt);
 		}
 
-		free(buffer);
+		free(copy);
 		image_size += buf_cnt;
 	}
 	if (diffs > 0)
@@ -3938,6 +4813,7 @@ done:
 				duration_elapsed(&bench), duration_kbps(&bench, image_size));
 	}
 
+	image_plan_free(&plan);
 	image_close(&image);
 
 	return retval;
@@ -4072,20 +4948,74 @@ COMMAND_HANDLER(handle_bp_command)
 	}
 }
 
+COMMAND_HANDLER(handle_bp_batch_command)
+{
+	if (CMD_ARGC < 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	uint32_t length;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], length);
+
+	unsigned int count = CMD_ARGC - 1;
+	target_addr_t *addresses = malloc(count * sizeof(*addresses));
+	if (!addresses) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; i++)
+		retval = parse_target_addr(CMD_ARGV[i + 1], &addresses[i]);
+	if (retval != ERROR_OK) {
+		free(addresses);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	retval = breakpoint_add_batch(target, addresses, count, length);
+	/* error is always logged in breakpoint_add_batch(), do not print it again */
+	if (retval == ERROR_OK)
+		command_print(CMD, "%u breakpoints set", count);
+
+	free(addresses);
+	return retval;
+}
+
 COMMAND_HANDLER(handle_rbp_command)
 {
-	if (CMD_ARGC != 1)
+	if (CMD_ARGC < 1)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	struct target *target = get_current_target(CMD_CTX);
 
 	if (!strcmp(CMD_ARGV[0], "all")) {
+		if (CMD_ARGC != 1)
+			return ERROR_COMMAND_SYNTAX_ERROR;
 		breakpoint_remove_all(target);
-	} else {
+	} else if (CMD_ARGC == 1) {
 		target_addr_t addr;
 		COMMAND_PARSE_ADDRESS(CMD_ARGV[0], addr);
 
 		breakpoint_remove(target, addr);
+	} else {
+		target_addr_t *addresses = malloc(CMD_ARGC * sizeof(*addresses));
+		if (!addresses) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+
+		for (unsigned int i = 0; i < CMD_ARGC; i++) {
+			if (parse_target_addr(CMD_ARGV[i], &addresses[i]) != ERROR_OK) {
+				free(addresses);
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+		}
+
+		unsigned int removed = breakpoint_remove_batch(target, addresses, CMD_ARGC);
+		if (removed < CMD_ARGC)
+			LOG_WARNING("%u of %u breakpoints not found", CMD_ARGC - removed, CMD_ARGC);
+
+		free(addresses);
 	}
 
 	return ERROR_OK;
@@ -4218,14 +5148,16 @@ static void write_string(FILE *f, char *s)
 
 typedef unsigned char UNIT[2];  /* unit of profiling */
 
-/* Dump a gmon.out histogram file. */
-static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filename, bool with_range,
-			uint32_t start_address, uint32_t end_address, struct target *target, uint32_t duration_ms)
+int target_write_gmon(struct target *target, const uint32_t *samples, const uint32_t *counts,
+		uint32_t sample_num, const char *filename, bool with_range,
+		uint32_t start_address, uint32_t end_address, uint32_t duration_ms)
 {
 	uint32_t i;
 	FILE *f = fopen(filename, "w");
-	if (!f)
-		return;
+	if (!f) {
+		LOG_ERROR("couldn't create %s: %s", filename, strerror(errno));
+		return ERROR_FAIL;
+	}
 	write_string(f, "gmon");
 	write_long(f, 0x00000001, target); /* Version */
 	write_long(f, 0, target); /* padding */
@@ -4273,15 +5205,17 @@ static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filen
 	uint32_t num_buckets = address_space / sizeof(UNIT);
 	if (num_buckets > max_buckets)
 		num_buckets = max_buckets;
-	int *buckets = malloc(sizeof(int) * num_buckets);
+	uint32_t *buckets = calloc(num_buckets, sizeof(*buckets));
 	if (!buckets) {
 		fclose(f);
-		return;
+		return ERROR_FAIL;
 	}
-	memset(buckets, 0, sizeof(int) * num_buckets);
+	uint64_t total = 0;
 	for (i = 0; i < sample_num; i++) {
 		uint32_t address = samples[i];
+		uint32_t count = counts ? counts[i] : 1;
 
+		total += count;
 		if ((address < min) || (max <= address))
 			continue;
 
@@ -4289,14 +5223,14 @@ static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filen
 		long long b = num_buckets;
 		long long c = address_space;
 		int index_t = (a * b) / c; /* danger!!!! int32 overflows */
-		buckets[index_t]++;
+		buckets[index_t] = MIN((uint64_t)buckets[index_t] + count, UINT32_MAX);
 	}
 
 	/* append binary memory gmon.out &profile_hist_hdr ((char*)&profile_hist_hdr + sizeof(struct gmon_hist_hdr)) */
 	write_long(f, min, target);			/* low_pc */
 	write_long(f, max, target);			/* high_pc */
 	write_long(f, num_buckets, target);	/* # of buckets */
-	float sample_rate = sample_num / (duration_ms / 1000.0);
+	float sample_rate = total / (duration_ms / 1000.0);
 	write_long(f, sample_rate, target);
 	write_string(f, "seconds");
 	for (i = 0; i < (15-strlen("seconds")); i++)
@@ -4308,7 +5242,7 @@ static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filen
 	char *data = malloc(2 * num_buckets);
 	if (data) {
 		for (i = 0; i < num_buckets; i++) {
-			int val;
+			uint32_t val;
 			val = buckets[i];
 			if (val > 65535)
 				val = 65535;
@@ -4322,6 +5256,8 @@ static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filen
 		free(buckets);
 
 	fclose(f);
+
+	return ERROR_OK;
 }
 
 /* profiling samples the CPU PC as quickly as OpenOCD is able,
@@ -4406,9 +5342,10 @@ COMMAND_HANDLER(handle_profile_command)
 		return retval;
 	}
 
-	write_gmon(samples, num_of_samples, CMD_ARGV[1],
-		   with_range, start_address, end_address, target, duration_ms);
-	command_print(CMD, "Wrote %s", CMD_ARGV[1]);
+	retval = target_write_gmon(target, samples, NULL, num_of_samples, CMD_ARGV[1],
+		   with_range, start_address, end_address, duration_ms);
+	if (retval == ERROR_OK)
+		command_print(CMD, "Wrote %s", CMD_ARGV[1]);
 
 	free(samples);
 	return retval;
@@ -4570,17 +5507,29 @@ static int target_mem2array(Jim_Interp *interp, struct target *target, int argc,
 			e = JIM_ERR;
 			break;
 		} else {
+			/* convert the chunk in place to host endianness */
+			switch (width) {
+				case 8:
+					target_buffer_get_u64_array(target, buffer, chunk_len, (uint64_t *)buffer);
+					break;
+				case 4:
+					target_buffer_get_u32_array(target, buffer, chunk_len, (uint32_t *)buffer);
+					break;
+				case 2:
+					target_buffer_get_u16_array(target, buffer, chunk_len, (uint16_t *)buffer);
+					break;
+			}
 			for (size_t i = 0; i < chunk_len ; i++, idx++) {
 				uint64_t v = 0;
 				switch (width) {
 					case 8:
-						v = target_buffer_get_u64(target, &buffer[i*width]);
+						v = ((uint64_t *)buffer)[i];
 						break;
 					case 4:
-						v = target_buffer_get_u32(target, &buffer[i*width]);
+						v = ((uint32_t *)buffer)[i];
 						break;
 					case 2:
-						v = target_buffer_get_u16(target, &buffer[i*width]);
+						v = ((uint16_t *)buffer)[i];
 						break;
 					case 1:
 						v = buffer[i] & 0x0ff;
@@ -4997,63 +5946,226 @@ static int target_jim_write_memory(Jim_Interp *interp, int argc,
 	const size_t buffersize = 4096;
 	uint8_t *buffer = malloc(buffersize);
 
-	if (!buffer) {
-		LOG_ERROR("Failed to allocate memory");
+	if (!buffer) {
+		LOG_ERROR("Failed to allocate memory");
+		return JIM_ERR;
+	}
+
+	size_t j = 0;
+
+	while (count > 0) {
+		const unsigned int max_chunk_len = buffersize / width;
+		const size_t chunk_len = MIN(count, max_chunk_len);
+
+		for (size_t i = 0; i < chunk_len; i++, j++) {
+			Jim_Obj *tmp = Jim_ListGetIndex(interp, argv[3], j);
+			jim_wide element_wide;
+			Jim_GetWide(interp, tmp, &element_wide);
+
+			const uint64_t v = element_wide;
+
+			switch (width) {
+			case 8:
+				target_buffer_set_u64(target, &buffer[i * width], v);
+				break;
+			case 4:
+				target_buffer_set_u32(target, &buffer[i * width], v);
+				break;
+			case 2:
+				target_buffer_set_u16(target, &buffer[i * width], v);
+				break;
+			case 1:
+				buffer[i] = v & 0x0ff;
+				break;
+			}
+		}
+
+		count -= chunk_len;
+
+		int retval;
+
+		if (is_phys)
+			retval = target_write_phys_memory(target, addr, width, chunk_len, buffer);
+		else
+			retval = target_write_memory(target, addr, width, chunk_len, buffer);
+
+		if (retval != ERROR_OK) {
+			LOG_ERROR("write_memory: write at " TARGET_ADDR_FMT " with width=%u and count=%zu failed",
+				addr,  width_bits, chunk_len);
+			Jim_SetResultString(interp, "write_memory: failed to write memory", -1);
+			e = JIM_ERR;
+			break;
+		}
+
+		addr += chunk_len * width;
+	}
+
+	free(buffer);
+
+	return e;
+}
+
+/* Largest transfer of read_memory_bin, the data is held in one Tcl object */
+#define TARGET_BINARY_TRANSFER_MAX	(64 * 1024 * 1024)
+#define TARGET_BINARY_CHUNK_SIZE	(64 * 1024)
+
+static int target_jim_binary_phys(Jim_Interp *interp, int argc,
+		Jim_Obj * const *argv, bool *is_phys)
+{
+	*is_phys = false;
+	if (argc < 4)
+		return JIM_OK;
+
+	const char *phys = Jim_GetString(argv[3], NULL);
+	if (strcmp(phys, "phys")) {
+		Jim_SetResultFormatted(interp, "invalid argument '%s', must be 'phys'", phys);
+		return JIM_ERR;
+	}
+
+	*is_phys = true;
+	return JIM_OK;
+}
+
+/*
+ * read_memory_bin and write_memory_bin move memory as Tcl byte strings, one
+ * object for the whole transfer instead of one per element. Over the Tcl
+ * server with length framing, the bytes go out as they are.
+ */
+static int target_jim_read_memory_bin(Jim_Interp *interp, int argc,
+		Jim_Obj * const *argv)
+{
+	/*
+	 * argv[1] = memory address
+	 * argv[2] = number of bytes to read
+	 * argv[3] = optional "phys"
+	 */
+
+	if (argc < 3 || argc > 4) {
+		Jim_WrongNumArgs(interp, 1, argv, "address count ['phys']");
+		return JIM_ERR;
+	}
+
+	jim_wide wide_addr, wide_count;
+	int e = Jim_GetWide(interp, argv[1], &wide_addr);
+	if (e != JIM_OK)
+		return e;
+	e = Jim_GetWide(interp, argv[2], &wide_count);
+	if (e != JIM_OK)
+		return e;
+
+	bool is_phys;
+	e = target_jim_binary_phys(interp, argc, argv, &is_phys);
+	if (e != JIM_OK)
+		return e;
+
+	target_addr_t addr = (target_addr_t)wide_addr;
+	if (wide_count < 0 || wide_count > TARGET_BINARY_TRANSFER_MAX) {
+		Jim_SetResultFormatted(interp, "read_memory_bin: count must be 0 to %d",
+				TARGET_BINARY_TRANSFER_MAX);
+		return JIM_ERR;
+	}
+	size_t count = wide_count;
+
+	if (addr + count < addr) {
+		Jim_SetResultString(interp, "read_memory_bin: addr + count wraps to zero", -1);
+		return JIM_ERR;
+	}
+
+	struct command_context *cmd_ctx = current_command_context(interp);
+	assert(cmd_ctx);
+	struct target *target = get_current_target(cmd_ctx);
+
+	uint8_t *buffer = malloc(count);
+	if (count && !buffer) {
+		LOG_ERROR("Failed to allocate memory");
+		return JIM_ERR;
+	}
+
+	for (size_t offset = 0; offset < count; offset += TARGET_BINARY_CHUNK_SIZE) {
+		uint32_t chunk = MIN(count - offset, TARGET_BINARY_CHUNK_SIZE);
+		uint8_t *data = buffer + offset;
+
+		int retval;
+		if (is_phys)
+			retval = target_read_phys_memory(target, addr + offset, 1, chunk, data);
+		else
+			retval = target_read_buffer(target, addr + offset, chunk, data);
+
+		if (retval != ERROR_OK) {
+			LOG_ERROR("read_memory_bin: read at " TARGET_ADDR_FMT " with count=%" PRIu32 " failed",
+					addr + offset, chunk);
+			Jim_SetResultString(interp, "read_memory_bin: failed to read memory", -1);
+			free(buffer);
+			return JIM_ERR;
+		}
+
+		keep_alive();
+	}
+
+	Jim_SetResult(interp, Jim_NewStringObj(interp, (const char *)buffer, count));
+	free(buffer);
+
+	return JIM_OK;
+}
+
+static int target_jim_write_memory_bin(Jim_Interp *interp, int argc,
+		Jim_Obj * const *argv)
+{
+	/*
+	 * argv[1] = memory address
+	 * argv[2] = byte string to write
+	 * argv[3] = optional "phys"
+	 */
+
+	if (argc < 3 || argc > 4) {
+		Jim_WrongNumArgs(interp, 1, argv, "address data ['phys']");
 		return JIM_ERR;
 	}
 
-	size_t j = 0;
+	jim_wide wide_addr;
+	int e = Jim_GetWide(interp, argv[1], &wide_addr);
+	if (e != JIM_OK)
+		return e;
 
-	while (count > 0) {
-		const unsigned int max_chunk_len = buffersize / width;
-		const size_t chunk_len = MIN(count, max_chunk_len);
+	bool is_phys;
+	e = target_jim_binary_phys(interp, argc, argv, &is_phys);
+	if (e != JIM_OK)
+		return e;
 
-		for (size_t i = 0; i < chunk_len; i++, j++) {
-			Jim_Obj *tmp = Jim_ListGetIndex(interp, argv[3], j);
-			jim_wide element_wide;
-			Jim_GetWide(interp, tmp, &element_wide);
+	target_addr_t addr = (target_addr_t)wide_addr;
+	int len;
+	const uint8_t *data = (const uint8_t *)Jim_GetString(argv[2], &len);
+	size_t count = len;
 
-			const uint64_t v = element_wide;
+	if (addr + count < addr) {
+		Jim_SetResultString(interp, "write_memory_bin: addr + len wraps to zero", -1);
+		return JIM_ERR;
+	}
 
-			switch (width) {
-			case 8:
-				target_buffer_set_u64(target, &buffer[i * width], v);
-				break;
-			case 4:
-				target_buffer_set_u32(target, &buffer[i * width], v);
-				break;
-			case 2:
-				target_buffer_set_u16(target, &buffer[i * width], v);
-				break;
-			case 1:
-				buffer[i] = v & 0x0ff;
-				break;
-			}
-		}
+	struct command_context *cmd_ctx = current_command_context(interp);
+	assert(cmd_ctx);
+	struct target *target = get_current_target(cmd_ctx);
 
-		count -= chunk_len;
+	for (size_t offset = 0; offset < count; offset += TARGET_BINARY_CHUNK_SIZE) {
+		uint32_t chunk = MIN(count - offset, TARGET_BINARY_CHUNK_SIZE);
 
 		int retval;
-
 		if (is_phys)
-			retval = target_write_phys_memory(target, addr, width, chunk_len, buffer);
+			retval = target_write_phys_memory(target, addr + offset, 1, chunk, data + offset);
 		else
-			retval = target_write_memory(target, addr, width, chunk_len, buffer);
+			retval = target_write_buffer(target, addr + offset, chunk, data + offset);
 
 		if (retval != ERROR_OK) {
-			LOG_ERROR("write_memory: write at " TARGET_ADDR_FMT " with width=%u and count=%zu failed",
-				addr,  width_bits, chunk_len);
-			Jim_SetResultString(interp, "write_memory: failed to write memory", -1);
-			e = JIM_ERR;
-			break;
+			LOG_ERROR("write_memory_bin: write at " TARGET_ADDR_FMT " with count=%" PRIu32 " failed",
+					addr + offset, chunk);
+			Jim_SetResultString(interp, "write_memory_bin: failed to write memory", -1);
+			return JIM_ERR;
 		}
 
-		addr += chunk_len * width;
+		keep_alive();
 	}
 
-	free(buffer);
-
-	return e;
+	return JIM_OK;
 }
 
 /* FIX? should we propagate errors here rather than printing them
@@ -5137,7 +6249,7 @@ static int target_jim_get_reg(Jim_Interp *interp, int argc,
 
 	struct command_context *cmd_ctx = current_command_context(interp);
 	assert(cmd_ctx != NULL);
-	const struct target *target = get_current_target(cmd_ctx);
+	struct target *target = get_current_target(cmd_ctx);
 
 	for (int i = 0; i < length; i++) {
 		Jim_Obj *elem = Jim_ListGetIndex(interp, argv[1], i);
@@ -5147,8 +6259,7 @@ static int target_jim_get_reg(Jim_Interp *interp, int argc,
 
 		const char *reg_name = Jim_String(elem);
 
-		struct reg *reg = register_get_by_name(target->reg_cache, reg_name,
-			false);
+		struct reg *reg = target_reg_get_by_name(target, reg_name, false);
 
 		if (!reg || !reg->exist) {
 			Jim_SetResultFormatted(interp, "unknown register '%s'", reg_name);
@@ -5217,13 +6328,12 @@ static int target_jim_set_reg(Jim_Interp *interp, int argc,
 	const unsigned int length = tmp;
 	struct command_context *cmd_ctx = current_command_context(interp);
 	assert(cmd_ctx);
-	const struct target *target = get_current_target(cmd_ctx);
+	struct target *target = get_current_target(cmd_ctx);
 
 	for (unsigned int i = 0; i < length; i += 2) {
 		const char *reg_name = Jim_String(dict[i]);
 		const char *reg_value = Jim_String(dict[i + 1]);
-		struct reg *reg = register_get_by_name(target->reg_cache, reg_name,
-			false);
+		struct reg *reg = target_reg_get_by_name(target, reg_name, false);
 
 		if (!reg || !reg->exist) {
 			Jim_SetResultFormatted(interp, "unknown register '%s'", reg_name);
@@ -5280,6 +6390,8 @@ enum target_cfg_param {
 	TCFG_DEFER_EXAMINE,
 	TCFG_GDB_PORT,
 	TCFG_GDB_MAX_CONNECTIONS,
+	TCFG_POLL_INTERVAL,
+	TCFG_POLL_INTERVAL_MAX,
 };
 
 static struct jim_nvp nvp_config_opts[] = {
@@ -5297,6 +6409,8 @@ static struct jim_nvp nvp_config_opts[] = {
 	{ .name = "-defer-examine",    .value = TCFG_DEFER_EXAMINE },
 	{ .name = "-gdb-port",         .value = TCFG_GDB_PORT },
 	{ .name = "-gdb-max-connections",   .value = TCFG_GDB_MAX_CONNECTIONS },
+	{ .name = "-poll-interval",    .value = TCFG_POLL_INTERVAL },
+	{ .name = "-poll-interval-max", .value = TCFG_POLL_INTERVAL_MAX },
 	{ .name = NULL, .value = -1 }
 };
 
@@ -5629,6 +6743,43 @@ no_params:
 			}
 			Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->gdb_max_connections));
 			break;
+
+		case TCFG_POLL_INTERVAL:
+			if (goi->isconfigure) {
+				e = jim_getopt_wide(goi, &w);
+				if (e != JIM_OK)
+					return e;
+				if (w < 1 || w > 60000) {
+					Jim_SetResultString(goi->interp, "-poll-interval must be 1 to 60000 ms", -1);
+					return JIM_ERR;
+				}
+				target->poll.interval_ms = w;
+				target_poll_soon(target);
+				if (target_poll_update_tick() != ERROR_OK)
+					return JIM_ERR;
+			} else {
+				if (goi->argc != 0)
+					goto no_params;
+			}
+			Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->poll.interval_ms));
+			break;
+
+		case TCFG_POLL_INTERVAL_MAX:
+			if (goi->isconfigure) {
+				e = jim_getopt_wide(goi, &w);
+				if (e != JIM_OK)
+					return e;
+				if (w < 0 || w > 60000) {
+					Jim_SetResultString(goi->interp, "-poll-interval-max must be 0 to 60000 ms", -1);
+					return JIM_ERR;
+				}
+				target->poll.interval_max_ms = w;
+			} else {
+				if (goi->argc != 0)
+					goto no_params;
+			}
+			Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->poll.interval_max_ms));
+			break;
 		}
 	} /* while (goi->argc) */
 
@@ -5824,6 +6975,8 @@ static int jim_target_reset(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
 	/* When this happens - all workareas are invalid. */
 	target_free_all_working_areas_restore(target, 0);
 
+	target_memcache_invalidate_all();
+
 	/* do the assert */
 	if (n->value == NVP_ASSERT)
 		e = target->type->assert_reset(target);
@@ -5911,6 +7064,25 @@ COMMAND_HANDLER(handle_target_event_list)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_target_poll_stats)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	const struct target_poll *poll = &target->poll;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD, "poll interval %u ms, backoff up to %u ms, currently %u ms",
+			poll->interval_ms, MAX(poll->interval_max_ms, poll->interval_ms),
+			poll->current_ms);
+	command_print(CMD, "%" PRIu64 " polls, %" PRIu64 " failed, %" PRId64 " ms total, "
+			"%" PRId64 " us average, %" PRId64 " us max",
+			poll->polls, poll->failures, poll->total_us / 1000,
+			poll->polls ? poll->total_us / (int64_t)poll->polls : 0, poll->max_us);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_target_current_state)
 {
 	if (CMD_ARGC != 0)
@@ -6060,6 +7232,20 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.help = "Write Tcl list of 8/16/32/64 bit numbers to target memory",
 		.usage = "address width data ['phys']",
 	},
+	{
+		.name = "read_memory_bin",
+		.mode = COMMAND_EXEC,
+		.jim_handler = target_jim_read_memory_bin,
+		.help = "Read target memory into a Tcl byte string",
+		.usage = "address count ['phys']",
+	},
+	{
+		.name = "write_memory_bin",
+		.mode = COMMAND_EXEC,
+		.jim_handler = target_jim_write_memory_bin,
+		.help = "Write a Tcl byte string to target memory",
+		.usage = "address data ['phys']",
+	},
 	{
 		.name = "eventlist",
 		.handler = handle_target_event_list,
@@ -6074,6 +7260,13 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.help = "displays the current state of this target",
 		.usage = "",
 	},
+	{
+		.name = "poll_stats",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_poll_stats,
+		.help = "displays the polling interval and cost of this target",
+		.usage = "",
+	},
 	{
 		.name = "arp_examine",
 		.mode = COMMAND_EXEC,
@@ -6133,6 +7326,12 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.help = "invoke handler for specified event",
 		.usage = "event_name",
 	},
+	{
+		.chain = target_memcache_command_handlers,
+	},
+	{
+		.chain = rtos_target_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -6256,6 +7455,7 @@ static int target_create(struct jim_getopt_info *goi)
 
 	target->dbgmsg          = NULL;
 	target->dbg_msg_enabled = 0;
+	target->dbgmsg_sink     = NULL;
 
 	target->endianness = TARGET_ENDIAN_UNKNOWN;
 
@@ -6265,6 +7465,10 @@ static int target_create(struct jim_getopt_info *goi)
 	target->gdb_port_override = NULL;
 	target->gdb_max_connections = 1;
 
+	target->poll.interval_ms = polling_interval;
+	target->poll.interval_max_ms = 0;
+	target_poll_soon(target);
+
 	/* Do the rest as "configure" options */
 	goi->isconfigure = 1;
 	e = target_configure(goi, target);
@@ -6448,6 +7652,60 @@ static int get_target_with_common_rtos_type(struct command_invocation *cmd,
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_target_wait_state)
+{
+	if (CMD_ARGC < 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	const struct jim_nvp *n = jim_nvp_name2value_simple(nvp_target_state, CMD_ARGV[0]);
+	if (!n->name) {
+		command_print(CMD, "unknown target state '%s'", CMD_ARGV[0]);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	int ms;
+	COMMAND_PARSE_NUMBER(int, CMD_ARGV[1], ms);
+
+	unsigned int num_targets = CMD_ARGC - 2;
+	struct target **targets = malloc(num_targets * sizeof(*targets));
+	int *status = malloc(num_targets * sizeof(*status));
+	if (!targets || !status) {
+		LOG_ERROR("Out of memory");
+		free(targets);
+		free(status);
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	for (unsigned int i = 0; i < num_targets; i++) {
+		targets[i] = get_target(CMD_ARGV[i + 2]);
+		if (!targets[i]) {
+			command_print(CMD, "unknown target '%s'", CMD_ARGV[i + 2]);
+			retval = ERROR_COMMAND_ARGUMENT_INVALID;
+			break;
+		}
+		if (!targets[i]->tap->enabled) {
+			command_print(CMD, "target '%s' is on a disabled TAP", CMD_ARGV[i + 2]);
+			retval = ERROR_FAIL;
+			break;
+		}
+	}
+
+	if (retval == ERROR_OK) {
+		retval = target_wait_state_all(targets, num_targets, n->value, ms, status);
+		for (unsigned int i = 0; i < num_targets; i++) {
+			if (status[i] != ERROR_OK)
+				command_print(CMD, "target: %s wait %s fails (%d) %s",
+						target_name(targets[i]), n->name,
+						status[i], target_strerror_safe(status[i]));
+		}
+	}
+
+	free(targets);
+	free(status);
+	return retval;
+}
+
 COMMAND_HANDLER(handle_target_smp)
 {
 	static int smp_group = 1;
@@ -6503,6 +7761,27 @@ static int jim_target_create(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
 	return target_create(&goi);
 }
 
+COMMAND_HANDLER(handle_target_timers)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int64_t now = timeval_ms();
+
+	command_print(CMD, "period  type      due in   calls  overruns  max late  max run");
+	for (unsigned int i = 0; i < target_timer_heap_len; i++) {
+		const struct target_timer_callback *cb = target_timer_heap[i];
+		command_print(CMD, "%6u  %-8s %7" PRId64 " %7" PRIu64 " %9" PRIu64
+				" %9" PRId64 " %8" PRId64,
+				cb->time_ms,
+				cb->type == TARGET_TIMER_TYPE_PERIODIC ? "periodic" : "oneshot",
+				cb->when - now, cb->calls, cb->overruns,
+				cb->max_late_ms, cb->max_run_ms);
+	}
+
+	return ERROR_OK;
+}
+
 static const struct command_registration target_subcommand_handlers[] = {
 	{
 		.name = "init",
@@ -6547,6 +7826,21 @@ static const struct command_registration target_subcommand_handlers[] = {
 		.usage = "targetname1 targetname2 ...",
 		.help = "gather several target in a smp list"
 	},
+	{
+		.name = "timers",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_timers,
+		.help = "display the timer callbacks and their statistics",
+		.usage = "",
+	},
+	{
+		.name = "wait_state",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_wait_state,
+		.help = "wait until all listed targets reach a state, "
+			"sharing one timeout",
+		.usage = "state_name timeout_in_msec target_name...",
+	},
 
 	COMMAND_REGISTRATION_DONE
 };
@@ -6555,24 +7849,101 @@ struct fast_load {
 	target_addr_t address;
 	uint8_t *data;
 	int length;
+	/* the checksum of the data, as verify_image computes it */
+	uint32_t crc;
+};
+
+/* the data of a slot fast_load last wrote to a target */
+struct fast_load_written {
+	struct target *target;
+	target_addr_t address;
+	int length;
+	uint32_t crc;
+};
 
+/* an image kept by fast_load_image */
+struct fast_load_slot {
+	char *name;
+	int num;
+	struct fast_load *runs;
+	/* kept when the image is replaced, to write only what changed */
+	int num_written;
+	struct fast_load_written *written;
+	struct fast_load_slot *next;
 };
 
-static int fastload_num;
-static struct fast_load *fastload;
+#define FAST_LOAD_DEFAULT_SLOT	"default"
+
+static struct fast_load_slot *fast_load_slots;
 
-static void free_fastload(void)
+static void free_fastload(struct fast_load *fastload, int num)
 {
 	if (fastload) {
-		for (int i = 0; i < fastload_num; i++)
+		for (int i = 0; i < num; i++)
 			free(fastload[i].data);
 		free(fastload);
-		fastload = NULL;
 	}
 }
 
+static struct fast_load_slot *fast_load_find_slot(const char *name)
+{
+	for (struct fast_load_slot *slot = fast_load_slots; slot; slot = slot->next)
+		if (!strcmp(slot->name, name))
+			return slot;
+
+	return NULL;
+}
+
+/* @returns true if the run, written by fast_load to the target earlier, is still there */
+static bool fast_load_unchanged(struct fast_load_slot *slot, struct target *target,
+	const struct fast_load *run)
+{
+	for (int i = 0; i < slot->num_written; i++) {
+		struct fast_load_written *w = &slot->written[i];
+		if (w->target != target || w->address != run->address || w->length != run->length)
+			continue;
+		if (w->crc != run->crc)
+			return false;
+
+		/* the target may have changed it since */
+		uint32_t checksum;
+		if (target_checksum_memory(target, run->address, run->length, &checksum) != ERROR_OK)
+			return false;
+		return checksum == run->crc;
+	}
+
+	return false;
+}
+
+static void fast_load_record(struct fast_load_slot *slot, struct target *target,
+	const struct fast_load *run)
+{
+	struct fast_load_written *w = NULL;
+
+	for (int i = 0; i < slot->num_written; i++)
+		if (slot->written[i].target == target && slot->written[i].address == run->address)
+			w = &slot->written[i];
+
+	if (!w) {
+		struct fast_load_written *written = realloc(slot->written,
+				(slot->num_written + 1) * sizeof(*written));
+		if (!written)
+			return;
+		slot->written = written;
+		w = &slot->written[slot->num_written++];
+	}
+
+	*w = (struct fast_load_written) {
+		.target = target,
+		.address = run->address,
+		.length = run->length,
+		.crc = run->crc,
+	};
+}
+
 COMMAND_HANDLER(handle_fast_load_image_command)
 {
+	const uint8_t *data;
 	uint8_t *buffer;
 	size_t buf_cnt;
 	uint32_t image_size;
@@ -6580,6 +7951,13 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 	target_addr_t max_address = -1;
 
 	struct image image;
+	const char *name = FAST_LOAD_DEFAULT_SLOT;
+
+	if (CMD_ARGC >= 2 && !strcmp(CMD_ARGV[0], "-slot")) {
+		name = CMD_ARGV[1];
+		CMD_ARGC -= 2;
+		CMD_ARGV += 2;
+	}
 
 	int retval = CALL_COMMAND_HANDLER(parse_load_image_command,
 			&image, &min_address, &max_address);
@@ -6593,48 +7971,48 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* the sections next to each other loaded at once */
+	struct image_plan plan;
+	retval = image_plan_runs(&image, image_merge_gap, image_merge_padding, &plan);
+	if (retval != ERROR_OK) {
+		image_close(&image);
+		return retval;
+	}
+
 	image_size = 0x0;
-	retval = ERROR_OK;
-	fastload_num = image.num_sections;
-	fastload = malloc(sizeof(struct fast_load)*image.num_sections);
-	if (!fastload) {
+	int fastload_num = plan.num_runs;
+	struct fast_load *fastload = calloc(plan.num_runs, sizeof(struct fast_load));
+	if (!fastload && plan.num_runs) {
 		command_print(CMD, "out of memory");
+		image_plan_free(&plan);
 		image_close(&image);
 		return ERROR_FAIL;
 	}
-	memset(fastload, 0, sizeof(struct fast_load)*image.num_sections);
-	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD, "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
-			break;
-		}
+	for (unsigned int i = 0; i < plan.num_runs; i++) {
+		struct image_run *run = &plan.runs[i];
 
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+		retval = image_get_run(&image, &plan, i, &data, &buffer);
+		if (retval != ERROR_OK)
 			break;
-		}
+		buf_cnt = run->size;
 
 		uint32_t offset = 0;
 		uint32_t length = buf_cnt;
 
 		/* DANGER!!! beware of unsigned comparison here!!! */
 
-		if ((image.sections[i].base_address + buf_cnt >= min_address) &&
-				(image.sections[i].base_address < max_address)) {
-			if (image.sections[i].base_address < min_address) {
+		if (run->base_address + buf_cnt >= min_address &&
+				run->base_address < max_address) {
+			if (run->base_address < min_address) {
 				/* clip addresses below */
-				offset += min_address-image.sections[i].base_address;
+				offset += min_address - run->base_address;
 				length -= offset;
 			}
 
-			if (image.sections[i].base_address + buf_cnt > max_address)
-				length -= (image.sections[i].base_address + buf_cnt)-max_address;
+			if (run->base_address + buf_cnt > max_address)
+				length -= (run->base_address + buf_cnt) - max_address;
 
-			fastload[i].address = image.sections[i].base_address + offset;
+			fastload[i].address = run->base_address + offset;
 			fastload[i].data = malloc(length);
 			if (!fastload[i].data) {
 				free(buffer);
@@ -6643,13 +8021,14 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 				retval = ERROR_FAIL;
 				break;
 			}
-			memcpy(fastload[i].data, buffer + offset, length);
+			memcpy(fastload[i].data, data + offset, length);
 			fastload[i].length = length;
+			image_calculate_checksum(data + offset, length, &fastload[i].crc);
 
 			image_size += length;
 			command_print(CMD, "%u bytes written at address 0x%8.8x",
 						  (unsigned int)length,
-						  ((unsigned int)(image.sections[i].base_address + offset)));
+						  ((unsigned int)(run->base_address + offset)));
 		}
 
 		free(buffer);
@@ -6665,40 +8044,102 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 				"You can issue a 'fast_load' to finish loading.");
 	}
 
+	image_plan_free(&plan);
 	image_close(&image);
 
-	if (retval != ERROR_OK)
-		free_fastload();
+	if (retval != ERROR_OK) {
+		free_fastload(fastload, fastload_num);
+		return retval;
+	}
 
-	return retval;
+	struct fast_load_slot *slot = fast_load_find_slot(name);
+	if (!slot) {
+		slot = calloc(1, sizeof(*slot));
+		if (slot)
+			slot->name = strdup(name);
+		if (!slot || !slot->name) {
+			free(slot);
+			free_fastload(fastload, fastload_num);
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+
+		struct fast_load_slot **p = &fast_load_slots;
+		while (*p)
+			p = &(*p)->next;
+		*p = slot;
+	}
+
+	free_fastload(slot->runs, slot->num);
+	slot->runs = fastload;
+	slot->num = fastload_num;
+
+	return ERROR_OK;
 }
 
 COMMAND_HANDLER(handle_fast_load_command)
 {
-	if (CMD_ARGC > 0)
-		return ERROR_COMMAND_SYNTAX_ERROR;
-	if (!fastload) {
+	bool changed = false;
+
+	if (CMD_ARGC >= 1 && !strcmp(CMD_ARGV[0], "-changed")) {
+		changed = true;
+		CMD_ARGC--;
+		CMD_ARGV++;
+	}
+
+	if (!fast_load_slots) {
 		LOG_ERROR("No image in memory");
 		return ERROR_FAIL;
 	}
-	int i;
+
+	for (unsigned int i = 0; i < CMD_ARGC; i++) {
+		if (!fast_load_find_slot(CMD_ARGV[i])) {
+			command_print(CMD, "no fast load image '%s'", CMD_ARGV[i]);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	struct target *target = get_current_target(CMD_CTX);
 	int64_t ms = timeval_ms();
 	int size = 0;
+	int skipped = 0;
 	int retval = ERROR_OK;
-	for (i = 0; i < fastload_num; i++) {
-		struct target *target = get_current_target(CMD_CTX);
-		command_print(CMD, "Write to 0x%08x, length 0x%08x",
-					  (unsigned int)(fastload[i].address),
-					  (unsigned int)(fastload[i].length));
-		retval = target_write_buffer(target, fastload[i].address, fastload[i].length, fastload[i].data);
-		if (retval != ERROR_OK)
-			break;
-		size += fastload[i].length;
-	}
-	if (retval == ERROR_OK) {
-		int64_t after = timeval_ms();
-		command_print(CMD, "Loaded image %f kBytes/s", (float)(size/1024.0)/((float)(after-ms)/1000.0));
+	for (struct fast_load_slot *slot = fast_load_slots; slot; slot = slot->next) {
+		bool selected = !CMD_ARGC;
+		for (unsigned int i = 0; i < CMD_ARGC; i++)
+			if (!strcmp(CMD_ARGV[i], slot->name))
+				selected = true;
+		if (!selected)
+			continue;
+
+		for (int i = 0; i < slot->num; i++) {
+			struct fast_load *fastload = &slot->runs[i];
+
+			if (!fastload->length)
+				continue;
+			if (changed && fast_load_unchanged(slot, target, fastload)) {
+				skipped += fastload->length;
+				continue;
+			}
+
+			command_print(CMD, "Write to 0x%08x, length 0x%08x",
+						  (unsigned int)(fastload->address),
+						  (unsigned int)(fastload->length));
+			retval = target_write_buffer(target, fastload->address, fastload->length,
+					fastload->data);
+			if (retval != ERROR_OK)
+				return retval;
+			size += fastload->length;
+			fast_load_record(slot, target, fastload);
+		}
 	}
+
+	int64_t after = timeval_ms();
+	command_print(CMD, "Loaded image %f kBytes/s",
+			(float)(size / 1024.0) / ((float)(after - ms) / 1000.0));
+	if (skipped)
+		command_print(CMD, "%d bytes unchanged on the target, not written", skipped);
+
 	return retval;
 }
 
@@ -6718,6 +8159,9 @@ static const struct command_registration target_command_handlers[] = {
 		.chain = target_subcommand_handlers,
 		.usage = "",
 	},
+	{
+		.chain = image_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -6957,17 +8401,18 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.handler = handle_fast_load_image_command,
 		.mode = COMMAND_ANY,
 		.help = "Load image into server memory for later use by "
-			"fast_load; primarily for profiling",
-		.usage = "filename address ['bin'|'ihex'|'elf'|'s19'] "
+			"fast_load, in the default slot or a named one",
+		.usage = "['-slot' name] filename address ['bin'|'ihex'|'elf'|'s19'] "
 			"[min_address [max_length]]",
 	},
 	{
 		.name = "fast_load",
 		.handler = handle_fast_load_command,
 		.mode = COMMAND_EXEC,
-		.help = "loads active fast load image to current target "
-			"- mainly for profiling purposes",
-		.usage = "",
+		.help = "loads the images of all the fast load slots, or of "
+			"those named, to current target, optionally only the "
+			"parts not already there",
+		.usage = "['-changed'] [slot ...]",
 	},
 	{
 		.name = "profile",
@@ -7107,12 +8552,19 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.help = "list or set hardware or software breakpoint",
 		.usage = "[<address> [<asid>] <length> ['hw'|'hw_ctx']]",
 	},
+	{
+		.name = "bp_batch",
+		.handler = handle_bp_batch_command,
+		.mode = COMMAND_EXEC,
+		.help = "set software breakpoints at many addresses at once",
+		.usage = "length address...",
+	},
 	{
 		.name = "rbp",
 		.handler = handle_rbp_command,
 		.mode = COMMAND_EXEC,
 		.help = "remove breakpoint",
-		.usage = "'all' | address",
+		.usage = "'all' | address...",
 	},
 	{
 		.name = "wp",
@@ -7135,6 +8587,15 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.usage = "filename address ['bin'|'ihex'|'elf'|'s19'] "
 			"[min_address] [max_length]",
 	},
+	{
+		.name = "image_merge_gap",
+		.handler = handle_image_merge_gap_command,
+		.mode = COMMAND_ANY,
+		.help = "set the largest gap between image sections which "
+			"load_image and fast_load_image fill with padding to "
+			"write them at once",
+		.usage = "[gap_bytes [padding]]",
+	},
 	{
 		.name = "dump_image",
 		.handler = handle_dump_image_command,
@@ -7187,6 +8648,20 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.help = "Write Tcl list of 8/16/32/64 bit numbers to target memory",
 		.usage = "address width data ['phys']",
 	},
+	{
+		.name = "read_memory_bin",
+		.mode = COMMAND_EXEC,
+		.jim_handler = target_jim_read_memory_bin,
+		.help = "Read target memory into a Tcl byte string",
+		.usage = "address count ['phys']",
+	},
+	{
+		.name = "write_memory_bin",
+		.mode = COMMAND_EXEC,
+		.jim_handler = target_jim_write_memory_bin,
+		.help = "Write a Tcl byte string to target memory",
+		.usage = "address data ['phys']",
+	},
 	{
 		.name = "reset_nag",
 		.handler = handle_target_reset_nag,
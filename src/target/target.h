@@ -21,6 +21,7 @@
 #define OPENOCD_TARGET_TARGET_H
 
 #include <helper/list.h>
+#include <helper/metrics.h>
 #include "helper/replacements.h"
 #include "helper/system.h"
 #include <jim.h>
@@ -35,6 +36,7 @@ struct mem_param;
 struct reg_param;
 struct target_list;
 struct gdb_fileio_info;
+struct target_request_sink;
 
 /*
  * TARGET_UNKNOWN = 0: we don't know anything about the target yet
@@ -93,6 +95,15 @@ struct working_area {
 	uint8_t *backup;
 	struct working_area **user;
 	struct working_area *next;
+	/* tag of a resident area, which keeps its content after being freed */
+	const void *resident;
+	/* resident area freed by its user, kept until reused or evicted */
+	bool parked;
+	/* memory of a resident area written since it was parked */
+	bool written;
+	/* size and CRC32 of the loader code uploaded at its start, if any */
+	uint32_t code_size;
+	uint32_t code_crc;
 };
 
 struct gdb_service {
@@ -110,6 +121,26 @@ struct backoff_timer {
 	int count;
 };
 
+/* adaptive polling of a target */
+struct target_poll {
+	/* interval while halted and right after a resume */
+	unsigned int interval_ms;
+	/* limit of the exponential backoff while the target keeps running */
+	unsigned int interval_max_ms;
+	unsigned int current_ms;
+	/* output of timeval_ms() */
+	int64_t next;
+
+	/* cost counters */
+	uint64_t polls;
+	uint64_t failures;
+	int64_t total_us;
+	int64_t max_us;
+};
+
+/* number of buckets of the per-target breakpoint address index */
+#define TARGET_BREAKPOINT_HASH_SIZE		64
+
 /* split target registers into multiple class */
 enum target_register_class {
 	REG_CLASS_ALL,
@@ -162,10 +193,13 @@ struct target {
 	enum target_state state;			/* the current backend-state (running, halted, ...) */
 	struct reg_cache *reg_cache;		/* the first register cache of the target (core regs) */
 	struct breakpoint *breakpoints;		/* list of breakpoints */
+	/* the breakpoints indexed by address, see breakpoints.c */
+	struct breakpoint *breakpoint_hash[TARGET_BREAKPOINT_HASH_SIZE];
 	struct watchpoint *watchpoints;		/* list of watchpoints */
 	struct trace *trace_info;			/* generic trace information */
 	struct debug_msg_receiver *dbgmsg;	/* list of debug message receivers */
 	uint32_t dbg_msg_enabled;			/* debug message status */
+	struct target_request_sink *dbgmsg_sink;	/* TCP sink of binary debug messages */
 	void *arch_info;					/* architecture specific information */
 	void *private_config;				/* pointer to target specific config data (for jim_configure hook) */
 	struct target *next;				/* next target in list */
@@ -174,6 +208,7 @@ struct target {
 										 * lots of halted/resumed info when stepping in debugger. */
 	bool halt_issued;					/* did we transition to halted state? */
 	int64_t halt_issued_time;			/* Note time when halt was issued */
+	struct metric poll_metric;			/* time of target_poll(), in microseconds */
 
 										/* ARM v7/v8 targets with ADIv5 interface */
 	bool dbgbase_set;					/* By default the debug base is not set */
@@ -189,6 +224,7 @@ struct target {
 	bool rtos_auto_detect;				/* A flag that indicates that the RTOS has been specified as "auto"
 										 * and must be detected when symbols are offered */
 	struct backoff_timer backoff;
+	struct target_poll poll;
 	int smp;							/* Unique non-zero number for each SMP group */
 	struct list_head *smp_targets;		/* list all targets in this smp group/cluster
 										 * The head of the list is shared between the
@@ -196,6 +232,8 @@ struct target {
 	bool smp_halt_event_postponed;		/* Some SMP implementations (currently Cortex-M) stores
 										 * 'halted' events and emits them after all targets of
 										 * the SMP group has been polled */
+	bool smp_non_stop;					/* The cores of the SMP group halt, resume and step
+										 * individually, see smp_core_enter() */
 
 	/* the gdb service is there in case of smp, we have only one gdb server
 	 * for all smp target
@@ -212,6 +250,12 @@ struct target {
 
 	/* The semihosting information, extracted from the target. */
 	struct semihosting *semihosting;
+
+	/* Read cache of memory while halted, see target_memcache.c */
+	struct target_memcache *memcache;
+
+	/* hash index of the register names, see target_reg_get_by_name() */
+	struct reg_name_index *reg_name_index;
 };
 
 struct target_list {
@@ -339,7 +383,17 @@ struct target_timer_callback {
 	bool removed;
 	int64_t when;	/* output of timeval_ms() */
 	void *priv;
-	struct target_timer_callback *next;
+	/* position in the deadline heap, keeps removal O(log n) */
+	unsigned int heap_index;
+	/* registration order, breaks ties between equal deadlines */
+	uint64_t seq;
+
+	/* statistics */
+	uint64_t calls;
+	/* periodic calls which came one full period or more too late */
+	uint64_t overruns;
+	int64_t max_late_ms;
+	int64_t max_run_ms;
 };
 
 struct target_memory_check_block {
@@ -411,6 +465,12 @@ int target_call_timer_callbacks(void);
  * a synchronous command completes.
  */
 int target_call_timer_callbacks_now(void);
+
+/**
+ * Poll @a target at its fastest interval again from the next polling
+ * round on, e.g. after a resume or a halt request.
+ */
+void target_poll_soon(struct target *target);
 /**
  * Returns when the next registered event will take place. Callers can use this
  * to go to sleep until that time occurs.
@@ -480,6 +540,23 @@ int target_add_hybrid_breakpoint(struct target *target,
 
 int target_remove_breakpoint(struct target *target,
 		struct breakpoint *breakpoint);
+/**
+ * Add the @a num_breakpoints software breakpoints of @a breakpoint_list at
+ * once. Either all of them are set or none.
+ *
+ * This routine is a wrapper for target->type->add_breakpoints, falling
+ * back to target->type->add_breakpoint for each breakpoint.
+ */
+int target_add_breakpoints(struct target *target,
+		struct breakpoint **breakpoint_list, unsigned int num_breakpoints);
+/**
+ * Remove the @a num_breakpoints breakpoints of @a breakpoint_list at once.
+ *
+ * This routine is a wrapper for target->type->remove_breakpoints, falling
+ * back to target->type->remove_breakpoint for each breakpoint.
+ */
+int target_remove_breakpoints(struct target *target,
+		struct breakpoint **breakpoint_list, unsigned int num_breakpoints);
 /**
  * Add the @a watchpoint for @a target.
  *
@@ -515,10 +592,34 @@ const char *target_get_gdb_arch(struct target *target);
  *
  * This routine is a wrapper for target->type->get_gdb_reg_list.
  */
+/**
+ * Look up a register of @a target by name, searching the first register
+ * cache only or all caches of the target. Faster than
+ * register_get_by_name() on targets with many registers.
+ */
+struct reg *target_reg_get_by_name(struct target *target, const char *name,
+		bool search_all);
+
 int target_get_gdb_reg_list(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class);
 
+/**
+ * Make the registers of @a reg_list valid, in one batch where the target
+ * supports it, else one register after the other. NULL, nonexistent and
+ * already valid entries are skipped.
+ */
+int target_read_registers(struct target *target, struct reg **reg_list,
+		unsigned int num_regs);
+
+/**
+ * Write the cached values of the dirty registers of @a reg_list to the
+ * target in one batch. Targets without batched writes keep the registers
+ * dirty; they are written on resume as usual.
+ */
+int target_write_registers(struct target *target, struct reg **reg_list,
+		unsigned int num_regs);
+
 /**
  * Obtain the registers for GDB, but don't read register values from the
  * target.
@@ -666,6 +767,15 @@ int target_blank_check_memory(struct target *target,
 		struct target_memory_check_block *blocks, int num_blocks,
 		uint8_t erased_value);
 int target_wait_state(struct target *target, enum target_state state, int ms);
+/**
+ * Wait until all @a num_targets @a targets reach @a state, polling them in
+ * turns, so that waiting for several targets takes no longer than @a ms
+ * in total. @a status receives the result of each target, i.e. ERROR_OK,
+ * the error of its poll or ERROR_TARGET_TIMEOUT.
+ * @returns the first failing status or ERROR_OK.
+ */
+int target_wait_state_all(struct target **targets, unsigned int num_targets,
+		enum target_state state, int ms, int *status);
 
 /**
  * Obtain file-I/O information from target for GDB to do syscall.
@@ -730,6 +840,31 @@ int target_alloc_working_area(struct target *target,
  */
 int target_alloc_working_area_try(struct target *target,
 		uint32_t size, struct working_area **area);
+/**
+ * Allocate a resident working area, identified by @a tag, typically the
+ * address of the loader code to be placed in it.
+ *
+ * Freeing a resident area with target_free_working_area() does not return
+ * it to the pool: it stays allocated with its content, and the next
+ * allocation with the same tag and size gets it back with @a loaded set,
+ * so the caller can skip writing the loader again. Resident areas are
+ * released on resume, reset, or when other allocations need the space;
+ * with backup enabled their memory is saved and restored only once.
+ * As with target_alloc_working_area_try(), no error is logged.
+ *
+ * @param loaded Set to true if the area still holds what was last written,
+ * i.e. no write to the target overlapped it since it was freed.
+ */
+int target_alloc_resident_working_area(struct target *target, const void *tag,
+		uint32_t size, struct working_area **area, bool *loaded);
+/**
+ * Allocate a resident working area of @a size bytes and upload @a code at
+ * its start, unless an area of that size already holds the same code.
+ * Areas are looked up by the size and CRC32 of the code, which must be
+ * in target byte order.
+ */
+int target_alloc_loader_working_area(struct target *target, const uint8_t *code,
+		uint32_t code_size, uint32_t size, struct working_area **area);
 /**
  * Free a working area.
  * Restore target data if area backup is configured.
@@ -790,6 +925,15 @@ void target_handle_md_output(struct command_invocation *cmd,
 int target_profiling_default(struct target *target, uint32_t *samples, uint32_t
 		max_num_samples, uint32_t *num_samples, uint32_t seconds);
 
+/**
+ * Write a gmon.out histogram of the PC samples, @a counts[i] samples of
+ * @a samples[i], or one of each if @a counts is NULL. Needs at least one
+ * sample without a range.
+ */
+int target_write_gmon(struct target *target, const uint32_t *samples, const uint32_t *counts,
+		uint32_t sample_num, const char *filename, bool with_range,
+		uint32_t start_address, uint32_t end_address, uint32_t duration_ms);
+
 #define ERROR_TARGET_INVALID	(-300)
 #define ERROR_TARGET_INIT_FAILED (-301)
 #define ERROR_TARGET_TIMEOUT	(-302)
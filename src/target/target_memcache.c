@@ -0,0 +1,426 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Read cache of target memory, valid while the target is halted.
+ *
+ * GDB, the RTOS awareness and scripts read the same stack and thread
+ * control block regions over and over between two resumes. With the cache
+ * enabled, such reads are served from whole pages fetched on the first
+ * access. Every resume, step, reset, algorithm run, memory write and
+ * target event drops the cached pages of all targets.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/align.h>
+#include <helper/log.h>
+
+#include "target.h"
+#include "target_type.h"
+#include "target_memcache.h"
+
+#define MEMCACHE_DEFAULT_PAGE_SIZE	256
+#define MEMCACHE_HASH_SIZE			64
+/* Reads larger than this many pages, e.g. image dumps, bypass the cache */
+#define MEMCACHE_MAX_READ_PAGES		16
+/* Drop the whole cache once it holds that many pages */
+#define MEMCACHE_MAX_PAGES			1024
+
+struct memcache_page {
+	struct memcache_page *next;
+	target_addr_t address;
+	/** false if the page could not be read; reads then bypass the cache */
+	bool valid;
+	uint8_t data[];
+};
+
+struct memcache_range {
+	target_addr_t address;
+	uint64_t size;
+};
+
+struct target_memcache {
+	bool enabled;
+	uint32_t page_size;
+	struct memcache_page *hash[MEMCACHE_HASH_SIZE];
+	unsigned int num_pages;
+
+	/** memory mapped I/O and other ranges which are never cached */
+	struct memcache_range *excluded;
+	unsigned int num_excluded;
+
+	struct {
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t bypassed;
+		uint64_t invalidations;
+	} stats;
+};
+
+static unsigned int memcache_hash(struct target_memcache *cache, target_addr_t address)
+{
+	return (address / cache->page_size) % MEMCACHE_HASH_SIZE;
+}
+
+static void memcache_flush(struct target_memcache *cache)
+{
+	if (!cache->num_pages)
+		return;
+
+	for (unsigned int i = 0; i < MEMCACHE_HASH_SIZE; i++) {
+		struct memcache_page *page = cache->hash[i];
+		while (page) {
+			struct memcache_page *next = page->next;
+			free(page);
+			page = next;
+		}
+		cache->hash[i] = NULL;
+	}
+	cache->num_pages = 0;
+	cache->stats.invalidations++;
+}
+
+static bool memcache_excluded(struct target_memcache *cache, target_addr_t address,
+		uint64_t size)
+{
+	for (unsigned int i = 0; i < cache->num_excluded; i++) {
+		const struct memcache_range *range = &cache->excluded[i];
+		if (address < range->address + range->size && range->address < address + size)
+			return true;
+	}
+
+	return false;
+}
+
+/* Look up the page at @a address, reading it from the target on a miss */
+static struct memcache_page *memcache_get_page(struct target *target,
+		struct target_memcache *cache, target_addr_t address)
+{
+	unsigned int bucket = memcache_hash(cache, address);
+
+	for (struct memcache_page *page = cache->hash[bucket]; page; page = page->next) {
+		if (page->address == address) {
+			if (!page->valid)
+				return NULL;
+			cache->stats.hits++;
+			return page;
+		}
+	}
+
+	if (cache->num_pages >= MEMCACHE_MAX_PAGES) {
+		memcache_flush(cache);
+		bucket = memcache_hash(cache, address);
+	}
+
+	struct memcache_page *page = malloc(sizeof(*page) + cache->page_size);
+	if (!page)
+		return NULL;
+
+	page->address = address;
+	page->valid = target->type->read_memory(target, address, 4,
+			cache->page_size / 4, page->data) == ERROR_OK;
+	page->next = cache->hash[bucket];
+	cache->hash[bucket] = page;
+	cache->num_pages++;
+
+	if (!page->valid) {
+		LOG_TARGET_DEBUG(target, "memory cache page at " TARGET_ADDR_FMT
+				" not readable, bypassing it", address);
+		return NULL;
+	}
+
+	cache->stats.misses++;
+
+	return page;
+}
+
+bool target_memcache_read(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	struct target_memcache *cache = target->memcache;
+
+	if (!cache || !cache->enabled || target->state != TARGET_HALTED)
+		return false;
+
+	uint64_t nbytes = (uint64_t)size * count;
+	if (!nbytes)
+		return false;
+
+	if (nbytes > (uint64_t)MEMCACHE_MAX_READ_PAGES * cache->page_size
+			|| address + nbytes - 1 < address
+			|| memcache_excluded(cache, address, nbytes)) {
+		cache->stats.bypassed++;
+		return false;
+	}
+
+	target_addr_t page_address = address & ~(target_addr_t)(cache->page_size - 1);
+	while (nbytes > 0) {
+		struct memcache_page *page = memcache_get_page(target, cache, page_address);
+		if (!page) {
+			cache->stats.bypassed++;
+			return false;
+		}
+
+		uint32_t offset = address - page_address;
+		uint32_t chunk = MIN(nbytes, cache->page_size - offset);
+		memcpy(buffer, page->data + offset, chunk);
+
+		buffer += chunk;
+		address += chunk;
+		nbytes -= chunk;
+		page_address += cache->page_size;
+	}
+
+	return true;
+}
+
+static unsigned int memcache_generation;
+
+void target_memcache_invalidate_all(void)
+{
+	memcache_generation++;
+
+	for (struct target *target = all_targets; target; target = target->next) {
+		if (target->memcache)
+			memcache_flush(target->memcache);
+	}
+}
+
+unsigned int target_memcache_generation(void)
+{
+	return memcache_generation;
+}
+
+void target_memcache_free(struct target *target)
+{
+	struct target_memcache *cache = target->memcache;
+
+	if (!cache)
+		return;
+
+	memcache_flush(cache);
+	free(cache->excluded);
+	free(cache);
+	target->memcache = NULL;
+}
+
+static struct target_memcache *memcache_get(struct target *target)
+{
+	if (!target->memcache) {
+		target->memcache = calloc(1, sizeof(*target->memcache));
+		if (!target->memcache) {
+			LOG_ERROR("Out of memory");
+			return NULL;
+		}
+		target->memcache->page_size = MEMCACHE_DEFAULT_PAGE_SIZE;
+	}
+
+	return target->memcache;
+}
+
+COMMAND_HANDLER(handle_memcache_enable_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		bool enable;
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], enable);
+
+		struct target_memcache *cache = memcache_get(target);
+		if (!cache)
+			return ERROR_FAIL;
+
+		memcache_flush(cache);
+		cache->enabled = enable;
+	}
+
+	command_print(CMD, "memory cache %s",
+			target->memcache && target->memcache->enabled ? "on" : "off");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memcache_page_size_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target_memcache *cache = memcache_get(target);
+	if (!cache)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC == 1) {
+		uint32_t page_size;
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], page_size);
+		if (page_size < 16 || page_size > 4096 || !IS_PWR_OF_2(page_size)) {
+			command_print(CMD, "page size must be a power of 2 from 16 to 4096");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+
+		memcache_flush(cache);
+		cache->page_size = page_size;
+	}
+
+	command_print(CMD, "%" PRIu32, cache->page_size);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memcache_exclude_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 0 && CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target_memcache *cache = memcache_get(target);
+	if (!cache)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC == 2) {
+		target_addr_t address;
+		uint64_t size;
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+		COMMAND_PARSE_NUMBER(u64, CMD_ARGV[1], size);
+		if (!size)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+
+		struct memcache_range *excluded = realloc(cache->excluded,
+				(cache->num_excluded + 1) * sizeof(*excluded));
+		if (!excluded) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		excluded[cache->num_excluded].address = address;
+		excluded[cache->num_excluded].size = size;
+		cache->excluded = excluded;
+		cache->num_excluded++;
+
+		memcache_flush(cache);
+		return ERROR_OK;
+	}
+
+	for (unsigned int i = 0; i < cache->num_excluded; i++)
+		command_print(CMD, TARGET_ADDR_FMT " 0x%" PRIx64,
+				cache->excluded[i].address, cache->excluded[i].size);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memcache_exclude_clear_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target_memcache *cache = target->memcache;
+	if (cache) {
+		free(cache->excluded);
+		cache->excluded = NULL;
+		cache->num_excluded = 0;
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memcache_flush_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (target->memcache)
+		memcache_flush(target->memcache);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memcache_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target_memcache *cache = target->memcache;
+	if (!cache) {
+		command_print(CMD, "memory cache off");
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "memory cache %s, %u pages of %" PRIu32 " bytes",
+			cache->enabled ? "on" : "off", cache->num_pages, cache->page_size);
+	command_print(CMD, "page hits %" PRIu64 ", misses %" PRIu64
+			", bypassed reads %" PRIu64 ", invalidations %" PRIu64,
+			cache->stats.hits, cache->stats.misses,
+			cache->stats.bypassed, cache->stats.invalidations);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration memcache_subcommand_handlers[] = {
+	{
+		.name = "enable",
+		.handler = handle_memcache_enable_command,
+		.mode = COMMAND_ANY,
+		.help = "enable or disable the memory read cache used while halted",
+		.usage = "[on|off]",
+	},
+	{
+		.name = "page_size",
+		.handler = handle_memcache_page_size_command,
+		.mode = COMMAND_ANY,
+		.help = "set or display the size of the cached pages",
+		.usage = "[bytes]",
+	},
+	{
+		.name = "exclude",
+		.handler = handle_memcache_exclude_command,
+		.mode = COMMAND_ANY,
+		.help = "never cache a memory range, e.g. memory mapped I/O; "
+			"without arguments list the excluded ranges",
+		.usage = "[address size]",
+	},
+	{
+		.name = "exclude_clear",
+		.handler = handle_memcache_exclude_clear_command,
+		.mode = COMMAND_ANY,
+		.help = "remove all excluded ranges",
+		.usage = "",
+	},
+	{
+		.name = "flush",
+		.handler = handle_memcache_flush_command,
+		.mode = COMMAND_EXEC,
+		.help = "drop all cached pages",
+		.usage = "",
+	},
+	{
+		.name = "stats",
+		.handler = handle_memcache_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "display the memory cache statistics",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration target_memcache_command_handlers[] = {
+	{
+		.name = "memcache",
+		.mode = COMMAND_ANY,
+		.help = "memory read cache used while the target is halted",
+		.usage = "",
+		.chain = memcache_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
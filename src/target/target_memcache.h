@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_TARGET_MEMCACHE_H
+#define OPENOCD_TARGET_TARGET_MEMCACHE_H
+
+#include <helper/command.h>
+#include <helper/types.h>
+
+struct target;
+
+/**
+ * Serve a read of @a count elements of @a size bytes from the memory cache
+ * of a halted target, filling missing pages from the target first.
+ * @returns true if @a buffer was filled, false if the caller has to read
+ * the target itself (cache disabled, target running, excluded range, ...).
+ */
+bool target_memcache_read(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, uint8_t *buffer);
+
+/**
+ * Drop the cached pages of all targets. Memory may be shared between
+ * targets, so anything that can change it invalidates every cache.
+ */
+void target_memcache_invalidate_all(void);
+
+/**
+ * Counter bumped by target_memcache_invalidate_all(). Data derived from
+ * target memory elsewhere, e.g. the registers of RTOS threads, stays valid
+ * as long as the counter does not change.
+ */
+unsigned int target_memcache_generation(void);
+
+void target_memcache_free(struct target *target);
+
+extern const struct command_registration target_memcache_command_handlers[];
+
+#endif /* OPENOCD_TARGET_TARGET_MEMCACHE_H */
@@ -17,6 +17,7 @@
 
 #include <helper/log.h>
 #include <helper/binarybuffer.h>
+#include <server/server.h>
 
 #include "target.h"
 #include "target_request.h"
@@ -34,6 +35,130 @@ bool target_got_message(void)
 
 static int charmsg_mode;
 
+#define TARGET_REQUEST_SINK_SERVICE_NAME "target_request"
+
+/* the hex messages of the target as they are, to a TCP client */
+struct target_request_sink {
+	char *port;
+	struct connection *connection;
+};
+
+/* private data of the service, freed by the server */
+struct target_request_sink_priv {
+	struct target_request_sink *sink;
+};
+
+static int target_request_sink_new_connection(struct connection *connection)
+{
+	struct target_request_sink_priv *priv = connection->service->priv;
+
+	priv->sink->connection = connection;
+
+	return ERROR_OK;
+}
+
+static int target_request_sink_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int target_request_sink_connection_closed(struct connection *connection)
+{
+	struct target_request_sink_priv *priv = connection->service->priv;
+
+	priv->sink->connection = NULL;
+
+	return ERROR_OK;
+}
+
+static const struct service_driver target_request_sink_driver = {
+	.name = TARGET_REQUEST_SINK_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = target_request_sink_new_connection,
+	.input_handler = target_request_sink_input,
+	.connection_closed_handler = target_request_sink_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+static int target_request_sink_start(struct target *target, const char *port)
+{
+	struct target_request_sink *sink = calloc(1, sizeof(*sink));
+	struct target_request_sink_priv *priv = malloc(sizeof(*priv));
+	if (sink)
+		sink->port = strdup(port);
+	if (!sink || !sink->port || !priv) {
+		LOG_ERROR("Out of memory");
+		if (sink)
+			free(sink->port);
+		free(sink);
+		free(priv);
+		return ERROR_FAIL;
+	}
+
+	priv->sink = sink;
+	int retval = add_service(&target_request_sink_driver, port, 1, priv);
+	if (retval != ERROR_OK) {
+		free(sink->port);
+		free(sink);
+		free(priv);
+		return retval;
+	}
+
+	target->dbgmsg_sink = sink;
+	target->dbg_msg_enabled = 1;
+
+	return ERROR_OK;
+}
+
+static void target_request_sink_stop(struct target *target)
+{
+	struct target_request_sink *sink = target->dbgmsg_sink;
+
+	if (!sink)
+		return;
+
+	/* also frees the private data of the service */
+	remove_service(TARGET_REQUEST_SINK_SERVICE_NAME, sink->port);
+	target_request_free(target);
+
+	if (!target->dbgmsg)
+		target->dbg_msg_enabled = 0;
+}
+
+void target_request_free(struct target *target)
+{
+	struct target_request_sink *sink = target->dbgmsg_sink;
+
+	if (!sink)
+		return;
+
+	free(sink->port);
+	free(sink);
+	target->dbgmsg_sink = NULL;
+}
+
+static void target_binmsg(struct target *target, const uint8_t *data, uint32_t length)
+{
+	struct connection *connection = target->dbgmsg_sink->connection;
+
+	if (!connection)
+		return;
+
+	if (connection_write(connection, data, length) != (int)length)
+		LOG_ERROR("Error writing binary debug message to connection");
+}
+
 static int target_asciimsg(struct target *target, uint32_t length)
 {
 	char *msg = malloc(DIV_ROUND_UP(length + 1, 4) * 4);
@@ -71,6 +196,12 @@ static int target_hexmsg(struct target *target, int size, uint32_t length)
 
 	target->type->target_request_data(target, DIV_ROUND_UP(length * size, 4), (uint8_t *)data);
 
+	if (target->dbgmsg_sink) {
+		target_binmsg(target, data, length * size);
+		free(data);
+		return ERROR_OK;
+	}
+
 	line_len = 0;
 	for (i = 0; i < length; i++) {
 		switch (size) {
@@ -223,7 +354,7 @@ int delete_debug_msg_receiver(struct command_context *cmd_ctx, struct target *ta
 			if (c->cmd_ctx == cmd_ctx) {
 				*p = next;
 				free(c);
-				if (!*p) {
+				if (!*p && !target->dbgmsg_sink) {
 					/* disable callback */
 					target->dbg_msg_enabled = 0;
 				}
@@ -277,6 +408,38 @@ COMMAND_HANDLER(handle_target_request_debugmsgs_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_target_request_binmsgs_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (!target->type->target_request_data) {
+		LOG_ERROR("Target %s does not support target requests", target_name(target));
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		target_request_sink_stop(target);
+
+		if (strcmp(CMD_ARGV[0], "disable")) {
+			int retval = target_request_sink_start(target, CMD_ARGV[0]);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	if (target->dbgmsg_sink)
+		command_print(CMD, "binary debug messages of current target %s go to port %s",
+				target_name(target), target->dbgmsg_sink->port);
+	else
+		command_print(CMD, "binary debug messages of current target %s are displayed",
+				target_name(target));
+
+	return ERROR_OK;
+}
+
 static const struct command_registration target_req_exec_command_handlers[] = {
 	{
 		.name = "debugmsgs",
@@ -285,6 +448,13 @@ static const struct command_registration target_req_exec_command_handlers[] = {
 		.help = "display and/or modify reception of debug messages from target",
 		.usage = "['enable'|'charmsg'|'disable']",
 	},
+	{
+		.name = "binmsgs",
+		.handler = handle_target_request_binmsgs_command,
+		.mode = COMMAND_EXEC,
+		.help = "send the binary debug messages of the target to a TCP port",
+		.usage = "[port|'disable']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 static const struct command_registration target_req_command_handlers[] = {
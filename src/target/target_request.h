@@ -32,6 +32,8 @@ struct debug_msg_receiver {
 int target_request(struct target *target, uint32_t request);
 int delete_debug_msg_receiver(struct command_context *cmd_ctx,
 		struct target *target);
+/* release the binary message sink of a target */
+void target_request_free(struct target *target);
 int target_request_register_commands(struct command_context *cmd_ctx);
 /**
  * Read and clear the flag as to whether we got a message.
@@ -106,6 +106,23 @@ struct target_type {
 			struct reg **reg_list[], int *reg_list_size,
 			enum target_register_class reg_class);
 
+	/**
+	 * Optional batched register read. Make the registers of @a reg_list
+	 * valid, reading all those not yet cached in as few transactions as
+	 * possible. NULL, nonexistent and valid entries are ignored. Do @b not
+	 * call this function directly, use target_read_registers() instead.
+	 */
+	int (*read_registers)(struct target *target, struct reg **reg_list,
+			unsigned int num_regs);
+	/**
+	 * Optional batched register write. Write the cached values of the
+	 * dirty registers of @a reg_list to the target in as few transactions
+	 * as possible. Do @b not call this function directly, use
+	 * target_write_registers() instead.
+	 */
+	int (*write_registers)(struct target *target, struct reg **reg_list,
+			unsigned int num_regs);
+
 	/* target memory access
 	* size: 1 = byte (8bit), 2 = half-word (16bit), 4 = word (32bit)
 	* count: number of items of <size>
@@ -124,6 +141,19 @@ struct target_type {
 	int (*write_memory)(struct target *target, target_addr_t address,
 			uint32_t size, uint32_t count, const uint8_t *buffer);
 
+	/**
+	 * Optional deferred variants of read_memory() and write_memory(), the
+	 * capability of merging the pieces of an unaligned buffer access into
+	 * a single queue flush. The accesses are only executed, and read data
+	 * is only valid, once run_queued_memory() returns ERROR_OK. A target
+	 * must provide run_queued_memory() along with either of them.
+	 */
+	int (*queue_read_memory)(struct target *target, target_addr_t address,
+			uint32_t size, uint32_t count, uint8_t *buffer);
+	int (*queue_write_memory)(struct target *target, target_addr_t address,
+			uint32_t size, uint32_t count, const uint8_t *buffer);
+	int (*run_queued_memory)(struct target *target);
+
 	/* Default implementation will do some fancy alignment to improve performance, target can override */
 	int (*read_buffer)(struct target *target, target_addr_t address,
 			uint32_t size, uint8_t *buffer);
@@ -160,6 +190,18 @@ struct target_type {
 	 */
 	int (*remove_breakpoint)(struct target *target, struct breakpoint *breakpoint);
 
+	/**
+	 * Optional batched variants of add_breakpoint() and remove_breakpoint()
+	 * for software breakpoints, setting or restoring all instructions with
+	 * as few memory transactions as possible. add_breakpoints() must leave
+	 * no breakpoint set when it fails. Do @b not call these functions
+	 * directly, use target_add_breakpoints() and target_remove_breakpoints().
+	 */
+	int (*add_breakpoints)(struct target *target,
+			struct breakpoint **breakpoint_list, unsigned int num_breakpoints);
+	int (*remove_breakpoints)(struct target *target,
+			struct breakpoint **breakpoint_list, unsigned int num_breakpoints);
+
 	/* add watchpoint ... see add_breakpoint() comment above. */
 	int (*add_watchpoint)(struct target *target, struct watchpoint *watchpoint);
 
@@ -324,8 +324,11 @@ static int read_mem(struct target *t, uint32_t size,
 
 	/* if CS.D bit=1 then its a 32 bit code segment, else 16 */
 	bool use32 = (buf_get_u32(x86_32->cache->reg_list[CSAR].value, 0, 32)) & CSAR_D;
+	/* queue the address and the load, the EDX read flushes them */
+	x86_32->flush = 0;
 	int retval = x86_32->write_hw_reg(t, EAX, addr, 0);
 	if (retval != ERROR_OK) {
+		x86_32->flush = 1;
 		LOG_ERROR("%s error write EAX", __func__);
 		return retval;
 	}
@@ -354,6 +357,7 @@ static int read_mem(struct target *t, uint32_t size,
 			break;
 	}
 
+	x86_32->flush = 1;
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -392,8 +396,11 @@ static int write_mem(struct target *t, uint32_t size,
 	}
 	/* if CS.D bit=1 then its a 32 bit code segment, else 16 */
 	bool use32 = (buf_get_u32(x86_32->cache->reg_list[CSAR].value, 0, 32)) & CSAR_D;
+	/* queue the address and the data, the store flushes them */
+	x86_32->flush = 0;
 	retval = x86_32->write_hw_reg(t, EAX, addr, 0);
 	if (retval != ERROR_OK) {
+		x86_32->flush = 1;
 		LOG_ERROR("%s error write EAX", __func__);
 		return retval;
 	}
@@ -402,6 +409,7 @@ static int write_mem(struct target *t, uint32_t size,
 	 * Watch out, the buffer passed into write_mem() might be 1 or 2 bytes.
 	 */
 	retval = x86_32->write_hw_reg(t, EDX, buf4bytes, 0);
+	x86_32->flush = 1;
 	if (retval != ERROR_OK) {
 		LOG_ERROR("%s error write EDX", __func__);
 		return retval;
@@ -1272,15 +1280,9 @@ void x86_32_common_reset_breakpoints_watchpoints(struct target *t)
 {
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
 	struct x86_32_dbg_reg *debug_reg_list = x86_32->hw_break_list;
-	struct breakpoint *next_b;
 	struct watchpoint *next_w;
 
-	while (t->breakpoints) {
-		next_b = t->breakpoints->next;
-		free(t->breakpoints->orig_instr);
-		free(t->breakpoints);
-		t->breakpoints = next_b;
-	}
+	breakpoint_forget_all(t);
 
 	while (t->watchpoints) {
 		next_w = t->watchpoints->next;
@@ -180,6 +180,8 @@
 #define XT_HW_IBREAK_MAX_NUM            2
 #define XT_HW_DBREAK_MAX_NUM            2
 
+#define XT_MEM_CHUNK_WORDS              4096	/* LDDR32.P/SDDR32.P words per queue execution */
+
 struct xtensa_reg_desc xtensa_regs[XT_NUM_REGS] = {
 	XT_MK_REG_DESC("pc", XT_PC_REG_NUM_VIRTUAL, XT_REG_SPECIAL, 0),
 	XT_MK_REG_DESC("ar0", 0x00, XT_REG_GENERAL, 0),
@@ -679,7 +681,11 @@ static int xtensa_write_dirty_registers(struct target *target)
 	}
 
 	preserve_a3 = (xtensa->core_config->windowed) || (xtensa->core_config->core_type == XT_NX);
-	if (preserve_a3) {
+	if (preserve_a3 && reg_list[XT_REG_IDX_A3].valid) {
+		/* The cached (windowed) A3 is either what A3 holds, or, once dirty, what it should
+		 * hold: restore it without a round trip to read it back */
+		a3 = xtensa_reg_get(target, XT_REG_IDX_A3);
+	} else if (preserve_a3) {
 		/* Save (windowed) A3 for scratch use */
 		xtensa_queue_exec_ins(xtensa, XT_INS_WSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		xtensa_queue_dbg_reg_read(xtensa, XDMREG_DDR, a3_buf);
@@ -1146,7 +1152,7 @@ int xtensa_fetch_all_regs(struct target *target)
 	struct xtensa *xtensa = target_to_xtensa(target);
 	struct reg *reg_list = xtensa->core_cache->reg_list;
 	unsigned int reg_list_size = xtensa->core_cache->num_regs;
-	xtensa_reg_val_t cpenable = 0, windowbase = 0, a0 = 0, a3;
+	xtensa_reg_val_t cpenable = 0, queued_cpenable = 0, windowbase = 0, a0 = 0, a3;
 	unsigned int ms_idx = reg_list_size;
 	uint32_t ms = 0;
 	uint32_t woe;
@@ -1226,38 +1232,21 @@ int xtensa_fetch_all_regs(struct target *target)
 		xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, xtensa_regs[XT_REG_IDX_CPENABLE].reg_num, XT_REG_A3));
 		xtensa_queue_exec_ins(xtensa, XT_INS_WSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		xtensa_queue_dbg_reg_read(xtensa, XDMREG_DDR, regvals[XT_REG_IDX_CPENABLE].buf);
-	}
-	res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
-	if (res != ERROR_OK) {
-		LOG_ERROR("Failed to read ARs (%d)!", res);
-		goto xtensa_fetch_all_regs_done;
-	}
-	xtensa_core_status_check(target);
-
-	a3 = buf_get_u32(a3_buf, 0, 32);
-	if (xtensa->core_config->core_type == XT_NX) {
-		a0 = buf_get_u32(a0_buf, 0, 32);
-		ms = buf_get_u32(ms_buf, 0, 32);
-	}
 
-	if (xtensa->core_config->coproc) {
-		cpenable = buf_get_u32(regvals[XT_REG_IDX_CPENABLE].buf, 0, 32);
-
-		/* Enable all coprocessors (by setting all bits in CPENABLE) so we can read FP and user registers. */
+		/* Enable all coprocessors (by setting all bits in CPENABLE) so we can read FP and user
+		 * registers in the same queue, without waiting for the value of CPENABLE. The registers
+		 * of the coprocessors disabled by the original CPENABLE are read, but left invalid. */
 		xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, 0xffffffff);
 		xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		xtensa_queue_exec_ins(xtensa, XT_INS_WSR(xtensa, xtensa_regs[XT_REG_IDX_CPENABLE].reg_num, XT_REG_A3));
-
-		/* Save CPENABLE; flag dirty later (when regcache updated) so original value is always restored */
-		LOG_TARGET_DEBUG(target, "CPENABLE: was 0x%" PRIx32 ", all enabled", cpenable);
-		xtensa_reg_set(target, XT_REG_IDX_CPENABLE, cpenable);
+		queued_cpenable = 0xffffffff;
 	}
 	/* We're now free to use any of A0-A15 as scratch registers
 	 * Grab the SFRs and user registers first. We use A3 as a scratch register. */
 	for (unsigned int i = 0; i < reg_list_size; i++) {
 		struct xtensa_reg_desc *rlist = (i < XT_NUM_REGS) ? xtensa_regs : xtensa->optregs;
 		unsigned int ridx = (i < XT_NUM_REGS) ? i : i - XT_NUM_REGS;
-		if (xtensa_reg_is_readable(rlist[ridx].flags, cpenable) && rlist[ridx].exist) {
+		if (xtensa_reg_is_readable(rlist[ridx].flags, queued_cpenable) && rlist[ridx].exist) {
 			bool reg_fetched = true;
 			unsigned int reg_num = rlist[ridx].reg_num;
 			switch (rlist[ridx].type) {
@@ -1313,6 +1302,20 @@ int xtensa_fetch_all_regs(struct target *target)
 	}
 	xtensa_core_status_check(target);
 
+	a3 = buf_get_u32(a3_buf, 0, 32);
+	if (xtensa->core_config->core_type == XT_NX) {
+		a0 = buf_get_u32(a0_buf, 0, 32);
+		ms = buf_get_u32(ms_buf, 0, 32);
+	}
+
+	if (xtensa->core_config->coproc) {
+		cpenable = buf_get_u32(regvals[XT_REG_IDX_CPENABLE].buf, 0, 32);
+
+		/* Save CPENABLE; flag dirty later (when regcache updated) so original value is always restored */
+		LOG_TARGET_DEBUG(target, "CPENABLE: was 0x%" PRIx32 ", all enabled", cpenable);
+		xtensa_reg_set(target, XT_REG_IDX_CPENABLE, cpenable);
+	}
+
 	if (debug_dsrs) {
 		/* DSR checking: follows order in which registers are requested. */
 		for (unsigned int i = 0; i < reg_list_size; i++) {
@@ -1928,6 +1931,105 @@ static bool xtensa_memory_op_validate_range(struct xtensa *xtensa, target_addr_t
 	return true;
 }
 
+/* Execute the queued accesses of a chunk, with a read of DSR queued after them: DSR keeps the
+ * exception of any earlier instruction, so a single read checks the whole chunk. */
+static int xtensa_mem_chunk_execute(struct target *target)
+{
+	struct xtensa *xtensa = target_to_xtensa(target);
+	uint8_t dsr_buf[4];
+
+	xtensa_queue_dbg_reg_read(xtensa, XDMREG_DSR, dsr_buf);
+	int res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
+	if (res != ERROR_OK)
+		return res;
+
+	xtensa_dsr_t dsr = buf_get_u32(dsr_buf, 0, 32);
+	if (!(dsr & (OCDDSR_EXECBUSY | OCDDSR_EXECEXCEPTION | OCDDSR_EXECOVERRUN)) &&
+		xtensa->core_config->core_type != XT_NX)
+		return ERROR_OK;
+
+	/* Check again and clear the exception, quietly as the callers retry */
+	bool prev_suppress = xtensa->suppress_dsr_errors;
+	xtensa->suppress_dsr_errors = true;
+	res = xtensa_core_status_check(target);
+	xtensa->suppress_dsr_errors = prev_suppress;
+	return res;
+}
+
+/* Stream aligned words from or to memory with LDDR32.P/SDDR32.P and a single queue execution */
+static int xtensa_mem_words_lsddr32p(struct target *target, target_addr_t address,
+	unsigned int count, uint8_t *buffer, bool write)
+{
+	struct xtensa *xtensa = target_to_xtensa(target);
+
+	/* Write start address to A3 */
+	xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, address);
+	xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
+	if (write) {
+		xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, buf_get_u32(buffer, 0, 32));
+		xtensa_queue_exec_ins(xtensa, XT_INS_SDDR32P(xtensa, XT_REG_A3));
+		for (unsigned int i = 1; i < count; i++)
+			xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDREXEC,
+				buf_get_u32(&buffer[i * sizeof(uint32_t)], 0, 32));
+	} else {
+		xtensa_queue_exec_ins(xtensa, XT_INS_LDDR32P(xtensa, XT_REG_A3));
+		for (unsigned int i = 0; i < count; i++)
+			xtensa_queue_dbg_reg_read(xtensa, (i + 1 == count) ? XDMREG_DDR : XDMREG_DDREXEC,
+				&buffer[i * sizeof(uint32_t)]);
+	}
+
+	return xtensa_mem_chunk_execute(target);
+}
+
+/* On a failure, retry both halves: a transient error is passed, and a real one is narrowed
+ * down to the failing word */
+static int xtensa_mem_words_bisect(struct target *target, target_addr_t address,
+	unsigned int count, uint8_t *buffer, bool write)
+{
+	int res = xtensa_mem_words_lsddr32p(target, address, count, buffer, write);
+	if (res == ERROR_OK)
+		return res;
+	if (count == 1) {
+		LOG_TARGET_DEBUG(target, "%s of the word at " TARGET_ADDR_FMT " failed",
+			write ? "Write" : "Read", address);
+		return res;
+	}
+
+	unsigned int half = count / 2;
+	res = xtensa_mem_words_bisect(target, address, half, buffer, write);
+	if (res == ERROR_OK)
+		res = xtensa_mem_words_bisect(target, address + half * sizeof(uint32_t), count - half,
+			&buffer[half * sizeof(uint32_t)], write);
+	return res;
+}
+
+/* Access aligned words with LDDR32.P/SDDR32.P, in chunks bounding the size of the queue */
+static int xtensa_mem_lsddr32p(struct target *target, target_addr_t address,
+	unsigned int count, uint8_t *buffer, bool write)
+{
+	struct xtensa *xtensa = target_to_xtensa(target);
+
+	for (unsigned int i = 0; i < count; ) {
+		unsigned int n = MIN(count - i, XT_MEM_CHUNK_WORDS);
+		target_addr_t adr = address + i * sizeof(uint32_t);
+		int res;
+
+		/* Until the instructions are known to work, fail fast to the slow access */
+		if (xtensa->probe_lsddr32p == -1)
+			res = xtensa_mem_words_lsddr32p(target, adr, n, &buffer[i * sizeof(uint32_t)], write);
+		else
+			res = xtensa_mem_words_bisect(target, adr, n, &buffer[i * sizeof(uint32_t)], write);
+		if (res != ERROR_OK)
+			return res;
+
+		if (xtensa->probe_lsddr32p == -1)
+			xtensa->probe_lsddr32p = 1;
+		i += n;
+	}
+
+	return ERROR_OK;
+}
+
 int xtensa_read_memory(struct target *target, target_addr_t address, uint32_t size, uint32_t count, uint8_t *buffer)
 {
 	struct xtensa *xtensa = target_to_xtensa(target);
@@ -1962,17 +2064,15 @@ int xtensa_read_memory(struct target *target, target_addr_t address, uint32_t si
 
 	/* We're going to use A3 here */
 	xtensa_mark_register_dirty(xtensa, XT_REG_IDX_A3);
-	/* Write start address to A3 */
-	xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, addrstart_al);
-	xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 	/* Now we can safely read data from addrstart_al up to addrend_al into albuff */
+	int res;
 	if (xtensa->probe_lsddr32p != 0) {
-		xtensa_queue_exec_ins(xtensa, XT_INS_LDDR32P(xtensa, XT_REG_A3));
-		for (unsigned int i = 0; adr != addrend_al; i += sizeof(uint32_t), adr += sizeof(uint32_t))
-			xtensa_queue_dbg_reg_read(xtensa,
-				(adr + sizeof(uint32_t) == addrend_al) ? XDMREG_DDR : XDMREG_DDREXEC,
-				&albuff[i]);
+		res = xtensa_mem_lsddr32p(target, addrstart_al, (addrend_al - addrstart_al) / sizeof(uint32_t),
+			albuff, false);
 	} else {
+		/* Write start address to A3 */
+		xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, addrstart_al);
+		xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		xtensa_mark_register_dirty(xtensa, XT_REG_IDX_A4);
 		for (unsigned int i = 0; adr != addrend_al; i += sizeof(uint32_t), adr += sizeof(uint32_t)) {
 			xtensa_queue_exec_ins(xtensa, XT_INS_L32I(xtensa, XT_REG_A3, XT_REG_A4, 0));
@@ -1981,15 +2081,13 @@ int xtensa_read_memory(struct target *target, target_addr_t address, uint32_t si
 			xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, adr + sizeof(uint32_t));
 			xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		}
-	}
-	int res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
-	if (res == ERROR_OK) {
-		bool prev_suppress = xtensa->suppress_dsr_errors;
-		xtensa->suppress_dsr_errors = true;
-		res = xtensa_core_status_check(target);
-		if (xtensa->probe_lsddr32p == -1)
-			xtensa->probe_lsddr32p = 1;
-		xtensa->suppress_dsr_errors = prev_suppress;
+		res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
+		if (res == ERROR_OK) {
+			bool prev_suppress = xtensa->suppress_dsr_errors;
+			xtensa->suppress_dsr_errors = true;
+			res = xtensa_core_status_check(target);
+			xtensa->suppress_dsr_errors = prev_suppress;
+		}
 	}
 	if (res != ERROR_OK) {
 		if (xtensa->probe_lsddr32p != 0) {
@@ -2129,20 +2227,14 @@ int xtensa_write_memory(struct target *target,
 	if (xtensa->target->endianness == TARGET_BIG_ENDIAN)
 		buf_bswap32(albuff, fill_head_tail ? albuff : buffer, addrend_al - addrstart_al);
 
-	/* Write start address to A3 */
-	xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, addrstart_al);
-	xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 	/* Write the aligned buffer */
 	if (xtensa->probe_lsddr32p != 0) {
-		for (unsigned int i = 0; adr != addrend_al; i += sizeof(uint32_t), adr += sizeof(uint32_t)) {
-			if (i == 0) {
-				xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, buf_get_u32(&albuff[i], 0, 32));
-				xtensa_queue_exec_ins(xtensa, XT_INS_SDDR32P(xtensa, XT_REG_A3));
-			} else {
-				xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDREXEC, buf_get_u32(&albuff[i], 0, 32));
-			}
-		}
+		res = xtensa_mem_lsddr32p(target, addrstart_al, (addrend_al - addrstart_al) / sizeof(uint32_t),
+			albuff, true);
 	} else {
+		/* Write start address to A3 */
+		xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, addrstart_al);
+		xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		xtensa_mark_register_dirty(xtensa, XT_REG_IDX_A4);
 		for (unsigned int i = 0; adr != addrend_al; i += sizeof(uint32_t), adr += sizeof(uint32_t)) {
 			xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, buf_get_u32(&albuff[i], 0, 32));
@@ -2151,17 +2243,15 @@ int xtensa_write_memory(struct target *target,
 			xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, adr + sizeof(uint32_t));
 			xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		}
+		res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
+		if (res == ERROR_OK) {
+			bool prev_suppress = xtensa->suppress_dsr_errors;
+			xtensa->suppress_dsr_errors = true;
+			res = xtensa_core_status_check(target);
+			xtensa->suppress_dsr_errors = prev_suppress;
+		}
 	}
 
-	res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
-	if (res == ERROR_OK) {
-		bool prev_suppress = xtensa->suppress_dsr_errors;
-		xtensa->suppress_dsr_errors = true;
-		res = xtensa_core_status_check(target);
-		if (xtensa->probe_lsddr32p == -1)
-			xtensa->probe_lsddr32p = 1;
-		xtensa->suppress_dsr_errors = prev_suppress;
-	}
 	if (res != ERROR_OK) {
 		if (xtensa->probe_lsddr32p != 0) {
 			/* Disable fast memory access instructions and retry before reporting an error */
@@ -2224,8 +2314,8 @@ int xtensa_write_buffer(struct target *target, target_addr_t address, uint32_t c
 
 int xtensa_checksum_memory(struct target *target, target_addr_t address, uint32_t count, uint32_t *checksum)
 {
-	LOG_WARNING("not implemented yet");
-	return ERROR_FAIL;
+	/* no loader yet, target_checksum_memory() reads the memory instead */
+	return ERROR_NOT_IMPLEMENTED;
 }
 
 int xtensa_poll(struct target *target)
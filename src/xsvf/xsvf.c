@@ -31,6 +31,7 @@
 #include "helper/system.h"
 #include <jtag/jtag.h>
 #include <svf/svf.h>
+#include <helper/binarybuffer.h>
 
 /* XSVF commands, from appendix B of xapp503.pdf  */
 #define XCOMPLETE			0x00
@@ -111,6 +112,146 @@ TDO  (1);
 
 static int xsvf_fd;
 
+/* the file is read in chunks, xsvf_read() takes the bytes out of them */
+#define XSVF_READ_CHUNK_SIZE (64 * 1024)
+static uint8_t *xsvf_read_buf;
+static size_t xsvf_read_buf_pos, xsvf_read_buf_len;
+/* offset in the file of the chunk */
+static long xsvf_read_buf_offset;
+
+/*
+ * The TDO of the scans without retries is checked after the JTAG queue is
+ * executed, along with the scans which follow them, up to this amount of data.
+ */
+#define XSVF_MAX_CHECK_BYTES (1024 * 1024)
+
+struct xsvf_check {
+	long file_offset;
+	const char *op_name;
+	int num_bits;
+	/* the captured TDO, followed by the expected one and the mask */
+	uint8_t *tdo;
+};
+
+static struct xsvf_check *xsvf_checks;
+static unsigned int xsvf_num_checks, xsvf_max_checks;
+static size_t xsvf_check_bytes;
+
+/* like read() on xsvf_fd */
+static int xsvf_read(void *data, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		if (xsvf_read_buf_pos == xsvf_read_buf_len) {
+			if (!xsvf_read_buf) {
+				xsvf_read_buf = malloc(XSVF_READ_CHUNK_SIZE);
+				if (!xsvf_read_buf)
+					return -1;
+			}
+
+			ssize_t n = read(xsvf_fd, xsvf_read_buf, XSVF_READ_CHUNK_SIZE);
+			if (n < 0)
+				return -1;
+			if (n == 0)
+				break;
+
+			xsvf_read_buf_offset += xsvf_read_buf_len;
+			xsvf_read_buf_pos = 0;
+			xsvf_read_buf_len = n;
+		}
+
+		size_t n = MIN(len - done, xsvf_read_buf_len - xsvf_read_buf_pos);
+		memcpy((uint8_t *)data + done, xsvf_read_buf + xsvf_read_buf_pos, n);
+		xsvf_read_buf_pos += n;
+		done += n;
+	}
+
+	return done;
+}
+
+/* the offset in the file of the next byte xsvf_read() returns */
+static long xsvf_tell(void)
+{
+	return xsvf_read_buf_offset + xsvf_read_buf_pos;
+}
+
+static void xsvf_free_checks(void)
+{
+	for (unsigned int i = 0; i < xsvf_num_checks; i++)
+		free(xsvf_checks[i].tdo);
+	xsvf_num_checks = 0;
+	xsvf_check_bytes = 0;
+}
+
+/* Add a check of a scan, returns the buffer for the TDO of the scan */
+static uint8_t *xsvf_add_check(long file_offset, const char *op_name, int num_bits,
+		const uint8_t *expected, const uint8_t *mask)
+{
+	unsigned int num_bytes = DIV_ROUND_UP(num_bits, 8);
+
+	if (xsvf_num_checks == xsvf_max_checks) {
+		unsigned int max_checks = MAX(2 * xsvf_max_checks, 64u);
+		struct xsvf_check *checks = realloc(xsvf_checks, max_checks * sizeof(*checks));
+		if (!checks)
+			return NULL;
+		xsvf_checks = checks;
+		xsvf_max_checks = max_checks;
+	}
+
+	uint8_t *tdo = calloc(3, num_bytes);
+	if (!tdo)
+		return NULL;
+	memcpy(tdo + num_bytes, expected, num_bytes);
+	memcpy(tdo + 2 * num_bytes, mask, num_bytes);
+
+	struct xsvf_check *check = &xsvf_checks[xsvf_num_checks++];
+	check->file_offset = file_offset;
+	check->op_name = op_name;
+	check->num_bits = num_bits;
+	check->tdo = tdo;
+	xsvf_check_bytes += 3 * num_bytes;
+
+	return tdo;
+}
+
+/*
+ * Execute the JTAG queue and check the TDO of the scans queued since,
+ * @a file_offset is set to the opcode of the first scan with a mismatch.
+ */
+static int xsvf_execute_queue(long *file_offset)
+{
+	int retval = jtag_execute_queue();
+
+	for (unsigned int i = 0; i < xsvf_num_checks && retval == ERROR_OK; i++) {
+		struct xsvf_check *check = &xsvf_checks[i];
+		unsigned int num_bytes = DIV_ROUND_UP(check->num_bits, 8);
+		const uint8_t *expected = check->tdo + num_bytes;
+		const uint8_t *mask = check->tdo + 2 * num_bytes;
+
+		if (!buf_cmp_mask(check->tdo, expected, mask, check->num_bits))
+			continue;
+
+		char *captured_str = buf_to_hex_str(check->tdo, check->num_bits);
+		char *expected_str = buf_to_hex_str(expected, check->num_bits);
+		char *mask_str = buf_to_hex_str(mask, check->num_bits);
+		LOG_ERROR("%s mismatch at offset %ld: captured 0x%s, expected 0x%s, mask 0x%s",
+			check->op_name, check->file_offset,
+			captured_str ? captured_str : "", expected_str ? expected_str : "",
+			mask_str ? mask_str : "");
+		free(captured_str);
+		free(expected_str);
+		free(mask_str);
+
+		*file_offset = check->file_offset;
+		retval = ERROR_JTAG_QUEUE_FAILED;
+	}
+
+	xsvf_free_checks();
+
+	return retval;
+}
+
 /* map xsvf tap state to an openocd "tap_state_t" */
 static tap_state_t xsvf_to_tap(int xsvf_state)
 {
@@ -173,14 +314,18 @@ static tap_state_t xsvf_to_tap(int xsvf_state)
 	return ret;
 }
 
-static int xsvf_read_buffer(int num_bits, int fd, uint8_t *buf)
+static int xsvf_read_buffer(int num_bits, uint8_t *buf)
 {
-	int num_bytes;
+	int num_bytes = (num_bits + 7) / 8;
+
+	if (xsvf_read(buf, num_bytes) < 0)
+		return ERROR_XSVF_EOF;
 
-	for (num_bytes = (num_bits + 7) / 8; num_bytes > 0; num_bytes--) {
-		/* reverse the order of bytes as they are read sequentially from file */
-		if (read(fd, buf + num_bytes - 1, 1) < 0)
-			return ERROR_XSVF_EOF;
+	/* reverse the order of bytes as they are read sequentially from file */
+	for (int i = 0; i < num_bytes / 2; i++) {
+		uint8_t b = buf[i];
+		buf[i] = buf[num_bytes - 1 - i];
+		buf[num_bytes - 1 - i] = b;
 	}
 
 	return ERROR_OK;
@@ -245,6 +390,9 @@ COMMAND_HANDLER(handle_xsvf_command)
 	}
 
 	xsvf_fd = open(filename, O_RDONLY);
+	xsvf_read_buf_pos = 0;
+	xsvf_read_buf_len = 0;
+	xsvf_read_buf_offset = 0;
 	if (xsvf_fd < 0) {
 		command_print(CMD, "file \"%s\" not found", filename);
 		return ERROR_FAIL;
@@ -264,9 +412,9 @@ COMMAND_HANDLER(handle_xsvf_command)
 	LOG_WARNING("XSVF support in OpenOCD is limited. Consider using SVF instead");
 	LOG_USER("xsvf processing file: \"%s\"", filename);
 
-	while (read(xsvf_fd, &opcode, 1) > 0) {
+	while (xsvf_read(&opcode, 1) > 0) {
 		/* record the position of this opcode within the file */
-		file_offset = lseek(xsvf_fd, 0, SEEK_CUR) - 1;
+		file_offset = xsvf_tell() - 1;
 
 		/* maybe collect another state for a pathmove();
 		 * or terminate a path.
@@ -286,7 +434,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 						break;
 					}
 
-					if (read(xsvf_fd, &uc, 1) < 0) {
+					if (xsvf_read(&uc, 1) < 0) {
 						do_abort = 1;
 						break;
 					}
@@ -334,7 +482,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 					else
 						jtag_add_pathmove(pathlen, path);
 
-					result = jtag_execute_queue();
+					result = xsvf_execute_queue(&file_offset);
 					if (result != ERROR_OK) {
 						LOG_ERROR("XSVF: pathmove error %d", result);
 						do_abort = 1;
@@ -348,7 +496,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			case XCOMPLETE:
 				LOG_DEBUG("XCOMPLETE");
 
-				result = jtag_execute_queue();
+				result = xsvf_execute_queue(&file_offset);
 				if (result != ERROR_OK) {
 					tdo_mismatch = 1;
 					break;
@@ -358,7 +506,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			case XTDOMASK:
 				LOG_DEBUG("XTDOMASK");
 				if (dr_in_mask &&
-						(xsvf_read_buffer(xsdrsize, xsvf_fd, dr_in_mask) != ERROR_OK))
+						(xsvf_read_buffer(xsdrsize, dr_in_mask) != ERROR_OK))
 					do_abort = 1;
 				break;
 
@@ -366,7 +514,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			{
 				uint8_t xruntest_buf[4];
 
-				if (read(xsvf_fd, xruntest_buf, 4) < 0) {
+				if (xsvf_read(xruntest_buf, 4) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -380,7 +528,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			{
 				uint8_t myrepeat;
 
-				if (read(xsvf_fd, &myrepeat, 1) < 0)
+				if (xsvf_read(&myrepeat, 1) < 0)
 					do_abort = 1;
 				else {
 					xrepeat = myrepeat;
@@ -393,7 +541,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			{
 				uint8_t xsdrsize_buf[4];
 
-				if (read(xsvf_fd, xsdrsize_buf, 4) < 0) {
+				if (xsvf_read(xsdrsize_buf, 4) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -420,14 +568,13 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 				const char *op_name = (opcode == XSDR ? "XSDR" : "XSDRTDO");
 
-				if (xsvf_read_buffer(xsdrsize, xsvf_fd, dr_out_buf) != ERROR_OK) {
+				if (xsvf_read_buffer(xsdrsize, dr_out_buf) != ERROR_OK) {
 					do_abort = 1;
 					break;
 				}
 
 				if (opcode == XSDRTDO) {
-					if (xsvf_read_buffer(xsdrsize, xsvf_fd,
-						dr_in_buf)  != ERROR_OK) {
+					if (xsvf_read_buffer(xsdrsize, dr_in_buf) != ERROR_OK) {
 						do_abort = 1;
 						break;
 					}
@@ -438,7 +585,39 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 				LOG_DEBUG("%s %d", op_name, xsdrsize);
 
-				for (attempt = 0; attempt < limit; ++attempt) {
+				if (limit == 1) {
+					/* nothing to retry, check the TDO along with the next scans */
+					struct scan_field field;
+
+					field.num_bits = xsdrsize;
+					field.out_value = dr_out_buf;
+					field.in_value = xsvf_add_check(file_offset, op_name, xsdrsize,
+							dr_in_buf, dr_in_mask);
+					if (!field.in_value) {
+						LOG_ERROR("Out of memory");
+						do_abort = 1;
+						break;
+					}
+
+					if (!tap)
+						jtag_add_plain_dr_scan(field.num_bits,
+								field.out_value,
+								field.in_value,
+								TAP_DRPAUSE);
+					else
+						jtag_add_dr_scan(tap, 1, &field, TAP_DRPAUSE);
+
+					matched = 1;
+					if (xsvf_check_bytes >= XSVF_MAX_CHECK_BYTES &&
+							xsvf_execute_queue(&file_offset) != ERROR_OK)
+						matched = 0;
+					limit = 0;
+				} else if (xsvf_execute_queue(&file_offset) != ERROR_OK) {
+					/* a scan before has a mismatch */
+					limit = 0;
+				}
+
+				for (attempt = 0; !matched && attempt < limit; ++attempt) {
 					struct scan_field field;
 
 					if (attempt > 0) {
@@ -486,10 +665,9 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 					jtag_check_value_mask(&field, dr_in_buf, dr_in_mask);
 
-					free(field.in_value);
-
 					/* LOG_DEBUG("FLUSHING QUEUE"); */
 					result = jtag_execute_queue();
+					free(field.in_value);
 					if (result == ERROR_OK) {
 						matched = 1;
 						break;
@@ -565,7 +743,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			{
 				tap_state_t mystate;
 
-				if (read(xsvf_fd, &uc, 1) < 0) {
+				if (xsvf_read(&uc, 1) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -608,7 +786,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 			case XENDIR:
 
-				if (read(xsvf_fd, &uc, 1) < 0) {
+				if (xsvf_read(&uc, 1) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -629,7 +807,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 			case XENDDR:
 
-				if (read(xsvf_fd, &uc, 1) < 0) {
+				if (xsvf_read(&uc, 1) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -658,14 +836,14 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 				if (opcode == XSIR) {
 					/* one byte bitcount */
-					if (read(xsvf_fd, short_buf, 1) < 0) {
+					if (xsvf_read(short_buf, 1) < 0) {
 						do_abort = 1;
 						break;
 					}
 					bitcount = short_buf[0];
 					LOG_DEBUG("XSIR %d", bitcount);
 				} else {
-					if (read(xsvf_fd, short_buf, 2) < 0) {
+					if (xsvf_read(short_buf, 2) < 0) {
 						do_abort = 1;
 						break;
 					}
@@ -675,7 +853,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 				ir_buf = malloc((bitcount + 7) / 8);
 
-				if (xsvf_read_buffer(bitcount, xsvf_fd, ir_buf) != ERROR_OK)
+				if (xsvf_read_buffer(bitcount, ir_buf) != ERROR_OK)
 					do_abort = 1;
 				else {
 					struct scan_field field;
@@ -701,12 +879,10 @@ COMMAND_HANDLER(handle_xsvf_command)
 					/* Note that an -irmask of non-zero in your config file
 					 * can cause this to fail.  Setting -irmask to zero cand work
 					 * around the problem.
+					 *
+					 * The queue is executed with the next scans, the
+					 * JTAG layer has made a copy of ir_buf.
 					 */
-
-					/* LOG_DEBUG("FLUSHING QUEUE"); */
-					result = jtag_execute_queue();
-					if (result != ERROR_OK)
-						tdo_mismatch = 1;
 				}
 				free(ir_buf);
 			}
@@ -718,7 +894,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 				char comment[128];
 
 				do {
-					if (read(xsvf_fd, &uc, 1) < 0) {
+					if (xsvf_read(&uc, 1) < 0) {
 						do_abort = 1;
 						break;
 					}
@@ -748,11 +924,11 @@ COMMAND_HANDLER(handle_xsvf_command)
 				tap_state_t end_state;
 				int delay;
 
-				if (read(xsvf_fd, &wait_local, 1) < 0
-					|| read(xsvf_fd, &end, 1) < 0
-					|| read(xsvf_fd, delay_buf, 4) < 0) {
-						do_abort = 1;
-						break;
+				if (xsvf_read(&wait_local, 1) < 0
+						|| xsvf_read(&end, 1) < 0
+						|| xsvf_read(delay_buf, 4) < 0) {
+					do_abort = 1;
+					break;
 				}
 
 				wait_state = xsvf_to_tap(wait_local);
@@ -793,10 +969,10 @@ COMMAND_HANDLER(handle_xsvf_command)
 				int clock_count;
 				int usecs;
 
-				if (read(xsvf_fd, &wait_local, 1) < 0
-						||  read(xsvf_fd, &end, 1) < 0
-						||  read(xsvf_fd, clock_buf, 4) < 0
-						||  read(xsvf_fd, usecs_buf, 4) < 0) {
+				if (xsvf_read(&wait_local, 1) < 0
+						||  xsvf_read(&end, 1) < 0
+						||  xsvf_read(clock_buf, 4) < 0
+						||  xsvf_read(usecs_buf, 4) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -845,7 +1021,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 				*/
 				uint8_t count_buf[4];
 
-				if (read(xsvf_fd, count_buf, 4) < 0) {
+				if (xsvf_read(count_buf, 4) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -864,9 +1040,9 @@ COMMAND_HANDLER(handle_xsvf_command)
 				uint8_t clock_buf[4];
 				uint8_t usecs_buf[4];
 
-				if (read(xsvf_fd, &state, 1) < 0
-						|| read(xsvf_fd, clock_buf, 4) < 0
-						|| read(xsvf_fd, usecs_buf, 4) < 0) {
+				if (xsvf_read(&state, 1) < 0
+						|| xsvf_read(clock_buf, 4) < 0
+						|| xsvf_read(usecs_buf, 4) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -892,8 +1068,8 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 				LOG_DEBUG("LSDR");
 
-				if (xsvf_read_buffer(xsdrsize, xsvf_fd, dr_out_buf) != ERROR_OK
-						|| xsvf_read_buffer(xsdrsize, xsvf_fd, dr_in_buf) != ERROR_OK) {
+				if (xsvf_read_buffer(xsdrsize, dr_out_buf) != ERROR_OK
+						|| xsvf_read_buffer(xsdrsize, dr_in_buf) != ERROR_OK) {
 					do_abort = 1;
 					break;
 				}
@@ -901,6 +1077,10 @@ COMMAND_HANDLER(handle_xsvf_command)
 				if (limit < 1)
 					limit = 1;
 
+				/* the retries need the result of each scan */
+				if (xsvf_execute_queue(&file_offset) != ERROR_OK)
+					limit = 0;
+
 				for (attempt = 0; attempt < limit; ++attempt) {
 					struct scan_field field;
 
@@ -929,11 +1109,9 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 					jtag_check_value_mask(&field, dr_in_buf, dr_in_mask);
 
-					free(field.in_value);
-
-
 					/* LOG_DEBUG("FLUSHING QUEUE"); */
 					result = jtag_execute_queue();
+					free(field.in_value);
 					if (result == ERROR_OK) {
 						matched = 1;
 						break;
@@ -952,7 +1130,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			{
 				uint8_t trst_mode;
 
-				if (read(xsvf_fd, &trst_mode, 1) < 0) {
+				if (xsvf_read(&trst_mode, 1) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -987,12 +1165,18 @@ COMMAND_HANDLER(handle_xsvf_command)
 			if (result != ERROR_OK)
 				return result;
 			result = jtag_execute_queue();
+			xsvf_free_checks();
 			if (result != ERROR_OK)
 				return result;
 			break;
 		}
 	}
 
+	/* the checks of the last scans, for a file without XCOMPLETE */
+	if (!do_abort && !unsupported && !tdo_mismatch &&
+			xsvf_execute_queue(&file_offset) != ERROR_OK)
+		tdo_mismatch = 1;
+
 	if (tdo_mismatch) {
 		command_print(CMD,
 			"TDO mismatch, somewhere near offset %lu in xsvf file, aborting",
@@ -1002,7 +1186,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 	}
 
 	if (unsupported) {
-		off_t offset = lseek(xsvf_fd, 0, SEEK_CUR) - 1;
+		off_t offset = xsvf_tell() - 1;
 		command_print(CMD,
 			"unsupported xsvf command (0x%02X) at offset %jd, aborting",
 			uc, (intmax_t)offset);
@@ -1017,6 +1201,11 @@ COMMAND_HANDLER(handle_xsvf_command)
 	free(dr_out_buf);
 	free(dr_in_buf);
 	free(dr_in_mask);
+	free(xsvf_checks);
+	xsvf_checks = NULL;
+	xsvf_max_checks = 0;
+	free(xsvf_read_buf);
+	xsvf_read_buf = NULL;
 
 	close(xsvf_fd);
 